@@ -78,6 +78,8 @@
 
 #define SO_MAX_PACING_RATE	44
 
+#define SO_BUSY_POLL		46
+
 #ifdef __KERNEL__
 /* O_NONBLOCK clashes with the bits used for socket types.  Therefore we
  * have to define SOCK_NONBLOCK to a different value here.
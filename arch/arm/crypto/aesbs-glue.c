@@ -18,6 +18,15 @@
 
 #define BIT_SLICED_KEY_MAXSIZE	(128 * (AES_MAXNR - 1) + 2 * AES_BLOCK_SIZE)
 
+/*
+ * Rank the NEON modes above the crypto engine (qcrypto registers its
+ * cbc/ctr/xts(aes) at 300) so that dm-crypt, which submits one 512 byte to
+ * 4 KB sector per request, does not pay the engine round trip for each one.
+ */
+static int aesbs_priority = 350;
+module_param_named(priority, aesbs_priority, int, S_IRUGO);
+MODULE_PARM_DESC(priority, "crypto API priority of the cbc/ctr/xts modes");
+
 struct BS_KEY {
 	struct AES_KEY	rk;
 	int		converted;
@@ -153,12 +162,21 @@ static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
 	blkcipher_walk_init(&walk, dst, src, nbytes);
 	err = blkcipher_walk_virt_block(desc, &walk, 8 * AES_BLOCK_SIZE);
 
-	while ((walk.nbytes / AES_BLOCK_SIZE) >= 8) {
+	if ((walk.nbytes / AES_BLOCK_SIZE) >= 8) {
+		/*
+		 * Save the VFP state once per request rather than once per
+		 * walk step, the walk must not sleep while NEON is in use.
+		 */
+		desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
 		kernel_neon_begin();
-		bsaes_cbc_encrypt(walk.src.virt.addr, walk.dst.virt.addr,
-				  walk.nbytes, &ctx->dec, walk.iv);
+		do {
+			bsaes_cbc_encrypt(walk.src.virt.addr,
+					  walk.dst.virt.addr, walk.nbytes,
+					  &ctx->dec, walk.iv);
+			err = blkcipher_walk_done(desc, &walk,
+					walk.nbytes % AES_BLOCK_SIZE);
+		} while ((walk.nbytes / AES_BLOCK_SIZE) >= 8);
 		kernel_neon_end();
-		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
 	while (walk.nbytes) {
 		u32 blocks = walk.nbytes / AES_BLOCK_SIZE;
@@ -263,13 +281,15 @@ static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
 	/* generate the initial tweak */
 	AES_encrypt(walk.iv, walk.iv, &ctx->twkey);
 
+	/* one VFP state save per sector, see aesbs_cbc_decrypt() */
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	kernel_neon_begin();
 	while (walk.nbytes) {
-		kernel_neon_begin();
 		bsaes_xts_encrypt(walk.src.virt.addr, walk.dst.virt.addr,
 				  walk.nbytes, &ctx->enc, walk.iv);
-		kernel_neon_end();
 		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
+	kernel_neon_end();
 	return err;
 }
 
@@ -287,13 +307,15 @@ static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
 	/* generate the initial tweak */
 	AES_encrypt(walk.iv, walk.iv, &ctx->twkey);
 
+	/* one VFP state save per sector, see aesbs_cbc_decrypt() */
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	kernel_neon_begin();
 	while (walk.nbytes) {
-		kernel_neon_begin();
 		bsaes_xts_decrypt(walk.src.virt.addr, walk.dst.virt.addr,
 				  walk.nbytes, &ctx->dec, walk.iv);
-		kernel_neon_end();
 		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
+	kernel_neon_end();
 	return err;
 }
 
@@ -415,9 +437,16 @@ static struct crypto_alg aesbs_algs[] = { {
 
 static int __init aesbs_mod_init(void)
 {
+	int i;
+
 	if (!cpu_has_neon())
 		return -ENODEV;
 
+	/* the internal blkciphers stay at 0, only rank the async modes */
+	for (i = 0; i < ARRAY_SIZE(aesbs_algs); i++)
+		if (aesbs_algs[i].cra_priority)
+			aesbs_algs[i].cra_priority = aesbs_priority;
+
 	return crypto_register_algs(aesbs_algs, ARRAY_SIZE(aesbs_algs));
 }
 
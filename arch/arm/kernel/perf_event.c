@@ -542,6 +542,7 @@ armpmu_reserve_hardware(struct arm_pmu *armpmu)
 	irqs = min(pmu_device->num_resources, num_possible_cpus());
 	if (irqs < 1) {
 		pr_err("no irqs for PMUs defined\n");
+		release_pmu(armpmu->type);
 		return -ENODEV;
 	}
 
@@ -568,7 +569,7 @@ armpmu_reserve_hardware(struct arm_pmu *armpmu)
                         pr_warning("unable to request IRQ%d for %s perf "
                                 "counters\n", irq, armpmu->name);
 
-			armpmu_release_hardware(cpu_pmu);
+			armpmu_release_hardware(armpmu);
                         return err;
                 }
 
@@ -705,8 +706,9 @@ static void armpmu_enable(struct pmu *pmu)
 	int enabled = bitmap_weight(hw_events->used_mask, armpmu->num_events);
 	int idx;
 
-	if (__get_cpu_var(from_idle)) {
-		for (idx = 0; idx <= cpu_pmu->num_events; ++idx) {
+	/* Only the CPU PMU loses its state in idle, see pmu_cpu_notify(). */
+	if (armpmu == cpu_pmu && __get_cpu_var(from_idle)) {
+		for (idx = 0; idx <= armpmu->num_events; ++idx) {
 			struct perf_event *event = hw_events->events[idx];
 
 			if (!event)
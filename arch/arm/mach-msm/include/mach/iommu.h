@@ -27,6 +27,11 @@ extern struct iommu_access_ops iommu_access_ops_v1;
 /* Domain attributes */
 #define MSM_IOMMU_DOMAIN_PT_CACHEABLE	0x1
 #define MSM_IOMMU_DOMAIN_PT_SECURE	0x2
+/*
+ * Batch the TLB invalidations of unmaps. The device may reach unmapped
+ * buffers until the next invalidation, so not for PT_SECURE domains.
+ */
+#define MSM_IOMMU_DOMAIN_LAZY_UNMAP	0x4
 
 /* Mask for the cache policy attribute */
 #define MSM_IOMMU_CP_MASK		0x03
@@ -13,6 +13,9 @@
 #include <linux/mutex.h>
 #include <linux/list.h>
 #include <linux/irqreturn.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/perf_event.h>
 
 #ifndef MSM_IOMMU_PERFMON_H
 #define MSM_IOMMU_PERFMON_H
@@ -27,6 +30,9 @@
  * @current_event_class: current selected event class, -1 if none
  * @counter_dir:         debugfs directory for this counter
  * @cnt_group:           group this counter belongs to
+ * @perf_event:          perf event using this counter, NULL if none
+ * @perf_raw:            last value folded into @perf_count
+ * @perf_count:          64 bit count seen by perf, under perf_lock
  */
 struct iommu_pmon_counter {
 	unsigned int counter_no;
@@ -37,6 +43,9 @@ struct iommu_pmon_counter {
 	int current_event_class;
 	struct dentry *counter_dir;
 	struct iommu_pmon_cnt_group *cnt_group;
+	struct perf_event *perf_event;
+	u64 perf_raw;
+	u64 perf_count;
 };
 
 /**
@@ -88,6 +97,11 @@ struct iommu_info {
  * @enabled:              Indicates whether perf. mon is enabled or not
  * @iommu_attached        Indicates whether iommu is attached or not.
  * @lock:                 mutex used to synchronize access to shared data
+ * @pmu:                  perf PMU for this iommu
+ * @perf_work:            folds the counters used by perf into their counts
+ * @perf_lock:            protects the counts read by the perf callbacks
+ * @perf_users:           number of perf events
+ * @perf_enabled:         1 if perf turned perf. mon on, 0 otherwise
  */
 struct iommu_pmon {
 	struct dentry *iommu_dir;
@@ -101,6 +115,11 @@ struct iommu_pmon {
 	unsigned int enabled;
 	unsigned int iommu_attach_count;
 	struct mutex lock;
+	struct pmu pmu;
+	struct delayed_work perf_work;
+	spinlock_t perf_lock;
+	unsigned int perf_users;
+	unsigned int perf_enabled;
 };
 
 /**
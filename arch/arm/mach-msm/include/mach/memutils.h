@@ -0,0 +1,28 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __ARCH_ARM_MACH_MSM_MEMUTILS_H
+#define __ARCH_ARM_MACH_MSM_MEMUTILS_H
+
+#include <linux/string.h>
+
+#if defined(CONFIG_HAS_MACH_MEMUTILS) && defined(CONFIG_KERNEL_MODE_NEON)
+void memcpy_neon_blocks(void *dest, const void *src, size_t n);
+void *memcpy_large(void *dest, const void *src, size_t n);
+#else
+static inline void *memcpy_large(void *dest, const void *src, size_t n)
+{
+	return memcpy(dest, src, n);
+}
+#endif
+
+#endif
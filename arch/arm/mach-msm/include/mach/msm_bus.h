@@ -78,6 +78,8 @@ struct msm_bus_scale_pdata {
 int __init msm_bus_fabric_init_driver(void);
 uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata);
 int msm_bus_scale_client_update_request(uint32_t cl, unsigned int index);
+int msm_bus_scale_client_update_request_async(uint32_t cl,
+		unsigned int index);
 void msm_bus_scale_unregister_client(uint32_t cl);
 /* AXI Port configuration APIs */
 int msm_bus_axi_porthalt(int master_port);
@@ -98,6 +100,12 @@ msm_bus_scale_client_update_request(uint32_t cl, unsigned int index)
 	return 0;
 }
 
+static inline int
+msm_bus_scale_client_update_request_async(uint32_t cl, unsigned int index)
+{
+	return 0;
+}
+
 static inline void
 msm_bus_scale_unregister_client(uint32_t cl)
 {
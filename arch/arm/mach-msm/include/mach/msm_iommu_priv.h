@@ -18,10 +18,13 @@
  * attributes.
  * fl_table: Pointer to the first level page table.
  * redirect: Set to 1 if L2 redirect for page tables are enabled, 0 otherwise.
+ * sl_freed: Number of second level tables freed by unmaps, cleared by the
+ *           driver once the TLB is invalidated.
  */
 struct msm_iommu_pt {
 	unsigned long *fl_table;
 	int redirect;
+	unsigned int sl_freed;
 };
 
 /**
@@ -31,11 +34,15 @@ struct msm_iommu_pt {
  * pt: Page table attribute structure
  * list_attached: List of devices (contexts) attached to this domain.
  * client_name: Name of the domain client.
+ * lazy_unmap: Set if the domain was created with MSM_IOMMU_DOMAIN_LAZY_UNMAP.
+ * unmap_pending: Unmaps done since the last TLB invalidation.
  */
 struct msm_iommu_priv {
 	struct msm_iommu_pt pt;
 	struct list_head list_attached;
 	const char *client_name;
+	int lazy_unmap;
+	unsigned int unmap_pending;
 };
 
 #endif
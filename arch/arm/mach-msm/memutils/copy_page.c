@@ -1,6 +1,69 @@
 #include <linux/string.h>
+#include <linux/module.h>
+#include <linux/hardirq.h>
 #include <asm/page.h>
+#include <asm/neon.h>
+#include <mach/memutils.h>
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+/*
+ * Saving the user VFP state and enabling NEON costs about as much as an
+ * integer copy of a few hundred bytes, so only larger copies go to NEON.
+ * Setting the threshold to 0 disables the NEON path.
+ */
+static unsigned int neon_min = 1024;
+module_param(neon_min, uint, 0644);
+
+static bool use_neon(const void *to, const void *from, size_t n)
+{
+	if (!neon_min || n < neon_min || !cpu_has_neon() || in_interrupt())
+		return false;
+
+	/* Misaligned NEON accesses split across lines, keep those integer */
+	return !(((unsigned long) to | (unsigned long) from) & 7);
+}
+
+/**
+ * memcpy_large() - memcpy() for copies that may be large
+ * @dest: destination
+ * @src: source
+ * @n: number of bytes
+ *
+ * Uses NEON for large, 8 byte aligned copies outside of interrupt context
+ * and the integer memcpy() for everything else, including the tail.
+ * memcpy() itself stays integer only since it is called from any context
+ * and mostly for small sizes.
+ */
+void *memcpy_large(void *dest, const void *src, size_t n)
+{
+	size_t blocks;
+
+	if (!use_neon(dest, src, n))
+		return memcpy(dest, src, n);
+
+	blocks = n & ~127;
+	kernel_neon_begin();
+	memcpy_neon_blocks(dest, src, blocks);
+	kernel_neon_end();
+
+	if (n > blocks)
+		memcpy(dest + blocks, src + blocks, n - blocks);
+
+	return dest;
+}
+EXPORT_SYMBOL(memcpy_large);
+
+void copy_page(void *to, const void *from)
+{
+	memcpy_large(to, from, PAGE_SIZE);
+}
+
+#else
+
 void copy_page(void *to, const void *from)
 {
 	memcpy(to, from, PAGE_SIZE);
 }
+
+#endif
@@ -17,6 +17,8 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/radix-tree.h>
 #include <linux/clk.h>
 #include <mach/msm_bus.h>
@@ -44,6 +46,16 @@
 
 static DEFINE_MUTEX(msm_bus_lock);
 
+/* Asynchronous votes waiting to be applied, see msm_bus_async_work_fn() */
+static LIST_HEAD(msm_bus_async_list);
+static DEFINE_SPINLOCK(msm_bus_async_lock);
+static void msm_bus_async_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(msm_bus_async_work, msm_bus_async_work_fn);
+
+static unsigned int msm_bus_async_window_ms = 2;
+module_param_named(async_window_ms, msm_bus_async_window_ms, uint,
+		S_IRUGO | S_IWUSR);
+
 /* This function uses shift operations to divide 64 bit value for higher
  * efficiency. The divisor expected are number of ports or bus-width.
  * These are expected to be 1, 2, 4, 8, 16 and 32 in most cases.
@@ -312,12 +324,108 @@ static uint64_t get_node_maxib(struct msm_bus_inode_info *info)
 	return maxib;
 }
 
+static int add_path_hop(struct msm_bus_path *path,
+	struct msm_bus_fabric_device *fabdev, struct msm_bus_inode_info *info,
+	int index)
+{
+	struct msm_bus_path_hop *hops;
+
+	hops = krealloc(path->hops, (path->num_hops + 1) *
+		sizeof(struct msm_bus_path_hop), GFP_KERNEL);
+	if (ZERO_OR_NULL_PTR(hops)) {
+		MSM_BUS_ERR("Error allocating path hop\n");
+		return -ENOMEM;
+	}
+
+	hops[path->num_hops].fabdev = fabdev;
+	hops[path->num_hops].info = info;
+	hops[path->num_hops].index = index;
+	path->hops = hops;
+	path->num_hops++;
+	return 0;
+}
+
+/**
+ * build_path() - Resolve the path nodes found by getpath() once
+ * @curr: Source node, as specified in the client vector (master)
+ * @pnode: The first-hop node on the path, as returned by getpath()
+ * @path: Path to fill in
+ *
+ * Walks the chain of path nodes the way update_path() used to on every
+ * request and records the fabric, node and path node index of each hop,
+ * so a bandwidth update doesn't have to look up fabrics and nodes again.
+ * The nodes and their path node slots live as long as the client.
+ */
+static int build_path(int curr, int pnode, struct msm_bus_path *path)
+{
+	int index, next_pnode, ret;
+	struct msm_bus_inode_info *info;
+	struct msm_bus_fabric_device *fabdev = msm_bus_get_fabric_device
+		(GET_FABID(curr));
+
+	if (!fabdev) {
+		MSM_BUS_ERR("Bus device for bus ID: %d not found!\n",
+			GET_FABID(curr));
+		return -ENXIO;
+	}
+
+	index = GET_INDEX(pnode);
+	info = fabdev->algo->find_node(fabdev, curr);
+	if (!info) {
+		MSM_BUS_ERR("Cannot find node info!\n");
+		return -ENXIO;
+	}
+
+	path->src = curr;
+	ret = add_path_hop(path, fabdev, info, index);
+	if (ret)
+		return ret;
+
+	do {
+		struct msm_bus_inode_info *hop;
+		fabdev = msm_bus_get_fabric_device(GET_FABID(curr));
+		if (!fabdev) {
+			MSM_BUS_ERR("Fabric not found\n");
+			return -ENXIO;
+		}
+
+		/* find next node and index */
+		next_pnode = info->pnode[index].next;
+		curr = GET_NODE(next_pnode);
+		index = GET_INDEX(next_pnode);
+
+		/* check if we are here as gateway, or does the hop belong to
+		 * this fabric */
+		if (IS_NODE(curr))
+			hop = fabdev->algo->find_node(fabdev, curr);
+		else
+			hop = fabdev->algo->find_gw_node(fabdev, curr);
+		if (!hop) {
+			MSM_BUS_ERR("Null Info found for hop\n");
+			return -ENXIO;
+		}
+
+		ret = add_path_hop(path, fabdev, hop, index);
+		if (ret)
+			return ret;
+		info = hop;
+	} while (GET_NODE(info->pnode[index].next) != info->node_info->priv_id);
+
+	return 0;
+}
+
+static void free_path(struct msm_bus_path *path)
+{
+	kfree(path->hops);
+	path->hops = NULL;
+	path->num_hops = 0;
+}
+
 /**
  * update_path() - Update the path with the bandwidth and clock values, as
  * requested by the client.
  *
- * @curr: Current source node, as specified in the client vector (master)
- * @pnode: The first-hop node on the path, stored in the internal client struct
+ * @path: The path resolved by build_path() at registration
  * @req_clk: Requested clock value from the vector
  * @req_bw: Requested bandwidth value from the vector
  * @curr_clk: Current clock frequency
@@ -328,36 +436,30 @@ static uint64_t get_node_maxib(struct msm_bus_inode_info *info)
  * frequencies is calculated at each node on the path. Commit data to be sent
  * to RPM for each master and slave is also calculated here.
  */
-static int update_path(int curr, int pnode, uint64_t req_clk, uint64_t req_bw,
-	uint64_t curr_clk, uint64_t curr_bw, unsigned int ctx, unsigned int
-	cl_active_flag)
+static int update_path(struct msm_bus_path *path, uint64_t req_clk,
+	uint64_t req_bw, uint64_t curr_clk, uint64_t curr_bw, unsigned int ctx,
+	unsigned int cl_active_flag)
 {
-	int index, ret = 0;
+	int index, h, ret = 0;
 	struct msm_bus_inode_info *info;
-	int next_pnode;
 	int64_t add_bw = req_bw - curr_bw;
 	uint64_t bwsum = 0;
-	uint64_t req_clk_hz, curr_clk_hz, bwsum_hz;
+	uint64_t req_clk_hz = 0, curr_clk_hz = 0, bwsum_hz = 0;
 	int *master_tiers;
-	struct msm_bus_fabric_device *fabdev = msm_bus_get_fabric_device
-		(GET_FABID(curr));
+	struct msm_bus_fabric_device *fabdev;
 
-	if (!fabdev) {
-		MSM_BUS_ERR("Bus device for bus ID: %d not found!\n",
-			GET_FABID(curr));
+	if (path->num_hops < 2) {
+		MSM_BUS_ERR("Path from %d not resolved!\n", path->src);
 		return -ENXIO;
 	}
 
-	MSM_BUS_DBG("args: %d %d %d %llu %llu %llu %llu %u\n",
-		curr, GET_NODE(pnode), GET_INDEX(pnode), req_clk, req_bw,
+	MSM_BUS_DBG("args: %d %d %llu %llu %llu %llu %u\n",
+		path->src, path->num_hops, req_clk, req_bw,
 		curr_clk, curr_bw, ctx);
-	index = GET_INDEX(pnode);
+	fabdev = path->hops[0].fabdev;
+	info = path->hops[0].info;
+	index = path->hops[0].index;
 	MSM_BUS_DBG("Client passed index :%d\n", index);
-	info = fabdev->algo->find_node(fabdev, curr);
-	if (!info) {
-		MSM_BUS_ERR("Cannot find node info!\n");
-		return -ENXIO;
-	}
 
 	info->link_info.sel_bw = &info->link_info.bw[ctx];
 	info->link_info.sel_clk = &info->link_info.clk[ctx];
@@ -390,33 +492,13 @@ static int update_path(int curr, int pnode, uint64_t req_clk, uint64_t req_bw,
 	info->link_info.tier = info->node_info->tier;
 	master_tiers = info->node_info->tier;
 
-	do {
-		struct msm_bus_inode_info *hop;
-		fabdev = msm_bus_get_fabric_device(GET_FABID(curr));
-		if (!fabdev) {
-			MSM_BUS_ERR("Fabric not found\n");
-			return -ENXIO;
-		}
-		MSM_BUS_DBG("id: %d\n", info->node_info->priv_id);
+	for (h = 1; h < path->num_hops; h++) {
+		struct msm_bus_inode_info *hop = path->hops[h].info;
 
-		/* find next node and index */
-		next_pnode = info->pnode[index].next;
-		curr = GET_NODE(next_pnode);
-		index = GET_INDEX(next_pnode);
+		fabdev = path->hops[h].fabdev;
+		index = path->hops[h].index;
 		MSM_BUS_DBG("id:%d, next: %d\n", info->
-		    node_info->priv_id, curr);
-
-		/* Get hop */
-		/* check if we are here as gateway, or does the hop belong to
-		 * this fabric */
-		if (IS_NODE(curr))
-			hop = fabdev->algo->find_node(fabdev, curr);
-		else
-			hop = fabdev->algo->find_gw_node(fabdev, curr);
-		if (!hop) {
-			MSM_BUS_ERR("Null Info found for hop\n");
-			return -ENXIO;
-		}
+		    node_info->priv_id, hop->node_info->priv_id);
 
 		hop->link_info.sel_bw = &hop->link_info.bw[ctx];
 		hop->link_info.sel_clk = &hop->link_info.clk[ctx];
@@ -462,13 +544,8 @@ static int update_path(int curr, int pnode, uint64_t req_clk, uint64_t req_bw,
 		if (ret)
 			MSM_BUS_WARN("Failed to update clk\n");
 		info = hop;
-	} while (GET_NODE(info->pnode[index].next) != info->node_info->priv_id);
-
-	/* Update BW, clk after exiting the loop for the last one */
-	if (!info) {
-		MSM_BUS_ERR("Cannot find node info!\n");
-		return -ENXIO;
 	}
+
 	/* Update slave clocks */
 	ret = fabdev->algo->update_clks(fabdev, info, index, curr_clk_hz,
 	    req_clk_hz, bwsum_hz, SEL_SLAVE_CLK, ctx, cl_active_flag);
@@ -532,9 +609,18 @@ uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata)
 		return 0;
 	}
 
+	client->paths = kcalloc(pdata->usecase->num_paths,
+		sizeof(struct msm_bus_path), GFP_KERNEL);
+	if (!client->paths) {
+		MSM_BUS_ERR("Error allocating client paths\n");
+		kfree(client);
+		return 0;
+	}
+
 	mutex_lock(&msm_bus_lock);
 	client->pdata = pdata;
 	client->curr = -1;
+	INIT_LIST_HEAD(&client->async_entry);
 	for (i = 0; i < pdata->usecase->num_paths; i++) {
 		int *pnode;
 		struct msm_bus_fabric_device *srcfab;
@@ -585,6 +671,11 @@ uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata)
 			MSM_BUS_ERR("Cannot register client now! Try again!\n");
 			goto err;
 		}
+
+		if (build_path(src, pnode[i], &client->paths[i])) {
+			MSM_BUS_ERR("Cannot resolve path %d -> %d\n", src, dest);
+			goto err;
+		}
 	}
 	msm_bus_dbg_client_data(client->pdata, MSM_BUS_DBG_REGISTER,
 		(uint32_t)client);
@@ -593,6 +684,9 @@ uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata)
 		pdata->usecase->num_paths);
 	return (uint32_t)(client);
 err:
+	for (i = 0; i < pdata->usecase->num_paths; i++)
+		free_path(&client->paths[i]);
+	kfree(client->paths);
 	kfree(client->src_pnode);
 	kfree(client);
 	mutex_unlock(&msm_bus_lock);
@@ -600,67 +694,73 @@ err:
 }
 EXPORT_SYMBOL(msm_bus_scale_register_client);
 
-/**
- * msm_bus_scale_client_update_request() - Update the request for bandwidth
- * from a particular client
- *
- * cl: Handle to the client
- * index: Index into the vector, to which the bw and clock values need to be
- * updated
+/*
+ * Returns true when every path of usecase @index asks for the same ab and
+ * ib as usecase @curr, in which case the aggregated votes can't change.
  */
-int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
+static bool msm_bus_same_vectors(struct msm_bus_scale_pdata *pdata,
+		int curr, unsigned index)
+{
+	int i;
+
+	if (curr < 0)
+		return false;
+
+	for (i = 0; i < pdata->usecase->num_paths; i++) {
+		struct msm_bus_vectors *cv = &pdata->usecase[curr].vectors[i];
+		struct msm_bus_vectors *nv = &pdata->usecase[index].vectors[i];
+
+		if ((cv->ab != nv->ab) || (cv->ib != nv->ib))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Updates the paths of a client to usecase @index without committing.
+ * Called with msm_bus_lock held.  Returns 1 if the fabrics need a commit,
+ * 0 if nothing changed or a negative error code.
+ */
+static int __msm_bus_update_request(struct msm_bus_client *client,
+		unsigned index)
 {
 	int i, ret = 0;
 	struct msm_bus_scale_pdata *pdata;
-	int pnode, src, curr, ctx;
+	struct msm_bus_path *path;
+	int curr;
 	uint64_t req_clk, req_bw, curr_clk, curr_bw;
-	struct msm_bus_client *client = (struct msm_bus_client *)cl;
-	if (IS_ERR_OR_NULL(client)) {
-		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
-				(uint32_t)client);
-		return -ENXIO;
-	}
+	uint32_t cl = (uint32_t)client;
 
-	mutex_lock(&msm_bus_lock);
 	if (client->curr == index)
-		goto err;
+		return 0;
 
 	curr = client->curr;
 	pdata = client->pdata;
 	if (!pdata) {
 		MSM_BUS_ERR("Null pdata passed to update-request\n");
-		ret = -ENXIO;
-		goto err;
+		return -ENXIO;
 	}
 
 	if (index >= pdata->num_usecases) {
 		MSM_BUS_ERR("Client %u passed invalid index: %d\n",
 			(uint32_t)client, index);
-		ret = -ENXIO;
-		goto err;
+		return -ENXIO;
 	}
 
 	MSM_BUS_DBG("cl: %u index: %d curr: %d num_paths: %d\n",
 		cl, index, client->curr, client->pdata->usecase->num_paths);
 
-	for (i = 0; i < pdata->usecase->num_paths; i++) {
-		src = msm_bus_board_get_iid(client->pdata->usecase[index].
-			vectors[i].src);
-		if (src == -ENXIO) {
-			MSM_BUS_ERR("Master %d not supported. Request cannot"
-				" be updated\n", client->pdata->usecase->
-				vectors[i].src);
-			goto err;
-		}
-
-		if (msm_bus_board_get_iid(client->pdata->usecase[index].
-			vectors[i].dst) == -ENXIO) {
-			MSM_BUS_ERR("Slave %d not supported. Request cannot"
-				" be updated\n", client->pdata->usecase->
-				vectors[i].dst);
-		}
+	if (msm_bus_same_vectors(pdata, curr, index)) {
+		MSM_BUS_DBG("cl: %u same vectors, skipping update\n", cl);
+		client->curr = index;
+		msm_bus_dbg_client_data(client->pdata, index, cl);
+		return 0;
+	}
 
-		pnode = client->src_pnode[i];
+	/* the masters and slaves were resolved when the client registered */
+	for (i = 0; i < pdata->usecase->num_paths; i++) {
+		path = &client->paths[i];
 		req_clk = client->pdata->usecase[index].vectors[i].ib;
 		req_bw = client->pdata->usecase[index].vectors[i].ab;
 		if (curr < 0) {
@@ -673,33 +773,149 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 		}
 
 		if (!pdata->active_only) {
-			ret = update_path(src, pnode, req_clk, req_bw,
+			ret = update_path(path, req_clk, req_bw,
 				curr_clk, curr_bw, 0, pdata->active_only);
 			if (ret) {
 				MSM_BUS_ERR("Update path failed! %d\n", ret);
-				goto err;
+				return ret;
 			}
 		}
 
-		ret = update_path(src, pnode, req_clk, req_bw, curr_clk,
+		ret = update_path(path, req_clk, req_bw, curr_clk,
 				curr_bw, ACTIVE_CTX, pdata->active_only);
 		if (ret) {
 			MSM_BUS_ERR("Update Path failed! %d\n", ret);
-			goto err;
+			return ret;
 		}
 	}
 
 	client->curr = index;
-	ctx = ACTIVE_CTX;
 	msm_bus_dbg_client_data(client->pdata, index, cl);
-	bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+	return 1;
+}
 
-err:
+/* Drops a vote still waiting for msm_bus_async_work_fn() */
+static void msm_bus_async_cancel(struct msm_bus_client *client)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_bus_async_lock, flags);
+	list_del_init(&client->async_entry);
+	spin_unlock_irqrestore(&msm_bus_async_lock, flags);
+}
+
+/*
+ * Applies all the votes queued during the last window and commits the
+ * fabrics once for all of them.
+ */
+static void msm_bus_async_work_fn(struct work_struct *work)
+{
+	struct msm_bus_client *client;
+	unsigned long flags;
+	unsigned index;
+	bool commit = false;
+	int ret;
+
+	mutex_lock(&msm_bus_lock);
+	spin_lock_irqsave(&msm_bus_async_lock, flags);
+	while (!list_empty(&msm_bus_async_list)) {
+		client = list_first_entry(&msm_bus_async_list,
+				struct msm_bus_client, async_entry);
+		list_del_init(&client->async_entry);
+		index = client->async_index;
+		spin_unlock_irqrestore(&msm_bus_async_lock, flags);
+
+		ret = __msm_bus_update_request(client, index);
+		if (ret > 0)
+			commit = true;
+		else if (ret < 0)
+			MSM_BUS_ERR("Async update for cl %u failed %d\n",
+				(uint32_t)client, ret);
+
+		spin_lock_irqsave(&msm_bus_async_lock, flags);
+	}
+	spin_unlock_irqrestore(&msm_bus_async_lock, flags);
+
+	if (commit)
+		bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+	mutex_unlock(&msm_bus_lock);
+}
+
+/**
+ * msm_bus_scale_client_update_request() - Update the request for bandwidth
+ * from a particular client
+ *
+ * cl: Handle to the client
+ * index: Index into the vector, to which the bw and clock values need to be
+ * updated
+ */
+int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
+{
+	int ret;
+	struct msm_bus_client *client = (struct msm_bus_client *)cl;
+	if (IS_ERR_OR_NULL(client)) {
+		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
+				(uint32_t)client);
+		return -ENXIO;
+	}
+
+	/* a synchronous vote supersedes a pending asynchronous one */
+	msm_bus_async_cancel(client);
+
+	mutex_lock(&msm_bus_lock);
+	ret = __msm_bus_update_request(client, index);
+	if (ret > 0) {
+		bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
+		ret = 0;
+	}
 	mutex_unlock(&msm_bus_lock);
 	return ret;
 }
 EXPORT_SYMBOL(msm_bus_scale_client_update_request);
 
+/**
+ * msm_bus_scale_client_update_request_async() - Queue a bandwidth request
+ * without waiting for it to be applied
+ *
+ * cl: Handle to the client
+ * index: Index into the vector, to which the bw and clock values need to be
+ * updated
+ *
+ * The votes of all clients arriving within async_window_ms are applied
+ * together with a single commit, and a client's later vote replaces its
+ * pending one.  Can be called from atomic context.  Since the vote lands
+ * late, use it where running briefly at the old bandwidth is harmless,
+ * e.g. to drop a vote or for the per frame refinements of a vote.
+ */
+int msm_bus_scale_client_update_request_async(uint32_t cl, unsigned index)
+{
+	struct msm_bus_client *client = (struct msm_bus_client *)cl;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(client) || !client->pdata) {
+		MSM_BUS_ERR("msm_bus_scale_client async req error %d\n",
+				(uint32_t)client);
+		return -ENXIO;
+	}
+
+	if (index >= client->pdata->num_usecases) {
+		MSM_BUS_ERR("Client %u passed invalid index: %d\n", cl, index);
+		return -ENXIO;
+	}
+
+	spin_lock_irqsave(&msm_bus_async_lock, flags);
+	client->async_index = index;
+	if (list_empty(&client->async_entry))
+		list_add_tail(&client->async_entry, &msm_bus_async_list);
+	spin_unlock_irqrestore(&msm_bus_async_lock, flags);
+
+	/* the window opens with the first vote and is not pushed back */
+	schedule_delayed_work(&msm_bus_async_work,
+			msecs_to_jiffies(msm_bus_async_window_ms));
+	return 0;
+}
+EXPORT_SYMBOL(msm_bus_scale_client_update_request_async);
+
 int reset_pnodes(int curr, int pnode)
 {
 	struct msm_bus_inode_info *info;
@@ -799,6 +1015,8 @@ void msm_bus_scale_unregister_client(uint32_t cl)
 	if (IS_ERR_OR_NULL(client))
 		return;
 
+	msm_bus_async_cancel(client);
+
 	for (i = 0; i < client->pdata->usecase->num_paths; i++) {
 		if ((client->pdata->usecase[0].vectors[i].ab) ||
 			(client->pdata->usecase[0].vectors[i].ib)) {
@@ -839,6 +1057,9 @@ void msm_bus_scale_unregister_client(uint32_t cl)
 	msm_bus_scale_client_reset_pnodes(cl);
 	msm_bus_dbg_client_data(client->pdata, MSM_BUS_DBG_UNREGISTER, cl);
 	mutex_unlock(&msm_bus_lock);
+	for (i = 0; i < client->pdata->usecase->num_paths; i++)
+		free_path(&client->paths[i]);
+	kfree(client->paths);
 	kfree(client->src_pnode);
 	kfree(client);
 }
@@ -213,11 +213,27 @@ struct msm_bus_fabnodeinfo {
 	struct msm_bus_inode_info *info;
 };
 
+/* A hop of a client path, as resolved by build_path() */
+struct msm_bus_path_hop {
+	struct msm_bus_fabric_device *fabdev;	/* fabric the hop was found on */
+	struct msm_bus_inode_info *info;
+	int index;				/* path node of the client */
+};
+
+struct msm_bus_path {
+	int src;				/* internal id of the master */
+	int num_hops;
+	struct msm_bus_path_hop *hops;		/* hops[0] is the master */
+};
+
 struct msm_bus_client {
 	int id;
 	struct msm_bus_scale_pdata *pdata;
 	int *src_pnode;
+	struct msm_bus_path *paths;
 	int curr;
+	struct list_head async_entry;	/* on the pending async vote list */
+	unsigned async_index;		/* usecase of the pending vote */
 };
 
 uint64_t msm_bus_div64(unsigned int width, uint64_t bw);
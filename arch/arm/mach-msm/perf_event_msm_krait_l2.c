@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2011-2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "krait-l2-pmu: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/of.h>
+#include <linux/perf_event.h>
+#include <linux/platform_device.h>
+#include <linux/spinlock.h>
+
+#include <asm/pmu.h>
+
+#include <mach/msm-krait-l2-accessors.h>
+
+/*
+ * Event counters 0-3 and the cycle counter are programmed by the devfreq
+ * L2 monitors in drivers/devfreq/krait-l2pm.c, which share the overflow
+ * interrupt with this driver. perf only hands out the counters above them.
+ */
+#define L2_PERF_FIRST_CTR	4
+
+#define L2_NUM_RESR		16
+#define L2_NUM_GROUPS		4
+
+/* Count the requests of every CPU port */
+#define L2_FILTER_ALL_CPUS	0x000f003f
+/* Count the requests of a single CPU port */
+#define L2_FILTER_CPU(cpu)	(0x000f0030 | BIT(cpu))
+/* Slave port traffic is not tied to any CPU */
+#define L2_FILTER_SLAVE		0x000f0010
+
+#define L2PMRESR(n)		(IA_L2PMRESX_BASE + (n))
+#define L2PMnEVCNTCR(n)		(IA_L2PMXEVCNTCR_BASE + (n) * 0x10)
+#define L2PMnEVCNTR(n)		(IA_L2PMXEVCNTR_BASE + (n) * 0x10)
+#define L2PMnEVFILTER(n)	(IA_L2PMXEVFILTER_BASE + (n) * 0x10)
+#define L2PMnEVTYPER(n)		(IA_L2PMXEVTYPER_BASE + (n) * 0x10)
+
+/*
+ * Raw event codes use the rsRCCG format: prefix, L2PMRESR register, group
+ * code and group select. The prefix tells slave port events apart.
+ */
+struct l2_event_desc {
+	unsigned int prefix;
+	unsigned int reg;
+	unsigned int code;
+	unsigned int group;
+};
+
+/*
+ * The L2PMRESR groups programmed by the devfreq monitors. perf events may
+ * count the same codes, but can't select a different code for these
+ * groups without breaking the bandwidth and cache governors.
+ */
+static const struct l2_event_desc l2_devfreq_events[] = {
+	{ .reg = 0, .group = 0, .code = 0x01 },
+	{ .reg = 0, .group = 3, .code = 0x06 },
+	{ .reg = 2, .group = 2, .code = 0x0b },
+	{ .reg = 2, .group = 3, .code = 0x0b },
+};
+
+/*
+ * Each group of an L2PMRESR register selects a single event code, so the
+ * perf events sharing a register and group have to agree on it.
+ */
+struct l2_resr_slot {
+	unsigned int code;
+	unsigned int users;
+};
+
+static struct l2_resr_slot l2_resr_slots[L2_NUM_RESR][L2_NUM_GROUPS];
+static DEFINE_RAW_SPINLOCK(l2_resr_lock);
+
+static struct perf_event *l2_events[MAX_KRAIT_L2_CTRS];
+static unsigned long l2_used_mask[BITS_TO_LONGS(MAX_KRAIT_L2_CTRS)];
+
+/* The L2 PMU is shared by all CPUs, so there is a single set of events */
+static struct pmu_hw_events krait_l2_hw_events = {
+	.events = l2_events,
+	.used_mask = l2_used_mask,
+	.pmu_lock = __RAW_SPIN_LOCK_UNLOCKED(krait_l2_hw_events.pmu_lock),
+};
+
+static struct arm_pmu krait_l2_pmu;
+
+static void l2_get_event_desc(u64 config, struct l2_event_desc *desc)
+{
+	desc->prefix = (config & EVENT_PREFIX_MASK) >> EVENT_PREFIX_SHIFT;
+	desc->reg = (config & EVENT_REG_MASK) >> EVENT_REG_SHIFT;
+	desc->code = (config & EVENT_GROUPCODE_MASK) >> EVENT_GROUPCODE_SHIFT;
+	desc->group = config & EVENT_GROUPSEL_MASK;
+}
+
+static struct pmu_hw_events *krait_l2_get_hw_events(void)
+{
+	return &krait_l2_hw_events;
+}
+
+static int krait_l2_map_event(struct perf_event *event)
+{
+	struct l2_event_desc desc;
+
+	if (event->attr.type != krait_l2_pmu.pmu.type)
+		return -ENOENT;
+
+	if (event->attr.config & ~(u64)L2_EVT_MASK)
+		return -EINVAL;
+
+	l2_get_event_desc(event->attr.config, &desc);
+
+	/* This also rejects L2CYCLE_CTR_RAW_CODE, devfreq owns that counter */
+	if (desc.group >= L2_NUM_GROUPS)
+		return -EINVAL;
+
+	if (desc.prefix == L2_SLAVE_EV_PREFIX) {
+		if (event->cpu < 0)
+			return -EOPNOTSUPP;
+	} else if (desc.prefix) {
+		return -EINVAL;
+	}
+
+	/*
+	 * The overflow interrupt is taken on one CPU for every L2 event, so
+	 * it can't deliver samples into the buffer of a task running
+	 * elsewhere. Counting is all that is supported.
+	 */
+	if (is_sampling_event(event))
+		return -EOPNOTSUPP;
+
+	return event->attr.config & L2_EVT_MASK;
+}
+
+static int krait_l2_test_set_event_constraints(struct perf_event *event)
+{
+	struct l2_event_desc desc;
+	struct l2_resr_slot *slot;
+	unsigned long flags;
+	int i, err = 0;
+
+	l2_get_event_desc(event->hw.config_base, &desc);
+
+	for (i = 0; i < ARRAY_SIZE(l2_devfreq_events); i++) {
+		const struct l2_event_desc *df = &l2_devfreq_events[i];
+
+		if (df->reg == desc.reg && df->group == desc.group &&
+		    df->code != desc.code)
+			return -EPERM;
+	}
+
+	slot = &l2_resr_slots[desc.reg][desc.group];
+
+	raw_spin_lock_irqsave(&l2_resr_lock, flags);
+	if (slot->users && slot->code != desc.code) {
+		err = -EPERM;
+	} else {
+		slot->code = desc.code;
+		slot->users++;
+	}
+	raw_spin_unlock_irqrestore(&l2_resr_lock, flags);
+
+	return err;
+}
+
+static int krait_l2_clear_event_constraints(struct perf_event *event)
+{
+	struct l2_event_desc desc;
+	unsigned long flags;
+
+	l2_get_event_desc(event->hw.config_base, &desc);
+
+	raw_spin_lock_irqsave(&l2_resr_lock, flags);
+	if (l2_resr_slots[desc.reg][desc.group].users)
+		l2_resr_slots[desc.reg][desc.group].users--;
+	raw_spin_unlock_irqrestore(&l2_resr_lock, flags);
+
+	return 0;
+}
+
+static int krait_l2_get_event_idx(struct pmu_hw_events *cpuc,
+				  struct hw_perf_event *hwc)
+{
+	int idx;
+
+	for (idx = L2_PERF_FIRST_CTR; idx < krait_l2_pmu.num_events; idx++)
+		if (!test_and_set_bit(idx, cpuc->used_mask))
+			return idx;
+
+	return -EAGAIN;
+}
+
+/*
+ * Events that follow a task (@cpu < 0) only count the requests of the CPU
+ * the task is running on. perf schedules such an event out and back in
+ * when the task migrates, which reprograms the filter for the new CPU.
+ */
+static void krait_l2_enable(struct hw_perf_event *hwc, int idx, int cpu)
+{
+	struct l2_event_desc desc;
+	unsigned long flags;
+	u32 filter, resr, shift;
+
+	l2_get_event_desc(hwc->config_base, &desc);
+
+	if (desc.prefix == L2_SLAVE_EV_PREFIX)
+		filter = L2_FILTER_SLAVE;
+	else if (cpu < 0)
+		filter = L2_FILTER_CPU(smp_processor_id());
+	else
+		filter = L2_FILTER_ALL_CPUS;
+
+	shift = desc.group * 8;
+
+	raw_spin_lock_irqsave(&krait_l2_hw_events.pmu_lock, flags);
+
+	set_l2_indirect_reg(L2PMCNTENCLR, BIT(idx));
+
+	resr = get_l2_indirect_reg(L2PMRESR(desc.reg));
+	resr &= ~(0xffU << shift);
+	resr |= RESRX_VALUE_EN | (desc.code << shift);
+	set_l2_indirect_reg(L2PMRESR(desc.reg), resr);
+
+	set_l2_indirect_reg(L2PMnEVCNTCR(idx), 0x0);
+	set_l2_indirect_reg(L2PMnEVTYPER(idx), desc.group + 4 * desc.reg);
+	set_l2_indirect_reg(L2PMnEVFILTER(idx), filter);
+
+	set_l2_indirect_reg(L2PMINTENSET, BIT(idx));
+	set_l2_indirect_reg(L2PMCNTENSET, BIT(idx));
+
+	raw_spin_unlock_irqrestore(&krait_l2_hw_events.pmu_lock, flags);
+}
+
+static void krait_l2_disable(struct hw_perf_event *hwc, int idx)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&krait_l2_hw_events.pmu_lock, flags);
+	set_l2_indirect_reg(L2PMCNTENCLR, BIT(idx));
+	set_l2_indirect_reg(L2PMINTENCLR, BIT(idx));
+	raw_spin_unlock_irqrestore(&krait_l2_hw_events.pmu_lock, flags);
+}
+
+static u32 krait_l2_read_counter(int idx)
+{
+	return get_l2_indirect_reg(L2PMnEVCNTR(idx));
+}
+
+static void krait_l2_write_counter(int idx, u32 val)
+{
+	set_l2_indirect_reg(L2PMnEVCNTR(idx), val);
+}
+
+static void krait_l2_start(void)
+{
+	unsigned long flags;
+	u32 pmcr;
+
+	raw_spin_lock_irqsave(&krait_l2_hw_events.pmu_lock, flags);
+	pmcr = get_l2_indirect_reg(L2PMCR);
+	if (!(pmcr & L2PMCR_GLOBAL_ENABLE))
+		set_l2_indirect_reg(L2PMCR, pmcr | L2PMCR_GLOBAL_ENABLE);
+	raw_spin_unlock_irqrestore(&krait_l2_hw_events.pmu_lock, flags);
+}
+
+/*
+ * The global enable is shared with the devfreq monitors and with the
+ * events of the other CPUs, so counters are only ever gated one by one.
+ */
+static void krait_l2_stop(void)
+{
+}
+
+static irqreturn_t krait_l2_handle_irq(int irq_num, void *dev)
+{
+	unsigned long ovsr;
+	int idx;
+
+	/* The other overflow bits belong to the devfreq monitors */
+	ovsr = get_l2_indirect_reg(L2PMOVSR) & l2_used_mask[0];
+	if (!ovsr)
+		return IRQ_NONE;
+
+	set_l2_indirect_reg(L2PMOVSR, ovsr);
+
+	for_each_set_bit(idx, &ovsr, krait_l2_pmu.num_events) {
+		struct perf_event *event = l2_events[idx];
+
+		if (!event)
+			continue;
+
+		armpmu_event_update(event, &event->hw, idx);
+		armpmu_event_set_period(event, &event->hw, idx);
+	}
+
+	return IRQ_HANDLED;
+}
+
+static int krait_l2_request_irq(int irq, irq_handler_t *handle_irq)
+{
+	return request_threaded_irq(irq, *handle_irq, NULL,
+				    IRQF_ONESHOT | IRQF_SHARED,
+				    "l2-armpmu", &krait_l2_pmu);
+}
+
+static void krait_l2_free_irq(int irq)
+{
+	if (irq >= 0)
+		free_irq(irq, &krait_l2_pmu);
+}
+
+static struct arm_pmu krait_l2_pmu = {
+	.id			= ARM_PERF_PMU_ID_KRAIT_L2,
+	.type			= ARM_PMU_DEVICE_L2CC,
+	.name			= "Krait L2CC PMU",
+	.max_period		= MAX_L2_PERIOD,
+	.handle_irq		= krait_l2_handle_irq,
+	.request_pmu_irq	= krait_l2_request_irq,
+	.free_pmu_irq		= krait_l2_free_irq,
+	.enable			= krait_l2_enable,
+	.disable		= krait_l2_disable,
+	.get_event_idx		= krait_l2_get_event_idx,
+	.read_counter		= krait_l2_read_counter,
+	.write_counter		= krait_l2_write_counter,
+	.start			= krait_l2_start,
+	.stop			= krait_l2_stop,
+	.map_event		= krait_l2_map_event,
+	.get_hw_events		= krait_l2_get_hw_events,
+	.test_set_event_constraints = krait_l2_test_set_event_constraints,
+	.clear_event_constraints = krait_l2_clear_event_constraints,
+};
+
+static int __devinit krait_l2_pmu_device_probe(struct platform_device *pdev)
+{
+	int num_ctrs;
+
+	num_ctrs = (get_l2_indirect_reg(L2PMCR) >> PMCR_NUM_EV_SHIFT) &
+		PMCR_NUM_EV_MASK;
+	krait_l2_pmu.num_events = min(num_ctrs, MAX_KRAIT_L2_CTRS);
+	if (krait_l2_pmu.num_events <= L2_PERF_FIRST_CTR) {
+		pr_err("no event counters left for perf (%d)\n", num_ctrs);
+		return -ENODEV;
+	}
+
+	krait_l2_pmu.plat_device = pdev;
+
+	pr_info("%d event counters available\n",
+		krait_l2_pmu.num_events - L2_PERF_FIRST_CTR);
+
+	return armpmu_register(&krait_l2_pmu, "msm-l2", -1);
+}
+
+static struct of_device_id krait_l2_pmu_of_match[] = {
+	{ .compatible = "qcom,l2-pmu" },
+	{}
+};
+
+static struct platform_driver krait_l2_pmu_driver = {
+	.probe = krait_l2_pmu_device_probe,
+	.driver = {
+		.name = "l2-arm-pmu",
+		.of_match_table = krait_l2_pmu_of_match,
+	},
+};
+
+static int __init register_krait_l2_pmu_driver(void)
+{
+	return platform_driver_register(&krait_l2_pmu_driver);
+}
+device_initcall(register_krait_l2_pmu_driver);
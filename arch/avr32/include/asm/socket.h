@@ -71,4 +71,6 @@
 
 #define SO_MAX_PACING_RATE	44
 
+#define SO_BUSY_POLL		46
+
 #endif /* __ASM_AVR32_SOCKET_H */
@@ -73,6 +73,8 @@
 
 #define SO_MAX_PACING_RATE	44
 
+#define SO_BUSY_POLL		46
+
 #endif /* _ASM_SOCKET_H */
 
 
@@ -82,4 +82,6 @@
 
 #define SO_MAX_PACING_RATE	47
 
+#define SO_BUSY_POLL		46
+
 #endif	/* _XTENSA_SOCKET_H */
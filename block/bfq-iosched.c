@@ -145,6 +145,14 @@ struct kmem_cache *bfq_pool;
  * thresholds used to switch between speed classes.
  * Both the reference peak rates and the thresholds are measured in
  * sectors/usec, left-shifted by BFQ_RATE_SHIFT.
+ *
+ * On Android, a newly forked application issues its first requests right
+ * away and in a burst with its siblings, so the idle-time based detection
+ * above often misses it. When wr_fg_cgroup names the cpu cgroup that the
+ * ActivityManager moves the foreground application into, a sync queue
+ * also starts a weight-raising period of wr_fg_time the first time it is
+ * activated after its process enters that cgroup, i.e. when the
+ * application is launched or brought to the front.
  */
 static int R_slow[2] = {1536, 10752};
 static int R_fast[2] = {17415, 34791};
@@ -573,6 +581,64 @@ static inline unsigned int bfq_wr_duration(struct bfq_data *bfqd)
 	return dur;
 }
 
+static inline unsigned int bfq_wr_fg_duration(struct bfq_data *bfqd)
+{
+	if (bfqd->bfq_wr_fg_time > 0)
+		return bfqd->bfq_wr_fg_time;
+
+	return bfq_wr_duration(bfqd);
+}
+
+#ifdef CONFIG_CGROUP_SCHED
+static bool bfq_task_in_fg_cgroup(struct bfq_data *bfqd,
+				  struct task_struct *tsk)
+{
+	char path[BFQ_CGROUP_PATH_LEN];
+	bool ret = false;
+
+	if (!bfqd->bfq_wr_fg_cgroup[0])
+		return false;
+
+	rcu_read_lock();
+	if (!cgroup_path(task_cgroup(tsk, cpu_cgroup_subsys_id),
+			 path, sizeof(path)))
+		ret = !strcmp(path, bfqd->bfq_wr_fg_cgroup);
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static inline bool bfq_task_in_fg_cgroup(struct bfq_data *bfqd,
+					 struct task_struct *tsk)
+{
+	return false;
+}
+#endif
+
+/*
+ * Tell whether the process owning the sync queue bfqq, which is being
+ * activated by the current task, has entered the foreground cgroup since
+ * the last activation of the queue.
+ */
+static bool bfq_bfqq_fg_launch(struct bfq_data *bfqd, struct bfq_queue *bfqq)
+{
+	bool in_fg;
+
+	if (!bfq_bfqq_sync(bfqq) || bfqq->bic == NULL || in_interrupt())
+		return false;
+
+	in_fg = bfq_task_in_fg_cgroup(bfqd, current);
+	if (!in_fg) {
+		bfq_clear_bfqq_in_fg(bfqq);
+		return false;
+	}
+	if (bfq_bfqq_in_fg(bfqq))
+		return false;
+
+	bfq_mark_bfqq_in_fg(bfqq);
+	return true;
+}
+
 static inline unsigned
 bfq_bfqq_cooperations(struct bfq_queue *bfqq)
 {
@@ -846,7 +912,7 @@ static void bfq_add_request(struct request *rq)
 	struct bfq_data *bfqd = bfqq->bfqd;
 	struct request *next_rq, *prev;
 	unsigned long old_wr_coeff = bfqq->wr_coeff;
-	bool interactive = false;
+	bool interactive = false, fg_launch = false;
 
 	bfq_log_bfqq(bfqd, bfqq, "add_request %d", rq_is_sync(rq));
 	bfqq->queued[rq_is_sync(rq)]++;
@@ -899,6 +965,13 @@ static void bfq_add_request(struct request *rq)
 			!coop_or_in_burst &&
 			time_is_before_jiffies(bfqq->soft_rt_next_start);
 		interactive = !coop_or_in_burst && idle_for_long_time;
+		/*
+		 * A launch signalled by the foreground cgroup is trusted
+		 * even though it comes in a burst of queue activations.
+		 */
+		if (bfqd->low_latency)
+			fg_launch = bfq_bfqq_fg_launch(bfqd, bfqq);
+		interactive = interactive || fg_launch;
 		entity->budget = max_t(unsigned long, bfqq->max_budget,
 				       bfq_serv_to_charge(next_rq, bfqq));
 
@@ -932,17 +1005,24 @@ static void bfq_add_request(struct request *rq)
 		if (old_wr_coeff == 1 && (interactive || soft_rt) &&
 		    (!bfq_bfqq_sync(bfqq) || bfqq->bic != NULL)) {
 			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
-			if (interactive)
+			if (fg_launch)
+				bfqq->wr_cur_max_time =
+					bfq_wr_fg_duration(bfqd);
+			else if (interactive)
 				bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
 			else
 				bfqq->wr_cur_max_time =
 					bfqd->bfq_wr_rt_max_time;
 			bfq_log_bfqq(bfqd, bfqq,
-				     "wrais starting at %lu, rais_max_time %u",
+				     "wrais starting at %lu, rais_max_time %u%s",
 				     jiffies,
-				     jiffies_to_msecs(bfqq->wr_cur_max_time));
+				     jiffies_to_msecs(bfqq->wr_cur_max_time),
+				     fg_launch ? " (foreground)" : "");
 		} else if (old_wr_coeff > 1) {
-			if (interactive)
+			if (fg_launch)
+				bfqq->wr_cur_max_time =
+					bfq_wr_fg_duration(bfqd);
+			else if (interactive)
 				bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
 			else if (coop_or_in_burst ||
 				 (bfqq->wr_cur_max_time ==
@@ -3408,10 +3488,16 @@ static void bfq_completed_request(struct request_queue *q, struct request *rq)
 	struct bfq_queue *bfqq = RQ_BFQQ(rq);
 	struct bfq_data *bfqd = bfqq->bfqd;
 	bool sync = bfq_bfqq_sync(bfqq);
+	unsigned long lat = jiffies - rq->start_time;
 
 	bfq_log_bfqq(bfqd, bfqq, "completed one req with %u sects left (%d)",
 		     blk_rq_sectors(rq), sync);
 
+	bfqq->lat_samples++;
+	bfqq->lat_total += lat;
+	if (lat > bfqq->lat_max)
+		bfqq->lat_max = lat;
+
 	bfq_update_hw_tag(bfqd);
 
 	BUG_ON(!bfqd->rq_in_driver);
@@ -3870,6 +3956,7 @@ static void *bfq_init_queue(struct request_queue *q)
 					      * high-definition compressed
 					      * video.
 					      */
+	bfqd->bfq_wr_fg_time = msecs_to_jiffies(3000);
 	bfqd->wr_busy_queues = 0;
 	bfqd->busy_in_flight_queues = 0;
 	bfqd->const_seeky_busy_in_flight_queues = 0;
@@ -3964,6 +4051,56 @@ static ssize_t bfq_weights_show(struct elevator_queue *e, char *page)
 	return num_char;
 }
 
+static int bfq_latency_show_list(struct list_head *head, char *page,
+				 int num_char)
+{
+	struct bfq_queue *bfqq;
+	u64 avg;
+
+	list_for_each_entry(bfqq, head, bfqq_list) {
+		avg = bfqq->lat_total;
+		if (bfqq->lat_samples)
+			do_div(avg, bfqq->lat_samples);
+		num_char += scnprintf(page + num_char, PAGE_SIZE - num_char,
+			"pid%d: wr_coeff %u, reqs %lu, avg %u ms, max %u ms\n",
+			bfqq->pid, bfqq->wr_coeff, bfqq->lat_samples,
+			jiffies_to_msecs((unsigned long)avg),
+			jiffies_to_msecs(bfqq->lat_max));
+	}
+
+	return num_char;
+}
+
+/*
+ * latency: submission-to-completion time of the requests of each active
+ * and idle queue, over the lifetime of the queue.
+ */
+static ssize_t bfq_latency_show(struct elevator_queue *e, char *page)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	int num_char = 0;
+
+	spin_lock_irq(bfqd->queue->queue_lock);
+
+	num_char += scnprintf(page + num_char, PAGE_SIZE - num_char,
+			      "Active:\n");
+	num_char = bfq_latency_show_list(&bfqd->active_list, page, num_char);
+	num_char += scnprintf(page + num_char, PAGE_SIZE - num_char,
+			      "Idle:\n");
+	num_char = bfq_latency_show_list(&bfqd->idle_list, page, num_char);
+
+	spin_unlock_irq(bfqd->queue->queue_lock);
+
+	return num_char;
+}
+
+static ssize_t bfq_wr_fg_cgroup_show(struct elevator_queue *e, char *page)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%s\n", bfqd->bfq_wr_fg_cgroup);
+}
+
 #define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
 static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
 {									\
@@ -3990,6 +4127,7 @@ SHOW_FUNCTION(bfq_wr_min_idle_time_show, bfqd->bfq_wr_min_idle_time, 1);
 SHOW_FUNCTION(bfq_wr_min_inter_arr_async_show, bfqd->bfq_wr_min_inter_arr_async,
 	1);
 SHOW_FUNCTION(bfq_wr_max_softrt_rate_show, bfqd->bfq_wr_max_softrt_rate, 0);
+SHOW_FUNCTION(bfq_wr_fg_time_show, bfqd->bfq_wr_fg_time, 1);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -4031,6 +4169,7 @@ STORE_FUNCTION(bfq_wr_min_inter_arr_async_store,
 		&bfqd->bfq_wr_min_inter_arr_async, 0, INT_MAX, 1);
 STORE_FUNCTION(bfq_wr_max_softrt_rate_store, &bfqd->bfq_wr_max_softrt_rate, 0,
 		INT_MAX, 0);
+STORE_FUNCTION(bfq_wr_fg_time_store, &bfqd->bfq_wr_fg_time, 0, INT_MAX, 1);
 #undef STORE_FUNCTION
 
 /* do nothing for the moment */
@@ -4089,6 +4228,22 @@ static ssize_t bfq_timeout_sync_store(struct elevator_queue *e,
 	return ret;
 }
 
+static ssize_t bfq_wr_fg_cgroup_store(struct elevator_queue *e,
+				      const char *page, size_t count)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	char path[BFQ_CGROUP_PATH_LEN];
+
+	strlcpy(path, page, sizeof(path));
+
+	spin_lock_irq(bfqd->queue->queue_lock);
+	strlcpy(bfqd->bfq_wr_fg_cgroup, strim(path),
+		sizeof(bfqd->bfq_wr_fg_cgroup));
+	spin_unlock_irq(bfqd->queue->queue_lock);
+
+	return count;
+}
+
 static ssize_t bfq_low_latency_store(struct elevator_queue *e,
 				     const char *page, size_t count)
 {
@@ -4125,7 +4280,10 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(wr_min_idle_time),
 	BFQ_ATTR(wr_min_inter_arr_async),
 	BFQ_ATTR(wr_max_softrt_rate),
+	BFQ_ATTR(wr_fg_cgroup),
+	BFQ_ATTR(wr_fg_time),
 	BFQ_ATTR(weights),
+	__ATTR(latency, S_IRUGO, bfq_latency_show, NULL),
 	__ATTR_NULL
 };
 
@@ -226,6 +226,10 @@ struct bfq_group;
  *                           backlogged
  * @bic: pointer to the bfq_io_cq owning the bfq_queue, set to %NULL if the
  *	 queue is shared
+ * @lat_samples: number of requests of the queue completed so far
+ * @lat_total: sum of the submission-to-completion times of these requests
+ *             (jiffies)
+ * @lat_max: longest of these times (jiffies)
  *
  * A bfq_queue is a leaf request queue; it can be associated with an
  * io_context or more, if it  is  async or shared  between  cooperating
@@ -281,6 +285,11 @@ struct bfq_queue {
 	unsigned int wr_coeff;
 	unsigned long last_idle_bklogged;
 	unsigned long service_from_backlogged;
+
+	/* completion latency statistics */
+	unsigned long lat_samples;
+	u64 lat_total;
+	unsigned long lat_max;
 };
 
 /**
@@ -474,6 +483,12 @@ enum bfq_device_speed {
  *				(in jiffies).
  * @bfq_wr_max_softrt_rate: max service-rate for a soft real-time queue,
  *			    sectors per seconds.
+ * @bfq_wr_fg_cgroup: cpu cgroup path of the foreground applications (as
+ *		      set by Android's ActivityManager), empty to disable
+ *		      foreground weight raising.
+ * @bfq_wr_fg_time: duration of the weight raising granted to a queue whose
+ *		    process enters @bfq_wr_fg_cgroup (0 for the duration
+ *		    used for interactive applications).
  * @RT_prod: cached value of the product R*T used for computing the maximum
  *	     duration of the weight raising automatically.
  * @device_speed: device-speed class for the low-latency heuristic.
@@ -556,6 +571,9 @@ struct bfq_data {
 	unsigned int bfq_wr_min_idle_time;
 	unsigned long bfq_wr_min_inter_arr_async;
 	unsigned int bfq_wr_max_softrt_rate;
+#define BFQ_CGROUP_PATH_LEN	64
+	char bfq_wr_fg_cgroup[BFQ_CGROUP_PATH_LEN];
+	unsigned int bfq_wr_fg_time;
 	u64 RT_prod;
 	enum bfq_device_speed device_speed;
 
@@ -590,6 +608,10 @@ enum bfqq_state_flags {
 	BFQ_BFQQ_FLAG_coop,		/* bfqq is shared */
 	BFQ_BFQQ_FLAG_split_coop,	/* shared bfqq will be split */
 	BFQ_BFQQ_FLAG_just_split,	/* queue has just been split */
+	BFQ_BFQQ_FLAG_in_fg,		/*
+					 * the process was in the foreground
+					 * cgroup at the last activation
+					 */
 };
 
 #define BFQ_BFQQ_FNS(name)						\
@@ -620,6 +642,7 @@ BFQ_BFQQ_FNS(coop);
 BFQ_BFQQ_FNS(split_coop);
 BFQ_BFQQ_FNS(just_split);
 BFQ_BFQQ_FNS(softrt_update);
+BFQ_BFQQ_FNS(in_fg);
 #undef BFQ_BFQQ_FNS
 
 /* Logging facilities. */
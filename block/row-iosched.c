@@ -26,6 +26,8 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/hrtimer.h>
+#include <linux/log2.h>
+#include <linux/cgroup.h>
 
 /*
  * enum row_queue_prio - Priorities of the ROW queues
@@ -64,18 +66,20 @@ enum row_queue_prio {
  *			in a dispatch cycle
  * @is_urgent: Flags indicating whether the queue can notify on
  *			urgent requests
+ * @target_ms: Latency target of the queue in latency mode (msec)
  *
  */
 struct row_queue_params {
 	bool idling_enabled;
 	int quantum;
 	bool is_urgent;
+	int target_ms;
 };
 
 /*
  * This array holds the default values of the different configurables
  * for each ROW queue. Each row of the array holds the following values:
- * {idling_enabled, quantum, is_urgent}
+ * {idling_enabled, quantum, is_urgent, target_ms}
  * Each row corresponds to a queue with the same index (according to
  * enum row_queue_prio)
  * Note: The quantums are valid inside their priority type. For example:
@@ -85,16 +89,23 @@ struct row_queue_params {
  *       be dispatched.
  */
 static const struct row_queue_params row_queues_def[] = {
-/* idling_enabled, quantum, is_urgent */
-	{true, 10, true},	/* ROWQ_PRIO_HIGH_READ */
-	{false, 1, false},	/* ROWQ_PRIO_HIGH_SWRITE */
-	{true, 100, true},	/* ROWQ_PRIO_REG_READ */
-	{false, 1, false},	/* ROWQ_PRIO_REG_SWRITE */
-	{false, 1, false},	/* ROWQ_PRIO_REG_WRITE */
-	{false, 1, false},	/* ROWQ_PRIO_LOW_READ */
-	{false, 1, false}	/* ROWQ_PRIO_LOW_SWRITE */
+/* idling_enabled, quantum, is_urgent, target_ms */
+	{true, 10, true, 10},		/* ROWQ_PRIO_HIGH_READ */
+	{false, 1, false, 20},		/* ROWQ_PRIO_HIGH_SWRITE */
+	{true, 100, true, 50},		/* ROWQ_PRIO_REG_READ */
+	{false, 1, false, 100},		/* ROWQ_PRIO_REG_SWRITE */
+	{false, 1, false, 500},		/* ROWQ_PRIO_REG_WRITE */
+	{false, 1, false, 1000},	/* ROWQ_PRIO_LOW_READ */
+	{false, 1, false, 2000}		/* ROWQ_PRIO_LOW_SWRITE */
 };
 
+/*
+ * Completion latency histogram buckets: bucket 0 counts requests that
+ * completed within 1ms of insertion, bucket n those within [2^(n-1), 2^n)
+ * msec, the last bucket everything slower.
+ */
+#define ROW_LAT_BUCKETS		12
+
 /* Default values for idling on read queues (in msec) */
 #define ROW_IDLE_TIME_MSEC 5
 #define ROW_READ_FREQ_MSEC 5
@@ -122,6 +133,8 @@ struct rowq_idling_data {
  * @dispatch quantum:	number of requests this queue may
  *			dispatch in a dispatch cycle
  * @idle_data:		data for idling on queues
+ * @target_ms:		latency target in latency mode (msec)
+ * @lat_hist:		completion latency histogram, see ROW_LAT_BUCKETS
  *
  */
 struct row_queue {
@@ -136,6 +149,9 @@ struct row_queue {
 
 	/* used only for READ queues */
 	struct rowq_idling_data	idle_data;
+
+	int			target_ms;
+	unsigned long		lat_hist[ROW_LAT_BUCKETS];
 };
 
 /**
@@ -187,6 +203,11 @@ struct starvation_data {
  * @reg_prio_starvation: starvation data for REGULAR priority queues
  * @low_prio_starvation: starvation data for LOW priority queues
  * @cycle_flags:	used for marking unserved queueus
+ * @latency_mode:	when set, a queue whose oldest request is past its
+ *			latency target is served before anything else
+ * @bg_cgroup:		cpu cgroup path whose tasks' requests without an
+ *			explicit ioprio go to the LOW priority queues,
+ *			empty to disable
  *
  */
 struct row_data {
@@ -206,10 +227,26 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+	int				latency_mode;
+#define ROW_CGROUP_PATH_LEN	64
+	char				bg_cgroup[ROW_CGROUP_PATH_LEN];
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
 
+/*
+ * Insertion time of the request in usec, truncated to unsigned long.
+ * Only differences are ever used, so wrapping is harmless. Kept in
+ * elv.priv[1] since fifo_time shares storage with the completion csd.
+ */
+#define RQ_INSERT_US(rq) ((unsigned long) ((rq)->elv.priv[1]))
+#define rq_set_insert_us(rq, us) ((rq)->elv.priv[1] = (void *) (us))
+
+static inline unsigned long row_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
+
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
 #define row_log_rowq(rdata, rowq_id, fmt, args...)		\
@@ -336,6 +373,7 @@ static void row_add_request(struct request_queue *q,
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rqueue->nr_req++;
 	rq_set_fifo_time(rq, jiffies); /* for statistics*/
+	rq_set_insert_us(rq, row_now_us());
 
 	if (rq->cmd_flags & REQ_URGENT) {
 		WARN_ON(1);
@@ -449,10 +487,27 @@ static int row_reinsert_req(struct request_queue *q,
 	return 0;
 }
 
+static void row_account_latency(struct request *rq)
+{
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+	long lat_ms;
+	int bucket = 0;
+
+	if (!rqueue)
+		return;
+
+	lat_ms = (long)(row_now_us() - RQ_INSERT_US(rq)) / USEC_PER_MSEC;
+	if (lat_ms > 0)
+		bucket = min_t(int, ilog2(lat_ms) + 1, ROW_LAT_BUCKETS - 1);
+	rqueue->lat_hist[bucket]++;
+}
+
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
 
+	row_account_latency(rq);
+
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
 			WARN_ON(1);
@@ -654,6 +709,42 @@ done:
 	return ret;
 }
 
+/*
+ * row_get_expired_queue() - Find the queue furthest past its latency target
+ * @rd:	pointer to struct row_data
+ *
+ * Only used in latency mode. The oldest request of a queue is at the head
+ * of its fifo, so comparing the heads is enough.
+ *
+ * Return index of the queue to dispatch from, -1 if no queue is late.
+ */
+static int row_get_expired_queue(struct row_data *rd)
+{
+	unsigned long now = row_now_us();
+	long lateness, max_lateness = 0;
+	int i, ret = -1;
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		struct row_queue *rqueue = &rd->row_queues[i];
+		struct request *rq;
+
+		if (list_empty(&rqueue->fifo))
+			continue;
+		rq = rq_entry_fifo(rqueue->fifo.next);
+		lateness = (long)(now - RQ_INSERT_US(rq)) -
+			(long)rqueue->target_ms * USEC_PER_MSEC;
+		if (lateness > max_lateness) {
+			max_lateness = lateness;
+			ret = i;
+		}
+	}
+
+	if (ret >= 0)
+		row_log_rowq(rd, ret, "%ldus past latency target",
+			max_lateness);
+	return ret;
+}
+
 static void row_restart_cycle(struct row_data *rd,
 				int start_idx, int end_idx)
 {
@@ -737,6 +828,21 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 		goto done;
 	}
 
+	if (rd->latency_mode) {
+		currq = row_get_expired_queue(rd);
+		if (currq >= 0) {
+			if (hrtimer_active(&rd->rd_idle_data.hr_timer) &&
+			    hrtimer_try_to_cancel(
+					&rd->rd_idle_data.hr_timer) >= 0)
+				rd->rd_idle_data.idling_queue_idx =
+					ROWQ_MAX_PRIO;
+			row_dispatch_insert(rd,
+				rq_entry_fifo(rd->row_queues[currq].fifo.next));
+			ret = 1;
+			goto done;
+		}
+	}
+
 	ioprio_class_to_serve = row_get_ioprio_class_to_serve(rd, force);
 	row_log(rd->dispatch_queue, "Dispatching from %d priority class",
 		ioprio_class_to_serve);
@@ -797,6 +903,7 @@ static void *row_init_queue(struct request_queue *q)
 	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
 		INIT_LIST_HEAD(&rdata->row_queues[i].fifo);
 		rdata->row_queues[i].disp_quantum = row_queues_def[i].quantum;
+		rdata->row_queues[i].target_ms = row_queues_def[i].target_ms;
 		rdata->row_queues[i].rdata = rdata;
 		rdata->row_queues[i].prio = i;
 		rdata->row_queues[i].idle_data.begin_idling = false;
@@ -823,6 +930,10 @@ static void *row_init_queue(struct request_queue *q)
 	rdata->last_served_ioprio_class = IOPRIO_CLASS_NONE;
 	rdata->rd_idle_data.idling_queue_idx = ROWQ_MAX_PRIO;
 	rdata->dispatch_queue = q;
+#ifdef CONFIG_CGROUP_SCHED
+	strlcpy(rdata->bg_cgroup, "/bg_non_interactive",
+		sizeof(rdata->bg_cgroup));
+#endif
 
 	return rdata;
 }
@@ -868,6 +979,39 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 	rqueue->rdata->nr_reqs[rq_data_dir(rq)]--;
 }
 
+#ifdef CONFIG_CGROUP_SCHED
+/*
+ * row_task_in_bg_cgroup() - Check whether a task runs in the background
+ *			     cpu cgroup (as Android's bg_non_interactive)
+ * @rd:		pointer to struct row_data
+ * @tsk:	the task to check
+ *
+ * Called with the queue lock held.
+ */
+static bool row_task_in_bg_cgroup(struct row_data *rd, struct task_struct *tsk)
+{
+	char path[ROW_CGROUP_PATH_LEN];
+	bool ret = false;
+
+	if (!rd->bg_cgroup[0])
+		return false;
+
+	rcu_read_lock();
+	if (!cgroup_path(task_cgroup(tsk, cpu_cgroup_subsys_id),
+			 path, sizeof(path)))
+		ret = !strcmp(path, rd->bg_cgroup);
+	rcu_read_unlock();
+
+	return ret;
+}
+#else
+static inline bool row_task_in_bg_cgroup(struct row_data *rd,
+					 struct task_struct *tsk)
+{
+	return false;
+}
+#endif
+
 /*
  * row_get_queue_prio() - Get queue priority for a given request
  *
@@ -884,6 +1028,15 @@ static enum row_queue_prio row_get_queue_prio(struct request *rq,
 	enum row_queue_prio q_type = ROWQ_MAX_PRIO;
 	int ioprio_class = IOPRIO_PRIO_CLASS(rq->elv.icq->ioc->ioprio);
 
+	/*
+	 * Without an explicit ioprio, background apps are demoted to the
+	 * IDLE class so foreground I/O is served first.
+	 */
+	if ((ioprio_class == IOPRIO_CLASS_NONE ||
+	     ioprio_class == IOPRIO_CLASS_BE) &&
+	    row_task_in_bg_cgroup(rd, current))
+		ioprio_class = IOPRIO_CLASS_IDLE;
+
 	switch (ioprio_class) {
 	case IOPRIO_CLASS_RT:
 		if (data_dir == READ)
@@ -984,6 +1137,21 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+SHOW_FUNCTION(row_latency_mode_show, rowd->latency_mode);
+SHOW_FUNCTION(row_hp_read_target_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_READ].target_ms);
+SHOW_FUNCTION(row_hp_swrite_target_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].target_ms);
+SHOW_FUNCTION(row_rp_read_target_show,
+	rowd->row_queues[ROWQ_PRIO_REG_READ].target_ms);
+SHOW_FUNCTION(row_rp_swrite_target_show,
+	rowd->row_queues[ROWQ_PRIO_REG_SWRITE].target_ms);
+SHOW_FUNCTION(row_rp_write_target_show,
+	rowd->row_queues[ROWQ_PRIO_REG_WRITE].target_ms);
+SHOW_FUNCTION(row_lp_read_target_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_READ].target_ms);
+SHOW_FUNCTION(row_lp_swrite_target_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].target_ms);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -1030,9 +1198,73 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+STORE_FUNCTION(row_latency_mode_store, &rowd->latency_mode, 0, 1);
+STORE_FUNCTION(row_hp_read_target_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_READ].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_hp_swrite_target_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_SWRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_rp_read_target_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_READ].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_rp_swrite_target_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_SWRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_rp_write_target_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_WRITE].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_lp_read_target_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_READ].target_ms,
+			1, INT_MAX);
+STORE_FUNCTION(row_lp_swrite_target_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_SWRITE].target_ms,
+			1, INT_MAX);
 
 #undef STORE_FUNCTION
 
+static ssize_t row_bg_cgroup_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rowd = e->elevator_data;
+
+	return snprintf(page, PAGE_SIZE, "%s\n", rowd->bg_cgroup);
+}
+
+static ssize_t row_bg_cgroup_store(struct elevator_queue *e,
+				   const char *page, size_t count)
+{
+	struct row_data *rowd = e->elevator_data;
+	char path[ROW_CGROUP_PATH_LEN];
+
+	strlcpy(path, page, sizeof(path));
+
+	spin_lock_irq(rowd->dispatch_queue->queue_lock);
+	strlcpy(rowd->bg_cgroup, strim(path), sizeof(rowd->bg_cgroup));
+	spin_unlock_irq(rowd->dispatch_queue->queue_lock);
+
+	return count;
+}
+
+/*
+ * latency_hist: one line per queue, in enum row_queue_prio order, with the
+ * completion counts of each ROW_LAT_BUCKETS bucket.
+ */
+static ssize_t row_latency_hist_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rowd = e->elevator_data;
+	ssize_t len = 0;
+	int i, j;
+
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		len += scnprintf(page + len, PAGE_SIZE - len, "rowq%d:", i);
+		for (j = 0; j < ROW_LAT_BUCKETS; j++)
+			len += scnprintf(page + len, PAGE_SIZE - len, " %lu",
+					 rowd->row_queues[i].lat_hist[j]);
+		len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+	}
+	return len;
+}
+
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
@@ -1049,6 +1281,16 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(latency_mode),
+	ROW_ATTR(hp_read_target),
+	ROW_ATTR(hp_swrite_target),
+	ROW_ATTR(rp_read_target),
+	ROW_ATTR(rp_swrite_target),
+	ROW_ATTR(rp_write_target),
+	ROW_ATTR(lp_read_target),
+	ROW_ATTR(lp_swrite_target),
+	ROW_ATTR(bg_cgroup),
+	__ATTR(latency_hist, S_IRUGO, row_latency_hist_show, NULL),
 	__ATTR_NULL
 };
 
@@ -27,6 +27,10 @@
 #include <linux/debugfs.h>
 #include <linux/test-iosched.h>
 #include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/random.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
 #include "blk.h"
 
 #define MODULE_NAME "test-iosched"
@@ -1240,6 +1244,574 @@ exit:
 	return ret;
 }
 
+/*
+ * Benchmark scenarios
+ *
+ * The tests above need test-iosched to be the scheduler of the device under
+ * test, so they cannot tell how another scheduler would have served the same
+ * requests. The benchmark submits bios to any block device from kernel
+ * threads instead, so that one seeded mix of workloads can be replayed under
+ * row, cfq, bfq or deadline on the same device and the results compared:
+ *
+ * launch_read:	bursts of random sync reads of 4KB up to kb, as seen when an
+ *		application starts
+ * fsync_write:	transactions of burst random 4KB sync writes followed by a
+ *		cache flush, as issued by sqlite
+ * seq_write:	back to back sequential writes of kb, as issued by background
+ *		writeback
+ *
+ * Latencies are per read for launch_read, per transaction for fsync_write
+ * and per write for seq_write. The device is opened exclusively and only
+ * sectors in [start_sector, start_sector + nr_sectors) are touched, so a
+ * device or partition with a mounted file system is refused.
+ */
+enum bench_class {
+	BENCH_LAUNCH_READ,
+	BENCH_FSYNC_WRITE,
+	BENCH_SEQ_WRITE,
+	BENCH_NR_CLASSES,
+};
+
+#define BENCH_MAX_THREADS	8
+#define BENCH_MAX_KB		512
+#define BENCH_MAX_PAGES		(BENCH_MAX_KB / (PAGE_SIZE >> 10))
+#define BENCH_MAX_SAMPLES	65536
+#define BENCH_REPORT_SIZE	1024
+
+static const char * const bench_class_name[BENCH_NR_CLASSES] = {
+	"launch_read",
+	"fsync_write",
+	"seq_write",
+};
+
+/**
+ * struct bench_class_cfg - workload of one benchmark class
+ * @threads:	Number of threads issuing the workload, 0 disables it
+ * @kb:		Request size in KB
+ * @burst:	Reads per burst, or writes per flush
+ * @think_ms:	Pause between bursts or transactions
+ */
+struct bench_class_cfg {
+	u32 threads;
+	u32 kb;
+	u32 burst;
+	u32 think_ms;
+};
+
+/**
+ * struct bench_class_res - results of one benchmark class
+ * @lock:	Protects the fields below
+ * @lat_us:	Latency samples. Once full, new samples replace random old
+ *		ones so that they stay representative of the whole run
+ * @nr_samples:	Number of valid entries in @lat_us
+ * @ops:	Number of latencies measured
+ * @bytes:	Bytes transferred
+ * @errors:	Failed requests
+ */
+struct bench_class_res {
+	spinlock_t lock;
+	u32 *lat_us;
+	u32 nr_samples;
+	u64 ops;
+	u64 bytes;
+	u32 errors;
+};
+
+struct bench_data {
+	struct mutex lock;
+	struct dentry *root;
+	u32 dev_major;
+	u32 dev_minor;
+	u32 start_sector;
+	u32 nr_sectors;
+	u32 duration_ms;
+	u32 seed;
+	struct bench_class_cfg cfg[BENCH_NR_CLASSES];
+	struct bench_class_res res[BENCH_NR_CLASSES];
+	struct block_device *bdev;
+	char report[BENCH_REPORT_SIZE];
+};
+
+struct bench_thread {
+	struct bench_data *bd;
+	enum bench_class class;
+	struct task_struct *task;
+	struct rnd_state rnd;
+	sector_t seq_start;
+	sector_t seq_end;
+	sector_t seq_pos;
+	struct page *pages[BENCH_MAX_PAGES];
+};
+
+struct bench_bio_wait {
+	struct completion done;
+	int err;
+};
+
+static struct bench_data *pbd;
+
+static void bench_end_io(struct bio *bio, int err)
+{
+	struct bench_bio_wait *wait = bio->bi_private;
+
+	wait->err = err;
+	complete(&wait->done);
+}
+
+/* Submit one bio of @nr_pages (none for a flush) and wait for it */
+static int bench_submit_wait(struct bench_thread *bt, int rw, sector_t sector,
+			     unsigned int nr_pages)
+{
+	struct bench_bio_wait wait;
+	struct bio *bio;
+	unsigned int i;
+
+	bio = bio_alloc(GFP_KERNEL, nr_pages);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_bdev = bt->bd->bdev;
+	bio->bi_sector = sector;
+	bio->bi_end_io = bench_end_io;
+	bio->bi_private = &wait;
+	for (i = 0; i < nr_pages; i++)
+		if (bio_add_page(bio, bt->pages[i], PAGE_SIZE, 0) < PAGE_SIZE)
+			break;
+
+	init_completion(&wait.done);
+	submit_bio(rw, bio);
+	wait_for_completion(&wait.done);
+	bio_put(bio);
+
+	return wait.err;
+}
+
+static void bench_account(struct bench_thread *bt, ktime_t start, int err,
+			  unsigned int bytes)
+{
+	struct bench_class_res *res = &bt->bd->res[bt->class];
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	u32 slot;
+
+	spin_lock(&res->lock);
+	if (err) {
+		res->errors++;
+		goto out;
+	}
+
+	res->ops++;
+	res->bytes += bytes;
+	if (res->nr_samples < BENCH_MAX_SAMPLES) {
+		res->lat_us[res->nr_samples++] = us;
+	} else {
+		slot = (res->ops * prandom_u32_state(&bt->rnd)) >> 32;
+		if (slot < BENCH_MAX_SAMPLES)
+			res->lat_us[slot] = us;
+	}
+out:
+	spin_unlock(&res->lock);
+}
+
+/* A random, @nr_sects long and page aligned position in the test range */
+static sector_t bench_rand_sector(struct bench_thread *bt,
+				  unsigned int nr_sects)
+{
+	struct bench_data *bd = bt->bd;
+	u32 sects_per_page = PAGE_SIZE >> 9;
+	u32 slots = (bd->nr_sectors - nr_sects) / sects_per_page + 1;
+
+	return bd->start_sector +
+		(prandom_u32_state(&bt->rnd) % slots) * sects_per_page;
+}
+
+static void bench_launch_read(struct bench_thread *bt)
+{
+	struct bench_class_cfg *cfg = &bt->bd->cfg[bt->class];
+	unsigned int max_pages = cfg->kb / (PAGE_SIZE >> 10);
+	unsigned int nr_pages;
+	ktime_t start;
+	int i, err;
+
+	for (i = 0; i < cfg->burst && !kthread_should_stop(); i++) {
+		nr_pages = 1 + prandom_u32_state(&bt->rnd) % max_pages;
+		start = ktime_get();
+		err = bench_submit_wait(bt, READ_SYNC,
+			bench_rand_sector(bt, nr_pages * (PAGE_SIZE >> 9)),
+			nr_pages);
+		bench_account(bt, start, err, nr_pages * PAGE_SIZE);
+	}
+}
+
+static void bench_fsync_write(struct bench_thread *bt)
+{
+	struct bench_class_cfg *cfg = &bt->bd->cfg[bt->class];
+	ktime_t start = ktime_get();
+	int i, err = 0;
+
+	for (i = 0; i < cfg->burst && !err; i++)
+		err = bench_submit_wait(bt, WRITE_SYNC,
+			bench_rand_sector(bt, PAGE_SIZE >> 9), 1);
+	if (!err)
+		err = bench_submit_wait(bt, WRITE_FLUSH, 0, 0);
+	bench_account(bt, start, err, cfg->burst * PAGE_SIZE);
+}
+
+static void bench_seq_write(struct bench_thread *bt)
+{
+	struct bench_class_cfg *cfg = &bt->bd->cfg[bt->class];
+	unsigned int nr_pages = cfg->kb / (PAGE_SIZE >> 10);
+	unsigned int nr_sects = nr_pages * (PAGE_SIZE >> 9);
+	ktime_t start;
+	int err;
+
+	if (bt->seq_pos + nr_sects > bt->seq_end)
+		bt->seq_pos = bt->seq_start;
+
+	start = ktime_get();
+	err = bench_submit_wait(bt, WRITE, bt->seq_pos, nr_pages);
+	bench_account(bt, start, err, nr_pages * PAGE_SIZE);
+	bt->seq_pos += nr_sects;
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *bt = data;
+	struct bench_class_cfg *cfg = &bt->bd->cfg[bt->class];
+
+	while (!kthread_should_stop()) {
+		switch (bt->class) {
+		case BENCH_LAUNCH_READ:
+			bench_launch_read(bt);
+			break;
+		case BENCH_FSYNC_WRITE:
+			bench_fsync_write(bt);
+			break;
+		default:
+			bench_seq_write(bt);
+			break;
+		}
+		if (cfg->think_ms)
+			schedule_timeout_interruptible(
+				msecs_to_jiffies(cfg->think_ms));
+		else
+			cond_resched();
+	}
+
+	return 0;
+}
+
+static void bench_free_thread(struct bench_thread *bt)
+{
+	int i;
+
+	for (i = 0; i < BENCH_MAX_PAGES; i++)
+		if (bt->pages[i])
+			__free_page(bt->pages[i]);
+	kfree(bt);
+}
+
+static struct bench_thread *bench_create_thread(struct bench_data *bd,
+						enum bench_class class, int idx)
+{
+	struct bench_class_cfg *cfg = &bd->cfg[class];
+	u32 slice = bd->nr_sectors / cfg->threads;
+	struct bench_thread *bt;
+	int i;
+
+	bt = kzalloc(sizeof(*bt), GFP_KERNEL);
+	if (!bt)
+		return NULL;
+
+	bt->bd = bd;
+	bt->class = class;
+	prandom_seed_state(&bt->rnd,
+			   bd->seed + class * BENCH_MAX_THREADS + idx);
+	/* every sequential writer streams through its own slice */
+	bt->seq_start = bd->start_sector + idx * slice;
+	bt->seq_end = bt->seq_start + slice;
+	bt->seq_pos = bt->seq_start;
+
+	/* zeroed, so that no kernel memory ends up on the device */
+	for (i = 0; i < cfg->kb / (PAGE_SIZE >> 10); i++) {
+		bt->pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+		if (!bt->pages[i])
+			goto err;
+	}
+
+	bt->task = kthread_create(bench_thread_fn, bt, "bench_%s/%d",
+				  bench_class_name[class], idx);
+	if (IS_ERR(bt->task))
+		goto err;
+
+	return bt;
+
+err:
+	bench_free_thread(bt);
+	return NULL;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_report(struct bench_data *bd, const char *elevator,
+			 unsigned int elapsed_ms)
+{
+	struct bench_class_res *res;
+	char *buf = bd->report;
+	int len, i;
+	u32 n;
+
+	len = scnprintf(buf, BENCH_REPORT_SIZE,
+			"scheduler: %s, %u ms, seed %u\n"
+			"%-12s %8s %8s %8s %8s %8s %6s\n", elevator,
+			elapsed_ms, bd->seed, "class", "ops", "KB/s",
+			"p50(us)", "p99(us)", "max(us)", "errors");
+
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		if (!bd->cfg[i].threads)
+			continue;
+
+		res = &bd->res[i];
+		n = res->nr_samples;
+		sort(res->lat_us, n, sizeof(u32), bench_cmp_u32, NULL);
+		len += scnprintf(buf + len, BENCH_REPORT_SIZE - len,
+				 "%-12s %8llu %8llu %8u %8u %8u %6u\n",
+				 bench_class_name[i], res->ops,
+				 div64_u64(res->bytes, max(elapsed_ms, 1U)) *
+					1000 >> 10,
+				 n ? res->lat_us[n / 2] : 0,
+				 n ? res->lat_us[n * 99 / 100] : 0,
+				 n ? res->lat_us[n - 1] : 0, res->errors);
+	}
+}
+
+static int bench_check_config(struct bench_data *bd)
+{
+	struct bench_class_cfg *cfg;
+	int i;
+
+	if (!bd->nr_sectors || !bd->duration_ms)
+		return -EINVAL;
+
+	if ((u64)bd->start_sector + bd->nr_sectors >
+	    i_size_read(bd->bdev->bd_inode) >> 9)
+		return -EINVAL;
+
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		cfg = &bd->cfg[i];
+		if (!cfg->threads)
+			continue;
+		if (cfg->threads > BENCH_MAX_THREADS ||
+		    cfg->kb < (PAGE_SIZE >> 10) || cfg->kb > BENCH_MAX_KB ||
+		    (cfg->kb << 1) > bd->nr_sectors / cfg->threads ||
+		    (i != BENCH_SEQ_WRITE && !cfg->burst))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int bench_run(struct bench_data *bd)
+{
+	struct bench_thread *bt[BENCH_NR_CLASSES * BENCH_MAX_THREADS];
+	char elevator[ELV_NAME_MAX] = "none";
+	struct request_queue *q;
+	int nr_threads = 0;
+	ktime_t start = ktime_get();
+	int i, j, ret;
+
+	bd->bdev = blkdev_get_by_dev(MKDEV(bd->dev_major, bd->dev_minor),
+				     FMODE_READ | FMODE_WRITE | FMODE_EXCL, bd);
+	if (IS_ERR(bd->bdev)) {
+		ret = PTR_ERR(bd->bdev);
+		test_pr_err("%s: cannot open %u:%u exclusively, err=%d",
+			    __func__, bd->dev_major, bd->dev_minor, ret);
+		return ret;
+	}
+
+	ret = bench_check_config(bd);
+	if (ret) {
+		test_pr_err("%s: invalid benchmark configuration", __func__);
+		goto put_bdev;
+	}
+
+	q = bdev_get_queue(bd->bdev);
+	if (q && q->elevator)
+		strlcpy(elevator, q->elevator->type->elevator_name,
+			sizeof(elevator));
+
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		memset(bd->res[i].lat_us, 0, BENCH_MAX_SAMPLES * sizeof(u32));
+		bd->res[i].nr_samples = 0;
+		bd->res[i].ops = 0;
+		bd->res[i].bytes = 0;
+		bd->res[i].errors = 0;
+
+		for (j = 0; j < bd->cfg[i].threads; j++) {
+			bt[nr_threads] = bench_create_thread(bd, i, j);
+			if (!bt[nr_threads]) {
+				ret = -ENOMEM;
+				goto stop_threads;
+			}
+			nr_threads++;
+		}
+	}
+
+	test_pr_info("%s: %d threads on %u:%u under %s for %u ms", __func__,
+		     nr_threads, bd->dev_major, bd->dev_minor, elevator,
+		     bd->duration_ms);
+
+	start = ktime_get();
+	for (i = 0; i < nr_threads; i++)
+		wake_up_process(bt[i]->task);
+	msleep_interruptible(bd->duration_ms);
+
+stop_threads:
+	for (i = 0; i < nr_threads; i++) {
+		kthread_stop(bt[i]->task);
+		bench_free_thread(bt[i]);
+	}
+
+	if (!ret) {
+		bench_report(bd, elevator,
+			     ktime_to_ms(ktime_sub(ktime_get(), start)));
+		test_pr_info("%s: done\n%s", __func__, bd->report);
+	}
+
+put_bdev:
+	blkdev_put(bd->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	bd->bdev = NULL;
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	int ret;
+
+	mutex_lock(&pbd->lock);
+	ret = bench_run(pbd);
+	mutex_unlock(&pbd->lock);
+
+	return ret ? ret : count;
+}
+
+static ssize_t bench_run_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&pbd->lock);
+	ret = simple_read_from_buffer(buf, count, ppos, pbd->report,
+				      strnlen(pbd->report, BENCH_REPORT_SIZE));
+	mutex_unlock(&pbd->lock);
+
+	return ret;
+}
+
+static const struct file_operations bench_run_ops = {
+	.write = bench_run_write,
+	.read = bench_run_read,
+};
+
+static int bench_debugfs_init(struct bench_data *bd)
+{
+	struct dentry *dir;
+	int i;
+
+	bd->root = debugfs_create_dir("test-iosched-bench", NULL);
+	if (!bd->root)
+		return -ENOENT;
+
+	if (!debugfs_create_u32("dev_major", S_IRUGO | S_IWUSR, bd->root,
+				&bd->dev_major) ||
+	    !debugfs_create_u32("dev_minor", S_IRUGO | S_IWUSR, bd->root,
+				&bd->dev_minor) ||
+	    !debugfs_create_u32("start_sector", S_IRUGO | S_IWUSR, bd->root,
+				&bd->start_sector) ||
+	    !debugfs_create_u32("nr_sectors", S_IRUGO | S_IWUSR, bd->root,
+				&bd->nr_sectors) ||
+	    !debugfs_create_u32("duration_ms", S_IRUGO | S_IWUSR, bd->root,
+				&bd->duration_ms) ||
+	    !debugfs_create_u32("seed", S_IRUGO | S_IWUSR, bd->root,
+				&bd->seed) ||
+	    !debugfs_create_file("run", S_IRUGO | S_IWUSR, bd->root, NULL,
+				 &bench_run_ops))
+		goto err;
+
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		dir = debugfs_create_dir(bench_class_name[i], bd->root);
+		if (!dir ||
+		    !debugfs_create_u32("threads", S_IRUGO | S_IWUSR, dir,
+					&bd->cfg[i].threads) ||
+		    !debugfs_create_u32("kb", S_IRUGO | S_IWUSR, dir,
+					&bd->cfg[i].kb) ||
+		    !debugfs_create_u32("burst", S_IRUGO | S_IWUSR, dir,
+					&bd->cfg[i].burst) ||
+		    !debugfs_create_u32("think_ms", S_IRUGO | S_IWUSR, dir,
+					&bd->cfg[i].think_ms))
+			goto err;
+	}
+
+	return 0;
+
+err:
+	debugfs_remove_recursive(bd->root);
+	return -ENOENT;
+}
+
+static void bench_exit(void)
+{
+	int i;
+
+	if (!pbd)
+		return;
+
+	debugfs_remove_recursive(pbd->root);
+	for (i = 0; i < BENCH_NR_CLASSES; i++)
+		vfree(pbd->res[i].lat_us);
+	kfree(pbd);
+	pbd = NULL;
+}
+
+static int bench_init(void)
+{
+	static const struct bench_class_cfg defaults[BENCH_NR_CLASSES] = {
+		[BENCH_LAUNCH_READ] = { 1, 64, 32, 200 },
+		[BENCH_FSYNC_WRITE] = { 1, 4, 2, 20 },
+		[BENCH_SEQ_WRITE] = { 1, 512, 1, 0 },
+	};
+	int i;
+
+	pbd = kzalloc(sizeof(*pbd), GFP_KERNEL);
+	if (!pbd)
+		return -ENOMEM;
+
+	mutex_init(&pbd->lock);
+	pbd->duration_ms = 30000;
+	pbd->seed = 1;
+	memcpy(pbd->cfg, defaults, sizeof(defaults));
+	for (i = 0; i < BENCH_NR_CLASSES; i++) {
+		spin_lock_init(&pbd->res[i].lock);
+		pbd->res[i].lat_us = vmalloc(BENCH_MAX_SAMPLES * sizeof(u32));
+		if (!pbd->res[i].lat_us)
+			goto err;
+	}
+
+	if (bench_debugfs_init(pbd))
+		goto err;
+
+	return 0;
+
+err:
+	bench_exit();
+	return -ENOMEM;
+}
+
 static struct elevator_type elevator_test_iosched = {
 
 	.ops = {
@@ -1260,12 +1832,15 @@ static struct elevator_type elevator_test_iosched = {
 static int __init test_init(void)
 {
 	elv_register(&elevator_test_iosched);
+	if (bench_init())
+		test_pr_err("%s: benchmark not available", __func__);
 
 	return 0;
 }
 
 static void __exit test_exit(void)
 {
+	bench_exit();
 	elv_unregister(&elevator_test_iosched);
 }
 
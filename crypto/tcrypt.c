@@ -141,6 +141,9 @@ out:
 
 static u32 block_sizes[] = { 16, 64, 256, 1024, 8192, 0 };
 
+/* dm-crypt submits one sector per request */
+static u32 sector_sizes[] = { 512, 1024, 2048, 4096, 0 };
+
 static void test_cipher_speed(const char *algo, int enc, unsigned int sec,
 			      struct cipher_speed_template *template,
 			      unsigned int tcount, u8 *keysize)
@@ -805,9 +808,10 @@ out:
 	return ret;
 }
 
-static void test_acipher_speed(const char *algo, int enc, unsigned int sec,
-			       struct cipher_speed_template *template,
-			       unsigned int tcount, u8 *keysize)
+static void __test_acipher_speed(const char *algo, int enc, unsigned int sec,
+				 struct cipher_speed_template *template,
+				 unsigned int tcount, u8 *keysize,
+				 u32 *b_sizes)
 {
 	unsigned int ret, i, j, iv_len;
 	struct tcrypt_result tresult;
@@ -847,7 +851,7 @@ static void test_acipher_speed(const char *algo, int enc, unsigned int sec,
 
 	i = 0;
 	do {
-		b_size = block_sizes;
+		b_size = b_sizes;
 
 		do {
 			struct scatterlist sg[TVMEMSIZE];
@@ -920,6 +924,30 @@ out:
 	crypto_free_ablkcipher(tfm);
 }
 
+static void test_acipher_speed(const char *algo, int enc, unsigned int sec,
+			       struct cipher_speed_template *template,
+			       unsigned int tcount, u8 *keysize)
+{
+	__test_acipher_speed(algo, enc, sec, template, tcount, keysize,
+			     block_sizes);
+}
+
+/*
+ * Compare the implementations of a disk encryption mode, by driver name,
+ * on sector sized requests.  Drivers that aren't present are reported and
+ * skipped.
+ */
+static void test_sector_speed(const char * const *drivers, unsigned int sec,
+			      u8 *keysize)
+{
+	for (; *drivers; drivers++) {
+		__test_acipher_speed(*drivers, ENCRYPT, sec, NULL, 0, keysize,
+				     sector_sizes);
+		__test_acipher_speed(*drivers, DECRYPT, sec, NULL, 0, keysize,
+				     sector_sizes);
+	}
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1423,6 +1451,10 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		test_hash_speed("crc32c", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1572,6 +1604,21 @@ static int do_test(int m)
 				   speed_template_32_64);
 		break;
 
+	case 504: {
+		static const char * const cbc_drivers[] = {
+			"cbc-aes-neonbs", "qcrypto-cbc-aes", "cbc(aes-asm)",
+			"cbc(aes-generic)", NULL
+		};
+		static const char * const xts_drivers[] = {
+			"xts-aes-neonbs", "qcrypto-xts-aes", "xts(aes-asm)",
+			"xts(aes-generic)", NULL
+		};
+
+		test_sector_speed(cbc_drivers, sec, speed_template_16_32);
+		test_sector_speed(xts_drivers, sec, speed_template_32_64);
+		break;
+	}
+
 	case 1000:
 		test_available();
 		break;
@@ -637,11 +637,13 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	char *info = NULL;
 	int error = 0;
 	struct dpm_watchdog wd;
+	ktime_t starttime;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
 	dpm_wait(dev->parent, async);
+	starttime = ktime_get();
 	device_lock(dev);
 
 	/*
@@ -702,6 +704,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
  Unlock:
 	device_unlock(dev);
 	dpm_wd_clear(&wd);
+	suspend_time_device_resumed(dev, ktime_sub(ktime_get(), starttime),
+				    async);
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -740,6 +744,7 @@ void dpm_resume(pm_message_t state)
 
 	might_sleep();
 
+	suspend_time_resume_start();
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
@@ -776,6 +781,7 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_time_resume_end();
 	dpm_show_time(starttime, state, NULL);
 }
 
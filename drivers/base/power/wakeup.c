@@ -714,6 +714,72 @@ void pm_get_active_wakeup_sources(char *pending_wakeup_source, size_t max)
 }
 EXPORT_SYMBOL_GPL(pm_get_active_wakeup_sources);
 
+/* Total active time of @ws up to @now, called with ws->lock held. */
+static ktime_t wakeup_source_total_time(struct wakeup_source *ws, ktime_t now)
+{
+	if (ws->active)
+		return ktime_add(ws->total_time, ktime_sub(now, ws->last_time));
+	return ws->total_time;
+}
+
+/**
+ * pm_wakeup_cost_start - Open a wakeup cost accounting window.
+ *
+ * Called on resume.  Records the active time of every wakeup source so that
+ * pm_wakeup_cost_end() can tell how long each one was held while awake.
+ */
+void pm_wakeup_cost_start(void)
+{
+	struct wakeup_source *ws;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		ws->cost_time = wakeup_source_total_time(ws, now);
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+	rcu_read_unlock();
+}
+
+/**
+ * pm_wakeup_cost_end - Charge the CPU time of an awake period.
+ * @cpu_us: CPU time, in microseconds, consumed since pm_wakeup_cost_start().
+ *
+ * Called before the next suspend.  @cpu_us is split between the wakeup
+ * sources in proportion to how long each of them was held in the window and
+ * added to their cpu_cost.  Sources registered in the middle of the window
+ * are charged for their whole active time.
+ */
+void pm_wakeup_cost_end(u64 cpu_us)
+{
+	struct wakeup_source *ws;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	u64 held_total = 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		/* reuse cost_time for the time held in this window */
+		ws->cost_time = ktime_sub(wakeup_source_total_time(ws, now),
+					  ws->cost_time);
+		held_total += ktime_to_ms(ws->cost_time);
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		spin_lock_irqsave(&ws->lock, flags);
+		if (held_total)
+			ws->cpu_cost += div64_u64(cpu_us *
+					ktime_to_ms(ws->cost_time), held_total);
+		ws->cost_time = ktime_set(0, 0);
+		spin_unlock_irqrestore(&ws->lock, flags);
+	}
+	rcu_read_unlock();
+}
+
 static void print_active_wakeup_sources(void)
 {
 	struct wakeup_source *ws;
@@ -898,12 +964,13 @@ static int print_wakeup_source_stats(struct seq_file *m,
 	}
 
 	ret = seq_printf(m, "%-12s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t"
-			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
+			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\t\t%llu\n",
 			ws->name, active_count, ws->event_count,
 			ws->wakeup_count, ws->expire_count,
 			ktime_to_ms(active_time), ktime_to_ms(total_time),
 			ktime_to_ms(max_time), ktime_to_ms(ws->last_time),
-			ktime_to_ms(prevent_sleep_time));
+			ktime_to_ms(prevent_sleep_time),
+			div_u64(ws->cpu_cost, USEC_PER_MSEC));
 
 	spin_unlock_irqrestore(&ws->lock, flags);
 
@@ -920,7 +987,7 @@ static int wakeup_sources_stats_show(struct seq_file *m, void *unused)
 
 	seq_puts(m, "name\t\tactive_count\tevent_count\twakeup_count\t"
 		"expire_count\tactive_since\ttotal_time\tmax_time\t"
-		"last_change\tprevent_suspend_time\n");
+		"last_change\tprevent_suspend_time\tcpu_cost\n");
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(ws, &wakeup_sources, entry)
@@ -85,6 +85,19 @@ static DEFINE_MUTEX(loop_index_mutex);
 static int max_part;
 static int part_shift;
 
+/*
+ * Reads don't depend on each other, so up to read_depth of them are
+ * handled at once by the read workers instead of queueing behind the
+ * loop thread. Writes, flushes and switches keep their order there.
+ */
+static int read_depth = LOOP_READ_WORKERS;
+
+/*
+ * Pages of the backing file a read has been copied out of are cached a
+ * second time by whoever reads the loop device. Drop the clean ones.
+ */
+static bool drop_backing_cache = true;
+
 /*
  * Transfer functions
  */
@@ -387,6 +400,7 @@ lo_receive(struct loop_device *lo, struct bio *bio, int bsize, loff_t pos)
 {
 	struct bio_vec *bvec;
 	ssize_t s;
+	loff_t start = pos;
 	int i;
 
 	bio_for_each_segment(bvec, bio, i) {
@@ -400,6 +414,18 @@ lo_receive(struct loop_device *lo, struct bio *bio, int bsize, loff_t pos)
 		}
 		pos += bvec->bv_len;
 	}
+
+	/* only pages the read covered entirely; busy ones are skipped */
+	if (drop_backing_cache && pos - start >= PAGE_CACHE_SIZE) {
+		pgoff_t first = (start + PAGE_CACHE_SIZE - 1) >>
+			PAGE_CACHE_SHIFT;
+		pgoff_t end = pos >> PAGE_CACHE_SHIFT;
+
+		if (end > first)
+			invalidate_mapping_pages(
+				lo->lo_backing_file->f_mapping,
+				first, end - 1);
+	}
 	return 0;
 }
 
@@ -474,6 +500,39 @@ static struct bio *loop_get_bio(struct loop_device *lo)
 	return bio_list_pop(&lo->lo_bio_list);
 }
 
+/*
+ * The transfer functions of loadable modules keep their state per device,
+ * so only plain reads are handed to the read workers.
+ */
+static inline bool loop_read_async(struct loop_device *lo)
+{
+	return lo->lo_read_wq && read_depth > 0 &&
+		lo->transfer == transfer_none;
+}
+
+/*
+ * Read worker: takes reads off lo_read_list until it is empty. Several of
+ * them run at once, one per read queued up to read_depth, so a read that
+ * misses the backing file's cache doesn't hold up the ones behind it.
+ */
+static void loop_read_work(struct work_struct *work)
+{
+	struct loop_read_worker *w = container_of(work,
+						  struct loop_read_worker,
+						  work);
+	struct loop_device *lo = w->lo;
+	struct bio *bio;
+
+	for (;;) {
+		spin_lock_irq(&lo->lo_lock);
+		bio = bio_list_pop(&lo->lo_read_list);
+		spin_unlock_irq(&lo->lo_lock);
+		if (!bio)
+			break;
+		bio_endio(bio, do_bio_filebacked(lo, bio));
+	}
+}
+
 static void loop_make_request(struct request_queue *q, struct bio *old_bio)
 {
 	struct loop_device *lo = q->queuedata;
@@ -489,6 +548,15 @@ static void loop_make_request(struct request_queue *q, struct bio *old_bio)
 		goto out;
 	if (unlikely(rw == WRITE && (lo->lo_flags & LO_FLAGS_READ_ONLY)))
 		goto out;
+	if (rw == READ && loop_read_async(lo)) {
+		int depth = min(read_depth, LOOP_READ_WORKERS);
+
+		bio_list_add(&lo->lo_read_list, old_bio);
+		queue_work(lo->lo_read_wq,
+			   &lo->lo_read_worker[lo->lo_read_next++ % depth].work);
+		spin_unlock_irq(&lo->lo_lock);
+		return;
+	}
 	loop_add_bio(lo, old_bio);
 	wake_up(&lo->lo_event);
 	spin_unlock_irq(&lo->lo_lock);
@@ -608,6 +676,12 @@ static void do_loop_switch(struct loop_device *lo, struct switch_request *p)
 	lo->old_gfp_mask = mapping_gfp_mask(mapping);
 	mapping_set_gfp_mask(mapping, lo->old_gfp_mask & ~(__GFP_IO|__GFP_FS));
 out:
+	/*
+	 * Reads queued before the switch, or racing with it on the old
+	 * file, have to be done before the caller may drop that file.
+	 */
+	if (lo->lo_read_wq)
+		flush_workqueue(lo->lo_read_wq);
 	complete(&p->wait);
 }
 
@@ -877,6 +951,7 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	mapping_set_gfp_mask(mapping, lo->old_gfp_mask & ~(__GFP_IO|__GFP_FS));
 
 	bio_list_init(&lo->lo_bio_list);
+	bio_list_init(&lo->lo_read_list);
 
 	/*
 	 * set queue make_request_fn, and add limits based on lower level
@@ -896,6 +971,14 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 
 	set_blocksize(bdev, lo_blocksize);
 
+	/* without it reads are simply left to the loop thread */
+	lo->lo_read_wq = alloc_workqueue("loop%d_read",
+					 WQ_MEM_RECLAIM | WQ_HIGHPRI,
+					 LOOP_READ_WORKERS, lo->lo_number);
+	if (!lo->lo_read_wq)
+		printk(KERN_WARNING "loop%d: no read workers\n",
+		       lo->lo_number);
+
 	lo->lo_thread = kthread_create(loop_thread, lo, "loop%d",
 						lo->lo_number);
 	if (IS_ERR(lo->lo_thread)) {
@@ -916,6 +999,10 @@ static int loop_set_fd(struct loop_device *lo, fmode_t mode,
 	return 0;
 
 out_clr:
+	if (lo->lo_read_wq) {
+		destroy_workqueue(lo->lo_read_wq);
+		lo->lo_read_wq = NULL;
+	}
 	loop_sysfs_exit(lo);
 	lo->lo_thread = NULL;
 	lo->lo_device = NULL;
@@ -993,6 +1080,12 @@ static int loop_clr_fd(struct loop_device *lo)
 
 	kthread_stop(lo->lo_thread);
 
+	/* no new reads past Lo_rundown, this waits for those in flight */
+	if (lo->lo_read_wq) {
+		destroy_workqueue(lo->lo_read_wq);
+		lo->lo_read_wq = NULL;
+	}
+
 	spin_lock_irq(&lo->lo_lock);
 	lo->lo_backing_file = NULL;
 	spin_unlock_irq(&lo->lo_lock);
@@ -1563,6 +1656,11 @@ module_param(max_loop, int, S_IRUGO);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
 module_param(max_part, int, S_IRUGO);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
+module_param(read_depth, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(read_depth, "Reads in flight per loop device (0-4)");
+module_param(drop_backing_cache, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(drop_backing_cache,
+		 "Drop backing file pages a read has been copied from");
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
@@ -1608,7 +1706,7 @@ static int loop_add(struct loop_device **l, int i)
 {
 	struct loop_device *lo;
 	struct gendisk *disk;
-	int err;
+	int err, w;
 
 	lo = kzalloc(sizeof(*lo), GFP_KERNEL);
 	if (!lo) {
@@ -1676,6 +1774,10 @@ static int loop_add(struct loop_device **l, int i)
 	lo->lo_thread		= NULL;
 	init_waitqueue_head(&lo->lo_event);
 	spin_lock_init(&lo->lo_lock);
+	for (w = 0; w < LOOP_READ_WORKERS; w++) {
+		INIT_WORK(&lo->lo_read_worker[w].work, loop_read_work);
+		lo->lo_read_worker[w].lo = lo;
+	}
 	disk->major		= LOOP_MAJOR;
 	disk->first_minor	= i << part_shift;
 	disk->fops		= &lo_fops;
@@ -13,11 +13,14 @@
 #include <linux/slab.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
 
 #include "zcomp.h"
 #include "zcomp_lzo.h"
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 #include "zcomp_lz4.h"
+#include "zcomp_lz4hc.h"
 #endif
 
 /*
@@ -43,10 +46,27 @@ struct zcomp_strm_multi {
 	wait_queue_head_t strm_wait;
 };
 
+/*
+ * per-cpu zcomp_strm backend: each possible cpu owns a preallocated
+ * stream, claimed without taking any lock. If the local stream is
+ * already in use (its owner got preempted or migrated while holding
+ * it) we fall back to the multi stream backend.
+ */
+struct zcomp_strm_pcpu_slot {
+	unsigned long busy;
+	struct zcomp_strm *zstrm;
+};
+
+struct zcomp_strm_pcpu {
+	struct zcomp_strm_pcpu_slot __percpu *slots;
+	struct zcomp_strm_multi fallback;
+};
+
 static struct zcomp_backend *backends[] = {
 	&zcomp_lzo,
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 	&zcomp_lz4,
+	&zcomp_lz4hc,
 #endif
 	NULL
 };
@@ -80,6 +100,7 @@ static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp, gfp_t flags)
 	if (!zstrm)
 		return NULL;
 
+	zstrm->cpu = -1;
 	zstrm->private = comp->backend->create(flags);
 	/*
 	 * allocate 2 pages. 1 for compressed data, plus 1 extra for the
@@ -97,9 +118,9 @@ static struct zcomp_strm *zcomp_strm_alloc(struct zcomp *comp, gfp_t flags)
  * get idle zcomp_strm or wait until other process release
  * (zcomp_strm_release()) one for us
  */
-static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
+static struct zcomp_strm *__zcomp_strm_multi_find(struct zcomp *comp,
+		struct zcomp_strm_multi *zs)
 {
-	struct zcomp_strm_multi *zs = comp->stream;
 	struct zcomp_strm *zstrm;
 
 	while (1) {
@@ -142,11 +163,15 @@ static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
 	return zstrm;
 }
 
-/* add stream back to idle list and wake up waiter or free the stream */
-static void zcomp_strm_multi_release(struct zcomp *comp, struct zcomp_strm *zstrm)
+static struct zcomp_strm *zcomp_strm_multi_find(struct zcomp *comp)
 {
-	struct zcomp_strm_multi *zs = comp->stream;
+	return __zcomp_strm_multi_find(comp, comp->stream);
+}
 
+/* add stream back to idle list and wake up waiter or free the stream */
+static void __zcomp_strm_multi_release(struct zcomp *comp,
+		struct zcomp_strm_multi *zs, struct zcomp_strm *zstrm)
+{
 	spin_lock(&zs->strm_lock);
 	if (zs->avail_strm <= zs->max_strm) {
 		list_add(&zstrm->list, &zs->idle_strm);
@@ -160,6 +185,12 @@ static void zcomp_strm_multi_release(struct zcomp *comp, struct zcomp_strm *zstr
 	zcomp_strm_free(comp, zstrm);
 }
 
+static void zcomp_strm_multi_release(struct zcomp *comp,
+		struct zcomp_strm *zstrm)
+{
+	__zcomp_strm_multi_release(comp, comp->stream, zstrm);
+}
+
 /* change max_strm limit */
 static bool zcomp_strm_multi_set_max_streams(struct zcomp *comp, int num_strm)
 {
@@ -183,9 +214,9 @@ static bool zcomp_strm_multi_set_max_streams(struct zcomp *comp, int num_strm)
 	return true;
 }
 
-static void zcomp_strm_multi_destroy(struct zcomp *comp)
+static void __zcomp_strm_multi_destroy(struct zcomp *comp,
+		struct zcomp_strm_multi *zs)
 {
-	struct zcomp_strm_multi *zs = comp->stream;
 	struct zcomp_strm *zstrm;
 
 	while (!list_empty(&zs->idle_strm)) {
@@ -194,12 +225,40 @@ static void zcomp_strm_multi_destroy(struct zcomp *comp)
 		list_del(&zstrm->list);
 		zcomp_strm_free(comp, zstrm);
 	}
+}
+
+static void zcomp_strm_multi_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm_multi *zs = comp->stream;
+
+	__zcomp_strm_multi_destroy(comp, zs);
 	kfree(zs);
 }
 
-static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
+/*
+ * initialize multi stream backend @zs with one preallocated stream, so
+ * that zcomp_strm_multi_find() always has something to wait for
+ */
+static int __zcomp_strm_multi_init(struct zcomp *comp,
+		struct zcomp_strm_multi *zs, int max_strm)
 {
 	struct zcomp_strm *zstrm;
+
+	spin_lock_init(&zs->strm_lock);
+	INIT_LIST_HEAD(&zs->idle_strm);
+	init_waitqueue_head(&zs->strm_wait);
+	zs->max_strm = max_strm;
+	zs->avail_strm = 1;
+
+	zstrm = zcomp_strm_alloc(comp, GFP_KERNEL);
+	if (!zstrm)
+		return -ENOMEM;
+	list_add(&zstrm->list, &zs->idle_strm);
+	return 0;
+}
+
+static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
+{
 	struct zcomp_strm_multi *zs;
 
 	comp->destroy = zcomp_strm_multi_destroy;
@@ -210,19 +269,109 @@ static int zcomp_strm_multi_create(struct zcomp *comp, int max_strm)
 	if (!zs)
 		return -ENOMEM;
 
+	if (__zcomp_strm_multi_init(comp, zs, max_strm)) {
+		kfree(zs);
+		return -ENOMEM;
+	}
 	comp->stream = zs;
-	spin_lock_init(&zs->strm_lock);
-	INIT_LIST_HEAD(&zs->idle_strm);
-	init_waitqueue_head(&zs->strm_wait);
-	zs->max_strm = max_strm;
-	zs->avail_strm = 1;
+	return 0;
+}
 
-	zstrm = zcomp_strm_alloc(comp, GFP_KERNEL);
-	if (!zstrm) {
+/*
+ * claim current cpu's stream. preemption is disabled only while we
+ * look up and mark the local slot: the caller may sleep (zs_malloc())
+ * while holding the stream, so the busy bit (not preemption) is what
+ * protects it. a preempted owner or a task that migrated away simply
+ * makes other writers on that cpu take the multi stream fallback.
+ */
+static struct zcomp_strm *zcomp_strm_pcpu_find(struct zcomp *comp)
+{
+	struct zcomp_strm_pcpu *zs = comp->stream;
+	struct zcomp_strm_pcpu_slot *slot;
+
+	slot = per_cpu_ptr(zs->slots, get_cpu());
+	if (likely(!test_and_set_bit_lock(0, &slot->busy))) {
+		put_cpu();
+		return slot->zstrm;
+	}
+	put_cpu();
+
+	return __zcomp_strm_multi_find(comp, &zs->fallback);
+}
+
+static void zcomp_strm_pcpu_release(struct zcomp *comp,
+		struct zcomp_strm *zstrm)
+{
+	struct zcomp_strm_pcpu *zs = comp->stream;
+
+	if (zstrm->cpu >= 0) {
+		clear_bit_unlock(0, &per_cpu_ptr(zs->slots, zstrm->cpu)->busy);
+		return;
+	}
+
+	__zcomp_strm_multi_release(comp, &zs->fallback, zstrm);
+}
+
+static bool zcomp_strm_pcpu_set_max_streams(struct zcomp *comp, int num_strm)
+{
+	/* zcomp_strm_pcpu is sized by the number of possible cpus */
+	return num_strm == ZCOMP_STRM_PERCPU;
+}
+
+static void zcomp_strm_pcpu_destroy(struct zcomp *comp)
+{
+	struct zcomp_strm_pcpu *zs = comp->stream;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_strm_pcpu_slot *slot = per_cpu_ptr(zs->slots, cpu);
+
+		if (slot->zstrm)
+			zcomp_strm_free(comp, slot->zstrm);
+	}
+	free_percpu(zs->slots);
+	__zcomp_strm_multi_destroy(comp, &zs->fallback);
+	kfree(zs);
+}
+
+static int zcomp_strm_pcpu_create(struct zcomp *comp)
+{
+	struct zcomp_strm_pcpu *zs;
+	int cpu;
+
+	comp->destroy = zcomp_strm_pcpu_destroy;
+	comp->strm_find = zcomp_strm_pcpu_find;
+	comp->strm_release = zcomp_strm_pcpu_release;
+	comp->set_max_streams = zcomp_strm_pcpu_set_max_streams;
+	zs = kzalloc(sizeof(struct zcomp_strm_pcpu), GFP_KERNEL);
+	if (!zs)
+		return -ENOMEM;
+
+	zs->slots = alloc_percpu(struct zcomp_strm_pcpu_slot);
+	if (!zs->slots) {
 		kfree(zs);
 		return -ENOMEM;
 	}
-	list_add(&zstrm->list, &zs->idle_strm);
+
+	/* further fallback streams are only allocated on contention */
+	if (__zcomp_strm_multi_init(comp, &zs->fallback, num_online_cpus())) {
+		free_percpu(zs->slots);
+		kfree(zs);
+		return -ENOMEM;
+	}
+
+	comp->stream = zs;
+	for_each_possible_cpu(cpu) {
+		struct zcomp_strm_pcpu_slot *slot = per_cpu_ptr(zs->slots, cpu);
+
+		slot->zstrm = zcomp_strm_alloc(comp, GFP_KERNEL);
+		if (!slot->zstrm) {
+			zcomp_strm_pcpu_destroy(comp);
+			comp->stream = NULL;
+			return -ENOMEM;
+		}
+		slot->zstrm->cpu = cpu;
+	}
 	return 0;
 }
 
@@ -304,6 +453,28 @@ struct zcomp_strm *zcomp_strm_find(struct zcomp *comp)
 	return comp->strm_find(comp);
 }
 
+/*
+ * claim current cpu's stream without sleeping, for callers in atomic
+ * context. only the per-cpu backend supports it, NULL is returned when
+ * the local stream is busy instead of falling back to the multi stream
+ * backend. the stream is released with zcomp_strm_release().
+ */
+struct zcomp_strm *zcomp_strm_find_nowait(struct zcomp *comp)
+{
+	struct zcomp_strm_pcpu *zs = comp->stream;
+	struct zcomp_strm_pcpu_slot *slot;
+	struct zcomp_strm *zstrm = NULL;
+
+	if (comp->strm_find != zcomp_strm_pcpu_find)
+		return NULL;
+
+	slot = per_cpu_ptr(zs->slots, get_cpu());
+	if (!test_and_set_bit_lock(0, &slot->busy))
+		zstrm = slot->zstrm;
+	put_cpu();
+	return zstrm;
+}
+
 void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
 {
 	comp->strm_release(comp, zstrm);
@@ -349,7 +520,9 @@ struct zcomp *zcomp_create(const char *compress, int max_strm)
 		return ERR_PTR(-ENOMEM);
 
 	comp->backend = backend;
-	if (max_strm > 1)
+	if (max_strm == ZCOMP_STRM_PERCPU)
+		zcomp_strm_pcpu_create(comp);
+	else if (max_strm > 1)
 		zcomp_strm_multi_create(comp, max_strm);
 	else
 		zcomp_strm_single_create(comp);
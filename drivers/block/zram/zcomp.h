@@ -12,6 +12,9 @@
 
 #include <linux/mutex.h>
 
+/* max_strm value selecting the per-cpu streams backend */
+#define ZCOMP_STRM_PERCPU	(-1)
+
 struct zcomp_strm {
 	/* compression/decompression buffer */
 	void *buffer;
@@ -23,6 +26,8 @@ struct zcomp_strm {
 	void *private;
 	/* used in multi stream backend, protected by backend strm_lock */
 	struct list_head list;
+	/* owning cpu for per-cpu backend streams, -1 otherwise */
+	int cpu;
 };
 
 /* static compression backend */
@@ -56,6 +61,7 @@ struct zcomp *zcomp_create(const char *comp, int max_strm);
 void zcomp_destroy(struct zcomp *comp);
 
 struct zcomp_strm *zcomp_strm_find(struct zcomp *comp);
+struct zcomp_strm *zcomp_strm_find_nowait(struct zcomp *comp);
 void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm);
 
 int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
@@ -25,6 +25,7 @@
 #include <linux/bitops.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
+#include <linux/completion.h>
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
@@ -32,6 +33,8 @@
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/err.h>
+#include <linux/workqueue.h>
+#include <linux/cpumask.h>
 
 #include "zram_drv.h"
 
@@ -39,6 +42,8 @@
 static int zram_major;
 static struct zram *zram_devices;
 static const char *default_compressor = "lzo";
+/* per-cpu workers decompressing async_read pages */
+static struct workqueue_struct *zram_read_wq;
 
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
@@ -109,6 +114,37 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	zs_compact(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t pages_compacted_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned long val = 0;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (init_done(zram))
+		val = zs_get_pages_compacted(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%lu\n", val);
+}
+
 static ssize_t max_comp_streams_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -119,6 +155,8 @@ static ssize_t max_comp_streams_show(struct device *dev,
 	val = zram->max_comp_streams;
 	up_read(&zram->init_lock);
 
+	if (val == ZCOMP_STRM_PERCPU)
+		return scnprintf(buf, PAGE_SIZE, "percpu\n");
 	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
 }
 
@@ -129,11 +167,15 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	struct zram *zram = dev_to_zram(dev);
 	int ret;
 
-	ret = kstrtoint(buf, 0, &num);
-	if (ret < 0)
-		return ret;
-	if (num < 1)
-		return -EINVAL;
+	if (sysfs_streq(buf, "percpu")) {
+		num = ZCOMP_STRM_PERCPU;
+	} else {
+		ret = kstrtoint(buf, 0, &num);
+		if (ret < 0)
+			return ret;
+		if (num < 1)
+			return -EINVAL;
+	}
 
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
@@ -151,6 +193,59 @@ out:
 	return ret;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	if (sysfs_streq(buf, "none"))
+		zram->recomp_algorithm[0] = 0x00;
+	else
+		strlcpy(zram->recomp_algorithm, buf,
+				sizeof(zram->recomp_algorithm));
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t async_read_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)zram->async_read);
+}
+
+static ssize_t async_read_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	zram->async_read = val;
+	return len;
+}
+
 static ssize_t comp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -179,6 +274,41 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+#endif
+
 /* flag operations needs meta->tb_lock */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
@@ -203,6 +333,422 @@ static inline int is_partial_io(struct bio_vec *bvec)
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+/*
+ * Tracks completion of a bio whose pages are (partly) filled in
+ * asynchronously. The submitter holds one reference; the bio is ended
+ * when the last reference is dropped.
+ */
+struct zram_io {
+	struct bio *bio;
+	atomic_t pending;
+	int error;
+};
+
+/* get a reference on the request's zram_io, allocating it on first use */
+static struct zram_io *zram_io_get(struct zram_io **iop, struct bio *bio)
+{
+	struct zram_io *io = *iop;
+
+	if (!io) {
+		io = kmalloc(sizeof(*io), GFP_NOIO);
+		if (!io)
+			return NULL;
+		io->bio = bio;
+		io->error = 0;
+		atomic_set(&io->pending, 1);
+		*iop = io;
+	}
+	atomic_inc(&io->pending);
+	return io;
+}
+
+static void zram_io_put(struct zram_io *io, int error)
+{
+	if (error)
+		io->error = error;
+	if (!atomic_dec_and_test(&io->pending))
+		return;
+
+	if (io->error) {
+		bio_io_error(io->bio);
+	} else {
+		set_bit(BIO_UPTODATE, &io->bio->bi_flags);
+		bio_endio(io->bio, 0);
+	}
+	kfree(io);
+}
+
+/* clear idle flag on access; avoid the write lock when it is not set */
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+
+	if (likely(!zram_test_flag(meta, index, ZRAM_IDLE)))
+		return;
+
+	write_lock(&meta->tb_lock);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	write_unlock(&meta->tb_lock);
+}
+
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index, nr_pages;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		write_lock(&meta->tb_lock);
+		if (meta->table[index].handle &&
+				!zram_test_flag(meta, index, ZRAM_SAME) &&
+				!zram_test_flag(meta, index, ZRAM_WB))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		write_unlock(&meta->tb_lock);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static inline bool zram_wb_enabled(struct zram *zram)
+{
+	return zram->backing_dev != NULL;
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram_wb_enabled(zram))
+		return;
+
+	if (zram->old_block_size)
+		set_blocksize(zram->bdev, zram->old_block_size);
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	zram->old_block_size = 0;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	if (!zram_wb_enabled(zram)) {
+		up_read(&zram->init_lock);
+		return scnprintf(buf, PAGE_SIZE, "none\n");
+	}
+
+	p = d_path(&zram->backing_dev->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *backing_dev = NULL;
+	struct block_device *bdev = NULL;
+	struct inode *inode;
+	unsigned long nr_pages, *bitmap = NULL;
+	unsigned int old_block_size;
+	char *file_name;
+	size_t sz;
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		/* blkdev_get() drops the bdev reference on failure */
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	if (nr_pages < 2) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+
+	zram->old_block_size = old_block_size;
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	vfree(bitmap);
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+
+	return err;
+}
+
+/* block index 0 is never handed out so that it can't be taken as !handle */
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+static struct bio *zram_bdev_bio(struct zram *zram, struct page *page,
+		unsigned int len, unsigned int offset, unsigned long blk_idx)
+{
+	struct bio *bio;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return NULL;
+
+	bio->bi_sector = blk_idx * (PAGE_SIZE >> SECTOR_SHIFT);
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, len, offset)) {
+		bio_put(bio);
+		return NULL;
+	}
+	return bio;
+}
+
+static void zram_bdev_sync_end_io(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+static int zram_bdev_rw_page(struct zram *zram, int rw, struct page *page,
+		unsigned long blk_idx)
+{
+	struct completion done;
+	struct bio *bio;
+	int ret;
+
+	bio = zram_bdev_bio(zram, page, PAGE_SIZE, 0, blk_idx);
+	if (!bio)
+		return -ENOMEM;
+
+	init_completion(&done);
+	bio->bi_private = &done;
+	bio->bi_end_io = zram_bdev_sync_end_io;
+	submit_bio(rw | REQ_SYNC, bio);
+	wait_for_completion(&done);
+
+	ret = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+	return ret;
+}
+
+static void zram_bdev_async_read_end_io(struct bio *bio, int err)
+{
+	struct zram_io *io = bio->bi_private;
+
+	if (!err && !test_bit(BIO_UPTODATE, &bio->bi_flags))
+		err = -EIO;
+	if (!err)
+		flush_dcache_page(bio->bi_io_vec[0].bv_page);
+
+	bio_put(bio);
+	zram_io_put(io, err);
+}
+
+/*
+ * Read a written back page into @bvec. Full page reads are submitted
+ * to the backing device directly into the caller's page and complete
+ * the parent bio asynchronously; partial reads go through a bounce
+ * page synchronously.
+ */
+static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
+		unsigned long blk_idx, int offset, struct bio *parent,
+		struct zram_io **iop)
+{
+	struct page *page;
+	struct bio *bio;
+	struct zram_io *io;
+	unsigned char *src, *dst;
+	int ret;
+
+	atomic64_inc(&zram->stats.bd_reads);
+	if (!is_partial_io(bvec)) {
+		bio = zram_bdev_bio(zram, bvec->bv_page, bvec->bv_len,
+				bvec->bv_offset, blk_idx);
+		if (bio) {
+			io = zram_io_get(iop, parent);
+			if (io) {
+				bio->bi_private = io;
+				bio->bi_end_io = zram_bdev_async_read_end_io;
+				submit_bio(READ, bio);
+				return 0;
+			}
+			bio_put(bio);
+		}
+	}
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = zram_bdev_rw_page(zram, READ, page, blk_idx);
+	if (!ret) {
+		dst = kmap_atomic(bvec->bv_page);
+		src = kmap_atomic(page);
+		memcpy(dst + bvec->bv_offset, src + offset, bvec->bv_len);
+		kunmap_atomic(src);
+		kunmap_atomic(dst);
+		flush_dcache_page(bvec->bv_page);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+/* Same as zram_decompress_page() for a written back page. May sleep. */
+static int read_from_bdev_sync(struct zram *zram, char *mem, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	struct page *page;
+	int ret;
+
+	read_lock(&meta->tb_lock);
+	if (!zram_test_flag(meta, index, ZRAM_WB)) {
+		read_unlock(&meta->tb_lock);
+		return -EAGAIN;
+	}
+	blk_idx = meta->table[index].handle;
+	read_unlock(&meta->tb_lock);
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	atomic64_inc(&zram->stats.bd_reads);
+	ret = zram_bdev_rw_page(zram, READ, page, blk_idx);
+	if (!ret) {
+		unsigned char *src = kmap_atomic(page);
+
+		memcpy(mem, src, PAGE_SIZE);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+
+	return ret;
+}
+#else
+static inline bool zram_wb_enabled(struct zram *zram) { return false; }
+static inline void reset_bdev(struct zram *zram) {};
+static inline void free_block_bdev(struct zram *zram,
+		unsigned long blk_idx) {};
+static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
+		unsigned long blk_idx, int offset, struct bio *parent,
+		struct zram_io **iop)
+{
+	return -EIO;
+}
+static inline int read_from_bdev_sync(struct zram *zram, char *mem,
+		u32 index)
+{
+	return -EIO;
+}
+#endif
+
 /*
  * Check if request is within bounds and aligned on zram logical blocks.
  */
@@ -230,15 +776,17 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 
 static void zram_meta_free(struct zram_meta *meta)
 {
+	zram_dedup_fini(meta);
 	zs_destroy_pool(meta->mem_pool);
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(u64 disksize)
+static struct zram_meta *zram_meta_alloc(const char *pool_name, u64 disksize,
+					bool use_dedup)
 {
 	size_t num_pages;
-	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
+	struct zram_meta *meta = kzalloc(sizeof(*meta), GFP_KERNEL);
 	if (!meta)
 		goto out;
 
@@ -249,15 +797,20 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 		goto free_meta;
 	}
 
-	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM);
+	meta->mem_pool = zs_create_pool(pool_name, GFP_NOIO | __GFP_HIGHMEM);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		goto free_table;
 	}
 
+	if (use_dedup && zram_dedup_init(meta, num_pages))
+		goto free_pool;
+
 	rwlock_init(&meta->tb_lock);
 	return meta;
 
+free_pool:
+	zs_destroy_pool(meta->mem_pool);
 free_table:
 	vfree(meta->table);
 free_meta:
@@ -267,6 +820,40 @@ out:
 	return meta;
 }
 
+static inline bool zram_dedup_enabled(struct zram_meta *meta)
+{
+#ifdef CONFIG_ZRAM_DEDUP
+	return meta->hash != NULL;
+#else
+	return false;
+#endif
+}
+
+/* zsmalloc handle of a compressed table entry */
+static inline unsigned long zram_zs_handle(struct zram_meta *meta,
+					unsigned long handle)
+{
+	if (zram_dedup_enabled(meta))
+		return ((struct zram_entry *)handle)->handle;
+	return handle;
+}
+
+/* release a compressed table entry of @size bytes */
+static void zram_free_handle(struct zram *zram, unsigned long handle,
+			u16 size)
+{
+	struct zram_meta *meta = zram->meta;
+
+	if (zram_dedup_enabled(meta)) {
+		/* still shared with another table entry */
+		if (!zram_dedup_put(zram, (struct zram_entry *)handle))
+			return;
+	} else {
+		zs_free(meta->mem_pool, handle);
+	}
+	atomic64_sub(size, &zram->stats.compr_data_size);
+}
+
 static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 {
 	if (*offset + bvec->bv_len >= PAGE_SIZE)
@@ -274,31 +861,57 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/* check if the page is filled with a single repeated word */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
-	unsigned int pos;
+	unsigned int pos, last_pos = PAGE_SIZE / sizeof(unsigned long) - 1;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
+
+	/* cheap reject for the common case of an ordinary page */
+	if (val != page[last_pos])
+		return 0;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos < last_pos; pos++) {
+		if (val != page[pos])
 			return 0;
 	}
 
+	*element = val;
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned int i;
+	unsigned long *page = ptr;
+
+	WARN_ON_ONCE(!IS_ALIGNED(len, sizeof(unsigned long)));
+
+	if (likely(value == 0)) {
+		memset(ptr, 0, len);
+	} else {
+		for (i = 0; i < len / sizeof(*page); i++)
+			page[i] = value;
+	}
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
 	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
+		zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len,
+				element);
+	else if (!element)
 		clear_page(user_mem);
+	else
+		zram_fill_page(user_mem, PAGE_SIZE, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -310,21 +923,44 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	/* tell a concurrent writeback/recompress the slot content went away */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_UNDER_RECOMP);
+	if (zram_test_flag(meta, index, ZRAM_RECOMP)) {
+		zram_clear_flag(meta, index, ZRAM_RECOMP);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+	if (zram_test_flag(meta, index, ZRAM_HUGE)) {
+		zram_clear_flag(meta, index, ZRAM_HUGE);
+		atomic64_dec(&zram->stats.huge_pages);
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle);
+		atomic64_dec(&zram->stats.pages_stored);
+		meta->table[index].handle = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same element filled pages, the
+	 * handle holds the fill value. Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		atomic64_dec(&zram->stats.same_pages);
+		if (!handle)
 			atomic64_dec(&zram->stats.zero_pages);
-		}
+		meta->table[index].handle = 0;
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
+	if (unlikely(!handle))
+		return;
 
-	atomic64_sub(meta->table[index].size, &zram->stats.compr_data_size);
+	zram_free_handle(zram, handle, meta->table[index].size);
 	atomic64_dec(&zram->stats.pages_stored);
 
 	meta->table[index].handle = 0;
@@ -343,15 +979,29 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	handle = meta->table[index].handle;
 	size = meta->table[index].size;
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (!handle || zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = handle;
+
 		read_unlock(&meta->tb_lock);
-		clear_page(mem);
+		if (!element)
+			clear_page(mem);
+		else
+			zram_fill_page(mem, PAGE_SIZE, element);
 		return 0;
 	}
 
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		/* caller has to go to the backing device */
+		read_unlock(&meta->tb_lock);
+		return -EAGAIN;
+	}
+
+	handle = zram_zs_handle(meta, handle);
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
 	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
+	else if (zram_test_flag(meta, index, ZRAM_RECOMP))
+		ret = zcomp_decompress(zram->recomp, cmem, size, mem);
 	else
 		ret = zcomp_decompress(zram->comp, cmem, size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
@@ -367,8 +1017,27 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * Like zram_decompress_page() but also reads back written back pages.
+ * May sleep.
+ */
+static int zram_read_page(struct zram *zram, char *mem, u32 index)
+{
+	int ret;
+
+	do {
+		ret = zram_decompress_page(zram, mem, index);
+		if (ret != -EAGAIN)
+			break;
+		ret = read_from_bdev_sync(zram, mem, index);
+	} while (ret == -EAGAIN);
+
+	return ret;
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
-			  u32 index, int offset, struct bio *bio)
+			  u32 index, int offset, struct bio *bio,
+			  struct zram_io **io)
 {
 	int ret;
 	struct page *page;
@@ -376,13 +1045,23 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
+	zram_accessed(zram, index);
+retry:
 	read_lock(&meta->tb_lock);
 	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+			zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].handle;
+
 		read_unlock(&meta->tb_lock);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, element);
 		return 0;
 	}
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].handle;
+
+		read_unlock(&meta->tb_lock);
+		return read_from_bdev(zram, bvec, blk_idx, offset, bio, io);
+	}
 	read_unlock(&meta->tb_lock);
 
 	if (is_partial_io(bvec))
@@ -400,6 +1079,14 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	}
 
 	ret = zram_decompress_page(zram, uncmem, index);
+	if (unlikely(ret == -EAGAIN)) {
+		/* written back under us, read it from the backing device */
+		kunmap_atomic(user_mem);
+		if (is_partial_io(bvec))
+			kfree(uncmem);
+		uncmem = NULL;
+		goto retry;
+	}
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret))
 		goto out_cleanup;
@@ -422,11 +1109,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	unsigned long handle, element;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
 	struct zcomp_strm *zstrm;
+	struct zram_entry *entry;
+	u32 checksum = 0;
 	bool locked = false;
 
 	page = bvec->bv_page;
@@ -440,7 +1129,7 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_decompress_page(zram, uncmem, index);
+		ret = zram_read_page(zram, uncmem, index);
 		if (ret)
 			goto out;
 	}
@@ -458,20 +1147,38 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		if (user_mem)
 			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		write_lock(&zram->meta->tb_lock);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].handle = element;
 		write_unlock(&zram->meta->tb_lock);
 
-		atomic64_inc(&zram->stats.zero_pages);
+		atomic64_inc(&zram->stats.same_pages);
+		if (!element)
+			atomic64_inc(&zram->stats.zero_pages);
 		ret = 0;
 		goto out;
 	}
 
+	if (zram_dedup_enabled(meta)) {
+		checksum = zram_dedup_checksum(uncmem);
+		/* stream buffer is free until we compress */
+		entry = zram_dedup_find(zram, uncmem, checksum, zstrm->buffer);
+		if (entry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			zcomp_strm_release(zram->comp, zstrm);
+			locked = false;
+			handle = (unsigned long)entry;
+			clen = entry->len;
+			goto store;
+		}
+	}
+
 	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -511,6 +1218,17 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	locked = false;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	if (zram_dedup_enabled(meta)) {
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+		if (!entry) {
+			zs_free(meta->mem_pool, handle);
+			ret = -ENOMEM;
+			goto out;
+		}
+		handle = (unsigned long)entry;
+	}
+	atomic64_add(clen, &zram->stats.compr_data_size);
+store:
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -520,10 +1238,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	meta->table[index].size = clen;
+	if (clen == PAGE_SIZE) {
+		zram_set_flag(meta, index, ZRAM_HUGE);
+		atomic64_inc(&zram->stats.huge_pages);
+	}
 	write_unlock(&zram->meta->tb_lock);
 
 	/* Update stats */
-	atomic64_add(clen, &zram->stats.compr_data_size);
 	atomic64_inc(&zram->stats.pages_stored);
 out:
 	if (locked)
@@ -535,15 +1256,79 @@ out:
 	return ret;
 }
 
+/* one page of a multi-page read decompressed by zram_read_wq */
+struct zram_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct bio_vec bvec;
+	u32 index;
+	struct zram_io *io;
+};
+
+static void zram_read_work_fn(struct work_struct *work)
+{
+	struct zram_read_work *rw = container_of(work,
+				struct zram_read_work, work);
+	struct zram *zram = rw->zram;
+	int ret = -EIO;
+
+	down_read(&zram->init_lock);
+	if (init_done(zram))
+		ret = zram_bvec_read(zram, &rw->bvec, rw->index, 0,
+				rw->io->bio, &rw->io);
+	up_read(&zram->init_lock);
+
+	zram_io_put(rw->io, ret < 0 ? ret : 0);
+	kfree(rw);
+}
+
+/*
+ * Hand a full page of a multi-page read to a worker on the next online
+ * cpu, so that the pages of a swap readahead cluster get decompressed
+ * in parallel. Returns false if the page has to be read synchronously.
+ */
+static bool zram_queue_read(struct zram *zram, struct bio_vec *bvec,
+			u32 index, struct bio *bio, struct zram_io **iop,
+			int *cpu)
+{
+	struct zram_read_work *rw;
+
+	rw = kmalloc(sizeof(*rw), GFP_NOIO);
+	if (!rw)
+		return false;
+
+	rw->io = zram_io_get(iop, bio);
+	if (!rw->io) {
+		kfree(rw);
+		return false;
+	}
+
+	INIT_WORK(&rw->work, zram_read_work_fn);
+	rw->zram = zram;
+	rw->bvec = *bvec;
+	rw->index = index;
+
+	*cpu = cpumask_next(*cpu, cpu_online_mask);
+	if (*cpu >= nr_cpu_ids)
+		*cpu = cpumask_first(cpu_online_mask);
+	queue_work_on(*cpu, zram_read_wq, &rw->work);
+	return true;
+}
+
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
-			int offset, struct bio *bio)
+			int offset, struct bio *bio, struct zram_io **io,
+			int *cpu)
 {
 	int ret;
 	int rw = bio_data_dir(bio);
 
 	if (rw == READ) {
 		atomic64_inc(&zram->stats.num_reads);
-		ret = zram_bvec_read(zram, bvec, index, offset, bio);
+		if (zram->async_read && bio->bi_vcnt > 1 && !offset &&
+				!is_partial_io(bvec) &&
+				zram_queue_read(zram, bvec, index, bio, io, cpu))
+			return 0;
+		ret = zram_bvec_read(zram, bvec, index, offset, bio, io);
 	} else {
 		atomic64_inc(&zram->stats.num_writes);
 		ret = zram_bvec_write(zram, bvec, index, offset);
@@ -593,13 +1378,244 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 	}
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/*
+ * Move pages flagged ZRAM_HUGE ("huge") or ZRAM_IDLE ("idle") out of
+ * zsmalloc to the backing device.
+ */
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	unsigned long blk_idx = 0;
+	size_t index, nr_pages;
+	struct page *page;
+	enum zram_pageflags mode;
+	ssize_t ret;
+	int err;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram_wb_enabled(zram)) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	ret = len;
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		if (!blk_idx) {
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				ret = -ENOSPC;
+				break;
+			}
+		}
+
+		write_lock(&meta->tb_lock);
+		if (!meta->table[index].handle ||
+				zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_WB) ||
+				zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(meta, index, ZRAM_UNDER_RECOMP) ||
+				!zram_test_flag(meta, index, mode)) {
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		/*
+		 * zram_free_page() clears ZRAM_UNDER_WB, so if it is still
+		 * set once the write completes the slot was not changed.
+		 */
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		write_unlock(&meta->tb_lock);
+
+		err = zram_decompress_page(zram, page_address(page), index);
+		if (!err)
+			err = zram_bdev_rw_page(zram, WRITE, page, blk_idx);
+
+		write_lock(&meta->tb_lock);
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			/* freed or overwritten meanwhile, reuse blk_idx */
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		if (err) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			write_unlock(&meta->tb_lock);
+			ret = err;
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].handle = blk_idx;
+		write_unlock(&meta->tb_lock);
+
+		blk_idx = 0;
+		atomic64_inc(&zram->stats.pages_stored);
+		atomic64_inc(&zram->stats.bd_writes);
+	}
+
+	if (blk_idx)
+		free_block_bdev(zram, blk_idx);
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
+/*
+ * Recompress pages flagged ZRAM_IDLE ("idle") or ZRAM_HUGE ("huge")
+ * with the secondary algorithm, keeping the result only if it is
+ * smaller. Not supported together with dedup, as shared objects are
+ * matched by decompressing them with the primary algorithm.
+ */
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	struct zcomp_strm *zstrm;
+	size_t index, nr_pages, clen;
+	unsigned long handle;
+	unsigned char *cmem;
+	struct page *page;
+	enum zram_pageflags mode;
+	ssize_t ret;
+	int err;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	meta = zram->meta;
+	if (!zram->recomp || zram_dedup_enabled(meta)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	ret = len;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		u16 old_size;
+
+		write_lock(&meta->tb_lock);
+		if (!meta->table[index].handle ||
+				zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_WB) ||
+				zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(meta, index, ZRAM_UNDER_RECOMP) ||
+				zram_test_flag(meta, index, ZRAM_RECOMP) ||
+				!zram_test_flag(meta, index, mode)) {
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		/* cleared by zram_free_page() if the slot changes under us */
+		zram_set_flag(meta, index, ZRAM_UNDER_RECOMP);
+		old_size = meta->table[index].size;
+		write_unlock(&meta->tb_lock);
+
+		err = zram_decompress_page(zram, page_address(page), index);
+		if (err)
+			goto next;
+
+		zstrm = zcomp_strm_find(zram->recomp);
+		err = zcomp_compress(zram->recomp, zstrm, page_address(page),
+				&clen);
+		if (err || clen >= old_size || clen > max_zpage_size) {
+			zcomp_strm_release(zram->recomp, zstrm);
+			goto next;
+		}
+
+		handle = zs_malloc(meta->mem_pool, clen);
+		if (!handle) {
+			zcomp_strm_release(zram->recomp, zstrm);
+			err = -ENOMEM;
+			goto next;
+		}
+		cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
+		memcpy(cmem, zstrm->buffer, clen);
+		zs_unmap_object(meta->mem_pool, handle);
+		zcomp_strm_release(zram->recomp, zstrm);
+
+		write_lock(&meta->tb_lock);
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_RECOMP)) {
+			write_unlock(&meta->tb_lock);
+			zs_free(meta->mem_pool, handle);
+			continue;
+		}
+		zram_free_page(zram, index);
+		meta->table[index].handle = handle;
+		meta->table[index].size = clen;
+		zram_set_flag(meta, index, ZRAM_RECOMP);
+		write_unlock(&meta->tb_lock);
+
+		atomic64_add(clen, &zram->stats.compr_data_size);
+		atomic64_inc(&zram->stats.pages_stored);
+		atomic64_inc(&zram->stats.recomp_pages);
+		continue;
+next:
+		write_lock(&meta->tb_lock);
+		zram_clear_flag(meta, index, ZRAM_UNDER_RECOMP);
+		write_unlock(&meta->tb_lock);
+		if (err)
+			ret = err;
+	}
+
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
 static void zram_reset_device(struct zram *zram, bool reset_capacity)
 {
 	size_t index;
 	struct zram_meta *meta;
 
+	/* workers take init_lock themselves, let queued reads finish */
+	flush_workqueue(zram_read_wq);
+
 	down_write(&zram->init_lock);
 	if (!init_done(zram)) {
+		reset_bdev(zram);
 		up_write(&zram->init_lock);
 		return;
 	}
@@ -608,13 +1624,18 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		zram_free_handle(zram, handle, meta->table[index].size);
 	}
 
 	zcomp_destroy(zram->comp);
+	if (zram->recomp)
+		zcomp_destroy(zram->recomp);
+	zram->recomp = NULL;
+	reset_bdev(zram);
 	zram->max_comp_streams = 1;
 
 	zram_meta_free(zram->meta);
@@ -632,7 +1653,7 @@ static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp = NULL;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
 	int err;
@@ -642,7 +1663,8 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(disksize);
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize,
+				zram->use_dedup);
 	if (!meta)
 		return -ENOMEM;
 
@@ -654,8 +1676,21 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	/* recompression runs from sysfs only, a single stream is enough */
+	if (zram->recomp_algorithm[0]) {
+		recomp = zcomp_create(zram->recomp_algorithm, 1);
+		if (IS_ERR(recomp)) {
+			pr_info("Cannot initialise %s recompressing backend\n",
+					zram->recomp_algorithm);
+			err = PTR_ERR(recomp);
+			recomp = NULL;
+			goto out_destroy_comp;
+		}
+	}
+
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
+		up_write(&zram->init_lock);
 		pr_info("Cannot change disksize for initialized device\n");
 		err = -EBUSY;
 		goto out_destroy_comp;
@@ -663,13 +1698,15 @@ static ssize_t disksize_store(struct device *dev,
 
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->recomp = recomp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	up_write(&zram->init_lock);
 	return len;
 
 out_destroy_comp:
-	up_write(&zram->init_lock);
+	if (recomp)
+		zcomp_destroy(recomp);
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta);
@@ -722,6 +1759,8 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 	int offset, i;
 	u32 index;
 	struct bio_vec *bvec;
+	struct zram_io *io = NULL;
+	int cpu = raw_smp_processor_id();
 
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 	offset = (bio->bi_sector &
@@ -747,25 +1786,38 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 			bv.bv_len = max_transfer_size;
 			bv.bv_offset = bvec->bv_offset;
 
-			if (zram_bvec_rw(zram, &bv, index, offset, bio) < 0)
+			if (zram_bvec_rw(zram, &bv, index, offset, bio,
+						&io, &cpu) < 0)
 				goto out;
 
 			bv.bv_len = bvec->bv_len - max_transfer_size;
 			bv.bv_offset += max_transfer_size;
-			if (zram_bvec_rw(zram, &bv, index + 1, 0, bio) < 0)
+			if (zram_bvec_rw(zram, &bv, index + 1, 0, bio,
+						&io, &cpu) < 0)
 				goto out;
 		} else
-			if (zram_bvec_rw(zram, bvec, index, offset, bio) < 0)
+			if (zram_bvec_rw(zram, bvec, index, offset, bio,
+						&io, &cpu) < 0)
 				goto out;
 
 		update_position(&index, &offset, bvec);
 	}
 
+	/* some segments are still being read in, let the last one end it */
+	if (io) {
+		zram_io_put(io, 0);
+		return;
+	}
+
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return;
 
 out:
+	if (io) {
+		zram_io_put(io, -EIO);
+		return;
+	}
 	bio_io_error(bio);
 }
 
@@ -821,10 +1873,27 @@ static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
+static DEVICE_ATTR(pages_compacted, S_IRUGO, pages_compacted_show, NULL);
 static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
 		max_comp_streams_show, max_comp_streams_store);
 static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
 		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(recomp_algorithm, S_IRUGO | S_IWUSR,
+		recomp_algorithm_show, recomp_algorithm_store);
+static DEVICE_ATTR(recompress, S_IWUSR, NULL, recompress_store);
+static DEVICE_ATTR(async_read, S_IRUGO | S_IWUSR,
+		async_read_show, async_read_store);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+#endif
 
 ZRAM_ATTR_RO(num_reads);
 ZRAM_ATTR_RO(num_writes);
@@ -833,7 +1902,19 @@ ZRAM_ATTR_RO(failed_writes);
 ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
+ZRAM_ATTR_RO(same_pages);
 ZRAM_ATTR_RO(compr_data_size);
+ZRAM_ATTR_RO(huge_pages);
+ZRAM_ATTR_RO(recomp_pages);
+#ifdef CONFIG_ZRAM_DEDUP
+ZRAM_ATTR_RO(dup_data_size);
+ZRAM_ATTR_RO(meta_data_size);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+ZRAM_ATTR_RO(bd_count);
+ZRAM_ATTR_RO(bd_reads);
+ZRAM_ATTR_RO(bd_writes);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -846,11 +1927,32 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_compact.attr,
+	&dev_attr_pages_compacted.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_huge_pages.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+	&dev_attr_recomp_pages.attr,
+	&dev_attr_async_read.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+	&dev_attr_dup_data_size.attr,
+	&dev_attr_meta_data_size.attr,
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_count.attr,
+	&dev_attr_bd_reads.attr,
+	&dev_attr_bd_writes.attr,
+#endif
 	NULL,
 };
 
@@ -964,11 +2066,18 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+	zram_read_wq = alloc_workqueue("zram_read",
+				WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!zram_read_wq) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_warn("Unable to get major number\n");
 		ret = -EBUSY;
-		goto out;
+		goto destroy_wq;
 	}
 
 	/* Allocate the device array and initialize each one */
@@ -994,6 +2103,8 @@ free_devices:
 	kfree(zram_devices);
 unregister:
 	unregister_blkdev(zram_major, "zram");
+destroy_wq:
+	destroy_workqueue(zram_read_wq);
 out:
 	return ret;
 }
@@ -1015,6 +2126,7 @@ static void __exit zram_exit(void)
 	}
 
 	unregister_blkdev(zram_major, "zram");
+	destroy_workqueue(zram_read_wq);
 
 	kfree(zram_devices);
 	pr_debug("Cleanup done!\n");
@@ -19,6 +19,7 @@
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -53,8 +54,20 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /* Flags for zram pages (table[page_no].flags) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/* Page consists of one repeated word, handle holds the word */
+	ZRAM_SAME,
+	/* Page is stored uncompressed (PAGE_SIZE object) */
+	ZRAM_HUGE,
+	/* Page has not been accessed since last idle marking */
+	ZRAM_IDLE,
+	/* Page lives on the backing device, handle is its block index */
+	ZRAM_WB,
+	/* Page is being written to the backing device */
+	ZRAM_UNDER_WB,
+	/* Page is compressed with the secondary (recomp) algorithm */
+	ZRAM_RECOMP,
+	/* Page is being recompressed */
+	ZRAM_UNDER_RECOMP,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -77,13 +90,29 @@ struct zram_stats {
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
 	atomic64_t zero_pages;		/* no. of zero filled pages */
+	atomic64_t same_pages;		/* no. of same element filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
+	atomic64_t huge_pages;		/* no. of incompressible pages */
+	atomic64_t recomp_pages;	/* no. of pages using recomp algorithm */
+#ifdef CONFIG_ZRAM_DEDUP
+	atomic64_t dup_data_size;	/* compressed bytes saved by dedup */
+	atomic64_t meta_data_size;	/* bytes used by dedup entries */
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* no. of pages in backing device */
+	atomic64_t bd_reads;		/* no. of reads from backing device */
+	atomic64_t bd_writes;		/* no. of writes to backing device */
+#endif
 };
 
 struct zram_meta {
 	rwlock_t tb_lock;	/* protect table */
 	struct table *table;
 	struct zs_pool *mem_pool;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_hash *hash;	/* NULL unless dedup is enabled */
+	size_t hash_size;
+#endif
 };
 
 struct zram {
@@ -91,6 +120,8 @@ struct zram {
 	struct request_queue *queue;
 	struct gendisk *disk;
 	struct zcomp *comp;
+	/* secondary algorithm for recompress, NULL if not configured */
+	struct zcomp *recomp;
 
 	/* Prevent concurrent execution of device init, reset and R/W request */
 	struct rw_semaphore init_lock;
@@ -102,5 +133,17 @@ struct zram {
 	int max_comp_streams;
 	struct zram_stats stats;
 	char compressor[10];
+	char recomp_algorithm[10];
+	bool use_dedup;
+	/* decompress multi-page reads in parallel on zram_read_wq */
+	bool async_read;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned int old_block_size;
+	/* allocated blocks of the backing device, bit 0 is never used */
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+#endif
 };
 #endif
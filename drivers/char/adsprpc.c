@@ -33,6 +33,10 @@
 #include <linux/of.h>
 #include <linux/iommu.h>
 #include <linux/kref.h>
+#include <linux/dma-buf.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #ifndef ION_ADSPRPC_HEAP_ID
 #define ION_ADSPRPC_HEAP_ID ION_AUDIO_HEAP_ID
@@ -42,6 +46,13 @@
 #define RPC_HASH_BITS	5
 #define RPC_HASH_SZ	(1 << RPC_HASH_BITS)
 #define BALIGN		32
+/* iommu mappings of invoke fds kept per open file */
+#define MAP_CACHE_SZ	16
+/* largest argument buffer kept per process between invokes */
+#define BUF_CACHE_MAX	SZ_64K
+/* profiled (handle, method) pairs and log2 usec latency buckets */
+#define PROF_MAX	256
+#define PROF_HIST	16
 
 #define LOCK_MMAP(kernel)\
 		do {\
@@ -132,6 +143,40 @@ struct fastrpc_buf {
 	int used;
 };
 
+struct fastrpc_cached_map {
+	struct hlist_node hn;
+	struct dma_buf *buf;
+	struct ion_handle *handle;
+	ion_phys_addr_t iova;
+	unsigned long len;
+	unsigned long stamp;
+	int refs;
+	bool cached;
+};
+
+/* phases of an invoke, as accounted by fastrpc_prof_account() */
+enum fastrpc_phase {
+	PHASE_ALLOC,	/* context, device buffer and smmu attach */
+	PHASE_ARGS,	/* page list and argument copies */
+	PHASE_CACHE,	/* cache maintenance before the send */
+	PHASE_SEND,	/* smd write */
+	PHASE_DSP,	/* smd transit and dsp execution until the response */
+	PHASE_WAKE,	/* response to the invoking thread running again */
+	PHASE_PUT,	/* copying out the results */
+	PHASES,
+};
+
+struct fastrpc_prof {
+	struct hlist_node hn;
+	uint32_t handle;
+	uint32_t method;
+	u64 count;
+	u64 ns[PHASES];
+	u64 max_ns;
+	u32 hist[PROF_HIST];
+};
+
+struct file_data;
 struct smq_context_list;
 
 struct smq_invoke_ctx {
@@ -145,11 +190,15 @@ struct smq_invoke_ctx {
 	struct fastrpc_buf *abufs;
 	struct fastrpc_device *dev;
 	struct fastrpc_apps *apps;
+	struct file_data *fdata;
 	int *fds;
-	struct ion_handle **handles;
+	struct fastrpc_cached_map **maps;
 	int nbufs;
+	size_t need;
 	bool smmu;
 	uint32_t sc;
+	bool prof;
+	ktime_t ts[PHASES];
 };
 
 struct smq_context_list {
@@ -180,6 +229,11 @@ struct fastrpc_apps {
 	spinlock_t hlock;
 	struct kref kref;
 	struct hlist_head htbl[RPC_HASH_SZ];
+	spinlock_t prof_lock;
+	struct hlist_head prof[RPC_HASH_SZ];
+	int nprof;
+	u32 profile;
+	struct dentry *debugfs;
 };
 
 struct fastrpc_mmap {
@@ -197,6 +251,9 @@ struct file_data {
 	struct hlist_head hlst;
 	uint32_t mode;
 	struct mutex map_mutex;
+	struct hlist_head maps;
+	int nmaps;
+	unsigned long stamp;
 };
 
 struct fastrpc_device {
@@ -244,6 +301,130 @@ static void free_map(struct fastrpc_mmap *map)
 	map->handle = NULL;
 }
 
+static void cached_map_free(struct fastrpc_cached_map *map)
+{
+	struct fastrpc_apps *me = &gfa;
+
+	ion_unmap_iommu(me->iclient, map->handle, me->smmu.domain_id, 0);
+	ion_free(me->iclient, map->handle);
+	dma_buf_put(map->buf);
+	kfree(map);
+}
+
+/*
+ * Looks up the iommu mapping of the buffer behind @fd in the cache of the
+ * file, and maps it on a miss. Importing and mapping, then unmapping, the
+ * same ION buffers again on every invoke is most of the cost of a small
+ * FastRPC call with SMMU enabled. The cache keeps the dma_buf referenced,
+ * so a buffer the client freed stays mapped until it is evicted or the
+ * file is released; MAP_CACHE_SZ bounds what that can pin.
+ */
+static int cached_map_get(struct file_data *fdata, int fd,
+			  struct fastrpc_cached_map **pmap)
+{
+	struct fastrpc_apps *me = &gfa;
+	struct fastrpc_cached_map *map = NULL, *evict = NULL, *m;
+	struct hlist_node *pos;
+	struct dma_buf *buf;
+	int err = 0;
+
+	buf = dma_buf_get(fd);
+	VERIFY(err, 0 == IS_ERR_OR_NULL(buf));
+	if (err)
+		return -EBADF;
+
+	spin_lock(&me->hlock);
+	hlist_for_each_entry(m, pos, &fdata->maps, hn) {
+		if (m->buf == buf) {
+			map = m;
+			map->refs++;
+			map->stamp = ++fdata->stamp;
+			break;
+		}
+	}
+	spin_unlock(&me->hlock);
+	if (map) {
+		dma_buf_put(buf);
+		*pmap = map;
+		return 0;
+	}
+
+	VERIFY(err, NULL != (map = kzalloc(sizeof(*map), GFP_KERNEL)));
+	if (err)
+		goto bail;
+	map->buf = buf;
+	map->handle = ion_import_dma_buf(me->iclient, fd);
+	VERIFY(err, 0 == IS_ERR_OR_NULL(map->handle));
+	if (err)
+		goto bail;
+	VERIFY(err, 0 == ion_map_iommu(me->iclient, map->handle,
+				me->smmu.domain_id, 0, SZ_4K, 0,
+				&map->iova, &map->len, 0, 0));
+	if (err)
+		goto bail;
+	map->refs = 1;
+	map->cached = true;
+
+	spin_lock(&me->hlock);
+	map->stamp = ++fdata->stamp;
+	hlist_add_head(&map->hn, &fdata->maps);
+	if (++fdata->nmaps > MAP_CACHE_SZ) {
+		hlist_for_each_entry(m, pos, &fdata->maps, hn) {
+			if (!m->refs && (!evict || m->stamp < evict->stamp))
+				evict = m;
+		}
+		if (evict) {
+			hlist_del(&evict->hn);
+			evict->cached = false;
+			fdata->nmaps--;
+		}
+	}
+	spin_unlock(&me->hlock);
+	if (evict)
+		cached_map_free(evict);
+	*pmap = map;
+	return 0;
+ bail:
+	if (map && !IS_ERR_OR_NULL(map->handle))
+		ion_free(me->iclient, map->handle);
+	kfree(map);
+	dma_buf_put(buf);
+	return err;
+}
+
+static void cached_map_put(struct fastrpc_cached_map *map)
+{
+	struct fastrpc_apps *me = &gfa;
+	bool unused;
+
+	spin_lock(&me->hlock);
+	unused = (--map->refs == 0) && !map->cached;
+	spin_unlock(&me->hlock);
+	if (unused)
+		cached_map_free(map);
+}
+
+static void cached_map_release(struct file_data *fdata)
+{
+	struct fastrpc_apps *me = &gfa;
+	struct fastrpc_cached_map *map;
+	struct hlist_node *pos, *n;
+	HLIST_HEAD(unused);
+
+	spin_lock(&me->hlock);
+	hlist_for_each_entry_safe(map, pos, n, &fdata->maps, hn) {
+		hlist_del(&map->hn);
+		map->cached = false;
+		/* mappings an interrupted invoke still holds go with it */
+		if (!map->refs)
+			hlist_add_head(&map->hn, &unused);
+	}
+	fdata->nmaps = 0;
+	spin_unlock(&me->hlock);
+	hlist_for_each_entry_safe(map, pos, n, &unused, hn)
+		cached_map_free(map);
+}
+
 static int alloc_mem(struct fastrpc_buf *buf)
 {
 	struct fastrpc_apps *me = &gfa;
@@ -326,7 +507,7 @@ static int context_alloc(struct fastrpc_apps *me, uint32_t kernel,
 		size = bufs * sizeof(*ctx->pra);
 		if (invokefd->fds)
 			size = size + bufs * sizeof(*ctx->fds) +
-				bufs * sizeof(*ctx->handles);
+				bufs * sizeof(*ctx->maps);
 	}
 
 	VERIFY(err, NULL != (ctx = kzalloc(sizeof(*ctx) + size, GFP_KERNEL)));
@@ -337,8 +518,8 @@ static int context_alloc(struct fastrpc_apps *me, uint32_t kernel,
 	hlist_add_fake(&ctx->hn);
 	ctx->pra = (remote_arg_t *)(&ctx[1]);
 	ctx->fds = invokefd->fds == 0 ? 0 : (int *)(&ctx->pra[bufs]);
-	ctx->handles = invokefd->fds == 0 ? 0 :
-					(struct ion_handle **)(&ctx->fds[bufs]);
+	ctx->maps = invokefd->fds == 0 ? 0 :
+			(struct fastrpc_cached_map **)(&ctx->fds[bufs]);
 	if (!kernel) {
 		VERIFY(err, 0 == copy_from_user(ctx->pra, invoke->pra,
 					bufs * sizeof(*ctx->pra)));
@@ -390,31 +571,49 @@ static void context_free(struct smq_invoke_ctx *ctx, bool lock)
 {
 	struct smq_context_list *clst = &ctx->apps->clst;
 	struct fastrpc_apps *apps = ctx->apps;
-	struct ion_client *clnt = apps->iclient;
 	struct fastrpc_smmu *smmu = &apps->smmu;
 	struct fastrpc_buf *b;
 	int i, bufs;
-	if (ctx->smmu) {
+
+	if (ctx->maps) {
 		bufs = REMOTE_SCALARS_INBUFS(ctx->sc) +
 			REMOTE_SCALARS_OUTBUFS(ctx->sc);
-		if (ctx->fds) {
-			for (i = 0; i < bufs; i++)
-				if (!IS_ERR_OR_NULL(ctx->handles[i])) {
-					ion_unmap_iommu(clnt, ctx->handles[i],
-						smmu->domain_id, 0);
-					ion_free(clnt, ctx->handles[i]);
-				}
-		}
-		iommu_detach_group(smmu->domain, smmu->group);
+		for (i = 0; i < bufs; i++)
+			if (ctx->maps[i])
+				cached_map_put(ctx->maps[i]);
 	}
+	if (ctx->smmu)
+		iommu_detach_group(smmu->domain, smmu->group);
 	for (i = 0, b = ctx->abufs; i < ctx->nbufs; ++i, ++b)
 		free_mem(b);
 
 	kfree(ctx->abufs);
 	if (ctx->dev) {
+		struct fastrpc_buf *dbuf = &ctx->dev->buf;
+
+		/*
+		 * Keep the larger buffer this invoke needed as the buffer of
+		 * the process, so the next invoke with the same arguments
+		 * copies them into one buffer instead of allocating more.
+		 */
+		if (ctx->obuf.handle != dbuf->handle) {
+			if (ctx->obuf.size <= BUF_CACHE_MAX) {
+				free_mem(dbuf);
+				*dbuf = ctx->obuf;
+			} else {
+				free_mem(&ctx->obuf);
+			}
+		} else if (lock && ctx->need > dbuf->size &&
+			   ctx->need <= BUF_CACHE_MAX) {
+			struct fastrpc_buf nbuf;
+
+			nbuf.size = buf_page_size(ctx->need);
+			if (!alloc_mem(&nbuf)) {
+				free_mem(dbuf);
+				*dbuf = nbuf;
+			}
+		}
 		add_dev(apps, ctx->dev);
-		if (ctx->obuf.handle != ctx->dev->buf.handle)
-			free_mem(&ctx->obuf);
 	}
 	if (lock)
 		spin_lock(&clst->hlock);
@@ -426,6 +625,8 @@ static void context_free(struct smq_invoke_ctx *ctx, bool lock)
 
 static void context_notify_user(struct smq_invoke_ctx *ctx, int retval)
 {
+	if (ctx->prof)
+		ctx->ts[PHASE_DSP] = ktime_get();
 	ctx->retval = retval;
 	complete(&ctx->work);
 }
@@ -564,24 +765,23 @@ static int get_args(uint32_t kernel, struct smq_invoke_ctx *ctx,
 	struct fastrpc_buf *pbuf = &ctx->obuf, *obufs = NULL;
 	struct smq_phy_page *pages;
 	struct vm_area_struct *vma;
-	struct ion_handle **handles = ctx->handles;
+	struct fastrpc_cached_map *map;
 	void *args;
 	remote_arg_t *pra = ctx->pra;
 	remote_arg_t *rpra = ctx->rpra;
 	uint32_t sc = ctx->sc, start;
-	size_t rlen, used, size;
+	size_t rlen, used, size, need;
 	int i, inh, bufs = 0, err = 0;
 	int inbufs = REMOTE_SCALARS_INBUFS(sc);
 	int outbufs = REMOTE_SCALARS_OUTBUFS(sc);
 	int *fds = ctx->fds, idx, num;
-	unsigned long len;
-	ion_phys_addr_t iova;
 
 	list = smq_invoke_buf_start(rpra, sc);
 	pages = smq_phy_page_start(sc, list);
 	used = ALIGN(pbuf->used, BALIGN);
 	args = (void *)((char *)pbuf->virt + used);
 	rlen = pbuf->size - used;
+	need = used;
 	for (i = 0; i < inbufs + outbufs; ++i) {
 
 		rpra[i].buf.len = pra[i].buf.len;
@@ -589,26 +789,24 @@ static int get_args(uint32_t kernel, struct smq_invoke_ctx *ctx,
 			continue;
 		if (me->smmu.enabled && fds && (fds[i] >= 0)) {
 			start = buf_page_start(pra[i].buf.pv);
-			len = buf_page_size(pra[i].buf.len);
 			num = buf_num_pages(pra[i].buf.pv, pra[i].buf.len);
 			idx = list[i].pgidx;
-			handles[i] = ion_import_dma_buf(me->iclient, fds[i]);
-			VERIFY(err, 0 == IS_ERR_OR_NULL(handles[i]));
+			VERIFY(err, 0 != ctx->fdata);
 			if (err)
 				goto bail;
-			VERIFY(err, 0 == ion_map_iommu(me->iclient, handles[i],
-						me->smmu.domain_id, 0, SZ_4K, 0,
-						&iova, &len, 0, 0));
+			VERIFY(err, 0 == cached_map_get(ctx->fdata, fds[i],
+							&ctx->maps[i]));
 			if (err)
 				goto bail;
-			VERIFY(err, (num << PAGE_SHIFT) <= len);
+			map = ctx->maps[i];
+			VERIFY(err, (num << PAGE_SHIFT) <= map->len);
 			if (err)
 				goto bail;
 			VERIFY(err, 0 != (vma = find_vma(current->mm, start)));
 			if (err)
 				goto bail;
 			rpra[i].buf.pv = pra[i].buf.pv;
-			pages[idx].addr = iova + (start - vma->vm_start);
+			pages[idx].addr = map->iova + (start - vma->vm_start);
 			pages[idx].size = num << PAGE_SHIFT;
 			continue;
 		} else if (list[i].num) {
@@ -652,6 +850,7 @@ static int get_args(uint32_t kernel, struct smq_invoke_ctx *ctx,
 		rpra[i].buf.pv = args;
 		args = (void *)((char *)args + ALIGN(pra[i].buf.len, BALIGN));
 		rlen -= ALIGN(pra[i].buf.len, BALIGN);
+		need += ALIGN(pra[i].buf.len, BALIGN);
 	}
 	for (i = 0; i < inbufs; ++i) {
 		if (rpra[i].buf.len)
@@ -675,6 +874,7 @@ static int get_args(uint32_t kernel, struct smq_invoke_ctx *ctx,
  bail:
 	ctx->abufs = obufs;
 	ctx->nbufs = bufs;
+	ctx->need = bufs ? need : 0;
 	return err;
 }
 
@@ -946,16 +1146,105 @@ static void add_dev(struct fastrpc_apps *me, struct fastrpc_device *dev)
 	return;
 }
 
+static struct fastrpc_prof *prof_find(struct fastrpc_apps *me,
+				uint32_t handle, uint32_t method)
+{
+	struct fastrpc_prof *prof;
+	struct hlist_node *pos;
+	uint32_t h = hash_32(handle ^ (method << 24), RPC_HASH_BITS);
+
+	hlist_for_each_entry(prof, pos, &me->prof[h], hn) {
+		if (prof->handle == handle && prof->method == method)
+			return prof;
+	}
+	return NULL;
+}
+
+/*
+ * Adds a completed invoke to the profile of its handle and method. The
+ * phase ends were stamped in ctx->ts as the invoke went, the response by
+ * context_notify_user(). Invokes restarted after a signal are not
+ * accounted, their phases are not contiguous.
+ */
+static void fastrpc_prof_account(struct fastrpc_apps *me,
+				 struct smq_invoke_ctx *ctx, uint32_t handle,
+				 ktime_t start)
+{
+	struct fastrpc_prof *prof, *new = NULL;
+	uint32_t method = REMOTE_SCALARS_METHOD(ctx->sc);
+	uint32_t h = hash_32(handle ^ (method << 24), RPC_HASH_BITS);
+	s64 ns[PHASES], total;
+	int i, b;
+
+	total = ktime_to_ns(ktime_sub(ctx->ts[PHASES - 1], start));
+	for (i = 0; i < PHASES; i++) {
+		ns[i] = ktime_to_ns(ktime_sub(ctx->ts[i], start));
+		if (ns[i] < 0)
+			return;
+		start = ctx->ts[i];
+	}
+	b = min(fls64(div_u64(total, NSEC_PER_USEC)), PROF_HIST - 1);
+
+	spin_lock(&me->prof_lock);
+	prof = prof_find(me, handle, method);
+	spin_unlock(&me->prof_lock);
+	if (!prof && me->nprof < PROF_MAX)
+		new = kzalloc(sizeof(*new), GFP_KERNEL);
+
+	spin_lock(&me->prof_lock);
+	if (!prof)
+		prof = prof_find(me, handle, method);
+	if (!prof && new && me->nprof < PROF_MAX) {
+		prof = new;
+		new = NULL;
+		prof->handle = handle;
+		prof->method = method;
+		hlist_add_head(&prof->hn, &me->prof[h]);
+		me->nprof++;
+	}
+	if (prof) {
+		prof->count++;
+		for (i = 0; i < PHASES; i++)
+			prof->ns[i] += ns[i];
+		prof->max_ns = max_t(u64, prof->max_ns, total);
+		prof->hist[b]++;
+	}
+	spin_unlock(&me->prof_lock);
+	kfree(new);
+}
+
+static void fastrpc_prof_reset(struct fastrpc_apps *me)
+{
+	struct fastrpc_prof *prof;
+	struct hlist_node *pos, *n;
+	HLIST_HEAD(list);
+	int i;
+
+	spin_lock(&me->prof_lock);
+	for (i = 0; i < RPC_HASH_SZ; i++) {
+		hlist_for_each_entry_safe(prof, pos, n, &me->prof[i], hn) {
+			hlist_del(&prof->hn);
+			hlist_add_head(&prof->hn, &list);
+		}
+	}
+	me->nprof = 0;
+	spin_unlock(&me->prof_lock);
+	hlist_for_each_entry_safe(prof, pos, n, &list, hn)
+		kfree(prof);
+}
+
 static int fastrpc_release_current_dsp_process(void);
 
 static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
-			uint32_t kernel,
+			uint32_t kernel, struct file_data *fdata,
 			struct fastrpc_ioctl_invoke_fd *invokefd)
 {
 	struct smq_invoke_ctx *ctx = NULL;
 	struct fastrpc_ioctl_invoke *invoke = &invokefd->inv;
 	int interrupted = 0;
 	int err = 0;
+	bool prof = ACCESS_ONCE(me->profile);
+	ktime_t start = prof ? ktime_get() : ktime_set(0, 0);
 
 	if (!kernel) {
 		VERIFY(err, 0 == context_restore_interrupted(me, invokefd,
@@ -969,6 +1258,8 @@ static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
 	VERIFY(err, 0 == context_alloc(me, kernel, invokefd, &ctx));
 	if (err)
 		goto bail;
+	ctx->fdata = fdata;
+	ctx->prof = prof;
 
 	if (me->smmu.enabled) {
 		VERIFY(err, 0 == iommu_attach_group(me->smmu.domain,
@@ -981,6 +1272,10 @@ static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
 		VERIFY(err, 0 == get_dev(me, &ctx->dev));
 		if (err)
 			goto bail;
+	}
+	if (prof)
+		ctx->ts[PHASE_ALLOC] = ktime_get();
+	if (REMOTE_SCALARS_LENGTH(ctx->sc)) {
 		VERIFY(err, 0 == get_page_list(kernel, ctx));
 		if (err)
 			goto bail;
@@ -989,14 +1284,20 @@ static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
 		if (err)
 			goto bail;
 	}
+	if (prof)
+		ctx->ts[PHASE_ARGS] = ktime_get();
 
 	inv_args_pre(ctx->sc, ctx->rpra);
 	if (FASTRPC_MODE_SERIAL == mode)
 		inv_args(ctx->sc, ctx->rpra, ctx->obuf.used);
+	if (prof)
+		ctx->ts[PHASE_CACHE] = ktime_get();
 	VERIFY(err, 0 == fastrpc_invoke_send(me, kernel, invoke->handle,
 						ctx->sc, ctx, &ctx->obuf));
 	if (err)
 		goto bail;
+	if (prof)
+		ctx->ts[PHASE_SEND] = ktime_get();
 	if (FASTRPC_MODE_PARALLEL == mode)
 		inv_args(ctx->sc, ctx->rpra, ctx->obuf.used);
  wait:
@@ -1008,6 +1309,8 @@ static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
 		if (err)
 			goto bail;
 	}
+	if (ctx->prof)
+		ctx->ts[PHASE_WAKE] = ktime_get();
 	VERIFY(err, 0 == (err = ctx->retval));
 	if (err)
 		goto bail;
@@ -1015,6 +1318,10 @@ static int fastrpc_internal_invoke(struct fastrpc_apps *me, uint32_t mode,
 					invoke->pra));
 	if (err)
 		goto bail;
+	if (prof && ctx->prof) {
+		ctx->ts[PHASE_PUT] = ktime_get();
+		fastrpc_prof_account(me, ctx, invoke->handle, start);
+	}
  bail:
 	if (ctx && interrupted == -ERESTARTSYS)
 		context_save_interrupted(ctx);
@@ -1039,7 +1346,7 @@ static int fastrpc_create_current_dsp_process(void)
 	ioctl.inv.pra = ra;
 	ioctl.fds = 0;
 	VERIFY(err, 0 == (err = fastrpc_internal_invoke(me,
-		FASTRPC_MODE_PARALLEL, 1, &ioctl)));
+		FASTRPC_MODE_PARALLEL, 1, NULL, &ioctl)));
 	return err;
 }
 
@@ -1059,7 +1366,7 @@ static int fastrpc_release_current_dsp_process(void)
 	ioctl.inv.pra = ra;
 	ioctl.fds = 0;
 	VERIFY(err, 0 == (err = fastrpc_internal_invoke(me,
-		FASTRPC_MODE_PARALLEL, 1, &ioctl)));
+		FASTRPC_MODE_PARALLEL, 1, NULL, &ioctl)));
 	return err;
 }
 
@@ -1099,7 +1406,7 @@ static int fastrpc_mmap_on_dsp(struct fastrpc_apps *me,
 	ioctl.inv.pra = ra;
 	ioctl.fds = 0;
 	VERIFY(err, 0 == (err = fastrpc_internal_invoke(me,
-		FASTRPC_MODE_PARALLEL, 1, &ioctl)));
+		FASTRPC_MODE_PARALLEL, 1, NULL, &ioctl)));
 	mmap->vaddrout = routargs.vaddrout;
 	if (err)
 		goto bail;
@@ -1130,7 +1437,7 @@ static int fastrpc_munmap_on_dsp(struct fastrpc_apps *me,
 	ioctl.inv.pra = ra;
 	ioctl.fds = 0;
 	VERIFY(err, 0 == (err = fastrpc_internal_invoke(me,
-		FASTRPC_MODE_PARALLEL, 1, &ioctl)));
+		FASTRPC_MODE_PARALLEL, 1, NULL, &ioctl)));
 	return err;
 }
 
@@ -1287,6 +1594,7 @@ static int fastrpc_device_release(struct inode *inode, struct file *file)
 			free_map(map);
 			kfree(map);
 		}
+		cached_map_release(fdata);
 		mutex_destroy(&fdata->map_mutex);
 		kfree(fdata);
 		kref_put_mutex(&me->kref, fastrpc_channel_close,
@@ -1329,6 +1637,7 @@ static int fastrpc_device_open(struct inode *inode, struct file *filp)
 
 		spin_lock_init(&fdata->hlock);
 		INIT_HLIST_HEAD(&fdata->hlst);
+		INIT_HLIST_HEAD(&fdata->maps);
 
 		VERIFY(err, 0 == fastrpc_create_current_dsp_process());
 		if (err)
@@ -1376,7 +1685,7 @@ static long fastrpc_device_ioctl(struct file *file, unsigned int ioctl_num,
 		if (err)
 			goto bail;
 		VERIFY(err, 0 == (err = fastrpc_internal_invoke(me, fdata->mode,
-						0, &invokefd)));
+						0, fdata, &invokefd)));
 		if (err)
 			goto bail;
 		break;
@@ -1428,12 +1737,93 @@ static const struct file_operations fops = {
 	.unlocked_ioctl = fastrpc_device_ioctl,
 };
 
+static const char *fastrpc_phase_names[PHASES] = {
+	[PHASE_ALLOC]	= "alloc",
+	[PHASE_ARGS]	= "args",
+	[PHASE_CACHE]	= "cache",
+	[PHASE_SEND]	= "send",
+	[PHASE_DSP]	= "dsp",
+	[PHASE_WAKE]	= "wake",
+	[PHASE_PUT]	= "put",
+};
+
+static int fastrpc_prof_show(struct seq_file *m, void *unused)
+{
+	struct fastrpc_apps *me = m->private;
+	struct fastrpc_prof *prof;
+	struct hlist_node *pos;
+	int i, j;
+
+	seq_puts(m, "# avg usecs per phase, hist[i] counts invokes taking "
+		 "under 2^i usecs\n");
+	spin_lock(&me->prof_lock);
+	for (i = 0; i < RPC_HASH_SZ; i++) {
+		hlist_for_each_entry(prof, pos, &me->prof[i], hn) {
+			seq_printf(m, "handle 0x%x method %u count %llu max %llu\n",
+				   prof->handle, prof->method, prof->count,
+				   div_u64(prof->max_ns, NSEC_PER_USEC));
+			for (j = 0; j < PHASES; j++)
+				seq_printf(m, " %s %llu", fastrpc_phase_names[j],
+					   div64_u64(prof->ns[j], prof->count *
+						     NSEC_PER_USEC));
+			seq_puts(m, "\n hist");
+			for (j = 0; j < PROF_HIST; j++)
+				seq_printf(m, " %u", prof->hist[j]);
+			seq_putc(m, '\n');
+		}
+	}
+	spin_unlock(&me->prof_lock);
+	return 0;
+}
+
+static int fastrpc_prof_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fastrpc_prof_show, inode->i_private);
+}
+
+/* any write clears the profiles */
+static ssize_t fastrpc_prof_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+
+	fastrpc_prof_reset(m->private);
+	return count;
+}
+
+static const struct file_operations fastrpc_prof_fops = {
+	.open		= fastrpc_prof_open,
+	.read		= seq_read,
+	.write		= fastrpc_prof_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void fastrpc_debugfs_init(struct fastrpc_apps *me)
+{
+	int i;
+
+	spin_lock_init(&me->prof_lock);
+	for (i = 0; i < RPC_HASH_SZ; ++i)
+		INIT_HLIST_HEAD(&me->prof[i]);
+	me->debugfs = debugfs_create_dir("adsprpc", NULL);
+	if (IS_ERR_OR_NULL(me->debugfs)) {
+		me->debugfs = NULL;
+		return;
+	}
+	debugfs_create_bool("profile_enable", 0644, me->debugfs,
+			    &me->profile);
+	debugfs_create_file("profile", 0644, me->debugfs, me,
+			    &fastrpc_prof_fops);
+}
+
 static int __init fastrpc_device_init(void)
 {
 	struct fastrpc_apps *me = &gfa;
 	int err = 0;
 
 	memset(me, 0, sizeof(*me));
+	fastrpc_debugfs_init(me);
 	VERIFY(err, 0 == fastrpc_init());
 	if (err)
 		goto fastrpc_bail;
@@ -1466,6 +1856,7 @@ cdev_init_bail:
 alloc_chrdev_bail:
 	fastrpc_deinit();
 fastrpc_bail:
+	debugfs_remove_recursive(me->debugfs);
 	return err;
 }
 
@@ -1480,6 +1871,8 @@ static void __exit fastrpc_device_exit(void)
 	class_destroy(me->class);
 	cdev_del(&me->cdev);
 	unregister_chrdev_region(me->dev_no, 1);
+	debugfs_remove_recursive(me->debugfs);
+	fastrpc_prof_reset(me);
 }
 
 module_init(fastrpc_device_init);
@@ -20,6 +20,7 @@
 #include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
+#include <linux/timer.h>
 #include <linux/sched.h>
 #include <linux/wakelock.h>
 #include <mach/msm_smd.h>
@@ -299,6 +300,19 @@ struct diag_smd_info {
 						void *buf, int num_bytes);
 };
 
+struct diag_md_ring {
+	struct diag_md_ring_hdr *hdr;	/* start of the mapping */
+	unsigned char *data;
+	uint32_t size;
+	unsigned long map_size;
+	uint32_t head;
+	uint32_t watermark;
+	unsigned int flush_ms;
+	struct file *file;
+	int pid;
+	struct timer_list flush_timer;
+};
+
 struct diagchar_dev {
 
 	/* State for the char driver */
@@ -464,6 +478,9 @@ struct diagchar_dev {
 	spinlock_t ws_lock;
 	int ws_ref_count;
 	int copy_count;
+	/* Memory device ring of the logging process */
+	struct diag_md_ring *md_ring;
+	spinlock_t md_ring_lock;
 };
 
 extern struct diag_bridge_dev *diag_bridge;
@@ -476,5 +493,6 @@ extern uint16_t wrap_count;
 void diag_get_timestamp(char *time_str);
 int diag_find_polling_reg(int i);
 void check_drain_timer(void);
+int diag_md_ring_append(int peripheral, void *buf, int len);
 
 #endif
@@ -23,6 +23,9 @@
 #include <linux/platform_device.h>
 #include <linux/sched.h>
 #include <linux/ratelimit.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 #ifdef CONFIG_DIAG_OVER_USB
 #include <mach/usbdiag.h>
 #endif
@@ -184,6 +187,202 @@ void diag_clear_hsic_tbl(void)
 void diag_clear_hsic_tbl(void) { }
 #endif
 
+#define DIAG_MD_RING_MIN_SIZE	(64 * 1024)
+#define DIAG_MD_RING_MAX_SIZE	(16 * 1024 * 1024)
+#define DIAG_MD_RING_FLUSH_MS	100
+
+/* Must be called with md_ring_lock held */
+static void diag_md_ring_wake(struct diag_md_ring *ring)
+{
+	int i;
+
+	for (i = 0; i < driver->num_clients; i++) {
+		if (driver->client_map[i].pid == ring->pid) {
+			driver->data_ready[i] |= MD_RING_DATA_TYPE;
+			wake_up_interruptible(&driver->wait_q);
+			break;
+		}
+	}
+}
+
+static void diag_md_ring_flush(unsigned long data)
+{
+	struct diag_md_ring *ring;
+	unsigned long flags;
+
+	spin_lock_irqsave(&driver->md_ring_lock, flags);
+	ring = driver->md_ring;
+	if (ring && ring->head != ACCESS_ONCE(ring->hdr->tail))
+		diag_md_ring_wake(ring);
+	spin_unlock_irqrestore(&driver->md_ring_lock, flags);
+}
+
+/**
+ * diag_md_ring_append() - Copy a peripheral packet to the memory device ring
+ * @peripheral: Peripheral the packet came from
+ * @buf: Packet data
+ * @len: Number of bytes in @buf
+ *
+ * Returns 0 if the packet is in the ring and @buf can be reused right away,
+ * or an error if it has to be handed to the logging process by read().
+ * The reader is woken once the watermark is reached, or by the flush timer.
+ */
+int diag_md_ring_append(int peripheral, void *buf, int len)
+{
+	struct diag_md_ring *ring;
+	struct diag_md_ring_rec *rec;
+	unsigned long flags;
+	uint32_t tail, used, off, contig, need;
+	int err = 0;
+
+	if (len <= 0)
+		return -EINVAL;
+
+	need = ALIGN(sizeof(*rec) + len, DIAG_MD_RING_ALIGN);
+
+	spin_lock_irqsave(&driver->md_ring_lock, flags);
+	ring = driver->md_ring;
+	if (!ring || ring->pid != driver->logging_process_id) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	tail = ACCESS_ONCE(ring->hdr->tail);
+	/* Don't reuse the space before the reader is done with it */
+	smp_mb();
+	used = ring->head - tail;
+	off = ring->head & (ring->size - 1);
+	contig = ring->size - off;
+	if (used > ring->size ||
+	    need + (need > contig ? contig : 0) > ring->size - used) {
+		ring->hdr->overflow++;
+		diag_md_ring_wake(ring);
+		err = -ENOSPC;
+		goto out;
+	}
+
+	if (need > contig) {
+		/* Records don't wrap, skip what is left at the end */
+		rec = (struct diag_md_ring_rec *)(ring->data + off);
+		rec->type = DIAG_MD_RING_REC_PAD;
+		rec->peripheral = peripheral;
+		rec->len = contig - sizeof(*rec);
+		ring->head += contig;
+		used += contig;
+		off = 0;
+	}
+
+	rec = (struct diag_md_ring_rec *)(ring->data + off);
+	rec->type = DIAG_MD_RING_REC_DATA;
+	rec->peripheral = peripheral;
+	rec->len = len;
+	memcpy(rec + 1, buf, len);
+	ring->head += need;
+	used += need;
+
+	/* Publish the records before the head that covers them */
+	smp_wmb();
+	ring->hdr->head = ring->head;
+	diag_ws_on_copy();
+
+	if (used >= ring->watermark)
+		diag_md_ring_wake(ring);
+	else if (!timer_pending(&ring->flush_timer))
+		mod_timer(&ring->flush_timer,
+			  jiffies + msecs_to_jiffies(ring->flush_ms));
+out:
+	spin_unlock_irqrestore(&driver->md_ring_lock, flags);
+	return err;
+}
+
+static int diag_md_ring_init(struct file *file, unsigned long ioarg)
+{
+	struct diag_md_ring_params params;
+	struct diag_md_ring *ring;
+	unsigned long flags;
+	int err = 0;
+
+	if (copy_from_user(&params, (void __user *)ioarg, sizeof(params)))
+		return -EFAULT;
+
+	if (params.size < DIAG_MD_RING_MIN_SIZE ||
+	    params.size > DIAG_MD_RING_MAX_SIZE ||
+	    !is_power_of_2(params.size) || params.watermark > params.size)
+		return -EINVAL;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (!ring)
+		return -ENOMEM;
+
+	ring->map_size = PAGE_ALIGN(DIAG_MD_RING_HDR_SIZE + params.size);
+	ring->hdr = vmalloc_user(ring->map_size);
+	if (!ring->hdr) {
+		kfree(ring);
+		return -ENOMEM;
+	}
+
+	ring->data = (unsigned char *)ring->hdr + DIAG_MD_RING_HDR_SIZE;
+	ring->size = params.size;
+	ring->watermark = params.watermark ? : params.size / 4;
+	ring->flush_ms = params.flush_ms ? : DIAG_MD_RING_FLUSH_MS;
+	ring->file = file;
+	ring->pid = current->tgid;
+	setup_timer(&ring->flush_timer, diag_md_ring_flush, 0);
+	ring->hdr->version = DIAG_MD_RING_VERSION;
+	ring->hdr->size = params.size;
+
+	spin_lock_irqsave(&driver->md_ring_lock, flags);
+	if (driver->md_ring)
+		err = -EBUSY;
+	else
+		driver->md_ring = ring;
+	spin_unlock_irqrestore(&driver->md_ring_lock, flags);
+
+	if (err) {
+		vfree(ring->hdr);
+		kfree(ring);
+	}
+	return err;
+}
+
+/* The mapping holds a file reference, so this only runs once it is gone */
+static void diag_md_ring_free(struct file *file)
+{
+	struct diag_md_ring *ring = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&driver->md_ring_lock, flags);
+	if (driver->md_ring && driver->md_ring->file == file) {
+		ring = driver->md_ring;
+		driver->md_ring = NULL;
+	}
+	spin_unlock_irqrestore(&driver->md_ring_lock, flags);
+
+	if (!ring)
+		return;
+
+	del_timer_sync(&ring->flush_timer);
+	vfree(ring->hdr);
+	kfree(ring);
+}
+
+static int diagchar_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct diag_md_ring *ring;
+	unsigned long flags;
+
+	spin_lock_irqsave(&driver->md_ring_lock, flags);
+	ring = driver->md_ring;
+	if (ring && ring->file != file)
+		ring = NULL;
+	spin_unlock_irqrestore(&driver->md_ring_lock, flags);
+
+	if (!ring)
+		return -ENODEV;
+
+	return remap_vmalloc_range(vma, ring->hdr, vma->vm_pgoff);
+}
+
 void diag_add_client(int i, struct file *file)
 {
 	struct diagchar_priv *diagpriv_data;
@@ -352,6 +551,7 @@ static int diag_remove_client_entry(struct file *file)
 static int diagchar_close(struct inode *inode, struct file *file)
 {
 	pr_debug("diag: process exit %s\n", current->comm);
+	diag_md_ring_free(file);
 	return diag_remove_client_entry(file);
 }
 
@@ -1002,6 +1202,9 @@ long diagchar_ioctl(struct file *filp,
 	case DIAG_IOCTL_COMMAND_REG:
 		result = diag_command_reg(ioarg);
 		break;
+	case DIAG_IOCTL_MD_RING_INIT:
+		result = diag_md_ring_init(filp, ioarg);
+		break;
 	case DIAG_IOCTL_GET_DELAYED_RSP_ID:
 		if (copy_from_user(&delay_params, (void *)ioarg,
 					sizeof(struct diagpkt_delay_params)))
@@ -1345,6 +1548,15 @@ drop:
 		driver->data_ready[index] ^= USER_SPACE_DATA_TYPE;
 	}
 
+	if (driver->data_ready[index] & MD_RING_DATA_TYPE) {
+		/* The records themselves are read from the mapping */
+		data_type = driver->data_ready[index] & MD_RING_DATA_TYPE;
+		driver->data_ready[index] ^= MD_RING_DATA_TYPE;
+		COPY_USER_SPACE_OR_EXIT(buf, data_type, 4);
+		copy_data = 1;
+		goto exit;
+	}
+
 	if (driver->data_ready[index] & DEINIT_TYPE) {
 		/*Copy the type of data being passed*/
 		data_type = driver->data_ready[index] & DEINIT_TYPE;
@@ -2051,6 +2263,7 @@ static const struct file_operations diagcharfops = {
 	.read = diagchar_read,
 	.write = diagchar_write,
 	.unlocked_ioctl = diagchar_ioctl,
+	.mmap = diagchar_mmap,
 	.open = diagchar_open,
 	.release = diagchar_close
 };
@@ -2187,6 +2400,7 @@ static int __init diagchar_init(void)
 		driver->in_busy_dcipktdata = 0;
 		mutex_init(&driver->diagchar_mutex);
 		mutex_init(&driver->diag_file_mutex);
+		spin_lock_init(&driver->md_ring_lock);
 		init_waitqueue_head(&driver->wait_q);
 		init_waitqueue_head(&driver->smd_wait_q);
 		INIT_WORK(&(driver->diag_drain_work), diag_drain_work_fn);
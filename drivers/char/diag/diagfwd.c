@@ -61,6 +61,37 @@ int diag_debug_buf_idx;
 unsigned char diag_debug_buf[1024];
 /* Number of entries in table of buffers */
 static unsigned int buf_tbl_size = 10;
+
+/*
+ * Don't offer HDLC encoding in apps to the peripherals.  They then send
+ * data that is already encoded, which goes to USB straight from the smd
+ * read buffers without an encoding pass or a copy on the apps side.
+ */
+static bool hdlc_pass_through;
+module_param(hdlc_pass_through, bool, 0444);
+MODULE_PARM_DESC(hdlc_pass_through, "Leave HDLC encoding to the peripherals");
+
+/*
+ * Extra read buffers for encoded smd data that keeps arriving while both
+ * buffers of a channel are queued to USB, as it does with heavy logging.
+ */
+static unsigned int smd_burst_bufs = 16;
+module_param(smd_burst_bufs, uint, 0444);
+MODULE_PARM_DESC(smd_burst_bufs, "Number of smd burst buffers");
+
+struct diag_burst_buf {
+	struct diag_request write_ptr;
+	struct diag_smd_info *smd_info;
+	unsigned char *buf;
+	struct list_head list;
+};
+
+static struct {
+	struct diag_burst_buf *entries;
+	unsigned int num;
+	struct list_head free;
+	spinlock_t lock;
+} diag_burst;
 struct diag_master_table entry;
 int wrap_enabled;
 uint16_t wrap_count;
@@ -432,11 +463,127 @@ void diag_ws_reset()
 	spin_unlock_irqrestore(&driver->ws_lock, flags);
 }
 
+static void diag_burst_init(void)
+{
+	struct diag_burst_buf *entry;
+	unsigned int i;
+
+	INIT_LIST_HEAD(&diag_burst.free);
+	spin_lock_init(&diag_burst.lock);
+	if (!smd_burst_bufs)
+		return;
+
+	diag_burst.entries = kcalloc(smd_burst_bufs,
+				     sizeof(*diag_burst.entries), GFP_KERNEL);
+	if (!diag_burst.entries) {
+		pr_err("diag: In %s, unable to allocate burst buffers\n",
+			__func__);
+		return;
+	}
+
+	for (i = 0; i < smd_burst_bufs; i++) {
+		entry = &diag_burst.entries[i];
+		entry->buf = kmalloc(IN_BUF_SIZE, GFP_KERNEL);
+		if (!entry->buf)
+			break;
+		kmemleak_not_leak(entry->buf);
+		list_add_tail(&entry->list, &diag_burst.free);
+	}
+	diag_burst.num = i;
+}
+
+static void diag_burst_exit(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < diag_burst.num; i++)
+		kfree(diag_burst.entries[i].buf);
+	kfree(diag_burst.entries);
+	diag_burst.entries = NULL;
+	diag_burst.num = 0;
+	INIT_LIST_HEAD(&diag_burst.free);
+}
+
+static struct diag_burst_buf *diag_burst_get(struct diag_smd_info *smd_info)
+{
+	struct diag_burst_buf *entry = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&diag_burst.lock, flags);
+	if (!list_empty(&diag_burst.free)) {
+		entry = list_first_entry(&diag_burst.free,
+					 struct diag_burst_buf, list);
+		list_del(&entry->list);
+		entry->smd_info = smd_info;
+	}
+	spin_unlock_irqrestore(&diag_burst.lock, flags);
+
+	return entry;
+}
+
+static void diag_burst_put(struct diag_burst_buf *entry)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&diag_burst.lock, flags);
+	entry->smd_info = NULL;
+	list_add(&entry->list, &diag_burst.free);
+	spin_unlock_irqrestore(&diag_burst.lock, flags);
+}
+
+static struct diag_burst_buf *diag_burst_find(void *buf)
+{
+	unsigned int i;
+
+	for (i = 0; i < diag_burst.num; i++)
+		if (diag_burst.entries[i].buf == buf)
+			return &diag_burst.entries[i];
+
+	return NULL;
+}
+
+static struct diag_burst_buf *diag_burst_from_req(struct diag_request *req)
+{
+	void *p = req;
+
+	if (!diag_burst.num || p < (void *)diag_burst.entries ||
+	    p >= (void *)(diag_burst.entries + diag_burst.num))
+		return NULL;
+
+	return container_of(req, struct diag_burst_buf, write_ptr);
+}
+
+/* Hand a burst buffer to USB, returns 1 if the channel should be polled */
+static int diag_smd_write_burst(struct diag_burst_buf *burst, int total_recd)
+{
+	int err;
+
+	/* Only a USB write completion returns the buffer */
+	if (driver->logging_mode != USB_MODE) {
+		diag_burst_put(burst);
+		return 0;
+	}
+
+	burst->write_ptr.length = total_recd;
+	err = diag_device_write(burst->buf, burst->smd_info->peripheral,
+				&burst->write_ptr);
+	if (err) {
+		pr_err_ratelimited("diag: In %s, diag_device_write error: %d\n",
+			__func__, err);
+		diag_burst_put(burst);
+		return 0;
+	}
+
+	/* Keep draining the channel while USB holds its buffers */
+	return 1;
+}
+
 /* Process the data read from the smd data channel */
 int diag_process_smd_read_data(struct diag_smd_info *smd_info, void *buf,
 			       int total_recd)
 {
 	struct diag_request *write_ptr_modem = NULL;
+	struct diag_burst_buf *burst;
 	int *in_busy_ptr = 0;
 	int err = 0;
 	unsigned long flags;
@@ -461,6 +608,8 @@ int diag_process_smd_read_data(struct diag_smd_info *smd_info, void *buf,
 		} else if (smd_info->buf_in_2 == buf) {
 			write_ptr_modem = smd_info->write_ptr_2;
 			in_busy_ptr = &smd_info->in_busy_2;
+		} else if ((burst = diag_burst_find(buf)) != NULL) {
+			return diag_smd_write_burst(burst, total_recd);
 		} else {
 			pr_err("diag: In %s, no match for in_busy_1, peripheral: %d\n",
 				__func__, smd_info->peripheral);
@@ -666,6 +815,7 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 	int buf_size = 0;
 	int resize_success = 0;
 	int buf_full = 0;
+	struct diag_burst_buf *burst = NULL;
 
 	if (!smd_info) {
 		pr_err("diag: In %s, no smd info. Not able to read.\n",
@@ -691,6 +841,16 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 			} else if (!smd_info->in_busy_2) {
 				buf = smd_info->buf_in_2;
 				buf_size = smd_info->buf_in_2_size;
+			} else if (driver->logging_mode == USB_MODE &&
+				   driver->usb_connected && smd_info->ch) {
+				/* Both buffers are with USB, use a spare */
+				pkt_len = smd_cur_packet_size(smd_info->ch);
+				if (pkt_len > 0 && pkt_len <= IN_BUF_SIZE)
+					burst = diag_burst_get(smd_info);
+				if (burst) {
+					buf = burst->buf;
+					buf_size = IN_BUF_SIZE;
+				}
 			}
 		}
 	} else if (smd_info->type == SMD_CMD_TYPE) {
@@ -821,6 +981,8 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 					diag_smd_notify(smd_info,
 							SMD_EVENT_DATA);
 			}
+		} else if (burst) {
+			diag_burst_put(burst);
 		}
 	} else if (smd_info->ch && !buf &&
 		(driver->logging_mode == MEMORY_DEVICE_MODE)) {
@@ -835,6 +997,9 @@ void diag_smd_send_req(struct diag_smd_info *smd_info)
 	return;
 
 fail_return:
+	if (burst)
+		diag_burst_put(burst);
+
 	if ((smd_info->type == SMD_DATA_TYPE ||
 	     smd_info->type == SMD_CMD_TYPE) &&
 	     driver->logging_mode == MEMORY_DEVICE_MODE)
@@ -891,12 +1056,39 @@ static int diag_write_to_usb(struct usb_diag_ch *ch,
 }
 #endif
 
+/* An smd buffer was copied to the memory device ring, read into it again */
+static void diag_md_ring_release(int peripheral, void *buf)
+{
+	struct diag_smd_info *smd_info = &driver->smd_data[peripheral];
+
+	if (buf == smd_info->buf_in_1) {
+		smd_info->in_busy_1 = 0;
+	} else if (buf == smd_info->buf_in_2) {
+		smd_info->in_busy_2 = 0;
+	} else if (peripheral < NUM_SMD_CMD_CHANNELS &&
+		   buf == driver->smd_cmd[peripheral].buf_in_1) {
+		smd_info = &driver->smd_cmd[peripheral];
+		smd_info->in_busy_1 = 0;
+		queue_work(driver->diag_wq, &(smd_info->diag_read_smd_work));
+		return;
+	} else {
+		return;
+	}
+	queue_work(smd_info->wq, &(smd_info->diag_read_smd_work));
+}
+
 int diag_device_write(void *buf, int data_type, struct diag_request *write_ptr)
 {
 	int i, err = 0, index;
 	index = 0;
 
 	if (driver->logging_mode == MEMORY_DEVICE_MODE) {
+		if ((data_type >= MODEM_DATA) && (data_type <= WCNSS_DATA) &&
+		    write_ptr && !diag_md_ring_append(data_type, buf,
+						      write_ptr->length)) {
+			diag_md_ring_release(data_type, buf);
+			return 0;
+		}
 		if (data_type == APPS_DATA) {
 			for (i = 0; i < driver->buf_tbl_size; i++)
 				if (driver->buf_tbl[i].length == 0) {
@@ -2078,6 +2270,16 @@ int diagfwd_write_complete(struct diag_request *diag_write_ptr)
 {
 	unsigned char *buf = diag_write_ptr->buf;
 	int found_it = 0;
+	struct diag_burst_buf *burst;
+
+	burst = diag_burst_from_req(diag_write_ptr);
+	if (burst) {
+		struct diag_smd_info *smd_info = burst->smd_info;
+
+		diag_burst_put(burst);
+		queue_work(smd_info->wq, &(smd_info->diag_read_smd_work));
+		return 0;
+	}
 
 	/* Determine if the write complete is for data from modem/apps/q6 */
 	found_it = diagfwd_check_buf_match(NUM_SMD_DATA_CHANNELS,
@@ -2593,7 +2795,8 @@ void diagfwd_init(void)
 	driver->buf_tbl_size = (buf_tbl_size < driver->poolsize_hdlc) ?
 				driver->poolsize_hdlc : buf_tbl_size;
 	driver->supports_separate_cmdrsp = device_supports_separate_cmdrsp();
-	driver->supports_apps_hdlc_encoding = 1;
+	driver->supports_apps_hdlc_encoding = !hdlc_pass_through;
+	diag_burst_init();
 	mutex_init(&driver->diag_hdlc_mutex);
 	mutex_init(&driver->diag_cntl_mutex);
 	spin_lock_init(&driver->ws_lock);
@@ -2738,6 +2941,7 @@ err:
 	kfree(driver->usb_read_ptr);
 	kfree(driver->apps_rsp_buf);
 	kfree(driver->user_space_data_buf);
+	diag_burst_exit();
 	if (driver->diag_wq)
 		destroy_workqueue(driver->diag_wq);
 	if (driver->diag_usb_wq)
@@ -2779,6 +2983,7 @@ void diagfwd_exit(void)
 	kfree(driver->usb_read_ptr);
 	kfree(driver->apps_rsp_buf);
 	kfree(driver->user_space_data_buf);
+	diag_burst_exit();
 	destroy_workqueue(driver->diag_wq);
 	destroy_workqueue(driver->diag_usb_wq);
 }
@@ -28,6 +28,9 @@
 #include <linux/major.h>
 #include <linux/regulator/consumer.h>
 #include <linux/msm_ion.h>
+#include <linux/slab.h>
+#include <linux/sync.h>
+#include <linux/sw_sync.h>
 #ifdef CONFIG_MSM_BUS_SCALING
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
@@ -88,6 +91,7 @@
 #define INVALID_SESSION -1
 #define VERSION_KEY_MASK 0xFFFFFF00
 #define MAX_DOWNSCALE_RATIO 3
+#define ROTATOR_FENCE_TIMEOUT 1000 /* ms */
 
 #define ROTATOR_REVISION_V0		0
 #define ROTATOR_REVISION_V1		1
@@ -126,6 +130,31 @@ struct msm_rotator_fd_info {
 	struct list_head list;
 };
 
+/* buffer sync of a session, taken by its next rotation */
+struct msm_rotator_session_sync {
+	struct sync_fence *acq_fence;
+	u32 rel_value;
+	bool pending;
+};
+
+/* a rotation queued behind its acquire fence */
+struct msm_rotator_job {
+	struct list_head list;
+	struct msm_rotator_img_info img_info;
+	int session_idx;
+	bool mapped;
+	unsigned int in_paddr, out_paddr;
+	unsigned int in_chroma_paddr, out_chroma_paddr;
+	unsigned int in_chroma2_paddr;
+	struct file *srcp0_file;
+	struct ion_handle *srcp0_ihdl, *dstp0_ihdl;
+	struct ion_handle *srcp1_ihdl, *dstp1_ihdl;
+	int ps0_need;
+	uint32_t src_flags;
+	struct sync_fence *acq_fence;
+	u32 rel_value;
+};
+
 struct msm_rotator_dev {
 	void __iomem *io_base;
 	int irq;
@@ -152,6 +181,14 @@ struct msm_rotator_dev {
 	int imem_owner;
 	wait_queue_head_t wq;
 	struct ion_client *client;
+	struct sw_sync_timeline *timeline;
+	u32 timeline_value;
+	u32 timeline_signaled;
+	struct msm_rotator_session_sync sync[MAX_SESSIONS];
+	struct list_head job_list;
+	spinlock_t job_lock;
+	struct workqueue_struct *rot_wq;
+	struct work_struct commit_work;
 	#ifdef CONFIG_MSM_BUS_SCALING
 	uint32_t bus_client_handle;
 	#endif
@@ -912,180 +949,184 @@ static void put_img(struct file *p_file, struct ion_handle *p_ihdl,
 	}
 #endif
 }
-static int msm_rotator_do_rotate(unsigned long arg)
+/*
+ * Map the buffers of a rotation request into job, and check them against
+ * the image sizes of its session. On failure whatever was mapped is left
+ * in job for msm_rotator_unmap_job(). Called with rotator_lock held.
+ */
+static int msm_rotator_map_job(struct msm_rotator_data_info *info,
+			       struct msm_rotator_job *job)
 {
-	unsigned int status, format;
-	struct msm_rotator_data_info info;
-	unsigned int in_paddr, out_paddr;
-	unsigned long src_len, dst_len;
-	int use_imem = 0, rc = 0, s;
-	struct file *srcp0_file = NULL, *dstp0_file = NULL;
-	struct file *srcp1_file = NULL, *dstp1_file = NULL;
-	struct ion_handle *srcp0_ihdl = NULL, *dstp0_ihdl = NULL;
-	struct ion_handle *srcp1_ihdl = NULL, *dstp1_ihdl = NULL;
-	int ps0_need, p_need;
-	unsigned int in_chroma_paddr = 0, out_chroma_paddr = 0;
-	unsigned int in_chroma2_paddr = 0;
-	struct msm_rotator_img_info *img_info;
+	struct msm_rotator_img_info *img_info = &job->img_info;
 	struct msm_rotator_mem_planes src_planes, dst_planes;
+	struct file *srcp1_file = NULL, *dstp0_file = NULL;
+	struct file *dstp1_file = NULL;
+	unsigned long src_len, dst_len;
+	int p_need, rc;
 
-	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
-		return -EFAULT;
-
-	mutex_lock(&msm_rotator_dev->rotator_lock);
-	for (s = 0; s < MAX_SESSIONS; s++)
-		if ((msm_rotator_dev->img_info[s] != NULL) &&
-			(info.session_id ==
-			(unsigned int)msm_rotator_dev->img_info[s]
-			))
-			break;
-
-	if (s == MAX_SESSIONS) {
-		pr_err("%s() : Attempt to use invalid session_id %d\n",
-			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
-	}
-
-	if (msm_rotator_dev->img_info[s]->enable == 0) {
-		dev_dbg(msm_rotator_dev->device,
-			"%s() : Session_id %d not enabled \n",
-			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
-	}
-
-	img_info = msm_rotator_dev->img_info[s];
 	if (msm_rotator_get_plane_sizes(img_info->src.format,
 					img_info->src.width,
 					img_info->src.height,
 					&src_planes)) {
 		pr_err("%s: invalid src format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 	if (msm_rotator_get_plane_sizes(img_info->dst.format,
 					img_info->dst.width,
 					img_info->dst.height,
 					&dst_planes)) {
 		pr_err("%s: invalid dst format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-	rc = get_img(&info.src, ROTATOR_SRC_DOMAIN, (unsigned long *)&in_paddr,
-			(unsigned long *)&src_len, &srcp0_file, &ps0_need,
-			&srcp0_ihdl, 0);
+	job->src_flags = info->src.flags;
+	rc = get_img(&info->src, ROTATOR_SRC_DOMAIN,
+			(unsigned long *)&job->in_paddr,
+			(unsigned long *)&src_len, &job->srcp0_file,
+			&job->ps0_need, &job->srcp0_ihdl, 0);
 	if (rc) {
 		pr_err("%s: in get_img() failed id=0x%08x\n",
-			DRIVER_NAME, info.src.memory_id);
-		goto do_rotate_unlock_mutex;
+			DRIVER_NAME, info->src.memory_id);
+		return rc;
 	}
 
-	rc = get_img(&info.dst, ROTATOR_DST_DOMAIN, (unsigned long *)&out_paddr,
+	rc = get_img(&info->dst, ROTATOR_DST_DOMAIN,
+			(unsigned long *)&job->out_paddr,
 			(unsigned long *)&dst_len, &dstp0_file, &p_need,
-			&dstp0_ihdl, img_info->secure);
+			&job->dstp0_ihdl, img_info->secure);
 	if (rc) {
 		pr_err("%s: out get_img() failed id=0x%08x\n",
-		       DRIVER_NAME, info.dst.memory_id);
-		goto do_rotate_unlock_mutex;
+		       DRIVER_NAME, info->dst.memory_id);
+		return rc;
 	}
 
-	format = msm_rotator_dev->img_info[s]->src.format;
-	if (((info.version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
-			((info.version_key & ~VERSION_KEY_MASK) > 0) &&
+	if (((info->version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
+			((info->version_key & ~VERSION_KEY_MASK) > 0) &&
 			(src_planes.num_planes == 2)) {
-		if (checkoffset(info.src.offset,
+		if (checkoffset(info->src.offset,
 				src_planes.plane_size[0],
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, src_len, info->src.offset);
+			return -ERANGE;
 		}
-		if (checkoffset(info.dst.offset,
+		if (checkoffset(info->dst.offset,
 				dst_planes.plane_size[0],
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, dst_len, info->dst.offset);
+			return -ERANGE;
 		}
 
-		rc = get_img(&info.src_chroma, ROTATOR_SRC_DOMAIN,
-				(unsigned long *)&in_chroma_paddr,
+		rc = get_img(&info->src_chroma, ROTATOR_SRC_DOMAIN,
+				(unsigned long *)&job->in_chroma_paddr,
 				(unsigned long *)&src_len, &srcp1_file, &p_need,
-				&srcp1_ihdl, 0);
+				&job->srcp1_ihdl, 0);
 		if (rc) {
 			pr_err("%s: in chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.src_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->src_chroma.memory_id);
+			return rc;
 		}
 
-		rc = get_img(&info.dst_chroma, ROTATOR_DST_DOMAIN,
-				(unsigned long *)&out_chroma_paddr,
+		rc = get_img(&info->dst_chroma, ROTATOR_DST_DOMAIN,
+				(unsigned long *)&job->out_chroma_paddr,
 				(unsigned long *)&dst_len, &dstp1_file, &p_need,
-				&dstp1_ihdl, img_info->secure);
+				&job->dstp1_ihdl, img_info->secure);
 		if (rc) {
 			pr_err("%s: out chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.dst_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->dst_chroma.memory_id);
+			return rc;
 		}
 
-		if (checkoffset(info.src_chroma.offset,
+		if (checkoffset(info->src_chroma.offset,
 				src_planes.plane_size[1],
 				src_len)) {
 			pr_err("%s: invalid chr src buf len=%lu offset=%x\n",
-			       __func__, src_len, info.src_chroma.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, src_len, info->src_chroma.offset);
+			return -ERANGE;
 		}
 
-		if (checkoffset(info.dst_chroma.offset,
+		if (checkoffset(info->dst_chroma.offset,
 				src_planes.plane_size[1],
 				dst_len)) {
 			pr_err("%s: invalid chr dst buf len=%lu offset=%x\n",
-			       __func__, dst_len, info.dst_chroma.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, dst_len, info->dst_chroma.offset);
+			return -ERANGE;
 		}
 
-		in_chroma_paddr += info.src_chroma.offset;
-		out_chroma_paddr += info.dst_chroma.offset;
+		job->in_chroma_paddr += info->src_chroma.offset;
+		job->out_chroma_paddr += info->dst_chroma.offset;
 	} else {
-		if (checkoffset(info.src.offset,
+		if (checkoffset(info->src.offset,
 				src_planes.total_size,
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, src_len, info->src.offset);
+			return -ERANGE;
 		}
-		if (checkoffset(info.dst.offset,
+		if (checkoffset(info->dst.offset,
 				dst_planes.total_size,
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
-			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			       __func__, dst_len, info->dst.offset);
+			return -ERANGE;
 		}
 	}
 
-	in_paddr += info.src.offset;
-	out_paddr += info.dst.offset;
+	job->in_paddr += info->src.offset;
+	job->out_paddr += info->dst.offset;
 
-	if (!in_chroma_paddr && src_planes.num_planes >= 2)
-		in_chroma_paddr = in_paddr + src_planes.plane_size[0];
-	if (!out_chroma_paddr && dst_planes.num_planes >= 2)
-		out_chroma_paddr = out_paddr + dst_planes.plane_size[0];
+	if (!job->in_chroma_paddr && src_planes.num_planes >= 2)
+		job->in_chroma_paddr = job->in_paddr + src_planes.plane_size[0];
+	if (!job->out_chroma_paddr && dst_planes.num_planes >= 2)
+		job->out_chroma_paddr = job->out_paddr +
+			dst_planes.plane_size[0];
 	if (src_planes.num_planes >= 3)
-		in_chroma2_paddr = in_chroma_paddr + src_planes.plane_size[1];
+		job->in_chroma2_paddr = job->in_chroma_paddr +
+			src_planes.plane_size[1];
 
+	job->mapped = true;
+	return 0;
+}
+
+static void msm_rotator_unmap_job(struct msm_rotator_job *job)
+{
+	put_img(NULL, job->dstp1_ihdl, ROTATOR_DST_DOMAIN,
+		job->img_info.secure);
+	put_img(NULL, job->srcp1_ihdl, ROTATOR_SRC_DOMAIN, 0);
+	put_img(NULL, job->dstp0_ihdl, ROTATOR_DST_DOMAIN,
+		job->img_info.secure);
+
+	/* only source may use frame buffer */
+	if (job->src_flags & MDP_MEMORY_ID_TYPE_FB)
+		fput_light(job->srcp0_file, job->ps0_need);
+	else
+		put_img(job->srcp0_file, job->srcp0_ihdl, ROTATOR_SRC_DOMAIN,
+			0);
+	job->mapped = false;
+}
+
+/* Called with rotator_lock held, before a job or burst of jobs */
+static void msm_rotator_rot_clk_on(void)
+{
 	cancel_delayed_work(&msm_rotator_dev->rot_clk_work);
 	if (msm_rotator_dev->rot_clk_state != CLK_EN) {
 		enable_rot_clks();
 		msm_rotator_dev->rot_clk_state = CLK_EN;
 	}
+}
+
+/*
+ * Run a mapped job on the hardware and wait for its interrupt. Called
+ * with rotator_lock held and the rotator clocks on.
+ */
+static int msm_rotator_hw_rotate(struct msm_rotator_job *job)
+{
+	struct msm_rotator_img_info *img_info = &job->img_info;
+	int s = job->session_idx;
+	unsigned int status, format;
+	int use_imem = 0, rc = 0;
+
 	enable_irq(msm_rotator_dev->irq);
 
 #ifdef CONFIG_MSM_ROTATOR_USE_IMEM
@@ -1101,19 +1142,17 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	if (use_imem)
 		iowrite32(0x42, MSM_ROTATOR_MAX_BURST_SIZE);
 
-	iowrite32(((msm_rotator_dev->img_info[s]->src_rect.h & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src_rect.w & 0x1fff),
+	iowrite32(((img_info->src_rect.h & 0x1fff) << 16) |
+		  (img_info->src_rect.w & 0x1fff),
 		  MSM_ROTATOR_SRC_SIZE);
-	iowrite32(((msm_rotator_dev->img_info[s]->src_rect.y & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src_rect.x & 0x1fff),
+	iowrite32(((img_info->src_rect.y & 0x1fff) << 16) |
+		  (img_info->src_rect.x & 0x1fff),
 		  MSM_ROTATOR_SRC_XY);
-	iowrite32(((msm_rotator_dev->img_info[s]->src.height & 0x1fff)
-				<< 16) |
-		  (msm_rotator_dev->img_info[s]->src.width & 0x1fff),
+	iowrite32(((img_info->src.height & 0x1fff) << 16) |
+		  (img_info->src.width & 0x1fff),
 		  MSM_ROTATOR_SRC_IMAGE_SIZE);
 
+	format = img_info->src.format;
 	switch (format) {
 	case MDP_RGB_565:
 	case MDP_BGR_565:
@@ -1126,8 +1165,8 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_BGRX_8888:
 	case MDP_YCBCR_H1V1:
 	case MDP_YCRCB_H1V1:
-		rc = msm_rotator_rgb_types(msm_rotator_dev->img_info[s],
-					   in_paddr, out_paddr,
+		rc = msm_rotator_rgb_types(img_info,
+					   job->in_paddr, job->out_paddr,
 					   use_imem,
 					   msm_rotator_dev->last_session_idx
 								!= s);
@@ -1139,39 +1178,41 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_Y_CR_CB_GH2V2:
 	case MDP_Y_CRCB_H2V2_TILE:
 	case MDP_Y_CBCR_H2V2_TILE:
-		rc = msm_rotator_ycxcx_h2v2(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
+		rc = msm_rotator_ycxcx_h2v2(img_info,
+					    job->in_paddr, job->out_paddr,
+					    use_imem,
 					    msm_rotator_dev->last_session_idx
 								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr,
-					    in_chroma2_paddr);
+					    job->in_chroma_paddr,
+					    job->out_chroma_paddr,
+					    job->in_chroma2_paddr);
 		break;
 	case MDP_Y_CBCR_H2V1:
 	case MDP_Y_CRCB_H2V1:
-		rc = msm_rotator_ycxcx_h2v1(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
+		rc = msm_rotator_ycxcx_h2v1(img_info,
+					    job->in_paddr, job->out_paddr,
+					    use_imem,
 					    msm_rotator_dev->last_session_idx
 								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr);
+					    job->in_chroma_paddr,
+					    job->out_chroma_paddr);
 		break;
 	case MDP_YCRYCB_H2V1:
-		rc = msm_rotator_ycrycb(msm_rotator_dev->img_info[s],
-				in_paddr, out_paddr, use_imem,
+		rc = msm_rotator_ycrycb(img_info,
+				job->in_paddr, job->out_paddr, use_imem,
 				msm_rotator_dev->last_session_idx != s,
-				out_chroma_paddr);
+				job->out_chroma_paddr);
 		break;
 	default:
 		rc = -EINVAL;
 		pr_err("%s(): Unsupported format %u\n", __func__, format);
-		goto do_rotate_exit;
+		goto hw_rotate_exit;
 	}
 
 	if (rc != 0) {
 		msm_rotator_dev->last_session_idx = INVALID_SESSION;
 		pr_err("%s(): Invalid session error\n", __func__);
-		goto do_rotate_exit;
+		goto hw_rotate_exit;
 	}
 
 	iowrite32(3, MSM_ROTATOR_INTR_ENABLE);
@@ -1190,30 +1231,313 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	iowrite32(0, MSM_ROTATOR_INTR_ENABLE);
 	iowrite32(3, MSM_ROTATOR_INTR_CLEAR);
 
-do_rotate_exit:
+hw_rotate_exit:
 	disable_irq(msm_rotator_dev->irq);
 #ifdef CONFIG_MSM_ROTATOR_USE_IMEM
 	msm_rotator_imem_free(ROTATOR_REQUEST);
 #endif
+	return rc;
+}
+
+/*
+ * Signal the release fences up to value. Jobs complete in order, so this
+ * also covers the fences of sessions whose buffer sync was dropped.
+ * Called with rotator_lock held.
+ */
+static void msm_rotator_signal_timeline(u32 value)
+{
+	int inc = value - msm_rotator_dev->timeline_signaled;
+
+	if (inc <= 0)
+		return;
+
+	sw_sync_timeline_inc(msm_rotator_dev->timeline, inc);
+	msm_rotator_dev->timeline_signaled = value;
+}
+
+static void msm_rotator_queue_job(struct msm_rotator_job *job)
+{
+	spin_lock(&msm_rotator_dev->job_lock);
+	list_add_tail(&job->list, &msm_rotator_dev->job_list);
+	spin_unlock(&msm_rotator_dev->job_lock);
+
+	queue_work(msm_rotator_dev->rot_wq, &msm_rotator_dev->commit_work);
+}
+
+static struct msm_rotator_job *msm_rotator_dequeue_job(void)
+{
+	struct msm_rotator_job *job = NULL;
+
+	spin_lock(&msm_rotator_dev->job_lock);
+	if (!list_empty(&msm_rotator_dev->job_list)) {
+		job = list_first_entry(&msm_rotator_dev->job_list,
+				       struct msm_rotator_job, list);
+		list_del(&job->list);
+	}
+	spin_unlock(&msm_rotator_dev->job_lock);
+
+	return job;
+}
+
+/*
+ * Hand the buffer sync of session s to job, or queue it on its own, with
+ * nothing to rotate, when job is NULL, so that its release fence is still
+ * signalled in order. Called with rotator_lock held.
+ */
+static int msm_rotator_take_sync(int s, struct msm_rotator_job *job)
+{
+	struct msm_rotator_session_sync *sync = &msm_rotator_dev->sync[s];
+
+	if (!sync->pending)
+		return 0;
+
+	if (!job) {
+		job = kzalloc(sizeof(*job), GFP_KERNEL);
+		if (!job) {
+			/* signal now rather than never */
+			if (sync->acq_fence)
+				sync_fence_put(sync->acq_fence);
+			msm_rotator_signal_timeline(sync->rel_value);
+			sync->acq_fence = NULL;
+			sync->pending = false;
+			return -ENOMEM;
+		}
+		job->session_idx = s;
+		msm_rotator_queue_job(job);
+	}
+
+	job->acq_fence = sync->acq_fence;
+	job->rel_value = sync->rel_value;
+	sync->acq_fence = NULL;
+	sync->pending = false;
+	return 0;
+}
+
+/*
+ * Rotation queue: each job waits for its acquire fence, rotates with
+ * rotator_lock held and signals its release fence. The clocks are kept
+ * on until the queue runs dry, so a burst is processed back to back.
+ */
+static void msm_rotator_commit_work_f(struct work_struct *work)
+{
+	struct msm_rotator_job *job;
+	bool idle;
+	int rc;
+
+	while ((job = msm_rotator_dequeue_job()) != NULL) {
+		rc = 0;
+		if (job->acq_fence) {
+			rc = sync_fence_wait(job->acq_fence,
+					     ROTATOR_FENCE_TIMEOUT);
+			if (rc < 0)
+				pr_err("%s: acquire fence wait failed %d\n",
+				       __func__, rc);
+			sync_fence_put(job->acq_fence);
+		}
+
+		mutex_lock(&msm_rotator_dev->rotator_lock);
+		if (job->mapped) {
+			if (rc >= 0) {
+				msm_rotator_rot_clk_on();
+				rc = msm_rotator_hw_rotate(job);
+				if (rc)
+					pr_err("%s: session %d failed %d\n",
+					       __func__, job->session_idx, rc);
+			}
+			msm_rotator_unmap_job(job);
+		}
+		msm_rotator_signal_timeline(job->rel_value);
+		spin_lock(&msm_rotator_dev->job_lock);
+		idle = list_empty(&msm_rotator_dev->job_list);
+		spin_unlock(&msm_rotator_dev->job_lock);
+		if (idle && msm_rotator_dev->rot_clk_state == CLK_EN)
+			schedule_delayed_work(&msm_rotator_dev->rot_clk_work,
+					      HZ);
+		mutex_unlock(&msm_rotator_dev->rotator_lock);
+
+		kfree(job);
+	}
+}
+
+static int msm_rotator_do_rotate(unsigned long arg)
+{
+	struct msm_rotator_data_info info;
+	struct msm_rotator_job job, *async_job;
+	int rc = 0, s;
+
+	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
+		return -EFAULT;
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	for (s = 0; s < MAX_SESSIONS; s++)
+		if ((msm_rotator_dev->img_info[s] != NULL) &&
+			(info.session_id ==
+			(unsigned int)msm_rotator_dev->img_info[s]
+			))
+			break;
+
+	if (s == MAX_SESSIONS) {
+		pr_err("%s() : Attempt to use invalid session_id %d\n",
+			__func__, s);
+		rc = -EINVAL;
+		goto do_rotate_unlock_mutex;
+	}
+
+	if (msm_rotator_dev->img_info[s]->enable == 0) {
+		dev_dbg(msm_rotator_dev->device,
+			"%s() : Session_id %d not enabled \n",
+			__func__, s);
+		rc = -EINVAL;
+		goto do_rotate_unlock_mutex;
+	}
+
+	/* after MSM_ROTATOR_IOCTL_BUFFER_SYNC, queue the job and return */
+	if (msm_rotator_dev->sync[s].pending) {
+		/* a frame buffer is only held for the duration of the ioctl */
+		if (info.src.flags & MDP_MEMORY_ID_TYPE_FB) {
+			pr_err("%s: fenced rotation needs ion buffers\n",
+			       __func__);
+			rc = -EINVAL;
+			goto do_rotate_unlock_mutex;
+		}
+
+		async_job = kzalloc(sizeof(*async_job), GFP_KERNEL);
+		if (!async_job) {
+			rc = -ENOMEM;
+			goto do_rotate_unlock_mutex;
+		}
+		async_job->img_info = *msm_rotator_dev->img_info[s];
+		async_job->session_idx = s;
+		rc = msm_rotator_map_job(&info, async_job);
+		if (rc) {
+			msm_rotator_unmap_job(async_job);
+			kfree(async_job);
+			goto do_rotate_unlock_mutex;
+		}
+		msm_rotator_take_sync(s, async_job);
+		msm_rotator_queue_job(async_job);
+		goto do_rotate_unlock_mutex;
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.img_info = *msm_rotator_dev->img_info[s];
+	job.session_idx = s;
+	rc = msm_rotator_map_job(&info, &job);
+	if (rc)
+		goto do_rotate_unmap;
+
+	msm_rotator_rot_clk_on();
+	rc = msm_rotator_hw_rotate(&job);
 	schedule_delayed_work(&msm_rotator_dev->rot_clk_work, HZ);
-do_rotate_unlock_mutex:
-	put_img(dstp1_file, dstp1_ihdl, ROTATOR_DST_DOMAIN,
-		msm_rotator_dev->img_info[s]->secure);
-	put_img(srcp1_file, srcp1_ihdl, ROTATOR_SRC_DOMAIN, 0);
-	put_img(dstp0_file, dstp0_ihdl, ROTATOR_DST_DOMAIN,
-		msm_rotator_dev->img_info[s]->secure);
 
-	/* only source may use frame buffer */
-	if (info.src.flags & MDP_MEMORY_ID_TYPE_FB)
-		fput_light(srcp0_file, ps0_need);
-	else
-		put_img(srcp0_file, srcp0_ihdl, ROTATOR_SRC_DOMAIN, 0);
+do_rotate_unmap:
+	msm_rotator_unmap_job(&job);
+do_rotate_unlock_mutex:
 	mutex_unlock(&msm_rotator_dev->rotator_lock);
 	dev_dbg(msm_rotator_dev->device, "%s() returning rc = %d\n",
 		__func__, rc);
 	return rc;
 }
 
+/*
+ * MSM_ROTATOR_IOCTL_BUFFER_SYNC: the next rotation of the session waits
+ * for acq_fen_fd (if not negative) in the rotation queue instead of being
+ * run in the ioctl, and rel_fen_fd is returned, signalled once it is done.
+ */
+static int msm_rotator_buf_sync(unsigned long arg)
+{
+	struct msm_rotator_buf_sync buf_sync;
+	struct msm_rotator_session_sync *sync;
+	struct sync_fence *acq_fence = NULL, *rel_fence;
+	struct sync_pt *rel_pt;
+	int s, rel_fd, rc = 0;
+	u32 value;
+
+	if (copy_from_user(&buf_sync, (void __user *)arg, sizeof(buf_sync)))
+		return -EFAULT;
+
+	if (!msm_rotator_dev->timeline)
+		return -ENODEV;
+
+	if (buf_sync.acq_fen_fd >= 0) {
+		acq_fence = sync_fence_fdget(buf_sync.acq_fen_fd);
+		if (!acq_fence) {
+			pr_err("%s: invalid acquire fence fd %d\n", __func__,
+			       buf_sync.acq_fen_fd);
+			return -EINVAL;
+		}
+		if (buf_sync.flags & MDP_BUF_SYNC_FLAG_WAIT) {
+			rc = sync_fence_wait(acq_fence, ROTATOR_FENCE_TIMEOUT);
+			sync_fence_put(acq_fence);
+			acq_fence = NULL;
+			if (rc < 0) {
+				pr_err("%s: acquire fence wait failed %d\n",
+				       __func__, rc);
+				return rc;
+			}
+		}
+	}
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	for (s = 0; s < MAX_SESSIONS; s++)
+		if ((msm_rotator_dev->img_info[s] != NULL) &&
+			(buf_sync.session_id ==
+			(unsigned int)msm_rotator_dev->img_info[s]))
+			break;
+
+	if (s == MAX_SESSIONS) {
+		rc = -EINVAL;
+		goto buf_sync_err;
+	}
+
+	rel_fd = get_unused_fd_flags(0);
+	if (rel_fd < 0) {
+		rc = rel_fd;
+		goto buf_sync_err;
+	}
+
+	value = msm_rotator_dev->timeline_value + 1;
+	rel_pt = sw_sync_pt_create(msm_rotator_dev->timeline, value);
+	if (!rel_pt) {
+		rc = -ENOMEM;
+		goto buf_sync_put_fd;
+	}
+	rel_fence = sync_fence_create("msm_rotator", rel_pt);
+	if (!rel_fence) {
+		sync_pt_free(rel_pt);
+		rc = -ENOMEM;
+		goto buf_sync_put_fd;
+	}
+
+	buf_sync.rel_fen_fd = rel_fd;
+	if (copy_to_user((void __user *)arg, &buf_sync, sizeof(buf_sync))) {
+		sync_fence_put(rel_fence);
+		rc = -EFAULT;
+		goto buf_sync_put_fd;
+	}
+
+	/* an earlier buffer sync that was never used still gets released */
+	msm_rotator_take_sync(s, NULL);
+
+	sync = &msm_rotator_dev->sync[s];
+	sync->acq_fence = acq_fence;
+	sync->rel_value = value;
+	sync->pending = true;
+	msm_rotator_dev->timeline_value = value;
+	sync_fence_install(rel_fence, rel_fd);
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+
+	return 0;
+
+buf_sync_put_fd:
+	put_unused_fd(rel_fd);
+buf_sync_err:
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	if (acq_fence)
+		sync_fence_put(acq_fence);
+	return rc;
+}
+
 static void msm_rotator_set_perf_level(u32 wh, u32 is_rgb)
 {
 	u32 perf_level;
@@ -1388,6 +1712,7 @@ static int msm_rotator_finish(unsigned long arg)
 		if ((msm_rotator_dev->img_info[s] != NULL) &&
 			(session_id ==
 			(unsigned int)msm_rotator_dev->img_info[s])) {
+			msm_rotator_take_sync(s, NULL);
 			if (msm_rotator_dev->last_session_idx == s)
 				msm_rotator_dev->last_session_idx =
 					INVALID_SESSION;
@@ -1474,6 +1799,7 @@ msm_rotator_close(struct inode *inode, struct file *filp)
 			pr_debug("%s: freeing rotator session %p (pid %d)\n",
 				 __func__, msm_rotator_dev->img_info[s],
 				 fd_info->pid);
+			msm_rotator_take_sync(s, NULL);
 			kfree(msm_rotator_dev->img_info[s]);
 			msm_rotator_dev->img_info[s] = NULL;
 			msm_rotator_dev->fd_info[s] = NULL;
@@ -1506,6 +1832,8 @@ static long msm_rotator_ioctl(struct file *file, unsigned cmd,
 		return msm_rotator_do_rotate(arg);
 	case MSM_ROTATOR_IOCTL_FINISH:
 		return msm_rotator_finish(arg);
+	case MSM_ROTATOR_IOCTL_BUFFER_SYNC:
+		return msm_rotator_buf_sync(arg);
 
 	default:
 		dev_dbg(msm_rotator_dev->device,
@@ -1709,6 +2037,21 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 		goto error_class_device_create;
 	}
 
+	INIT_LIST_HEAD(&msm_rotator_dev->job_list);
+	spin_lock_init(&msm_rotator_dev->job_lock);
+	INIT_WORK(&msm_rotator_dev->commit_work, msm_rotator_commit_work_f);
+	msm_rotator_dev->rot_wq = create_singlethread_workqueue("msm_rotator");
+	if (!msm_rotator_dev->rot_wq) {
+		printk(KERN_ERR "%s: create_workqueue failed\n", __func__);
+		rc = -ENOMEM;
+		goto error_create_wq;
+	}
+
+	/* without a timeline, rotations simply stay synchronous */
+	msm_rotator_dev->timeline = sw_sync_timeline_create(DRIVER_NAME);
+	if (!msm_rotator_dev->timeline)
+		pr_err("%s: cannot create sync timeline\n", __func__);
+
 	cdev_init(&msm_rotator_dev->cdev, &msm_rotator_fops);
 	rc = cdev_add(&msm_rotator_dev->cdev,
 		      MKDEV(MAJOR(msm_rotator_dev->dev_num), 0),
@@ -1724,6 +2067,10 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 	return rc;
 
 error_cdev_add:
+	destroy_workqueue(msm_rotator_dev->rot_wq);
+	if (msm_rotator_dev->timeline)
+		sync_timeline_destroy(&msm_rotator_dev->timeline->obj);
+error_create_wq:
 	device_destroy(msm_rotator_dev->class, msm_rotator_dev->dev_num);
 error_class_device_create:
 	class_destroy(msm_rotator_dev->class);
@@ -1754,6 +2101,9 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 #ifdef CONFIG_MSM_BUS_SCALING
 	msm_bus_scale_unregister_client(msm_rotator_dev->bus_client_handle);
 #endif
+	destroy_workqueue(msm_rotator_dev->rot_wq);
+	if (msm_rotator_dev->timeline)
+		sync_timeline_destroy(&msm_rotator_dev->timeline->obj);
 	free_irq(msm_rotator_dev->irq, NULL);
 	mutex_destroy(&msm_rotator_dev->rotator_lock);
 	cdev_del(&msm_rotator_dev->cdev);
@@ -1786,6 +2136,7 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 #ifdef CONFIG_PM
 static int msm_rotator_suspend(struct platform_device *dev, pm_message_t state)
 {
+	flush_workqueue(msm_rotator_dev->rot_wq);
 	mutex_lock(&msm_rotator_dev->imem_lock);
 	if (msm_rotator_dev->imem_clk_state == CLK_EN
 		&& msm_rotator_dev->imem_clk) {
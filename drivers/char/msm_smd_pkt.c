@@ -25,6 +25,7 @@
 #include <linux/uaccess.h>
 #include <linux/workqueue.h>
 #include <linux/poll.h>
+#include <linux/timer.h>
 
 #include <mach/msm_smd.h>
 
@@ -47,8 +48,8 @@ struct smd_pkt_dev {
 	int i;
 
 	unsigned char tx_buf[MAX_BUF_SIZE];
-	unsigned char rx_buf[MAX_BUF_SIZE];
 	int remote_open;
+	struct timer_list wakeup_timer;
 
 } *smd_pkt_devp[NUM_SMD_PKT_PORTS];
 
@@ -59,6 +60,29 @@ static int msm_smd_pkt_debug_enable;
 module_param_named(debug_enable, msm_smd_pkt_debug_enable,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Ports whose reads return every complete packet that fits in the user
+ * buffer instead of one, bit n for port n. Packet boundaries are lost,
+ * so this is only for ports carrying a byte stream, like NMEA.
+ */
+static unsigned int batch_read_mask;
+module_param(batch_read_mask, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * On batched ports, readers are only woken once wakeup_watermark bytes
+ * are pending, or wakeup_delay_ms after the first packet that did not
+ * reach it.
+ */
+static unsigned int wakeup_watermark;
+module_param(wakeup_watermark, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+static unsigned int wakeup_delay_ms = 20;
+module_param(wakeup_delay_ms, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+static inline bool smd_pkt_batched(struct smd_pkt_dev *smd_pkt_devp)
+{
+	return batch_read_mask & (1 << smd_pkt_devp->i);
+}
+
 #ifdef DEBUG
 #define D_DUMP_BUFFER(prestr, cnt, buf) do {			\
 		int i;						\
@@ -99,20 +123,43 @@ static void check_and_wakeup_reader(struct smd_pkt_dev *smd_pkt_devp)
 		return;
 	}
 
+	if (smd_pkt_batched(smd_pkt_devp) && wakeup_delay_ms &&
+	    smd_read_avail(smd_pkt_devp->ch) < wakeup_watermark) {
+		if (!timer_pending(&smd_pkt_devp->wakeup_timer))
+			mod_timer(&smd_pkt_devp->wakeup_timer, jiffies +
+				  msecs_to_jiffies(wakeup_delay_ms));
+		DBG("below wakeup watermark\n");
+		return;
+	}
+
 	DBG("waking up reader\n");
+	del_timer(&smd_pkt_devp->wakeup_timer);
 	wake_up_interruptible(&smd_pkt_devp->ch_read_wait_queue);
 }
 
+static void smd_pkt_wakeup_timer(unsigned long data)
+{
+	struct smd_pkt_dev *smd_pkt_devp = (struct smd_pkt_dev *)data;
+
+	DBG("wakeup delay expired\n");
+	wake_up_interruptible(&smd_pkt_devp->ch_read_wait_queue);
+}
+
+static inline bool smd_pkt_complete(struct smd_channel *chl)
+{
+	int sz = smd_cur_packet_size(chl);
+
+	return sz > 0 && smd_read_avail(chl) >= sz;
+}
+
 static int smd_pkt_read(struct file *file, char __user *buf,
 			size_t count, loff_t *ppos)
 {
-	int r, bytes_read;
+	int r, bytes_read, total = 0;
 	struct smd_pkt_dev *smd_pkt_devp;
 	struct smd_channel *chl;
 
 	DBG("read %d bytes\n", count);
-	if (count > MAX_BUF_SIZE)
-		return -EINVAL;
 
 	smd_pkt_devp = file->private_data;
 	if (!smd_pkt_devp || !smd_pkt_devp->ch)
@@ -121,9 +168,7 @@ static int smd_pkt_read(struct file *file, char __user *buf,
 	chl = smd_pkt_devp->ch;
 wait_for_packet:
 	r = wait_event_interruptible(smd_pkt_devp->ch_read_wait_queue,
-				     (smd_cur_packet_size(chl) > 0 &&
-				      smd_read_avail(chl) >=
-				      smd_cur_packet_size(chl)));
+				     smd_pkt_complete(chl));
 
 	if (r < 0) {
 		if (r != -ERESTARTSYS)
@@ -147,25 +192,31 @@ wait_for_packet:
 		return -EINVAL;
 	}
 
-	r = smd_read(smd_pkt_devp->ch, smd_pkt_devp->rx_buf, bytes_read);
-	if (r != bytes_read) {
-		mutex_unlock(&smd_pkt_devp->rx_lock);
-		pr_err("smd_read failed to read %d bytes: %d\n", bytes_read, r);
-		return -EIO;
-	}
-
-	D_DUMP_BUFFER("read: ", bytes_read, smd_pkt_devp->rx_buf);
-	r = copy_to_user(buf, smd_pkt_devp->rx_buf, bytes_read);
+	/*
+	 * Packets are copied from the channel fifo straight to the user
+	 * buffer. On batched ports, every further complete packet that still
+	 * fits goes into the same read.
+	 */
+	do {
+		r = smd_read_user_buffer(chl, buf + total, bytes_read);
+		if (r != bytes_read) {
+			pr_err("smd_read_user_buffer failed to read %d bytes: %d\n",
+			       bytes_read, r);
+			break;
+		}
+		total += bytes_read;
+		if (!smd_pkt_batched(smd_pkt_devp) || !smd_pkt_complete(chl))
+			break;
+		bytes_read = smd_cur_packet_size(chl);
+	} while (bytes_read <= count - total);
 	mutex_unlock(&smd_pkt_devp->rx_lock);
-	if (r) {
-		pr_err("copy_to_user failed %d\n", r);
-		return -EFAULT;
-	}
+	if (!total)
+		return r < 0 ? r : -EIO;
 
-	DBG("read complete %d bytes\n", bytes_read);
+	DBG("read complete %d bytes\n", total);
 	check_and_wakeup_reader(smd_pkt_devp);
 
-	return bytes_read;
+	return total;
 }
 
 static int smd_pkt_write(struct file *file, const char __user *buf,
@@ -337,6 +388,7 @@ static int smd_pkt_release(struct inode *inode, struct file *file)
 	if (--smd_pkt_devp->open_count == 0) {
 		r = smd_close(smd_pkt_devp->ch);
 		smd_pkt_devp->ch = 0;
+		del_timer_sync(&smd_pkt_devp->wakeup_timer);
 	}
 	mutex_unlock(&smd_pkt_devp->ch_lock);
 
@@ -384,6 +436,9 @@ static int __init smd_pkt_init(void)
 		init_waitqueue_head(&smd_pkt_devp[i]->ch_read_wait_queue);
 		smd_pkt_devp[i]->remote_open = 0;
 		init_waitqueue_head(&smd_pkt_devp[i]->ch_opened_wait_queue);
+		setup_timer(&smd_pkt_devp[i]->wakeup_timer,
+			    smd_pkt_wakeup_timer,
+			    (unsigned long)smd_pkt_devp[i]);
 
 		mutex_init(&smd_pkt_devp[i]->ch_lock);
 		mutex_init(&smd_pkt_devp[i]->rx_lock);
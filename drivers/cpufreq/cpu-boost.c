@@ -15,6 +15,7 @@
 
 #include <linux/kernel.h>
 #include <linux/init.h>
+#include <linux/export.h>
 #include <linux/notifier.h>
 #include <linux/cpufreq.h>
 #include <linux/cpu.h>
@@ -25,6 +26,26 @@
 #include <linux/slab.h>
 #include <linux/input.h>
 #include <linux/time.h>
+#include <linux/fb.h>
+#include <trace/events/power.h>
+
+/*
+ * Input boost profiles. A touch going down is a tap, a touch that then
+ * travels more than fling_min_distance is a fling and a key press is a key.
+ * Each profile has its own per-CPU boost frequency and duration.
+ */
+enum input_boost_type {
+	INPUT_BOOST_TAP,
+	INPUT_BOOST_FLING,
+	INPUT_BOOST_KEY,
+	INPUT_BOOST_TYPES,
+};
+
+struct input_boost_profile {
+	enum input_boost_type type;
+	unsigned int ms;
+	u64 last_time;
+};
 
 struct cpu_sync {
 	struct task_struct *thread;
@@ -36,14 +57,18 @@ struct cpu_sync {
 	bool pending;
 	atomic_t being_woken;
 	int src_cpu;
+	int task_load;
 	unsigned int boost_min;
 	unsigned int input_boost_min;
+	unsigned int input_boost_freq[INPUT_BOOST_TYPES];
 };
 
 static DEFINE_PER_CPU(struct cpu_sync, sync_info);
 static struct workqueue_struct *cpu_boost_wq;
 
 static struct work_struct input_boost_work;
+static struct work_struct input_boost_idle_work;
+static unsigned long input_boost_pending;
 
 static unsigned int boost_ms;
 module_param(boost_ms, uint, 0644);
@@ -51,15 +76,137 @@ module_param(boost_ms, uint, 0644);
 static unsigned int sync_threshold;
 module_param(sync_threshold, uint, 0644);
 
-static unsigned int input_boost_freq;
-module_param(input_boost_freq, uint, 0644);
+/*
+ * With load_based_syncs the migration boost follows the demand of the task
+ * that migrated instead of copying the source CPU's frequency. Tasks below
+ * migration_load_threshold percent of demand do not boost.
+ */
+static bool load_based_syncs = IS_ENABLED(CONFIG_SCHED_FREQ_INPUT);
+module_param(load_based_syncs, bool, 0644);
 
-static unsigned int input_boost_ms = 40;
-module_param(input_boost_ms, uint, 0644);
+static unsigned int migration_load_threshold = 15;
+module_param(migration_load_threshold, uint, 0644);
+
+/*
+ * Every boost_ms the migration boost keeps only migration_boost_decay
+ * percent of its frequency, until it drops to the CPU's minimum. 0 removes
+ * it in one go.
+ */
+static unsigned int migration_boost_decay = 50;
+module_param(migration_boost_decay, uint, 0644);
+
+static struct input_boost_profile input_boost_profiles[INPUT_BOOST_TYPES] = {
+	[INPUT_BOOST_TAP] = {
+		.type = INPUT_BOOST_TAP,
+		.ms = 40,
+	},
+	[INPUT_BOOST_FLING] = {
+		.type = INPUT_BOOST_FLING,
+		.ms = 500,
+	},
+	[INPUT_BOOST_KEY] = {
+		.type = INPUT_BOOST_KEY,
+		.ms = 40,
+	},
+};
+
+/*
+ * The frequency parameters take either a single frequency that applies to
+ * all CPUs, or a space separated list of "cpu:freq" pairs.
+ */
+static int set_input_boost_freq(const char *buf, const struct kernel_param *kp)
+{
+	struct input_boost_profile *p = kp->arg;
+	int i, ntokens = 0;
+	unsigned int val, cpu;
+	const char *cp = buf;
+
+	while ((cp = strpbrk(cp + 1, " :")))
+		ntokens++;
+
+	if (!ntokens) {
+		if (sscanf(buf, "%u\n", &val) != 1)
+			return -EINVAL;
+		for_each_possible_cpu(i)
+			per_cpu(sync_info, i).input_boost_freq[p->type] = val;
+		return 0;
+	}
+
+	if (!(ntokens % 2))
+		return -EINVAL;
+
+	cp = buf;
+	for (i = 0; i < ntokens; i += 2) {
+		if (sscanf(cp, "%u:%u", &cpu, &val) != 2)
+			return -EINVAL;
+		if (cpu >= nr_cpu_ids || !cpu_possible(cpu))
+			return -EINVAL;
+
+		per_cpu(sync_info, cpu).input_boost_freq[p->type] = val;
+		cp = strchr(cp, ' ');
+		if (!cp)
+			break;
+		cp++;
+	}
+
+	return 0;
+}
+
+static int get_input_boost_freq(char *buf, const struct kernel_param *kp)
+{
+	struct input_boost_profile *p = kp->arg;
+	int cnt = 0, cpu;
+
+	for_each_possible_cpu(cpu)
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%d:%u ", cpu,
+			per_cpu(sync_info, cpu).input_boost_freq[p->type]);
+
+	/* Drop the trailing space, sysfs appends the newline */
+	if (cnt)
+		buf[--cnt] = '\0';
+	return cnt;
+}
+
+static struct kernel_param_ops param_ops_input_boost_freq = {
+	.set = set_input_boost_freq,
+	.get = get_input_boost_freq,
+};
+
+module_param_cb(input_boost_freq, &param_ops_input_boost_freq,
+		&input_boost_profiles[INPUT_BOOST_TAP], 0644);
+module_param_named(input_boost_ms, input_boost_profiles[INPUT_BOOST_TAP].ms,
+		uint, 0644);
+module_param_cb(fling_boost_freq, &param_ops_input_boost_freq,
+		&input_boost_profiles[INPUT_BOOST_FLING], 0644);
+module_param_named(fling_boost_ms, input_boost_profiles[INPUT_BOOST_FLING].ms,
+		uint, 0644);
+module_param_cb(key_boost_freq, &param_ops_input_boost_freq,
+		&input_boost_profiles[INPUT_BOOST_KEY], 0644);
+module_param_named(key_boost_ms, input_boost_profiles[INPUT_BOOST_KEY].ms,
+		uint, 0644);
+
+/* Distance, in device units, a touch has to travel to count as a fling */
+static unsigned int fling_min_distance = 100;
+module_param(fling_min_distance, uint, 0644);
+
+/*
+ * Keep input boosts until the display reports it went idle. The per-profile
+ * durations then only act as an upper bound.
+ */
+static bool input_boost_until_idle;
+module_param(input_boost_until_idle, bool, 0644);
 
 static u64 last_input_time;
 #define MIN_INPUT_INTERVAL (150 * USEC_PER_MSEC)
 
+struct cpuboost_handle {
+	struct input_handle handle;
+	bool touch_down;
+	bool fling;
+	int start_x;
+	int start_y;
+};
+
 /*
  * The CPUFREQ_ADJUST notifier is used to override the current policy min to
  * make sure policy min >= boost_min. The cpufreq framework then does the job
@@ -113,11 +260,27 @@ static void do_boost_rem(struct work_struct *work)
 {
 	struct cpu_sync *s = container_of(work, struct cpu_sync,
 						boost_rem.work);
+	struct cpufreq_policy policy;
+	unsigned int min = 0;
 
-	pr_debug("Removing boost for CPU%d\n", s->cpu);
-	s->boost_min = 0;
+	if (migration_boost_decay < 100 &&
+	    !cpufreq_get_policy(&policy, s->cpu)) {
+		min = s->boost_min * migration_boost_decay / 100;
+		if (min <= policy.cpuinfo.min_freq)
+			min = 0;
+	}
+
+	if (min)
+		pr_debug("Decaying boost for CPU%d to %u kHz\n", s->cpu, min);
+	else
+		pr_debug("Removing boost for CPU%d\n", s->cpu);
+	s->boost_min = min;
+	trace_cpu_boost_decay(min, s->cpu);
 	/* Force policy re-evaluation to trigger adjust notifier. */
 	cpufreq_update_policy(s->cpu);
+	if (min)
+		queue_delayed_work_on(s->cpu, cpu_boost_wq, &s->boost_rem,
+				      msecs_to_jiffies(boost_ms));
 }
 
 static void do_input_boost_rem(struct work_struct *work)
@@ -134,7 +297,8 @@ static void do_input_boost_rem(struct work_struct *work)
 static int boost_mig_sync_thread(void *data)
 {
 	int dest_cpu = (int) data;
-	int src_cpu, ret;
+	int src_cpu, ret, task_load;
+	unsigned int req_freq;
 	struct cpu_sync *s = &per_cpu(sync_info, dest_cpu);
 	struct cpufreq_policy dest_policy;
 	struct cpufreq_policy src_policy;
@@ -150,6 +314,7 @@ static int boost_mig_sync_thread(void *data)
 		spin_lock_irqsave(&s->lock, flags);
 		s->pending = false;
 		src_cpu = s->src_cpu;
+		task_load = s->task_load;
 		spin_unlock_irqrestore(&s->lock, flags);
 
 		ret = cpufreq_get_policy(&src_policy, src_cpu);
@@ -160,21 +325,40 @@ static int boost_mig_sync_thread(void *data)
 		if (ret)
 			continue;
 
-		if (src_policy.cur == src_policy.cpuinfo.min_freq) {
-			pr_debug("No sync. Source CPU%d@%dKHz at min freq\n",
-				 src_cpu, src_policy.cur);
+		if (load_based_syncs) {
+			if (task_load < migration_load_threshold) {
+				pr_debug("No sync. Task load %d%% below threshold\n",
+					 task_load);
+				continue;
+			}
+			req_freq = dest_policy.max * task_load / 100;
+		} else {
+			if (src_policy.cur == src_policy.cpuinfo.min_freq) {
+				pr_debug("No sync. Source CPU%d@%dKHz at min freq\n",
+					 src_cpu, src_policy.cur);
+				continue;
+			}
+			req_freq = src_policy.cur;
+		}
+
+		if (sync_threshold)
+			req_freq = min(sync_threshold, req_freq);
+
+		if (req_freq <= dest_policy.cpuinfo.min_freq) {
+			pr_debug("No sync. Sync freq %u kHz at min freq\n",
+				 req_freq);
 			continue;
 		}
 
+		/*
+		 * A task that keeps migrating refreshes the boost of every CPU
+		 * it lands on. Don't let a lighter task lower a boost that is
+		 * still decaying.
+		 */
 		cancel_delayed_work_sync(&s->boost_rem);
-		if (sync_threshold) {
-			if (src_policy.cur >= sync_threshold)
-				s->boost_min = sync_threshold;
-			else
-				s->boost_min = src_policy.cur;
-		} else {
-			s->boost_min = src_policy.cur;
-		}
+		s->boost_min = max(s->boost_min, req_freq);
+		trace_cpu_boost_migration(src_cpu, dest_cpu, task_load,
+					  s->boost_min);
 		/* Force policy re-evaluation to trigger adjust notifier. */
 		get_online_cpus();
 		if (cpu_online(src_cpu))
@@ -202,22 +386,27 @@ static int boost_mig_sync_thread(void *data)
 }
 
 static int boost_migration_notify(struct notifier_block *nb,
-				unsigned long dest_cpu, void *arg)
+				unsigned long unused, void *arg)
 {
+	struct migration_notify_data *mnd = arg;
 	unsigned long flags;
-	struct cpu_sync *s = &per_cpu(sync_info, dest_cpu);
+	struct cpu_sync *s = &per_cpu(sync_info, mnd->dest_cpu);
 
 	if (!boost_ms)
 		return NOTIFY_OK;
 
+	if (load_based_syncs && mnd->load < migration_load_threshold)
+		return NOTIFY_OK;
+
 	/* Avoid deadlock in try_to_wake_up() */
 	if (s->thread == current)
 		return NOTIFY_OK;
 
-	pr_debug("Migration: CPU%d --> CPU%d\n", (int) arg, (int) dest_cpu);
+	pr_debug("Migration: CPU%d --> CPU%d\n", mnd->src_cpu, mnd->dest_cpu);
 	spin_lock_irqsave(&s->lock, flags);
 	s->pending = true;
-	s->src_cpu = (int) arg;
+	s->src_cpu = mnd->src_cpu;
+	s->task_load = mnd->load;
 	spin_unlock_irqrestore(&s->lock, flags);
 	/*
 	* Avoid issuing recursive wakeup call, as sync thread itself could be
@@ -239,7 +428,8 @@ static struct notifier_block boost_migration_nb = {
 
 static void do_input_boost(struct work_struct *work)
 {
-	unsigned int i, ret;
+	unsigned long pending = xchg(&input_boost_pending, 0);
+	unsigned int i, ret, type, freq, ms;
 	struct cpu_sync *i_sync_info;
 	struct cpufreq_policy policy;
 
@@ -247,51 +437,162 @@ static void do_input_boost(struct work_struct *work)
 	for_each_online_cpu(i) {
 
 		i_sync_info = &per_cpu(sync_info, i);
+		freq = ms = 0;
+		for_each_set_bit(type, &pending, INPUT_BOOST_TYPES) {
+			freq = max(freq, i_sync_info->input_boost_freq[type]);
+			ms = max(ms, input_boost_profiles[type].ms);
+		}
+		if (!freq)
+			continue;
+
 		ret = cpufreq_get_policy(&policy, i);
 		if (ret)
 			continue;
-		if (policy.cur >= input_boost_freq)
+		if (policy.cur >= freq)
 			continue;
 
 		cancel_delayed_work_sync(&i_sync_info->input_boost_rem);
-		i_sync_info->input_boost_min = input_boost_freq;
+		i_sync_info->input_boost_min = freq;
 		cpufreq_update_policy(i);
 		queue_delayed_work_on(i_sync_info->cpu, cpu_boost_wq,
 			&i_sync_info->input_boost_rem,
-			msecs_to_jiffies(input_boost_ms));
+			msecs_to_jiffies(ms));
 	}
 	put_online_cpus();
 }
 
-static void cpuboost_input_event(struct input_handle *handle,
-		unsigned int type, unsigned int code, int value)
+static void do_input_boost_idle(struct work_struct *work)
+{
+	unsigned int i;
+	struct cpu_sync *i_sync_info;
+
+	get_online_cpus();
+	for_each_possible_cpu(i) {
+		i_sync_info = &per_cpu(sync_info, i);
+		if (cancel_delayed_work_sync(&i_sync_info->input_boost_rem))
+			do_input_boost_rem(&i_sync_info->input_boost_rem.work);
+	}
+	put_online_cpus();
+}
+
+static void cpuboost_queue_boost(enum input_boost_type type)
 {
+	struct input_boost_profile *p = &input_boost_profiles[type];
+	unsigned int cpu;
 	u64 now;
 
-	if (!input_boost_freq)
+	for_each_possible_cpu(cpu)
+		if (per_cpu(sync_info, cpu).input_boost_freq[type])
+			break;
+	if (cpu >= nr_cpu_ids)
 		return;
 
 	now = ktime_to_us(ktime_get());
-	if (now - last_input_time < MIN_INPUT_INTERVAL)
+	if (now - p->last_time < MIN_INPUT_INTERVAL)
 		return;
 
-	if (work_pending(&input_boost_work))
+	set_bit(type, &input_boost_pending);
+	queue_work(cpu_boost_wq, &input_boost_work);
+	p->last_time = now;
+	last_input_time = now;
+}
+
+/**
+ * cpu_boost_input_irq() - Start the tap boost from a touch interrupt
+ *
+ * Lets a touch driver raise the CPU frequency as soon as its interrupt
+ * fires, before the report is read from the controller, rather than when
+ * the touch down reaches the input handler. The touch down that follows is
+ * then rate limited like any other tap. Safe to call from hard irq context.
+ */
+void cpu_boost_input_irq(void)
+{
+	cpuboost_queue_boost(INPUT_BOOST_TAP);
+}
+EXPORT_SYMBOL(cpu_boost_input_irq);
+
+/*
+ * Classify the raw events of a device into taps, flings and key presses.
+ * Called with the device's event_lock held, so the per-handle touch state
+ * needs no locking of its own.
+ */
+static void cpuboost_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	struct cpuboost_handle *h = container_of(handle,
+					struct cpuboost_handle, handle);
+	int *start;
+
+	switch (type) {
+	case EV_KEY:
+		if (code == BTN_TOUCH) {
+			if (value && !h->touch_down)
+				goto touch_down;
+			if (!value)
+				h->touch_down = false;
+			return;
+		}
+		/* Key press, not a touch or pointer button */
+		if (value == 1 && (code < BTN_MISC || code >= KEY_OK))
+			cpuboost_queue_boost(INPUT_BOOST_KEY);
 		return;
 
-	queue_work(cpu_boost_wq, &input_boost_work);
-	last_input_time = ktime_to_us(ktime_get());
+	case EV_ABS:
+		switch (code) {
+		case ABS_MT_TRACKING_ID:
+			if (value >= 0 && !h->touch_down)
+				goto touch_down;
+			if (value < 0)
+				h->touch_down = false;
+			return;
+		case ABS_MT_POSITION_X:
+		case ABS_X:
+			start = &h->start_x;
+			break;
+		case ABS_MT_POSITION_Y:
+		case ABS_Y:
+			start = &h->start_y;
+			break;
+		default:
+			return;
+		}
+
+		if (!h->touch_down || h->fling)
+			return;
+		if (*start < 0) {
+			*start = value;
+			return;
+		}
+		if (abs(value - *start) > fling_min_distance) {
+			h->fling = true;
+			cpuboost_queue_boost(INPUT_BOOST_FLING);
+		}
+		return;
+
+	default:
+		return;
+	}
+
+touch_down:
+	h->touch_down = true;
+	h->fling = false;
+	h->start_x = h->start_y = -1;
+	cpuboost_queue_boost(INPUT_BOOST_TAP);
 }
 
 static int cpuboost_input_connect(struct input_handler *handler,
 		struct input_dev *dev, const struct input_device_id *id)
 {
+	struct cpuboost_handle *h;
 	struct input_handle *handle;
 	int error;
 
-	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
-	if (!handle)
+	h = kzalloc(sizeof(struct cpuboost_handle), GFP_KERNEL);
+	if (!h)
 		return -ENOMEM;
 
+	handle = &h->handle;
+
 	handle->dev = dev;
 	handle->handler = handler;
 	handle->name = "cpufreq";
@@ -308,7 +609,7 @@ static int cpuboost_input_connect(struct input_handler *handler,
 err1:
 	input_unregister_handle(handle);
 err2:
-	kfree(handle);
+	kfree(h);
 	return error;
 }
 
@@ -316,7 +617,7 @@ static void cpuboost_input_disconnect(struct input_handle *handle)
 {
 	input_close_device(handle);
 	input_unregister_handle(handle);
-	kfree(handle);
+	kfree(container_of(handle, struct cpuboost_handle, handle));
 }
 
 static const struct input_device_id cpuboost_ids[] = {
@@ -353,6 +654,31 @@ static struct input_handler cpuboost_input_handler = {
 	.id_table       = cpuboost_ids,
 };
 
+/*
+ * End input boosts once the display goes idle. Ignore an idle event that
+ * arrives right after an input boost started: it relates to frames drawn
+ * before the input and the UI has not had a chance to respond yet.
+ */
+static int cpuboost_fb_notify(struct notifier_block *nb,
+				unsigned long event, void *data)
+{
+	u64 now;
+
+	if (event != FB_EVENT_IDLE || !input_boost_until_idle)
+		return NOTIFY_OK;
+
+	now = ktime_to_us(ktime_get());
+	if (now - last_input_time < MIN_INPUT_INTERVAL)
+		return NOTIFY_OK;
+
+	queue_work(cpu_boost_wq, &input_boost_idle_work);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpuboost_fb_nb = {
+	.notifier_call = cpuboost_fb_notify,
+};
+
 static int cpu_boost_init(void)
 {
 	int cpu, ret;
@@ -363,6 +689,7 @@ static int cpu_boost_init(void)
 		return -EFAULT;
 
 	INIT_WORK(&input_boost_work, do_input_boost);
+	INIT_WORK(&input_boost_idle_work, do_input_boost_idle);
 
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
@@ -380,6 +707,7 @@ static int cpu_boost_init(void)
 	atomic_notifier_chain_register(&migration_notifier_head,
 					&boost_migration_nb);
 	ret = input_register_handler(&cpuboost_input_handler);
+	fb_register_client(&cpuboost_fb_nb);
 
 	return 0;
 }
@@ -46,12 +46,14 @@ struct cpufreq_interactive_cpuinfo {
 	u64 cputime_speedadj;
 	u64 cputime_speedadj_timestamp;
 	struct cpufreq_policy *policy;
+	struct cpufreq_interactive_tunables *tunables;
 	struct cpufreq_frequency_table *freq_table;
 	unsigned int target_freq;
 	unsigned int floor_freq;
 	u64 floor_validate_time;
 	u64 hispeed_validate_time;
 	struct rw_semaphore enable_sem;
+	spinlock_t eval_lock; /* serializes speed selection for this cpu */
 	int governor_enabled;
 	int prev_load;
 	bool limits_changed;
@@ -68,48 +70,84 @@ static cpumask_t speedchange_cpumask;
 static spinlock_t speedchange_cpumask_lock;
 static struct mutex gov_lock;
 
-/* Hi speed to bump to from lo speed when load burst (default max) */
-static unsigned int hispeed_freq;
-
-/* Go to hi speed when CPU load at or above this value. */
-#define DEFAULT_GO_HISPEED_LOAD 99
-static unsigned long go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
-
 /* Sampling down factor to be applied to min_sample_time at max freq */
 static unsigned int sampling_down_factor;
 
-/* Target load.  Lower values result in higher CPU speeds. */
+/* Busy SDF parameters*/
+#define MIN_BUSY_TIME (100 * USEC_PER_MSEC)
+
+#define DEFAULT_GO_HISPEED_LOAD 99
 #define DEFAULT_TARGET_LOAD 90
 static unsigned int default_target_loads[] = {DEFAULT_TARGET_LOAD};
-static spinlock_t target_loads_lock;
-static unsigned int *target_loads = default_target_loads;
-static int ntarget_loads = ARRAY_SIZE(default_target_loads);
-
-/*
- * The minimum amount of time to spend at a frequency before we can ramp down.
- */
 #define DEFAULT_MIN_SAMPLE_TIME (80 * USEC_PER_MSEC)
-static unsigned long min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+#define DEFAULT_TIMER_RATE (20 * USEC_PER_MSEC)
+#define DEFAULT_ABOVE_HISPEED_DELAY DEFAULT_TIMER_RATE
+static unsigned int default_above_hispeed_delay[] = {
+	DEFAULT_ABOVE_HISPEED_DELAY };
+#define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
 
 /*
- * The sample rate of the timer used to increase frequency
+ * Tunables that can be set for each policy, in the "interactive" directory
+ * of the policy.  Writes to the global "interactive" directory apply to
+ * every policy's set and to common_tunables, which policies started for
+ * the first time inherit.
  */
-#define DEFAULT_TIMER_RATE (20 * USEC_PER_MSEC)
-static unsigned long timer_rate = DEFAULT_TIMER_RATE;
+struct cpufreq_interactive_tunables {
+	/* Hi speed to bump to from lo speed when load burst (default max) */
+	unsigned int hispeed_freq;
 
-/* Busy SDF parameters*/
-#define MIN_BUSY_TIME (100 * USEC_PER_MSEC)
+	/* Go to hi speed when CPU load at or above this value. */
+	unsigned long go_hispeed_load;
 
-/*
- * Wait this long before raising speed above hispeed, by default a single
- * timer interval.
- */
-#define DEFAULT_ABOVE_HISPEED_DELAY DEFAULT_TIMER_RATE
-static unsigned int default_above_hispeed_delay[] = {
-	DEFAULT_ABOVE_HISPEED_DELAY };
-static spinlock_t above_hispeed_delay_lock;
-static unsigned int *above_hispeed_delay = default_above_hispeed_delay;
-static int nabove_hispeed_delay = ARRAY_SIZE(default_above_hispeed_delay);
+	/* Target load.  Lower values result in higher CPU speeds. */
+	spinlock_t target_loads_lock;
+	unsigned int *target_loads;
+	int ntarget_loads;
+
+	/*
+	 * The minimum amount of time to spend at a frequency before we can
+	 * ramp down.
+	 */
+	unsigned long min_sample_time;
+
+	/* The sample rate of the timer used to increase frequency */
+	unsigned long timer_rate;
+
+	/*
+	 * Wait this long before raising speed above hispeed, by default a
+	 * single timer interval.
+	 */
+	spinlock_t above_hispeed_delay_lock;
+	unsigned int *above_hispeed_delay;
+	int nabove_hispeed_delay;
+
+	/*
+	 * Max additional time to wait in idle, beyond timer_rate, at speeds
+	 * above minimum before wakeup to reduce speed, or -1 if unnecessary.
+	 */
+	int timer_slack_val;
+
+	struct kobject kobj;
+	struct list_head list;
+};
+
+static struct cpufreq_interactive_tunables common_tunables = {
+	.go_hispeed_load = DEFAULT_GO_HISPEED_LOAD,
+	.target_loads = default_target_loads,
+	.ntarget_loads = ARRAY_SIZE(default_target_loads),
+	.min_sample_time = DEFAULT_MIN_SAMPLE_TIME,
+	.timer_rate = DEFAULT_TIMER_RATE,
+	.above_hispeed_delay = default_above_hispeed_delay,
+	.nabove_hispeed_delay = ARRAY_SIZE(default_above_hispeed_delay),
+	.timer_slack_val = DEFAULT_TIMER_SLACK,
+};
+
+/* All tunable sets, common_tunables included */
+static LIST_HEAD(tunables_list);
+static DEFINE_MUTEX(tunables_lock);
+
+/* Set of the policy last started on each cpu, kept across governor stops */
+static DEFINE_PER_CPU(struct cpufreq_interactive_tunables *, cached_tunables);
 
 /* Non-zero means indefinite speed boost active */
 static int boost_val;
@@ -118,14 +156,21 @@ static int boostpulse_duration_val = DEFAULT_MIN_SAMPLE_TIME;
 /* End time of boost pulse in ktime converted to usecs */
 static u64 boostpulse_endtime;
 
+static bool io_is_busy;
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
 /*
- * Max additional time to wait in idle, beyond timer_rate, at speeds above
- * minimum before wakeup to reduce speed, or -1 if unnecessary.
+ * Also use the scheduler's per-cpu task demand as a load input, and ramp up
+ * as soon as the scheduler reports that demand moved onto a cpu.
  */
-#define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
-static int timer_slack_val = DEFAULT_TIMER_SLACK;
+static bool use_sched_load;
+#endif
 
-static bool io_is_busy;
+/*
+ * Take speed decisions from the scheduler's enqueue and tick callbacks,
+ * using the timer only to lower the speed of cpus that went idle.
+ */
+static bool sched_driven;
 
 /*
  * If the max load among other CPUs is higher than up_threshold_any_cpu_load
@@ -162,11 +207,12 @@ static void cpufreq_interactive_timer_resched(
 				  &pcpu->time_in_idle_timestamp, io_is_busy);
 	pcpu->cputime_speedadj = 0;
 	pcpu->cputime_speedadj_timestamp = pcpu->time_in_idle_timestamp;
-	expires = jiffies + usecs_to_jiffies(timer_rate);
+	expires = jiffies + usecs_to_jiffies(pcpu->tunables->timer_rate);
 	mod_timer_pinned(&pcpu->cpu_timer, expires);
 
-	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
-		expires += usecs_to_jiffies(timer_slack_val);
+	if (pcpu->tunables->timer_slack_val >= 0 &&
+	    pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(pcpu->tunables->timer_slack_val);
 		mod_timer_pinned(&pcpu->cpu_slack_timer, expires);
 	}
 
@@ -185,12 +231,13 @@ static void cpufreq_interactive_timer_start(int cpu, int time_override)
 	if (time_override)
 		expires = jiffies + time_override;
 	else
-		expires = jiffies + usecs_to_jiffies(timer_rate);
+		expires = jiffies + usecs_to_jiffies(pcpu->tunables->timer_rate);
 
 	pcpu->cpu_timer.expires = expires;
 	add_timer_on(&pcpu->cpu_timer, cpu);
-	if (timer_slack_val >= 0 && pcpu->target_freq > pcpu->policy->min) {
-		expires += usecs_to_jiffies(timer_slack_val);
+	if (pcpu->tunables->timer_slack_val >= 0 &&
+	    pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(pcpu->tunables->timer_slack_val);
 		pcpu->cpu_slack_timer.expires = expires;
 		add_timer_on(&pcpu->cpu_slack_timer, cpu);
 	}
@@ -204,38 +251,41 @@ static void cpufreq_interactive_timer_start(int cpu, int time_override)
 	spin_unlock_irqrestore(&pcpu->load_lock, flags);
 }
 
-static unsigned int freq_to_above_hispeed_delay(unsigned int freq)
+static unsigned int freq_to_above_hispeed_delay(
+	struct cpufreq_interactive_tunables *tunables, unsigned int freq)
 {
 	int i;
 	unsigned int ret;
 	unsigned long flags;
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&tunables->above_hispeed_delay_lock, flags);
 
-	for (i = 0; i < nabove_hispeed_delay - 1 &&
-			freq >= above_hispeed_delay[i+1]; i += 2)
+	for (i = 0; i < tunables->nabove_hispeed_delay - 1 &&
+			freq >= tunables->above_hispeed_delay[i+1]; i += 2)
 		;
 
-	ret = above_hispeed_delay[i];
+	ret = tunables->above_hispeed_delay[i];
 	ret = (ret > (1 * USEC_PER_MSEC)) ? (ret - (1 * USEC_PER_MSEC)) : ret;
 
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_unlock_irqrestore(&tunables->above_hispeed_delay_lock, flags);
 	return ret;
 }
 
-static unsigned int freq_to_targetload(unsigned int freq)
+static unsigned int freq_to_targetload(
+	struct cpufreq_interactive_tunables *tunables, unsigned int freq)
 {
 	int i;
 	unsigned int ret;
 	unsigned long flags;
 
-	spin_lock_irqsave(&target_loads_lock, flags);
+	spin_lock_irqsave(&tunables->target_loads_lock, flags);
 
-	for (i = 0; i < ntarget_loads - 1 && freq >= target_loads[i+1]; i += 2)
+	for (i = 0; i < tunables->ntarget_loads - 1 &&
+		    freq >= tunables->target_loads[i+1]; i += 2)
 		;
 
-	ret = target_loads[i];
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	ret = tunables->target_loads[i];
+	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
 	return ret;
 }
 
@@ -258,7 +308,7 @@ static unsigned int choose_freq(
 
 	do {
 		prevfreq = freq;
-		tl = freq_to_targetload(freq);
+		tl = freq_to_targetload(pcpu->tunables, freq);
 
 		/*
 		 * Find the lowest frequency where the computed load is less
@@ -355,16 +405,18 @@ static u64 update_load(int cpu)
 	return now;
 }
 
-static void cpufreq_interactive_timer(unsigned long data)
+/*
+ * Choose and request a new target speed for @cpu from its current load,
+ * given as load percentage times current speed.  Returns false when the
+ * change was held back, in which case the load must be evaluated again.
+ * The caller holds pcpu->eval_lock.
+ */
+static bool cpufreq_interactive_evaluate(
+	struct cpufreq_interactive_cpuinfo *pcpu, int cpu,
+	unsigned int loadadjfreq, u64 now)
 {
-	u64 now;
-	unsigned int delta_time;
-	u64 cputime_speedadj;
 	int cpu_load;
-	struct cpufreq_interactive_cpuinfo *pcpu =
-		&per_cpu(cpuinfo, data);
 	unsigned int new_freq;
-	unsigned int loadadjfreq;
 	unsigned int index;
 	unsigned long flags;
 	bool boosted;
@@ -372,36 +424,20 @@ static void cpufreq_interactive_timer(unsigned long data)
 	int i, max_load;
 	unsigned int max_freq;
 	struct cpufreq_interactive_cpuinfo *picpu;
+	struct cpufreq_interactive_tunables *tunables = pcpu->tunables;
 
-	if (!down_read_trylock(&pcpu->enable_sem))
-		return;
-	if (!pcpu->governor_enabled)
-		goto exit;
-
-	pcpu->nr_timer_resched = 0;
-	spin_lock_irqsave(&pcpu->load_lock, flags);
-	now = update_load(data);
-	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
-	cputime_speedadj = pcpu->cputime_speedadj;
-	spin_unlock_irqrestore(&pcpu->load_lock, flags);
-
-	if (WARN_ON_ONCE(!delta_time))
-		goto rearm;
-
-	do_div(cputime_speedadj, delta_time);
-	loadadjfreq = (unsigned int)cputime_speedadj * 100;
 	cpu_load = loadadjfreq / pcpu->target_freq;
 	pcpu->prev_load = cpu_load;
 	boosted = boost_val || now < boostpulse_endtime;
 
-	if (cpu_load >= go_hispeed_load || boosted) {
-		if (pcpu->target_freq < hispeed_freq) {
-			new_freq = hispeed_freq;
+	if (cpu_load >= tunables->go_hispeed_load || boosted) {
+		if (pcpu->target_freq < tunables->hispeed_freq) {
+			new_freq = tunables->hispeed_freq;
 		} else {
 			new_freq = choose_freq(pcpu, loadadjfreq);
 
-			if (new_freq < hispeed_freq)
-				new_freq = hispeed_freq;
+			if (new_freq < tunables->hispeed_freq)
+				new_freq = tunables->hispeed_freq;
 		}
 	} else {
 		new_freq = choose_freq(pcpu, loadadjfreq);
@@ -414,7 +450,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 			for_each_online_cpu(i) {
 				picpu = &per_cpu(cpuinfo, i);
 
-				if (i == data || picpu->prev_load <
+				if (i == cpu || picpu->prev_load <
 						up_threshold_any_cpu_load)
 					continue;
 
@@ -428,14 +464,14 @@ static void cpufreq_interactive_timer(unsigned long data)
 		}
 	}
 
-	if (pcpu->target_freq >= hispeed_freq &&
+	if (pcpu->target_freq >= tunables->hispeed_freq &&
 	    new_freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time <
-	    freq_to_above_hispeed_delay(pcpu->target_freq)) {
+	    freq_to_above_hispeed_delay(tunables, pcpu->target_freq)) {
 		trace_cpufreq_interactive_notyet(
-			data, cpu_load, pcpu->target_freq,
+			cpu, cpu_load, pcpu->target_freq,
 			pcpu->policy->cur, new_freq);
-		goto rearm;
+		return false;
 	}
 
 	pcpu->hispeed_validate_time = now;
@@ -443,7 +479,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
 					   new_freq, CPUFREQ_RELATION_L,
 					   &index))
-		goto rearm;
+		return false;
 
 	new_freq = pcpu->freq_table[index].frequency;
 
@@ -454,7 +490,7 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (sampling_down_factor && pcpu->policy->cur == pcpu->policy->max)
 		mod_min_sample_time = sampling_down_factor;
 	else
-		mod_min_sample_time = min_sample_time;
+		mod_min_sample_time = tunables->min_sample_time;
 
 	if (pcpu->limits_changed) {
 		if (sampling_down_factor &&
@@ -467,9 +503,9 @@ static void cpufreq_interactive_timer(unsigned long data)
 	if (new_freq < pcpu->floor_freq) {
 		if (now - pcpu->floor_validate_time < mod_min_sample_time) {
 			trace_cpufreq_interactive_notyet(
-				data, cpu_load, pcpu->target_freq,
+				cpu, cpu_load, pcpu->target_freq,
 				pcpu->policy->cur, new_freq);
-			goto rearm;
+			return false;
 		}
 	}
 
@@ -481,28 +517,72 @@ static void cpufreq_interactive_timer(unsigned long data)
 	 * (or the indefinite boost is turned off).
 	 */
 
-	if (!boosted || new_freq > hispeed_freq) {
+	if (!boosted || new_freq > tunables->hispeed_freq) {
 		pcpu->floor_freq = new_freq;
 		pcpu->floor_validate_time = now;
 	}
 
 	if (pcpu->target_freq == new_freq) {
 		trace_cpufreq_interactive_already(
-			data, cpu_load, pcpu->target_freq,
+			cpu, cpu_load, pcpu->target_freq,
 			pcpu->policy->cur, new_freq);
-		goto rearm_if_notmax;
+		return true;
 	}
 
-	trace_cpufreq_interactive_target(data, cpu_load, pcpu->target_freq,
+	trace_cpufreq_interactive_target(cpu, cpu_load, pcpu->target_freq,
 					 pcpu->policy->cur, new_freq);
 
 	pcpu->target_freq = new_freq;
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
-	cpumask_set_cpu(data, &speedchange_cpumask);
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
 	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
 	wake_up_process(speedchange_task);
+	return true;
+}
+
+static void cpufreq_interactive_timer(unsigned long data)
+{
+	u64 now;
+	unsigned int delta_time;
+	u64 cputime_speedadj;
+	struct cpufreq_interactive_cpuinfo *pcpu =
+		&per_cpu(cpuinfo, data);
+	unsigned int loadadjfreq;
+	unsigned long flags;
+	bool settled;
+
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	pcpu->nr_timer_resched = 0;
+	spin_lock_irqsave(&pcpu->load_lock, flags);
+	now = update_load(data);
+	delta_time = (unsigned int)(now - pcpu->cputime_speedadj_timestamp);
+	cputime_speedadj = pcpu->cputime_speedadj;
+	spin_unlock_irqrestore(&pcpu->load_lock, flags);
+
+	if (WARN_ON_ONCE(!delta_time))
+		goto rearm;
+
+	do_div(cputime_speedadj, delta_time);
+	loadadjfreq = (unsigned int)cputime_speedadj * 100;
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	if (sched_driven)
+		loadadjfreq = sched_get_cpu_demand(data) * pcpu->policy->cur;
+	else if (use_sched_load)
+		loadadjfreq = max(loadadjfreq,
+			sched_get_cpu_demand(data) * pcpu->policy->cur);
+#endif
+
+	spin_lock_irqsave(&pcpu->eval_lock, flags);
+	settled = cpufreq_interactive_evaluate(pcpu, data, loadadjfreq, now);
+	spin_unlock_irqrestore(&pcpu->eval_lock, flags);
+
+	if (!settled)
+		goto rearm;
 
-rearm_if_notmax:
 	/*
 	 * Already set max speed and don't see a need to change that,
 	 * wait until next idle to re-evaluate, don't need timer.
@@ -511,6 +591,13 @@ rearm_if_notmax:
 		goto exit;
 
 rearm:
+	/*
+	 * The scheduler reports load on its own while this cpu is busy; the
+	 * timer is only needed to bring an idle cpu down to the minimum.
+	 */
+	if (sched_driven && pcpu->target_freq == pcpu->policy->min)
+		goto exit;
+
 	if (!timer_pending(&pcpu->cpu_timer))
 		cpufreq_interactive_timer_resched(pcpu);
 
@@ -572,6 +659,12 @@ static void cpufreq_interactive_idle_end(void)
 		return;
 	}
 
+	/* The scheduler will report the load of this cpu from now on. */
+	if (sched_driven) {
+		up_read(&pcpu->enable_sem);
+		return;
+	}
+
 	/* Arm the timer for 1-2 ticks later if not already. */
 	if (!timer_pending(&pcpu->cpu_timer)) {
 		cpufreq_interactive_timer_resched(pcpu);
@@ -658,8 +751,8 @@ static void cpufreq_interactive_boost(void)
 	for_each_online_cpu(i) {
 		pcpu = &per_cpu(cpuinfo, i);
 
-		if (pcpu->target_freq < hispeed_freq) {
-			pcpu->target_freq = hispeed_freq;
+		if (pcpu->target_freq < pcpu->tunables->hispeed_freq) {
+			pcpu->target_freq = pcpu->tunables->hispeed_freq;
 			cpumask_set_cpu(i, &speedchange_cpumask);
 			pcpu->hispeed_validate_time =
 				ktime_to_us(ktime_get());
@@ -671,7 +764,7 @@ static void cpufreq_interactive_boost(void)
 		 * validated.
 		 */
 
-		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_freq = pcpu->tunables->hispeed_freq;
 		pcpu->floor_validate_time = ktime_to_us(ktime_get());
 	}
 
@@ -725,6 +818,87 @@ static struct notifier_block cpufreq_notifier_block = {
 	.notifier_call = cpufreq_interactive_notifier,
 };
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Called by the scheduler when tasks with a significant demand wake up on,
+ * migrate to or from, or exit on @cpu, and on every enqueue and tick of
+ * @cpu in sched_driven mode.  Outside of sched_driven mode only speed up
+ * here; lowering the speed is left to the timer so that floor_freq and
+ * min_sample_time keep being honoured.
+ */
+static int cpufreq_interactive_demand_notifier(struct notifier_block *nb,
+					       unsigned long cpu, void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	struct cpufreq_interactive_tunables *tunables = pcpu->tunables;
+	unsigned int loadadjfreq, new_freq, index;
+	unsigned long flags;
+	int cpu_load;
+	u64 now;
+
+	if (!use_sched_load && !sched_driven)
+		return 0;
+	if (!down_read_trylock(&pcpu->enable_sem))
+		return 0;
+	if (!pcpu->governor_enabled)
+		goto exit;
+
+	/* Skip if this cpu's speed is being chosen elsewhere. */
+	if (!spin_trylock_irqsave(&pcpu->eval_lock, flags))
+		goto exit;
+
+	loadadjfreq = sched_get_cpu_demand(cpu) * pcpu->policy->cur;
+	now = ktime_to_us(ktime_get());
+
+	if (sched_driven) {
+		cpufreq_interactive_evaluate(pcpu, cpu, loadadjfreq, now);
+		goto unlock;
+	}
+
+	cpu_load = loadadjfreq / pcpu->target_freq;
+	new_freq = choose_freq(pcpu, loadadjfreq);
+	if (cpu_load >= tunables->go_hispeed_load &&
+	    new_freq < tunables->hispeed_freq)
+		new_freq = tunables->hispeed_freq;
+
+	if (new_freq <= pcpu->target_freq)
+		goto unlock;
+
+	if (pcpu->target_freq >= tunables->hispeed_freq &&
+	    now - pcpu->hispeed_validate_time <
+	    freq_to_above_hispeed_delay(tunables, pcpu->target_freq))
+		goto unlock;
+
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_L,
+					   &index))
+		goto unlock;
+
+	new_freq = pcpu->freq_table[index].frequency;
+	trace_cpufreq_interactive_target(cpu, cpu_load, pcpu->target_freq,
+					 pcpu->policy->cur, new_freq);
+
+	pcpu->target_freq = new_freq;
+	pcpu->floor_freq = new_freq;
+	pcpu->floor_validate_time = now;
+	pcpu->hispeed_validate_time = now;
+	spin_lock(&speedchange_cpumask_lock);
+	cpumask_set_cpu(cpu, &speedchange_cpumask);
+	spin_unlock(&speedchange_cpumask_lock);
+	wake_up_process(speedchange_task);
+
+unlock:
+	spin_unlock_irqrestore(&pcpu->eval_lock, flags);
+exit:
+	up_read(&pcpu->enable_sem);
+	return 0;
+}
+
+static struct notifier_block cpufreq_interactive_demand_nb = {
+	.notifier_call = cpufreq_interactive_demand_notifier,
+};
+#endif
+
 static unsigned int *get_tokenized_data(const char *buf, int *num_tokens)
 {
 	const char *cp;
@@ -770,21 +944,69 @@ err:
 	return ERR_PTR(err);
 }
 
+/*
+ * The tunable set shown through @kobj: common_tunables for the global
+ * node, the policy's own set otherwise.
+ */
+static struct cpufreq_interactive_tunables *to_tunables(struct kobject *kobj)
+{
+	if (kobj == cpufreq_global_kobject)
+		return &common_tunables;
+	return container_of(kobj, struct cpufreq_interactive_tunables, kobj);
+}
+
+/*
+ * Iterate over the tunable sets a write through @kobj applies to: every
+ * set for the global node, the policy's own set otherwise.  The caller
+ * holds tunables_lock.
+ */
+#define for_each_target_tunables(tunables, kobj)			\
+	list_for_each_entry(tunables, &tunables_list, list)		\
+		if ((kobj) != cpufreq_global_kobject &&			\
+		    &(tunables)->kobj != (kobj)) {} else
+
+/*
+ * Replace the array at *@array, protected by @lock, with a copy of the
+ * @ntokens values at @data.  @default_array is never freed.
+ */
+static int set_tunable_array(spinlock_t *lock, unsigned int **array,
+			     int *narray, unsigned int *default_array,
+			     const unsigned int *data, int ntokens)
+{
+	unsigned int *new_array, *old_array;
+	unsigned long flags;
+
+	new_array = kmemdup(data, ntokens * sizeof(unsigned int), GFP_KERNEL);
+	if (!new_array)
+		return -ENOMEM;
+
+	spin_lock_irqsave(lock, flags);
+	old_array = *array;
+	*array = new_array;
+	*narray = ntokens;
+	spin_unlock_irqrestore(lock, flags);
+
+	if (old_array != default_array)
+		kfree(old_array);
+	return 0;
+}
+
 static ssize_t show_target_loads(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
+	struct cpufreq_interactive_tunables *tunables = to_tunables(kobj);
 	int i;
 	ssize_t ret = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&target_loads_lock, flags);
+	spin_lock_irqsave(&tunables->target_loads_lock, flags);
 
-	for (i = 0; i < ntarget_loads; i++)
-		ret += sprintf(buf + ret, "%u%s", target_loads[i],
+	for (i = 0; i < tunables->ntarget_loads; i++)
+		ret += sprintf(buf + ret, "%u%s", tunables->target_loads[i],
 			       i & 0x1 ? ":" : " ");
 
 	sprintf(buf + ret - 1, "\n");
-	spin_unlock_irqrestore(&target_loads_lock, flags);
+	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
 	return ret;
 }
 
@@ -792,21 +1014,29 @@ static ssize_t store_target_loads(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ntokens;
 	unsigned int *new_target_loads = NULL;
-	unsigned long flags;
+	int ret = 0;
 
 	new_target_loads = get_tokenized_data(buf, &ntokens);
 	if (IS_ERR(new_target_loads))
 		return PTR_RET(new_target_loads);
 
-	spin_lock_irqsave(&target_loads_lock, flags);
-	if (target_loads != default_target_loads)
-		kfree(target_loads);
-	target_loads = new_target_loads;
-	ntarget_loads = ntokens;
-	spin_unlock_irqrestore(&target_loads_lock, flags);
-	return count;
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj) {
+		ret = set_tunable_array(&tunables->target_loads_lock,
+					&tunables->target_loads,
+					&tunables->ntarget_loads,
+					default_target_loads,
+					new_target_loads, ntokens);
+		if (ret)
+			break;
+	}
+	mutex_unlock(&tunables_lock);
+
+	kfree(new_target_loads);
+	return ret ? ret : count;
 }
 
 static struct global_attr target_loads_attr =
@@ -816,18 +1046,20 @@ static struct global_attr target_loads_attr =
 static ssize_t show_above_hispeed_delay(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
+	struct cpufreq_interactive_tunables *tunables = to_tunables(kobj);
 	int i;
 	ssize_t ret = 0;
 	unsigned long flags;
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
+	spin_lock_irqsave(&tunables->above_hispeed_delay_lock, flags);
 
-	for (i = 0; i < nabove_hispeed_delay; i++)
-		ret += sprintf(buf + ret, "%u%s", above_hispeed_delay[i],
+	for (i = 0; i < tunables->nabove_hispeed_delay; i++)
+		ret += sprintf(buf + ret, "%u%s",
+			       tunables->above_hispeed_delay[i],
 			       i & 0x1 ? ":" : " ");
 
 	sprintf(buf + ret - 1, "\n");
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
+	spin_unlock_irqrestore(&tunables->above_hispeed_delay_lock, flags);
 	return ret;
 }
 
@@ -835,22 +1067,29 @@ static ssize_t store_above_hispeed_delay(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ntokens;
 	unsigned int *new_above_hispeed_delay = NULL;
-	unsigned long flags;
+	int ret = 0;
 
 	new_above_hispeed_delay = get_tokenized_data(buf, &ntokens);
 	if (IS_ERR(new_above_hispeed_delay))
 		return PTR_RET(new_above_hispeed_delay);
 
-	spin_lock_irqsave(&above_hispeed_delay_lock, flags);
-	if (above_hispeed_delay != default_above_hispeed_delay)
-		kfree(above_hispeed_delay);
-	above_hispeed_delay = new_above_hispeed_delay;
-	nabove_hispeed_delay = ntokens;
-	spin_unlock_irqrestore(&above_hispeed_delay_lock, flags);
-	return count;
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj) {
+		ret = set_tunable_array(&tunables->above_hispeed_delay_lock,
+					&tunables->above_hispeed_delay,
+					&tunables->nabove_hispeed_delay,
+					default_above_hispeed_delay,
+					new_above_hispeed_delay, ntokens);
+		if (ret)
+			break;
+	}
+	mutex_unlock(&tunables_lock);
 
+	kfree(new_above_hispeed_delay);
+	return ret ? ret : count;
 }
 
 static struct global_attr above_hispeed_delay_attr =
@@ -860,20 +1099,25 @@ static struct global_attr above_hispeed_delay_attr =
 static ssize_t show_hispeed_freq(struct kobject *kobj,
 				 struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%u\n", hispeed_freq);
+	return sprintf(buf, "%u\n", to_tunables(kobj)->hispeed_freq);
 }
 
 static ssize_t store_hispeed_freq(struct kobject *kobj,
 				  struct attribute *attr, const char *buf,
 				  size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ret;
 	long unsigned int val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	hispeed_freq = val;
+
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj)
+		tunables->hispeed_freq = val;
+	mutex_unlock(&tunables_lock);
 	return count;
 }
 
@@ -907,19 +1151,24 @@ static struct global_attr sampling_down_factor_attr =
 static ssize_t show_go_hispeed_load(struct kobject *kobj,
 				     struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", go_hispeed_load);
+	return sprintf(buf, "%lu\n", to_tunables(kobj)->go_hispeed_load);
 }
 
 static ssize_t store_go_hispeed_load(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ret;
 	unsigned long val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	go_hispeed_load = val;
+
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj)
+		tunables->go_hispeed_load = val;
+	mutex_unlock(&tunables_lock);
 	return count;
 }
 
@@ -929,19 +1178,24 @@ static struct global_attr go_hispeed_load_attr = __ATTR(go_hispeed_load, 0644,
 static ssize_t show_min_sample_time(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", min_sample_time);
+	return sprintf(buf, "%lu\n", to_tunables(kobj)->min_sample_time);
 }
 
 static ssize_t store_min_sample_time(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ret;
 	unsigned long val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	min_sample_time = val;
+
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj)
+		tunables->min_sample_time = val;
+	mutex_unlock(&tunables_lock);
 	return count;
 }
 
@@ -951,19 +1205,24 @@ static struct global_attr min_sample_time_attr = __ATTR(min_sample_time, 0644,
 static ssize_t show_timer_rate(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", timer_rate);
+	return sprintf(buf, "%lu\n", to_tunables(kobj)->timer_rate);
 }
 
 static ssize_t store_timer_rate(struct kobject *kobj,
 			struct attribute *attr, const char *buf, size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ret;
 	unsigned long val;
 
 	ret = strict_strtoul(buf, 0, &val);
 	if (ret < 0)
 		return ret;
-	timer_rate = val;
+
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj)
+		tunables->timer_rate = val;
+	mutex_unlock(&tunables_lock);
 	return count;
 }
 
@@ -973,21 +1232,25 @@ static struct global_attr timer_rate_attr = __ATTR(timer_rate, 0644,
 static ssize_t show_timer_slack(
 	struct kobject *kobj, struct attribute *attr, char *buf)
 {
-	return sprintf(buf, "%d\n", timer_slack_val);
+	return sprintf(buf, "%d\n", to_tunables(kobj)->timer_slack_val);
 }
 
 static ssize_t store_timer_slack(
 	struct kobject *kobj, struct attribute *attr, const char *buf,
 	size_t count)
 {
+	struct cpufreq_interactive_tunables *tunables;
 	int ret;
-	unsigned long val;
+	long val;
 
 	ret = kstrtol(buf, 10, &val);
 	if (ret < 0)
 		return ret;
 
-	timer_slack_val = val;
+	mutex_lock(&tunables_lock);
+	for_each_target_tunables(tunables, kobj)
+		tunables->timer_slack_val = val;
+	mutex_unlock(&tunables_lock);
 	return count;
 }
 
@@ -1087,6 +1350,53 @@ static ssize_t store_io_is_busy(struct kobject *kobj,
 static struct global_attr io_is_busy_attr = __ATTR(io_is_busy, 0644,
 		show_io_is_busy, store_io_is_busy);
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+static ssize_t show_use_sched_load(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", use_sched_load);
+}
+
+static ssize_t store_use_sched_load(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	use_sched_load = val;
+	return count;
+}
+
+static struct global_attr use_sched_load_attr = __ATTR(use_sched_load, 0644,
+		show_use_sched_load, store_use_sched_load);
+
+static ssize_t show_sched_driven(struct kobject *kobj,
+			struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", sched_driven);
+}
+
+static ssize_t store_sched_driven(struct kobject *kobj,
+			struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	sched_driven = val;
+	sched_set_demand_callbacks(sched_driven);
+	return count;
+}
+
+static struct global_attr sched_driven_attr = __ATTR(sched_driven, 0644,
+		show_sched_driven, store_sched_driven);
+#endif
+
 static ssize_t show_sync_freq(struct kobject *kobj,
 			struct attribute *attr, char *buf)
 {
@@ -1169,6 +1479,10 @@ static struct attribute *interactive_attributes[] = {
 	&boostpulse.attr,
 	&boostpulse_duration.attr,
 	&io_is_busy_attr.attr,
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	&use_sched_load_attr.attr,
+	&sched_driven_attr.attr,
+#endif
 	&sampling_down_factor_attr.attr,
 	&sync_freq_attr.attr,
 	&up_threshold_any_cpu_load_attr.attr,
@@ -1181,6 +1495,74 @@ static struct attribute_group interactive_attr_group = {
 	.name = "interactive",
 };
 
+/* Tunables that can also be set for each policy */
+static struct attribute *interactive_policy_attributes[] = {
+	&target_loads_attr.attr,
+	&above_hispeed_delay_attr.attr,
+	&hispeed_freq_attr.attr,
+	&go_hispeed_load_attr.attr,
+	&min_sample_time_attr.attr,
+	&timer_rate_attr.attr,
+	&timer_slack.attr,
+	NULL,
+};
+
+static struct kobj_type interactive_tunables_ktype = {
+	.sysfs_ops = &kobj_sysfs_ops,
+	.default_attrs = interactive_policy_attributes,
+};
+
+/*
+ * Return the tunable set of a policy owned by @cpu: the one it used last
+ * time, or a new copy of common_tunables. Called with gov_lock held.
+ */
+static struct cpufreq_interactive_tunables *get_policy_tunables(int cpu)
+{
+	struct cpufreq_interactive_tunables *tunables;
+
+	tunables = per_cpu(cached_tunables, cpu);
+	if (tunables)
+		return tunables;
+
+	tunables = kzalloc(sizeof(*tunables), GFP_KERNEL);
+	if (!tunables)
+		return NULL;
+
+	mutex_lock(&tunables_lock);
+	tunables->hispeed_freq = common_tunables.hispeed_freq;
+	tunables->go_hispeed_load = common_tunables.go_hispeed_load;
+	tunables->min_sample_time = common_tunables.min_sample_time;
+	tunables->timer_rate = common_tunables.timer_rate;
+	tunables->timer_slack_val = common_tunables.timer_slack_val;
+	spin_lock_init(&tunables->target_loads_lock);
+	spin_lock_init(&tunables->above_hispeed_delay_lock);
+	tunables->target_loads = default_target_loads;
+	tunables->above_hispeed_delay = default_above_hispeed_delay;
+	if (set_tunable_array(&tunables->target_loads_lock,
+			      &tunables->target_loads,
+			      &tunables->ntarget_loads, default_target_loads,
+			      common_tunables.target_loads,
+			      common_tunables.ntarget_loads) ||
+	    set_tunable_array(&tunables->above_hispeed_delay_lock,
+			      &tunables->above_hispeed_delay,
+			      &tunables->nabove_hispeed_delay,
+			      default_above_hispeed_delay,
+			      common_tunables.above_hispeed_delay,
+			      common_tunables.nabove_hispeed_delay)) {
+		mutex_unlock(&tunables_lock);
+		if (tunables->target_loads != default_target_loads)
+			kfree(tunables->target_loads);
+		kfree(tunables);
+		return NULL;
+	}
+	kobject_init(&tunables->kobj, &interactive_tunables_ktype);
+	list_add_tail(&tunables->list, &tunables_list);
+	mutex_unlock(&tunables_lock);
+
+	per_cpu(cached_tunables, cpu) = tunables;
+	return tunables;
+}
+
 static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
 					     unsigned long val,
 					     void *data)
@@ -1207,6 +1589,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 	int rc;
 	unsigned int j;
 	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_interactive_tunables *tunables;
 	struct cpufreq_frequency_table *freq_table;
 	unsigned long expire_time;
 
@@ -1217,14 +1600,31 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 
 		mutex_lock(&gov_lock);
 
+		if (!common_tunables.hispeed_freq)
+			common_tunables.hispeed_freq = policy->max;
+
+		tunables = get_policy_tunables(policy->cpu);
+		if (!tunables) {
+			mutex_unlock(&gov_lock);
+			return -ENOMEM;
+		}
+
+		rc = kobject_add(&tunables->kobj, &policy->kobj, "interactive");
+		if (rc) {
+			mutex_unlock(&gov_lock);
+			return rc;
+		}
+
+		if (!tunables->hispeed_freq)
+			tunables->hispeed_freq = policy->max;
+
 		freq_table =
 			cpufreq_frequency_get_table(policy->cpu);
-		if (!hispeed_freq)
-			hispeed_freq = policy->max;
 
 		for_each_cpu(j, policy->cpus) {
 			pcpu = &per_cpu(cpuinfo, j);
 			pcpu->policy = policy;
+			pcpu->tunables = tunables;
 			pcpu->target_freq = policy->cur;
 			pcpu->freq_table = freq_table;
 			pcpu->floor_freq = pcpu->target_freq;
@@ -1259,6 +1659,11 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		idle_notifier_register(&cpufreq_interactive_idle_nb);
 		cpufreq_register_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		atomic_notifier_chain_register(&cpu_demand_notifier_head,
+					       &cpufreq_interactive_demand_nb);
+		sched_set_demand_callbacks(sched_driven);
+#endif
 		mutex_unlock(&gov_lock);
 		break;
 
@@ -1274,16 +1679,25 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			up_write(&pcpu->enable_sem);
 		}
 
+		kobject_del(&per_cpu(cpuinfo, policy->cpu).tunables->kobj);
+
 		if (--active_count > 0) {
 			mutex_unlock(&gov_lock);
 			return 0;
 		}
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		atomic_notifier_chain_unregister(&cpu_demand_notifier_head,
+						 &cpufreq_interactive_demand_nb);
+#endif
 		cpufreq_unregister_notifier(
 			&cpufreq_notifier_block, CPUFREQ_TRANSITION_NOTIFIER);
 		idle_notifier_unregister(&cpufreq_interactive_idle_nb);
 		sysfs_remove_group(cpufreq_global_kobject,
 				&interactive_attr_group);
+#ifdef CONFIG_SCHED_FREQ_INPUT
+		sched_set_demand_callbacks(0);
+#endif
 		mutex_unlock(&gov_lock);
 
 		break;
@@ -1331,8 +1745,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 				 * calculations do not get reset.
 				 */
 				add_timer_on(&pcpu->cpu_timer, j);
-				if (timer_slack_val >= 0 && pcpu->target_freq >
-							pcpu->policy->min)
+				if (pcpu->tunables->timer_slack_val >= 0 &&
+				    pcpu->target_freq > pcpu->policy->min)
 					add_timer_on(&pcpu->cpu_slack_timer, j);
 			} else if (policy->min >= pcpu->target_freq) {
 				pcpu->target_freq = policy->min;
@@ -1352,7 +1766,8 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 				 * was already going to expire soon.
 				 */
 				expire_time = pcpu->cpu_timer.expires - jiffies;
-				expire_time = min(usecs_to_jiffies(timer_rate),
+				expire_time = min(usecs_to_jiffies(
+						  pcpu->tunables->timer_rate),
 						  expire_time);
 				expire_time = max(MIN_TIMER_JIFFIES,
 						  expire_time);
@@ -1387,12 +1802,15 @@ static int __init cpufreq_interactive_init(void)
 		init_timer(&pcpu->cpu_slack_timer);
 		pcpu->cpu_slack_timer.function = cpufreq_interactive_nop_timer;
 		spin_lock_init(&pcpu->load_lock);
+		pcpu->tunables = &common_tunables;
 		init_rwsem(&pcpu->enable_sem);
+		spin_lock_init(&pcpu->eval_lock);
 	}
 
-	spin_lock_init(&target_loads_lock);
+	spin_lock_init(&common_tunables.target_loads_lock);
 	spin_lock_init(&speedchange_cpumask_lock);
-	spin_lock_init(&above_hispeed_delay_lock);
+	spin_lock_init(&common_tunables.above_hispeed_delay_lock);
+	list_add(&common_tunables.list, &tunables_list);
 	mutex_init(&gov_lock);
 	speedchange_task =
 		kthread_create(cpufreq_interactive_speedchange_task, NULL,
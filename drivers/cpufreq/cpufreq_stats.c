@@ -24,10 +24,44 @@
 #include <linux/err.h>
 #include <linux/of.h>
 #include <linux/sched.h>
+#include <linux/hashtable.h>
+#include <linux/proc_fs.h>
+#include <linux/profile.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
 #include <asm/cputime.h>
 
 static spinlock_t cpufreq_stats_lock;
 
+/*
+ * Per task time in state is indexed by the position of a frequency in
+ * task_freq_table. The table is append only, so indices stay valid as
+ * more CPUs register their frequencies.
+ */
+#define TASK_MAX_STATES	64
+#define UID_HASH_BITS	8
+
+static unsigned int task_freq_table[TASK_MAX_STATES];
+static unsigned int task_freq_states;
+
+static DEFINE_HASHTABLE(uid_hash_table, UID_HASH_BITS);
+static DEFINE_MUTEX(uid_lock);
+
+/* time in state of the exited tasks of a uid */
+struct uid_time_in_state {
+	uid_t uid;
+	unsigned int max_state;
+	u64 *rec;
+	struct hlist_node hash;
+	cputime64_t time_in_state[0];
+};
+
+struct uid_time_in_state_snap {
+	size_t size;
+	u64 data[0];
+};
+
 #define CPUFREQ_STATDEVICE_ATTR(_name, _mode, _show) \
 static struct freq_attr _attr_##_name = {\
 	.attr = {.name = __stringify(_name), .mode = _mode, }, \
@@ -41,6 +75,7 @@ struct cpufreq_stats {
 	unsigned int max_state;
 	unsigned int state_num;
 	unsigned int last_index;
+	int task_index;
 	cputime64_t *time_in_state;
 	unsigned int *freq_table;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
@@ -140,6 +175,22 @@ static int get_index_all_cpufreq_stat(struct all_cpufreq_stats *all_stat,
 	return -1;
 }
 
+/* Called with cpufreq_stats_lock held */
+static int task_freq_get_index(unsigned int freq, bool add)
+{
+	unsigned int i;
+
+	for (i = 0; i < task_freq_states; i++)
+		if (task_freq_table[i] == freq)
+			return i;
+	if (!add || task_freq_states == TASK_MAX_STATES)
+		return -1;
+	task_freq_table[task_freq_states] = freq;
+	/* lockless readers check task_freq_states before the table */
+	smp_wmb();
+	return task_freq_states++;
+}
+
 void acct_update_power(struct task_struct *task, cputime_t cputime) {
 	struct cpufreq_power_stats *powerstats;
 	struct cpufreq_stats *stats;
@@ -150,7 +201,13 @@ void acct_update_power(struct task_struct *task, cputime_t cputime) {
 	cpu_num = task_cpu(task);
 	powerstats = per_cpu(cpufreq_power_stats, cpu_num);
 	stats = per_cpu(cpufreq_stats_table, cpu_num);
-	if (!powerstats || !stats)
+	if (!stats)
+		return;
+
+	if ((unsigned int)stats->task_index < task->max_state)
+		task->time_in_state[stats->task_index] += cputime;
+
+	if (!powerstats)
 		return;
 
 	curr = powerstats->curr[stats->last_index];
@@ -159,6 +216,218 @@ void acct_update_power(struct task_struct *task, cputime_t cputime) {
 }
 EXPORT_SYMBOL_GPL(acct_update_power);
 
+/**
+ * cpufreq_task_stats_init - Give a new task its own time in state
+ * @p: Task being forked
+ *
+ * Tasks forked before any frequency table was registered are not
+ * accounted.
+ */
+void cpufreq_task_stats_init(struct task_struct *p)
+{
+	unsigned int max_state = ACCESS_ONCE(task_freq_states);
+
+	p->time_in_state = NULL;
+	p->max_state = 0;
+	if (!max_state)
+		return;
+
+	p->time_in_state = kcalloc(max_state, sizeof(*p->time_in_state),
+				   GFP_KERNEL);
+	if (p->time_in_state)
+		p->max_state = max_state;
+}
+
+void cpufreq_task_stats_free(struct task_struct *p)
+{
+	kfree(p->time_in_state);
+}
+
+int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
+			    struct pid *pid, struct task_struct *p)
+{
+	unsigned int i, max_state = ACCESS_ONCE(p->max_state);
+
+	smp_rmb();
+	for (i = 0; i < max_state; i++)
+		seq_printf(m, "%u %llu\n", task_freq_table[i],
+			   (unsigned long long)
+			   cputime_to_clock_t(p->time_in_state[i]));
+	return 0;
+}
+
+static struct uid_time_in_state *find_uid_entry(uid_t uid)
+{
+	struct uid_time_in_state *uid_entry;
+	struct hlist_node *node;
+
+	hash_for_each_possible(uid_hash_table, uid_entry, node, hash, uid) {
+		if (uid_entry->uid == uid)
+			return uid_entry;
+	}
+	return NULL;
+}
+
+/* Called with uid_lock held, and possibly tasklist_lock */
+static struct uid_time_in_state *find_or_register_uid(uid_t uid)
+{
+	struct uid_time_in_state *uid_entry;
+	unsigned int max_state;
+
+	uid_entry = find_uid_entry(uid);
+	if (uid_entry)
+		return uid_entry;
+
+	max_state = ACCESS_ONCE(task_freq_states);
+	uid_entry = kzalloc(sizeof(*uid_entry) +
+			    max_state * sizeof(uid_entry->time_in_state[0]),
+			    GFP_ATOMIC);
+	if (!uid_entry)
+		return NULL;
+
+	uid_entry->uid = uid;
+	uid_entry->max_state = max_state;
+	hash_add(uid_hash_table, &uid_entry->hash, uid);
+
+	return uid_entry;
+}
+
+/*
+ * Fold the time in state of an exiting task into its uid. The task is
+ * not accounted any further, nor counted again by a reader.
+ */
+static int cpufreq_stats_task_exit(struct notifier_block *nb,
+				   unsigned long cmd, void *v)
+{
+	struct task_struct *task = v;
+	struct uid_time_in_state *uid_entry;
+	unsigned int i, max_state;
+
+	if (!task || !task->max_state)
+		return NOTIFY_OK;
+
+	mutex_lock(&uid_lock);
+	max_state = task->max_state;
+	task->max_state = 0;
+	uid_entry = find_or_register_uid(task_uid(task));
+	if (!uid_entry) {
+		pr_err("%s: failed to find uid %d\n", __func__,
+		       task_uid(task));
+		goto exit;
+	}
+
+	max_state = min(max_state, uid_entry->max_state);
+	for (i = 0; i < max_state; i++)
+		uid_entry->time_in_state[i] += task->time_in_state[i];
+exit:
+	mutex_unlock(&uid_lock);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block task_exit_notifier_block = {
+	.notifier_call = cpufreq_stats_task_exit,
+};
+
+/*
+ * /proc/uid_time_in_state is binary, all fields native endian u64:
+ * nr_states, freq[nr_states], then for each uid: uid,
+ * time[nr_states] in USER_HZ ticks. It is snapshotted on open, so it can
+ * be read in a single read() with a large enough buffer.
+ */
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	struct uid_time_in_state_snap *snap;
+	struct uid_time_in_state *uid_entry;
+	struct task_struct *task, *temp;
+	struct hlist_node *node;
+	unsigned int nr_states, nr_uids = 0, i, n;
+	unsigned long bkt;
+	u64 *rec;
+	size_t size;
+
+	nr_states = ACCESS_ONCE(task_freq_states);
+	smp_rmb();
+
+	mutex_lock(&uid_lock);
+
+	/* register the uids of running tasks, so that the size is known */
+	read_lock(&tasklist_lock);
+	do_each_thread(temp, task) {
+		if (task->max_state)
+			find_or_register_uid(task_uid(task));
+	} while_each_thread(temp, task);
+	read_unlock(&tasklist_lock);
+
+	hash_for_each(uid_hash_table, bkt, node, uid_entry, hash)
+		nr_uids++;
+
+	size = (1 + nr_states + nr_uids * (1 + nr_states)) * sizeof(u64);
+	snap = vzalloc(sizeof(*snap) + size);
+	if (!snap) {
+		mutex_unlock(&uid_lock);
+		return -ENOMEM;
+	}
+	snap->size = size;
+
+	snap->data[0] = nr_states;
+	for (i = 0; i < nr_states; i++)
+		snap->data[1 + i] = task_freq_table[i];
+
+	rec = snap->data + 1 + nr_states;
+	hash_for_each(uid_hash_table, bkt, node, uid_entry, hash) {
+		uid_entry->rec = rec;
+		rec[0] = uid_entry->uid;
+		n = min(nr_states, uid_entry->max_state);
+		for (i = 0; i < n; i++)
+			rec[1 + i] = uid_entry->time_in_state[i];
+		rec += 1 + nr_states;
+	}
+
+	read_lock(&tasklist_lock);
+	do_each_thread(temp, task) {
+		/* tasks forked since the first pass are left out */
+		uid_entry = find_uid_entry(task_uid(task));
+		if (!uid_entry)
+			continue;
+		n = min(nr_states, task->max_state);
+		for (i = 0; i < n; i++)
+			uid_entry->rec[1 + i] += task->time_in_state[i];
+	} while_each_thread(temp, task);
+	read_unlock(&tasklist_lock);
+
+	mutex_unlock(&uid_lock);
+
+	rec = snap->data + 1 + nr_states;
+	for (n = 0; n < nr_uids; n++, rec += 1 + nr_states)
+		for (i = 0; i < nr_states; i++)
+			rec[1 + i] = cputime64_to_clock_t(rec[1 + i]);
+
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t uid_time_in_state_read(struct file *file, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct uid_time_in_state_snap *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->data,
+				       snap->size);
+}
+
+static int uid_time_in_state_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= uid_time_in_state_read,
+	.llseek		= default_llseek,
+	.release	= uid_time_in_state_release,
+};
+
 static ssize_t show_current_in_state(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
 {
@@ -422,8 +691,11 @@ static int cpufreq_stats_create_table(struct cpufreq_policy *policy,
 	}
 	stat->state_num = j;
 	spin_lock(&cpufreq_stats_lock);
+	for (i = 0; i < stat->state_num; i++)
+		task_freq_get_index(stat->freq_table[i], true);
 	stat->last_time = get_jiffies_64();
 	stat->last_index = freq_table_get_index(stat, policy->cur);
+	stat->task_index = task_freq_get_index(policy->cur, false);
 	spin_unlock(&cpufreq_stats_lock);
 	cpufreq_cpu_put(data);
 	return 0;
@@ -642,6 +914,7 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 
 	spin_lock(&cpufreq_stats_lock);
 	stat->last_index = new_index;
+	stat->task_index = task_freq_get_index(freq->new, false);
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stat->trans_table[old_index * stat->max_state + new_index]++;
 #endif
@@ -763,6 +1036,11 @@ static int __init cpufreq_stats_init(void)
 	if (ret)
 		pr_warn("Cannot create sysfs file for cpufreq current stats\n");
 
+	if (!proc_create("uid_time_in_state", S_IRUGO, NULL,
+			 &uid_time_in_state_fops))
+		pr_warn("Cannot create proc file for uid time in state\n");
+	profile_event_register(PROFILE_TASK_EXIT, &task_exit_notifier_block);
+
 	return 0;
 }
 static void __exit cpufreq_stats_exit(void)
@@ -774,6 +1052,8 @@ static void __exit cpufreq_stats_exit(void)
 	cpufreq_unregister_notifier(&notifier_trans_block,
 			CPUFREQ_TRANSITION_NOTIFIER);
 	unregister_hotcpu_notifier(&cpufreq_stat_cpu_notifier);
+	profile_event_unregister(PROFILE_TASK_EXIT, &task_exit_notifier_block);
+	remove_proc_entry("uid_time_in_state", NULL);
 	for_each_online_cpu(cpu) {
 		cpufreq_stats_free_table(cpu);
 		cpufreq_stats_free_sysfs(cpu);
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Load based CPU hotplug.
+ *
+ * Every sample_ms the number of CPUs needed is derived from the average
+ * number of runnable tasks (sched_get_nr_running_avg()) and the busy time
+ * of the online CPUs. More CPUs are brought up as soon as a sample asks for
+ * them. CPUs are only taken down after the load has stayed low enough for
+ * down_delay_ms, one at a time, so short dips don't cause hotplug churn.
+ *
+ * Touch and key input, and with SCHED_FREQ_INPUT the wakeup of a task with
+ * significant demand, trigger an evaluation right away instead of waiting
+ * for the next sample. Input additionally keeps at least input_min_cpus
+ * online for input_ms.
+ *
+ * CPUs the thermal driver took down are never brought back up from here.
+ */
+
+#define pr_fmt(fmt) "msm-hotplug: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/input.h>
+#include <linux/notifier.h>
+#include <linux/msm_thermal.h>
+
+struct hotplug_cpu_load {
+	u64 prev_idle;
+	u64 prev_wall;
+	bool valid;
+};
+
+static DEFINE_PER_CPU(struct hotplug_cpu_load, cpu_load);
+static struct workqueue_struct *hotplug_wq;
+static struct delayed_work hotplug_work;
+static struct work_struct hotplug_kick_work;
+static DEFINE_MUTEX(hotplug_mutex);
+
+static u64 down_since;
+static u64 input_until;
+static u64 last_kick_time;
+#define MIN_KICK_INTERVAL (5 * USEC_PER_MSEC)
+
+static bool enabled;
+
+static unsigned int min_cpus = 1;
+module_param(min_cpus, uint, 0644);
+
+static unsigned int max_cpus = NR_CPUS;
+module_param(max_cpus, uint, 0644);
+
+static unsigned int sample_ms = 20;
+module_param(sample_ms, uint, 0644);
+
+/* Busiest CPU load (%) above which one more CPU is brought up */
+static unsigned int up_load = 90;
+module_param(up_load, uint, 0644);
+
+/* Load (%) the remaining CPUs may reach after one is taken down */
+static unsigned int down_load = 60;
+module_param(down_load, uint, 0644);
+
+/* Average runnable tasks (x100) per online CPU to bring one more up */
+static unsigned int nr_up_thresh = 125;
+module_param(nr_up_thresh, uint, 0644);
+
+/* Average runnable tasks (x100) per remaining CPU to take one down */
+static unsigned int nr_down_thresh = 75;
+module_param(nr_down_thresh, uint, 0644);
+
+static unsigned int down_delay_ms = 500;
+module_param(down_delay_ms, uint, 0644);
+
+static unsigned int input_min_cpus = 2;
+module_param(input_min_cpus, uint, 0644);
+
+static unsigned int input_ms = 1000;
+module_param(input_ms, uint, 0644);
+
+static unsigned int get_cpu_load(int cpu)
+{
+	struct hotplug_cpu_load *l = &per_cpu(cpu_load, cpu);
+	u64 idle, wall, idle_delta, wall_delta;
+	unsigned int load = 0;
+
+	idle = get_cpu_idle_time_us(cpu, &wall);
+	if (idle == -1ULL)
+		return 0;
+
+	idle_delta = idle - l->prev_idle;
+	wall_delta = wall - l->prev_wall;
+	if (l->valid && wall_delta && idle_delta <= wall_delta)
+		load = div64_u64(100 * (wall_delta - idle_delta), wall_delta);
+
+	l->prev_idle = idle;
+	l->prev_wall = wall;
+	l->valid = true;
+	return load;
+}
+
+/* CPUs that may be brought online: possible and not held by thermal */
+static unsigned int available_cpus(void)
+{
+	uint32_t blocked = msm_thermal_get_cpus_offlined();
+	unsigned int cpu, n = 0;
+
+	for_each_possible_cpu(cpu)
+		if (cpu_online(cpu) || !(blocked & BIT(cpu)))
+			n++;
+	return n;
+}
+
+static unsigned int get_target_cpus(unsigned int online, u64 now)
+{
+	unsigned int cpu, load, max_load = 0, total_load = 0;
+	unsigned int max = min(max_cpus, available_cpus());
+	unsigned int target = online;
+	int nr_avg, iowait_avg;
+
+	sched_get_nr_running_avg(&nr_avg, &iowait_avg);
+
+	for_each_possible_cpu(cpu) {
+		if (!cpu_online(cpu)) {
+			per_cpu(cpu_load, cpu).valid = false;
+			continue;
+		}
+		load = get_cpu_load(cpu);
+		max_load = max(max_load, load);
+		total_load += load;
+	}
+
+	if (nr_avg > online * nr_up_thresh)
+		target = DIV_ROUND_UP(nr_avg, nr_up_thresh);
+	else if (max_load >= up_load)
+		target = online + 1;
+	else if (online > 1 &&
+		 nr_avg < (online - 1) * nr_down_thresh &&
+		 total_load < (online - 1) * down_load)
+		target = online - 1;
+
+	if (now < input_until)
+		target = max(target, input_min_cpus);
+
+	target = max(target, min_cpus);
+	target = min(target, max);
+	return max(target, 1U);
+}
+
+static void __ref hotplug_evaluate(void)
+{
+	unsigned int cpu, online, target;
+	uint32_t blocked;
+	u64 now;
+
+	mutex_lock(&hotplug_mutex);
+	if (!enabled)
+		goto out;
+
+	online = num_online_cpus();
+	now = ktime_to_us(ktime_get());
+	target = get_target_cpus(online, now);
+
+	if (target > online) {
+		down_since = 0;
+		blocked = msm_thermal_get_cpus_offlined();
+		for_each_possible_cpu(cpu) {
+			if (online >= target)
+				break;
+			if (cpu_online(cpu) || (blocked & BIT(cpu)))
+				continue;
+			pr_debug("Online CPU%u, target %u\n", cpu, target);
+			if (!cpu_up(cpu))
+				online++;
+		}
+	} else if (target < online) {
+		if (!down_since) {
+			down_since = now;
+			goto out;
+		}
+		if (now - down_since < down_delay_ms * USEC_PER_MSEC)
+			goto out;
+
+		/* Take down the highest numbered CPU, never CPU0 */
+		for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--) {
+			if (!cpu_online(cpu))
+				continue;
+			pr_debug("Offline CPU%u, target %u\n", cpu, target);
+			cpu_down(cpu);
+			break;
+		}
+		down_since = now;
+	} else {
+		down_since = 0;
+	}
+out:
+	mutex_unlock(&hotplug_mutex);
+}
+
+static void do_hotplug_work(struct work_struct *work)
+{
+	hotplug_evaluate();
+	if (enabled)
+		queue_delayed_work(hotplug_wq, &hotplug_work,
+				   msecs_to_jiffies(sample_ms));
+}
+
+static void do_hotplug_kick(struct work_struct *work)
+{
+	hotplug_evaluate();
+}
+
+/* Evaluate right now, from any context */
+static void hotplug_kick(void)
+{
+	u64 now = ktime_to_us(ktime_get());
+
+	if (now - last_kick_time < MIN_KICK_INTERVAL)
+		return;
+	last_kick_time = now;
+	queue_work(hotplug_wq, &hotplug_kick_work);
+}
+
+static void hotplug_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	if (!enabled)
+		return;
+
+	input_until = ktime_to_us(ktime_get()) + input_ms * USEC_PER_MSEC;
+	if (num_online_cpus() < input_min_cpus)
+		hotplug_kick();
+}
+
+static int hotplug_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "msm-hotplug";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void hotplug_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id hotplug_ids[] = {
+	/* multi-touch touchscreen */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			BIT_MASK(ABS_MT_POSITION_X) |
+			BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	/* touchpad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	/* Keypad */
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{ },
+};
+
+static struct input_handler hotplug_input_handler = {
+	.event          = hotplug_input_event,
+	.connect        = hotplug_input_connect,
+	.disconnect     = hotplug_input_disconnect,
+	.name           = "msm-hotplug",
+	.id_table       = hotplug_ids,
+};
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * A task with significant demand woke up, migrated or exited. Called
+ * without runqueue locks held.
+ */
+static int hotplug_demand_notify(struct notifier_block *nb,
+				 unsigned long cpu, void *data)
+{
+	if (!enabled || num_online_cpus() >= max_cpus)
+		return NOTIFY_OK;
+
+	if (sched_get_cpu_demand(cpu) >= up_load)
+		hotplug_kick();
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block hotplug_demand_nb = {
+	.notifier_call = hotplug_demand_notify,
+};
+#endif
+
+static int set_enabled(const char *val, const struct kernel_param *kp)
+{
+	bool old = enabled;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || !hotplug_wq || old == enabled)
+		return ret;
+
+	if (enabled) {
+		down_since = 0;
+		queue_delayed_work(hotplug_wq, &hotplug_work, 0);
+	} else {
+		cancel_delayed_work_sync(&hotplug_work);
+		cancel_work_sync(&hotplug_kick_work);
+	}
+
+	return 0;
+}
+
+static struct kernel_param_ops param_ops_enabled = {
+	.set = set_enabled,
+	.get = param_get_bool,
+};
+
+module_param_cb(enabled, &param_ops_enabled, &enabled, 0644);
+
+static int __init msm_hotplug_init(void)
+{
+	int ret;
+
+	hotplug_wq = alloc_workqueue("msm_hotplug_wq", WQ_HIGHPRI, 0);
+	if (!hotplug_wq)
+		return -EFAULT;
+
+	INIT_DELAYED_WORK_DEFERRABLE(&hotplug_work, do_hotplug_work);
+	INIT_WORK(&hotplug_kick_work, do_hotplug_kick);
+
+	ret = input_register_handler(&hotplug_input_handler);
+	if (ret)
+		pr_err("Failed to register input handler: %d\n", ret);
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	atomic_notifier_chain_register(&cpu_demand_notifier_head,
+				       &hotplug_demand_nb);
+#endif
+
+	if (enabled)
+		queue_delayed_work(hotplug_wq, &hotplug_work, 0);
+
+	return 0;
+}
+late_initcall(msm_hotplug_init);
@@ -172,6 +172,9 @@ int cpuidle_idle_call(void)
 	trace_power_start_rcuidle(POWER_CSTATE, next_state, dev->cpu);
 	trace_cpu_idle_rcuidle(next_state, dev->cpu);
 
+	/* let the governor learn which interrupt wakes us up */
+	dev->wakeup_irq = CPUIDLE_WAKEUP_PENDING;
+
 	if (cpuidle_state_is_coupled(dev, drv, next_state))
 		entered_state = cpuidle_enter_state_coupled(dev, drv,
 							    next_state);
@@ -343,8 +346,10 @@ int cpuidle_enable_device(struct cpuidle_device *dev)
 	for (i = 0; i < dev->state_count; i++) {
 		dev->states_usage[i].usage = 0;
 		dev->states_usage[i].time = 0;
+		dev->states_usage[i].mispredict = 0;
 	}
 	dev->last_residency = 0;
+	dev->wakeup_irq = CPUIDLE_WAKEUP_NONE;
 
 	smp_wmb();
 
@@ -27,6 +27,9 @@
 #define DECAY 8
 #define MAX_INTERESTING 50000
 #define STDDEV_THRESH 400
+#define WAKE_SOURCES 8
+#define WAKE_SOURCE_THRESH (RESOLUTION * DECAY / 4)
+#define WAKE_SOURCE_MAX_MISSED 4
 
 
 /*
@@ -78,6 +81,18 @@
  * intervals and if the stand deviation of these 8 intervals is below a
  * threshold value, we use the average of these intervals as prediction.
  *
+ * Wakeup source history
+ * ---------------------
+ * Periodic device interrupts (SMD, for example) are not known to the timer
+ * code, and their period is unrelated to when the CPU went idle, so neither
+ * predictor above catches them when the interval between idle entries is
+ * irregular. For every CPU we therefore remember the last 8 interrupts that
+ * woke it up, with a decaying weight and the average interval between two
+ * of their wakeups. If one interrupt dominates the recent wakeups and comes
+ * at regular intervals, its next expected arrival caps the prediction.
+ * Wakeups close to the expected timer event are considered timer wakeups
+ * and only age the history.
+ *
  * Limiting Performance Impact
  * ---------------------------
  * C states, especially those with large exit latencies, can have a real
@@ -109,6 +124,14 @@
  *
  */
 
+struct menu_wake_source {
+	int		irq;
+	unsigned int	weight;
+	u64		last_us;
+	u32		avg_interval_us;
+	u32		avg_dev_us;
+};
+
 struct menu_device {
 	int		last_state_idx;
 	int             needs_update;
@@ -120,6 +143,8 @@ struct menu_device {
 	u64		correction_factor[BUCKETS];
 	u32		intervals[INTERVALS];
 	int		interval_ptr;
+	u64		entry_us;
+	struct menu_wake_source sources[WAKE_SOURCES];
 };
 
 
@@ -215,6 +240,87 @@ static void detect_repeating_patterns(struct menu_device *data)
 		data->predicted_us = avg;
 }
 
+/*
+ * If the interrupt that woke us most often recently is also regular, assume
+ * it comes again after its average interval and cap the prediction there.
+ */
+static void predict_wakeup_source(struct menu_device *data)
+{
+	struct menu_wake_source *ws, *best = NULL;
+	u64 next;
+	int i;
+
+	for (i = 0; i < WAKE_SOURCES; i++) {
+		ws = &data->sources[i];
+		if (ws->weight < WAKE_SOURCE_THRESH || !ws->avg_interval_us)
+			continue;
+		if (!best || ws->weight > best->weight)
+			best = ws;
+	}
+
+	if (!best || best->avg_dev_us > best->avg_interval_us / 2)
+		return;
+
+	next = best->last_us + best->avg_interval_us;
+	if (next <= data->entry_us) {
+		/* it might have fired while we were busy, skip those periods */
+		u64 missed = div_u64(data->entry_us - best->last_us,
+				     best->avg_interval_us);
+
+		if (missed > WAKE_SOURCE_MAX_MISSED)
+			return;
+		next = best->last_us + (missed + 1) * best->avg_interval_us;
+	}
+
+	if (next - data->entry_us < data->predicted_us)
+		data->predicted_us = next - data->entry_us;
+}
+
+/*
+ * Account a wakeup by @irq at @wake_us in the per-CPU history. A negative
+ * @irq only ages the existing entries.
+ */
+static void update_wakeup_sources(struct menu_device *data, int irq,
+				  u64 wake_us)
+{
+	struct menu_wake_source *ws = NULL, *victim = &data->sources[0];
+	u32 interval, dev;
+	int i;
+
+	for (i = 0; i < WAKE_SOURCES; i++) {
+		struct menu_wake_source *s = &data->sources[i];
+
+		s->weight = s->weight * (DECAY - 1) / DECAY;
+		if (s->weight && s->irq == irq)
+			ws = s;
+		else if (s->weight < victim->weight)
+			victim = s;
+	}
+
+	if (irq < 0)
+		return;
+
+	if (!ws) {
+		ws = victim;
+		memset(ws, 0, sizeof(*ws));
+		ws->irq = irq;
+	} else if (wake_us > ws->last_us) {
+		interval = min_t(u64, wake_us - ws->last_us, UINT_MAX);
+		if (!ws->avg_interval_us) {
+			ws->avg_interval_us = interval;
+		} else {
+			dev = abs((s32)(interval - ws->avg_interval_us));
+			ws->avg_dev_us = (ws->avg_dev_us * (u64)(DECAY - 1) +
+					  dev) / DECAY;
+			ws->avg_interval_us = (ws->avg_interval_us *
+					       (u64)(DECAY - 1) + interval) / DECAY;
+		}
+	}
+
+	ws->weight += RESOLUTION;
+	ws->last_us = wake_us;
+}
+
 /**
  * menu_select - selects the next idle state to enter
  * @drv: cpuidle driver containing state data
@@ -236,6 +342,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 
 	data->last_state_idx = 0;
 	data->exit_us = 0;
+	data->entry_us = ktime_to_us(ktime_get());
 
 	/* Special case when user has set very strict latency requirement */
 	if (unlikely(latency_req == 0))
@@ -263,6 +370,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 					 RESOLUTION * DECAY);
 
 	detect_repeating_patterns(data);
+	predict_wakeup_source(data);
 
 	/*
 	 * We want to default to C1 (hlt), not to busy polling
@@ -327,6 +435,7 @@ static void menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	struct cpuidle_state *target = &drv->states[last_idx];
 	unsigned int measured_us;
 	u64 new_factor;
+	int irq = dev->wakeup_irq;
 
 	/*
 	 * Ugh, this idle state doesn't support residency measurements, so we
@@ -335,7 +444,15 @@ static void menu_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	 */
 	if (unlikely(!(target->flags & CPUIDLE_FLAG_TIME_VALID)))
 		last_idle_us = data->expected_us;
-
+	else if (last_idle_us < target->target_residency)
+		dev->states_usage[last_idx].mispredict++;
+
+	/* a wakeup within 1/8 of the next timer event is the timer itself */
+	if (irq >= 0 &&
+	    last_idle_us >= data->expected_us - (data->expected_us >> 3))
+		irq = CPUIDLE_WAKEUP_NONE;
+	update_wakeup_sources(data, irq, data->entry_us + last_idle_us);
+	dev->wakeup_irq = CPUIDLE_WAKEUP_NONE;
 
 	measured_us = last_idle_us;
 
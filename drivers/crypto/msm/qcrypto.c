@@ -108,6 +108,7 @@ struct crypto_stat {
 	u64 ablk_cipher_3des_dec;
 	u64 ablk_cipher_op_success;
 	u64 ablk_cipher_op_fail;
+	u64 ablk_cipher_cpu;
 	u64 sha1_digest;
 	u64 sha256_digest;
 	u64 sha_op_success;
@@ -119,6 +120,7 @@ struct crypto_stat {
 };
 static struct crypto_stat _qcrypto_stat;
 static struct dentry *_debug_dent;
+static struct dentry *_debug_crossover_dent;
 static char _debug_read_buf[DEBUG_MAX_RW_BUF];
 static bool _qcrypto_init_assign;
 struct crypto_priv;
@@ -138,6 +140,7 @@ struct crypto_engine {
 					 */
 	u64 total_req;
 	u64 err_req;
+	u32 assigned_tfms;	/* tfms statically bound to this engine */
 	u32 unit;
 	u32 ce_device;
 	unsigned int signature;
@@ -178,7 +181,6 @@ struct crypto_priv {
 	int32_t total_units;   /* total units of engines */
 	struct mutex engine_lock;
 
-	struct crypto_engine *next_engine; /* next assign engine */
 	struct crypto_queue req_queue;	/*
 					 * request queue for those requests
 					 * that waiting for an available
@@ -200,6 +202,8 @@ struct crypto_priv {
 static struct crypto_priv qcrypto_dev;
 static struct crypto_engine *_qcrypto_static_assign_engine(
 					struct crypto_priv *cp);
+static void _qcrypto_static_release_engine(struct crypto_priv *cp,
+					struct crypto_engine *pengine);
 
 /*-------------------------------------------------------------------------
 * Resource Locking Service
@@ -308,8 +312,19 @@ struct qcrypto_alg {
 	struct ahash_alg sha_alg;
 	enum qcrypto_alg_type alg_type;
 	struct crypto_priv *cp;
+	bool cpu_fallback;		/* may hand small requests to the CPU */
+	u32 cpu_crossover;		/* smallest request sent to the engine */
+	struct dentry *crossover_dent;
 };
 
+/*
+ * Default crossover, in bytes, below which AES requests run on the CPU.
+ * Tune it per algorithm through debugfs qcrypto/crossover/<driver>, e.g.
+ * from the tcrypt mode 504 figures measured at boot; 0 keeps everything
+ * on the engine.
+ */
+#define QCRYPTO_CPU_CROSSOVER	512
+
 #define QCRYPTO_MAX_KEY_SIZE	64
 /* max of AES_BLOCK_SIZE, DES3_EDE_BLOCK_SIZE */
 #define QCRYPTO_MAX_IV_LENGTH	16
@@ -332,6 +347,9 @@ struct qcrypto_cipher_ctx {
 	unsigned int auth_key_len;
 
 	u8 ccm4309_nonce[QCRYPTO_CCM4309_NONCE_LEN];
+
+	struct crypto_ablkcipher *cpu_tfm;	/* software fallback */
+	bool cpu_key;				/* cpu_tfm holds the key */
 };
 
 struct qcrypto_resp_ctx {
@@ -771,6 +789,8 @@ static void _qcrypto_ahash_cra_exit(struct crypto_tfm *tfm)
 
 	if (!list_empty(&sha_ctx->rsp_queue))
 		pr_err("_qcrypto_ahash_cra_exit: requests still outstanding");
+	_qcrypto_static_release_engine(sha_ctx->cp, sha_ctx->pengine);
+	sha_ctx->pengine = NULL;
 	if (sha_ctx->ahash_req != NULL) {
 		ahash_request_free(sha_ctx->ahash_req);
 		sha_ctx->ahash_req = NULL;
@@ -809,8 +829,38 @@ static int _qcrypto_ahash_hmac_cra_init(struct crypto_tfm *tfm)
 
 static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct qcrypto_alg *q_alg = container_of(tfm->__crt_alg,
+					struct qcrypto_alg, cipher_alg);
+	struct crypto_ablkcipher *cpu_tfm;
+	int ret;
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
-	return _qcrypto_cipher_cra_init(tfm);
+	ret = _qcrypto_cipher_cra_init(tfm);
+	if (ret)
+		return ret;
+
+	ctx->cpu_tfm = NULL;
+	ctx->cpu_key = false;
+	if (!q_alg->cpu_fallback)
+		return 0;
+
+	/* the engine algs need a fallback, so this picks a CPU one */
+	cpu_tfm = crypto_alloc_ablkcipher(tfm->__crt_alg->cra_name, 0,
+					CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(cpu_tfm)) {
+		pr_debug("qcrypto: no cpu fallback for %s\n",
+				tfm->__crt_alg->cra_name);
+		return 0;
+	}
+	ctx->cpu_tfm = cpu_tfm;
+
+	/* a request runs on either side, the sub request overlays rctx */
+	tfm->crt_ablkcipher.reqsize = max_t(unsigned int,
+			sizeof(struct qcrypto_cipher_req_ctx),
+			sizeof(struct ablkcipher_request) +
+				crypto_ablkcipher_reqsize(cpu_tfm));
+	return 0;
 };
 
 static int _qcrypto_cra_aead_init(struct crypto_tfm *tfm)
@@ -825,6 +875,12 @@ static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 
 	if (!list_empty(&ctx->rsp_queue))
 		pr_err("_qcrypto__cra_ablkcipher_exit: requests still outstanding");
+	_qcrypto_static_release_engine(ctx->cp, ctx->pengine);
+	ctx->pengine = NULL;
+	if (ctx->cpu_tfm) {
+		crypto_free_ablkcipher(ctx->cpu_tfm);
+		ctx->cpu_tfm = NULL;
+	}
 };
 
 static void _qcrypto_cra_aead_exit(struct crypto_tfm *tfm)
@@ -833,6 +889,8 @@ static void _qcrypto_cra_aead_exit(struct crypto_tfm *tfm)
 
 	if (!list_empty(&ctx->rsp_queue))
 		pr_err("_qcrypto__cra_aead_exit: requests still outstanding");
+	_qcrypto_static_release_engine(ctx->cp, ctx->pengine);
+	ctx->pengine = NULL;
 };
 
 static int _disp_stats(int id)
@@ -876,6 +934,9 @@ static int _disp_stats(int id)
 	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   ABLK CIPHER operation fail          : %llu\n",
 					pstat->ablk_cipher_op_fail);
+	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK AES CIPHER sent to the CPU     : %llu\n",
+					pstat->ablk_cipher_cpu);
 
 	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   AEAD SHA1-AES encryption            : %llu\n",
@@ -975,8 +1036,6 @@ static void _qcrypto_remove_engine(struct crypto_engine *pengine)
 
 	spin_lock_irqsave(&cp->lock, flags);
 	list_del(&pengine->elist);
-	if (cp->next_engine == pengine)
-		cp->next_engine = NULL;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
 	cp->total_units--;
@@ -993,8 +1052,10 @@ static void _qcrypto_remove_engine(struct crypto_engine *pengine)
 		return;
 
 	list_for_each_entry_safe(q_alg, n, &cp->alg_list, entry) {
-		if (q_alg->alg_type == QCRYPTO_ALG_CIPHER)
+		if (q_alg->alg_type == QCRYPTO_ALG_CIPHER) {
+			debugfs_remove(q_alg->crossover_dent);
 			crypto_unregister_alg(&q_alg->cipher_alg);
+		}
 		if (q_alg->alg_type == QCRYPTO_ALG_SHA)
 			crypto_unregister_ahash(&q_alg->sha_alg);
 		list_del(&q_alg->entry);
@@ -1040,6 +1101,16 @@ static int _qcrypto_check_aes_keylen(struct crypto_ablkcipher *cipher,
 	return 0;
 }
 
+static void _qcrypto_cpu_setkey(struct qcrypto_cipher_ctx *ctx, const u8 *key,
+		unsigned int len)
+{
+	if (ctx->cpu_tfm == NULL)
+		return;
+
+	crypto_ablkcipher_clear_flags(ctx->cpu_tfm, CRYPTO_TFM_REQ_MASK);
+	ctx->cpu_key = !crypto_ablkcipher_setkey(ctx->cpu_tfm, key, len);
+}
+
 static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 		unsigned int len)
 {
@@ -1057,6 +1128,7 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 		if (!(ctx->flags & QCRYPTO_CTX_USE_PIPE_KEY))  {
 			if (key != NULL) {
 				memcpy(ctx->enc_key, key, len);
+				_qcrypto_cpu_setkey(ctx, key, len);
 			} else {
 				pr_err("%s Inavlid key pointer\n", __func__);
 				return -EINVAL;
@@ -1082,6 +1154,7 @@ static int _qcrypto_setkey_aes_xts(struct crypto_ablkcipher *cipher,
 		if (!(ctx->flags & QCRYPTO_CTX_USE_PIPE_KEY))  {
 			if (key != NULL) {
 				memcpy(ctx->enc_key, key, len);
+				_qcrypto_cpu_setkey(ctx, key, len);
 			} else {
 				pr_err("%s Inavlid key pointer\n", __func__);
 				return -EINVAL;
@@ -1936,28 +2009,44 @@ static int _qcrypto_process_aead(struct  crypto_engine *pengine,
 	return ret;
 }
 
+/*
+ * Bind a new tfm to the engine with the fewest tfms bound to it, the one
+ * that has executed less work so far wins a tie.
+ */
 static struct crypto_engine *_qcrypto_static_assign_engine(
 					struct crypto_priv *cp)
 {
-	struct crypto_engine *pengine;
+	struct crypto_engine *pengine = NULL;
+	struct crypto_engine *pe;
 	unsigned long flags;
 
 	spin_lock_irqsave(&cp->lock, flags);
-	if (cp->next_engine)
-		pengine = cp->next_engine;
-	else
-		pengine = list_first_entry(&cp->engine_list,
-				struct crypto_engine, elist);
-
-	if (list_is_last(&pengine->elist, &cp->engine_list))
-		cp->next_engine = list_first_entry(
-			&cp->engine_list, struct crypto_engine, elist);
-	else
-		cp->next_engine = list_next_entry(pengine, elist);
+	list_for_each_entry(pe, &cp->engine_list, elist) {
+		if (!pengine || pe->assigned_tfms < pengine->assigned_tfms ||
+		    (pe->assigned_tfms == pengine->assigned_tfms &&
+		     pe->total_req < pengine->total_req))
+			pengine = pe;
+	}
+	if (pengine)
+		pengine->assigned_tfms++;
 	spin_unlock_irqrestore(&cp->lock, flags);
 	return pengine;
 }
 
+static void _qcrypto_static_release_engine(struct crypto_priv *cp,
+					struct crypto_engine *pengine)
+{
+	unsigned long flags;
+
+	if (pengine == NULL)
+		return;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	if (pengine->assigned_tfms)
+		pengine->assigned_tfms--;
+	spin_unlock_irqrestore(&cp->lock, flags);
+}
+
 static int _start_qcrypto_process(struct crypto_priv *cp,
 				struct crypto_engine *pengine)
 {
@@ -2094,15 +2183,29 @@ again:
 	return ret;
 }
 
+/*
+ * Pick the idle engine a request from the common queue gets done on
+ * soonest: one that already has bus bandwidth, then the one with the
+ * fewest requests of its own tfms waiting, as those go first.
+ */
 static struct crypto_engine *_avail_eng(struct crypto_priv *cp)
 {
-	struct crypto_engine *pe = NULL;
+	struct crypto_engine *pengine = NULL;
+	struct crypto_engine *pe;
+	bool bw, best_bw = false;
 
 	list_for_each_entry(pe, &cp->engine_list, elist) {
-		if (pe->req == NULL)
-			return pe;
+		if (pe->req != NULL)
+			continue;
+		bw = pe->bw_state == BUS_HAS_BANDWIDTH;
+		if (!pengine || (bw && !best_bw) ||
+		    (bw == best_bw &&
+		     pe->req_queue.qlen < pengine->req_queue.qlen)) {
+			pengine = pe;
+			best_bw = bw;
+		}
 	}
-	return NULL;
+	return pengine;
 }
 
 static int _qcrypto_queue_req(struct crypto_priv *cp,
@@ -2163,6 +2266,41 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 	return ret;
 }
 
+/*
+ * Requests shorter than the per algorithm crossover cost more in engine
+ * setup than the whole operation takes on the CPU, so they are handed to
+ * the best software implementation of the same algorithm instead.
+ */
+static bool _qcrypto_use_cpu(struct ablkcipher_request *req)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct qcrypto_alg *q_alg = container_of(req->base.tfm->__crt_alg,
+					struct qcrypto_alg, cipher_alg);
+
+	if (!ctx->cpu_key || !is_fips_qcrypto_tests_done)
+		return false;
+	if (ctx->flags & (QCRYPTO_CTX_USE_HW_KEY | QCRYPTO_CTX_USE_PIPE_KEY))
+		return false;
+	return req->nbytes < q_alg->cpu_crossover;
+}
+
+static int _qcrypto_cpu_crypt(struct ablkcipher_request *req,
+		enum qce_cipher_dir_enum dir)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct ablkcipher_request *subreq = ablkcipher_request_ctx(req);
+
+	_qcrypto_stat.ablk_cipher_cpu++;
+	ablkcipher_request_set_tfm(subreq, ctx->cpu_tfm);
+	ablkcipher_request_set_callback(subreq, req->base.flags,
+					req->base.complete, req->base.data);
+	ablkcipher_request_set_crypt(subreq, req->src, req->dst, req->nbytes,
+					req->info);
+	if (dir == QCE_ENCRYPT)
+		return crypto_ablkcipher_encrypt(subreq);
+	return crypto_ablkcipher_decrypt(subreq);
+}
+
 static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
@@ -2172,6 +2310,9 @@ static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_ENCRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 					CRYPTO_ALG_TYPE_ABLKCIPHER);
 #ifdef QCRYPTO_DEBUG
@@ -2196,6 +2337,9 @@ static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_ENCRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 					CRYPTO_ALG_TYPE_ABLKCIPHER);
 #ifdef QCRYPTO_DEBUG
@@ -2220,6 +2364,9 @@ static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_ENCRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 				CRYPTO_ALG_TYPE_ABLKCIPHER);
 #ifdef QCRYPTO_DEBUG
@@ -2244,6 +2391,9 @@ static int _qcrypto_enc_aes_xts(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_ENCRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 					CRYPTO_ALG_TYPE_ABLKCIPHER);
 	rctx = ablkcipher_request_ctx(req);
@@ -2398,6 +2548,9 @@ static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_DECRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 				CRYPTO_ALG_TYPE_ABLKCIPHER);
 #ifdef QCRYPTO_DEBUG
@@ -2422,6 +2575,9 @@ static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_DECRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 				CRYPTO_ALG_TYPE_ABLKCIPHER);
 #ifdef QCRYPTO_DEBUG
@@ -2447,6 +2603,9 @@ static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_DECRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 					CRYPTO_ALG_TYPE_ABLKCIPHER);
 #ifdef QCRYPTO_DEBUG
@@ -2557,6 +2716,9 @@ static int _qcrypto_dec_aes_xts(struct ablkcipher_request *req)
 
 	pstat = &_qcrypto_stat;
 
+	if (_qcrypto_use_cpu(req))
+		return _qcrypto_cpu_crypt(req, QCE_DECRYPT);
+
 	BUG_ON(crypto_tfm_alg_type(req->base.tfm) !=
 					CRYPTO_ALG_TYPE_ABLKCIPHER);
 	rctx = ablkcipher_request_ctx(req);
@@ -3761,6 +3923,28 @@ static int _qcrypto_prefix_alg_cra_name(char cra_name[], unsigned int size)
 	return 0;
 }
 
+/*
+ * Let an AES alg hand requests below its crossover to a CPU implementation.
+ * Flagging it as needing a fallback keeps the fallback lookup from
+ * resolving to the engine again.
+ */
+static void _qcrypto_cpu_fallback_init(struct qcrypto_alg *q_alg)
+{
+	q_alg->cipher_alg.cra_flags |= CRYPTO_ALG_NEED_FALLBACK;
+	q_alg->cpu_fallback = true;
+	q_alg->cpu_crossover = QCRYPTO_CPU_CROSSOVER;
+}
+
+static void _qcrypto_cpu_fallback_debugfs(struct qcrypto_alg *q_alg)
+{
+	if (!q_alg->cpu_fallback || _debug_crossover_dent == NULL)
+		return;
+
+	q_alg->crossover_dent = debugfs_create_u32(
+				q_alg->cipher_alg.cra_driver_name, 0644,
+				_debug_crossover_dent, &q_alg->cpu_crossover);
+}
+
 /*
  * Fill up fips_selftest_data structure
  */
@@ -4429,7 +4613,6 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 
 	spin_lock_irqsave(&cp->lock, flags);
 	list_add_tail(&pengine->elist, &cp->engine_list);
-	cp->next_engine = pengine;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
 	qce_hw_support(pengine->qce, &cp->ce_support);
@@ -4504,6 +4687,8 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 				kfree(q_alg);
 				goto err;
 			}
+		} else if (q_alg->cipher_alg.cra_blocksize == AES_BLOCK_SIZE) {
+			_qcrypto_cpu_fallback_init(q_alg);
 		}
 		rc = crypto_register_alg(&q_alg->cipher_alg);
 		if (rc) {
@@ -4512,6 +4697,7 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 			kzfree(q_alg);
 		} else {
 			list_add_tail(&q_alg->entry, &cp->alg_list);
+			_qcrypto_cpu_fallback_debugfs(q_alg);
 			dev_info(&pdev->dev, "%s\n",
 					q_alg->cipher_alg.cra_driver_name);
 		}
@@ -4538,6 +4724,8 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 				kfree(q_alg);
 				goto err;
 			}
+		} else {
+			_qcrypto_cpu_fallback_init(q_alg);
 		}
 		rc = crypto_register_alg(&q_alg->cipher_alg);
 		if (rc) {
@@ -4546,6 +4734,7 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 			kzfree(q_alg);
 		} else {
 			list_add_tail(&q_alg->entry, &cp->alg_list);
+			_qcrypto_cpu_fallback_debugfs(q_alg);
 			dev_info(&pdev->dev, "%s\n",
 					q_alg->cipher_alg.cra_driver_name);
 		}
@@ -4970,6 +5159,10 @@ static int _qcrypto_debug_init(void)
 		rc = PTR_ERR(dent);
 		goto err;
 	}
+
+	_debug_crossover_dent = debugfs_create_dir("crossover", _debug_dent);
+	if (IS_ERR(_debug_crossover_dent))
+		_debug_crossover_dent = NULL;
 	return 0;
 err:
 	debugfs_remove_recursive(_debug_dent);
@@ -5000,7 +5193,6 @@ static int __init _qcrypto_init(void)
 	pcp->total_units = 0;
 	pcp->ce_lock_count = 0;
 	pcp->platform_support.bus_scale_table = NULL;
-	pcp->next_engine = NULL;
 	crypto_init_queue(&pcp->req_queue, MSM_QCRYPTO_REQ_QUEUE_LENGTH);
 	return platform_driver_register(&_qualcomm_crypto);
 }
@@ -5008,8 +5200,9 @@ static int __init _qcrypto_init(void)
 static void __exit _qcrypto_exit(void)
 {
 	pr_debug("%s Unregister QCRYPTO\n", __func__);
-	debugfs_remove_recursive(_debug_dent);
+	/* the algs remove their crossover files as they are unregistered */
 	platform_driver_unregister(&_qualcomm_crypto);
+	debugfs_remove_recursive(_debug_dent);
 }
 
 module_init(_qcrypto_init);
@@ -24,12 +24,25 @@
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
 #include <linux/interrupt.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/devfreq.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/slab.h>
 #include "governor.h"
 #include "governor_bw_hwmon.h"
+#include "governor_cache_hwmon.h"
+
+#define MAX_HIST	20U
+
+struct cpu_bw_map {
+	unsigned int cpu_khz;
+	unsigned int mbps;
+};
 
 struct hwmon_node {
 	unsigned int tolerance_percent;
@@ -37,6 +50,15 @@ struct hwmon_node {
 	unsigned int decay_rate;
 	unsigned int io_percent;
 	unsigned int bw_step;
+	unsigned int hist_memory;
+	unsigned int hist_decay;
+	unsigned int up_scale;
+	unsigned int membound_mpkc;
+	struct cpu_bw_map *cpu_map;
+	unsigned long hist[MAX_HIST];
+	unsigned int hist_idx;
+	unsigned int hist_cnt;
+	bool irq_update;
 	unsigned long prev_ab;
 	unsigned long *dev_ab;
 	unsigned long resume_freq;
@@ -56,6 +78,13 @@ static DEFINE_MUTEX(list_lock);
 static int use_cnt;
 static DEFINE_MUTEX(state_lock);
 
+/* Bandwidth hints, shared by all the HW monitors */
+static struct {
+	unsigned long mbps;
+	unsigned long expires;
+} hints[BW_HWMON_HINT_MAX];
+static DEFINE_SPINLOCK(hint_lock);
+
 #define show_attr(name) \
 static ssize_t show_##name(struct device *dev,				\
 			struct device_attribute *attr, char *buf)	\
@@ -122,13 +151,107 @@ static unsigned long measure_bw_and_set_irq(struct hwmon_node *node)
 	return mbps;
 }
 
+/*
+ * Records @mbps and returns the highest of the last hist_memory samples,
+ * each one reduced by hist_decay percent per sample of age.  This keeps
+ * the vote near a recent peak for a while even when decay_rate lets the
+ * vote follow a dip right away.
+ */
+static unsigned long hist_floor(struct hwmon_node *node, unsigned long mbps)
+{
+	unsigned int age, idx, window;
+	unsigned long floor = 0;
+
+	if (!node->hist_memory) {
+		node->hist_cnt = 0;
+		return 0;
+	}
+
+	node->hist[node->hist_idx] = mbps;
+	node->hist_idx = (node->hist_idx + 1) % MAX_HIST;
+	if (node->hist_cnt < MAX_HIST)
+		node->hist_cnt++;
+
+	window = min(node->hist_memory, node->hist_cnt - 1);
+	for (age = 1; age <= window; age++) {
+		if (age * node->hist_decay >= 100)
+			break;
+		idx = (node->hist_idx + MAX_HIST - 1 - age) % MAX_HIST;
+		floor = max(floor, node->hist[idx] *
+				(100 - age * node->hist_decay) / 100);
+	}
+
+	return floor;
+}
+
+static unsigned long hint_floor(void)
+{
+	unsigned long flags, floor = 0;
+	int i;
+
+	spin_lock_irqsave(&hint_lock, flags);
+	for (i = 0; i < BW_HWMON_HINT_MAX; i++) {
+		if (!hints[i].mbps)
+			continue;
+		if (time_after_eq(jiffies, hints[i].expires))
+			hints[i].mbps = 0;
+		else
+			floor = max(floor, hints[i].mbps);
+	}
+	spin_unlock_irqrestore(&hint_lock, flags);
+
+	return floor;
+}
+
+/*
+ * A CPU running fast while missing L2 a lot spends its cycles waiting on
+ * DDR, and the bandwidth it manages to use stays low because of that, so
+ * the measurement alone never raises the vote.  When the L2 misses per
+ * thousand CPU cycles reach membound_mpkc, hold the vote at the floor the
+ * cpu_map gives for the fastest CPU.
+ */
+static unsigned long cpu_floor(struct hwmon_node *node)
+{
+	struct cpu_bw_map *map = node->cpu_map;
+	unsigned int cpu, cpu_khz = 0;
+	unsigned long mpkc;
+
+	if (!map)
+		return 0;
+
+	for_each_online_cpu(cpu)
+		cpu_khz = max(cpu_khz, cpufreq_quick_get(cpu));
+	if (!cpu_khz)
+		return 0;
+
+	/* M req/s over k cycles/s, times 1000 cycles */
+	mpkc = cache_hwmon_get_mrps(MED) * USEC_PER_SEC / cpu_khz;
+	if (mpkc < node->membound_mpkc)
+		return 0;
+
+	while (map->cpu_khz && map->cpu_khz < cpu_khz)
+		map++;
+	if (!map->cpu_khz)
+		map--;
+
+	return map->mbps;
+}
+
 static void compute_bw(struct hwmon_node *node, int mbps,
 			unsigned long *freq, unsigned long *ab)
 {
 	int new_bw;
+	unsigned long floor;
 
 	mbps += node->guard_band_mbps;
 
+	/*
+	 * A threshold IRQ means the usage is still ramping up and the sample
+	 * it cut short underestimates it, so get ahead of it.
+	 */
+	if (node->irq_update)
+		mbps = mbps * node->up_scale / 100;
+
 	if (mbps > node->prev_ab) {
 		new_bw = mbps;
 	} else {
@@ -137,6 +260,11 @@ static void compute_bw(struct hwmon_node *node, int mbps,
 		new_bw /= 100;
 	}
 
+	floor = max(hist_floor(node, mbps), hint_floor());
+	floor = max(floor, cpu_floor(node));
+	if (new_bw < floor)
+		new_bw = floor;
+
 	node->prev_ab = new_bw;
 	if (ab)
 		*ab = roundup(new_bw, node->bw_step);
@@ -162,24 +290,14 @@ static struct hwmon_node *find_hwmon_node(struct devfreq *df)
 }
 
 #define TOO_SOON_US	(1 * USEC_PER_MSEC)
-int update_bw_hwmon(struct bw_hwmon *hwmon)
+static int __update_bw_hwmon(struct hwmon_node *node, bool irq)
 {
-	struct devfreq *df;
-	struct hwmon_node *node;
+	struct devfreq *df = node->hw->df;
 	ktime_t ts;
 	unsigned int us;
 	int ret;
 
-	if (!hwmon)
-		return -EINVAL;
-	df = hwmon->df;
-	if (!df)
-		return -ENODEV;
-	node = find_hwmon_node(df);
-	if (!node)
-		return -ENODEV;
-
-	if (!node->mon_started)
+	if (!df || !node->mon_started)
 		return -EBUSY;
 
 	dev_dbg(df->dev.parent, "Got update request\n");
@@ -199,7 +317,9 @@ int update_bw_hwmon(struct bw_hwmon *hwmon)
 	us = ktime_to_us(ktime_sub(ts, node->prev_ts));
 	if (us > TOO_SOON_US) {
 		mutex_lock(&df->lock);
+		node->irq_update = irq;
 		ret = update_devfreq(df);
+		node->irq_update = false;
 		if (ret)
 			dev_err(df->dev.parent,
 				"Unable to update freq on request!\n");
@@ -211,6 +331,65 @@ int update_bw_hwmon(struct bw_hwmon *hwmon)
 	return 0;
 }
 
+/**
+ * update_bw_hwmon() - Re-evaluate the vote after a HW monitor IRQ
+ * @hwmon:	HW monitor whose threshold was crossed
+ */
+int update_bw_hwmon(struct bw_hwmon *hwmon)
+{
+	struct devfreq *df;
+	struct hwmon_node *node;
+
+	if (!hwmon)
+		return -EINVAL;
+	df = hwmon->df;
+	if (!df)
+		return -ENODEV;
+	node = find_hwmon_node(df);
+	if (!node)
+		return -ENODEV;
+
+	return __update_bw_hwmon(node, true);
+}
+
+/**
+ * bw_hwmon_hint() - Hint the bandwidth a client is about to use
+ * @client:	Client giving the hint
+ * @mbps:	Bandwidth the client expects to need, 0 to drop the hint
+ * @ms:		How long the hint holds
+ *
+ * Every HW monitor vote stays at or above the highest live hint, so a
+ * client that knows a burst is coming (a GPU frequency jump, a camera
+ * stream starting) doesn't wait for the monitor to see it.  Votes the
+ * hint raises are re-evaluated right away.  May sleep.
+ */
+int bw_hwmon_hint(enum bw_hwmon_hint_client client, unsigned long mbps,
+			unsigned int ms)
+{
+	struct hwmon_node *node;
+	unsigned long flags;
+
+	if (client >= BW_HWMON_HINT_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&hint_lock, flags);
+	hints[client].mbps = mbps;
+	hints[client].expires = jiffies + msecs_to_jiffies(ms);
+	spin_unlock_irqrestore(&hint_lock, flags);
+
+	if (!mbps)
+		return 0;
+
+	mutex_lock(&list_lock);
+	list_for_each_entry(node, &hwmon_list, list)
+		if (node->mon_started && node->prev_ab < mbps)
+			__update_bw_hwmon(node, false);
+	mutex_unlock(&list_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(bw_hwmon_hint);
+
 static int start_monitor(struct devfreq *df, bool init)
 {
 	struct hwmon_node *node = df->data;
@@ -225,6 +404,8 @@ static int start_monitor(struct devfreq *df, bool init)
 		node->prev_ab = 0;
 		node->resume_freq = 0;
 		node->resume_ab = 0;
+		node->hist_idx = 0;
+		node->hist_cnt = 0;
 		mbps = (df->previous_freq * node->io_percent) / 100;
 		ret = hw->start_hwmon(hw, mbps);
 	} else {
@@ -403,6 +584,32 @@ gov_attr(guard_band_mbps, 0U, 2000U);
 gov_attr(decay_rate, 0U, 100U);
 gov_attr(io_percent, 1U, 100U);
 gov_attr(bw_step, 50U, 1000U);
+gov_attr(hist_memory, 0U, MAX_HIST - 1);
+gov_attr(hist_decay, 1U, 100U);
+gov_attr(up_scale, 100U, 500U);
+gov_attr(membound_mpkc, 0U, 1000U);
+
+static ssize_t show_cpu_bw_map(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct devfreq *df = to_devfreq(dev);
+	struct hwmon_node *hw = df->data;
+	struct cpu_bw_map *map = hw->cpu_map;
+	unsigned int cnt = 0;
+
+	if (!map)
+		return snprintf(buf, PAGE_SIZE, "No CPU to BW map\n");
+
+	cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "CPU freq\tMBps\n");
+	while (map->cpu_khz && cnt < PAGE_SIZE) {
+		cnt += snprintf(buf + cnt, PAGE_SIZE - cnt, "%8u\t%4u\n",
+				map->cpu_khz, map->mbps);
+		map++;
+	}
+
+	return cnt;
+}
+static DEVICE_ATTR(cpu_bw_map, 0444, show_cpu_bw_map, NULL);
 
 static struct attribute *dev_attr[] = {
 	&dev_attr_tolerance_percent.attr,
@@ -410,6 +617,11 @@ static struct attribute *dev_attr[] = {
 	&dev_attr_decay_rate.attr,
 	&dev_attr_io_percent.attr,
 	&dev_attr_bw_step.attr,
+	&dev_attr_hist_memory.attr,
+	&dev_attr_hist_decay.attr,
+	&dev_attr_up_scale.attr,
+	&dev_attr_membound_mpkc.attr,
+	&dev_attr_cpu_bw_map.attr,
 	NULL,
 };
 
@@ -486,6 +698,40 @@ static struct devfreq_governor devfreq_gov_bw_hwmon = {
 	.event_handler = devfreq_bw_hwmon_ev_handler,
 };
 
+#define PROP_CPU_MAP "qcom,cpu-bw-map"
+static struct cpu_bw_map *read_cpu_map(struct device *dev)
+{
+	struct cpu_bw_map *map;
+	int len, nf, i;
+	u32 data;
+
+	if (!dev->of_node ||
+	    !of_find_property(dev->of_node, PROP_CPU_MAP, &len))
+		return NULL;
+	len /= sizeof(data);
+	if (len % 2 || len == 0) {
+		dev_err(dev, "Bad %s, ignoring it\n", PROP_CPU_MAP);
+		return NULL;
+	}
+	nf = len / 2;
+
+	map = devm_kzalloc(dev, (nf + 1) * sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return NULL;
+
+	for (i = 0; i < nf; i++) {
+		of_property_read_u32_index(dev->of_node, PROP_CPU_MAP,
+					   i * 2, &data);
+		map[i].cpu_khz = data;
+		of_property_read_u32_index(dev->of_node, PROP_CPU_MAP,
+					   i * 2 + 1, &data);
+		map[i].mbps = data;
+	}
+	map[i].cpu_khz = 0;
+
+	return map;
+}
+
 int register_bw_hwmon(struct device *dev, struct bw_hwmon *hwmon)
 {
 	int ret = 0;
@@ -523,6 +769,11 @@ int register_bw_hwmon(struct device *dev, struct bw_hwmon *hwmon)
 	node->decay_rate = 90;
 	node->io_percent = 16;
 	node->bw_step = 190;
+	node->hist_memory = 0;
+	node->hist_decay = 20;
+	node->up_scale = 100;
+	node->membound_mpkc = 10;
+	node->cpu_map = read_cpu_map(dev);
 	node->hw = hwmon;
 
 	mutex_lock(&list_lock);
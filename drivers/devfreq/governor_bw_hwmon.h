@@ -58,16 +58,31 @@ struct bw_hwmon {
 	struct devfreq *df;
 };
 
+/* Clients that can hint their upcoming bandwidth, see bw_hwmon_hint() */
+enum bw_hwmon_hint_client {
+	BW_HWMON_HINT_GPU,
+	BW_HWMON_HINT_CAMERA,
+	BW_HWMON_HINT_VIDEO,
+	BW_HWMON_HINT_MAX,
+};
+
 #ifdef CONFIG_DEVFREQ_GOV_MSM_BW_HWMON
 int register_bw_hwmon(struct device *dev, struct bw_hwmon *hwmon);
 int update_bw_hwmon(struct bw_hwmon *hwmon);
+int bw_hwmon_hint(enum bw_hwmon_hint_client client, unsigned long mbps,
+			unsigned int ms);
 #else
 static inline int register_bw_hwmon(struct device *dev,
 					struct bw_hwmon *hwmon)
 {
 	return 0;
 }
-int update_bw_hwmon(struct bw_hwmon *hwmon)
+static inline int update_bw_hwmon(struct bw_hwmon *hwmon)
+{
+	return 0;
+}
+static inline int bw_hwmon_hint(enum bw_hwmon_hint_client client,
+				unsigned long mbps, unsigned int ms)
 {
 	return 0;
 }
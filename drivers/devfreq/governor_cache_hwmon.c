@@ -55,6 +55,9 @@ static DEFINE_MUTEX(list_lock);
 static int use_cnt;
 static DEFINE_MUTEX(state_lock);
 
+/* Latest measurement, for governors of other devices to look at */
+static unsigned long last_mrps[MAX_NUM_GROUPS];
+
 #define show_attr(name) \
 static ssize_t show_##name(struct device *dev,				\
 			struct device_attribute *attr, char *buf)	\
@@ -228,11 +231,28 @@ static int devfreq_cache_hwmon_get_freq(struct devfreq *df,
 
 	memset(&stat, 0, sizeof(stat));
 	measure_mrps_and_set_irq(node, &stat);
+	memcpy(last_mrps, stat.mrps, sizeof(last_mrps));
 	compute_cache_freq(node, &stat, freq);
 
 	return 0;
 }
 
+/**
+ * cache_hwmon_get_mrps() - Latest request rate seen by the cache monitor
+ * @grp:	Request group, e.g. MED for the L2 misses on Krait
+ *
+ * Returns the million requests per second of the last sample, or 0 when
+ * no cache monitor is running.
+ */
+unsigned long cache_hwmon_get_mrps(enum request_group grp)
+{
+	if (grp >= MAX_NUM_GROUPS)
+		return 0;
+
+	return ACCESS_ONCE(last_mrps[grp]);
+}
+EXPORT_SYMBOL(cache_hwmon_get_mrps);
+
 gov_attr(cycles_per_low_req, 1U, 100U);
 gov_attr(cycles_per_med_req, 1U, 100U);
 gov_attr(cycles_per_high_req, 1U, 100U);
@@ -320,6 +340,7 @@ static void stop_monitoring(struct devfreq *df)
 	node->mon_started = false;
 	devfreq_monitor_stop(df);
 	hw->stop_hwmon(hw);
+	memset(last_mrps, 0, sizeof(last_mrps));
 	df->data = node->orig_data;
 	node->orig_data = NULL;
 	hw->df = NULL;
@@ -56,13 +56,18 @@ struct cache_hwmon {
 #ifdef CONFIG_DEVFREQ_GOV_MSM_CACHE_HWMON
 int register_cache_hwmon(struct device *dev, struct cache_hwmon *hwmon);
 int update_cache_hwmon(struct cache_hwmon *hwmon);
+unsigned long cache_hwmon_get_mrps(enum request_group grp);
 #else
 static inline int register_cache_hwmon(struct device *dev,
 				       struct cache_hwmon *hwmon)
 {
 	return 0;
 }
-int update_cache_hwmon(struct cache_hwmon *hwmon)
+static inline int update_cache_hwmon(struct cache_hwmon *hwmon)
+{
+	return 0;
+}
+static inline unsigned long cache_hwmon_get_mrps(enum request_group grp)
 {
 	return 0;
 }
@@ -51,6 +51,13 @@ static DEFINE_SPINLOCK(tz_lock);
  * frame length, but less than the idle timer.
  */
 #define CEILING			50000
+
+/*
+ * Percentage of the busy time that has to come from work with a frame
+ * deadline for the deadline alone to pick the frequency.
+ */
+#define DEADLINE_BUSY		90
+
 #define TZ_RESET_ID		0x3
 #define TZ_UPDATE_ID		0x4
 #define TZ_INIT_ID		0x6
@@ -92,6 +99,34 @@ static void _update_cutoff(struct devfreq_msm_adreno_tz_data *priv,
 	}
 }
 
+/*
+ * Adjust the level picked from the busy statistics with the frame deadlines
+ * reported by the driver. The lowest frequency that would have met the most
+ * demanding deadline of the window is a floor. If nearly all of the GPU time
+ * was spent on work that has a deadline, that frequency is used as is since
+ * it already accounts for all the work there is.
+ */
+static int _deadline_level(struct devfreq *devfreq,
+		struct devfreq_msm_adreno_tz_data *priv, int level)
+{
+	int i, dl_level = 0;
+
+	if (!priv->frame.freq)
+		return level;
+
+	for (i = devfreq->profile->max_state - 1; i >= 0; i--) {
+		if (devfreq->profile->freq_table[i] >= priv->frame.freq) {
+			dl_level = i;
+			break;
+		}
+	}
+
+	if (priv->frame.busy_time * 100 >= priv->bin.busy_time * DEADLINE_BUSY)
+		return dl_level;
+
+	return min(level, dl_level);
+}
+
 static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 				u32 *flag)
 {
@@ -99,16 +134,14 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
 	struct devfreq_dev_status stats;
 	struct xstats b;
-	int val, level = 0;
+	int val, level = 0, cur_level;
 	int act_level;
 	int norm_cycles;
 	int gpu_percent;
 	static int busy_bin, frame_flag;
 
-	if (priv->bus.num)
-		stats.private_data = &b;
-	else
-		stats.private_data = NULL;
+	memset(&b, 0, sizeof(b));
+	stats.private_data = &b;
 
 	result = devfreq->profile->get_dev_status(devfreq->dev.parent, &stats);
 	if (result) {
@@ -120,6 +153,8 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 	*flag = 0;
 	priv->bin.total_time += stats.total_time;
 	priv->bin.busy_time += stats.busy_time;
+	priv->frame.freq = max(priv->frame.freq, b.frame_freq);
+	priv->frame.busy_time += b.frame_busy;
 	if (priv->bus.num) {
 		priv->bus.total_time += stats.total_time;
 		priv->bus.gpu_time += stats.busy_time;
@@ -170,19 +205,26 @@ static int tz_get_target_freq(struct devfreq *devfreq, unsigned long *freq,
 				priv->bin.total_time,
 				priv->bin.busy_time);
 	}
-	priv->bin.total_time = 0;
-	priv->bin.busy_time = 0;
 
 	/*
 	 * If the decision is to move to a different level, make sure the GPU
 	 * frequency changes.
 	 */
+	cur_level = level;
 	if (val) {
 		level += val;
 		level = max(level, 0);
 		level = min_t(int, level, devfreq->profile->max_state - 1);
-		goto clear;
 	}
+	level = _deadline_level(devfreq, priv, level);
+
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+	priv->frame.freq = 0;
+	priv->frame.busy_time = 0;
+
+	if (level != cur_level)
+		goto clear;
 
 	if (priv->bus.total_time < LONG_FLOOR)
 		goto end;
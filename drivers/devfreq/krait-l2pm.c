@@ -69,6 +69,18 @@ static void global_mon_enable(bool en)
 	spin_unlock(&mon_lock);
 }
 
+/* The other L2PMRESR groups may be in use by perf */
+static void mon_set_resr(int n, u32 mask, u32 val)
+{
+	u32 regval;
+
+	spin_lock(&mon_lock);
+	regval = get_l2_indirect_reg(L2PMRESR(n));
+	regval = (regval & ~mask) | val;
+	set_l2_indirect_reg(L2PMRESR(n), regval);
+	spin_unlock(&mon_lock);
+}
+
 static void mon_enable(int n)
 {
 	/* Clear previous overflow state for event counter n */
@@ -140,7 +152,7 @@ static int bw_irq;
 static void mon_bw_init(void)
 {
 	/* Set up counters 0/1 to count write/read beats */
-	set_l2_indirect_reg(L2PMRESR(2), 0x8B0B0000);
+	mon_set_resr(2, 0xFFFF0000, 0x8B0B0000);
 	set_l2_indirect_reg(L2PMnEVCNTCR(RD_MON), 0x0);
 	set_l2_indirect_reg(L2PMnEVCNTCR(WR_MON), 0x0);
 	set_l2_indirect_reg(L2PMnEVCNTR(RD_MON), 0xFFFFFFFF);
@@ -272,7 +284,7 @@ static int cache_irq;
 static void mon_mrps_init(void)
 {
 	/* Cache bank requests */
-	set_l2_indirect_reg(L2PMRESR(0), 0x86000001);
+	mon_set_resr(0, 0xFF0000FF, 0x86000001);
 	set_l2_indirect_reg(L2PMnEVCNTCR(L2_H_REQ_MON), 0x0);
 	set_l2_indirect_reg(L2PMnEVCNTR(L2_H_REQ_MON), 0x0);
 	set_l2_indirect_reg(L2PMnEVFILTER(L2_H_REQ_MON), 0xF003F);
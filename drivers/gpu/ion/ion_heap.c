@@ -20,6 +20,8 @@
 #include <linux/ion.h>
 #include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/rtmutex.h>
 #include <linux/sched.h>
 #include <linux/scatterlist.h>
@@ -29,6 +31,28 @@
 #include <linux/dma-mapping.h>
 #include "ion_priv.h"
 
+/*
+ * Maximum number of buffers a deferred free thread takes off the free
+ * list at once.
+ */
+static int deferred_free_batch = 32;
+module_param(deferred_free_batch, int, S_IRUGO | S_IWUSR);
+
+/* Number of deferred free threads started for each heap. */
+static int deferred_free_threads = 1;
+module_param(deferred_free_threads, int, S_IRUGO);
+
+/*
+ * Priority of the deferred free threads: either "idle" for SCHED_IDLE,
+ * or a nice value for SCHED_NORMAL.  Writing it updates the running
+ * threads of every heap.
+ */
+#define ION_DEFERRED_FREE_IDLE	INT_MIN
+static int deferred_free_nice = ION_DEFERRED_FREE_IDLE;
+
+static LIST_HEAD(ion_deferred_heaps);
+static DEFINE_MUTEX(ion_deferred_lock);
+
 void *ion_heap_map_kernel(struct ion_heap *heap,
 			  struct ion_buffer *buffer)
 {
@@ -171,15 +195,25 @@ size_t ion_heap_freelist_size(struct ion_heap *heap)
 	return size;
 }
 
+static void ion_heap_destroy_list(struct list_head *buffers)
+{
+	struct ion_buffer *buffer, *tmp;
+
+	list_for_each_entry_safe(buffer, tmp, buffers, list)
+		ion_buffer_destroy(buffer);
+}
+
 static size_t _ion_heap_freelist_drain(struct ion_heap *heap, size_t size,
 				bool skip_pools)
 {
 	struct ion_buffer *buffer;
 	size_t total_drained = 0;
+	LIST_HEAD(buffers);
 
 	if (ion_heap_freelist_size(heap) == 0)
 		return 0;
 
+	/* take everything needed in one go, then free without the lock */
 	spin_lock(&heap->free_lock);
 	if (size == 0)
 		size = heap->free_list_size;
@@ -189,17 +223,16 @@ static size_t _ion_heap_freelist_drain(struct ion_heap *heap, size_t size,
 			break;
 		buffer = list_first_entry(&heap->free_list, struct ion_buffer,
 					  list);
-		list_del(&buffer->list);
+		list_move_tail(&buffer->list, &buffers);
 		heap->free_list_size -= buffer->size;
 		if (skip_pools)
 			buffer->private_flags |= ION_PRIV_FLAG_SHRINKER_FREE;
 		total_drained += buffer->size;
-		spin_unlock(&heap->free_lock);
-		ion_buffer_destroy(buffer);
-		spin_lock(&heap->free_lock);
 	}
 	spin_unlock(&heap->free_lock);
 
+	ion_heap_destroy_list(&buffers);
+
 	return total_drained;
 }
 
@@ -219,40 +252,120 @@ static int ion_heap_deferred_free(void *data)
 
 	while (true) {
 		struct ion_buffer *buffer;
+		LIST_HEAD(buffers);
+		int batch = max(1, ACCESS_ONCE(deferred_free_batch));
+		int nr;
 
 		wait_event_freezable(heap->waitqueue,
 				     ion_heap_freelist_size(heap) > 0);
 
+		/*
+		 * Other threads of this heap may have emptied the list
+		 * since we woke up, in which case we just go back to sleep.
+		 */
 		spin_lock(&heap->free_lock);
-		if (list_empty(&heap->free_list)) {
-			spin_unlock(&heap->free_lock);
-			continue;
+		for (nr = 0; nr < batch && !list_empty(&heap->free_list); nr++) {
+			buffer = list_first_entry(&heap->free_list,
+						  struct ion_buffer, list);
+			list_move_tail(&buffer->list, &buffers);
+			heap->free_list_size -= buffer->size;
 		}
-		buffer = list_first_entry(&heap->free_list, struct ion_buffer,
-					  list);
-		list_del(&buffer->list);
-		heap->free_list_size -= buffer->size;
 		spin_unlock(&heap->free_lock);
-		ion_buffer_destroy(buffer);
+
+		ion_heap_destroy_list(&buffers);
 	}
 
 	return 0;
 }
 
-int ion_heap_init_deferred_free(struct ion_heap *heap)
+static void ion_heap_set_task_prio(struct task_struct *task, int nice)
 {
 	struct sched_param param = { .sched_priority = 0 };
 
+	if (nice == ION_DEFERRED_FREE_IDLE) {
+		sched_setscheduler_nocheck(task, SCHED_IDLE, &param);
+	} else {
+		sched_setscheduler_nocheck(task, SCHED_NORMAL, &param);
+		set_user_nice(task, nice);
+	}
+}
+
+static int deferred_free_nice_set(const char *val,
+				  const struct kernel_param *kp)
+{
+	struct ion_heap *heap;
+	int nice, i, ret;
+
+	if (sysfs_streq(val, "idle")) {
+		nice = ION_DEFERRED_FREE_IDLE;
+	} else {
+		ret = kstrtoint(val, 0, &nice);
+		if (ret)
+			return ret;
+		if (nice < -20 || nice > 19)
+			return -EINVAL;
+	}
+
+	mutex_lock(&ion_deferred_lock);
+	deferred_free_nice = nice;
+	list_for_each_entry(heap, &ion_deferred_heaps, deferred_node)
+		for (i = 0; i < heap->nr_tasks; i++)
+			ion_heap_set_task_prio(heap->task[i], nice);
+	mutex_unlock(&ion_deferred_lock);
+
+	return 0;
+}
+
+static int deferred_free_nice_get(char *buffer, const struct kernel_param *kp)
+{
+	if (deferred_free_nice == ION_DEFERRED_FREE_IDLE)
+		return sprintf(buffer, "idle");
+	return sprintf(buffer, "%d", deferred_free_nice);
+}
+
+static struct kernel_param_ops deferred_free_nice_ops = {
+	.set = deferred_free_nice_set,
+	.get = deferred_free_nice_get,
+};
+module_param_cb(deferred_free_priority, &deferred_free_nice_ops, NULL,
+		S_IRUGO | S_IWUSR);
+
+int ion_heap_init_deferred_free(struct ion_heap *heap)
+{
+	int nr_threads = clamp(deferred_free_threads, 1,
+			       ION_HEAP_MAX_FREE_THREADS);
+	struct task_struct *task;
+	int i;
+
 	INIT_LIST_HEAD(&heap->free_list);
 	init_waitqueue_head(&heap->waitqueue);
-	heap->task = kthread_run(ion_heap_deferred_free, heap,
-				 "%s", heap->name);
-	sched_setscheduler(heap->task, SCHED_IDLE, &param);
-	if (IS_ERR(heap->task)) {
+	heap->nr_tasks = 0;
+
+	mutex_lock(&ion_deferred_lock);
+	for (i = 0; i < nr_threads; i++) {
+		if (i == 0)
+			task = kthread_run(ion_heap_deferred_free, heap,
+					   "%s", heap->name);
+		else
+			task = kthread_run(ion_heap_deferred_free, heap,
+					   "%s/%d", heap->name, i);
+		if (IS_ERR(task))
+			break;
+		ion_heap_set_task_prio(task, deferred_free_nice);
+		heap->task[heap->nr_tasks++] = task;
+	}
+	if (heap->nr_tasks)
+		list_add_tail(&heap->deferred_node, &ion_deferred_heaps);
+	mutex_unlock(&ion_deferred_lock);
+
+	if (!heap->nr_tasks) {
 		pr_err("%s: creating thread for deferred free failed\n",
 		       __func__);
-		return PTR_RET(heap->task);
+		return PTR_RET(task);
 	}
+	if (heap->nr_tasks < nr_threads)
+		pr_warn("%s: only %d of %d deferred free threads for %s\n",
+			__func__, heap->nr_tasks, nr_threads, heap->name);
 	return 0;
 }
 
@@ -20,6 +20,7 @@
 #include <linux/fs.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/vmalloc.h>
@@ -50,9 +51,8 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void __ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	mutex_lock(&pool->mutex);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -60,8 +60,17 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
+}
+
+static void ion_page_pool_add_batch(struct ion_page_pool *pool,
+				    struct page **pages, int nr)
+{
+	int i;
+
+	mutex_lock(&pool->mutex);
+	for (i = 0; i < nr; i++)
+		__ion_page_pool_add(pool, pages[i]);
 	mutex_unlock(&pool->mutex);
-	return 0;
 }
 
 static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
@@ -82,21 +91,81 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+static struct page *ion_page_pool_pcp_get(struct ion_page_pool *pool)
+{
+	struct ion_page_pool_pcp *pcp;
+	struct page *page = NULL;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count) {
+		page = pcp->pages[--pcp->count];
+		pcp->hits++;
+	} else {
+		pcp->misses++;
+	}
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	return page;
+}
+
+/*
+ * Stash up to nr pages in this cpu's cache, returns how many were taken
+ * from the end of the pages array.
+ */
+static int ion_page_pool_pcp_put(struct ion_page_pool *pool,
+				 struct page **pages, int nr)
+{
+	struct ion_page_pool_pcp *pcp;
+	int taken = 0;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	while (taken < nr && pcp->count < pool->pcp_high)
+		pcp->pages[pcp->count++] = pages[nr - ++taken];
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	return taken;
+}
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 {
+	struct page *pages[ION_PAGE_POOL_PCP_MAX];
 	struct page *page = NULL;
+	int nr = 0;
 
 	BUG_ON(!pool);
 
 	*from_pool = true;
 
+	page = ion_page_pool_pcp_get(pool);
+	if (page)
+		return page;
+
+	/* refill this cpu's cache with a batch while holding the lock */
 	if (mutex_trylock(&pool->mutex)) {
-		if (pool->high_count)
-			page = ion_page_pool_remove(pool, true);
-		else if (pool->low_count)
-			page = ion_page_pool_remove(pool, false);
+		while (nr < pool->pcp_batch) {
+			if (pool->high_count)
+				pages[nr++] = ion_page_pool_remove(pool, true);
+			else if (pool->low_count)
+				pages[nr++] = ion_page_pool_remove(pool, false);
+			else
+				break;
+		}
 		mutex_unlock(&pool->mutex);
 	}
+
+	if (nr) {
+		page = pages[0];
+		nr--;
+		nr -= ion_page_pool_pcp_put(pool, pages + 1, nr);
+		/* raced with frees filling the cache: rare, give them back */
+		if (nr)
+			ion_page_pool_add_batch(pool, pages + 1, nr);
+	}
+
 	if (!page) {
 		page = ion_page_pool_alloc_pages(pool);
 		*from_pool = false;
@@ -106,19 +175,83 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool, bool *from_pool)
 
 void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
-	int ret;
+	struct ion_page_pool_pcp *pcp;
+	struct page *pages[ION_PAGE_POOL_PCP_MAX + 1];
+	int nr = 0;
 
-	ret = ion_page_pool_add(pool, page);
-	if (ret)
-		ion_page_pool_free_pages(pool, page);
+	pcp = get_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->count < pool->pcp_high) {
+		pcp->pages[pcp->count++] = page;
+	} else {
+		/* full: send a batch to the lists along with this page */
+		while (nr < pool->pcp_batch)
+			pages[nr++] = pcp->pages[--pcp->count];
+		pages[nr++] = page;
+	}
+	spin_unlock(&pcp->lock);
+	put_cpu_ptr(pool->pcp);
+
+	if (nr)
+		ion_page_pool_add_batch(pool, pages, nr);
+}
+
+/* move every per-cpu cached page back to the lists */
+static void ion_page_pool_drain_pcp(struct ion_page_pool *pool)
+{
+	struct page *pages[ION_PAGE_POOL_PCP_MAX];
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+		int nr = 0;
+
+		spin_lock(&pcp->lock);
+		while (pcp->count)
+			pages[nr++] = pcp->pages[--pcp->count];
+		spin_unlock(&pcp->lock);
+
+		if (nr)
+			ion_page_pool_add_batch(pool, pages, nr);
+	}
+}
+
+void ion_page_pool_pcp_stats(struct ion_page_pool *pool, int *count,
+			     unsigned long *hits, unsigned long *misses)
+{
+	int cpu;
+
+	*count = 0;
+	*hits = 0;
+	*misses = 0;
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		*count += pcp->count;
+		*hits += pcp->hits;
+		*misses += pcp->misses;
+		spin_unlock(&pcp->lock);
+	}
+}
+
+int ion_page_pool_count(struct ion_page_pool *pool)
+{
+	int cpu, count = pool->high_count + pool->low_count;
+
+	/* racy snapshot, good enough for watermarks */
+	for_each_possible_cpu(cpu)
+		count += per_cpu_ptr(pool->pcp, cpu)->count;
+
+	return count;
 }
 
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
 	int total = 0;
 
-	total += high ? (pool->high_count + pool->low_count) *
-		(1 << pool->order) :
+	/* the per-cpu caches mix highmem and lowmem, count them as high */
+	total += high ? ion_page_pool_count(pool) * (1 << pool->order) :
 			pool->low_count * (1 << pool->order);
 	return total;
 }
@@ -134,6 +267,9 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	else
 		high = !!(gfp_mask & __GFP_HIGHMEM);
 
+	if (nr_to_scan)
+		ion_page_pool_drain_pcp(pool);
+
 	for (i = 0; i < nr_to_scan; i++) {
 		struct page *page;
 
@@ -157,8 +293,27 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 {
 	struct ion_page_pool *pool = kmalloc(sizeof(struct ion_page_pool),
 					     GFP_KERNEL);
+	int cpu;
+
 	if (!pool)
 		return NULL;
+	pool->pcp = alloc_percpu(struct ion_page_pool_pcp);
+	if (!pool->pcp) {
+		kfree(pool);
+		return NULL;
+	}
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock_init(&pcp->lock);
+		pcp->count = 0;
+		pcp->hits = 0;
+		pcp->misses = 0;
+	}
+	/* keep at most 256KB per cpu for high orders */
+	pool->pcp_high = min_t(int, ION_PAGE_POOL_PCP_MAX,
+			       max(1, 64 >> order));
+	pool->pcp_batch = max(1, pool->pcp_high / 2);
 	pool->high_count = 0;
 	pool->low_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
@@ -173,6 +328,7 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 
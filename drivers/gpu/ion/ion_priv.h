@@ -142,6 +142,8 @@ struct ion_heap_ops {
  */
 #define ION_HEAP_FLAG_DEFER_FREE (1 << 0)
 
+#define ION_HEAP_MAX_FREE_THREADS 4
+
 /**
  * private flags - flags internal to ion
  */
@@ -170,8 +172,10 @@ struct ion_heap_ops {
  * @free_list:		free list head if deferred free is used
  * @free_list_size	size of the deferred free list in bytes
  * @lock:		protects the free list
- * @waitqueue:		queue to wait on from deferred free thread
- * @task:		task struct of deferred free thread
+ * @waitqueue:		queue to wait on from deferred free threads
+ * @task:		task structs of deferred free threads
+ * @nr_tasks:		number of deferred free threads running
+ * @deferred_node:	node in the list of heaps using deferred free
  * @debug_show:		called when heap debug file is read to add any
  *			heap specific debug info to output
  *
@@ -194,7 +198,9 @@ struct ion_heap {
 	size_t free_list_size;
 	spinlock_t free_lock;
 	wait_queue_head_t waitqueue;
-	struct task_struct *task;
+	struct task_struct *task[ION_HEAP_MAX_FREE_THREADS];
+	int nr_tasks;
+	struct list_head deferred_node;
 	int (*debug_show)(struct ion_heap *heap, struct seq_file *, void *);
 };
 
@@ -277,7 +283,8 @@ void ion_heap_init_shrinker(struct ion_heap *heap);
  *
  * If a heap sets the ION_HEAP_FLAG_DEFER_FREE flag this function will
  * be called to setup deferred frees. Calls to free the buffer will
- * return immediately and the actual free will occur some time later
+ * return immediately and the actual free will occur some time later,
+ * in batches, from the heap's deferred free threads
  */
 int ion_heap_init_deferred_free(struct ion_heap *heap);
 
@@ -386,6 +393,10 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @pcp:		per-cpu caches in front of the lists
+ * @pcp_high:		max number of pages in each per-cpu cache
+ * @pcp_batch:		number of pages moved between a per-cpu cache and
+ *			the lists at once
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
@@ -401,6 +412,28 @@ struct ion_page_pool {
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	struct ion_page_pool_pcp __percpu *pcp;
+	int pcp_high;
+	int pcp_batch;
+};
+
+#define ION_PAGE_POOL_PCP_MAX	16
+
+/**
+ * struct ion_page_pool_pcp - per-cpu cache of pool pages
+ * @lock:		protects this struct, only contended while the
+ *			shrinker drains it
+ * @count:		number of pages in @pages
+ * @hits:		allocations served from @pages
+ * @misses:		allocations that had to go to the pool lists
+ * @pages:		cached pages, highmem and lowmem mixed
+ */
+struct ion_page_pool_pcp {
+	spinlock_t lock;
+	int count;
+	unsigned long hits;
+	unsigned long misses;
+	struct page *pages[ION_PAGE_POOL_PCP_MAX];
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
@@ -408,6 +441,22 @@ void ion_page_pool_destroy(struct ion_page_pool *);
 void *ion_page_pool_alloc(struct ion_page_pool *, bool *from_pool);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 
+/**
+ * ion_page_pool_count - number of items in the pool, including the
+ *			 per-cpu caches
+ */
+int ion_page_pool_count(struct ion_page_pool *pool);
+
+/**
+ * ion_page_pool_pcp_stats - sums up the per-cpu cache statistics
+ * @pool:		the pool
+ * @count:		returns the number of items in the per-cpu caches
+ * @hits:		returns the number of allocations they served
+ * @misses:		returns the number of allocations they missed
+ */
+void ion_page_pool_pcp_stats(struct ion_page_pool *pool, int *count,
+			     unsigned long *hits, unsigned long *misses);
+
 /** ion_page_pool_shrink - shrinks the size of the memory cached in the pool
  * @pool:		the pool
  * @gfp_mask:		the memory type to reclaim
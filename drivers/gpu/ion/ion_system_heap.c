@@ -18,9 +18,13 @@
 #include <asm/page.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -33,8 +37,31 @@ static gfp_t high_order_gfp_flags = (GFP_HIGHUSER | __GFP_NOWARN |
 				     __GFP_NO_KSWAPD | __GFP_NORETRY)
 				     & ~__GFP_WAIT;
 static gfp_t low_order_gfp_flags  = (GFP_HIGHUSER | __GFP_NOWARN);
-static const unsigned int orders[] = {4, 0};
+static const unsigned int orders[] = {8, 4, 0};
 static const int num_orders = ARRAY_SIZE(orders);
+
+/*
+ * Order-8 chunks let the IOMMU map the buffer with 1MB sections. They
+ * are rarely sitting on the free lists though, so when neither the pool
+ * nor the buddy allocator has one, allow a single asynchronous
+ * compaction attempt. If that fails, compaction is not tried again for
+ * compact_backoff_ms so that large allocations don't keep paying for it.
+ */
+#define ION_COMPACT_ORDER	8
+static unsigned int compact_backoff_ms = 1000;
+module_param(compact_backoff_ms, uint, S_IRUGO | S_IWUSR);
+static unsigned long compact_retry_time;
+
+/*
+ * Number of pre-zeroed chunks of each order in orders[] the refill
+ * thread keeps in the uncached pools. 0 disables refilling that order.
+ */
+static int pool_watermark[ARRAY_SIZE(orders)] = {0, 32, 512};
+module_param_array(pool_watermark, int, NULL, S_IRUGO | S_IWUSR);
+
+/* refill only from pages that are free right now, never reclaim for it */
+static gfp_t refill_gfp_flags = (__GFP_NORETRY | __GFP_NO_KSWAPD |
+				 __GFP_NOWARN | __GFP_NOMEMALLOC);
 static int order_to_index(unsigned int order)
 {
 	int i;
@@ -54,6 +81,9 @@ struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **uncached_pools;
 	struct ion_page_pool **cached_pools;
+	struct task_struct *refill_task;
+	wait_queue_head_t refill_wait;
+	bool refill_requested;
 };
 
 struct page_info {
@@ -63,6 +93,24 @@ struct page_info {
 	struct list_head list;
 };
 
+static struct page *alloc_compacted_page(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	if (time_before(jiffies, ACCESS_ONCE(compact_retry_time)))
+		return NULL;
+
+	/*
+	 * __GFP_NORETRY together with __GFP_NO_KSWAPD makes the allocator
+	 * give up instead of reclaiming when compaction is deferred.
+	 */
+	page = alloc_pages(pool->gfp_mask | __GFP_WAIT, pool->order);
+	if (!page)
+		compact_retry_time = jiffies +
+				     msecs_to_jiffies(compact_backoff_ms);
+	return page;
+}
+
 static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 				      struct ion_buffer *buffer,
 				      unsigned long order,
@@ -77,6 +125,8 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 	else
 		pool = heap->cached_pools[order_to_index(order)];
 	page = ion_page_pool_alloc(pool, from_pool);
+	if (!page && order == ION_COMPACT_ORDER)
+		page = alloc_compacted_page(pool);
 	if (!page)
 		return 0;
 
@@ -159,6 +209,74 @@ static unsigned int process_info(struct page_info *info,
 	return i;
 }
 
+static bool ion_system_heap_needs_refill(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < num_orders; i++) {
+		struct ion_page_pool *pool = heap->uncached_pools[i];
+
+		if (ion_page_pool_count(pool) < pool_watermark[i])
+			return true;
+	}
+	return false;
+}
+
+static void ion_system_heap_kick_refill(struct ion_system_heap *heap)
+{
+	if (!heap->refill_task || !ion_system_heap_needs_refill(heap))
+		return;
+
+	heap->refill_requested = true;
+	wake_up(&heap->refill_wait);
+}
+
+/*
+ * Top up the uncached pools with zeroed pages, so that allocations find
+ * them there instead of zeroing inline. Pages are zeroed and flushed
+ * exactly as on the ion_system_heap_free() path. Refilling stops at the
+ * first failed allocation and waits for the next kick, so it never
+ * competes with reclaim, which takes the pages back through
+ * ion_system_heap_shrink().
+ */
+static int ion_system_heap_refill(void *data)
+{
+	struct ion_system_heap *heap = data;
+	int i;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->refill_wait,
+				     heap->refill_requested ||
+				     kthread_should_stop());
+		heap->refill_requested = false;
+
+		for (i = 0; i < num_orders; i++) {
+			struct ion_page_pool *pool = heap->uncached_pools[i];
+			struct page *page;
+
+			while (ion_page_pool_count(pool) < pool_watermark[i]) {
+				if (kthread_should_stop())
+					return 0;
+
+				page = alloc_pages((pool->gfp_mask |
+						    refill_gfp_flags) &
+						   ~__GFP_WAIT, pool->order);
+				if (!page)
+					break;
+				if (msm_ion_heap_high_order_page_zero(page,
+								pool->order)) {
+					__free_pages(page, pool->order);
+					break;
+				}
+				ion_page_pool_free(pool, page);
+				cond_resched();
+			}
+		}
+	}
+
+	return 0;
+}
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				     struct ion_buffer *buffer,
 				     unsigned long size, unsigned long align,
@@ -277,6 +395,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 	if (nents_sync)
 		sg_free_table(&table_sync);
 	msm_ion_heap_free_pages_mem(&data);
+	ion_system_heap_kick_refill(sys_heap);
 	return 0;
 err_free_sg2:
 	/* We failed to zero buffers. Bypass pool */
@@ -369,6 +488,20 @@ static struct ion_heap_ops system_heap_ops = {
 	.shrink = ion_system_heap_shrink,
 };
 
+static void ion_system_heap_pcp_show(struct seq_file *s,
+				     struct ion_page_pool *pool,
+				     const char *name)
+{
+	unsigned long hits, misses;
+	int count;
+
+	ion_page_pool_pcp_stats(pool, &count, &hits, &misses);
+	seq_printf(s,
+		"%d order %u pages in %s per-cpu caches, %lu hits %lu misses (%lu%% hit rate)\n",
+		count, pool->order, name, hits, misses,
+		hits + misses ? hits * 100 / (hits + misses) : 0);
+}
+
 static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 				      void *unused)
 {
@@ -387,6 +520,7 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			"%d order %u lowmem pages in uncached pool = %lu total\n",
 			pool->low_count, pool->order,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
+		ion_system_heap_pcp_show(s, pool, "uncached");
 	}
 
 	for (i = 0; i < num_orders; i++) {
@@ -399,6 +533,7 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			"%d order %u lowmem pages in cached pool = %lu total\n",
 			pool->low_count, pool->order,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
+		ion_system_heap_pcp_show(s, pool, "cached");
 	}
 
 	return 0;
@@ -469,6 +604,20 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 		goto err_create_cached_pools;
 
 	heap->heap.debug_show = ion_system_heap_debug_show;
+
+	init_waitqueue_head(&heap->refill_wait);
+	heap->refill_task = kthread_run(ion_system_heap_refill, heap,
+					"ion_system_refill");
+	if (IS_ERR(heap->refill_task)) {
+		pr_err("%s: creating pool refill thread failed\n", __func__);
+		heap->refill_task = NULL;
+	} else {
+		struct sched_param param = { .sched_priority = 0 };
+
+		sched_setscheduler(heap->refill_task, SCHED_IDLE, &param);
+		ion_system_heap_kick_refill(heap);
+	}
+
 	return &heap->heap;
 
 err_create_cached_pools:
@@ -488,6 +637,8 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 							struct ion_system_heap,
 							heap);
 
+	if (sys_heap->refill_task)
+		kthread_stop(sys_heap->refill_task);
 	ion_system_heap_destroy_pools(sys_heap->uncached_pools);
 	ion_system_heap_destroy_pools(sys_heap->cached_pools);
 	kfree(sys_heap->uncached_pools);
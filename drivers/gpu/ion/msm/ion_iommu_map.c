@@ -196,6 +196,7 @@ static int ion_iommu_map_iommu(struct ion_iommu_meta *meta,
 	unsigned long extra, size;
 	struct sg_table *table;
 	int prot = IOMMU_WRITE | IOMMU_READ;
+	unsigned long min_align = align;
 
 
 	size = meta->size;
@@ -215,6 +216,15 @@ static int ion_iommu_map_iommu(struct ion_iommu_meta *meta,
 						data->mapped_size, align,
 						&data->iova_addr);
 
+	/*
+	 * The bigger alignment is only an optimization, don't fail the
+	 * mapping because the iova space is too fragmented for it.
+	 */
+	if (ret && align > min_align)
+		ret = msm_allocate_iova_address(domain_num, partition_num,
+						data->mapped_size, min_align,
+						&data->iova_addr);
+
 	if (ret)
 		goto out;
 
@@ -813,6 +813,7 @@
 #define SP_ALU_ACTIVE_CYCLES           0x1D
 #define SP0_ICL1_MISSES                0x1A
 #define SP_FS_CFLOW_INSTRUCTIONS       0x0C
+#define SP_STALL_CYCLES_BY_TP          0x20
 
 /* COUNTABLE FOR TSE PERFCOUNTER */
 #define TSE_INPUT_PRIM_NUM             0x0
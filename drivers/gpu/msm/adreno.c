@@ -1664,6 +1664,12 @@ adreno_probe(struct platform_device *pdev)
 	if (input_register_handler(&adreno_input_handler))
 		KGSL_DRV_ERR(device, "Unable to register the input handler\n");
 
+	/*
+	 * The GPU depends on no other device during system suspend and
+	 * resume, let it run in parallel with the rest.
+	 */
+	device_enable_async_suspend(&pdev->dev);
+
 	return 0;
 
 error_close_device:
@@ -1693,6 +1699,7 @@ static int __devexit adreno_remove(struct platform_device *pdev)
 
 	adreno_dispatcher_close(adreno_dev);
 	adreno_ringbuffer_close(&adreno_dev->ringbuffer);
+	adreno_sample_close(adreno_dev);
 	adreno_perfcounter_close(device);
 	kgsl_device_platform_remove(device);
 
@@ -1775,6 +1782,8 @@ static int adreno_init(struct kgsl_device *device)
 	if (ret)
 		goto done;
 
+	adreno_sample_init(adreno_dev);
+
 	/* Power down the device */
 	kgsl_pwrctrl_disable(device);
 
@@ -2016,6 +2025,8 @@ struct adreno_device *_get_adreno_dev(struct device *dev)
  * KGSL_FT_REPLAY  -> BIT(1) Set to enable replay
  * KGSL_FT_SKIPIB  -> BIT(2) Set to skip IB
  * KGSL_FT_SKIPFRAME -> BIT(3) Set to skip frame
+ * KGSL_FT_NO_SNAPSHOT -> BIT(8) Set to only log the fault header instead
+ * of taking a snapshot before recovery
  * by default set FT policy to KGSL_FT_DEFAULT_POLICY
  */
 static int _ft_policy_store(struct device *dev,
@@ -2506,8 +2517,31 @@ static int adreno_set_constraint(struct kgsl_device *device,
 		context->pwr_constraint.sub_type = pwr.level;
 		}
 		break;
+	case KGSL_CONSTRAINT_FRAME_TIME: {
+		struct kgsl_device_constraint_frame_time frame;
+
+		if (constraint->size != sizeof(frame)) {
+			status = -EINVAL;
+			break;
+		}
+
+		if (copy_from_user(&frame,
+				(void __user *)constraint->data,
+				sizeof(frame))) {
+			status = -EFAULT;
+			break;
+		}
+		if (frame.us == 0 || frame.us > USEC_PER_SEC) {
+			status = -EINVAL;
+			break;
+		}
+
+		ADRENO_CONTEXT(context)->frame_target = frame.us;
+		}
+		break;
 	case KGSL_CONSTRAINT_NONE:
 		context->pwr_constraint.type = KGSL_CONSTRAINT_NONE;
+		ADRENO_CONTEXT(context)->frame_target = 0;
 		break;
 
 	default:
@@ -44,6 +44,7 @@
 #define KGSL_CMD_FLAGS_PROFILE		BIT(3)
 #define KGSL_CMD_FLAGS_PWRON_FIXUP      BIT(4)
 #define KGSL_CMD_FLAGS_MEMLIST          BIT(5)
+#define KGSL_CMD_FLAGS_NO_KICK          BIT(6)
 
 /* Command identifiers */
 #define KGSL_CONTEXT_TO_MEM_IDENTIFIER	0x2EADBEEF
@@ -129,6 +130,7 @@ enum coresight_debug_reg {
  * submitted operation
  * @work: work_struct to put the dispatcher in a work queue
  * @kobj: kobject for the dispatcher directory in the device sysfs node
+ * @last_retire: Time in us when the last command batch was retired
  */
 struct adreno_dispatcher {
 	struct mutex mutex;
@@ -144,6 +146,7 @@ struct adreno_dispatcher {
 	unsigned int tail;
 	struct work_struct work;
 	struct kobject kobj;
+	u64 last_retire;
 };
 
 enum adreno_dispatcher_flags {
@@ -197,6 +200,7 @@ struct adreno_device {
 	struct ocmem_buf *ocmem_hdl;
 	unsigned int ocmem_base;
 	struct adreno_profile profile;
+	struct adreno_sampler sampler;
 	struct kgsl_memdesc pwron_fixup;
 	unsigned int pwron_fixup_dwords;
 	struct adreno_dispatcher dispatcher;
@@ -417,6 +421,7 @@ struct log_field {
 #define  KGSL_FT_TEMP_DISABLE             5
 #define  KGSL_FT_THROTTLE                 6
 #define  KGSL_FT_SKIPCMD                  7
+#define  KGSL_FT_NO_SNAPSHOT              8
 #define  KGSL_FT_DEFAULT_POLICY (BIT(KGSL_FT_REPLAY) + BIT(KGSL_FT_SKIPCMD) \
 				+ BIT(KGSL_FT_THROTTLE))
 
@@ -438,7 +443,8 @@ struct log_field {
 	{ BIT(KGSL_FT_DISABLE), "disable" }, \
 	{ BIT(KGSL_FT_TEMP_DISABLE), "temp" }, \
 	{ BIT(KGSL_FT_THROTTLE), "throttle"}, \
-	{ BIT(KGSL_FT_SKIPCMD), "skipcmd" }
+	{ BIT(KGSL_FT_SKIPCMD), "skipcmd" }, \
+	{ BIT(KGSL_FT_NO_SNAPSHOT), "nosnapshot" }
 
 #define ADRENO_CMDBATCH_FLAGS \
 	{ KGSL_CMDBATCH_CTX_SWITCH, "CTX_SWITCH" }, \
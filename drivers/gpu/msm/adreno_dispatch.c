@@ -15,6 +15,7 @@
 #include <linux/delay.h>
 #include <linux/sched.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/err.h>
 
 #include "kgsl.h"
@@ -47,6 +48,12 @@ static unsigned int _fault_throttle_burst = 3;
 /* Number of command batches inflight in the ringbuffer at any time */
 static unsigned int _dispatcher_inflight = 15;
 
+/*
+ * Number of inflight slots only contexts with a higher than default priority
+ * may use, so that they never wait for the ringbuffer to drain
+ */
+static unsigned int _fast_lane_inflight = 2;
+
 /* Command batch timeout (in milliseconds) */
 static unsigned int _cmdbatch_timeout = 2000;
 
@@ -201,6 +208,48 @@ static void _retire_marker(struct kgsl_cmdbatch *cmdbatch)
 	kgsl_cmdbatch_destroy(cmdbatch);
 }
 
+/**
+ * _retire_account() - Charge the GPU time of a retired command batch to its
+ * context
+ * @adreno_dev: Pointer to the adreno device
+ * @cmdbatch: Pointer to the command batch that just retired
+ *
+ * The ringbuffer executes in order so a command batch had the GPU to itself
+ * from the time it was submitted or the previous one retired, whichever is
+ * later, until now.  At the end of a frame the frame counters are sampled and
+ * on a context with a frame deadline the frame time is handed to pwrscale.
+ * Must be called with the device mutex held.
+ */
+static void _retire_account(struct adreno_device *adreno_dev,
+		struct kgsl_cmdbatch *cmdbatch)
+{
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+	struct adreno_context *drawctxt = ADRENO_CONTEXT(cmdbatch->context);
+	u64 now = ktime_to_us(ktime_get());
+	u64 busy;
+
+	busy = now - max(cmdbatch->submit_time, dispatcher->last_retire);
+	dispatcher->last_retire = now;
+
+	drawctxt->busy_time += busy;
+	drawctxt->frame_busy += busy;
+
+	if (drawctxt->frame_target)
+		kgsl_pwrscale_deadline_busy(&adreno_dev->dev, busy);
+
+	if (!(cmdbatch->flags & KGSL_CMDBATCH_END_OF_FRAME))
+		return;
+
+	trace_adreno_drawctxt_frame(drawctxt, drawctxt->frame_busy);
+	adreno_sample_frame(adreno_dev, cmdbatch);
+
+	if (drawctxt->frame_target)
+		kgsl_pwrscale_frame_done(&adreno_dev->dev,
+			drawctxt->frame_busy, drawctxt->frame_target);
+
+	drawctxt->frame_busy = 0;
+}
+
 /*
  * return true if this is a marker command and the dependent timestamp has
  * retired
@@ -408,7 +457,13 @@ static int sendcmd(struct adreno_device *adreno_dev,
 		set_bit(ADRENO_DISPATCHER_POWER, &dispatcher->priv);
 	}
 
-	ret = adreno_ringbuffer_submitcmd(adreno_dev, cmdbatch);
+	/*
+	 * Start the GPU right away if it is idle. Otherwise it has enough to
+	 * chew on and the wptr update can wait for the end of the burst, see
+	 * dispatcher_context_sendcmds()
+	 */
+	ret = adreno_ringbuffer_submitcmd(adreno_dev, cmdbatch,
+		dispatcher->inflight == 1);
 
 	/*
 	 * On the first command, if the submission was successful, then read the
@@ -434,6 +489,7 @@ static int sendcmd(struct adreno_device *adreno_dev,
 	}
 
 	trace_adreno_cmdbatch_submitted(cmdbatch, (int) dispatcher->inflight);
+	cmdbatch->submit_time = ktime_to_us(ktime_get());
 
 	dispatcher->cmdqueue[dispatcher->tail] = cmdbatch;
 	dispatcher->tail = (dispatcher->tail + 1) %
@@ -460,6 +516,48 @@ static int sendcmd(struct adreno_device *adreno_dev,
 	return 0;
 }
 
+/**
+ * _context_inflight() - Get the inflight limit for a context
+ * @drawctxt: Pointer to the adreno draw context
+ *
+ * Contexts on the fast lane may fill the whole ringbuffer, everybody else
+ * has to leave the reserved slots free
+ */
+static unsigned int _context_inflight(struct adreno_context *drawctxt)
+{
+	if (drawctxt->pending.prio < ADRENO_CONTEXT_DEFAULT_PRIORITY)
+		return _dispatcher_inflight;
+
+	if (_dispatcher_inflight > _fast_lane_inflight)
+		return _dispatcher_inflight - _fast_lane_inflight;
+
+	return 1;
+}
+
+/**
+ * _higher_priority_pending() - Check for a more important context
+ * @dispatcher: Pointer to the adreno dispatcher struct
+ * @drawctxt: Pointer to the context currently sending commands
+ *
+ * Return true if a context with a higher priority than @drawctxt is waiting
+ * on the dispatcher pending list
+ */
+static bool _higher_priority_pending(struct adreno_dispatcher *dispatcher,
+		struct adreno_context *drawctxt)
+{
+	bool ret = false;
+
+	spin_lock(&dispatcher->plist_lock);
+
+	if (!plist_head_empty(&dispatcher->pending))
+		ret = plist_first(&dispatcher->pending)->prio <
+			drawctxt->pending.prio;
+
+	spin_unlock(&dispatcher->plist_lock);
+
+	return ret;
+}
+
 /**
  * dispatcher_context_sendcmds() - Send commands from a context to the GPU
  * @adreno_dev: Pointer to the adreno device struct
@@ -476,6 +574,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	int count = 0;
 	int requeued = 0;
 	unsigned int timestamp;
+	u64 wait;
 
 	/*
 	 * Each context can send a specific number of command batches per cycle
@@ -488,6 +587,17 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 		if (adreno_gpu_fault(adreno_dev) != 0)
 			break;
 
+		/*
+		 * Give up the rest of the burst as soon as a more important
+		 * context shows up, and stay off the reserved fast lane
+		 * slots. Either way the context goes back on the list.
+		 */
+		if ((count && _higher_priority_pending(dispatcher, drawctxt)) ||
+			dispatcher->inflight >= _context_inflight(drawctxt)) {
+			requeued = 1;
+			break;
+		}
+
 		cmdbatch = adreno_dispatcher_get_cmdbatch(drawctxt);
 
 		/*
@@ -519,6 +629,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 		}
 
 		timestamp = cmdbatch->timestamp;
+		wait = ktime_to_us(ktime_get()) - cmdbatch->queued_time;
 
 		ret = sendcmd(adreno_dev, cmdbatch);
 
@@ -535,11 +646,23 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 			break;
 		}
 
+		trace_adreno_cmdbatch_queue_wait(cmdbatch,
+			drawctxt->pending.prio, wait);
+
 		drawctxt->submitted_timestamp = timestamp;
 
 		count++;
 	}
 
+	/* Let the GPU see everything this burst wrote to the ringbuffer */
+	if (adreno_dev->ringbuffer.kick_pending) {
+		struct kgsl_device *device = &adreno_dev->dev;
+
+		kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+		adreno_ringbuffer_kick(&adreno_dev->ringbuffer);
+		kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+	}
+
 	/*
 	 * Wake up any snoozing threads if we have consumed any real commands
 	 * or marker commands and we have room in the context queue.
@@ -870,6 +993,7 @@ int adreno_dispatcher_queue_cmd(struct adreno_device *adreno_dev,
 		}
 	}
 
+	cmdbatch->queued_time = ktime_to_us(ktime_get());
 	drawctxt->queued++;
 	trace_adreno_cmdbatch_queued(cmdbatch, drawctxt->queued);
 
@@ -1200,12 +1324,14 @@ static int dispatcher_do_fault(struct kgsl_device *device)
 
 	/*
 	 * Dump the snapshot information if this is the first
-	 * detected fault for the oldest active command batch
+	 * detected fault for the oldest active command batch. Taking the
+	 * snapshot stalls recovery, so the policy can ask for the header only.
 	 */
 
 	if (!test_bit(KGSL_FT_SKIP_PMDUMP, &cmdbatch->fault_policy)) {
 		adreno_fault_header(device, cmdbatch);
-		kgsl_device_snapshot(device, 1);
+		if (!test_bit(KGSL_FT_NO_SNAPSHOT, &cmdbatch->fault_policy))
+			kgsl_device_snapshot(device, 1);
 	}
 
     kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -1331,7 +1457,7 @@ static int dispatcher_do_fault(struct kgsl_device *device)
 	 */
 
 	if (test_bit(KGSL_CONTEXT_PAGEFAULT, &cmdbatch->context->priv)) {
-		/* we'll need to resume the mmu later... */
+		/* we'll need to resume the mmu before the reset */
 		pagefault = true;
 		clear_bit(KGSL_FT_REPLAY, &cmdbatch->fault_policy);
 		clear_bit(KGSL_CONTEXT_PAGEFAULT, &cmdbatch->context->priv);
@@ -1419,6 +1545,15 @@ replay:
 	/* Reset the GPU */
 	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
 
+	/*
+	 * A pagefault that didn't stall the GPU is confined to the guilty
+	 * context, which the policy above has already dealt with. Clear the
+	 * IOMMU fault state so that adreno_reset() can use the soft reset
+	 * instead of power cycling the GPU for every app on the system.
+	 */
+	if (pagefault && !(fault & ADRENO_IOMMU_PAGE_FAULT))
+		kgsl_mmu_pagefault_resume(&device->mmu);
+
 	ret = adreno_reset(device);
 	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
 	/* if any other fault got in until reset then ignore */
@@ -1585,6 +1720,7 @@ static void adreno_dispatcher_work(struct work_struct *work)
 				ADRENO_DISPATCH_CMDQUEUE_SIZE);
 
 			kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+			_retire_account(adreno_dev, cmdbatch);
 			/* Destroy the retired command batch */
 			kgsl_cmdbatch_destroy(cmdbatch);
 			kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -1892,6 +2028,8 @@ static ssize_t _show_uint(struct adreno_dispatcher *dispatcher,
 
 static DISPATCHER_UINT_ATTR(inflight, 0644, ADRENO_DISPATCH_CMDQUEUE_SIZE,
 	_dispatcher_inflight);
+static DISPATCHER_UINT_ATTR(fast_lane_inflight, 0644,
+	ADRENO_DISPATCH_CMDQUEUE_SIZE, _fast_lane_inflight);
 /*
  * Our code that "puts back" a command from the context is much cleaner
  * if we are sure that there will always be enough room in the
@@ -1913,6 +2051,7 @@ static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
+	&dispatcher_attr_fast_lane_inflight.attr,
 	&dispatcher_attr_context_cmdqueue_size.attr,
 	&dispatcher_attr_context_burst_count.attr,
 	&dispatcher_attr_cmdbatch_timeout.attr,
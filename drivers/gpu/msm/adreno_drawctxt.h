@@ -31,7 +31,11 @@ struct adreno_context_type {
 
 #define ADRENO_CONTEXT_CMDQUEUE_SIZE 128
 
-#define ADRENO_CONTEXT_DEFAULT_PRIORITY 1
+/*
+ * Contexts without a priority from userspace run in the middle of the
+ * range, anything with a higher priority gets on the dispatcher fast lane
+ */
+#define ADRENO_CONTEXT_DEFAULT_PRIORITY 8
 
 #define ADRENO_CONTEXT_STATE_ACTIVE 0
 #define ADRENO_CONTEXT_STATE_INVALID 1
@@ -61,6 +65,9 @@ struct kgsl_context;
  * @fault_policy: GFT fault policy set in cmdbatch_skip_cmd();
  * @queued_timestamp: The last timestamp that was queued on this context
  * @submitted_timestamp: The last timestamp that was submitted for this context
+ * @busy_time: Total GPU time in us attributed to this context
+ * @frame_busy: GPU time in us attributed to the frame in progress
+ * @frame_target: Target GPU time per frame in us, 0 if there is no deadline
  */
 struct adreno_context {
 	struct kgsl_context base;
@@ -85,6 +92,10 @@ struct adreno_context {
 	unsigned int fault_policy;
 	unsigned int queued_timestamp;
 	unsigned int submitted_timestamp;
+
+	u64 busy_time;
+	u64 frame_busy;
+	unsigned int frame_target;
 };
 
 /**
@@ -54,6 +54,37 @@ struct adreno_profile {
 	unsigned int shared_size;
 };
 
+/* Counters recorded by the always on frame sampler */
+enum adreno_sample_counters {
+	ADRENO_SAMPLE_BUSY = 0,
+	ADRENO_SAMPLE_ALU,
+	ADRENO_SAMPLE_TEX_STALL,
+	ADRENO_SAMPLE_AXI,
+	ADRENO_SAMPLE_MAX,
+};
+
+/**
+ * struct adreno_sample_counter - A reserved sampling counter
+ * @lo: LO register offset, 0 if the counter could not be reserved
+ * @hi: HI register offset
+ */
+struct adreno_sample_counter {
+	unsigned int lo;
+	unsigned int hi;
+};
+
+/**
+ * struct adreno_sampler - State of the always on frame sampler
+ * @ring: Ring of samples exported through sysfs
+ * @size: Size of @ring in bytes
+ * @counters: Counters read for every sample
+ */
+struct adreno_sampler {
+	struct kgsl_profile_ring *ring;
+	size_t size;
+	struct adreno_sample_counter counters[ADRENO_SAMPLE_MAX];
+};
+
 #define ADRENO_PROFILE_SHARED_BUF_SIZE_DWORDS (48 * 4096 / sizeof(uint))
 /* sized @ 48 pages should allow for over 50 outstanding IBs minimum, 1755 max*/
 
@@ -62,6 +93,13 @@ struct adreno_profile {
 #define ADRENO_PROFILE_LOG_BUF_SIZE_DWORDS  (ADRENO_PROFILE_LOG_BUF_SIZE / \
 						sizeof(unsigned int))
 
+struct adreno_device;
+
+void adreno_sample_init(struct adreno_device *adreno_dev);
+void adreno_sample_close(struct adreno_device *adreno_dev);
+void adreno_sample_frame(struct adreno_device *adreno_dev,
+		struct kgsl_cmdbatch *cmdbatch);
+
 #ifdef CONFIG_DEBUG_FS
 void adreno_profile_init(struct kgsl_device *device);
 void adreno_profile_close(struct kgsl_device *device);
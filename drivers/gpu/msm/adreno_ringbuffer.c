@@ -45,6 +45,20 @@ void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb)
 	mb();
 
 	adreno_writereg(adreno_dev, ADRENO_REG_CP_RB_WPTR, rb->wptr);
+	rb->kick_pending = false;
+}
+
+/**
+ * adreno_ringbuffer_kick() - Submit commands written without a wptr update
+ * @rb: Pointer to adreno ringbuffer
+ *
+ * Tell the hardware about commands added with KGSL_CMD_FLAGS_NO_KICK, if
+ * nobody else has since. Must be called with the device mutex held.
+ */
+void adreno_ringbuffer_kick(struct adreno_ringbuffer *rb)
+{
+	if (rb->kick_pending)
+		adreno_ringbuffer_submit(rb);
 }
 
 static int
@@ -405,6 +419,7 @@ void _ringbuffer_setup_common(struct adreno_ringbuffer *rb)
 		kgsl_regwrite(device, A3XX_CP_QUEUE_THRESHOLDS, 0x003E2008);
 
 	rb->wptr = 0;
+	rb->kick_pending = false;
 }
 
 /**
@@ -811,7 +826,14 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu, 0x00000000);
 	}
 
-	adreno_ringbuffer_submit(rb);
+	/*
+	 * The caller may hold the wptr update back to batch up several
+	 * submissions, it has to call adreno_ringbuffer_kick() afterwards
+	 */
+	if (flags & KGSL_CMD_FLAGS_NO_KICK)
+		rb->kick_pending = true;
+	else
+		adreno_ringbuffer_submit(rb);
 
 	return 0;
 }
@@ -1162,9 +1184,14 @@ void adreno_ringbuffer_set_constraint(struct kgsl_device *device,
 
 }
 
-/* adreno_rindbuffer_submitcmd - submit userspace IBs to the GPU */
+/*
+ * adreno_rindbuffer_submitcmd - submit userspace IBs to the GPU
+ *
+ * If @kick is false the commands are only written to the ringbuffer and
+ * the caller has to call adreno_ringbuffer_kick() to start them.
+ */
 int adreno_ringbuffer_submitcmd(struct adreno_device *adreno_dev,
-		struct kgsl_cmdbatch *cmdbatch)
+		struct kgsl_cmdbatch *cmdbatch, bool kick)
 {
 	struct kgsl_device *device = &adreno_dev->dev;
 	struct kgsl_memobj_node *ib;
@@ -1299,6 +1326,12 @@ int adreno_ringbuffer_submitcmd(struct adreno_device *adreno_dev,
 		test_bit(ADRENO_DEVICE_PWRON_FIXUP, &adreno_dev->priv))
 		flags |= KGSL_CMD_FLAGS_PWRON_FIXUP;
 
+#ifndef CONFIG_MSM_KGSL_CFF_DUMP
+	/* CFF dumping idles the GPU after every submission below */
+	if (!kick)
+		flags |= KGSL_CMD_FLAGS_NO_KICK;
+#endif
+
 	/* Set the constraints before adding to ringbuffer */
 	adreno_ringbuffer_set_constraint(device, cmdbatch);
 
@@ -33,6 +33,8 @@ struct adreno_ringbuffer {
 	unsigned int sizedwords;
 
 	unsigned int wptr; /* write pointer offset in dwords from baseaddr */
+	/* commands were written but the hardware wptr wasn't updated yet */
+	bool kick_pending;
 
 	unsigned int global_ts;
 };
@@ -63,7 +65,9 @@ int adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 				uint32_t *timestamp);
 
 int adreno_ringbuffer_submitcmd(struct adreno_device *adreno_dev,
-		struct kgsl_cmdbatch *cmdbatch);
+		struct kgsl_cmdbatch *cmdbatch, bool kick);
+
+void adreno_ringbuffer_kick(struct adreno_ringbuffer *rb);
 
 int adreno_ringbuffer_init(struct kgsl_device *device);
 
@@ -0,0 +1,230 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/sysfs.h>
+#include <linux/ktime.h>
+
+#include "adreno.h"
+#include "adreno_profile.h"
+
+/*
+ * Lightweight frame sampling: a fixed set of kernel owned performance
+ * counters is read from the CPU whenever an end of frame command batch
+ * retires and the raw values are appended to a ring that userspace can read
+ * or mmap from sysfs.  Unlike the debugfs profiler nothing is added to the
+ * ringbuffer so it can stay on all the time.
+ */
+
+#define ADRENO_SAMPLE_RING_SIZE 512
+
+static const struct {
+	unsigned int groupid;
+	unsigned int countable;
+} sample_countables[ADRENO_SAMPLE_MAX] = {
+	[ADRENO_SAMPLE_BUSY] = { KGSL_PERFCOUNTER_GROUP_PWR, 1 },
+	[ADRENO_SAMPLE_ALU] = { KGSL_PERFCOUNTER_GROUP_SP,
+		SP_ALU_ACTIVE_CYCLES },
+	[ADRENO_SAMPLE_TEX_STALL] = { KGSL_PERFCOUNTER_GROUP_SP,
+		SP_STALL_CYCLES_BY_TP },
+	[ADRENO_SAMPLE_AXI] = { KGSL_PERFCOUNTER_GROUP_VBIF,
+		VBIF_AXI_TOTAL_BEATS },
+};
+
+static uint64_t _sample_read(struct kgsl_device *device,
+		struct adreno_sample_counter *counter)
+{
+	unsigned int lo, hi, tmp;
+
+	if (counter->lo == 0)
+		return 0;
+
+	/* Re-read if the low word wrapped between the two reads */
+	kgsl_regread(device, counter->hi, &hi);
+	do {
+		tmp = hi;
+		kgsl_regread(device, counter->lo, &lo);
+		kgsl_regread(device, counter->hi, &hi);
+	} while (hi != tmp);
+
+	return (((uint64_t) hi) << 32) | lo;
+}
+
+/**
+ * adreno_sample_frame() - Record the frame counters for a retired command
+ * @adreno_dev: Pointer to an adreno_device structure
+ * @cmdbatch: The end of frame command batch that just retired
+ *
+ * Must be called with the device mutex held while the dispatcher still
+ * holds its active count, so the counters are readable.
+ */
+void adreno_sample_frame(struct adreno_device *adreno_dev,
+		struct kgsl_cmdbatch *cmdbatch)
+{
+	struct adreno_sampler *sampler = &adreno_dev->sampler;
+	struct kgsl_device *device = &adreno_dev->dev;
+	struct kgsl_profile_ring *ring = sampler->ring;
+	struct kgsl_profile_sample *sample;
+
+	if (ring == NULL)
+		return;
+
+	sample = &ring->samples[ring->head % ring->count];
+
+	sample->context_id = cmdbatch->context->id;
+	sample->timestamp = cmdbatch->timestamp;
+	sample->time = ktime_to_ns(ktime_get());
+	sample->busy = _sample_read(device,
+		&sampler->counters[ADRENO_SAMPLE_BUSY]);
+	sample->alu_busy = _sample_read(device,
+		&sampler->counters[ADRENO_SAMPLE_ALU]);
+	sample->tex_stall = _sample_read(device,
+		&sampler->counters[ADRENO_SAMPLE_TEX_STALL]);
+	sample->axi_beats = _sample_read(device,
+		&sampler->counters[ADRENO_SAMPLE_AXI]);
+
+	/* Publish the sample before moving the head past it */
+	smp_wmb();
+	ring->head++;
+}
+
+static ssize_t profile_ring_read(struct file *filep, struct kobject *kobj,
+		struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(
+		container_of(kobj, struct device, kobj));
+	struct adreno_sampler *sampler;
+
+	if (device == NULL)
+		return -ENODEV;
+
+	sampler = &ADRENO_DEVICE(device)->sampler;
+
+	if (off >= sampler->size)
+		return 0;
+
+	count = min_t(size_t, count, sampler->size - off);
+	memcpy(buf, (char *) sampler->ring + off, count);
+
+	return count;
+}
+
+static int profile_ring_mmap(struct file *filep, struct kobject *kobj,
+		struct bin_attribute *attr, struct vm_area_struct *vma)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(
+		container_of(kobj, struct device, kobj));
+	struct adreno_sampler *sampler;
+
+	if (device == NULL)
+		return -ENODEV;
+
+	sampler = &ADRENO_DEVICE(device)->sampler;
+
+	/* The ring can only be mapped as read only */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, sampler->ring, vma->vm_pgoff);
+}
+
+static struct bin_attribute profile_ring_attr = {
+	.attr = { .name = "profile_ring", .mode = 0444 },
+	.read = profile_ring_read,
+	.mmap = profile_ring_mmap,
+};
+
+/**
+ * adreno_sample_init() - Reserve the sampling counters and create the ring
+ * @adreno_dev: Pointer to an adreno_device structure
+ *
+ * Called with the GPU powered during device init.  A counter that can't be
+ * reserved, e.g. because userspace profiling took all of its group, is left
+ * out of the samples.  Failing to create the ring only disables sampling.
+ */
+void adreno_sample_init(struct adreno_device *adreno_dev)
+{
+	struct adreno_sampler *sampler = &adreno_dev->sampler;
+	struct kgsl_device *device = &adreno_dev->dev;
+	struct kgsl_profile_ring *ring;
+	size_t size;
+	int i;
+
+	size = PAGE_ALIGN(sizeof(*ring) +
+		ADRENO_SAMPLE_RING_SIZE * sizeof(struct kgsl_profile_sample));
+
+	ring = vmalloc_user(size);
+	if (ring == NULL)
+		return;
+
+	ring->version = KGSL_PROFILE_RING_VERSION;
+	ring->count = ADRENO_SAMPLE_RING_SIZE;
+
+	for (i = 0; i < ADRENO_SAMPLE_MAX; i++) {
+		struct adreno_sample_counter *counter = &sampler->counters[i];
+
+		if (adreno_perfcounter_get(adreno_dev,
+			sample_countables[i].groupid,
+			sample_countables[i].countable,
+			&counter->lo, &counter->hi, PERFCOUNTER_FLAG_KERNEL)) {
+			KGSL_DRV_INFO(device,
+				"Unable to reserve sampling counter %d/%d\n",
+				sample_countables[i].groupid,
+				sample_countables[i].countable);
+			counter->lo = 0;
+			counter->hi = 0;
+		}
+	}
+
+	sampler->size = size;
+	profile_ring_attr.size = size;
+	sampler->ring = ring;
+
+	if (sysfs_create_bin_file(&device->dev->kobj, &profile_ring_attr))
+		KGSL_DRV_ERR(device, "Unable to create the profile ring\n");
+}
+
+/**
+ * adreno_sample_close() - Release the resources of adreno_sample_init()
+ * @adreno_dev: Pointer to an adreno_device structure
+ */
+void adreno_sample_close(struct adreno_device *adreno_dev)
+{
+	struct adreno_sampler *sampler = &adreno_dev->sampler;
+	struct kgsl_device *device = &adreno_dev->dev;
+	int i;
+
+	if (sampler->ring == NULL)
+		return;
+
+	sysfs_remove_bin_file(&device->dev->kobj, &profile_ring_attr);
+
+	for (i = 0; i < ADRENO_SAMPLE_MAX; i++) {
+		if (sampler->counters[i].lo == 0)
+			continue;
+
+		adreno_perfcounter_put(adreno_dev,
+			sample_countables[i].groupid,
+			sample_countables[i].countable,
+			PERFCOUNTER_FLAG_KERNEL);
+		sampler->counters[i].lo = 0;
+		sampler->counters[i].hi = 0;
+	}
+
+	vfree(sampler->ring);
+	sampler->ring = NULL;
+	sampler->size = 0;
+}
@@ -74,6 +74,28 @@ DEFINE_EVENT(adreno_cmdbatch_template, adreno_cmdbatch_submitted,
 	TP_ARGS(cmdbatch, inflight)
 );
 
+TRACE_EVENT(adreno_cmdbatch_queue_wait,
+	TP_PROTO(struct kgsl_cmdbatch *cmdbatch, int priority, u64 wait),
+	TP_ARGS(cmdbatch, priority, wait),
+	TP_STRUCT__entry(
+		__field(unsigned int, id)
+		__field(unsigned int, timestamp)
+		__field(int, priority)
+		__field(u64, wait)
+	),
+	TP_fast_assign(
+		__entry->id = cmdbatch->context->id;
+		__entry->timestamp = cmdbatch->timestamp;
+		__entry->priority = priority;
+		__entry->wait = wait;
+	),
+	TP_printk(
+		"ctx=%u ts=%u prio=%d wait=%llu us",
+			__entry->id, __entry->timestamp, __entry->priority,
+			__entry->wait
+	)
+);
+
 TRACE_EVENT(adreno_cmdbatch_retired,
 	TP_PROTO(struct kgsl_cmdbatch *cmdbatch, int inflight),
 	TP_ARGS(cmdbatch, inflight),
@@ -103,6 +125,25 @@ TRACE_EVENT(adreno_cmdbatch_retired,
 	)
 );
 
+TRACE_EVENT(adreno_drawctxt_frame,
+	TP_PROTO(struct adreno_context *drawctxt, u64 busy),
+	TP_ARGS(drawctxt, busy),
+	TP_STRUCT__entry(
+		__field(unsigned int, id)
+		__field(u64, busy)
+		__field(unsigned int, target)
+	),
+	TP_fast_assign(
+		__entry->id = drawctxt->base.id;
+		__entry->busy = busy;
+		__entry->target = drawctxt->frame_target;
+	),
+	TP_printk(
+		"ctx=%u busy=%llu us target=%u us",
+			__entry->id, __entry->busy, __entry->target
+	)
+);
+
 TRACE_EVENT(adreno_cmdbatch_fault,
 	TP_PROTO(struct kgsl_cmdbatch *cmdbatch, unsigned int fault),
 	TP_ARGS(cmdbatch, fault),
@@ -80,6 +80,9 @@ struct kgsl_dma_buf_meta {
 
 static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry);
 
+/* Serializes populating lazy allocations */
+static DEFINE_MUTEX(kgsl_lazy_mutex);
+
 /**
  * kgsl_trace_issueibcmds() - Call trace_issueibcmds by proxy
  * device: KGSL device
@@ -467,8 +470,13 @@ kgsl_mem_entry_attach_process(struct kgsl_mem_entry *entry,
 	spin_unlock(&process->mem_lock);
 	if (ret)
 		goto err_put_proc_priv;
-	/* map the memory after unlocking if gpuaddr has been assigned */
-	if (entry->memdesc.gpuaddr) {
+	/*
+	 * map the memory after unlocking if gpuaddr has been assigned, lazy
+	 * allocations get mapped once they are populated
+	 */
+	if (kgsl_memdesc_is_lazy(&entry->memdesc)) {
+		atomic_inc(&process->lazy_count);
+	} else if (entry->memdesc.gpuaddr) {
 		ret = kgsl_mmu_map(process->pagetable, &entry->memdesc);
 		if (ret)
 			kgsl_mem_entry_detach_process(entry);
@@ -490,6 +498,9 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	/* Unmap here so that below we can call kgsl_mmu_put_gpuaddr */
 	kgsl_mmu_unmap(entry->priv->pagetable, &entry->memdesc);
 
+	if (kgsl_memdesc_is_lazy(&entry->memdesc))
+		atomic_dec(&entry->priv->lazy_count);
+
 	spin_lock(&entry->priv->mem_lock);
 
 	kgsl_mem_entry_untrack_gpuaddr(entry->priv, entry);
@@ -504,6 +515,74 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	entry->priv = NULL;
 }
 
+/**
+ * kgsl_mem_entry_populate() - Allocate the pages of a lazy mem_entry
+ * @entry: The memory entry, the caller must hold a reference
+ *
+ * Allocate and map the pages of an entry created with KGSL_MEMFLAGS_LAZY.
+ * Does nothing if the entry has already been populated.
+ *
+ * Return: 0 on success else error code
+ */
+static int kgsl_mem_entry_populate(struct kgsl_mem_entry *entry)
+{
+	int ret = 0;
+
+	mutex_lock(&kgsl_lazy_mutex);
+	if (kgsl_memdesc_is_lazy(&entry->memdesc)) {
+		ret = kgsl_sharedmem_populate(&entry->memdesc);
+		if (!ret)
+			atomic_dec(&entry->priv->lazy_count);
+	}
+	mutex_unlock(&kgsl_lazy_mutex);
+
+	return ret;
+}
+
+/**
+ * kgsl_process_populate_lazy() - Populate all lazy allocations of a process
+ * @private: The process about to submit commands
+ *
+ * The GPU can't fault pages in, so anything it may touch has to be backed
+ * before a submission. Command buffers may refer to any allocation of the
+ * process, so populate every one that's still pending.
+ *
+ * Return: 0 on success else error code
+ */
+static int kgsl_process_populate_lazy(struct kgsl_process_private *private)
+{
+	struct kgsl_mem_entry *entry;
+	struct rb_node *node;
+	int ret = 0;
+
+	while (!ret && atomic_read(&private->lazy_count)) {
+		entry = NULL;
+
+		spin_lock(&private->mem_lock);
+		for (node = rb_first(&private->mem_rb); node;
+			node = rb_next(node)) {
+			struct kgsl_mem_entry *cur =
+				rb_entry(node, struct kgsl_mem_entry, node);
+
+			if (kgsl_memdesc_is_lazy(&cur->memdesc) &&
+				!cur->pending_free && kgsl_mem_entry_get(cur)) {
+				entry = cur;
+				break;
+			}
+		}
+		spin_unlock(&private->mem_lock);
+
+		/* The rest is either being freed or not committed yet */
+		if (entry == NULL)
+			break;
+
+		ret = kgsl_mem_entry_populate(entry);
+		kgsl_mem_entry_put(entry);
+	}
+
+	return ret;
+}
+
 /**
  * kgsl_context_dump() - dump information about a draw context
  * @device: KGSL device that owns the context
@@ -905,7 +984,9 @@ static void kgsl_destroy_process_private(struct kref *kref)
 		mutex_unlock(&kgsl_driver.process_mutex);
 		return;
 	}
+	spin_lock(&kgsl_driver.proclist_lock);
 	list_del(&private->list);
+	spin_unlock(&kgsl_driver.proclist_lock);
 	mutex_unlock(&kgsl_driver.process_mutex);
 
 	if (private->kobj.state_in_sysfs)
@@ -957,6 +1038,35 @@ struct kgsl_process_private *kgsl_process_private_find(pid_t pid)
 	return private;
 }
 
+/**
+ * kgsl_process_mem_pages() - Get the GPU memory owned by a process
+ * @pid: tgid of the process
+ *
+ * Return the number of pages kgsl allocated on behalf of the process.  Only
+ * KGSL_MEM_ENTRY_KERNEL memory is counted: it is not part of the RSS of the
+ * process and it is freed when the process goes away.  Imported memory is
+ * either already in the RSS or shared with other processes.  Safe to call
+ * from atomic context, e.g. the low memory killer scan.
+ */
+unsigned long kgsl_process_mem_pages(pid_t pid)
+{
+	struct kgsl_process_private *p;
+	unsigned long pages = 0;
+
+	spin_lock(&kgsl_driver.proclist_lock);
+	list_for_each_entry(p, &kgsl_driver.process_list, list) {
+		if (p->pid == pid) {
+			pages = p->stats[KGSL_MEM_ENTRY_KERNEL].cur >>
+				PAGE_SHIFT;
+			break;
+		}
+	}
+	spin_unlock(&kgsl_driver.proclist_lock);
+
+	return pages;
+}
+EXPORT_SYMBOL(kgsl_process_mem_pages);
+
 /**
  * kgsl_process_private_new() - Helper function to search for process private
  * Returns: Pointer to the found/newly created private struct
@@ -986,7 +1096,9 @@ static struct kgsl_process_private *kgsl_process_private_new(void)
 	spin_lock_init(&private->mem_lock);
 	mutex_init(&private->process_private_mutex);
 	/* Add the newly created process struct obj to the process list */
+	spin_lock(&kgsl_driver.proclist_lock);
 	list_add(&private->list, &kgsl_driver.process_list);
+	spin_unlock(&kgsl_driver.proclist_lock);
 done:
 	mutex_unlock(&kgsl_driver.process_mutex);
 	return private;
@@ -2362,6 +2474,9 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 	struct kgsl_cmdbatch *cmdbatch;
 	long result = -EINVAL;
 
+	/* Start powering up the GPU while the command is parsed */
+	kgsl_pwrctrl_early_wake(device);
+
 	/* The legacy functions don't support synchronization commands */
 	if ((param->flags & (KGSL_CMDBATCH_SYNC | KGSL_CMDBATCH_MARKER)))
 		return -EINVAL;
@@ -2394,6 +2509,10 @@ static long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 	if (!_kgsl_cmdbatch_verify(dev_priv, cmdbatch))
 		goto free_cmdbatch;
 
+	result = kgsl_process_populate_lazy(dev_priv->process_priv);
+	if (result)
+		goto free_cmdbatch;
+
 	result = dev_priv->device->ftbl->issueibcmds(dev_priv, context,
 		cmdbatch, &param->timestamp);
 
@@ -2423,6 +2542,9 @@ static long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 
 	long result = -EINVAL;
 
+	/* Start powering up the GPU while the command is parsed */
+	kgsl_pwrctrl_early_wake(device);
+
 	/*
 	 * The SYNC bit is supposed to identify a dummy sync object so warn the
 	 * user if they specified any IBs with it.  A MARKER command can either
@@ -2456,6 +2578,10 @@ static long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 	if (!_kgsl_cmdbatch_verify(dev_priv, cmdbatch))
 		goto free_cmdbatch;
 
+	result = kgsl_process_populate_lazy(dev_priv->process_priv);
+	if (result)
+		goto free_cmdbatch;
+
 	result = dev_priv->device->ftbl->issueibcmds(dev_priv, context,
 		cmdbatch, &param->timestamp);
 
@@ -3422,7 +3548,12 @@ _gpumem_alloc(struct kgsl_device_private *dev_priv,
 		| KGSL_CACHEMODE_MASK
 		| KGSL_MEMTYPE_MASK
 		| KGSL_MEMALIGN_MASK
-		| KGSL_MEMFLAGS_USE_CPU_MAP;
+		| KGSL_MEMFLAGS_USE_CPU_MAP
+		| KGSL_MEMFLAGS_LAZY;
+
+	/* The GPU address of a CPU mapped buffer is only known at mmap time */
+	if (flags & KGSL_MEMFLAGS_USE_CPU_MAP)
+		flags &= ~KGSL_MEMFLAGS_LAZY;
 
 	/* Cap the alignment bits to the highest number we can handle */
 
@@ -3699,6 +3830,30 @@ static long kgsl_add_genlock_event(struct kgsl_device *device,
 }
 #endif
 
+static int kgsl_add_eventfd_event_user(struct kgsl_device *device,
+	u32 context_id, u32 timestamp, void __user *data, int len,
+	struct kgsl_device_private *owner)
+{
+	struct kgsl_timestamp_event_eventfd priv;
+	struct kgsl_context *context;
+	int ret;
+
+	if (len != sizeof(priv))
+		return -EINVAL;
+
+	if (copy_from_user(&priv, data, sizeof(priv)))
+		return -EFAULT;
+
+	context = kgsl_context_get_owner(owner, context_id);
+	if (context == NULL)
+		return -EINVAL;
+
+	ret = kgsl_add_eventfd_event(device, context, timestamp, priv.fd);
+
+	kgsl_context_put(context);
+	return ret;
+}
+
 /**
  * kgsl_ioctl_timestamp_event - Register a new timestamp event from userspace
  * @dev_priv - pointer to the private device structure
@@ -3724,6 +3879,11 @@ static long kgsl_ioctl_timestamp_event(struct kgsl_device_private *dev_priv,
 			param->context_id, param->timestamp, param->priv,
 			param->len, dev_priv);
 		break;
+	case KGSL_TIMESTAMP_EVENT_EVENTFD:
+		ret = kgsl_add_eventfd_event_user(dev_priv->device,
+			param->context_id, param->timestamp, param->priv,
+			param->len, dev_priv);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -3939,6 +4099,13 @@ kgsl_gpumem_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (!entry->memdesc.ops || !entry->memdesc.ops->vmfault)
 		return VM_FAULT_SIGBUS;
 
+	if (kgsl_memdesc_is_lazy(&entry->memdesc)) {
+		if (kgsl_mem_entry_populate(entry))
+			return VM_FAULT_OOM;
+	}
+	/* Pairs with the barrier in kgsl_sharedmem_populate() */
+	smp_rmb();
+
 	return entry->memdesc.ops->vmfault(&entry->memdesc, vma, vmf);
 }
 
@@ -4407,6 +4574,7 @@ static const struct file_operations kgsl_fops = {
 struct kgsl_driver kgsl_driver  = {
 	.process_mutex = __MUTEX_INITIALIZER(kgsl_driver.process_mutex),
 	.ptlock = __SPIN_LOCK_UNLOCKED(kgsl_driver.ptlock),
+	.proclist_lock = __SPIN_LOCK_UNLOCKED(kgsl_driver.proclist_lock),
 	.devlock = __MUTEX_INITIALIZER(kgsl_driver.devlock),
 	/*
 	 * Full cache flushes are faster than line by line on at least
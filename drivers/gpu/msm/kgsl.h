@@ -105,6 +105,8 @@ struct kgsl_driver {
 	spinlock_t ptlock;
 	/* Mutex for accessing the process list */
 	struct mutex process_mutex;
+	/* Spinlock for walking the process list from atomic context */
+	spinlock_t proclist_lock;
 
 	/* Mutex for protecting the device list */
 	struct mutex devlock;
@@ -120,6 +122,9 @@ struct kgsl_driver {
 		atomic_t coherent_max;
 		atomic_t mapped;
 		atomic_t mapped_max;
+		atomic_t page_pool;
+		atomic_t page_pool_hits;
+		atomic_t page_pool_misses;
 	} stats;
 	unsigned int full_cache_threshold;
 };
@@ -147,6 +152,8 @@ struct kgsl_memdesc_ops {
 #define KGSL_MEMDESC_FROZEN BIT(2)
 /* The memdesc is mapped into a pagetable */
 #define KGSL_MEMDESC_MAPPED BIT(3)
+/* The memdesc has a GPU address but no pages allocated yet */
+#define KGSL_MEMDESC_LAZY BIT(4)
 
 /* shared memory allocation */
 struct kgsl_memdesc {
@@ -235,6 +235,8 @@ struct kgsl_memobj_node {
  * @timer: a timer used to track possible sync timeouts for this cmdbatch
  * @marker_timestamp: For markers, the timestamp of the last "real" command that
  * was queued
+ * @queued_time: Time in us when the command was queued in its context
+ * @submit_time: Time in us when the command was submitted to the ringbuffer
  *
  * This struture defines an atomic batch of command buffers issued from
  * userspace.
@@ -255,6 +257,8 @@ struct kgsl_cmdbatch {
 	struct list_head synclist;
 	struct timer_list timer;
 	unsigned int marker_timestamp;
+	u64 queued_time;
+	u64 submit_time;
 };
 
 /**
@@ -308,6 +312,7 @@ struct kgsl_device {
 	struct completion cmdbatch_gate;
 	const struct kgsl_functable *ftbl;
 	struct work_struct idle_check_ws;
+	struct work_struct early_wake_ws;
 	struct timer_list idle_timer;
 	struct kgsl_pwrctrl pwrctrl;
 	int open_count;
@@ -366,6 +371,8 @@ struct kgsl_device {
 	.cmdbatch_gate = COMPLETION_INITIALIZER((_dev).cmdbatch_gate),\
 	.idle_check_ws = __WORK_INITIALIZER((_dev).idle_check_ws,\
 			kgsl_idle_check),\
+	.early_wake_ws = __WORK_INITIALIZER((_dev).early_wake_ws,\
+			kgsl_early_wake),\
 	.context_idr = IDR_INIT((_dev).context_idr),\
 	.wait_queue = __WAIT_QUEUE_HEAD_INITIALIZER((_dev).wait_queue),\
 	.active_cnt_wq = __WAIT_QUEUE_HEAD_INITIALIZER((_dev).active_cnt_wq),\
@@ -461,6 +468,9 @@ struct kgsl_process_private {
 		unsigned int cur;
 		unsigned int max;
 	} stats[KGSL_MEM_ENTRY_MAX];
+
+	/* Number of lazy allocations that haven't been populated yet */
+	atomic_t lazy_count;
 };
 
 /**
@@ -594,6 +604,8 @@ void kgsl_cancel_event(struct kgsl_device *device,
 		kgsl_event_func func, void *priv);
 int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 		unsigned int timestamp, kgsl_event_func func, void *priv);
+int kgsl_add_eventfd_event(struct kgsl_device *device,
+		struct kgsl_context *context, unsigned int timestamp, int fd);
 void kgsl_process_event_group(struct kgsl_device *device,
 	struct kgsl_event_group *group);
 
@@ -14,6 +14,7 @@
 #include <linux/slab.h>
 #include <linux/list.h>
 #include <linux/workqueue.h>
+#include <linux/eventfd.h>
 #include <kgsl_device.h>
 
 #include "kgsl_trace.h"
@@ -235,6 +236,44 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 }
 EXPORT_SYMBOL(kgsl_add_event);
 
+static void _eventfd_event_cb(struct kgsl_device *device,
+		struct kgsl_context *context, void *priv, int result)
+{
+	struct eventfd_ctx *ctx = priv;
+
+	/* Signal for every result so a waiter never gets stuck */
+	eventfd_signal(ctx, 1);
+	eventfd_ctx_put(ctx);
+}
+
+/**
+ * kgsl_add_eventfd_event() - Signal an eventfd when a timestamp retires
+ * @device: Pointer to a KGSL device
+ * @context: Context that the timestamp belongs to
+ * @timestamp: Timestamp that the event will expire on
+ * @fd: File descriptor of the eventfd to signal
+ *
+ * Lets userspace sleep in poll() on an eventfd instead of blocking in
+ * IOCTL_KGSL_DEVICE_WAITTIMESTAMP_CTXTID.
+ */
+int kgsl_add_eventfd_event(struct kgsl_device *device,
+		struct kgsl_context *context, unsigned int timestamp, int fd)
+{
+	struct eventfd_ctx *ctx;
+	int ret;
+
+	ctx = eventfd_ctx_fdget(fd);
+	if (IS_ERR(ctx))
+		return PTR_ERR(ctx);
+
+	ret = kgsl_add_event(device, &context->events, timestamp,
+		_eventfd_event_cb, ctx);
+	if (ret)
+		eventfd_ctx_put(ctx);
+
+	return ret;
+}
+
 static DEFINE_RWLOCK(group_lock);
 static LIST_HEAD(group_list);
 
@@ -96,21 +96,31 @@ static void kgsl_page_pool_free_pages(struct kgsl_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static void kgsl_page_pool_zero(struct kgsl_page_pool *pool, struct page *page)
+/*
+ * Make the page safe to hand to the GPU: optionally zero it, and push it
+ * out of the CPU caches so no dirty lines get written back over GPU data.
+ * Pages sitting in the pool are always clean, so this is done once when
+ * they enter the pool instead of on every allocation.
+ */
+static void kgsl_page_pool_clean(struct kgsl_page_pool *pool,
+				 struct page *page, bool zero)
 {
 	int i;
-	trace_kgsl_page_pool_zero_begin(pool->order);
+
+	if (zero)
+		trace_kgsl_page_pool_zero_begin(pool->order);
 	for (i = 0; i < (1 << pool->order); i++) {
 		struct page *p;
 		void *kaddr;
 		p = nth_page(page, i);
 		kaddr = kmap_atomic(p);
-		clear_page(kaddr);
+		if (zero)
+			clear_page(kaddr);
 		dmac_flush_range(kaddr, kaddr + PAGE_SIZE);
 		kunmap_atomic(kaddr);
 	}
-	trace_kgsl_page_pool_zero_end(pool->order);
-
+	if (zero)
+		trace_kgsl_page_pool_zero_end(pool->order);
 }
 
 static int kgsl_page_pool_add(struct kgsl_page_pool *pool, struct page *page)
@@ -119,6 +129,7 @@ static int kgsl_page_pool_add(struct kgsl_page_pool *pool, struct page *page)
 	list_add_tail(&page->lru, &pool->items);
 	pool->count++;
 	mutex_unlock(&pool->mutex);
+	atomic_add(PAGE_SIZE << pool->order, &kgsl_driver.stats.page_pool);
 	return 0;
 }
 
@@ -130,6 +141,7 @@ static struct page *kgsl_page_pool_remove(struct kgsl_page_pool *pool)
 	page = list_first_entry(&pool->items, struct page, lru);
 	pool->count--;
 	list_del(&page->lru);
+	atomic_sub(PAGE_SIZE << pool->order, &kgsl_driver.stats.page_pool);
 	return page;
 }
 
@@ -143,15 +155,18 @@ static struct page *kgsl_page_pool_alloc(struct kgsl_page_pool *pool)
 		page = kgsl_page_pool_remove(pool);
 	mutex_unlock(&pool->mutex);
 
-	if (!page && !pool->reserve_only) {
-		// allocate with GFP_ZERO, don't need to zero by hand
+	if (page) {
+		// already zeroed and cleaned when it was freed to the pool
+		atomic_inc(&kgsl_driver.stats.page_pool_hits);
+	} else if (!pool->reserve_only) {
+		// allocate with GFP_ZERO, only the cache needs cleaning
 		page = kgsl_page_pool_alloc_pages(pool);
+		if (page) {
+			atomic_inc(&kgsl_driver.stats.page_pool_misses);
+			kgsl_page_pool_clean(pool, page, false);
+		}
 	}
 
-	// zero anything coming back from the pool
-	if (page)
-		kgsl_page_pool_zero(pool, page);
-
 	trace_kgsl_page_pool_alloc_end(pool->order);
 
 	return page;
@@ -161,6 +176,7 @@ static void kgsl_page_pool_free(struct kgsl_page_pool *pool, struct page *page)
 {
 	int ret;
 	BUG_ON(pool->order != compound_order(page));
+	kgsl_page_pool_clean(pool, page, true);
 	ret = kgsl_page_pool_add(pool, page);
 	if (ret)
 		kgsl_page_pool_free_pages(pool, page);
@@ -233,6 +249,7 @@ static struct kgsl_page_pool *kgsl_page_pool_create(gfp_t gfp_mask, unsigned int
 				kgsl_page_pool_destroy(pool);
 				return NULL;
 			}
+			kgsl_page_pool_clean(pool, page, false);
 			kgsl_page_pool_add(pool, page);
 		}
 
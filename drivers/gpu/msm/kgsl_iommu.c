@@ -639,6 +639,15 @@ static int kgsl_iommu_pt_equal(struct kgsl_mmu *mmu,
 static void kgsl_iommu_destroy_pagetable(struct kgsl_pagetable *pt)
 {
 	struct kgsl_iommu_pt *iommu_pt = pt->priv;
+
+	/* The TLB may still hold translations of the old pagetable */
+	if (pt->mmu && pt->mmu->priv) {
+		struct kgsl_iommu *iommu = pt->mmu->priv;
+
+		if (iommu->tlb_pt == pt)
+			iommu->tlb_pt = NULL;
+	}
+
 	if (iommu_pt->domain)
 		msm_unregister_domain(iommu_pt->domain);
 
@@ -1237,11 +1246,32 @@ static int kgsl_iommu_setstate(struct kgsl_mmu *mmu,
 		 *  specified page table
 		 */
 		if (mmu->hwpagetable != pagetable) {
-			unsigned int flags = 0;
+			struct kgsl_iommu *iommu = mmu->priv;
+			unsigned int flags;
+
 			mmu->hwpagetable = pagetable;
-			flags |= kgsl_mmu_pt_get_flags(mmu->hwpagetable,
-							mmu->device->id) |
-							KGSL_MMUFLAGS_TLBFLUSH;
+
+			/* Set if the pagetable changed while it wasn't used */
+			flags = kgsl_mmu_pt_get_flags(pagetable,
+							mmu->device->id);
+
+			/*
+			 * The default pagetable only holds global mappings,
+			 * which are the same in every pagetable, and it is
+			 * only used for commands from the kernel, so the
+			 * translations left in the TLB don't matter.  Coming
+			 * back to the last per-process pagetable finds
+			 * nothing but its own and the global translations so
+			 * the flush can be skipped too.
+			 */
+			if (pagetable != mmu->defaultpagetable) {
+				if (iommu->tlb_pt != pagetable)
+					flags |= KGSL_MMUFLAGS_TLBFLUSH;
+				iommu->tlb_pt = pagetable;
+			} else if (flags & KGSL_MMUFLAGS_TLBFLUSH) {
+				iommu->tlb_pt = NULL;
+			}
+
 			ret = kgsl_setstate(mmu, context_id,
 				KGSL_MMUFLAGS_PTUPDATE | flags);
 		}
@@ -1724,7 +1754,18 @@ done:
 	return status;
 }
 
-static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt)
+/*
+ * kgsl_iommu_flush_tlb_pt_current - Flush the TLB after a change to a
+ * pagetable
+ * @pt: The pagetable that was changed
+ * @tlb_flags: The TLB flags of the pagetable
+ *
+ * If the pagetable is in use flush right away.  Otherwise only mark it so
+ * the next switch to it flushes, which covers all the changes made in the
+ * meantime with a single flush.
+ */
+static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt,
+		unsigned int *tlb_flags)
 {
 	int lock_taken = 0;
 	struct kgsl_device *device = pt->mmu->device;
@@ -1743,10 +1784,14 @@ static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt)
 	 * hasn't been switched yet
 	 */
 	if (kgsl_mmu_is_perprocess(pt->mmu) &&
-		iommu->iommu_units[0].dev[KGSL_IOMMU_CONTEXT_USER].attached &&
-		kgsl_iommu_pt_equal(pt->mmu, pt,
-		kgsl_iommu_get_current_ptbase(pt->mmu)))
-		kgsl_iommu_default_setstate(pt->mmu, KGSL_MMUFLAGS_TLBFLUSH);
+		iommu->iommu_units[0].dev[KGSL_IOMMU_CONTEXT_USER].attached) {
+		if (kgsl_iommu_pt_equal(pt->mmu, pt,
+			kgsl_iommu_get_current_ptbase(pt->mmu)))
+			kgsl_iommu_default_setstate(pt->mmu,
+				KGSL_MMUFLAGS_TLBFLUSH);
+		else
+			*tlb_flags = UINT_MAX;
+	}
 
 	if (lock_taken)
 		kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -1781,7 +1826,7 @@ kgsl_iommu_unmap(struct kgsl_pagetable *pt,
 		return ret;
 	}
 
-	kgsl_iommu_flush_tlb_pt_current(pt);
+	kgsl_iommu_flush_tlb_pt_current(pt, tlb_flags);
 
 	return ret;
 }
@@ -1838,7 +1883,7 @@ kgsl_iommu_map(struct kgsl_pagetable *pt,
 	 *  implement the invalidate+map.
 	 */
 	if (!msm_soc_version_supports_iommu_v0())
-		kgsl_iommu_flush_tlb_pt_current(pt);
+		kgsl_iommu_flush_tlb_pt_current(pt, tlb_flags);
 
 	return ret;
 }
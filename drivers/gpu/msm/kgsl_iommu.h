@@ -195,6 +195,9 @@ struct kgsl_iommu_unit {
  * @sync_lock_offset - The page offset within a page at which the sync
  * variables are located
  * @sync_lock_initialized: True if the sync_lock feature is enabled
+ * @tlb_pt: The last per-process pagetable that was switched to.  Since then
+ * the TLB can only hold translations of this pagetable and of the global
+ * mappings.  NULL if that isn't known and the next switch has to flush
  */
 struct kgsl_iommu {
 	struct kgsl_iommu_unit iommu_units[KGSL_IOMMU_MAX_UNITS];
@@ -206,6 +209,7 @@ struct kgsl_iommu {
 	struct kgsl_memdesc sync_lock_desc;
 	unsigned int sync_lock_offset;
 	bool sync_lock_initialized;
+	struct kgsl_pagetable *tlb_pt;
 };
 
 /*
@@ -289,6 +289,12 @@ static inline void kgsl_mmu_stop(struct kgsl_mmu *mmu)
 		mmu->mmu_ops->mmu_stop(mmu);
 }
 
+static inline void kgsl_mmu_pagefault_resume(struct kgsl_mmu *mmu)
+{
+	if (mmu->mmu_ops && mmu->mmu_ops->mmu_pagefault_resume)
+		mmu->mmu_ops->mmu_pagefault_resume(mmu);
+}
+
 static inline int kgsl_mmu_pt_equal(struct kgsl_mmu *mmu,
 			struct kgsl_pagetable *pt,
 			phys_addr_t pt_base)
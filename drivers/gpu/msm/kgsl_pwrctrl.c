@@ -87,9 +87,9 @@ static void kgsl_pwrctrl_pwrrail(struct kgsl_device *device, int state);
 
 static inline unsigned int _adjust_pwrlevel(struct kgsl_pwrctrl *pwr, int level)
 {
-	unsigned int max_pwrlevel = max_t(unsigned int, pwr->thermal_pwrlevel,
+	unsigned int max_pwrlevel = max_t(unsigned int, kgsl_pwrctrl_thermal_level(pwr),
 		pwr->max_pwrlevel);
-	unsigned int min_pwrlevel = max_t(unsigned int, pwr->thermal_pwrlevel,
+	unsigned int min_pwrlevel = max_t(unsigned int, kgsl_pwrctrl_thermal_level(pwr),
 		pwr->min_pwrlevel);
 
 	if (level < max_pwrlevel)
@@ -163,6 +163,39 @@ void kgsl_pwrctrl_pwrlevel_change(struct kgsl_device *device,
 
 EXPORT_SYMBOL(kgsl_pwrctrl_pwrlevel_change);
 
+/* GPU utilization over the last busy statistics window, in percent */
+static unsigned int kgsl_pwrctrl_budget_get_util(void *data)
+{
+	struct kgsl_device *device = data;
+	struct kgsl_clk_stats *stats = &device->pwrctrl.clk_stats;
+
+	if (!stats->total_old)
+		return 0;
+	return div_u64((u64)stats->busy_old * 100, stats->total_old);
+}
+
+/* Cap the GPU at @pct percent of its highest frequency */
+static void kgsl_pwrctrl_budget_set_limit(void *data, unsigned int pct)
+{
+	struct kgsl_device *device = data;
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	unsigned int max_freq, level, thermal_level;
+
+	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+
+	max_freq = div_u64((u64)pwr->pwrlevels[0].gpu_freq * pct, 100);
+	for (level = 0; level < pwr->num_pwrlevels - 2; level++)
+		if (pwr->pwrlevels[level].gpu_freq <= max_freq)
+			break;
+	pwr->budget_pwrlevel = level;
+
+	thermal_level = kgsl_pwrctrl_thermal_level(pwr);
+	if (thermal_level > pwr->active_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, thermal_level);
+
+	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+}
+
 static int kgsl_pwrctrl_thermal_pwrlevel_store(struct device *dev,
 					 struct device_attribute *attr,
 					 const char *buf, size_t count)
@@ -243,7 +276,7 @@ static int kgsl_pwrctrl_max_pwrlevel_store(struct device *dev,
 	pwr->max_pwrlevel = level;
 
 
-	max_level = max_t(unsigned int, pwr->thermal_pwrlevel,
+	max_level = max_t(unsigned int, kgsl_pwrctrl_thermal_level(pwr),
 		pwr->max_pwrlevel);
 
 	/*
@@ -297,7 +330,7 @@ static int kgsl_pwrctrl_min_pwrlevel_store(struct device *dev,
 
 	pwr->min_pwrlevel = level;
 
-	min_level = max_t(unsigned int, pwr->thermal_pwrlevel,
+	min_level = max_t(unsigned int, kgsl_pwrctrl_thermal_level(pwr),
 		pwr->min_pwrlevel);
 
 	/* Only move the power level higher if minimum is higher then the
@@ -979,6 +1012,7 @@ int kgsl_pwrctrl_init(struct kgsl_device *device)
 	pwr->max_pwrlevel = 0;
 	pwr->min_pwrlevel = pdata->num_levels - 2;
 	pwr->thermal_pwrlevel = 0;
+	pwr->budget_pwrlevel = 0;
 
 	pwr->active_pwrlevel = pdata->init_level;
 	pwr->default_pwrlevel = pdata->init_level;
@@ -1077,6 +1111,13 @@ int kgsl_pwrctrl_init(struct kgsl_device *device)
 	for (m = 0; m < pwr->num_pwrlevels - 1; m++)
 		printk("kgsl bus index is %d for pwrlevel %d\n", pwr->bus_index[m], m);
 
+	pwr->budget.name = device->name;
+	pwr->budget.get_util = kgsl_pwrctrl_budget_get_util;
+	pwr->budget.set_limit = kgsl_pwrctrl_budget_set_limit;
+	pwr->budget.data = device;
+	if (msm_thermal_budget_register(&pwr->budget))
+		pwr->budget.set_limit = NULL;
+
 	return result;
 
 clk_err:
@@ -1095,6 +1136,9 @@ void kgsl_pwrctrl_close(struct kgsl_device *device)
 
 	KGSL_PWR_INFO(device, "close device %d\n", device->id);
 
+	if (pwr->budget.set_limit)
+		msm_thermal_budget_unregister(&pwr->budget);
+
 	pm_runtime_disable(device->parentdev);
 
 	clk_put(pwr->ebi1_clk);
@@ -1183,6 +1227,53 @@ void kgsl_idle_check(struct work_struct *work)
 }
 EXPORT_SYMBOL(kgsl_idle_check);
 
+/**
+ * kgsl_early_wake() - Work function to wake the GPU ahead of a submission
+ * @work: The early_wake_ws work struct of the device
+ *
+ * Bring the device out of SLEEP or SLUMBER, which includes the regulator
+ * enable, the bus vote and the microcode start, and drop the reference right
+ * away.  The device is left ACTIVE with the idle timer running so the command
+ * that triggered the wake only has to turn the clocks back on if it loses the
+ * race with NAP.
+ */
+void kgsl_early_wake(struct work_struct *work)
+{
+	struct kgsl_device *device = container_of(work, struct kgsl_device,
+							early_wake_ws);
+
+	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+
+	/* Never race with suspend, the hwaccess gate has to stay closed */
+	if ((device->state == KGSL_STATE_SLUMBER ||
+		device->state == KGSL_STATE_SLEEP) &&
+		device->requested_state != KGSL_STATE_SUSPEND) {
+		if (kgsl_active_count_get(device) == 0)
+			kgsl_active_count_put(device);
+	}
+
+	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+}
+EXPORT_SYMBOL(kgsl_early_wake);
+
+/**
+ * kgsl_pwrctrl_early_wake() - Start waking the GPU from a submission ioctl
+ * @device: The device
+ *
+ * Called without the device mutex on entry to the command submission ioctls
+ * so the power up runs on the device workqueue while the caller is still
+ * copying and parsing the command batch.  The state check is only a hint,
+ * the work function checks again under the mutex.
+ */
+void kgsl_pwrctrl_early_wake(struct kgsl_device *device)
+{
+	unsigned int state = ACCESS_ONCE(device->state);
+
+	if (state == KGSL_STATE_SLUMBER || state == KGSL_STATE_SLEEP)
+		queue_work(device->work_queue, &device->early_wake_ws);
+}
+EXPORT_SYMBOL(kgsl_pwrctrl_early_wake);
+
 void kgsl_timer(unsigned long data)
 {
 	struct kgsl_device *device = (struct kgsl_device *) data;
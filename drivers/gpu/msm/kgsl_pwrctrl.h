@@ -13,6 +13,8 @@
 #ifndef __KGSL_PWRCTRL_H
 #define __KGSL_PWRCTRL_H
 
+#include <linux/msm_thermal.h>
+
 /*****************************************************************************
 ** power flags
 *****************************************************************************/
@@ -59,6 +61,7 @@ struct kgsl_pwr_constraint {
  * @pwrlevels - List of supported power levels
  * @active_pwrlevel - The currently active power level
  * @thermal_pwrlevel - maximum powerlevel constraint from thermal
+ * @budget_pwrlevel - maximum powerlevel from the shared CPU/GPU thermal budget
  * @default_pwrlevel - device wake up power level
  * @init_pwrlevel - device inital power level
  * @max_pwrlevel - maximum allowable powerlevel per the user
@@ -78,6 +81,7 @@ struct kgsl_pwr_constraint {
  * @bus_index - default bus index into the bus_ib table
  * @bus_ib - the set of unique ib requests needed for the bus calculation
  * @constraint - currently active power constraint
+ * @budget - client of the msm_thermal CPU/GPU budget
  */
 
 struct kgsl_pwrctrl {
@@ -89,6 +93,7 @@ struct kgsl_pwrctrl {
 	struct kgsl_pwrlevel pwrlevels[KGSL_MAX_PWRLEVELS];
 	unsigned int active_pwrlevel;
 	unsigned int thermal_pwrlevel;
+	unsigned int budget_pwrlevel;
 	unsigned int default_pwrlevel;
 	unsigned int init_pwrlevel;
 	unsigned int wakeup_maxpwrlevel;
@@ -111,6 +116,7 @@ struct kgsl_pwrctrl {
 	unsigned int bus_index[KGSL_MAX_PWRLEVELS];
 	uint64_t bus_ib[KGSL_MAX_PWRLEVELS];
 	struct kgsl_pwr_constraint constraint;
+	struct msm_thermal_budget_client budget;
 };
 
 void kgsl_pwrctrl_irq(struct kgsl_device *device, int state);
@@ -118,6 +124,8 @@ int kgsl_pwrctrl_init(struct kgsl_device *device);
 void kgsl_pwrctrl_close(struct kgsl_device *device);
 void kgsl_timer(unsigned long data);
 void kgsl_idle_check(struct work_struct *work);
+void kgsl_early_wake(struct work_struct *work);
+void kgsl_pwrctrl_early_wake(struct kgsl_device *device);
 void kgsl_pre_hwaccess(struct kgsl_device *device);
 int kgsl_pwrctrl_sleep(struct kgsl_device *device);
 int kgsl_pwrctrl_wake(struct kgsl_device *device, int priority);
@@ -131,6 +139,19 @@ void kgsl_pwrctrl_enable(struct kgsl_device *device);
 void kgsl_pwrctrl_disable(struct kgsl_device *device);
 bool kgsl_pwrctrl_isenabled(struct kgsl_device *device);
 
+/*
+ * kgsl_pwrctrl_thermal_level - get the effective thermal powerlevel limit
+ * @pwr: kgsl_pwrctrl structure for the device
+ *
+ * Returns the more restrictive of the userspace thermal limit and the
+ * limit from the shared thermal budget.
+ */
+static inline unsigned int
+kgsl_pwrctrl_thermal_level(struct kgsl_pwrctrl *pwr)
+{
+	return max(pwr->thermal_pwrlevel, pwr->budget_pwrlevel);
+}
+
 static inline unsigned long kgsl_get_clkrate(struct clk *clk)
 {
 	return (clk != NULL) ? clk_get_rate(clk) : 0;
@@ -13,6 +13,7 @@
 
 #include <linux/export.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
@@ -144,6 +145,53 @@ void kgsl_pwrscale_update(struct kgsl_device *device)
 }
 EXPORT_SYMBOL(kgsl_pwrscale_update);
 
+/*
+ * kgsl_pwrscale_deadline_busy - account GPU time spent on deadline work
+ * @device: The device
+ * @busy: GPU time in usecs
+ *
+ * Called for work from contexts which have a frame deadline. Lets the
+ * governor tell whether the deadlines describe all of the GPU load.
+ * This function must be called with the device mutex locked.
+ */
+void kgsl_pwrscale_deadline_busy(struct kgsl_device *device, u64 busy)
+{
+	BUG_ON(!mutex_is_locked(&device->mutex));
+
+	device->pwrscale.frame_busy += busy;
+}
+EXPORT_SYMBOL(kgsl_pwrscale_deadline_busy);
+
+/*
+ * kgsl_pwrscale_frame_done - report a finished frame with a deadline
+ * @device: The device
+ * @busy: GPU time the frame took in usecs
+ * @target: GPU time the frame was allowed in usecs
+ *
+ * Scale the current frequency by how far the frame was from its target,
+ * leaving KGSL_FRAME_HEADROOM percent of the target spare. The highest
+ * frequency asked for since the last get_dev_status call is passed on to the
+ * governor. This function must be called with the device mutex locked.
+ */
+void kgsl_pwrscale_frame_done(struct kgsl_device *device, u64 busy,
+		unsigned int target)
+{
+	struct kgsl_pwrscale *psc = &device->pwrscale;
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	u64 freq;
+
+	BUG_ON(!mutex_is_locked(&device->mutex));
+
+	if (!psc->enabled || !target)
+		return;
+
+	freq = div64_u64((u64) kgsl_pwrctrl_active_freq(pwr) * busy * 100,
+			(u64) target * (100 - KGSL_FRAME_HEADROOM));
+	freq = min_t(u64, freq, pwr->pwrlevels[0].gpu_freq);
+	psc->frame_freq = max_t(unsigned long, psc->frame_freq, freq);
+}
+EXPORT_SYMBOL(kgsl_pwrscale_frame_done);
+
 /*
  * kgsl_pwrscale_disable - temporarily disable the governor
  * @device: The device
@@ -312,7 +360,11 @@ int kgsl_devfreq_get_dev_status(struct device *dev,
 		b->ram_time = device->pwrscale.accum_stats.ram_time;
 		b->ram_wait = device->pwrscale.accum_stats.ram_wait;
 		b->mod = device->pwrctrl.bus_mod;
+		b->frame_freq = pwrscale->frame_freq;
+		b->frame_busy = pwrscale->frame_busy;
 	}
+	pwrscale->frame_freq = 0;
+	pwrscale->frame_busy = 0;
 
 	kgsl_pwrctrl_busy_time(device, stat->total_time, stat->busy_time);
 	trace_kgsl_pwrstats(device, stat->total_time, &pwrscale->accum_stats);
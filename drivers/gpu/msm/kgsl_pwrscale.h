@@ -20,6 +20,9 @@
 /* devfreq governor call window in usec */
 #define KGSL_GOVERNOR_CALL_INTERVAL 10000
 
+/* Percentage of a frame deadline kept spare when picking a frequency */
+#define KGSL_FRAME_HEADROOM 10
+
 struct kgsl_power_stats {
 	u64 busy_time;
 	u64 ram_time;
@@ -41,6 +44,8 @@ struct kgsl_pwrscale {
 	struct work_struct devfreq_resume_ws;
 	struct work_struct devfreq_notify_ws;
 	ktime_t next_governor_call;
+	unsigned long frame_freq;
+	u64 frame_busy;
 };
 
 int kgsl_pwrscale_init(struct device *dev, const char *governor);
@@ -51,6 +56,9 @@ void kgsl_pwrscale_update_stats(struct kgsl_device *device);
 void kgsl_pwrscale_busy(struct kgsl_device *device);
 void kgsl_pwrscale_sleep(struct kgsl_device *device);
 void kgsl_pwrscale_wake(struct kgsl_device *device);
+void kgsl_pwrscale_deadline_busy(struct kgsl_device *device, u64 busy);
+void kgsl_pwrscale_frame_done(struct kgsl_device *device, u64 busy,
+		unsigned int target);
 
 void kgsl_pwrscale_enable(struct kgsl_device *device);
 void kgsl_pwrscale_disable(struct kgsl_device *device);
@@ -17,6 +17,7 @@
 #include <linux/slab.h>
 #include <linux/kmemleak.h>
 #include <linux/highmem.h>
+#include <linux/alloc_bench.h>
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
@@ -101,6 +102,22 @@ mem_entry_show(struct kgsl_process_private *priv, int type, char *buf)
 	return snprintf(buf, PAGE_SIZE, "%d\n", priv->stats[type].cur);
 }
 
+/**
+ * Show the current amount of memory allocated for all memtypes
+ */
+
+static ssize_t
+mem_entry_total_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < KGSL_MEM_ENTRY_MAX; i++)
+		total += priv->stats[i].cur;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", total);
+}
+
 /**
  * Show the maximum memory allocated for the given memtype through the life of
  * the process
@@ -158,6 +175,9 @@ static struct mem_entry_stats mem_stats[] = {
 #endif
 };
 
+static struct kgsl_mem_entry_attribute mem_total_attr =
+	__MEM_ENTRY_ATTR(KGSL_MEM_ENTRY_MAX, total, mem_entry_total_show);
+
 void
 kgsl_process_uninit_sysfs(struct kgsl_process_private *private)
 {
@@ -168,6 +188,7 @@ kgsl_process_uninit_sysfs(struct kgsl_process_private *private)
 		sysfs_remove_file(&private->kobj,
 			&mem_stats[i].max_attr.attr);
 	}
+	sysfs_remove_file(&private->kobj, &mem_total_attr.attr);
 
 	kobject_put(&private->kobj);
 }
@@ -208,6 +229,7 @@ kgsl_process_init_sysfs(struct kgsl_device *device,
 		ret = sysfs_create_file(&private->kobj,
 			&mem_stats[i].max_attr.attr);
 	}
+	ret = sysfs_create_file(&private->kobj, &mem_total_attr.attr);
 	return ret;
 }
 
@@ -217,22 +239,28 @@ static int kgsl_drv_memstat_show(struct device *dev,
 {
 	unsigned int val = 0;
 
-	if (!strncmp(attr->attr.name, "vmalloc", 7))
+	if (!strcmp(attr->attr.name, "vmalloc"))
 		val = atomic_read(&kgsl_driver.stats.vmalloc);
-	else if (!strncmp(attr->attr.name, "vmalloc_max", 11))
+	else if (!strcmp(attr->attr.name, "vmalloc_max"))
 		val = atomic_read(&kgsl_driver.stats.vmalloc_max);
-	else if (!strncmp(attr->attr.name, "page_alloc", 10))
+	else if (!strcmp(attr->attr.name, "page_alloc"))
 		val = atomic_read(&kgsl_driver.stats.page_alloc);
-	else if (!strncmp(attr->attr.name, "page_alloc_max", 14))
+	else if (!strcmp(attr->attr.name, "page_alloc_max"))
 		val = atomic_read(&kgsl_driver.stats.page_alloc_max);
-	else if (!strncmp(attr->attr.name, "coherent", 8))
+	else if (!strcmp(attr->attr.name, "coherent"))
 		val = atomic_read(&kgsl_driver.stats.coherent);
-	else if (!strncmp(attr->attr.name, "coherent_max", 12))
+	else if (!strcmp(attr->attr.name, "coherent_max"))
 		val = atomic_read(&kgsl_driver.stats.coherent_max);
-	else if (!strncmp(attr->attr.name, "mapped", 6))
+	else if (!strcmp(attr->attr.name, "mapped"))
 		val = atomic_read(&kgsl_driver.stats.mapped);
-	else if (!strncmp(attr->attr.name, "mapped_max", 10))
+	else if (!strcmp(attr->attr.name, "mapped_max"))
 		val = atomic_read(&kgsl_driver.stats.mapped_max);
+	else if (!strcmp(attr->attr.name, "page_pool"))
+		val = atomic_read(&kgsl_driver.stats.page_pool);
+	else if (!strcmp(attr->attr.name, "page_pool_hits"))
+		val = atomic_read(&kgsl_driver.stats.page_pool_hits);
+	else if (!strcmp(attr->attr.name, "page_pool_misses"))
+		val = atomic_read(&kgsl_driver.stats.page_pool_misses);
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -268,6 +296,9 @@ DEVICE_ATTR(coherent, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(coherent_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(page_pool, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(page_pool_hits, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(page_pool_misses, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(full_cache_threshold, 0644,
 		kgsl_drv_full_cache_threshold_show,
 		kgsl_drv_full_cache_threshold_store);
@@ -281,19 +312,58 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_coherent_max,
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
+	&dev_attr_page_pool,
+	&dev_attr_page_pool_hits,
+	&dev_attr_page_pool_misses,
 	&dev_attr_full_cache_threshold,
 	NULL
 };
 
+static int kgsl_bench_alloc(void *priv, size_t size, unsigned long *cookie)
+{
+	struct kgsl_memdesc *memdesc;
+	int ret;
+
+	memdesc = kzalloc(sizeof(*memdesc), GFP_KERNEL);
+	if (memdesc == NULL)
+		return -ENOMEM;
+
+	/* Only the pages, the allocation isn't mapped to a GPU pagetable */
+	ret = kgsl_sharedmem_page_alloc_user(memdesc, NULL, size);
+	if (ret) {
+		kfree(memdesc);
+		return ret;
+	}
+
+	*cookie = (unsigned long) memdesc;
+	return 0;
+}
+
+static void kgsl_bench_free(void *priv, unsigned long cookie)
+{
+	struct kgsl_memdesc *memdesc = (struct kgsl_memdesc *) cookie;
+
+	kgsl_sharedmem_free(memdesc);
+	kfree(memdesc);
+}
+
+static struct alloc_bench_ops kgsl_bench_ops = {
+	.name = "kgsl_sharedmem",
+	.alloc = kgsl_bench_alloc,
+	.free = kgsl_bench_free,
+};
+
 void
 kgsl_sharedmem_uninit_sysfs(void)
 {
+	alloc_bench_unregister(&kgsl_bench_ops);
 	kgsl_remove_device_sysfs_files(&kgsl_driver.virtdev, drv_attr_list);
 }
 
 int
 kgsl_sharedmem_init_sysfs(void)
 {
+	alloc_bench_register(&kgsl_bench_ops);
 	return kgsl_create_device_sysfs_files(&kgsl_driver.virtdev,
 		drv_attr_list);
 }
@@ -404,6 +474,10 @@ static int kgsl_page_alloc_map_kernel(struct kgsl_memdesc *memdesc)
 {
 	int ret = 0;
 
+	/* Nothing to map until the pages have been allocated */
+	if (kgsl_memdesc_is_lazy(memdesc))
+		return -ENOMEM;
+
 	mutex_lock(&kernel_map_global_lock);
 	if (!memdesc->hostptr) {
 		pgprot_t page_prot = pgprot_writecombine(PAGE_KERNEL);
@@ -524,30 +598,25 @@ void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
 }
 EXPORT_SYMBOL(kgsl_cache_range_op);
 
-static int
-_kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
-			struct kgsl_pagetable *pagetable,
-			size_t size)
+/*
+ * kgsl_page_alloc_fill() - Allocate the backing pages for a memdesc
+ * @memdesc: The memory descriptor to fill
+ * @size: Size of the allocation, already page aligned
+ *
+ * On failure memdesc->sglen and memdesc->size describe the part that was
+ * allocated so that it can be released again.
+ */
+static int kgsl_page_alloc_fill(struct kgsl_memdesc *memdesc, size_t size)
 {
 	int ret = 0;
 	int page_size, sglen_alloc, sglen = 0;
 	size_t len;
 	unsigned int align;
 
-	size = PAGE_ALIGN(size);
-	if (size == 0 || size > UINT_MAX)
-		return -EINVAL;
-
 	align = (memdesc->flags & KGSL_MEMALIGN_MASK) >> KGSL_MEMALIGN_SHIFT;
 
 	page_size = (align >= ilog2(SZ_64K) && size >= SZ_64K)
 			? SZ_64K : PAGE_SIZE;
-	/*
-	 * The alignment cannot be less than the intended page size - it can be
-	 * larger however to accomodate hardware quirks
-	 */
-	if (ilog2(align) < page_size)
-		kgsl_memdesc_set_align(memdesc, ilog2(page_size));
 
 	/*
 	 * There needs to be enough room in the sg structure to be able to
@@ -555,9 +624,6 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	 */
 	sglen_alloc = PAGE_ALIGN(size) >> PAGE_SHIFT;
 
-	memdesc->pagetable = pagetable;
-	memdesc->ops = &kgsl_page_alloc_ops;
-
 	memdesc->sglen_alloc = sglen_alloc;
 	memdesc->sg = kgsl_sg_alloc(memdesc->sglen_alloc);
 
@@ -616,12 +682,94 @@ done:
 	KGSL_STATS_ADD(memdesc->size, &kgsl_driver.stats.page_alloc,
 		&kgsl_driver.stats.page_alloc_max);
 
+	return ret;
+}
+
+static int
+_kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
+			struct kgsl_pagetable *pagetable,
+			size_t size)
+{
+	int ret;
+	int page_size;
+	unsigned int align;
+
+	size = PAGE_ALIGN(size);
+	if (size == 0 || size > UINT_MAX)
+		return -EINVAL;
+
+	align = (memdesc->flags & KGSL_MEMALIGN_MASK) >> KGSL_MEMALIGN_SHIFT;
+
+	page_size = (align >= ilog2(SZ_64K) && size >= SZ_64K)
+			? SZ_64K : PAGE_SIZE;
+	/*
+	 * The alignment cannot be less than the intended page size - it can be
+	 * larger however to accomodate hardware quirks
+	 */
+	if (ilog2(align) < page_size)
+		kgsl_memdesc_set_align(memdesc, ilog2(page_size));
+
+	memdesc->pagetable = pagetable;
+	memdesc->ops = &kgsl_page_alloc_ops;
+
+	/*
+	 * Lazy allocations only get their size here so that a GPU address
+	 * range can be reserved. The pages are allocated and mapped by
+	 * kgsl_sharedmem_populate() on first use.
+	 */
+	if (memdesc->flags & KGSL_MEMFLAGS_LAZY) {
+		memdesc->size = size;
+		memdesc->priv |= KGSL_MEMDESC_LAZY;
+		return 0;
+	}
+
+	ret = kgsl_page_alloc_fill(memdesc, size);
 	if (ret)
 		kgsl_sharedmem_free(memdesc);
 
 	return ret;
 }
 
+/**
+ * kgsl_sharedmem_populate() - Allocate and map the pages of a lazy memdesc
+ * @memdesc: The memory descriptor created with KGSL_MEMFLAGS_LAZY
+ *
+ * Allocate the backing pages of a memdesc that so far only has a GPU
+ * address reserved and map them into its pagetable. On failure the memdesc
+ * is left unpopulated so the caller may try again later. The caller is
+ * responsible for serializing calls for the same memdesc.
+ *
+ * Return: 0 on success else error code
+ */
+int kgsl_sharedmem_populate(struct kgsl_memdesc *memdesc)
+{
+	unsigned int size = memdesc->size;
+	int ret;
+
+	if (!kgsl_memdesc_is_lazy(memdesc))
+		return 0;
+
+	ret = kgsl_page_alloc_fill(memdesc, size);
+	if (!ret)
+		ret = kgsl_mmu_map(memdesc->pagetable, memdesc);
+
+	if (ret) {
+		kgsl_page_alloc_free(memdesc);
+		kgsl_sg_free(memdesc->sg, memdesc->sglen_alloc);
+		memdesc->sg = NULL;
+		memdesc->sglen = 0;
+		memdesc->sglen_alloc = 0;
+		memdesc->size = size;
+		return ret;
+	}
+
+	/* Make the pages visible before the memdesc is marked populated */
+	smp_wmb();
+	memdesc->priv &= ~KGSL_MEMDESC_LAZY;
+	return 0;
+}
+EXPORT_SYMBOL(kgsl_sharedmem_populate);
+
 int
 kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 			    struct kgsl_pagetable *pagetable,
@@ -36,6 +36,8 @@ int kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 				struct kgsl_pagetable *pagetable,
 				size_t size);
 
+int kgsl_sharedmem_populate(struct kgsl_memdesc *memdesc);
+
 int kgsl_cma_alloc_coherent(struct kgsl_device *device,
 			struct kgsl_memdesc *memdesc,
 			struct kgsl_pagetable *pagetable, size_t size);
@@ -178,6 +180,17 @@ static inline int kgsl_memdesc_is_global(const struct kgsl_memdesc *memdesc)
 	return (memdesc->priv & KGSL_MEMDESC_GLOBAL) != 0;
 }
 
+/*
+ * kgsl_memdesc_is_lazy - are the pages still to be allocated?
+ * @memdesc: the memdesc
+ *
+ * Returns nonzero if kgsl_sharedmem_populate() has yet to be called
+ */
+static inline int kgsl_memdesc_is_lazy(const struct kgsl_memdesc *memdesc)
+{
+	return (memdesc->priv & KGSL_MEMDESC_LAZY) != 0;
+}
+
 /*
  * kgsl_memdesc_has_guard_page - is the last page a guard page?
  * @memdesc - the memdesc
@@ -257,6 +270,8 @@ kgsl_allocate_user(struct kgsl_device *device,
 	memdesc->flags = flags;
 
 	if (kgsl_mmu_get_mmutype() == KGSL_MMU_TYPE_NONE) {
+		/* Contiguous memory can't be populated later */
+		memdesc->flags &= ~KGSL_MEMFLAGS_LAZY;
 		size = ALIGN(size, PAGE_SIZE);
 		ret = kgsl_cma_alloc_coherent(device, memdesc, pagetable, size);
 	}
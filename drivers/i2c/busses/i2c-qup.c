@@ -191,6 +191,7 @@ struct qup_i2c_dev {
 	int                          out_blk_sz;
 	int                          in_blk_sz;
 	int                          wr_sz;
+	bool                         rd_blk;
 	struct msm_i2c_platform_data *pdata;
 	enum msm_i2c_state           pwr_state;
 	atomic_t		     xfer_progress;
@@ -204,6 +205,32 @@ struct qup_i2c_dev {
 static int i2c_qup_pm_resume_runtime(struct device *device);
 #endif
 
+/*
+ * Copy the received bytes from the input FIFO to the current read message.
+ * Each FIFO word carries two bytes. Returns the number of bytes copied.
+ */
+static int qup_read_in_fifo(struct qup_i2c_dev *dev)
+{
+	struct i2c_msg *msg = dev->msg;
+	uint32_t dval = 0;
+	int i;
+
+	for (i = 0; dev->pos < msg->len; i++, dev->pos++) {
+		if (i % 2 == 0) {
+			uint32_t rd_status = readl_relaxed(dev->base +
+							QUP_OPERATIONAL);
+
+			if ((rd_status & QUP_IN_NOT_EMPTY) == 0)
+				break;
+			dval = readl_relaxed(dev->base + QUP_IN_FIFO_BASE);
+			msg->buf[dev->pos] = dval & 0xFF;
+		} else
+			msg->buf[dev->pos] = (dval & 0xFF0000) >> 16;
+	}
+	dev->cnt -= i;
+	return i;
+}
+
 #ifdef DEBUG
 static void
 qup_print_status(struct qup_i2c_dev *dev)
@@ -295,6 +322,17 @@ qup_i2c_interrupt(int irq, void *devid)
 			 * exits
 			 */
 			mb();
+			/*
+			 * In block mode empty every input block here and only
+			 * wake up the transfer once the whole read arrived,
+			 * rather than once per block.
+			 */
+			if (dev->rd_blk) {
+				qup_read_in_fifo(dev);
+				if (dev->cnt > 0 &&
+					!(op_flgs & QUP_MX_INPUT_DONE))
+					return IRQ_HANDLED;
+			}
 		} else
 			return IRQ_HANDLED;
 	}
@@ -845,10 +883,12 @@ qup_set_read_mode(struct qup_i2c_dev *dev, int rd_len)
 		writel_relaxed(wr_mode | QUP_PACK_EN | QUP_UNPACK_EN,
 			dev->base + QUP_IO_MODE);
 		writel_relaxed(rd_len, dev->base + QUP_MX_READ_CNT);
+		dev->rd_blk = false;
 	} else {
 		writel_relaxed(wr_mode | QUP_RD_BLK_MODE |
 			QUP_PACK_EN | QUP_UNPACK_EN, dev->base + QUP_IO_MODE);
 		writel_relaxed(rd_len, dev->base + QUP_MX_INPUT_CNT);
+		dev->rd_blk = true;
 	}
 }
 
@@ -1071,6 +1111,7 @@ qup_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 		dev->msg = msgs;
 
 		dev->wr_sz = dev->out_fifo_sz;
+		dev->rd_blk = false;
 		dev->err = 0;
 		dev->complete = &complete;
 
@@ -1224,29 +1265,9 @@ timeout_err:
 				ret = -dev->err;
 				goto out_err;
 			}
-			if (dev->msg->flags & I2C_M_RD) {
-				int i;
-				uint32_t dval = 0;
-				for (i = 0; dev->pos < dev->msg->len; i++,
-						dev->pos++) {
-					uint32_t rd_status =
-						readl_relaxed(dev->base
-							+ QUP_OPERATIONAL);
-					if (i % 2 == 0) {
-						if ((rd_status &
-							QUP_IN_NOT_EMPTY) == 0)
-							break;
-						dval = readl_relaxed(dev->base +
-							QUP_IN_FIFO_BASE);
-						dev->msg->buf[dev->pos] =
-							dval & 0xFF;
-					} else
-						dev->msg->buf[dev->pos] =
-							((dval & 0xFF0000) >>
-							 16);
-				}
-				dev->cnt -= i;
-			} else
+			if (dev->msg->flags & I2C_M_RD)
+				qup_read_in_fifo(dev);
+			else
 				filled = false; /* refill output FIFO */
 			dev_dbg(dev->dev, "pos:%d, len:%d, cnt:%d\n",
 					dev->pos, msgs->len, dev->cnt);
@@ -1288,6 +1309,7 @@ timeout_err:
 	}
 	dev->complete = NULL;
 	dev->msg = NULL;
+	dev->rd_blk = false;
 	dev->pos = 0;
 	dev->err = 0;
 	dev->cnt = 0;
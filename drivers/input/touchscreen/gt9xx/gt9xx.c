@@ -51,6 +51,9 @@
 #include <linux/module.h>
 #include <linux/input/mt.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cpufreq.h>
+#include <linux/sched.h>
 
 #define GOODIX_DEV_NAME	"Goodix-CTP"
 #define CFG_MAX_TOUCH_POINTS	5
@@ -116,6 +119,7 @@ struct i2c_client  *i2c_connect_client;
 #define GTP_DEBUGFS_FILE_SUSPEND	"suspend"
 #define GTP_DEBUGFS_FILE_DATA		"data"
 #define GTP_DEBUGFS_FILE_ADDR		"addr"
+#define GTP_DEBUGFS_FILE_LATENCY	"latency"
 
 /*******************************************************
 Function:
@@ -376,15 +380,32 @@ static void gtp_touch_up(struct goodix_ts_data *ts, int id)
 
 
 
+static void gtp_record_latency(struct goodix_ts_data *ts, ktime_t read)
+{
+	struct goodix_lat_record *rec;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ts->lat_lock, flags);
+	rec = &ts->lat[ts->lat_first];
+	rec->irq = ts->irq_time;
+	rec->read = read;
+	rec->sync = ktime_get();
+	ts->lat_first = (ts->lat_first + 1) % GTP_LAT_ENTRY;
+	if (ts->lat_cnt < GTP_LAT_ENTRY)
+		ts->lat_cnt++;
+	spin_unlock_irqrestore(&ts->lat_lock, flags);
+}
+
 /*******************************************************
 Function:
-	Goodix touchscreen work function
+	Goodix touchscreen report function, runs in the
+	interrupt thread.
 Input:
-	work: work struct of goodix_workqueue
+	ts: private data.
 Output:
 	None.
 *********************************************************/
-static void goodix_ts_work_func(struct work_struct *work)
+static void goodix_ts_report(struct goodix_ts_data *ts)
 {
 	u8 end_cmd[3] = { GTP_READ_COOR_ADDR >> 8,
 			GTP_READ_COOR_ADDR & 0xFF, 0};
@@ -404,10 +425,9 @@ static void goodix_ts_work_func(struct work_struct *work)
 	s32 id = 0;
 	s32 i = 0;
 	int ret = -1;
-	struct goodix_ts_data *ts = NULL;
 	u8 doze_buf[3] = {0x81, 0x4B};
+	ktime_t read;
 
-	ts = container_of(work, struct goodix_ts_data, work);
 #ifdef CONFIG_GT9XX_TOUCHPANEL_UPDATE
 	if (ts->enter_update)
 		return;
@@ -490,7 +510,8 @@ static void goodix_ts_work_func(struct work_struct *work)
 				2 + 8 * (touch_num - 1));
 		memcpy(&point_data[12], &buf[2], 8 * (touch_num - 1));
 	}
-
+	read = ktime_get();
+	input_set_timestamp(ts->input_dev, ts->irq_time);
 
 	key_value = point_data[3 + 8 * touch_num];
 
@@ -584,6 +605,7 @@ static void goodix_ts_work_func(struct work_struct *work)
 		}
 	}
 	input_sync(ts->input_dev);
+	gtp_record_latency(ts, read);
 
 exit_work_func:
 	if (!ts->gtp_rawdiff_mode) {
@@ -601,6 +623,54 @@ exit_work_func:
 /*******************************************************
 Function:
 	External interrupt service routine for interrupt mode.
+	Stamps the interrupt and starts the CPU boost before
+	the report is read by the interrupt thread.
+Input:
+	irq:  interrupt number.
+	dev_id: private data pointer
+Output:
+	Handle Result.
+	IRQ_WAKE_THREAD: run the interrupt thread
+*********************************************************/
+static irqreturn_t goodix_ts_hardirq(int irq, void *dev_id)
+{
+	struct goodix_ts_data *ts = dev_id;
+
+	ts->irq_time = ktime_get();
+	cpu_boost_input_irq();
+
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * Move the interrupt thread to the priority and CPU from the device tree.
+ * Has to run in the thread itself, the irq core does not expose it. The
+ * thread follows the irq again if its smp_affinity is changed later.
+ */
+static void gtp_irq_thread_setup(struct goodix_ts_data *ts)
+{
+	struct sched_param param = {
+		.sched_priority = ts->pdata->irq_thread_prio,
+	};
+	int cpu = ts->pdata->irq_cpu;
+
+	ts->irq_thread_setup = true;
+
+	if (param.sched_priority &&
+	    sched_setscheduler(current, SCHED_FIFO, &param))
+		dev_err(&ts->client->dev,
+			"Unable to set irq thread priority %d\n",
+			param.sched_priority);
+
+	if (cpu >= 0 && cpu_online(cpu) &&
+	    set_cpus_allowed_ptr(current, cpumask_of(cpu)))
+		dev_err(&ts->client->dev,
+			"Unable to move irq thread to cpu %d\n", cpu);
+}
+
+/*******************************************************
+Function:
+	Interrupt thread, reads and reports the touch data.
 Input:
 	irq:  interrupt number.
 	dev_id: private data pointer
@@ -612,9 +682,12 @@ static irqreturn_t goodix_ts_irq_handler(int irq, void *dev_id)
 {
 	struct goodix_ts_data *ts = dev_id;
 
+	if (!ts->irq_thread_setup)
+		gtp_irq_thread_setup(ts);
+
 	gtp_irq_disable(ts);
 
-	queue_work(ts->goodix_wq, &ts->work);
+	goodix_ts_report(ts);
 
 	return IRQ_HANDLED;
 }
@@ -1179,15 +1252,19 @@ static int gtp_request_irq(struct goodix_ts_data *ts)
 	int ret = 0;
 	const u8 irq_table[] = GTP_IRQ_TAB;
 
-	ret = request_threaded_irq(ts->client->irq, NULL,
+	spin_lock_init(&ts->lat_lock);
+	ret = request_threaded_irq(ts->client->irq, goodix_ts_hardirq,
 			goodix_ts_irq_handler,
-			irq_table[ts->int_trigger_type],
+			irq_table[ts->int_trigger_type] | IRQF_ONESHOT,
 			ts->client->name, ts);
 	if (ret) {
 		ts->use_irq = false;
 		return ret;
 	} else {
 		gtp_irq_disable(ts);
+		if (ts->pdata->irq_cpu >= 0)
+			irq_set_affinity_hint(ts->client->irq,
+				cpumask_of(ts->pdata->irq_cpu));
 		ts->use_irq = true;
 		return ret;
 	}
@@ -1730,6 +1807,41 @@ static int gtp_debug_suspend_get(void *_data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(debug_suspend_fops, gtp_debug_suspend_get,
 			gtp_debug_suspend_set, "%lld\n");
 
+static int gtp_debug_latency_show(struct seq_file *s, void *unused)
+{
+	struct goodix_ts_data *ts = s->private;
+	struct goodix_lat_record *rec;
+	unsigned long flags;
+	int i, n;
+
+	seq_puts(s, "irq(us) read sync (us from irq)\n");
+
+	spin_lock_irqsave(&ts->lat_lock, flags);
+	i = (ts->lat_first + GTP_LAT_ENTRY - ts->lat_cnt) % GTP_LAT_ENTRY;
+	for (n = 0; n < ts->lat_cnt; n++) {
+		rec = &ts->lat[i];
+		seq_printf(s, "%lld %lld %lld\n", ktime_to_us(rec->irq),
+			ktime_us_delta(rec->read, rec->irq),
+			ktime_us_delta(rec->sync, rec->irq));
+		i = (i + 1) % GTP_LAT_ENTRY;
+	}
+	spin_unlock_irqrestore(&ts->lat_lock, flags);
+
+	return 0;
+}
+
+static int gtp_debug_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gtp_debug_latency_show, inode->i_private);
+}
+
+static const struct file_operations debug_latency_fops = {
+	.open = gtp_debug_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int gtp_debugfs_init(struct goodix_ts_data *data)
 {
 	data->debug_base = debugfs_create_dir(GTP_DEBUGFS_DIR, NULL);
@@ -1769,6 +1881,16 @@ static int gtp_debugfs_init(struct goodix_ts_data *data)
 		return -EINVAL;
 	}
 
+	if ((IS_ERR_OR_NULL(debugfs_create_file(GTP_DEBUGFS_FILE_LATENCY,
+					S_IRUSR | S_IRGRP,
+					data->debug_base,
+					data,
+					&debug_latency_fops)))) {
+		dev_err(&data->client->dev, "Failed to create latency file.\n");
+		debugfs_remove_recursive(data->debug_base);
+		return -EINVAL;
+	}
+
 	return 0;
 }
 
@@ -1857,6 +1979,27 @@ static int goodix_parse_dt(struct device *dev,
 	pdata->dbl_clk_wakeup = of_property_read_bool(np,
 						"goodix,dbl_clk_wakeup");
 
+	rc = of_property_read_u32(np, "goodix,irq-thread-prio", &temp_val);
+	if (!rc) {
+		if (temp_val >= MAX_USER_RT_PRIO)
+			return -EINVAL;
+		pdata->irq_thread_prio = temp_val;
+	} else if (rc != -EINVAL) {
+		dev_err(dev, "Unable to read irq thread priority\n");
+		return rc;
+	}
+
+	pdata->irq_cpu = -1;
+	rc = of_property_read_u32(np, "goodix,irq-cpu", &temp_val);
+	if (!rc) {
+		if (temp_val >= nr_cpu_ids)
+			return -EINVAL;
+		pdata->irq_cpu = temp_val;
+	} else if (rc != -EINVAL) {
+		dev_err(dev, "Unable to read irq cpu\n");
+		return rc;
+	}
+
 	/* reset, irq gpio info */
 	pdata->reset_gpio = of_get_named_gpio_flags(np, "reset-gpios",
 				0, &pdata->reset_gpio_flags);
@@ -2066,9 +2209,6 @@ static int goodix_ts_probe(struct i2c_client *client,
 	register_early_suspend(&ts->early_suspend);
 #endif
 
-	ts->goodix_wq = create_singlethread_workqueue("goodix_wq");
-	INIT_WORK(&ts->work, goodix_ts_work_func);
-
 	ret = gtp_request_irq(ts);
 	if (ret)
 		dev_info(&client->dev, "GTP request irq failed %d.\n", ret);
@@ -2118,11 +2258,10 @@ exit_free_irq:
 #elif defined(CONFIG_HAS_EARLYSUSPEND)
 	unregister_early_suspend(&ts->early_suspend);
 #endif
-	if (ts->use_irq)
+	if (ts->use_irq) {
+		irq_set_affinity_hint(client->irq, NULL);
 		free_irq(client->irq, ts);
-	cancel_work_sync(&ts->work);
-	flush_workqueue(ts->goodix_wq);
-	destroy_workqueue(ts->goodix_wq);
+	}
 
 	input_unregister_device(ts->input_dev);
 	if (ts->input_dev) {
@@ -2181,12 +2320,10 @@ static int goodix_ts_remove(struct i2c_client *client)
 #endif
 
 	if (ts) {
-		if (ts->use_irq)
+		if (ts->use_irq) {
+			irq_set_affinity_hint(client->irq, NULL);
 			free_irq(client->irq, ts);
-
-		cancel_work_sync(&ts->work);
-		flush_workqueue(ts->goodix_wq);
-		destroy_workqueue(ts->goodix_wq);
+		}
 
 		input_unregister_device(ts->input_dev);
 		if (ts->input_dev) {
@@ -69,15 +69,25 @@ struct goodix_ts_platform_data {
 	bool with_pen;
 	bool slide_wakeup;
 	bool dbl_clk_wakeup;
+	u32 irq_thread_prio;
+	int irq_cpu;
 };
+
+#define GTP_LAT_ENTRY		64
+
+/* timestamps of a touch report, from the interrupt to the input core */
+struct goodix_lat_record {
+	ktime_t irq;
+	ktime_t read;
+	ktime_t sync;
+};
+
 struct goodix_ts_data {
 	spinlock_t irq_lock;
 	struct i2c_client *client;
 	struct input_dev  *input_dev;
 	struct goodix_ts_platform_data *pdata;
 	struct hrtimer timer;
-	struct workqueue_struct *goodix_wq;
-	struct work_struct	work;
 	char fw_name[GTP_FW_NAME_MAXSIZE];
 	struct delayed_work goodix_update_work;
 	s32 irq_is_disabled;
@@ -110,6 +120,12 @@ struct goodix_ts_data {
 	struct early_suspend early_suspend;
 #endif
 	struct dentry *debug_base;
+	bool irq_thread_setup;
+	ktime_t irq_time;
+	spinlock_t lat_lock;
+	struct goodix_lat_record lat[GTP_LAT_ENTRY];
+	int lat_first;
+	int lat_cnt;
 };
 
 extern u16 show_len;
@@ -36,6 +36,11 @@
 #include <mach/msm_bus.h>
 #include "msm_iommu_pagetable.h"
 
+static unsigned int lazy_unmap_batch = 32;
+module_param(lazy_unmap_batch, uint, 0644);
+MODULE_PARM_DESC(lazy_unmap_batch,
+	"Unmaps per TLB invalidation in MSM_IOMMU_DOMAIN_LAZY_UNMAP domains");
+
 /* bitmap of the page sizes currently supported */
 #define MSM_IOMMU_PGSIZES	(SZ_4K | SZ_64K | SZ_1M | SZ_16M)
 
@@ -345,6 +350,22 @@ fail:
 	return ret;
 }
 
+/*
+ * Returns true if the TLB invalidation of an unmap in a lazy domain can
+ * wait. The stale entries only matter until the IOVAs are mapped again and
+ * every map invalidates the VAs it maps. A freed second level table must
+ * not stay in the walk caches though, so that always invalidates.
+ */
+static bool __defer_unmap_flush(struct msm_iommu_priv *priv)
+{
+	if (!priv->pt.sl_freed && ++priv->unmap_pending < lazy_unmap_batch)
+		return true;
+
+	priv->unmap_pending = 0;
+	priv->pt.sl_freed = 0;
+	return false;
+}
+
 static int __flush_iotlb(struct iommu_domain *domain)
 {
 	struct msm_iommu_priv *priv = domain->priv;
@@ -652,6 +673,8 @@ static int msm_iommu_domain_init(struct iommu_domain *domain, int flags)
 #ifdef CONFIG_IOMMU_PGTABLES_L2
 	priv->pt.redirect = flags & MSM_IOMMU_DOMAIN_PT_CACHEABLE;
 #endif
+	priv->lazy_unmap = (flags & MSM_IOMMU_DOMAIN_LAZY_UNMAP) &&
+			   !(flags & MSM_IOMMU_DOMAIN_PT_SECURE);
 
 	INIT_LIST_HEAD(&priv->list_attached);
 	if (msm_iommu_pagetable_alloc(&priv->pt))
@@ -883,7 +906,12 @@ static size_t msm_iommu_unmap(struct iommu_domain *domain, unsigned long va,
 	if (ret < 0)
 		goto fail;
 
-	ret = __flush_iotlb_va(domain, va);
+	if (!priv->lazy_unmap)
+		ret = __flush_iotlb_va(domain, va);
+	else if (__defer_unmap_flush(priv))
+		ret = 0;
+	else
+		ret = __flush_iotlb(domain);
 fail:
 	mutex_unlock(&msm_iommu_lock);
 
@@ -912,6 +940,8 @@ static int msm_iommu_map_range(struct iommu_domain *domain, unsigned int va,
 		goto fail;
 
 	__flush_iotlb(domain);
+	priv->unmap_pending = 0;
+	priv->pt.sl_freed = 0;
 fail:
 	mutex_unlock(&msm_iommu_lock);
 	return ret;
@@ -928,7 +958,8 @@ static int msm_iommu_unmap_range(struct iommu_domain *domain, unsigned int va,
 	priv = domain->priv;
 	msm_iommu_pagetable_unmap_range(&priv->pt, va, len);
 
-	__flush_iotlb(domain);
+	if (!priv->lazy_unmap || !__defer_unmap_flush(priv))
+		__flush_iotlb(domain);
 	mutex_unlock(&msm_iommu_lock);
 	return 0;
 }
@@ -400,11 +400,48 @@ static int check_range(unsigned long *fl_table, unsigned int va,
 	return 0;
 }
 
-static inline int is_fully_aligned(unsigned int va, phys_addr_t pa, size_t len,
-				   int align)
+/*
+ * Length of the physically contiguous run starting chunk_offset bytes into
+ * sg. Following entries are added as long as they continue the run, so
+ * buffers made of adjacent chunks still get large pages. Stops at max.
+ */
+static unsigned int contig_len(struct scatterlist *sg,
+			       unsigned int chunk_offset, unsigned int max)
+{
+	phys_addr_t end = get_phys_addr(sg) + sg->length;
+	unsigned int len = sg->length - chunk_offset;
+
+	while (len < max) {
+		sg = sg_next(sg);
+		if (!sg || get_phys_addr(sg) != end)
+			break;
+		len += sg->length;
+		end += sg->length;
+	}
+	return len;
+}
+
+static inline int is_fully_aligned(unsigned int va, phys_addr_t pa,
+				   struct scatterlist *sg,
+				   unsigned int chunk_offset,
+				   unsigned int len, int align)
 {
 	return  IS_ALIGNED(va, align) && IS_ALIGNED(pa, align)
-		&& (len >= align);
+		&& (len >= align)
+		&& contig_len(sg, chunk_offset, align) >= align;
+}
+
+/* Move to the entry the next chunk starts in, it may be past several */
+static inline struct scatterlist *next_chunk(struct scatterlist *sg,
+					     unsigned int *chunk_offset,
+					     phys_addr_t *pa)
+{
+	while (*chunk_offset >= sg->length) {
+		*chunk_offset -= sg->length;
+		sg = sg_next(sg);
+		*pa = get_phys_addr(sg) + *chunk_offset;
+	}
+	return sg;
 }
 
 int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
@@ -413,7 +450,7 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 	phys_addr_t pa;
 	unsigned int start_va = va;
 	unsigned int offset = 0;
-	unsigned long *fl_pte;
+	unsigned long *fl_pte, *fl_start;
 	unsigned long fl_offset;
 	unsigned long *sl_table = NULL;
 	unsigned long sl_offset, sl_start;
@@ -434,6 +471,7 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 
 	fl_offset = FL_OFFSET(va);		/* Upper 12 bits */
 	fl_pte = pt->fl_table + fl_offset;	/* int pointers, 4 bytes */
+	fl_start = fl_pte;
 	pa = get_phys_addr(sg);
 
 	ret = check_range(pt->fl_table, va, len);
@@ -443,29 +481,30 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 	while (offset < len) {
 		chunk_size = SZ_4K;
 
-		if (is_fully_aligned(va, pa, sg->length - chunk_offset,
+		if (is_fully_aligned(va, pa, sg, chunk_offset, len - offset,
 				     SZ_16M))
 			chunk_size = SZ_16M;
-		else if (is_fully_aligned(va, pa, sg->length - chunk_offset,
-					  SZ_1M))
+		else if (is_fully_aligned(va, pa, sg, chunk_offset,
+					  len - offset, SZ_1M))
 			chunk_size = SZ_1M;
 		/* 64k or 4k determined later */
 
 		trace_iommu_map_range(va, pa, sg->length, chunk_size);
 
-		/* for 1M and 16M, only first level entries are required */
+		/*
+		 * for 1M and 16M, only first level entries are required.
+		 * They are cleaned all at once when the range is done.
+		 */
 		if (chunk_size >= SZ_1M) {
 			if (chunk_size == SZ_16M) {
 				ret = fl_16m(fl_pte, pa, pgprot16m);
 				if (ret)
 					goto fail;
-				clean_pte(fl_pte, fl_pte + 16, pt->redirect);
 				fl_pte += 16;
 			} else if (chunk_size == SZ_1M) {
 				ret = fl_1m(fl_pte, pa, pgprot1m);
 				if (ret)
 					goto fail;
-				clean_pte(fl_pte, fl_pte + 1, pt->redirect);
 				fl_pte++;
 			}
 
@@ -474,11 +513,8 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 			va += chunk_size;
 			pa += chunk_size;
 
-			if (chunk_offset >= sg->length && offset < len) {
-				chunk_offset = 0;
-				sg = sg_next(sg);
-				pa = get_phys_addr(sg);
-			}
+			if (offset < len)
+				sg = next_chunk(sg, &chunk_offset, &pa);
 			continue;
 		}
 		/* for 4K or 64K, make sure there is a second level table */
@@ -505,8 +541,8 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 			 * the pa and va are aligned
 			 */
 
-			if (is_fully_aligned(va, pa, sg->length - chunk_offset,
-					     SZ_64K))
+			if (is_fully_aligned(va, pa, sg, chunk_offset,
+					     len - offset, SZ_64K))
 				chunk_size = SZ_64K;
 			else
 				chunk_size = SZ_4K;
@@ -529,11 +565,8 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 			va += chunk_size;
 			pa += chunk_size;
 
-			if (chunk_offset >= sg->length && offset < len) {
-				chunk_offset = 0;
-				sg = sg_next(sg);
-				pa = get_phys_addr(sg);
-			}
+			if (offset < len)
+				sg = next_chunk(sg, &chunk_offset, &pa);
 		}
 
 		clean_pte(sl_table + sl_start, sl_table + sl_offset,
@@ -542,6 +575,8 @@ int msm_iommu_pagetable_map_range(struct msm_iommu_pt *pt, unsigned int va,
 		sl_offset = 0;
 	}
 
+	clean_pte(fl_start, fl_pte, pt->redirect);
+
 fail:
 	if (ret && offset > 0)
 		msm_iommu_pagetable_unmap_range(pt, start_va, offset);
@@ -553,7 +588,7 @@ void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 				 unsigned int len)
 {
 	unsigned int offset = 0;
-	unsigned long *fl_pte;
+	unsigned long *fl_pte, *fl_start;
 	unsigned long fl_offset;
 	unsigned long *sl_table;
 	unsigned long sl_start, sl_end;
@@ -563,6 +598,7 @@ void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 
 	fl_offset = FL_OFFSET(va);		/* Upper 12 bits */
 	fl_pte = pt->fl_table + fl_offset;	/* int pointers, 4 bytes */
+	fl_start = fl_pte;
 
 	while (offset < len) {
 		if (*fl_pte & FL_TYPE_TABLE) {
@@ -599,20 +635,23 @@ void msm_iommu_pagetable_unmap_range(struct msm_iommu_pt *pt, unsigned int va,
 			if (!used) {
 				free_page((unsigned long)sl_table);
 				*fl_pte = 0;
+				pt->sl_freed++;
 
 				clean_pte(fl_pte, fl_pte + 1, pt->redirect);
 			}
 
 			sl_start = 0;
 		} else {
+			/* cleaned with the rest of the range below */
 			*fl_pte = 0;
-			clean_pte(fl_pte, fl_pte + 1, pt->redirect);
 			va += SZ_1M;
 			offset += SZ_1M;
 			sl_start = 0;
 		}
 		fl_pte++;
 	}
+
+	clean_pte(fl_start, fl_pte, pt->redirect);
 }
 
 static int __init get_tex_class(int icp, int ocp, int mt, int nos)
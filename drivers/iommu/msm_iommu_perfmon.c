@@ -20,6 +20,8 @@
 #include <linux/interrupt.h>
 #include <linux/bitops.h>
 #include <linux/debugfs.h>
+#include <linux/perf_event.h>
+#include <linux/workqueue.h>
 #include <mach/iommu.h>
 #include <mach/iommu_perfmon.h>
 
@@ -249,6 +251,55 @@ static void iommu_pm_read_all_counters(struct iommu_pmon *pmon)
 	}
 }
 
+#ifdef CONFIG_PERF_EVENTS
+/* Must be called with pmon->lock held */
+static void iommu_pm_perf_update(struct iommu_pmon *pmon)
+{
+	struct iommu_info *iommu = &pmon->iommu;
+	struct iommu_pmon_counter *counter;
+	unsigned int hw_ok, i, j;
+	unsigned long flags;
+	u64 raw;
+
+	if (!pmon->perf_users)
+		return;
+
+	hw_ok = iommu->hw_ops->is_hw_access_OK(pmon);
+	if (hw_ok)
+		iommu->ops->iommu_lock_acquire(1);
+
+	for (i = 0; i < pmon->num_groups; ++i) {
+		for (j = 0; j < pmon->cnt_grp[i].num_counters; ++j) {
+			counter = &pmon->cnt_grp[i].counters[j];
+			if (!counter->perf_event)
+				continue;
+
+			if (hw_ok)
+				counter->value =
+					iommu->hw_ops->read_counter(counter);
+			raw = (u64) counter->value +
+			      ((u64) counter->overflow_count << 32);
+
+			/* The counters restart from 0 when PM is turned on */
+			spin_lock_irqsave(&pmon->perf_lock, flags);
+			if (raw >= counter->perf_raw)
+				counter->perf_count += raw - counter->perf_raw;
+			else
+				counter->perf_count += raw;
+			counter->perf_raw = raw;
+			spin_unlock_irqrestore(&pmon->perf_lock, flags);
+		}
+	}
+
+	if (hw_ok)
+		iommu->ops->iommu_lock_release(1);
+}
+#else
+static inline void iommu_pm_perf_update(struct iommu_pmon *pmon)
+{
+}
+#endif
+
 static void iommu_pm_on(struct iommu_pmon *pmon)
 {
 	unsigned int i;
@@ -315,6 +366,9 @@ static void iommu_pm_off(struct iommu_pmon *pmon)
 	iommu->ops->iommu_bus_vote(iommu_drvdata, 0);
 	iommu->ops->iommu_power_off(iommu_drvdata);
 
+	/* Hand the last values over to perf before they are reset */
+	iommu_pm_perf_update(pmon);
+
 	pr_info("%s: TLB performance monitoring turned OFF\n",
 		pmon->iommu.iommu_name);
 }
@@ -397,6 +451,10 @@ static ssize_t iommu_pm_event_class_write(struct file *fp,
 		return -EINVAL;
 
 	mutex_lock(&pmon->lock);
+	if (counter->perf_event) {
+		mutex_unlock(&pmon->lock);
+		return -EBUSY;
+	}
 	current_event_class = counter->current_event_class;
 	wr_cnt = simple_write_to_buffer(buf, buf_size, pos, user_buff, count);
 	if (wr_cnt >= 1) {
@@ -654,6 +712,289 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_PERF_EVENTS
+/*
+ * Each IOMMU PMU is also a perf PMU named after the IOMMU, so its counters
+ * can be used with perf stat, e.g. perf stat -C 0 -e mdp_iommu/event=0x08/.
+ * The counters are only reachable under mutexes, which the perf callbacks
+ * can't take, so a worker folds them into 64 bit counts every
+ * IOMMU_PMU_PERF_POLL_MS and the callbacks only look at those. The IOMMU
+ * counts for the whole system, so events are only taken on CPU 0 (see the
+ * cpumask attribute) and can't be per task or sampling. The group field
+ * selects the counter group, e.g. mdp_iommu/event=0x08,group=1/.
+ */
+#define IOMMU_PMU_PERF_POLL_MS	100
+#define IOMMU_PMU_PERF_EVENT(config)	((config) & 0xFF)
+#define IOMMU_PMU_PERF_GROUP(config)	(((config) >> 8) & 0xFF)
+
+static inline struct iommu_pmon *to_iommu_pmon(struct pmu *pmu)
+{
+	return container_of(pmu, struct iommu_pmon, pmu);
+}
+
+static struct iommu_pmon_counter *iommu_pm_perf_counter(
+					struct perf_event *event)
+{
+	struct iommu_pmon *pmon = to_iommu_pmon(event->pmu);
+	unsigned int idx = event->hw.idx;
+
+	return &pmon->cnt_grp[idx / pmon->num_counters].counters[
+						idx % pmon->num_counters];
+}
+
+static void iommu_pm_perf_work(struct work_struct *work)
+{
+	struct iommu_pmon *pmon = container_of(to_delayed_work(work),
+					       struct iommu_pmon, perf_work);
+
+	mutex_lock(&pmon->lock);
+	iommu_pm_perf_update(pmon);
+	if (pmon->perf_users)
+		schedule_delayed_work(&pmon->perf_work,
+				msecs_to_jiffies(IOMMU_PMU_PERF_POLL_MS));
+	mutex_unlock(&pmon->lock);
+}
+
+static void iommu_pm_perf_destroy(struct perf_event *event)
+{
+	struct iommu_pmon *pmon = to_iommu_pmon(event->pmu);
+	struct iommu_pmon_counter *counter = iommu_pm_perf_counter(event);
+
+	mutex_lock(&pmon->lock);
+	counter->perf_event = NULL;
+	counter->current_event_class = MSM_IOMMU_PMU_NO_EVENT_CLASS;
+	iommu_pm_set_event_type(pmon, counter);
+
+	/*
+	 * The worker stops by itself once there are no users left. Turn PM
+	 * back off if perf turned it on and nobody did so meanwhile.
+	 */
+	if (--pmon->perf_users == 0) {
+		if (pmon->perf_enabled && pmon->enabled) {
+			if (pmon->iommu.always_on ||
+			    pmon->iommu_attach_count > 0)
+				iommu_pm_off(pmon);
+			else
+				pmon->enabled = 0;
+		}
+		pmon->perf_enabled = 0;
+	}
+	mutex_unlock(&pmon->lock);
+}
+
+static int iommu_pm_perf_event_init(struct perf_event *event)
+{
+	struct iommu_pmon *pmon = to_iommu_pmon(event->pmu);
+	struct iommu_pmon_cnt_group *cnt_grp;
+	struct iommu_pmon_counter *counter = NULL;
+	unsigned int grp = IOMMU_PMU_PERF_GROUP(event->attr.config);
+	int event_class = IOMMU_PMU_PERF_EVENT(event->attr.config);
+	unsigned long flags;
+	unsigned int j;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	if (is_sampling_event(event) || event->cpu != 0)
+		return -EOPNOTSUPP;
+
+	if (grp >= pmon->num_groups ||
+	    iommu_pm_event_class_supported(pmon, event_class) !=
+							event_class)
+		return -EINVAL;
+
+	mutex_lock(&pmon->lock);
+	cnt_grp = &pmon->cnt_grp[grp];
+	for (j = 0; j < cnt_grp->num_counters; ++j) {
+		if (cnt_grp->counters[j].current_event_class ==
+					MSM_IOMMU_PMU_NO_EVENT_CLASS) {
+			counter = &cnt_grp->counters[j];
+			break;
+		}
+	}
+	if (!counter) {
+		mutex_unlock(&pmon->lock);
+		return -EBUSY;
+	}
+
+	if (!pmon->enabled) {
+		pmon->perf_enabled = 1;
+		if (pmon->iommu.always_on || pmon->iommu_attach_count > 0)
+			iommu_pm_on(pmon);
+		else
+			pmon->enabled = 1;
+	}
+
+	counter->perf_event = event;
+	counter->current_event_class = event_class;
+	iommu_pm_set_event_type(pmon, counter);
+
+	spin_lock_irqsave(&pmon->perf_lock, flags);
+	counter->perf_raw = 0;
+	counter->perf_count = 0;
+	spin_unlock_irqrestore(&pmon->perf_lock, flags);
+
+	if (pmon->perf_users++ == 0)
+		schedule_delayed_work(&pmon->perf_work,
+				msecs_to_jiffies(IOMMU_PMU_PERF_POLL_MS));
+	mutex_unlock(&pmon->lock);
+
+	event->hw.idx = counter->absolute_counter_no;
+	event->destroy = iommu_pm_perf_destroy;
+
+	return 0;
+}
+
+static u64 iommu_pm_perf_count(struct perf_event *event)
+{
+	struct iommu_pmon *pmon = to_iommu_pmon(event->pmu);
+	unsigned long flags;
+	u64 count;
+
+	spin_lock_irqsave(&pmon->perf_lock, flags);
+	count = iommu_pm_perf_counter(event)->perf_count;
+	spin_unlock_irqrestore(&pmon->perf_lock, flags);
+
+	return count;
+}
+
+static void iommu_pm_perf_read(struct perf_event *event)
+{
+	u64 now = iommu_pm_perf_count(event);
+	u64 prev = local64_xchg(&event->hw.prev_count, now);
+
+	local64_add(now - prev, &event->count);
+}
+
+static void iommu_pm_perf_start(struct perf_event *event, int flags)
+{
+	local64_set(&event->hw.prev_count, iommu_pm_perf_count(event));
+	event->hw.state = 0;
+}
+
+static void iommu_pm_perf_stop(struct perf_event *event, int flags)
+{
+	if (event->hw.state & PERF_HES_STOPPED)
+		return;
+
+	iommu_pm_perf_read(event);
+	event->hw.state |= PERF_HES_STOPPED | PERF_HES_UPTODATE;
+}
+
+static int iommu_pm_perf_add(struct perf_event *event, int flags)
+{
+	event->hw.state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+	if (flags & PERF_EF_START)
+		iommu_pm_perf_start(event, flags);
+
+	return 0;
+}
+
+static void iommu_pm_perf_del(struct perf_event *event, int flags)
+{
+	iommu_pm_perf_stop(event, PERF_EF_UPDATE);
+}
+
+static ssize_t iommu_pm_perf_event_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "config:0-7\n");
+}
+
+static ssize_t iommu_pm_perf_group_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "config:8-15\n");
+}
+
+static ssize_t iommu_pm_perf_cpumask_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "0\n");
+}
+
+static struct device_attribute iommu_pm_perf_format_attrs[] = {
+	__ATTR(event, 0444, iommu_pm_perf_event_show, NULL),
+	__ATTR(group, 0444, iommu_pm_perf_group_show, NULL),
+};
+
+static struct device_attribute iommu_pm_perf_cpumask_attr =
+	__ATTR(cpumask, 0444, iommu_pm_perf_cpumask_show, NULL);
+
+static struct attribute *iommu_pm_perf_format[] = {
+	&iommu_pm_perf_format_attrs[0].attr,
+	&iommu_pm_perf_format_attrs[1].attr,
+	NULL,
+};
+
+static struct attribute *iommu_pm_perf_cpumask[] = {
+	&iommu_pm_perf_cpumask_attr.attr,
+	NULL,
+};
+
+static struct attribute_group iommu_pm_perf_format_group = {
+	.name = "format",
+	.attrs = iommu_pm_perf_format,
+};
+
+static struct attribute_group iommu_pm_perf_cpumask_group = {
+	.attrs = iommu_pm_perf_cpumask,
+};
+
+static const struct attribute_group *iommu_pm_perf_attr_groups[] = {
+	&iommu_pm_perf_format_group,
+	&iommu_pm_perf_cpumask_group,
+	NULL,
+};
+
+static void iommu_pm_perf_register(struct iommu_pmon *pmon)
+{
+	int ret;
+
+	spin_lock_init(&pmon->perf_lock);
+	INIT_DELAYED_WORK(&pmon->perf_work, iommu_pm_perf_work);
+
+	pmon->pmu = (struct pmu) {
+		.task_ctx_nr	= perf_invalid_context,
+		.attr_groups	= iommu_pm_perf_attr_groups,
+		.event_init	= iommu_pm_perf_event_init,
+		.add		= iommu_pm_perf_add,
+		.del		= iommu_pm_perf_del,
+		.start		= iommu_pm_perf_start,
+		.stop		= iommu_pm_perf_stop,
+		.read		= iommu_pm_perf_read,
+	};
+
+	ret = perf_pmu_register(&pmon->pmu, (char *) pmon->iommu.iommu_name,
+				-1);
+	if (ret) {
+		pr_err("%s: perf PMU registration failed: %d\n",
+			pmon->iommu.iommu_name, ret);
+		pmon->pmu.event_init = NULL;
+	}
+}
+
+static void iommu_pm_perf_unregister(struct iommu_pmon *pmon)
+{
+	if (!pmon->pmu.event_init)
+		return;
+
+	perf_pmu_unregister(&pmon->pmu);
+	cancel_delayed_work_sync(&pmon->perf_work);
+}
+#else
+static inline void iommu_pm_perf_register(struct iommu_pmon *pmon)
+{
+}
+
+static inline void iommu_pm_perf_unregister(struct iommu_pmon *pmon)
+{
+}
+#endif
+
 int msm_iommu_pm_iommu_register(struct iommu_pmon *pmon_entry)
 {
 	int ret = 0;
@@ -731,6 +1072,8 @@ int msm_iommu_pm_iommu_register(struct iommu_pmon *pmon_entry)
 		pr_info("%s: Overflow interrupt not available\n", __func__);
 	}
 
+	iommu_pm_perf_register(pmon_entry);
+
 	dev_dbg(iommu->iommu_dev, "%s iommu registered\n", iommu->iommu_name);
 
 	goto out;
@@ -758,6 +1101,8 @@ void msm_iommu_pm_iommu_unregister(struct device *dev)
 	if (!pmon_entry)
 		return;
 
+	iommu_pm_perf_unregister(pmon_entry);
+
 	free_irq(pmon_entry->iommu.evt_irq, pmon_entry->iommu.iommu_dev);
 
 	if (!pmon_entry)
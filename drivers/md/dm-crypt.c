@@ -164,6 +164,14 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 
+/*
+ * Sectors of one bio an asynchronous cipher may have in flight. 1 sends
+ * the next sector only once the previous one is done.
+ */
+static unsigned async_depth = 16;
+module_param(async_depth, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(async_depth, "Sectors per bio queued to an async cipher");
+
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
@@ -732,12 +740,26 @@ static void crypt_alloc_req(struct crypt_config *cc,
 	    kcryptd_async_done, dmreq_of_req(cc, ctx->req));
 }
 
+/*
+ * Wait until no more than @max requests of @ctx are with the cipher. The
+ * caller holds one ctx->pending reference of its own. Each completion
+ * signals ctx->restart, the count is checked again after every wakeup.
+ */
+static void crypt_wait_pending(struct convert_context *ctx, int max)
+{
+	while (atomic_read(&ctx->pending) - 1 > max) {
+		wait_for_completion(&ctx->restart);
+		INIT_COMPLETION(ctx->restart);
+	}
+}
+
 /*
  * Encrypt / decrypt data from one bio to another one (can be the same one)
  */
 static int crypt_convert(struct crypt_config *cc,
 			 struct convert_context *ctx)
 {
+	int depth = max(async_depth, 1U);
 	int r;
 
 	atomic_set(&ctx->pending, 1);
@@ -752,13 +774,15 @@ static int crypt_convert(struct crypt_config *cc,
 		r = crypt_convert_block(cc, ctx, ctx->req);
 
 		switch (r) {
-		/* async */
+		/*
+		 * async: keep up to depth sectors queued, but once the
+		 * cipher backlogs one let it drain first
+		 */
 		case -EINPROGRESS:
 		case -EBUSY:
-			wait_for_completion(&ctx->restart);
-			INIT_COMPLETION(ctx->restart);
 			ctx->req = NULL;
 			ctx->sector++;
+			crypt_wait_pending(ctx, r == -EBUSY ? 0 : depth - 1);
 			continue;
 
 		/* sync */
@@ -771,10 +795,16 @@ static int crypt_convert(struct crypt_config *cc,
 		/* error */
 		default:
 			atomic_dec(&ctx->pending);
+			crypt_wait_pending(ctx, 0);
 			return r;
 		}
 	}
 
+	/*
+	 * Callers move on to the next clone or complete the bio once this
+	 * returns, so none of its sectors may still be with the cipher.
+	 */
+	crypt_wait_pending(ctx, 0);
 	return 0;
 }
 
@@ -31,6 +31,7 @@
 #include "camera.h"
 #include "msm.h"
 #include "msm_vb2.h"
+#include "msm_cam_frame.h"
 
 #define fh_to_private(__fh) \
 	container_of(__fh, struct camera_v4l2_private, fh)
@@ -250,6 +251,9 @@ static int camera_v4l2_dqbuf(struct file *filep, void *fh,
 	mutex_lock(&session->lock);
 	ret = vb2_dqbuf(&sp->vb2_q, pb, filep->f_flags & O_NONBLOCK);
 	mutex_unlock(&session->lock);
+	if (!ret)
+		msm_cam_frame_stamp(session_id, pb->sequence,
+			MSM_CAM_FRAME_DQBUF);
 	return ret;
 }
 
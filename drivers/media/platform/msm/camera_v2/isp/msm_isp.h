@@ -301,6 +301,11 @@ struct msm_vfe_axi_stream {
 	uint32_t runtime_output_format;
 	enum msm_vfe_frame_skip_pattern frame_skip_pattern;
 
+	/*Done buffer held back while no new buffer was queued*/
+	struct msm_isp_buffer *deferred_buf;
+	uint32_t deferred_pingpong;
+	uint32_t deferred_frame_id;
+	struct msm_isp_timestamp deferred_ts;
 };
 
 enum msm_vfe_overflow_state {
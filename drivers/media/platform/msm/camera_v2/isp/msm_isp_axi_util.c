@@ -14,6 +14,7 @@
 #include <asm/div64.h>
 #include "msm_isp_util.h"
 #include "msm_isp_axi_util.h"
+#include "msm_cam_frame.h"
 
 #define SRC_TO_INTF(src) \
 	((src < RDI_INTF_0) ? VFE_PIX_0 : \
@@ -418,6 +419,27 @@ static void msm_isp_reset_framedrop(struct vfe_device *vfe_dev,
 	vfe_dev->hw_info->vfe_ops.axi_ops.cfg_framedrop(vfe_dev, stream_info);
 }
 
+static void msm_isp_axi_stamp_sof(struct vfe_device *vfe_dev,
+	enum msm_vfe_input_src frame_src)
+{
+	int i;
+	struct msm_vfe_axi_stream *stream_info;
+
+	if (frame_src >= VFE_SRC_MAX)
+		return;
+
+	for (i = 0; i < MAX_NUM_STREAM; i++) {
+		stream_info = &vfe_dev->axi_data.stream_info[i];
+		if (stream_info->state == ACTIVE &&
+			SRC_TO_INTF(stream_info->stream_src) == frame_src) {
+			msm_cam_frame_stamp(stream_info->session_id,
+				vfe_dev->axi_data.src_info[frame_src].frame_id,
+				MSM_CAM_FRAME_SOF);
+			break;
+		}
+	}
+}
+
 void msm_isp_sof_notify(struct vfe_device *vfe_dev,
 	enum msm_vfe_input_src frame_src, struct msm_isp_timestamp *ts) {
 	struct msm_isp_event_data sof_event;
@@ -445,6 +467,9 @@ void msm_isp_sof_notify(struct vfe_device *vfe_dev,
 		break;
 	}
 
+	msm_isp_axi_refill_src(vfe_dev, frame_src);
+	msm_isp_axi_stamp_sof(vfe_dev, frame_src);
+
 	sof_event.input_intf = frame_src;
 	sof_event.frame_id = vfe_dev->axi_data.src_info[frame_src].frame_id;
 	sof_event.timestamp = ts->event_time;
@@ -853,38 +878,17 @@ static void msm_isp_get_done_buf(struct vfe_device *vfe_dev,
 	*done_buf = stream_info->buf[pingpong_bit];
 }
 
-static int msm_isp_cfg_ping_pong_address(struct vfe_device *vfe_dev,
+static int msm_isp_update_ping_pong_buf(struct vfe_device *vfe_dev,
 	struct msm_vfe_axi_stream *stream_info, uint32_t pingpong_status)
 {
-	int i, rc = -1;
+	int i, rc;
 	struct msm_isp_buffer *buf = NULL;
 	uint32_t pingpong_bit = 0;
-	uint32_t bufq_handle = stream_info->bufq_handle;
-	uint32_t stream_idx = HANDLE_TO_IDX(stream_info->stream_handle);
-	uint32_t src_intf = SRC_TO_INTF(stream_info->stream_src);
-	uint32_t frame_id = 0;
-	if (stream_idx >= MAX_NUM_STREAM) {
-		pr_err("%s: Invalid stream_idx", __func__);
-		return rc;
-	}
-	if (src_intf < VFE_SRC_MAX)
-		frame_id = vfe_dev->axi_data.src_info[src_intf].frame_id;
-
-	if (frame_id && (stream_info->frame_id >= frame_id)) {
-		pr_err("%s: duplicate frame_id, Session frm id %d cur frm id %d\n",
-		__func__, frame_id, stream_info->frame_id);
-		vfe_dev->error_info.stream_framedrop_count[stream_idx]++;
-		return rc;
-	}
 
 	rc = vfe_dev->buf_mgr->ops->get_buf(vfe_dev->buf_mgr,
-			vfe_dev->pdev->id, bufq_handle, &buf);
-	if (rc < 0) {
-		if(stream_idx < MAX_NUM_STREAM)
-			vfe_dev->error_info.
-				stream_framedrop_count[stream_idx]++;
-		return rc;
-	}
+			vfe_dev->pdev->id, stream_info->bufq_handle, &buf);
+	if (rc < 0)
+		return -ENOBUFS;
 
 	if (buf->num_planes != stream_info->num_planes) {
 		pr_err("%s: Invalid buffer\n", __func__);
@@ -907,16 +911,52 @@ buf_error:
 	return rc;
 }
 
-static void msm_isp_process_done_buf(struct vfe_device *vfe_dev,
+static int msm_isp_cfg_ping_pong_address(struct vfe_device *vfe_dev,
+	struct msm_vfe_axi_stream *stream_info, uint32_t pingpong_status)
+{
+	int rc = -1;
+	uint32_t stream_idx = HANDLE_TO_IDX(stream_info->stream_handle);
+	uint32_t src_intf = SRC_TO_INTF(stream_info->stream_src);
+	uint32_t frame_id = 0;
+	if (stream_idx >= MAX_NUM_STREAM) {
+		pr_err("%s: Invalid stream_idx", __func__);
+		return rc;
+	}
+	if (src_intf < VFE_SRC_MAX)
+		frame_id = vfe_dev->axi_data.src_info[src_intf].frame_id;
+
+	if (frame_id && (stream_info->frame_id >= frame_id)) {
+		pr_err("%s: duplicate frame_id, Session frm id %d cur frm id %d\n",
+		__func__, frame_id, stream_info->frame_id);
+		vfe_dev->error_info.stream_framedrop_count[stream_idx]++;
+		return rc;
+	}
+
+	rc = msm_isp_update_ping_pong_buf(vfe_dev, stream_info,
+		pingpong_status);
+	if (rc < 0)
+		vfe_dev->error_info.stream_framedrop_count[stream_idx]++;
+	return rc;
+}
+
+static uint32_t msm_isp_get_src_frame_id(struct vfe_device *vfe_dev,
+	struct msm_vfe_axi_stream *stream_info)
+{
+	uint32_t src_intf = SRC_TO_INTF(stream_info->stream_src);
+
+	if (src_intf < VFE_SRC_MAX)
+		return vfe_dev->axi_data.src_info[src_intf].frame_id;
+	return 0;
+}
+
+static void __msm_isp_process_done_buf(struct vfe_device *vfe_dev,
 	struct msm_vfe_axi_stream *stream_info, struct msm_isp_buffer *buf,
-	struct msm_isp_timestamp *ts)
+	struct msm_isp_timestamp *ts, uint32_t frame_id)
 {
 	int rc;
 	struct msm_isp_event_data buf_event;
 	struct timeval *time_stamp;
 	uint32_t stream_idx = HANDLE_TO_IDX(stream_info->stream_handle);
-	uint32_t src_intf = SRC_TO_INTF(stream_info->stream_src);
-	uint32_t frame_id = 0;
 	memset(&buf_event, 0, sizeof(buf_event) );
 
 	if(stream_idx >= MAX_NUM_STREAM) {
@@ -924,11 +964,9 @@ static void msm_isp_process_done_buf(struct vfe_device *vfe_dev,
 		return;
 	}
 
-	if (src_intf < VFE_SRC_MAX) {
-		frame_id = vfe_dev->axi_data.src_info[src_intf].frame_id;
-	}
-
 	if (buf && ts) {
+		msm_cam_frame_stamp(stream_info->session_id, frame_id,
+			MSM_CAM_FRAME_ISP_DONE);
 		if (vfe_dev->vt_enable) {
                         msm_isp_get_avtimer_ts(ts);
 			time_stamp = &ts->vt_time;
@@ -970,6 +1008,130 @@ static void msm_isp_process_done_buf(struct vfe_device *vfe_dev,
 	}
 }
 
+static void msm_isp_process_done_buf(struct vfe_device *vfe_dev,
+	struct msm_vfe_axi_stream *stream_info, struct msm_isp_buffer *buf,
+	struct msm_isp_timestamp *ts)
+{
+	__msm_isp_process_done_buf(vfe_dev, stream_info, buf, ts,
+		msm_isp_get_src_frame_id(vfe_dev, stream_info));
+}
+
+/*
+ * Called from the write master done irq. When no new buffer can be
+ * programmed, the buffer that was just written is not dropped right away:
+ * it stays in the idle ping pong slot until the hardware comes back to it,
+ * one frame later. If a buffer is queued in the meantime it replaces the
+ * done buffer in the slot and the done buffer is returned late instead of
+ * being overwritten.
+ */
+static int msm_isp_axi_swap_buf(struct vfe_device *vfe_dev,
+	struct msm_vfe_axi_stream *stream_info, uint32_t pingpong_status,
+	struct msm_isp_timestamp *ts, struct msm_isp_buffer **done_buf)
+{
+	int rc = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stream_info->lock, flags);
+	/* The hardware moved on to the deferred slot, that frame is lost */
+	stream_info->deferred_buf = NULL;
+	msm_isp_get_done_buf(vfe_dev, stream_info, pingpong_status, done_buf);
+	if (stream_info->stream_type == CONTINUOUS_STREAM ||
+		stream_info->runtime_num_burst_capture > 1) {
+		rc = msm_isp_cfg_ping_pong_address(vfe_dev, stream_info,
+			pingpong_status);
+		if (rc == -ENOBUFS && *done_buf &&
+			stream_info->stream_type == CONTINUOUS_STREAM) {
+			stream_info->deferred_buf = *done_buf;
+			stream_info->deferred_pingpong = pingpong_status;
+			stream_info->deferred_frame_id =
+				msm_isp_get_src_frame_id(vfe_dev, stream_info);
+			stream_info->deferred_ts = *ts;
+		}
+	}
+	spin_unlock_irqrestore(&stream_info->lock, flags);
+	return rc;
+}
+
+static void msm_isp_axi_refill_stream(struct vfe_device *vfe_dev,
+	struct msm_vfe_axi_stream *stream_info)
+{
+	int rc;
+	unsigned long flags;
+	uint32_t pingpong_status, frame_id;
+	struct msm_isp_buffer *done_buf;
+	struct msm_isp_timestamp ts;
+
+	spin_lock_irqsave(&stream_info->lock, flags);
+	done_buf = stream_info->deferred_buf;
+	if (!done_buf || stream_info->state != ACTIVE) {
+		spin_unlock_irqrestore(&stream_info->lock, flags);
+		return;
+	}
+	stream_info->deferred_buf = NULL;
+	frame_id = stream_info->deferred_frame_id;
+	ts = stream_info->deferred_ts;
+
+	/* Too late if the hardware already switched to the deferred slot */
+	pingpong_status =
+		vfe_dev->hw_info->vfe_ops.axi_ops.get_pingpong_status(vfe_dev);
+	if (((pingpong_status ^ stream_info->deferred_pingpong) >>
+		stream_info->wm[0]) & 0x1) {
+		spin_unlock_irqrestore(&stream_info->lock, flags);
+		return;
+	}
+
+	rc = msm_isp_update_ping_pong_buf(vfe_dev, stream_info,
+		stream_info->deferred_pingpong);
+	spin_unlock_irqrestore(&stream_info->lock, flags);
+
+	if (!rc)
+		__msm_isp_process_done_buf(vfe_dev, stream_info, done_buf,
+			&ts, frame_id);
+}
+
+/**
+ * msm_isp_axi_refill_bufq() - Retry deferred buffer updates of a queue
+ * @vfe_dev: VFE device the buffer was queued to
+ * @bufq_handle: Buffer queue that just got a buffer
+ *
+ * Called after userspace queued a buffer, so that a stream that ran out of
+ * buffers gets the new one before its next frame starts.
+ */
+void msm_isp_axi_refill_bufq(struct vfe_device *vfe_dev,
+	uint32_t bufq_handle)
+{
+	int i;
+	struct msm_vfe_axi_stream *stream_info;
+
+	for (i = 0; i < MAX_NUM_STREAM; i++) {
+		stream_info = &vfe_dev->axi_data.stream_info[i];
+		if (stream_info->bufq_handle == bufq_handle)
+			msm_isp_axi_refill_stream(vfe_dev, stream_info);
+	}
+}
+
+/**
+ * msm_isp_axi_refill_src() - Retry deferred buffer updates at start of frame
+ * @vfe_dev: VFE device of the input
+ * @frame_src: Input that just started a frame
+ *
+ * Covers buffers queued without going through the ISP, e.g. vb2 buffers
+ * from the HAL, as long as they arrive before the frame ends.
+ */
+void msm_isp_axi_refill_src(struct vfe_device *vfe_dev,
+	enum msm_vfe_input_src frame_src)
+{
+	int i;
+	struct msm_vfe_axi_stream *stream_info;
+
+	for (i = 0; i < MAX_NUM_STREAM; i++) {
+		stream_info = &vfe_dev->axi_data.stream_info[i];
+		if (stream_info->deferred_buf &&
+			SRC_TO_INTF(stream_info->stream_src) == frame_src)
+			msm_isp_axi_refill_stream(vfe_dev, stream_info);
+	}
+}
+
 static enum msm_isp_camif_update_state
 	msm_isp_get_camif_update_state(struct vfe_device *vfe_dev,
 	struct msm_vfe_axi_stream_cfg_cmd *stream_cfg_cmd)
@@ -1284,6 +1446,7 @@ static int msm_isp_start_axi_stream(struct vfe_device *vfe_dev,
 		stream_info = &axi_data->stream_info[
 			HANDLE_TO_IDX(stream_cfg_cmd->stream_handle[i])];
 		stream_info->frame_id = 0;
+		stream_info->deferred_buf = NULL;
 		if (SRC_TO_INTF(stream_info->stream_src) < VFE_SRC_MAX)
 			src_state = axi_data->src_info[
 				SRC_TO_INTF(stream_info->stream_src)].active;
@@ -1601,16 +1764,9 @@ void msm_isp_process_axi_irq(struct vfe_device *vfe_dev,
 					stream_info->
 						runtime_num_burst_capture--;
 
-				msm_isp_get_done_buf(vfe_dev, stream_info,
-					pingpong_status, &done_buf);
-				if (stream_info->stream_type ==
-					CONTINUOUS_STREAM ||
-					stream_info->
-					runtime_num_burst_capture > 1) {
-					rc = msm_isp_cfg_ping_pong_address(
-							vfe_dev, stream_info,
-							pingpong_status);
-				}
+				rc = msm_isp_axi_swap_buf(vfe_dev,
+					stream_info, pingpong_status,
+					&buf_ts, &done_buf);
 				if ((stream_info->stream_src < RDI_INTF_0) &&
 					SRC_TO_INTF(stream_info->stream_src) < VFE_SRC_MAX) {
 					stream_info->frame_id = vfe_dev->axi_data.
@@ -1641,13 +1797,8 @@ void msm_isp_process_axi_irq(struct vfe_device *vfe_dev,
 			if (stream_info->stream_type == BURST_STREAM)
 				stream_info->runtime_num_burst_capture--;
 
-			msm_isp_get_done_buf(vfe_dev, stream_info,
-						pingpong_status, &done_buf);
-			if (stream_info->stream_type == CONTINUOUS_STREAM ||
-				stream_info->runtime_num_burst_capture > 1) {
-				rc = msm_isp_cfg_ping_pong_address(vfe_dev,
-					stream_info, pingpong_status);
-			}
+			rc = msm_isp_axi_swap_buf(vfe_dev, stream_info,
+				pingpong_status, &buf_ts, &done_buf);
 			if ((stream_info->stream_src < RDI_INTF_0) &&
 				SRC_TO_INTF(stream_info->stream_src) < VFE_SRC_MAX)
 				stream_info->frame_id = vfe_dev->axi_data.
@@ -55,4 +55,8 @@ void msm_isp_sof_notify(struct vfe_device *vfe_dev,
 void msm_isp_process_axi_irq(struct vfe_device *vfe_dev,
 	uint32_t irq_status0, uint32_t irq_status1,
 	struct msm_isp_timestamp *ts);
+void msm_isp_axi_refill_bufq(struct vfe_device *vfe_dev,
+	uint32_t bufq_handle);
+void msm_isp_axi_refill_src(struct vfe_device *vfe_dev,
+	enum msm_vfe_input_src frame_src);
 #endif /* __MSM_ISP_AXI_UTIL_H__ */
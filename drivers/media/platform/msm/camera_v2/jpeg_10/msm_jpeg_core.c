@@ -221,6 +221,8 @@ irqreturn_t msm_jpeg_core_irq(int irq_num, void *context)
 	if (msm_jpeg_hw_irq_is_frame_done(jpeg_irq_status)) {
 		/* send fe ping pong irq */
 		JPEG_DBG_HIGH("%s:%d] Session done\n", __func__, __LINE__);
+		/* idle before the handlers so a queued job can start */
+		pgmn_dev->state = MSM_JPEG_INIT;
 		data = msm_jpeg_core_fe_pingpong_irq(jpeg_irq_status,
 			pgmn_dev);
 		if (msm_jpeg_irq_handler)
@@ -232,7 +234,6 @@ irqreturn_t msm_jpeg_core_irq(int irq_num, void *context)
 			msm_jpeg_irq_handler(
 				MSM_JPEG_HW_MASK_COMP_FRAMEDONE,
 				context, data);
-		pgmn_dev->state = MSM_JPEG_INIT;
 	}
 	if (msm_jpeg_hw_irq_is_reset_ack(jpeg_irq_status)) {
 		data = msm_jpeg_core_reset_ack_irq(jpeg_irq_status,
@@ -17,11 +17,15 @@
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/ratelimit.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 #include <media/msm_jpeg.h>
 #include "msm_jpeg_sync.h"
 #include "msm_jpeg_core.h"
 #include "msm_jpeg_platform.h"
 #include "msm_jpeg_common.h"
+#include "msm_cam_frame.h"
 
 #define JPEG_REG_SIZE 0x308
 #define JPEG_DEV_CNT 3
@@ -188,6 +192,8 @@ int msm_jpeg_framedone_irq(struct msm_jpeg_device *pgmn_dev,
 	JPEG_DBG("%s:%d] Enter\n", __func__, __LINE__);
 
 	if (buf_in) {
+		msm_cam_frame_stamp(MSM_CAM_FRAME_JPEG_SESSION,
+			pgmn_dev->job_id, MSM_CAM_FRAME_JPEG_DONE);
 		buf_in->vbuf.framedone_len = buf_in->framedone_len;
 		buf_in->vbuf.type = MSM_JPEG_EVT_SESSION_DONE;
 		JPEG_DBG("%s:%d] 0x%08x %d framedone_len %d\n",
@@ -200,6 +206,7 @@ int msm_jpeg_framedone_irq(struct msm_jpeg_device *pgmn_dev,
 			__func__, __LINE__);
 		rc = -1;
 	}
+	schedule_work(&pgmn_dev->job_work);
 
 	if (buf_in)
 		rc = msm_jpeg_q_wakeup(&pgmn_dev->evt_q);
@@ -628,6 +635,8 @@ int __msm_jpeg_release(struct msm_jpeg_device *pgmn_dev)
 	pgmn_dev->open_count--;
 	mutex_unlock(&pgmn_dev->lock);
 
+	msm_jpeg_job_q_flush(pgmn_dev);
+	cancel_work_sync(&pgmn_dev->job_work);
 	msm_jpeg_core_release(pgmn_dev, pgmn_dev->domain_num);
 	msm_jpeg_q_cleanup(&pgmn_dev->evt_q);
 	msm_jpeg_q_cleanup(&pgmn_dev->output_rtn_q);
@@ -677,24 +686,22 @@ int msm_jpeg_ioctl_hw_cmd(struct msm_jpeg_device *pgmn_dev,
 	return 0;
 }
 
-int msm_jpeg_ioctl_hw_cmds(struct msm_jpeg_device *pgmn_dev,
-	void * __user arg)
+static struct msm_jpeg_hw_cmds *msm_jpeg_hw_cmds_copy(void * __user arg,
+	uint32_t *m_p, uint32_t *len_p)
 {
-	int is_copy_to_user;
 	uint32_t len;
 	uint32_t m;
 	struct msm_jpeg_hw_cmds *hw_cmds_p;
-	struct msm_jpeg_hw_cmd *hw_cmd_p;
 
 	if (copy_from_user(&m, arg, sizeof(m))) {
 		JPEG_PR_ERR("%s:%d] failed\n", __func__, __LINE__);
-		return -EFAULT;
+		return NULL;
 	}
 
 	if ((m == 0) || (m > ((UINT32_MAX - sizeof(struct msm_jpeg_hw_cmds)) /
 		sizeof(struct msm_jpeg_hw_cmd)))) {
 		JPEG_PR_ERR("%s:%d] m_cmds out of range\n", __func__, __LINE__);
-		return -EFAULT;
+		return NULL;
 	}
 
 	len = sizeof(struct msm_jpeg_hw_cmds) +
@@ -702,15 +709,33 @@ int msm_jpeg_ioctl_hw_cmds(struct msm_jpeg_device *pgmn_dev,
 	hw_cmds_p = kmalloc(len, GFP_KERNEL);
 	if (!hw_cmds_p) {
 		JPEG_PR_ERR("%s:%d] no mem %d\n", __func__, __LINE__, len);
-		return -EFAULT;
+		return NULL;
 	}
 
 	if (copy_from_user(hw_cmds_p, arg, len)) {
 		JPEG_PR_ERR("%s:%d] failed\n", __func__, __LINE__);
 		kfree(hw_cmds_p);
-		return -EFAULT;
+		return NULL;
 	}
 
+	*m_p = m;
+	*len_p = len;
+	return hw_cmds_p;
+}
+
+int msm_jpeg_ioctl_hw_cmds(struct msm_jpeg_device *pgmn_dev,
+	void * __user arg)
+{
+	int is_copy_to_user;
+	uint32_t len;
+	uint32_t m;
+	struct msm_jpeg_hw_cmds *hw_cmds_p;
+	struct msm_jpeg_hw_cmd *hw_cmd_p;
+
+	hw_cmds_p = msm_jpeg_hw_cmds_copy(arg, &m, &len);
+	if (!hw_cmds_p)
+		return -EFAULT;
+
 	hw_cmd_p = (struct msm_jpeg_hw_cmd *) &(hw_cmds_p->hw_cmd);
 
 	is_copy_to_user = msm_jpeg_hw_exec_cmds(hw_cmd_p, m,
@@ -730,22 +755,16 @@ int msm_jpeg_ioctl_hw_cmds(struct msm_jpeg_device *pgmn_dev,
 	return 0;
 }
 
-int msm_jpeg_start(struct msm_jpeg_device *pgmn_dev, void * __user arg)
-{
-	struct msm_jpeg_core_buf *buf_out;
-	struct msm_jpeg_core_buf *buf_out_free[2] = {NULL, NULL};
-	int i, rc;
+/*************** job queue ****************/
 
-	JPEG_DBG("%s:%d] Enter\n", __func__, __LINE__);
+static void msm_jpeg_job_get_bufs(struct msm_jpeg_device *pgmn_dev,
+	struct msm_jpeg_job *job)
+{
+	int i;
 
-	pgmn_dev->release_buf = 1;
 	for (i = 0; i < 2; i++) {
-		buf_out = msm_jpeg_q_out(&pgmn_dev->input_buf_q);
-
-		if (buf_out) {
-			msm_jpeg_core_fe_buf_update(pgmn_dev, buf_out);
-			kfree(buf_out);
-		} else {
+		job->in_buf[i] = msm_jpeg_q_out(&pgmn_dev->input_buf_q);
+		if (!job->in_buf[i]) {
 			JPEG_DBG("%s:%d] no input buffer\n", __func__,
 					__LINE__);
 			break;
@@ -753,31 +772,225 @@ int msm_jpeg_start(struct msm_jpeg_device *pgmn_dev, void * __user arg)
 	}
 
 	for (i = 0; i < 2; i++) {
-		buf_out_free[i] = msm_jpeg_q_out(&pgmn_dev->output_buf_q);
-
-		if (buf_out_free[i]) {
-			msm_jpeg_core_we_buf_update(pgmn_dev, buf_out_free[i]);
-			pgmn_dev->release_buf = 0;
-		} else {
+		job->out_buf[i] = msm_jpeg_q_out(&pgmn_dev->output_buf_q);
+		if (!job->out_buf[i]) {
 			JPEG_DBG("%s:%d] no output buffer\n",
 			__func__, __LINE__);
 			break;
 		}
 	}
+}
+
+/**
+ * msm_jpeg_job_program() - Hand the buffers of a job to the engines
+ * @pgmn_dev: JPEG device
+ * @job: Job whose fetch and write engine buffers are programmed
+ *
+ * Frees the buffers of the job and moves the device to the executing
+ * state, the caller then writes the job's hw commands to start it.
+ * Called with job_lock held.
+ */
+static void msm_jpeg_job_program(struct msm_jpeg_device *pgmn_dev,
+	struct msm_jpeg_job *job)
+{
+	int i;
+
+	msm_cam_frame_stamp(MSM_CAM_FRAME_JPEG_SESSION, ++pgmn_dev->job_id,
+		MSM_CAM_FRAME_JPEG_START);
+	pgmn_dev->release_buf = 1;
+	for (i = 0; i < 2 && job->in_buf[i]; i++) {
+		msm_jpeg_core_fe_buf_update(pgmn_dev, job->in_buf[i]);
+		kfree(job->in_buf[i]);
+		job->in_buf[i] = NULL;
+	}
 
-	for (i = 0; i < 2; i++)
-		kfree(buf_out_free[i]);
+	for (i = 0; i < 2 && job->out_buf[i]; i++) {
+		msm_jpeg_core_we_buf_update(pgmn_dev, job->out_buf[i]);
+		pgmn_dev->release_buf = 0;
+	}
+
+	for (i = 0; i < 2; i++) {
+		kfree(job->out_buf[i]);
+		job->out_buf[i] = NULL;
+	}
 
 	pgmn_dev->state = MSM_JPEG_EXECUTING;
 	JPEG_DBG_HIGH("%s:%d] START\n", __func__, __LINE__);
+}
+
+static void msm_jpeg_job_free(struct msm_jpeg_device *pgmn_dev,
+	struct msm_jpeg_job *job)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (job->in_buf[i]) {
+			msm_jpeg_platform_p2v(pgmn_dev, job->in_buf[i]->file,
+				&job->in_buf[i]->handle, pgmn_dev->domain_num);
+			kfree(job->in_buf[i]);
+		}
+		if (job->out_buf[i]) {
+			msm_jpeg_platform_p2v(pgmn_dev, job->out_buf[i]->file,
+				&job->out_buf[i]->handle, pgmn_dev->domain_num);
+			kfree(job->out_buf[i]);
+		}
+	}
+	kfree(job->hw_cmds_p);
+	kfree(job);
+}
+
+static void msm_jpeg_job_q_flush(struct msm_jpeg_device *pgmn_dev)
+{
+	struct msm_jpeg_job *job;
+
+	mutex_lock(&pgmn_dev->job_lock);
+	while ((job = msm_jpeg_q_out(&pgmn_dev->job_q)) != NULL)
+		msm_jpeg_job_free(pgmn_dev, job);
+	pgmn_dev->job_q_depth = 0;
+	mutex_unlock(&pgmn_dev->job_lock);
+}
+
+/**
+ * msm_jpeg_job_work() - Start the next queued job once the engine is idle
+ * @work: job_work of the JPEG device
+ *
+ * Scheduled on every frame done, so a job queued while the previous one
+ * was encoding starts without a round trip through userspace.
+ */
+static void msm_jpeg_job_work(struct work_struct *work)
+{
+	struct msm_jpeg_device *pgmn_dev = container_of(work,
+		struct msm_jpeg_device, job_work);
+	struct msm_jpeg_job *job;
+	int rc;
+
+	mutex_lock(&pgmn_dev->job_lock);
+	if (pgmn_dev->state == MSM_JPEG_EXECUTING ||
+		pgmn_dev->state == MSM_JPEG_STOPPED) {
+		mutex_unlock(&pgmn_dev->job_lock);
+		return;
+	}
+
+	job = msm_jpeg_q_out(&pgmn_dev->job_q);
+	if (!job) {
+		mutex_unlock(&pgmn_dev->job_lock);
+		return;
+	}
+	pgmn_dev->job_q_depth--;
+	pgmn_dev->jobs_queued++;
+
+	msm_jpeg_job_program(pgmn_dev, job);
+	wmb();
+	rc = msm_jpeg_hw_exec_cmds((struct msm_jpeg_hw_cmd *)
+		&(job->hw_cmds_p->hw_cmd), job->m, pgmn_dev->res_size,
+		pgmn_dev->base);
+	wmb();
+	if (rc < 0)
+		JPEG_PR_ERR("%s:%d] job %u failed to start %d\n", __func__,
+			__LINE__, pgmn_dev->job_id, rc);
+	mutex_unlock(&pgmn_dev->job_lock);
+
+	msm_jpeg_job_free(pgmn_dev, job);
+}
+
+static int msm_jpeg_job_queue(struct msm_jpeg_device *pgmn_dev,
+	void * __user arg)
+{
+	struct msm_jpeg_job *job;
+	uint32_t len;
+
+	if (pgmn_dev->job_q_depth >= MSM_JPEG_JOB_Q_MAX) {
+		pgmn_dev->job_q_full++;
+		JPEG_DBG_HIGH("%s:%d] job queue full\n", __func__, __LINE__);
+		return -EBUSY;
+	}
+
+	job = kzalloc(sizeof(struct msm_jpeg_job), GFP_KERNEL);
+	if (!job) {
+		JPEG_PR_ERR("%s:%d] no mem\n", __func__, __LINE__);
+		return -ENOMEM;
+	}
+
+	job->hw_cmds_p = msm_jpeg_hw_cmds_copy(arg, &job->m, &len);
+	if (!job->hw_cmds_p) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	msm_jpeg_job_get_bufs(pgmn_dev, job);
+	if (msm_jpeg_q_in(&pgmn_dev->job_q, job)) {
+		msm_jpeg_job_free(pgmn_dev, job);
+		return -ENOMEM;
+	}
+
+	pgmn_dev->job_q_depth++;
+	if (pgmn_dev->job_q_depth > pgmn_dev->job_q_peak)
+		pgmn_dev->job_q_peak = pgmn_dev->job_q_depth;
+	JPEG_DBG("%s:%d] queued, depth %d\n", __func__, __LINE__,
+		pgmn_dev->job_q_depth);
+	return 0;
+}
+
+/**
+ * msm_jpeg_start() - Start an encode or decode job
+ * @pgmn_dev: JPEG device
+ * @arg: hw commands that start the job
+ *
+ * A job started while the previous one is still executing is queued with
+ * the buffers enqueued for it so far, and is started from the frame done
+ * of the previous job. The hw commands of a queued job are not copied back
+ * to userspace.
+ */
+int msm_jpeg_start(struct msm_jpeg_device *pgmn_dev, void * __user arg)
+{
+	struct msm_jpeg_job job;
+	int rc;
+
+	JPEG_DBG("%s:%d] Enter\n", __func__, __LINE__);
+
+	mutex_lock(&pgmn_dev->job_lock);
+	if (pgmn_dev->state == MSM_JPEG_EXECUTING || pgmn_dev->job_q_depth) {
+		rc = msm_jpeg_job_queue(pgmn_dev, arg);
+		mutex_unlock(&pgmn_dev->job_lock);
+		return rc;
+	}
+
+	memset(&job, 0, sizeof(job));
+	msm_jpeg_job_get_bufs(pgmn_dev, &job);
+	msm_jpeg_job_program(pgmn_dev, &job);
+	pgmn_dev->jobs_direct++;
 	wmb();
 	rc = msm_jpeg_ioctl_hw_cmds(pgmn_dev, arg);
 	wmb();
+	mutex_unlock(&pgmn_dev->job_lock);
 
 	JPEG_DBG("%s:%d]", __func__, __LINE__);
 	return rc;
 }
 
+static int msm_jpeg_job_q_show(struct seq_file *s, void *unused)
+{
+	struct msm_jpeg_device *pgmn_dev = s->private;
+
+	seq_printf(s, "depth %d peak %d max %d\n", pgmn_dev->job_q_depth,
+		pgmn_dev->job_q_peak, MSM_JPEG_JOB_Q_MAX);
+	seq_printf(s, "direct %u queued %u full %u\n", pgmn_dev->jobs_direct,
+		pgmn_dev->jobs_queued, pgmn_dev->job_q_full);
+	return 0;
+}
+
+static int msm_jpeg_job_q_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_jpeg_job_q_show, inode->i_private);
+}
+
+static const struct file_operations msm_jpeg_job_q_fops = {
+	.open = msm_jpeg_job_q_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int msm_jpeg_ioctl_reset(struct msm_jpeg_device *pgmn_dev,
 	void * __user arg)
 {
@@ -858,6 +1071,7 @@ long __msm_jpeg_ioctl(struct msm_jpeg_device *pgmn_dev,
 	case MSM_JPEG_IOCTL_STOP:
 		rc = msm_jpeg_ioctl_hw_cmds(pgmn_dev, (void __user *) arg);
 		pgmn_dev->state = MSM_JPEG_STOPPED;
+		msm_jpeg_job_q_flush(pgmn_dev);
 		break;
 
 	case MSM_JPEG_IOCTL_START:
@@ -944,8 +1158,11 @@ int __msm_jpeg_init(struct msm_jpeg_device *pgmn_dev)
 	int idx = 0;
 	char *iommu_name[JPEG_DEV_CNT] = {"jpeg_enc0", "jpeg_enc1",
 		"jpeg_dec"};
+	char name[16];
 
 	mutex_init(&pgmn_dev->lock);
+	mutex_init(&pgmn_dev->job_lock);
+	INIT_WORK(&pgmn_dev->job_work, msm_jpeg_job_work);
 
 	pr_err("%s:%d] Jpeg Device id %d", __func__, __LINE__,
 		   pgmn_dev->pdev->id);
@@ -959,6 +1176,7 @@ int __msm_jpeg_init(struct msm_jpeg_device *pgmn_dev)
 	msm_jpeg_q_init("output_buf_q", &pgmn_dev->output_buf_q);
 	msm_jpeg_q_init("input_rtn_q", &pgmn_dev->input_rtn_q);
 	msm_jpeg_q_init("input_buf_q", &pgmn_dev->input_buf_q);
+	msm_jpeg_q_init("job_q", &pgmn_dev->job_q);
 
 #ifdef CONFIG_MSM_IOMMU
 	j = (pgmn_dev->iommu_cnt <= 1) ? idx : 0;
@@ -991,14 +1209,23 @@ int __msm_jpeg_init(struct msm_jpeg_device *pgmn_dev)
 	}
 #endif
 
+	snprintf(name, sizeof(name), "msm_jpeg%d", idx);
+	pgmn_dev->debugfs_root = debugfs_create_dir(name, NULL);
+	if (!IS_ERR_OR_NULL(pgmn_dev->debugfs_root))
+		debugfs_create_file("job_q", S_IRUGO, pgmn_dev->debugfs_root,
+			pgmn_dev, &msm_jpeg_job_q_fops);
+
 	return rc;
 error:
+	mutex_destroy(&pgmn_dev->job_lock);
 	mutex_destroy(&pgmn_dev->lock);
 	return -EFAULT;
 }
 
 int __msm_jpeg_exit(struct msm_jpeg_device *pgmn_dev)
 {
+	debugfs_remove_recursive(pgmn_dev->debugfs_root);
+	mutex_destroy(&pgmn_dev->job_lock);
 	mutex_destroy(&pgmn_dev->lock);
 	kfree(pgmn_dev);
 	return 0;
@@ -19,6 +19,7 @@
 #include <linux/list.h>
 #include <linux/cdev.h>
 #include <linux/platform_device.h>
+#include <linux/workqueue.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-subdev.h>
 #include "msm_jpeg_hw.h"
@@ -26,6 +27,9 @@
 #define JPEG_8974_V1 0x10000000
 #define JPEG_8974_V2 0x10010000
 
+/* jobs that can wait behind the executing one */
+#define MSM_JPEG_JOB_Q_MAX 4
+
 enum msm_jpeg_state {
 	MSM_JPEG_INIT,
 	MSM_JPEG_RESET,
@@ -47,6 +51,13 @@ struct msm_jpeg_q_entry {
 	void   *data;
 };
 
+struct msm_jpeg_job {
+	struct msm_jpeg_hw_buf *in_buf[2];
+	struct msm_jpeg_hw_buf *out_buf[2];
+	struct msm_jpeg_hw_cmds *hw_cmds_p;
+	uint32_t m;
+};
+
 struct msm_jpeg_device {
 	struct platform_device *pdev;
 	struct resource        *mem;
@@ -98,6 +109,18 @@ struct msm_jpeg_device {
 	struct ion_client *jpeg_client;
 	void *jpeg_vbif;
 	int release_buf;
+	uint32_t job_id;
+
+	/* jobs started while the engine was busy, protected by job_lock */
+	struct msm_jpeg_q job_q;
+	struct mutex job_lock;
+	struct work_struct job_work;
+	int job_q_depth;
+	int job_q_peak;
+	uint32_t jobs_direct;
+	uint32_t jobs_queued;
+	uint32_t job_q_full;
+	struct dentry *debugfs_root;
 	struct msm_jpeg_hw_pingpong fe_pingpong_buf;
 	struct msm_jpeg_hw_pingpong we_pingpong_buf;
 	int we_pingpong_index;
@@ -0,0 +1,221 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+
+#include "msm_cam_frame.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/msm_camera_trace.h>
+
+/*
+ * Per frame pipeline timestamps. A record is keyed by session and frame
+ * id and is opened by the first stage the frame goes through, normally the
+ * SOF of the VFE input. Each later stage stamps the record once, so with
+ * several streams per session a stage holds the time of its first stream.
+ * Records live in a ring and the oldest one is reused for a new frame.
+ */
+
+#define MSM_CAM_FRAME_ENTRY	64
+
+struct msm_cam_frame_record {
+	uint32_t session_id;
+	uint32_t frame_id;
+	ktime_t t[MSM_CAM_FRAME_STAGE_MAX];
+};
+
+static struct {
+	struct msm_cam_frame_record records[MSM_CAM_FRAME_ENTRY];
+	int first;
+	int cnt;
+	u32 enable;
+	spinlock_t lock;
+	struct dentry *dir;
+} msm_cam_frame = {
+	.enable = 1,
+	.lock = __SPIN_LOCK_UNLOCKED(msm_cam_frame.lock),
+};
+
+static const char * const msm_cam_frame_stage_names[] = {
+	[MSM_CAM_FRAME_SOF] = "sof",
+	[MSM_CAM_FRAME_ISP_DONE] = "isp",
+	[MSM_CAM_FRAME_CPP_START] = "cpp_start",
+	[MSM_CAM_FRAME_CPP_DONE] = "cpp_done",
+	[MSM_CAM_FRAME_JPEG_START] = "jpeg_start",
+	[MSM_CAM_FRAME_JPEG_DONE] = "jpeg_done",
+	[MSM_CAM_FRAME_DQBUF] = "dqbuf",
+};
+
+static ktime_t msm_cam_frame_first(struct msm_cam_frame_record *rec)
+{
+	int stage;
+
+	for (stage = 0; stage < MSM_CAM_FRAME_STAGE_MAX; stage++) {
+		if (ktime_to_ns(rec->t[stage]))
+			return rec->t[stage];
+	}
+	return ktime_set(0, 0);
+}
+
+static struct msm_cam_frame_record *msm_cam_frame_find(uint32_t session_id,
+	uint32_t frame_id)
+{
+	struct msm_cam_frame_record *rec;
+	int i, n;
+
+	/* Newest first, a frame moves through the pipeline in a few frames */
+	i = msm_cam_frame.first;
+	for (n = 0; n < msm_cam_frame.cnt; n++) {
+		i = (i + MSM_CAM_FRAME_ENTRY - 1) % MSM_CAM_FRAME_ENTRY;
+		rec = &msm_cam_frame.records[i];
+		if (rec->session_id == session_id && rec->frame_id == frame_id)
+			return rec;
+	}
+	return NULL;
+}
+
+/**
+ * msm_cam_frame_stamp() - Timestamp a pipeline stage of a frame
+ * @session_id: Camera session the frame belongs to
+ * @frame_id: Frame id from the VFE, as seen by all later stages
+ * @stage: Stage the frame just went through
+ *
+ * Can be called from any context. Every stamp is also emitted as a
+ * msm_cam_frame_stage trace event with the time since the first stage of
+ * the frame.
+ */
+void msm_cam_frame_stamp(uint32_t session_id, uint32_t frame_id,
+	enum msm_cam_frame_stage stage)
+{
+	struct msm_cam_frame_record *rec;
+	unsigned long flags;
+	ktime_t now, first;
+
+	if (!msm_cam_frame.enable || stage >= MSM_CAM_FRAME_STAGE_MAX)
+		return;
+
+	now = ktime_get();
+	spin_lock_irqsave(&msm_cam_frame.lock, flags);
+	rec = msm_cam_frame_find(session_id, frame_id);
+	if (!rec) {
+		rec = &msm_cam_frame.records[msm_cam_frame.first];
+		memset(rec, 0, sizeof(*rec));
+		rec->session_id = session_id;
+		rec->frame_id = frame_id;
+		msm_cam_frame.first =
+			(msm_cam_frame.first + 1) % MSM_CAM_FRAME_ENTRY;
+		if (msm_cam_frame.cnt < MSM_CAM_FRAME_ENTRY)
+			msm_cam_frame.cnt++;
+	}
+	if (!ktime_to_ns(rec->t[stage]))
+		rec->t[stage] = now;
+	first = msm_cam_frame_first(rec);
+	spin_unlock_irqrestore(&msm_cam_frame.lock, flags);
+
+	trace_msm_cam_frame_stage(session_id, frame_id, stage,
+		ktime_us_delta(now, first));
+}
+EXPORT_SYMBOL(msm_cam_frame_stamp);
+
+static int msm_cam_frame_records_show(struct seq_file *s, void *unused)
+{
+	struct msm_cam_frame_record *rec;
+	unsigned long flags;
+	ktime_t first;
+	int i, n, stage;
+
+	seq_puts(s, "session frame");
+	for (stage = 0; stage < MSM_CAM_FRAME_STAGE_MAX; stage++)
+		seq_printf(s, " %s", msm_cam_frame_stage_names[stage]);
+	seq_puts(s, " (us from first stage)\n");
+
+	spin_lock_irqsave(&msm_cam_frame.lock, flags);
+	i = (msm_cam_frame.first + MSM_CAM_FRAME_ENTRY - msm_cam_frame.cnt) %
+		MSM_CAM_FRAME_ENTRY;
+	for (n = 0; n < msm_cam_frame.cnt; n++) {
+		rec = &msm_cam_frame.records[i];
+		first = msm_cam_frame_first(rec);
+		if (rec->session_id == MSM_CAM_FRAME_JPEG_SESSION)
+			seq_printf(s, "jpeg %u", rec->frame_id);
+		else
+			seq_printf(s, "%u %u", rec->session_id, rec->frame_id);
+		for (stage = 0; stage < MSM_CAM_FRAME_STAGE_MAX; stage++) {
+			if (!ktime_to_ns(rec->t[stage]))
+				seq_puts(s, " -");
+			else
+				seq_printf(s, " %lld",
+					ktime_us_delta(rec->t[stage], first));
+		}
+		seq_puts(s, "\n");
+		i = (i + 1) % MSM_CAM_FRAME_ENTRY;
+	}
+	spin_unlock_irqrestore(&msm_cam_frame.lock, flags);
+
+	return 0;
+}
+
+static int msm_cam_frame_records_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_cam_frame_records_show, inode->i_private);
+}
+
+static ssize_t msm_cam_frame_records_write(struct file *file,
+	const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	/* any write clears the records */
+	spin_lock_irqsave(&msm_cam_frame.lock, flags);
+	msm_cam_frame.first = 0;
+	msm_cam_frame.cnt = 0;
+	spin_unlock_irqrestore(&msm_cam_frame.lock, flags);
+
+	return count;
+}
+
+static const struct file_operations msm_cam_frame_records_fops = {
+	.open = msm_cam_frame_records_open,
+	.read = seq_read,
+	.write = msm_cam_frame_records_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_cam_frame_init(void)
+{
+	msm_cam_frame.dir = debugfs_create_dir("msm_camera_frame", NULL);
+	if (IS_ERR_OR_NULL(msm_cam_frame.dir)) {
+		pr_err("%s: debugfs_create_dir fail\n", __func__);
+		msm_cam_frame.dir = NULL;
+		return 0;
+	}
+	debugfs_create_file("records", 0644, msm_cam_frame.dir, NULL,
+		&msm_cam_frame_records_fops);
+	debugfs_create_bool("enable", 0644, msm_cam_frame.dir,
+		&msm_cam_frame.enable);
+	return 0;
+}
+
+static void __exit msm_cam_frame_exit(void)
+{
+	debugfs_remove_recursive(msm_cam_frame.dir);
+}
+
+module_init(msm_cam_frame_init);
+module_exit(msm_cam_frame_exit);
+MODULE_DESCRIPTION("MSM camera frame latency records");
+MODULE_LICENSE("GPL v2");
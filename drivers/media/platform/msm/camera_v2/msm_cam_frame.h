@@ -0,0 +1,35 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _MSM_CAM_FRAME_H
+#define _MSM_CAM_FRAME_H
+
+#include <linux/types.h>
+
+/* JPEG jobs carry no frame id, they are keyed by a per device job count */
+#define MSM_CAM_FRAME_JPEG_SESSION	0xFFFFFFFF
+
+enum msm_cam_frame_stage {
+	MSM_CAM_FRAME_SOF,
+	MSM_CAM_FRAME_ISP_DONE,
+	MSM_CAM_FRAME_CPP_START,
+	MSM_CAM_FRAME_CPP_DONE,
+	MSM_CAM_FRAME_JPEG_START,
+	MSM_CAM_FRAME_JPEG_DONE,
+	MSM_CAM_FRAME_DQBUF,
+	MSM_CAM_FRAME_STAGE_MAX,
+};
+
+void msm_cam_frame_stamp(uint32_t session_id, uint32_t frame_id,
+	enum msm_cam_frame_stage stage);
+
+#endif /* _MSM_CAM_FRAME_H */
@@ -41,6 +41,7 @@
 #include "msm_cpp.h"
 #include "msm_isp_util.h"
 #include "msm_camera_io_util.h"
+#include "msm_cam_frame.h"
 #include <linux/debugfs.h>
 
 #define MSM_CPP_DRV_NAME "msm_cpp"
@@ -1091,6 +1092,8 @@ static int msm_cpp_notify_frame_done(struct cpp_device *cpp_dev,
 	if (frame_qcmd) {
 		processed_frame = frame_qcmd->command;
 		do_gettimeofday(&(processed_frame->out_time));
+		msm_cam_frame_stamp((processed_frame->identity >> 16) & 0xFFFF,
+			processed_frame->frame_id, MSM_CAM_FRAME_CPP_DONE);
 		kfree(frame_qcmd);
 		event_qcmd = kzalloc(sizeof(struct msm_queue_cmd), GFP_ATOMIC);
 		if (!event_qcmd) {
@@ -1249,6 +1252,8 @@ static int msm_cpp_send_frame_to_hardware(struct cpp_device *cpp_dev,
 		process_frame = frame_qcmd->command;
 		msm_enqueue(&cpp_dev->processing_q,
 					&frame_qcmd->list_frame);
+		msm_cam_frame_stamp((process_frame->identity >> 16) & 0xFFFF,
+			process_frame->frame_id, MSM_CAM_FRAME_CPP_START);
 
 		cpp_timer.data.processed_frame = process_frame;
 		atomic_set(&cpp_timer.used, 1);
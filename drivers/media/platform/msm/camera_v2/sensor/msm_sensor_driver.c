@@ -1018,7 +1018,7 @@ static struct i2c_driver msm_sensor_driver_i2c = {
 	},
 };
 
-static int __init msm_sensor_driver_init(void)
+static int msm_sensor_driver_init(void)
 {
 	int32_t rc = 0;
 
@@ -1045,7 +1045,7 @@ static void __exit msm_sensor_driver_exit(void)
 	return;
 }
 
-module_init(msm_sensor_driver_init);
+deferred_initcall(msm_sensor_driver_init);
 module_exit(msm_sensor_driver_exit);
 MODULE_DESCRIPTION("msm_sensor_driver");
 MODULE_LICENSE("GPL v2");
@@ -341,6 +341,7 @@ static int msm_vidc_initialize_core(struct platform_device *pdev,
 	}
 
 	INIT_DELAYED_WORK(&core->fw_unload_work, msm_vidc_fw_unload_handler);
+	spin_lock_init(&core->caps_lock);
 	return rc;
 }
 
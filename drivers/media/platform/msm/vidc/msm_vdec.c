@@ -1068,6 +1068,13 @@ int msm_vdec_s_fmt(struct msm_vidc_inst *inst, struct v4l2_format *f)
 			goto err_invalid_fmt;
 		}
 		inst->fmts[fmt->type] = fmt;
+		msm_comm_get_cached_capability(inst);
+		rc = msm_vidc_check_session_supported(inst);
+		if (rc) {
+			dprintk(VIDC_ERR,
+				"%s: session not supported\n", __func__);
+			goto err_invalid_fmt;
+		}
 		rc = msm_comm_try_state(inst, MSM_VIDC_OPEN_DONE);
 		if (rc) {
 			dprintk(VIDC_ERR, "Failed to open instance\n");
@@ -1309,7 +1316,9 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 		}
 	}
 
+	/* Everything queued before stream on goes out with one doorbell */
 	mutex_lock(&inst->pendingq.lock);
+	call_hfi_op(hdev, cmdq_batch_begin, hdev->hfi_device_data);
 	list_for_each_safe(ptr, next, &inst->pendingq.list) {
 		temp = list_entry(ptr, struct vb2_buf_entry, list);
 		rc = msm_comm_qbuf(temp->vb);
@@ -1321,6 +1330,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 		list_del(&temp->list);
 		kfree(temp);
 	}
+	call_hfi_op(hdev, cmdq_batch_end, hdev->hfi_device_data);
 	mutex_unlock(&inst->pendingq.lock);
 	return rc;
 fail_start:
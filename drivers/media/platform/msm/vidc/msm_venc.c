@@ -1063,11 +1063,13 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 	int rc = 0;
 	struct vb2_buf_entry *temp;
 	struct list_head *ptr, *next;
+	struct hfi_device *hdev;
 
 	if (!inst || !inst->core || !inst->core->device) {
 		dprintk(VIDC_ERR, "%s invalid parameters\n", __func__);
 		return -EINVAL;
 	}
+	hdev = inst->core->device;
 
 	if (inst->capability.pixelprocess_capabilities &
 		HAL_VIDEO_ENCODER_SCALING_CAPABILITY)
@@ -1102,7 +1104,9 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 		goto fail_start;
 	}
 
+	/* Everything queued before stream on goes out with one doorbell */
 	mutex_lock(&inst->pendingq.lock);
+	call_hfi_op(hdev, cmdq_batch_begin, hdev->hfi_device_data);
 	list_for_each_safe(ptr, next, &inst->pendingq.list) {
 		temp = list_entry(ptr, struct vb2_buf_entry, list);
 		rc = msm_comm_qbuf(temp->vb);
@@ -1114,6 +1118,7 @@ static inline int start_streaming(struct msm_vidc_inst *inst)
 		list_del(&temp->list);
 		kfree(temp);
 	}
+	call_hfi_op(hdev, cmdq_batch_end, hdev->hfi_device_data);
 	mutex_unlock(&inst->pendingq.lock);
 	return rc;
 fail_start:
@@ -2698,6 +2703,7 @@ int msm_venc_s_fmt(struct msm_vidc_inst *inst, struct v4l2_format *f)
 		inst->fmts[fmt->type] = fmt;
 		if (f->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
 			struct hal_frame_size frame_sz;
+			msm_comm_get_cached_capability(inst);
 			rc = msm_comm_try_state(inst, MSM_VIDC_OPEN_DONE);
 			if (rc) {
 				dprintk(VIDC_ERR, "Failed to open instance\n");
@@ -379,10 +379,64 @@ static inline void repopulate_v4l2_buffer(struct v4l2_buffer *b,
 	}
 }
 
+/* Unused mappings kept per instance, on top of the ones in use */
+#define MAP_CACHE_MAX_IDLE 32
+
+static void map_cache_evict(struct msm_vidc_inst *inst, bool all,
+		u32 type_mask)
+{
+	struct msm_vidc_map_cache_entry *entry, *dummy;
+	int idle = 0;
+
+	WARN(!mutex_is_locked(&inst->map_cache.lock),
+		"Map cache lock is not acquired for %s", __func__);
+
+	/* The list is kept most recently used first */
+	list_for_each_entry_safe(entry, dummy, &inst->map_cache.list, list) {
+		if (entry->refcount)
+			continue;
+		if (!all && ++idle <= MAP_CACHE_MAX_IDLE)
+			continue;
+		if (all && !(entry->buffer_type & type_mask))
+			continue;
+		dprintk(VIDC_DBG, "[MAP CACHE] evict handle = %pK\n",
+			entry->handle);
+		list_del(&entry->list);
+		msm_comm_smem_free(inst, entry->handle);
+		kfree(entry);
+	}
+}
+
 static struct msm_smem *map_buffer(struct msm_vidc_inst *inst,
 		struct v4l2_plane *p, enum hal_buffer buffer_type)
 {
+	struct msm_vidc_map_cache_entry *entry;
 	struct msm_smem *handle = NULL;
+
+	mutex_lock(&inst->map_cache.lock);
+	list_for_each_entry(entry, &inst->map_cache.list, list) {
+		if (entry->buffer_type == buffer_type &&
+			msm_smem_compare_buffers(inst->mem_client,
+				p->reserved[0], entry->handle->smem_priv)) {
+			/*
+			 * The buffer was cleaned when it was first mapped and
+			 * has been written by the core only since then.
+			 */
+			entry->refcount++;
+			list_move(&entry->list, &inst->map_cache.list);
+			dprintk(VIDC_DBG, "[MAP CACHE] hit handle = %pK\n",
+				entry->handle);
+			handle = entry->handle;
+			goto exit;
+		}
+	}
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry) {
+		dprintk(VIDC_ERR, "Out of memory\n");
+		goto exit;
+	}
+
 	handle = msm_comm_smem_user_to_kernel(inst,
 				p->reserved[0],
 				p->reserved[1],
@@ -390,7 +444,8 @@ static struct msm_smem *map_buffer(struct msm_vidc_inst *inst,
 	if (!handle) {
 		dprintk(VIDC_ERR,
 			"%s: Failed to get device buffer address\n", __func__);
-		return NULL;
+		kfree(entry);
+		goto exit;
 	}
 	if (msm_comm_smem_cache_operations(inst, handle,
 			SMEM_CACHE_CLEAN))
@@ -399,9 +454,50 @@ static struct msm_smem *map_buffer(struct msm_vidc_inst *inst,
 				p->reserved[0],
 				p->reserved[1],
 				p->length);
+
+	entry->handle = handle;
+	entry->buffer_type = buffer_type;
+	entry->refcount = 1;
+	list_add(&entry->list, &inst->map_cache.list);
+exit:
+	mutex_unlock(&inst->map_cache.lock);
 	return handle;
 }
 
+/*
+ * Drops a buffer_info's reference on a mapping made by map_buffer(). The
+ * mapping itself stays in the cache until it is evicted.
+ */
+static void unmap_buffer(struct msm_vidc_inst *inst, struct msm_smem *handle)
+{
+	struct msm_vidc_map_cache_entry *entry;
+	bool found = false;
+
+	mutex_lock(&inst->map_cache.lock);
+	list_for_each_entry(entry, &inst->map_cache.list, list) {
+		if (entry->handle == handle) {
+			if (entry->refcount > 0)
+				entry->refcount--;
+			found = true;
+			break;
+		}
+	}
+	if (found)
+		map_cache_evict(inst, false, 0);
+	mutex_unlock(&inst->map_cache.lock);
+
+	if (!found)
+		msm_comm_smem_free(inst, handle);
+}
+
+/* Frees the unused mappings of the buffer types in @type_mask */
+static void flush_map_cache(struct msm_vidc_inst *inst, u32 type_mask)
+{
+	mutex_lock(&inst->map_cache.lock);
+	map_cache_evict(inst, true, type_mask);
+	mutex_unlock(&inst->map_cache.lock);
+}
+
 static inline enum hal_buffer get_hal_buffer_type(
 		struct msm_vidc_inst *inst, struct v4l2_buffer *b)
 {
@@ -621,8 +717,7 @@ int unmap_and_deregister_buf(struct msm_vidc_inst *inst,
 			dprintk(VIDC_DBG,
 				"[UNMAP] - handle[%d] = %p fd[%d] = %d",
 				i, temp->handle[i], i, temp->fd[i]);
-			msm_comm_smem_free(inst,
-				temp->handle[i]);
+			unmap_buffer(inst, temp->handle[i]);
 		}
 
 		if (temp->same_fd_ref[i])
@@ -756,6 +851,7 @@ int msm_vidc_release_buffers(void *instance, int buffer_type)
 	struct buffer_info *bi, *dummy;
 	struct v4l2_buffer buffer_info;
 	struct v4l2_plane plane[VIDEO_MAX_PLANES];
+	u32 hal_types = 0;
 	int i, rc = 0;
 
 	if (!inst)
@@ -830,14 +926,18 @@ free_and_unmap:
 						__func__, bi, i, bi->handle[i],
 						bi->device_addr[i], bi->fd[i],
 						bi->buff_off[i], bi->mapped[i]);
-					msm_comm_smem_free(inst,
-							bi->handle[i]);
+					hal_types |= bi->handle[i]->buffer_type;
+					unmap_buffer(inst, bi->handle[i]);
 				}
 			}
 			kfree(bi);
 		}
 	}
 	mutex_unlock(&inst->registeredbufs.lock);
+
+	/* The client is done with this set of buffers, don't pin them */
+	if (hal_types)
+		flush_map_cache(inst, hal_types);
 	return rc;
 }
 
@@ -1237,8 +1337,11 @@ void *msm_vidc_open(int core_id, int session_type)
 	INIT_MSM_VIDC_LIST(&inst->persistbufs);
 	INIT_MSM_VIDC_LIST(&inst->outputbufs);
 	INIT_MSM_VIDC_LIST(&inst->registeredbufs);
+	INIT_MSM_VIDC_LIST(&inst->map_cache);
 
 	init_waitqueue_head(&inst->kernel_event_queue);
+	spin_lock_init(&inst->feedback.lock);
+	inst->feedback.scale_pct = 100;
 	inst->state = MSM_VIDC_CORE_UNINIT_DONE;
 	inst->core = core;
 	inst->map_output_buffer = false;
@@ -1365,8 +1468,8 @@ int msm_vidc_close(void *instance)
 			list_del(&bi->list);
 			for (i = 0; (i < bi->num_planes)
 				&& (i < VIDEO_MAX_PLANES); i++) {
-				if (bi->handle[i])
-					msm_comm_smem_free(inst, bi->handle[i]);
+				if (bi->handle[i] && bi->mapped[i])
+					unmap_buffer(inst, bi->handle[i]);
 			}
 			kfree(bi);
 		}
@@ -1402,6 +1505,7 @@ int msm_vidc_close(void *instance)
 
 	msm_comm_session_clean(inst);
 
+	flush_map_cache(inst, ~0);
 	msm_smem_delete_client(inst->mem_client);
 	pr_info(VIDC_DBG_TAG "Closed video instance: %pK\n", VIDC_INFO, inst);
 	kfree(inst);
@@ -49,6 +49,7 @@
 static void msm_comm_generate_session_error(struct msm_vidc_inst *inst);
 static void msm_comm_generate_sys_error(struct msm_vidc_inst *inst);
 static void handle_session_error(enum command_response cmd, void *data);
+static int msm_comm_scale_clocks(struct msm_vidc_core *core);
 
 static inline bool is_turbo_session(struct msm_vidc_inst *inst)
 {
@@ -116,8 +117,114 @@ enum load_calc_quirks {
 	LOAD_CALC_IGNORE_TURBO_LOAD = 1 << 0,
 	LOAD_CALC_IGNORE_THUMBNAIL_LOAD = 1 << 1,
 	LOAD_CALC_IGNORE_NON_REALTIME_LOAD = 1 << 2,
+	LOAD_CALC_APPLY_FEEDBACK = 1 << 3,
 };
 
+/* Lowest clock load, in percent of the nominal load, feedback can reach */
+#define FEEDBACK_MIN_PCT 40
+/* Ignore changes smaller than this, in percent, to avoid clock dithering */
+#define FEEDBACK_HYSTERESIS_PCT 5
+
+static bool msm_comm_feedback_eligible(struct msm_vidc_inst *inst)
+{
+	return msm_vidc_load_feedback && inst->prop.fps &&
+		!is_turbo_session(inst) && !is_thumbnail_session(inst) &&
+		!is_non_realtime_session(inst);
+}
+
+static void msm_comm_feedback_reset(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_load_feedback *fb = &inst->feedback;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fb->lock, flags);
+	fb->etb_tail = fb->etb_head;
+	fb->busy_us = 0;
+	fb->frames = 0;
+	spin_unlock_irqrestore(&fb->lock, flags);
+}
+
+static void msm_comm_feedback_etb(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_load_feedback *fb = &inst->feedback;
+	unsigned long flags;
+
+	spin_lock_irqsave(&fb->lock, flags);
+	if (fb->etb_head - fb->etb_tail < MSM_VIDC_FEEDBACK_PENDING) {
+		fb->etb_time[fb->etb_head % MSM_VIDC_FEEDBACK_PENDING] =
+			ktime_get();
+		fb->etb_head++;
+	} else {
+		/* Lost track of the pending buffers, start a new window */
+		fb->etb_tail = fb->etb_head;
+		fb->busy_us = 0;
+		fb->frames = 0;
+	}
+	spin_unlock_irqrestore(&fb->lock, flags);
+}
+
+/*
+ * Accounts the busy time of the input buffer the firmware just returned
+ * and, at the end of each window, moves the session's clock load scale
+ * so that the average busy time is msm_vidc_load_feedback_target percent
+ * of the frame period. A window over the frame period jumps back to the
+ * nominal load right away so frames aren't dropped while converging.
+ * Returns true if the scale changed.
+ */
+static bool msm_comm_feedback_ebd(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_load_feedback *fb = &inst->feedback;
+	unsigned long flags;
+	ktime_t now = ktime_get(), start;
+	u32 util, scale;
+	bool changed = false;
+
+	if (!msm_comm_feedback_eligible(inst)) {
+		changed = fb->scale_pct != 100;
+		fb->scale_pct = 100;
+		return changed;
+	}
+
+	spin_lock_irqsave(&fb->lock, flags);
+	if (fb->etb_head == fb->etb_tail)
+		goto exit;
+
+	start = fb->etb_time[fb->etb_tail % MSM_VIDC_FEEDBACK_PENDING];
+	fb->etb_tail++;
+	if (ktime_to_ns(fb->last_done) > ktime_to_ns(start))
+		start = fb->last_done;
+	fb->busy_us += ktime_us_delta(now, start);
+	fb->last_done = now;
+
+	if (++fb->frames < MSM_VIDC_FEEDBACK_WINDOW)
+		goto exit;
+
+	/* Average busy time in percent of the frame period */
+	util = div_s64(fb->busy_us * inst->prop.fps * 100,
+			fb->frames * USEC_PER_SEC);
+	fb->busy_us = 0;
+	fb->frames = 0;
+
+	if (util >= 100)
+		scale = 100;
+	else
+		scale = clamp_t(u32, fb->scale_pct * util /
+			max_t(u32, msm_vidc_load_feedback_target, 1),
+			FEEDBACK_MIN_PCT, 100);
+
+	if (scale == 100 || abs((int)scale - (int)fb->scale_pct) >=
+			FEEDBACK_HYSTERESIS_PCT) {
+		changed = scale != fb->scale_pct;
+		fb->scale_pct = scale;
+	}
+
+	dprintk(VIDC_PROF, "%s: inst %pK busy %u%% of frame period, load %u%%\n",
+		__func__, inst, util, fb->scale_pct);
+exit:
+	spin_unlock_irqrestore(&fb->lock, flags);
+	return changed;
+}
+
 static int msm_comm_get_inst_load(struct msm_vidc_inst *inst,
 		enum load_calc_quirks quirks)
 {
@@ -129,6 +236,10 @@ static int msm_comm_get_inst_load(struct msm_vidc_inst *inst,
 
 	load = msm_comm_get_mbs_per_sec(inst);
 
+	if ((quirks & LOAD_CALC_APPLY_FEEDBACK) &&
+		msm_comm_feedback_eligible(inst))
+		load = load * inst->feedback.scale_pct / 100;
+
 	if (is_thumbnail_session(inst)) {
 		if (quirks & LOAD_CALC_IGNORE_THUMBNAIL_LOAD)
 			load = 0;
@@ -484,6 +595,88 @@ static void msm_comm_generate_max_clients_error(struct msm_vidc_inst *inst)
 	handle_session_error(cmd, (void *)&response);
 }
 
+static u32 msm_comm_get_session_fourcc(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_format *fmt = NULL;
+
+	if (inst->session_type == MSM_VIDC_DECODER)
+		fmt = inst->fmts[OUTPUT_PORT];
+	else if (inst->session_type == MSM_VIDC_ENCODER)
+		fmt = inst->fmts[CAPTURE_PORT];
+	return fmt ? fmt->fourcc : 0;
+}
+
+static struct msm_vidc_caps_cache_entry *msm_comm_find_cached_capability(
+		struct msm_vidc_core *core, int session_type, u32 fourcc)
+{
+	int i;
+
+	for (i = 0; i < core->caps_cache_cnt; i++) {
+		if (core->caps_cache[i].session_type == session_type &&
+			core->caps_cache[i].fourcc == fourcc)
+			return &core->caps_cache[i];
+	}
+	return NULL;
+}
+
+static void msm_comm_cache_capability(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_core *core = inst->core;
+	struct msm_vidc_caps_cache_entry *entry;
+	u32 fourcc = msm_comm_get_session_fourcc(inst);
+	unsigned long flags;
+
+	if (!fourcc)
+		return;
+
+	spin_lock_irqsave(&core->caps_lock, flags);
+	entry = msm_comm_find_cached_capability(core, inst->session_type,
+			fourcc);
+	if (!entry && core->caps_cache_cnt < MSM_VIDC_CAPS_CACHE_SIZE) {
+		entry = &core->caps_cache[core->caps_cache_cnt++];
+		entry->session_type = inst->session_type;
+		entry->fourcc = fourcc;
+	}
+	if (entry)
+		entry->capability = inst->capability;
+	spin_unlock_irqrestore(&core->caps_lock, flags);
+}
+
+/**
+ * msm_comm_get_cached_capability() - Fill in the capabilities of a session
+ * @inst: Instance whose codec format has just been set
+ *
+ * Copies the capabilities an earlier session of the same type and codec
+ * got in its SESSION_INIT_DONE, so the format can be checked and the frame
+ * sizes enumerated before this session is opened on the firmware. The
+ * session's own SESSION_INIT_DONE overwrites them.
+ */
+void msm_comm_get_cached_capability(struct msm_vidc_inst *inst)
+{
+	struct msm_vidc_caps_cache_entry *entry;
+	unsigned long flags;
+	u32 fourcc;
+
+	if (!inst || !inst->core) {
+		dprintk(VIDC_ERR, "%s invalid parameters\n", __func__);
+		return;
+	}
+	if (inst->capability.capability_set)
+		return;
+
+	fourcc = msm_comm_get_session_fourcc(inst);
+	spin_lock_irqsave(&inst->core->caps_lock, flags);
+	entry = msm_comm_find_cached_capability(inst->core,
+			inst->session_type, fourcc);
+	if (entry)
+		inst->capability = entry->capability;
+	spin_unlock_irqrestore(&inst->core->caps_lock, flags);
+
+	if (entry)
+		dprintk(VIDC_DBG, "Using cached capabilities for %#x\n",
+			fourcc);
+}
+
 static void handle_session_init_done(enum command_response cmd, void *data)
 {
 	struct msm_vidc_cb_cmd_done *response = data;
@@ -519,6 +712,7 @@ static void handle_session_init_done(enum command_response cmd, void *data)
 			inst->capability.capability_set = true;
 			inst->capability.buffer_mode[CAPTURE_PORT] =
 				session_init_done->alloc_mode_out;
+			msm_comm_cache_capability(inst);
 		} else {
 			dprintk(VIDC_ERR,
 				"Session init response from FW : 0x%x",
@@ -811,6 +1005,7 @@ int msm_comm_queue_output_buffers(struct msm_vidc_inst *inst)
 		output_buf->buffer_size);
 
 	mutex_lock(&inst->outputbufs.lock);
+	call_hfi_op(hdev, cmdq_batch_begin, hdev->hfi_device_data);
 	list_for_each_entry(binfo, &inst->outputbufs.list, list) {
 		if (binfo->buffer_ownership != DRIVER)
 			continue;
@@ -827,6 +1022,7 @@ int msm_comm_queue_output_buffers(struct msm_vidc_inst *inst)
 			(void *) inst->session, &frame_data);
 		binfo->buffer_ownership = FIRMWARE;
 	}
+	call_hfi_op(hdev, cmdq_batch_end, hdev->hfi_device_data);
 	mutex_unlock(&inst->outputbufs.lock);
 	return 0;
 }
@@ -850,6 +1046,7 @@ static void handle_session_flush(enum command_response cmd, void *data)
 				}
 			}
 		}
+		msm_comm_feedback_reset(inst);
 		msm_vidc_queue_v4l2_event(inst, V4L2_EVENT_MSM_VIDC_FLUSH_DONE);
 	} else {
 		dprintk(VIDC_ERR, "Failed to get valid response for flush\n");
@@ -1095,6 +1292,11 @@ static void handle_ebd(enum command_response cmd, void *data)
 		mutex_unlock(&inst->bufq[OUTPUT_PORT].lock);
 		wake_up(&inst->kernel_event_queue);
 		msm_vidc_debugfs_update(inst, MSM_VIDC_DEBUGFS_EVENT_EBD);
+
+		if (msm_comm_feedback_ebd(inst) &&
+			msm_comm_scale_clocks(inst->core))
+			dprintk(VIDC_WARN,
+				"Failed to rescale clocks on load feedback\n");
 	}
 }
 
@@ -1527,9 +1729,16 @@ static int msm_comm_scale_clocks(struct msm_vidc_core *core)
 		return -EINVAL;
 	}
 
+	/*
+	 * Clocks follow the measured firmware load. The decoder and encoder
+	 * bus votes keep using their own nominal tables: DDR traffic depends
+	 * on the frame size and rate, not on how busy the core is.
+	 */
 	num_mbs_per_sec =
-		msm_comm_get_load(core, MSM_VIDC_ENCODER, LOAD_CALC_NO_QUIRKS) +
-		msm_comm_get_load(core, MSM_VIDC_DECODER, LOAD_CALC_NO_QUIRKS);
+		msm_comm_get_load(core, MSM_VIDC_ENCODER,
+			LOAD_CALC_APPLY_FEEDBACK) +
+		msm_comm_get_load(core, MSM_VIDC_DECODER,
+			LOAD_CALC_APPLY_FEEDBACK);
 
 
 	dprintk(VIDC_INFO, "num_mbs_per_sec = %d\n", num_mbs_per_sec);
@@ -2596,9 +2805,11 @@ int msm_comm_qbuf(struct vb2_buffer *vb)
 				frame_data.timestamp, frame_data.flags);
 			rc = call_hfi_op(hdev, session_etb, (void *)
 					inst->session, &frame_data);
-			if (!rc)
+			if (!rc) {
 				msm_vidc_debugfs_update(inst,
 					MSM_VIDC_DEBUGFS_EVENT_ETB);
+				msm_comm_feedback_etb(inst);
+			}
 			dprintk(VIDC_DBG, "Sent etb to HAL\n");
 		} else if (q->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
 			struct vidc_seq_hdr seq_hdr;
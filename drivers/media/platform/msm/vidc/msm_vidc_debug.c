@@ -11,6 +11,7 @@
  *
  */
 
+#include <linux/module.h>
 #include "msm_vidc_debug.h"
 #include "vidc_hfi_api.h"
 
@@ -22,6 +23,16 @@ int msm_fw_debug_mode = 0x1;
 int msm_fw_low_power_mode = 0x1;
 int msm_vidc_hw_rsp_timeout = 1000;
 u32 msm_vidc_firmware_unload_delay = 15000;
+u32 msm_vidc_load_feedback = 1;
+u32 msm_vidc_load_feedback_target = 80;
+
+/*
+ * How long the firmware stays loaded and booted after the last session
+ * closes, so that a following session doesn't pay for the firmware load and
+ * SYS_INIT. Settable at boot and on builds without debugfs.
+ */
+module_param_named(firmware_unload_delay, msm_vidc_firmware_unload_delay,
+		uint, S_IRUGO | S_IWUSR);
 
 struct debug_buffer {
 	struct mutex lock;
@@ -194,6 +205,16 @@ struct dentry *msm_vidc_debugfs_init_drv(void)
 		dprintk(VIDC_ERR, "debugfs_create_file: fail\n");
 		goto failed_create_dir;
 	}
+	if (!debugfs_create_u32("load_feedback", S_IRUGO | S_IWUSR,
+			dir, &msm_vidc_load_feedback)) {
+		dprintk(VIDC_ERR, "debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
+	if (!debugfs_create_u32("load_feedback_target", S_IRUGO | S_IWUSR,
+			dir, &msm_vidc_load_feedback_target)) {
+		dprintk(VIDC_ERR, "debugfs_create_file: fail\n");
+		goto failed_create_dir;
+	}
 	return dir;
 
 failed_create_dir:
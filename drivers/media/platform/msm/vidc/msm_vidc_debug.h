@@ -54,6 +54,8 @@ extern int msm_fw_low_power_mode;
 extern int msm_vp8_low_tier;
 extern int msm_vidc_hw_rsp_timeout;
 extern u32 msm_vidc_firmware_unload_delay;
+extern u32 msm_vidc_load_feedback;
+extern u32 msm_vidc_load_feedback_target;
 
 #define dprintk(__level, __fmt, arg...)	\
 	do { \
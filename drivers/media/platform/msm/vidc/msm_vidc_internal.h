@@ -17,6 +17,8 @@
 #include <linux/atomic.h>
 #include <linux/list.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 #include <linux/completion.h>
 #include <linux/wait.h>
@@ -210,6 +212,20 @@ struct msm_vidc_core_capability {
 	u32 buffer_size_limit;
 };
 
+#define MSM_VIDC_CAPS_CACHE_SIZE 16
+
+/*
+ * Capabilities reported by the firmware in SESSION_INIT_DONE, per session
+ * type and codec. They only depend on the firmware image, so they are kept
+ * across firmware unloads and let a new session validate its format before
+ * its own session init has completed.
+ */
+struct msm_vidc_caps_cache_entry {
+	int session_type;
+	u32 fourcc;
+	struct msm_vidc_core_capability capability;
+};
+
 struct msm_vidc_core {
 	struct list_head list;
 	struct mutex lock;
@@ -226,6 +242,41 @@ struct msm_vidc_core {
 	u32 enc_codec_supported;
 	u32 dec_codec_supported;
 	struct delayed_work fw_unload_work;
+	spinlock_t caps_lock;
+	struct msm_vidc_caps_cache_entry caps_cache[MSM_VIDC_CAPS_CACHE_SIZE];
+	int caps_cache_cnt;
+};
+
+#define MSM_VIDC_FEEDBACK_PENDING 32
+#define MSM_VIDC_FEEDBACK_WINDOW 30
+
+/*
+ * Per session estimate of the firmware busy time per input buffer: the
+ * time from an ETB, or from the previous EBD if the firmware was still
+ * busy with it, to its EBD. Averaged over MSM_VIDC_FEEDBACK_WINDOW frames
+ * and compared to the frame period, it scales the session clock load.
+ */
+struct msm_vidc_load_feedback {
+	spinlock_t lock;
+	ktime_t etb_time[MSM_VIDC_FEEDBACK_PENDING];
+	u32 etb_head;
+	u32 etb_tail;
+	ktime_t last_done;
+	s64 busy_us;
+	u32 frames;
+	u32 scale_pct;
+};
+
+/*
+ * A user buffer mapping kept around after its buffer_info is gone, so the
+ * ION import, IOMMU map and cache clean are skipped when the same ION
+ * buffer is queued again. @refcount counts the buffer_infos using it.
+ */
+struct msm_vidc_map_cache_entry {
+	struct list_head list;
+	struct msm_smem *handle;
+	enum hal_buffer buffer_type;
+	int refcount;
 };
 
 struct msm_vidc_inst {
@@ -243,6 +294,7 @@ struct msm_vidc_inst {
 	struct msm_vidc_list persistbufs;
 	struct msm_vidc_list outputbufs;
 	struct msm_vidc_list registeredbufs;
+	struct msm_vidc_list map_cache;
 	struct buffer_requirements buff_req;
 	void *mem_client;
 	struct v4l2_ctrl_handler ctrl_handler;
@@ -267,6 +319,7 @@ struct msm_vidc_inst {
 
 	bool map_output_buffer;
 	struct v4l2_ctrl **ctrls;
+	struct msm_vidc_load_feedback feedback;
 };
 
 extern struct msm_vidc_drv *vidc_driver;
@@ -1575,11 +1575,19 @@ static int venus_hfi_iface_cmdq_write_nolock(struct venus_hfi_device *device,
 			dprintk(VIDC_ERR, "Clock scaling failed\n");
 			goto err_q_write;
 		}
-		if (rx_req_is_set)
+		if (rx_req_is_set && device->cmdq_batch &&
+			(cmd_packet->packet_type ==
+				HFI_CMD_SESSION_EMPTY_BUFFER ||
+			cmd_packet->packet_type ==
+				HFI_CMD_SESSION_FILL_BUFFER)) {
+			device->cmdq_doorbell = true;
+		} else if (rx_req_is_set || device->cmdq_doorbell) {
+			device->cmdq_doorbell = false;
 			venus_hfi_write_register(
 				device,
 				VIDC_CPU_IC_SOFTINT,
 				1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT, 0);
+		}
 		result = 0;
 	} else {
 		dprintk(VIDC_ERR, "venus_hfi_iface_cmdq_write:queue_full");
@@ -1589,7 +1597,88 @@ err_q_null:
 	return result;
 }
 
-static int venus_hfi_iface_msgq_read(struct venus_hfi_device *device, void *pkt)
+/**
+ * venus_hfi_cmdq_batch_begin() - Hold back the command queue doorbell
+ * @dev: venus_hfi_device the commands are written to
+ *
+ * Packets written until the matching venus_hfi_cmdq_batch_end() are put in
+ * the command queue right away, but the firmware is only interrupted once,
+ * when the last batch ends. Only ETB and FTB packets are held back, any
+ * other command rings the doorbell for everything queued before it, so a
+ * batch can't delay a command the caller waits on. Batches nest.
+ */
+static int venus_hfi_cmdq_batch_begin(void *dev)
+{
+	struct venus_hfi_device *device = dev;
+
+	if (!device) {
+		dprintk(VIDC_ERR, "%s invalid device\n", __func__);
+		return -EINVAL;
+	}
+	mutex_lock(&device->write_lock);
+	device->cmdq_batch++;
+	mutex_unlock(&device->write_lock);
+	return 0;
+}
+
+/**
+ * venus_hfi_cmdq_batch_end() - Ring the doorbell held back by a batch
+ * @dev: venus_hfi_device the commands were written to
+ */
+static int venus_hfi_cmdq_batch_end(void *dev)
+{
+	struct venus_hfi_device *device = dev;
+	int rc = 0;
+
+	if (!device) {
+		dprintk(VIDC_ERR, "%s invalid device\n", __func__);
+		return -EINVAL;
+	}
+	mutex_lock(&device->write_lock);
+	if (WARN_ON(device->cmdq_batch <= 0))
+		goto exit;
+	if (--device->cmdq_batch || !device->cmdq_doorbell)
+		goto exit;
+
+	device->cmdq_doorbell = false;
+	mutex_lock(&device->clk_pwr_lock);
+	if (!IS_VENUS_IN_VALID_STATE(device)) {
+		dprintk(VIDC_ERR, "%s - fw not in init state\n", __func__);
+		rc = -EINVAL;
+	} else {
+		rc = venus_hfi_clk_gating_off(device);
+		if (rc)
+			dprintk(VIDC_ERR, "%s : Clock enable failed\n",
+					__func__);
+		else
+			venus_hfi_write_register(device, VIDC_CPU_IC_SOFTINT,
+				1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT, 0);
+	}
+	mutex_unlock(&device->clk_pwr_lock);
+exit:
+	mutex_unlock(&device->write_lock);
+	return rc;
+}
+
+static void venus_hfi_msgq_doorbell(struct venus_hfi_device *device)
+{
+	mutex_lock(&device->clk_pwr_lock);
+	if (!venus_hfi_clk_gating_off(device))
+		venus_hfi_write_register(device, VIDC_CPU_IC_SOFTINT,
+			1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT, 0);
+	else
+		dprintk(VIDC_ERR, "%s : Clock enable failed\n", __func__);
+	mutex_unlock(&device->clk_pwr_lock);
+}
+
+/*
+ * The firmware sets tx_req when it wants to be told that the message queue
+ * has room again. Rather than interrupting it for every packet read, the
+ * request is returned in @tx_req and the caller rings once the queue has
+ * been drained.
+ */
+static int venus_hfi_iface_msgq_read(struct venus_hfi_device *device,
+		void *pkt, u32 *tx_req)
 {
 	u32 tx_req_is_set = 0;
 	int rc = 0;
@@ -1615,26 +1704,12 @@ static int venus_hfi_iface_msgq_read(struct venus_hfi_device *device, void *pkt)
 
 	q_info = &device->iface_queues[VIDC_IFACEQ_MSGQ_IDX];
 	if (!venus_hfi_read_queue(q_info, (u8 *)pkt, &tx_req_is_set)) {
-		mutex_lock(&device->clk_pwr_lock);
-		rc = venus_hfi_clk_gating_off(device);
-		if (rc) {
-			dprintk(VIDC_ERR,
-					"%s : Clock enable failed\n", __func__);
-			mutex_unlock(&device->clk_pwr_lock);
-			goto read_error;
-		}
-		if (tx_req_is_set)
-			venus_hfi_write_register(
-				device,
-				VIDC_CPU_IC_SOFTINT,
-				1 << VIDC_CPU_IC_SOFTINT_H2A_SHFT, 0);
+		*tx_req |= tx_req_is_set;
 		rc = 0;
-		mutex_unlock(&device->clk_pwr_lock);
 	} else {
 		dprintk(VIDC_INFO, "venus_hfi_iface_msgq_read:queue_empty");
 		rc = -ENODATA;
 	}
-read_error:
 read_error_null:
 	mutex_unlock(&device->read_lock);
 	return rc;
@@ -3065,7 +3140,7 @@ static void venus_hfi_process_msg_event_notify(
 static void venus_hfi_response_handler(struct venus_hfi_device *device)
 {
 	u8 packet[VIDC_IFACEQ_MED_PKT_SIZE];
-	u32 rc = 0;
+	u32 rc = 0, tx_req = 0;
 	struct hfi_sfr_struct *vsfr = NULL;
 	dprintk(VIDC_INFO, "#####venus_hfi_response_handler#####\n");
 	/* Process messages only if device is in valid state*/
@@ -3083,7 +3158,7 @@ static void venus_hfi_response_handler(struct venus_hfi_device *device)
 			venus_hfi_process_sys_watchdog_timeout(device);
 		}
 
-		while (!venus_hfi_iface_msgq_read(device, packet)) {
+		while (!venus_hfi_iface_msgq_read(device, packet, &tx_req)) {
 			/* During SYS_ERROR processing the device state
 			*  will be changed to DEINIT. Below check will
 			*  make sure no messages messages are read or
@@ -3115,6 +3190,8 @@ static void venus_hfi_response_handler(struct venus_hfi_device *device)
 						"Failed to allocate OCMEM. Performance will be impacted\n");
 			}
 		}
+		if (tx_req && device->state != VENUS_STATE_DEINIT)
+			venus_hfi_msgq_doorbell(device);
 		while (!venus_hfi_iface_dbgq_read(device, packet)) {
 			struct hfi_msg_sys_debug_packet *pkt =
 				(struct hfi_msg_sys_debug_packet *) packet;
@@ -4029,6 +4106,8 @@ static void venus_init_hfi_callbacks(struct hfi_device *hdev)
 	hdev->session_resume = venus_hfi_session_resume;
 	hdev->session_etb = venus_hfi_session_etb;
 	hdev->session_ftb = venus_hfi_session_ftb;
+	hdev->cmdq_batch_begin = venus_hfi_cmdq_batch_begin;
+	hdev->cmdq_batch_end = venus_hfi_cmdq_batch_end;
 	hdev->session_parse_seq_hdr = venus_hfi_session_parse_seq_hdr;
 	hdev->session_get_seq_hdr = venus_hfi_session_get_seq_hdr;
 	hdev->session_get_buf_req = venus_hfi_session_get_buf_req;
@@ -216,6 +216,8 @@ struct venus_hfi_device {
 	int spur_count;
 	int reg_count;
 	int pc_num_cmds;
+	int cmdq_batch;
+	bool cmdq_doorbell;
 	u32 base_addr;
 	u32 register_base;
 	u32 register_size;
@@ -1141,6 +1141,8 @@ struct hfi_device {
 			struct vidc_frame_data *input_frame);
 	int (*session_ftb)(void *sess,
 			struct vidc_frame_data *output_frame);
+	int (*cmdq_batch_begin)(void *dev);
+	int (*cmdq_batch_end)(void *dev);
 	int (*session_parse_seq_hdr)(void *sess,
 			struct vidc_seq_hdr *seq_hdr);
 	int (*session_get_seq_hdr)(void *sess,
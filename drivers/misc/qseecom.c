@@ -34,6 +34,7 @@
 #include <linux/firmware.h>
 #include <linux/freezer.h>
 #include <linux/scatterlist.h>
+#include <linux/dma-buf.h>
 #include <mach/board.h>
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
@@ -73,6 +74,11 @@
 
 #define QSEECOM_SEND_CMD_CRYPTO_TIMEOUT	2000
 #define QSEECOM_LOAD_APP_CRYPTO_TIMEOUT	2000
+/* shortest bus vote hold after a send command, see qseecom_send_cmd_hold() */
+#define QSEECOM_SEND_CMD_CRYPTO_MIN_TIMEOUT	100
+
+/* ion buffers of modfd commands kept imported per client */
+#define QSEECOM_ION_FD_CACHE_SZ	(2 * MAX_ION_FD)
 
 enum qseecom_clk_definitions {
 	CLK_DFAB = 0,
@@ -178,6 +184,13 @@ struct qseecom_control {
 	struct cdev cdev;
 	bool timer_running;
 	bool appsbl_qseecom_support;
+	unsigned long last_send_cmd;
+	uint32_t send_cmd_gap_ms;
+};
+
+struct qseecom_ion_fd_cache {
+	struct dma_buf *dmabuf;
+	struct ion_handle *ihandle;
 };
 
 struct qseecom_client_handle {
@@ -188,6 +201,8 @@ struct qseecom_client_handle {
 	size_t sb_length;
 	struct ion_handle *ihandle;		/* Retrieve phy addr */
 	char app_name[MAX_APP_NAME_SIZE];
+	struct qseecom_ion_fd_cache fd_cache[QSEECOM_ION_FD_CACHE_SZ];
+	unsigned int fd_cache_next;
 };
 
 struct qseecom_listener_handle {
@@ -688,6 +703,37 @@ static void __qseecom_add_bw_scale_down_timer(uint32_t duration)
 	mutex_unlock(&qsee_bw_mutex);
 }
 
+/*
+ * Returns how long the bus vote is held after a send command, in msecs.
+ * Clients like fingerprint and DRM send bursts of commands, and dropping
+ * the vote between two of them makes the next one pay the ramp up again.
+ * The hold follows the average gap between send commands: twice the
+ * gap, so that a burst keeps the vote, up to the fixed timeout. Commands
+ * spaced further apart than that would find the vote dropped anyway, so
+ * they only hold it for QSEECOM_SEND_CMD_CRYPTO_MIN_TIMEOUT.
+ *
+ * Called with app_access_lock held.
+ */
+static uint32_t qseecom_send_cmd_hold(void)
+{
+	unsigned long now = jiffies;
+	uint32_t gap, hold;
+
+	gap = min_t(unsigned long, jiffies_to_msecs(now -
+			qseecom.last_send_cmd),
+			2 * QSEECOM_SEND_CMD_CRYPTO_TIMEOUT);
+	qseecom.last_send_cmd = now;
+	qseecom.send_cmd_gap_ms = (3 * qseecom.send_cmd_gap_ms + gap) / 4;
+
+	hold = 2 * qseecom.send_cmd_gap_ms;
+	if (hold > QSEECOM_SEND_CMD_CRYPTO_TIMEOUT)
+		hold = (qseecom.send_cmd_gap_ms >
+			QSEECOM_SEND_CMD_CRYPTO_TIMEOUT) ?
+			QSEECOM_SEND_CMD_CRYPTO_MIN_TIMEOUT :
+			QSEECOM_SEND_CMD_CRYPTO_TIMEOUT;
+	return max_t(uint32_t, hold, QSEECOM_SEND_CMD_CRYPTO_MIN_TIMEOUT);
+}
+
 static void __qseecom_disable_clk_scale_down(struct qseecom_dev_handle *data)
 {
 	if (!qseecom.support_bus_scaling)
@@ -1099,9 +1145,71 @@ static int __qseecom_cleanup_app(struct qseecom_dev_handle *data)
 	return 1;
 }
 
+/*
+ * Returns the ion handle of the buffer behind @fd, from the cache of the
+ * client when it passed the same buffer before. Importing the buffer
+ * again on every modfd command looks up the dma_buf and the handle of
+ * the ion client each time; cached handles stay imported until they are
+ * replaced or the client goes away.
+ */
+static struct ion_handle *qseecom_get_ion_fd(struct qseecom_dev_handle *data,
+					     int fd)
+{
+	struct qseecom_client_handle *client = &data->client;
+	struct qseecom_ion_fd_cache *entry;
+	struct ion_handle *ihandle;
+	struct dma_buf *dmabuf;
+	int i;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR_OR_NULL(dmabuf))
+		return ERR_PTR(-EBADF);
+
+	for (i = 0; i < QSEECOM_ION_FD_CACHE_SZ; i++) {
+		if (client->fd_cache[i].dmabuf == dmabuf) {
+			dma_buf_put(dmabuf);
+			return client->fd_cache[i].ihandle;
+		}
+	}
+
+	ihandle = ion_import_dma_buf(qseecom.ion_clnt, fd);
+	if (IS_ERR_OR_NULL(ihandle)) {
+		dma_buf_put(dmabuf);
+		return ihandle;
+	}
+	entry = &client->fd_cache[client->fd_cache_next];
+	client->fd_cache_next = (client->fd_cache_next + 1) %
+					QSEECOM_ION_FD_CACHE_SZ;
+	if (entry->dmabuf) {
+		ion_free(qseecom.ion_clnt, entry->ihandle);
+		dma_buf_put(entry->dmabuf);
+	}
+	entry->dmabuf = dmabuf;
+	entry->ihandle = ihandle;
+	return ihandle;
+}
+
+static void qseecom_put_ion_fd_cache(struct qseecom_dev_handle *data)
+{
+	struct qseecom_ion_fd_cache *entry;
+	int i;
+
+	for (i = 0; i < QSEECOM_ION_FD_CACHE_SZ; i++) {
+		entry = &data->client.fd_cache[i];
+		if (!entry->dmabuf)
+			continue;
+		ion_free(qseecom.ion_clnt, entry->ihandle);
+		dma_buf_put(entry->dmabuf);
+		entry->dmabuf = NULL;
+		entry->ihandle = NULL;
+	}
+}
+
 static int qseecom_unmap_ion_allocated_memory(struct qseecom_dev_handle *data)
 {
 	int ret = 0;
+
+	qseecom_put_ion_fd_cache(data);
 	if (!IS_ERR_OR_NULL(data->client.ihandle)) {
 		ion_unmap_kernel(qseecom.ion_clnt, data->client.ihandle);
 		ion_free(qseecom.ion_clnt, data->client.ihandle);
@@ -1481,6 +1589,7 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 	struct qseecom_registered_app_list *ptr_app;
 	bool found_app = false;
 	int name_len = 0;
+	uint32_t cmd_virt, rsp_virt, start, end;
 
 	reqd_len_sb_in = req->cmd_req_len + req->resp_len;
 	/* find app_id & img_name from list */
@@ -1513,9 +1622,22 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 					(uint32_t)req->resp_buf));
 	send_data_req.rsp_len = req->resp_len;
 
+	/*
+	 * Only the request and response have to be maintained, not the
+	 * whole shared buffer: a client with a large buffer would otherwise
+	 * invalidate all of it after every command.
+	 */
+	cmd_virt = __qseecom_uvirt_to_kvirt(data, (uint32_t)req->cmd_req_buf);
+	rsp_virt = __qseecom_uvirt_to_kvirt(data, (uint32_t)req->resp_buf);
+	start = min(cmd_virt, rsp_virt);
+	end = max(cmd_virt + req->cmd_req_len, rsp_virt + req->resp_len);
+	if (end - start > data->client.sb_length ||
+			end - start < reqd_len_sb_in) {
+		start = (uint32_t)data->client.sb_virt;
+		end = start + data->client.sb_length;
+	}
 	msm_ion_do_cache_op(qseecom.ion_clnt, data->client.ihandle,
-					data->client.sb_virt,
-					reqd_len_sb_in,
+					(void *)start, end - start,
 					ION_IOC_CLEAN_INV_CACHES);
 
 	ret = scm_call(SCM_SVC_TZSCHEDULER, 1, (const void *) &send_data_req,
@@ -1541,7 +1663,7 @@ static int __qseecom_send_cmd(struct qseecom_dev_handle *data,
 		}
 	}
 	msm_ion_do_cache_op(qseecom.ion_clnt, data->client.ihandle,
-				data->client.sb_virt, data->client.sb_length,
+				(void *)start, end - start,
 				ION_IOC_INV_CACHES);
 	return ret;
 }
@@ -1626,7 +1748,7 @@ static int __qseecom_update_cmd_buf(void *msg, bool cleanup,
 	for (i = 0; i < MAX_ION_FD; i++) {
 		struct sg_table *sg_ptr = NULL;
 		if ((!listener_svc) && (cmd_req->ifd_data[i].fd > 0)) {
-			ihandle = ion_import_dma_buf(qseecom.ion_clnt,
+			ihandle = qseecom_get_ion_fd(data,
 					cmd_req->ifd_data[i].fd);
 			if (IS_ERR_OR_NULL(ihandle)) {
 				pr_err("Ion client can't retrieve the handle\n");
@@ -1728,13 +1850,13 @@ static int __qseecom_update_cmd_buf(void *msg, bool cleanup,
 			msm_ion_do_cache_op(qseecom.ion_clnt,
 					ihandle, NULL, len,
 					ION_IOC_CLEAN_INV_CACHES);
-		/* Deallocate the handle */
-		if (!IS_ERR_OR_NULL(ihandle))
+		/* Deallocate the handle, client ones stay cached */
+		if (listener_svc && !IS_ERR_OR_NULL(ihandle))
 			ion_free(qseecom.ion_clnt, ihandle);
 	}
 	return ret;
 err:
-	if (!IS_ERR_OR_NULL(ihandle))
+	if (listener_svc && !IS_ERR_OR_NULL(ihandle))
 		ion_free(qseecom.ion_clnt, ihandle);
 	return -ENOMEM;
 }
@@ -2458,8 +2580,7 @@ int qseecom_send_command(struct qseecom_handle *handle, void *send_buf,
 
 	ret = __qseecom_send_cmd(data, &req);
 	if (qseecom.support_bus_scaling)
-		__qseecom_add_bw_scale_down_timer(
-			QSEECOM_SEND_CMD_CRYPTO_TIMEOUT);
+		__qseecom_add_bw_scale_down_timer(qseecom_send_cmd_hold());
 
 	if (perf_enabled) {
 		qsee_disable_clock_vote(data, CLK_DFAB);
@@ -3724,7 +3845,7 @@ static long qseecom_ioctl(struct file *file, unsigned cmd,
 		ret = qseecom_send_cmd(data, argp);
 		if (qseecom.support_bus_scaling)
 			__qseecom_add_bw_scale_down_timer(
-				QSEECOM_SEND_CMD_CRYPTO_TIMEOUT);
+				qseecom_send_cmd_hold());
 		if (perf_enabled) {
 			qsee_disable_clock_vote(data, CLK_DFAB);
 			qsee_disable_clock_vote(data, CLK_SFPB);
@@ -3784,7 +3905,7 @@ static long qseecom_ioctl(struct file *file, unsigned cmd,
 		ret = qseecom_send_modfd_cmd(data, argp);
 		if (qseecom.support_bus_scaling)
 			__qseecom_add_bw_scale_down_timer(
-				QSEECOM_SEND_CMD_CRYPTO_TIMEOUT);
+				qseecom_send_cmd_hold());
 		if (perf_enabled) {
 			qsee_disable_clock_vote(data, CLK_DFAB);
 			qsee_disable_clock_vote(data, CLK_SFPB);
@@ -4603,6 +4724,7 @@ static int __devinit qseecom_probe(struct platform_device *pdev)
 				qseecom_scale_bus_bandwidth_timer_callback;
 	}
 	qseecom.timer_running = false;
+	qseecom.send_cmd_gap_ms = QSEECOM_SEND_CMD_CRYPTO_TIMEOUT / 2;
 	qseecom.qsee_perf_client = msm_bus_scale_register_client(
 					qseecom_platform_support);
 
@@ -67,6 +67,7 @@ MODULE_ALIAS("mmc:block");
 			(req->cmd_flags & REQ_META)) && \
 			(rq_data_dir(req) == WRITE))
 #define PACKED_CMD_VER		0x01
+#define PACKED_CMD_RD		0x01
 #define PACKED_CMD_WR		0x02
 #define PACKED_TRIGGER_MAX_ELEMENTS	5000
 #define MMC_BLK_MAX_RETRIES 5 /* max # of retries before aborting a command */
@@ -82,6 +83,9 @@ MODULE_ALIAS("mmc:block");
 #define PCKD_TRGR_LOWER_BOUND		5
 #define PCKD_TRGR_PRECISION_MULTIPLIER	100
 
+/* reads larger than this on average already use the bus well */
+#define PCKD_RD_MAX_AVG_SECTORS		64
+
 static DEFINE_MUTEX(block_mutex);
 
 /*
@@ -134,6 +138,7 @@ struct mmc_blk_data {
 	struct device_attribute num_wr_reqs_to_start_packing;
 	struct device_attribute bkops_check_threshold;
 	struct device_attribute no_pack_for_random;
+	struct device_attribute discard_idle_ms;
 	int	area_type;
 };
 
@@ -488,6 +493,45 @@ exit:
 	return ret;
 }
 
+static ssize_t
+discard_idle_ms_show(struct device *dev, struct device_attribute *attr,
+		     char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	if (!md)
+		return -EINVAL;
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->queue.discard_idle_ms);
+
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t
+discard_idle_ms_store(struct device *dev, struct device_attribute *attr,
+		      const char *buf, size_t count)
+{
+	unsigned int value;
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret = count;
+
+	if (!md)
+		return -EINVAL;
+
+	if (sscanf(buf, "%u", &value) != 1) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* 0 issues discards as they come, pending ones go out when idle */
+	md->queue.discard_idle_ms = value;
+
+exit:
+	mmc_blk_put(md);
+	return ret;
+}
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -695,6 +739,11 @@ static int mmc_blk_ioctl_cmd(struct block_device *bdev,
 	mmc_rpm_hold(card->host, &card->dev);
 	mmc_claim_host(card->host);
 
+	/* Passthrough commands are not allowed while queueing */
+	err = mmc_cmdq_ctrl(card, false);
+	if (err)
+		goto cmd_rel_host;
+
 	err = mmc_blk_part_switch(card, md);
 	if (err)
 		goto cmd_rel_host;
@@ -827,6 +876,11 @@ static int mmc_blk_ioctl_rpmb_cmd(struct block_device *bdev,
 	mmc_rpm_hold(card->host, &card->dev);
 	mmc_claim_host(card->host);
 
+	/* Passthrough commands are not allowed while queueing */
+	err = mmc_cmdq_ctrl(card, false);
+	if (err)
+		goto cmd_rel_host;
+
 	err = mmc_blk_part_switch(card, md);
 	if (err)
 		goto cmd_rel_host;
@@ -979,6 +1033,11 @@ static inline int mmc_blk_part_switch(struct mmc_card *card,
 	if (mmc_card_mmc(card)) {
 		u8 part_config = card->ext_csd.part_config;
 
+		/* Partition access can't change while queueing is on */
+		ret = mmc_cmdq_ctrl(card, false);
+		if (ret)
+			return ret;
+
 		part_config &= ~EXT_CSD_PART_CONFIG_ACC_MASK;
 		part_config |= md->part_type;
 
@@ -1284,23 +1343,16 @@ static inline void mmc_blk_reset_success(struct mmc_blk_data *md, int type)
 	md->reset_done &= ~type;
 }
 
-static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+static int mmc_blk_do_discard(struct mmc_blk_data *md, unsigned int from,
+			      unsigned int nr)
 {
-	struct mmc_blk_data *md = mq->data;
 	struct mmc_card *card = md->queue.card;
-	unsigned int from, nr, arg;
+	unsigned int arg;
 	int err = 0, type = MMC_BLK_DISCARD;
 
-	if (!mmc_can_erase(card)) {
-		err = -EOPNOTSUPP;
-		goto out;
-	}
-
-	from = blk_rq_pos(req);
-	nr = blk_rq_sectors(req);
-
-	if (card->ext_csd.bkops_en)
-		card->bkops_info.sectors_changed += blk_rq_sectors(req);
+	/* erase is rejected while command queueing is on */
+	if (card->ext_csd.cmdq_en)
+		mmc_cmdq_ctrl(card, false);
 
 	if (mmc_can_discard(card))
 		arg = MMC_DISCARD_ARG;
@@ -1325,11 +1377,120 @@ out:
 		goto retry;
 	if (!err)
 		mmc_blk_reset_success(md, type);
+
+	return err;
+}
+
+/*
+ * Deferring is not possible when reads of discarded sectors have to
+ * return zeroes, as they would still see the old data until the discard
+ * is actually issued.
+ */
+static bool mmc_blk_may_defer_discard(struct mmc_queue *mq)
+{
+	return mq->discard_idle_ms && mq->discard_chunk &&
+		!mq->queue->limits.discard_zeroes_data;
+}
+
+static int mmc_blk_issue_discard_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned int from, nr;
+	int err = 0;
+
+	if (!mmc_can_erase(card)) {
+		err = -EOPNOTSUPP;
+		goto out;
+	}
+
+	from = blk_rq_pos(req);
+	nr = blk_rq_sectors(req);
+
+	if (card->ext_csd.bkops_en)
+		card->bkops_info.sectors_changed += blk_rq_sectors(req);
+
+	/* coalesce with the other pending discards, issue them when idle */
+	if (mmc_blk_may_defer_discard(mq) &&
+	    mmc_queue_defer_discard(mq, from, nr))
+		goto out;
+
+	err = mmc_blk_do_discard(md, from, nr);
+out:
 	blk_end_request(req, err, blk_rq_bytes(req));
 
 	return err ? 0 : 1;
 }
 
+/*
+ * I/O is waiting for the host as soon as a request has been allocated on
+ * the queue, whether it is still in the elevator or already fetched by
+ * the queue thread.
+ */
+static inline bool mmc_blk_io_pending(struct request_queue *q)
+{
+	return q->rq.count[BLK_RW_SYNC] || q->rq.count[BLK_RW_ASYNC];
+}
+
+/*
+ * Issue the deferred discards of @mq one chunk at a time, with the host
+ * claimed. When @preemptible, stop as soon as other I/O shows up, so that
+ * it waits for at most one chunk.
+ */
+static void mmc_blk_issue_deferred_discards(struct mmc_queue *mq,
+					    bool preemptible)
+{
+	struct mmc_blk_data *md = mq->data;
+	unsigned int from, nr;
+
+	while (!(preemptible && mmc_blk_io_pending(mq->queue)) &&
+	       mmc_queue_next_discard(mq, &from, &nr))
+		mmc_blk_do_discard(md, from, nr);
+}
+
+static void mmc_blk_discard_work(struct work_struct *work)
+{
+	struct mmc_queue *mq = container_of(work, struct mmc_queue,
+					    discard_work.work);
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	unsigned long idle = mq->last_io +
+		msecs_to_jiffies(mq->discard_idle_ms);
+
+	if (time_before(jiffies, idle)) {
+		queue_delayed_work(system_freezable_wq, &mq->discard_work,
+				   idle - jiffies);
+		return;
+	}
+
+	if (mmc_blk_io_pending(mq->queue))
+		return;
+
+	mmc_rpm_hold(card->host, &card->dev);
+	mmc_claim_host(card->host);
+	if (card->ext_csd.bkops_en)
+		mmc_stop_bkops(card);
+	if (!mmc_blk_part_switch(card, md))
+		mmc_blk_issue_deferred_discards(mq, true);
+	if (mmc_card_need_bkops(card))
+		mmc_start_bkops(card, false);
+	mmc_release_host(card->host);
+	mmc_rpm_release(card->host, &card->dev);
+}
+
+/*
+ * Called at the end of every burst: deferred discards go out once no
+ * other I/O has been seen for discard_idle_ms. A preempted run of the
+ * work is picked up again from here.
+ */
+static void mmc_blk_schedule_discards(struct mmc_queue *mq)
+{
+	mq->last_io = jiffies;
+	if (mq->nr_discards)
+		queue_delayed_work(system_freezable_wq, &mq->discard_work,
+				   msecs_to_jiffies(mq->discard_idle_ms));
+}
+
 static int mmc_blk_issue_secdiscard_rq(struct mmc_queue *mq,
 				       struct request *req)
 {
@@ -1414,6 +1575,9 @@ static int mmc_blk_issue_sanitize_rq(struct mmc_queue *mq,
 			goto out;
 	}
 
+	/* sanitize only purges what has actually been unmapped */
+	mmc_blk_issue_deferred_discards(mq, false);
+
 	pr_debug("%s: %s - SANITIZE IN PROGRESS...\n",
 		mmc_hostname(card->host), __func__);
 
@@ -2039,6 +2203,39 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	return trigger;
 }
 
+/*
+ * Keep running averages (weight 1/8) of the share of reads among the
+ * read/write requests and of the read request size. Read packing is
+ * only worth its extra header transfer for small reads.
+ */
+static void mmc_blk_packing_mix_update(struct mmc_queue *mq,
+				       struct request *req)
+{
+	if (!req || (req->cmd_flags & MMC_REQ_SPECIAL_MASK))
+		return;
+
+	mq->rd_share -= mq->rd_share >> 3;
+	if (rq_data_dir(req) == READ) {
+		mq->rd_share += 1024 >> 3;
+		mq->avg_rd_sectors -= mq->avg_rd_sectors >> 3;
+		mq->avg_rd_sectors += blk_rq_sectors(req);
+	}
+
+	mq->rd_packing_enabled =
+		(mq->avg_rd_sectors >> 3) <= PCKD_RD_MAX_AVG_SECTORS;
+}
+
+/*
+ * A packed write group holds off reads until it completes, so the more
+ * reads in the mix, the more potential packed writes we want to see
+ * before packing (up to twice the trigger for a read-only mix).
+ */
+static int mmc_blk_wr_packing_trigger(struct mmc_queue *mq)
+{
+	return mq->num_wr_reqs_to_start_packing +
+		((mq->num_wr_reqs_to_start_packing * mq->rd_share) >> 10);
+}
+
 static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 					  struct request *req)
 {
@@ -2064,7 +2261,7 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 
 	if (!req || (req && (req->cmd_flags & REQ_FLUSH))) {
 		if (mq->num_of_potential_packed_wr_reqs >
-				mq->num_wr_reqs_to_start_packing)
+				mmc_blk_wr_packing_trigger(mq))
 			mq->wr_packing_enabled = true;
 		mq->num_wr_reqs_to_start_packing =
 			get_packed_trigger(mq->num_of_potential_packed_wr_reqs,
@@ -2090,7 +2287,7 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 	}
 
 	if (mq->num_of_potential_packed_wr_reqs >
-			mq->num_wr_reqs_to_start_packing)
+			mmc_blk_wr_packing_trigger(mq))
 		mq->wr_packing_enabled = true;
 
 }
@@ -2117,8 +2314,14 @@ void mmc_blk_init_packed_statistics(struct mmc_card *card)
 	memset(card->wr_pack_stats.packing_events, 0,
 		(max_num_of_packed_reqs + 1) *
 	       sizeof(*card->wr_pack_stats.packing_events));
+	if (card->wr_pack_stats.rd_packing_events)
+		memset(card->wr_pack_stats.rd_packing_events, 0,
+			(card->ext_csd.max_packed_reads + 1) *
+			sizeof(*card->wr_pack_stats.rd_packing_events));
 	memset(&card->wr_pack_stats.pack_stop_reason, 0,
 		sizeof(card->wr_pack_stats.pack_stop_reason));
+	memset(&card->wr_pack_stats.no_pack_reason, 0,
+		sizeof(card->wr_pack_stats.no_pack_reason));
 	card->wr_pack_stats.enabled = true;
 	spin_unlock(&card->wr_pack_stats.lock);
 }
@@ -2137,32 +2340,50 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	u8 max_packed_rw = 0;
 	u8 reqs = 0;
 	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
+	enum mmc_no_packed_reasons reason;
 
 	mmc_blk_clear_packed(mq->mqrq_cur);
 
+	reason = NO_PACK_UNSUPPORTED;
 	if (!(md->flags & MMC_BLK_CMD23) ||
 			!card->ext_csd.packed_event_en)
 		goto no_packed;
 
-	if (!mq->wr_packing_enabled)
-		goto no_packed;
-
 	if ((rq_data_dir(cur) == WRITE) &&
 			(card->host->caps2 & MMC_CAP2_PACKED_WR))
 		max_packed_rw = card->ext_csd.max_packed_writes;
+	else if ((rq_data_dir(cur) == READ) &&
+			(card->host->caps2 & MMC_CAP2_PACKED_RD))
+		max_packed_rw = card->ext_csd.max_packed_reads;
 
 	if (max_packed_rw == 0)
 		goto no_packed;
 
+	reason = NO_PACK_CONTROL;
+	if (rq_data_dir(cur) == WRITE ? !mq->wr_packing_enabled :
+			!mq->rd_packing_enabled)
+		goto no_packed;
+
+	/*
+	 * The header of a packed read is written with a request of its
+	 * own, which can't be done while another request is in flight.
+	 */
+	reason = NO_PACK_HOST_BUSY;
+	if ((rq_data_dir(cur) == READ) && card->host->areq)
+		goto no_packed;
+
+	reason = NO_PACK_REL_WRITE;
 	if (mmc_req_rel_wr(cur) &&
 			(md->flags & MMC_BLK_REL_WR) &&
 			!en_rel_wr)
 		goto no_packed;
 
+	reason = NO_PACK_LARGE_SEC_ALIGN;
 	if (mmc_large_sec(card) &&
 			!IS_ALIGNED(blk_rq_sectors(cur), 8))
 		goto no_packed;
 
+	reason = NO_PACK_FUA;
 	if (cur->cmd_flags & REQ_FUA)
 		goto no_packed;
 
@@ -2171,6 +2392,11 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	if (unlikely(max_blk_count > 0xffff))
 		max_blk_count = 0xffff;
 
+	/* nothing can be packed next to a request this large */
+	reason = NO_PACK_LARGE_REQ;
+	if (blk_rq_sectors(cur) >= max_blk_count / 2)
+		goto no_packed;
+
 	max_phys_segs = queue_max_segments(q);
 	req_sectors += blk_rq_sectors(cur);
 	phys_segments += cur->nr_phys_segments;
@@ -2267,8 +2493,13 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	}
 
 	if (stats->enabled) {
-		if (reqs + 1 <= card->ext_csd.max_packed_writes)
-			stats->packing_events[reqs + 1]++;
+		if (rq_data_dir(cur) == WRITE) {
+			if (reqs + 1 <= card->ext_csd.max_packed_writes)
+				stats->packing_events[reqs + 1]++;
+		} else if (stats->rd_packing_events) {
+			if (reqs + 1 <= card->ext_csd.max_packed_reads)
+				stats->rd_packing_events[reqs + 1]++;
+		}
 		if (reqs + 1 == max_packed_rw)
 			MMC_BLK_UPDATE_STOP_REASON(stats, THRESHOLD);
 	}
@@ -2281,31 +2512,37 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		mq->mqrq_cur->packed_retries = reqs;
 		return reqs;
 	}
+	reason = NO_PACK_SINGLE;
 
 no_packed:
+	spin_lock(&stats->lock);
+	if (stats->enabled)
+		stats->no_pack_reason[reason]++;
+	spin_unlock(&stats->lock);
+
 	mmc_blk_clear_packed(mq->mqrq_cur);
 	return 0;
 }
 
-static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
-					struct mmc_card *card,
-					struct mmc_queue *mq)
+static void mmc_blk_packed_hdr_prep(struct mmc_queue_req *mqrq,
+				    struct mmc_card *card,
+				    struct mmc_queue *mq, u8 rw)
 {
 	struct mmc_blk_request *brq = &mqrq->brq;
-	struct request *req = mqrq->req;
 	struct request *prq;
 	struct mmc_blk_data *md = mq->data;
 	bool do_rel_wr, do_data_tag;
 	u32 *packed_cmd_hdr = mqrq->packed_cmd_hdr;
 	u8 i = 1;
 
-	mqrq->packed_cmd = MMC_PACKED_WRITE;
+	mqrq->packed_cmd = rw == PACKED_CMD_WR ?
+		MMC_PACKED_WRITE : MMC_PACKED_READ;
 	mqrq->packed_blocks = 0;
 	mqrq->packed_fail_idx = MMC_PACKED_N_IDX;
 
 	memset(packed_cmd_hdr, 0, sizeof(mqrq->packed_cmd_hdr));
 	packed_cmd_hdr[0] = (mqrq->packed_num << 16) |
-		(PACKED_CMD_WR << 8) | PACKED_CMD_VER;
+		(rw << 8) | PACKED_CMD_VER;
 
 	/*
 	 * Argument for each entry of packed group
@@ -2329,6 +2566,16 @@ static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
 		mqrq->packed_blocks += blk_rq_sectors(prq);
 		i++;
 	}
+}
+
+static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
+					struct mmc_card *card,
+					struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+
+	mmc_blk_packed_hdr_prep(mqrq, card, mq, PACKED_CMD_WR);
 
 	memset(brq, 0, sizeof(struct mmc_blk_request));
 	brq->mrq.cmd = &brq->cmd;
@@ -2383,6 +2630,137 @@ static void mmc_blk_packed_hdr_wrq_prep(struct mmc_queue_req *mqrq,
 	mmc_queue_bounce_pre(mqrq);
 }
 
+/*
+ * Wait for the card to leave the programming state after a write.
+ * Some cards mishandle the status bits, so check both the busy
+ * indication and the card state.
+ */
+static int mmc_blk_wait_prg_done(struct mmc_card *card)
+{
+	unsigned long timeout;
+	u32 status;
+	int err;
+
+	timeout = jiffies + msecs_to_jiffies(MMC_BLK_TIMEOUT_MS);
+	do {
+		err = get_card_status(card, &status, 5);
+		if (err)
+			return err;
+
+		if (time_after(jiffies, timeout)) {
+			pr_err("%s: Card stuck in programming state! %s\n",
+			       mmc_hostname(card->host), __func__);
+			return -ETIMEDOUT;
+		}
+	} while (!(status & R1_READY_FOR_DATA) ||
+		 (R1_CURRENT_STATE(status) == R1_STATE_PRG));
+
+	return 0;
+}
+
+/*
+ * A packed read takes two transfers: the header is written to the card
+ * by itself first (CMD23 + CMD25 of one block), then the data of all
+ * packed requests is read back in one go (CMD23 + CMD18). The header
+ * is sent here, synchronously, so the host must be idle.
+ */
+static int mmc_blk_packed_hdr_rrq_prep(struct mmc_queue_req *mqrq,
+				       struct mmc_card *card,
+				       struct mmc_queue *mq)
+{
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	struct mmc_request mrq = {NULL};
+	struct mmc_command sbc = {0};
+	struct mmc_command cmd = {0};
+	struct mmc_command stop = {0};
+	struct mmc_data data = {0};
+	struct scatterlist sg;
+	int err;
+
+	mmc_blk_packed_hdr_prep(mqrq, card, mq, PACKED_CMD_RD);
+
+	sbc.opcode = MMC_SET_BLOCK_COUNT;
+	sbc.arg = MMC_CMD23_ARG_PACKED | 1;
+	sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+	cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		cmd.arg <<= 9;
+	cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	data.blksz = 512;
+	data.blocks = 1;
+	data.flags = MMC_DATA_WRITE;
+	data.sg = &sg;
+	data.sg_len = 1;
+	sg_init_one(&sg, mqrq->packed_cmd_hdr, sizeof(mqrq->packed_cmd_hdr));
+	mmc_set_data_timeout(&data, card);
+
+	stop.opcode = MMC_STOP_TRANSMISSION;
+	stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mrq.sbc = &sbc;
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+	mrq.stop = &stop;
+
+	mmc_wait_for_req(card->host, &mrq);
+	if (sbc.error || cmd.error || data.error || stop.error ||
+	    (cmd.resp[0] & CMD_ERRORS)) {
+		pr_err("%s: packed read header failed: %d/%d/%d/%d %#x\n",
+		       req->rq_disk->disk_name, sbc.error, cmd.error,
+		       data.error, stop.error, cmd.resp[0]);
+		return -EIO;
+	}
+
+	err = mmc_blk_wait_prg_done(card);
+	if (err)
+		return err;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->mrq.sbc = &brq->sbc;
+	brq->mrq.stop = &brq->stop;
+
+	brq->sbc.opcode = MMC_SET_BLOCK_COUNT;
+	brq->sbc.arg = MMC_CMD23_ARG_PACKED | mqrq->packed_blocks;
+	brq->sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	brq->cmd.opcode = MMC_READ_MULTIPLE_BLOCK;
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+
+	brq->data.blksz = 512;
+	brq->data.blocks = mqrq->packed_blocks;
+	brq->data.flags |= MMC_DATA_READ;
+
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+
+	mmc_set_data_timeout(&brq->data, card);
+
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.cmd_flags = req->cmd_flags;
+	if (mq->err_check_fn)
+		mqrq->mmc_active.err_check = mq->err_check_fn;
+	else
+		mqrq->mmc_active.err_check = mmc_blk_packed_err_check;
+	mqrq->mmc_active.reinsert_req = mmc_blk_reinsert_req;
+	mqrq->mmc_active.update_interrupted_req =
+		mmc_blk_update_interrupted_req;
+
+	return 0;
+}
+
 static int mmc_blk_cmd_err(struct mmc_blk_data *md, struct mmc_card *card,
 			   struct mmc_blk_request *brq, struct request *req,
 			   int ret)
@@ -2477,6 +2855,22 @@ static void mmc_blk_revert_packed_req(struct mmc_queue *mq,
 	mmc_blk_clear_packed(mq_rq);
 }
 
+static void mmc_blk_packed_rq_prep(struct mmc_queue_req *mqrq,
+				   struct mmc_card *card,
+				   struct mmc_queue *mq)
+{
+	if (rq_data_dir(mqrq->req) == WRITE) {
+		mmc_blk_packed_hdr_wrq_prep(mqrq, card, mq);
+		return;
+	}
+
+	if (mmc_blk_packed_hdr_rrq_prep(mqrq, card, mq)) {
+		/* read the packed requests one at a time instead */
+		mmc_blk_revert_packed_req(mq, mqrq);
+		mmc_blk_rw_rq_prep(mqrq, card, 0, mq);
+	}
+}
+
 static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 {
 	struct mmc_blk_data *md = mq->data;
@@ -2502,7 +2896,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	do {
 		if (rqc) {
 			if (reqs >= packed_num)
-				mmc_blk_packed_hdr_wrq_prep(mq->mqrq_cur,
+				mmc_blk_packed_rq_prep(mq->mqrq_cur,
 						card, mq);
 			else
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
@@ -2642,7 +3036,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			} else {
 				if (!mq_rq->packed_retries)
 					goto cmd_abort;
-				mmc_blk_packed_hdr_wrq_prep(mq_rq, card, mq);
+				mmc_blk_packed_rq_prep(mq_rq, card, mq);
 				mmc_start_req(card->host,
 						&mq_rq->mmc_active, NULL);
 			}
@@ -2686,6 +3080,274 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 	return 0;
 }
 
+/*
+ * Command queueing: read and write requests are queued on the card with
+ * CMD44/CMD45 under the task id of a free slot, and executed with
+ * CMD46/CMD47 once the card reports the task ready in its queue status
+ * register. The host stays claimed while any task is queued.
+ */
+static int mmc_blk_cmdq_queue_task(struct mmc_queue *mq, struct request *req,
+				   int tag)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_command cmd = {0};
+	int err;
+
+	cmd.opcode = MMC_QUE_TASK_PARAMS;
+	cmd.arg = MMC_CMDQ_TASK_ID(tag) | blk_rq_sectors(req);
+	if (rq_data_dir(req) == READ)
+		cmd.arg |= MMC_CMDQ_DIR_READ | MMC_CMDQ_PRIORITY;
+	else if (req->cmd_flags & REQ_FUA)
+		cmd.arg |= MMC_CMDQ_FORCED_PRG;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err)
+		return err;
+	if (cmd.resp[0] & CMD_ERRORS)
+		return -EIO;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = MMC_QUE_TASK_ADDR;
+	cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		cmd.arg <<= 9;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+	err = mmc_wait_for_cmd(card->host, &cmd, 0);
+	if (err)
+		return err;
+	if (cmd.resp[0] & CMD_ERRORS)
+		return -EIO;
+
+	mq->cmdq_slot[tag].req = req;
+	return 0;
+}
+
+static int mmc_blk_cmdq_wait_ready(struct mmc_queue *mq, u32 *qsr)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_command cmd = {0};
+	unsigned long timeout;
+	int err;
+
+	timeout = jiffies + msecs_to_jiffies(MMC_BLK_TIMEOUT_MS);
+	do {
+		cmd.opcode = MMC_SEND_STATUS;
+		cmd.arg = card->rca << 16 | MMC_CMDQ_SEND_QSR;
+		cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+		err = mmc_wait_for_cmd(card->host, &cmd, 0);
+		if (err)
+			return err;
+
+		*qsr = cmd.resp[0] & mq->cmdq_busy;
+		if (*qsr)
+			return 0;
+
+		cond_resched();
+	} while (time_before(jiffies, timeout));
+
+	pr_err("%s: no queued task became ready\n",
+	       mmc_hostname(card->host));
+	return -ETIMEDOUT;
+}
+
+static int mmc_blk_cmdq_exec_task(struct mmc_queue *mq)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_queue_req *mqrq;
+	struct mmc_blk_request *brq;
+	struct request *req;
+	u32 qsr;
+	int tag, err;
+
+	err = mmc_blk_cmdq_wait_ready(mq, &qsr);
+	if (err)
+		return err;
+
+	tag = __ffs(qsr);
+	mqrq = &mq->cmdq_slot[tag];
+	req = mqrq->req;
+	brq = &mqrq->brq;
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+	brq->cmd.arg = MMC_CMDQ_TASK_ID(tag);
+	brq->cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->data.blocks = blk_rq_sectors(req);
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = MMC_EXECUTE_READ_TASK;
+		brq->data.flags = MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = MMC_EXECUTE_WRITE_TASK;
+		brq->data.flags = MMC_DATA_WRITE;
+	}
+	mmc_set_data_timeout(&brq->data, card);
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
+
+	mmc_wait_for_req(card->host, &brq->mrq);
+	err = brq->cmd.error ? brq->cmd.error : brq->data.error;
+	if (err)
+		return err;
+	if ((brq->cmd.resp[0] & CMD_ERRORS) ||
+	    brq->data.bytes_xfered != blk_rq_bytes(req))
+		return -EIO;
+
+	/* Writes leave the card programming before the next task runs */
+	if (rq_data_dir(req) != READ) {
+		err = mmc_blk_wait_prg_done(card);
+		if (err)
+			return err;
+	}
+
+	__clear_bit(tag, &mq->cmdq_busy);
+	mqrq->req = NULL;
+	blk_end_request_all(req, 0);
+	return 0;
+}
+
+/*
+ * Throw away everything queued on the card, hand the requests back to
+ * the block layer and carry on without command queueing, leaving error
+ * recovery to the regular read/write path.
+ */
+static void mmc_blk_cmdq_reset(struct mmc_queue *mq, int err)
+{
+	struct mmc_card *card = mq->card;
+	struct request_queue *q = mq->queue;
+	struct mmc_command cmd = {0};
+	int tag;
+
+	pr_err("%s: command queue error %d, disabling it\n",
+	       mmc_hostname(card->host), err);
+
+	if (card->ext_csd.cmdq_en) {
+		cmd.opcode = MMC_CMDQ_TASK_MGMT;
+		cmd.arg = MMC_CMDQ_DISCARD_QUEUE;
+		cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+		if (mmc_wait_for_cmd(card->host, &cmd, 0))
+			pr_err("%s: failed to discard the command queue\n",
+			       mmc_hostname(card->host));
+	}
+
+	spin_lock_irq(q->queue_lock);
+	for_each_set_bit(tag, &mq->cmdq_busy, mq->cmdq_depth) {
+		if (mq->cmdq_slot[tag].req)
+			blk_requeue_request(q, mq->cmdq_slot[tag].req);
+		mq->cmdq_slot[tag].req = NULL;
+	}
+	spin_unlock_irq(q->queue_lock);
+	mq->cmdq_busy = 0;
+
+	mmc_cmdq_ctrl(card, false);
+	clear_bit(MMC_QUEUE_CMDQ, &mq->flags);
+}
+
+static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_host *host = card->host;
+	struct request_queue *q = mq->queue;
+	unsigned int cmd_flags = req ? req->cmd_flags : 0;
+	int tag, ret = 0;
+
+	if (req && !mq->cmdq_claimed) {
+		mmc_rpm_hold(host, &card->dev);
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+		if (mmc_bus_needs_resume(card->host))
+			mmc_resume_bus(card->host);
+#endif
+		mmc_claim_host(card->host);
+		if (card->ext_csd.bkops_en)
+			mmc_stop_bkops(card);
+		mq->cmdq_claimed = true;
+	}
+
+	if (!req) {
+		if (!mq->cmdq_busy)
+			goto release;
+		ret = mmc_blk_cmdq_exec_task(mq);
+		if (ret)
+			goto reset;
+		return 0;
+	}
+
+	if (mmc_blk_part_switch(card, md)) {
+		blk_end_request_all(req, -EIO);
+		return 0;
+	}
+
+	if (cmd_flags & (MMC_REQ_SPECIAL_MASK | REQ_SANITIZE)) {
+		/* the queue has to be empty for anything but reads/writes */
+		while (mq->cmdq_busy) {
+			ret = mmc_blk_cmdq_exec_task(mq);
+			if (ret) {
+				spin_lock_irq(q->queue_lock);
+				blk_requeue_request(q, req);
+				spin_unlock_irq(q->queue_lock);
+				goto reset;
+			}
+		}
+
+		/*
+		 * Erase and sanitize are rejected while queueing is on.
+		 * Plain discards turn it off themselves, and only when
+		 * they are not deferred.
+		 */
+		if (cmd_flags & (REQ_SECURE | REQ_SANITIZE))
+			mmc_cmdq_ctrl(card, false);
+
+		if (cmd_flags & REQ_SANITIZE) {
+			ret = mmc_blk_issue_sanitize_rq(mq, req);
+		} else if (cmd_flags & REQ_DISCARD) {
+			if (cmd_flags & REQ_SECURE &&
+			    !(card->quirks & MMC_QUIRK_SEC_ERASE_TRIM_BROKEN))
+				ret = mmc_blk_issue_secdiscard_rq(mq, req);
+			else
+				ret = mmc_blk_issue_discard_rq(mq, req);
+		} else {
+			ret = mmc_blk_issue_flush(mq, req);
+		}
+		return ret;
+	}
+
+	if (!card->ext_csd.cmdq_en) {
+		ret = mmc_cmdq_ctrl(card, true);
+		if (ret) {
+			spin_lock_irq(q->queue_lock);
+			blk_requeue_request(q, req);
+			spin_unlock_irq(q->queue_lock);
+			goto reset;
+		}
+	}
+
+	tag = find_first_zero_bit(&mq->cmdq_busy, mq->cmdq_depth);
+	__set_bit(tag, &mq->cmdq_busy);
+	ret = mmc_blk_cmdq_queue_task(mq, req, tag);
+	if (ret) {
+		/* let the reset requeue it with the queued tasks */
+		mq->cmdq_slot[tag].req = req;
+		goto reset;
+	}
+	return 0;
+
+reset:
+	mmc_blk_cmdq_reset(mq, ret);
+release:
+	if (mmc_card_need_bkops(card))
+		mmc_start_bkops(card, false);
+	/* clock scaling only acts while the command queue is disabled */
+	if (host->clk_scaling.enable)
+		mmc_cmdq_ctrl(card, false);
+	mmc_release_host(card->host);
+	mmc_rpm_release(host, &card->dev);
+	mq->cmdq_claimed = false;
+	mmc_blk_schedule_discards(mq);
+	return ret ? 0 : 1;
+}
+
 static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 {
 	int ret;
@@ -2695,6 +3357,9 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	unsigned long flags;
 	unsigned int cmd_flags = req ? req->cmd_flags : 0;
 
+	if (test_bit(MMC_QUEUE_CMDQ, &mq->flags))
+		return mmc_blk_cmdq_issue_rq(mq, req);
+
 	if (req && !mq->mqrq_prev->req) {
 		mmc_rpm_hold(host, &card->dev);
 #ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
@@ -2717,6 +3382,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		goto out;
 	}
 
+	mmc_blk_packing_mix_update(mq, req);
 	mmc_blk_write_packing_control(mq, req);
 
 	clear_bit(MMC_QUEUE_NEW_REQUEST, &mq->flags);
@@ -2765,6 +3431,7 @@ out:
 		/* release host only when there are no more requests */
 		mmc_release_host(card->host);
 		mmc_rpm_release(host, &card->dev);
+		mmc_blk_schedule_discards(mq);
 	}
 	return ret;
 }
@@ -2835,6 +3502,12 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
+	INIT_DELAYED_WORK(&md->queue.discard_work, mmc_blk_discard_work);
+
+	if (area_type == MMC_BLK_DATA_AREA_MAIN &&
+	    mmc_cmdq_init(&md->queue, card))
+		pr_warning("%s: no memory for the command queue, using legacy mode\n",
+			   mmc_card_name(card));
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx * perdev_minors;
@@ -2997,6 +3670,8 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 
 		/* Then flush out any already in there */
 		mmc_cleanup_queue(&md->queue);
+		/* deferred discards are only hints, they can be dropped */
+		cancel_delayed_work_sync(&md->queue.discard_work);
 		mmc_blk_put(md);
 	}
 }
@@ -3084,8 +3759,21 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto no_pack_for_random_fails;
 
+	md->discard_idle_ms.show = discard_idle_ms_show;
+	md->discard_idle_ms.store = discard_idle_ms_store;
+	sysfs_attr_init(&md->discard_idle_ms.attr);
+	md->discard_idle_ms.attr.name = "discard_idle_ms";
+	md->discard_idle_ms.attr.mode = S_IRUGO | S_IWUSR;
+	ret = device_create_file(disk_to_dev(md->disk),
+				 &md->discard_idle_ms);
+	if (ret)
+		goto discard_idle_ms_fails;
+
 	return ret;
 
+discard_idle_ms_fails:
+	device_remove_file(disk_to_dev(md->disk),
+			   &md->no_pack_for_random);
 no_pack_for_random_fails:
 	device_remove_file(disk_to_dev(md->disk),
 			   &md->bkops_check_threshold);
@@ -3242,10 +3930,12 @@ static void mmc_blk_shutdown(struct mmc_card *card)
 		rc = mmc_queue_suspend(&md->queue, 1);
 		if (rc)
 			goto suspend_error;
+		cancel_delayed_work_sync(&md->queue.discard_work);
 		list_for_each_entry(part_md, &md->part, part) {
 			rc = mmc_queue_suspend(&part_md->queue, 1);
 			if (rc)
 				goto suspend_error;
+			cancel_delayed_work_sync(&part_md->queue.discard_work);
 		}
 	}
 
@@ -37,6 +37,140 @@
 /*
  * Prepare a MMC request. This just filters out odd stuff.
  */
+/*
+ * Remove [from, from + nr) from the deferred discards, splitting a range
+ * the sectors fall inside of. Called with the queue lock held. Dropping a
+ * discard is always safe, so if there is no room for the split the tail
+ * of the range is simply forgotten.
+ */
+static void mmc_queue_drop_discard(struct mmc_queue *mq, unsigned int from,
+				   unsigned int nr)
+{
+	struct mmc_discard_range *r = mq->discard;
+	unsigned int end = from + nr;
+	unsigned int r_end;
+	int i = 0;
+
+	while (i < mq->nr_discards && r[i].from < end) {
+		r_end = r[i].from + r[i].nr;
+		if (r_end <= from) {
+			i++;
+		} else if (r[i].from < from && r_end > end) {
+			if (mq->nr_discards < MMC_DISCARD_MAX_RANGES) {
+				memmove(&r[i + 2], &r[i + 1],
+					(mq->nr_discards - i - 1) * sizeof(*r));
+				r[i + 1].from = end;
+				r[i + 1].nr = r_end - end;
+				mq->nr_discards++;
+			}
+			r[i].nr = from - r[i].from;
+			break;
+		} else if (r[i].from < from) {
+			r[i].nr = from - r[i].from;
+			i++;
+		} else if (r_end > end) {
+			r[i].nr = r_end - end;
+			r[i].from = end;
+			break;
+		} else {
+			memmove(&r[i], &r[i + 1],
+				(mq->nr_discards - i - 1) * sizeof(*r));
+			mq->nr_discards--;
+		}
+	}
+}
+
+/**
+ * mmc_queue_defer_discard - add a discard to the deferred ranges
+ * @mq: mmc queue
+ * @from: first sector
+ * @nr: number of sectors
+ *
+ * The range is merged with every deferred range it overlaps or touches.
+ * Returns false when it could not be merged and all slots are in use, in
+ * which case the caller has to issue the discard itself.
+ */
+bool mmc_queue_defer_discard(struct mmc_queue *mq, unsigned int from,
+			     unsigned int nr)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_discard_range *r = mq->discard;
+	unsigned int end = from + nr;
+	bool ret = true;
+	int i, j;
+
+	spin_lock_irq(q->queue_lock);
+	for (i = 0; i < mq->nr_discards && r[i].from + r[i].nr < from; i++)
+		;
+	for (j = i; j < mq->nr_discards && r[j].from <= end; j++) {
+		from = min(from, r[j].from);
+		end = max(end, r[j].from + r[j].nr);
+	}
+
+	if (i == j) {
+		if (mq->nr_discards == MMC_DISCARD_MAX_RANGES) {
+			ret = false;
+			goto out;
+		}
+		memmove(&r[i + 1], &r[i], (mq->nr_discards - i) * sizeof(*r));
+		mq->nr_discards++;
+	} else if (j > i + 1) {
+		/* ranges i + 1 .. j - 1 were absorbed into i */
+		memmove(&r[i + 1], &r[j], (mq->nr_discards - j) * sizeof(*r));
+		mq->nr_discards -= j - i - 1;
+	}
+	r[i].from = from;
+	r[i].nr = end - from;
+out:
+	spin_unlock_irq(q->queue_lock);
+	return ret;
+}
+
+/**
+ * mmc_queue_next_discard - take the next chunk of deferred discards
+ * @mq: mmc queue
+ * @from: first sector of the chunk
+ * @nr: number of sectors in the chunk
+ *
+ * Chunks are at most discard_chunk sectors long so that a request arriving
+ * while they are issued is never held back longer than one erase. Where a
+ * range has to be split, the chunk ends on an erase group boundary. Returns
+ * false when there is nothing left to discard.
+ */
+bool mmc_queue_next_discard(struct mmc_queue *mq, unsigned int *from,
+			    unsigned int *nr)
+{
+	struct request_queue *q = mq->queue;
+	struct mmc_discard_range *r = mq->discard;
+	unsigned int erase_size = mq->card->erase_size;
+	unsigned int end;
+	bool ret = false;
+
+	spin_lock_irq(q->queue_lock);
+	if (!mq->nr_discards)
+		goto out;
+
+	*from = r[0].from;
+	*nr = r[0].nr;
+	if (*nr > mq->discard_chunk) {
+		*nr = mq->discard_chunk;
+		end = *from + *nr;
+		if (erase_size && end - end % erase_size > *from)
+			*nr = end - end % erase_size - *from;
+	}
+
+	r[0].from += *nr;
+	r[0].nr -= *nr;
+	if (!r[0].nr) {
+		memmove(&r[0], &r[1], (mq->nr_discards - 1) * sizeof(*r));
+		mq->nr_discards--;
+	}
+	ret = true;
+out:
+	spin_unlock_irq(q->queue_lock);
+	return ret;
+}
+
 static int mmc_prep_request(struct request_queue *q, struct request *req)
 {
 	struct mmc_queue *mq = q->queuedata;
@@ -52,6 +186,15 @@ static int mmc_prep_request(struct request_queue *q, struct request *req)
 	if (mq && mmc_card_removed(mq->card))
 		return BLKPREP_KILL;
 
+	/*
+	 * A write supersedes any deferred discard of the same sectors, and
+	 * the discard must not be issued over the new data later on.
+	 */
+	if (mq && mq->nr_discards && rq_data_dir(req) == WRITE &&
+	    !(req->cmd_flags & REQ_DISCARD))
+		mmc_queue_drop_discard(mq, blk_rq_pos(req),
+				       blk_rq_sectors(req));
+
 	req->cmd_flags |= REQ_DONTPREP;
 
 	return BLKPREP_OK;
@@ -75,14 +218,30 @@ static int mmc_queue_thread(void *d)
 		struct mmc_queue_req *tmp;
 		struct request *req = NULL;
 		unsigned int cmd_flags = 0;
+		bool cmdq = test_bit(MMC_QUEUE_CMDQ, &mq->flags);
 
 		spin_lock_irq(q->queue_lock);
 		set_current_state(TASK_INTERRUPTIBLE);
-		req = blk_fetch_request(q);
-		mq->mqrq_cur->req = req;
+		if (!cmdq) {
+			req = blk_fetch_request(q);
+			mq->mqrq_cur->req = req;
+		} else if (find_first_zero_bit(&mq->cmdq_busy,
+				mq->cmdq_depth) < mq->cmdq_depth) {
+			/* only fetch while a task id is free */
+			req = blk_fetch_request(q);
+		}
 		spin_unlock_irq(q->queue_lock);
 
-		if (req || mq->mqrq_prev->req) {
+		if (cmdq && (req || mq->cmdq_claimed)) {
+			/*
+			 * Queue the new request on the card, or execute
+			 * one of the queued tasks when nothing was fetched.
+			 * The host is kept claimed until all queued tasks
+			 * have completed.
+			 */
+			set_current_state(TASK_RUNNING);
+			mq->issue_fn(mq, req);
+		} else if (!cmdq && (req || mq->mqrq_prev->req)) {
 			set_current_state(TASK_RUNNING);
 			cmd_flags = req ? req->cmd_flags : 0;
 			mq->issue_fn(mq, req);
@@ -172,6 +331,21 @@ static void mmc_request(struct request_queue *q)
 		wake_up_process(mq->thread);
 }
 
+/*
+ * Start waking the host as soon as a bio is submitted (for reads typically
+ * a page cache miss) instead of when the request is finally dispatched, so
+ * that the resume overlaps with plugging and merging in the block layer.
+ */
+static void mmc_queue_bio(struct request_queue *q, struct bio *bio)
+{
+	struct mmc_queue *mq = q->queuedata;
+
+	if (mq && !test_bit(MMC_QUEUE_SUSPENDED, &mq->flags))
+		mmc_host_early_resume(mq->card->host);
+
+	blk_queue_bio(q, bio);
+}
+
 /*
  * mmc_urgent_request() - Urgent MMC request handler.
  * @q: request queue.
@@ -254,6 +428,52 @@ static void mmc_queue_setup_sanitize(struct request_queue *q)
 	queue_flag_set_unlocked(QUEUE_FLAG_SANITIZE, q);
 }
 
+/**
+ * mmc_cmdq_init - set up command queueing for a queue
+ * @mq: mmc queue
+ * @card: mmc card the queue belongs to
+ *
+ * Allocate one request slot per task id, so that up to the queue depth
+ * of the card requests can be queued on it at once. Queues that need a
+ * bounce buffer keep issuing requests one at a time.
+ */
+int mmc_cmdq_init(struct mmc_queue *mq, struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+	unsigned int depth = min_t(unsigned int, card->ext_csd.cmdq_depth,
+				   MMC_CMDQ_MAX_DEPTH);
+	int i, ret = 0;
+
+	if (!(host->caps2 & MMC_CAP2_CMDQ) || !card->ext_csd.cmdq_support ||
+	    !depth || mq->mqrq_cur->bounce_buf)
+		return 0;
+
+	mq->cmdq_slot = kcalloc(depth, sizeof(*mq->cmdq_slot), GFP_KERNEL);
+	if (!mq->cmdq_slot)
+		return -ENOMEM;
+
+	for (i = 0; i < depth; i++) {
+		INIT_LIST_HEAD(&mq->cmdq_slot[i].packed_list);
+		mq->cmdq_slot[i].sg =
+			mmc_alloc_sg(queue_max_segments(mq->queue), &ret);
+		if (ret)
+			goto free_slots;
+	}
+
+	mq->cmdq_depth = depth;
+	mq->cmdq_busy = 0;
+	set_bit(MMC_QUEUE_CMDQ, &mq->flags);
+	pr_info("%s: command queue depth %u\n", mmc_card_name(card), depth);
+	return 0;
+
+free_slots:
+	while (--i >= 0)
+		kfree(mq->cmdq_slot[i].sg);
+	kfree(mq->cmdq_slot);
+	mq->cmdq_slot = NULL;
+	return ret;
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -279,6 +499,8 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	mq->queue = blk_init_queue(mmc_request, lock);
 	if (!mq->queue)
 		return -ENOMEM;
+	/* Not blk_queue_make_request(): that would redo the queue defaults */
+	mq->queue->make_request_fn = mmc_queue_bio;
 
 	if ((host->caps2 & MMC_CAP2_STOP_REQUEST) &&
 			host->ops->stop_request &&
@@ -301,8 +523,13 @@ int mmc_init_queue(struct mmc_queue *mq, struct mmc_card *card,
 	blk_queue_prep_rq(mq->queue, mmc_prep_request);
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, mq->queue);
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, mq->queue);
-	if (mmc_can_erase(card))
+	if (mmc_can_erase(card)) {
 		mmc_queue_setup_discard(mq->queue, card);
+		mq->discard_idle_ms = MMC_DISCARD_IDLE_MS;
+		mq->discard_chunk = min_t(unsigned int,
+			MMC_DISCARD_CHUNK_SECTORS,
+			mq->queue->limits.max_discard_sectors);
+	}
 
 	/* Don't enable Sanitize if HPI is not supported */
 	if ((mmc_can_sanitize(card) && (host->caps2 & MMC_CAP2_SANITIZE) &&
@@ -473,6 +700,15 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 	kfree(mqrq_prev->bounce_buf);
 	mqrq_prev->bounce_buf = NULL;
 
+	if (mq->cmdq_slot) {
+		int i;
+
+		for (i = 0; i < mq->cmdq_depth; i++)
+			kfree(mq->cmdq_slot[i].sg);
+		kfree(mq->cmdq_slot);
+		mq->cmdq_slot = NULL;
+	}
+
 	mq->card = NULL;
 }
 EXPORT_SYMBOL(mmc_cleanup_queue);
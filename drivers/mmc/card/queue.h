@@ -3,6 +3,12 @@
 
 #define MMC_REQ_SPECIAL_MASK    (REQ_DISCARD | REQ_FLUSH)
 
+#define MMC_CMDQ_MAX_DEPTH	32
+
+#define MMC_DISCARD_MAX_RANGES		32
+#define MMC_DISCARD_IDLE_MS		500
+#define MMC_DISCARD_CHUNK_SECTORS	(8 << 11)	/* 8MB */
+
 struct request;
 struct task_struct;
 
@@ -17,6 +23,7 @@ struct mmc_blk_request {
 enum mmc_packed_cmd {
 	MMC_PACKED_NONE = 0,
 	MMC_PACKED_WRITE,
+	MMC_PACKED_READ,
 };
 
 struct mmc_queue_req {
@@ -36,6 +43,12 @@ struct mmc_queue_req {
 	u8		packed_num;
 };
 
+/* a run of sectors whose discard has been deferred */
+struct mmc_discard_range {
+	unsigned int		from;
+	unsigned int		nr;
+};
+
 struct mmc_queue {
 	struct mmc_card		*card;
 	struct task_struct	*thread;
@@ -44,6 +57,7 @@ struct mmc_queue {
 #define MMC_QUEUE_SUSPENDED		0
 #define MMC_QUEUE_NEW_REQUEST		1
 #define MMC_QUEUE_URGENT_REQUEST	2
+#define MMC_QUEUE_CMDQ			3
 
 	int			(*issue_fn)(struct mmc_queue *, struct request *);
 	void			*data;
@@ -55,13 +69,32 @@ struct mmc_queue {
 	int			num_of_potential_packed_wr_reqs;
 	int			num_wr_reqs_to_start_packing;
 	bool			no_pack_for_random;
+	bool			rd_packing_enabled;
+	unsigned int		rd_share;	/* running share of reads, of 1024 */
+	unsigned int		avg_rd_sectors;	/* running read size, x8 */
 	int (*err_check_fn) (struct mmc_card *, struct mmc_async_req *);
 	void (*packed_test_fn) (struct request_queue *, struct mmc_queue_req *);
+	struct mmc_queue_req	*cmdq_slot;	/* one per task id */
+	unsigned int		cmdq_depth;
+	unsigned long		cmdq_busy;	/* task ids queued on the card */
+	bool			cmdq_claimed;	/* host held for queued tasks */
+	/* deferred discards, sorted and disjoint, protected by queue_lock */
+	struct mmc_discard_range discard[MMC_DISCARD_MAX_RANGES];
+	int			nr_discards;
+	unsigned int		discard_idle_ms;	/* 0 issues them inline */
+	unsigned int		discard_chunk;	/* sectors per erase when idle */
+	unsigned long		last_io;	/* jiffies at the last burst end */
+	struct delayed_work	discard_work;
 };
 
 extern int mmc_init_queue(struct mmc_queue *, struct mmc_card *, spinlock_t *,
 			  const char *);
 extern void mmc_cleanup_queue(struct mmc_queue *);
+extern int mmc_cmdq_init(struct mmc_queue *, struct mmc_card *);
+extern bool mmc_queue_defer_discard(struct mmc_queue *, unsigned int,
+				    unsigned int);
+extern bool mmc_queue_next_discard(struct mmc_queue *, unsigned int *,
+				   unsigned int *);
 extern int mmc_queue_suspend(struct mmc_queue *, int);
 extern void mmc_queue_resume(struct mmc_queue *);
 
@@ -474,6 +474,7 @@ void mmc_remove_card(struct mmc_card *card)
 	}
 
 	kfree(card->wr_pack_stats.packing_events);
+	kfree(card->wr_pack_stats.rd_packing_events);
 	kfree(card->cached_ext_csd);
 
 	put_device(&card->dev);
@@ -48,6 +48,8 @@
 #define CREATE_TRACE_POINTS
 #include <trace/events/mmc.h>
 
+EXPORT_TRACEPOINT_SYMBOL_GPL(mmc_pm_phase);
+
 static void mmc_clk_scaling(struct mmc_host *host, bool from_wq);
 
 /* If the device is not responding */
@@ -509,6 +511,11 @@ void mmc_start_bkops(struct mmc_card *card, bool from_exception)
 	}
 	pr_info("%s: %s: Starting bkops\n", mmc_hostname(card->host), __func__);
 
+	/* BKOPS_START is not accepted while the command queue is enabled */
+	err = mmc_cmdq_ctrl(card, false);
+	if (err)
+		goto out;
+
 	err = __mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
 			EXT_CSD_BKOPS_START, 1, 0, false, false);
 	if (err) {
@@ -2873,12 +2880,14 @@ static bool mmc_is_vaild_state_for_clk_scaling(struct mmc_host *host,
 	/*
 	 * If the current partition type is RPMB, clock switching may not
 	 * work properly as sending tuning command (CMD21) is illegal in
-	 * this mode.
+	 * this mode. The same holds while the command queue is enabled,
+	 * as tasks may still be queued on the card.
 	 * In case invalid_state is set, we forbid clock scaling, unless,
 	 * its down-scale and "scale_down_in_low_wr_load" is set.
 	 */
 	if (!card || (mmc_card_mmc(card) &&
 		card->part_curr == EXT_CSD_PART_CONFIG_ACC_RPMB) ||
+		card->ext_csd.cmdq_en ||
 		(host->clk_scaling.invalid_state &&
 		!(state == MMC_LOAD_LOW &&
 		host->clk_scaling.scale_down_in_low_wr_load)))
@@ -3304,6 +3313,7 @@ void mmc_stop_host(struct mmc_host *host)
 #endif
 
 	cancel_delayed_work_sync(&host->detect);
+	cancel_work_sync(&host->early_resume_work);
 
 	mmc_flush_scheduled_work();
 
@@ -3512,6 +3522,35 @@ int mmc_cache_ctrl(struct mmc_host *host, u8 enable)
 }
 EXPORT_SYMBOL(mmc_cache_ctrl);
 
+/*
+ * Turn the eMMC command queue ON/OFF.
+ * The queue has to be empty: the card rejects the switch while
+ * tasks are still queued. This function should be called with
+ * host claimed.
+ */
+int mmc_cmdq_ctrl(struct mmc_card *card, bool enable)
+{
+	int err;
+
+	if (!card || !mmc_card_mmc(card) || !card->ext_csd.cmdq_support)
+		return enable ? -EOPNOTSUPP : 0;
+
+	if (card->ext_csd.cmdq_en == enable)
+		return 0;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 enable, card->ext_csd.generic_cmd6_time);
+	if (err) {
+		pr_err("%s: command queue %s error %d\n",
+		       mmc_hostname(card->host), enable ? "on" : "off", err);
+		return err;
+	}
+
+	card->ext_csd.cmdq_en = enable;
+	return 0;
+}
+EXPORT_SYMBOL(mmc_cmdq_ctrl);
+
 #ifdef CONFIG_PM
 
 /**
@@ -3801,6 +3840,56 @@ void mmc_rpm_release(struct mmc_host *host, struct device *dev) {}
 EXPORT_SYMBOL(mmc_rpm_release);
 #endif
 
+/*
+ * Claiming the host runs the host driver's ->enable(), which resumes it
+ * synchronously, and holding the clock ungates it. Doing this under the
+ * claim means the queue thread never races the resume: if it gets there
+ * first it just waits in mmc_claim_host() for a resume that is already
+ * well under way.
+ */
+void mmc_early_resume_work(struct work_struct *work)
+{
+	struct mmc_host *host =
+		container_of(work, struct mmc_host, early_resume_work);
+	struct mmc_card *card = host->card;
+
+	if (card)
+		mmc_rpm_hold(host, &card->dev);
+	mmc_claim_host(host);
+	mmc_host_clk_hold(host);
+	mmc_host_clk_release(host);
+	mmc_release_host(host);
+	if (card)
+		mmc_rpm_release(host, &card->dev);
+
+	trace_mmc_pm_phase(mmc_hostname(host), "early_resume",
+		ktime_to_us(ktime_sub(ktime_get(), host->early_resume_start)));
+}
+
+/**
+ * mmc_host_early_resume() - start waking an idle host ahead of I/O
+ * @host: mmc host
+ *
+ * Called when I/O is about to be queued for @host. If the host is runtime
+ * suspended or its clock is gated, start bringing it back in the
+ * background so the first request after idle does not pay for the whole
+ * resume at dispatch time. Safe to call from atomic context.
+ */
+void mmc_host_early_resume(struct mmc_host *host)
+{
+	bool idle = host->clk_gated || pm_runtime_suspended(mmc_dev(host));
+
+	if (!idle && host->card && mmc_use_core_runtime_pm(host))
+		idle = pm_runtime_suspended(&host->card->dev);
+
+	if (!idle || work_pending(&host->early_resume_work))
+		return;
+
+	host->early_resume_start = ktime_get();
+	queue_work(system_freezable_wq, &host->early_resume_work);
+}
+EXPORT_SYMBOL(mmc_host_early_resume);
+
 /**
  * mmc_init_context_info() - init synchronization context
  * @host: mmc host
@@ -434,6 +434,23 @@ static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
 		}
 	}
 
+	if (pack_stats->rd_packing_events) {
+		snprintf(temp_buf, TEMP_BUF_SIZE,
+			 "%s: read packing statistics:\n",
+			 mmc_hostname(card->host));
+		strlcat(ubuf, temp_buf, cnt);
+
+		for (i = 1 ; i <= card->ext_csd.max_packed_reads ; ++i) {
+			if (pack_stats->rd_packing_events[i]) {
+				snprintf(temp_buf, TEMP_BUF_SIZE,
+					 "%s: Packed %d reqs - %d times\n",
+					mmc_hostname(card->host), i,
+					pack_stats->rd_packing_events[i]);
+				strlcat(ubuf, temp_buf, cnt);
+			}
+		}
+	}
+
 	snprintf(temp_buf, TEMP_BUF_SIZE,
 		 "%s: stopped packing due to the following reasons:\n",
 		 mmc_hostname(card->host));
@@ -511,6 +528,33 @@ static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
 		strlcat(ubuf, temp_buf, cnt);
 	}
 
+	snprintf(temp_buf, TEMP_BUF_SIZE,
+		 "%s: not packed due to the following reasons:\n",
+		 mmc_hostname(card->host));
+	strlcat(ubuf, temp_buf, cnt);
+
+	for (i = 0 ; i < MAX_NO_PACK_REASONS ; ++i) {
+		static const char * const no_pack_reason_str[] = {
+			[NO_PACK_UNSUPPORTED]	  = "not supported",
+			[NO_PACK_CONTROL]	  = "packing control",
+			[NO_PACK_REL_WRITE]	  = "rel write",
+			[NO_PACK_LARGE_SEC_ALIGN] = "Large sector alignment",
+			[NO_PACK_FUA]		  = "fua request",
+			[NO_PACK_LARGE_REQ]	  = "large request",
+			[NO_PACK_HOST_BUSY]	  = "host busy (read)",
+			[NO_PACK_SINGLE]	  = "nothing to pack with",
+		};
+
+		if (pack_stats->no_pack_reason[i]) {
+			snprintf(temp_buf, TEMP_BUF_SIZE,
+				 "%s: %d times: %s\n",
+				 mmc_hostname(card->host),
+				 pack_stats->no_pack_reason[i],
+				 no_pack_reason_str[i]);
+			strlcat(ubuf, temp_buf, cnt);
+		}
+	}
+
 	spin_unlock(&pack_stats->lock);
 
 	kfree(temp_buf);
@@ -703,7 +747,7 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 			goto err;
 
 	if (mmc_card_mmc(card) && (card->ext_csd.rev >= 6) &&
-	    (card->host->caps2 & MMC_CAP2_PACKED_WR))
+	    (card->host->caps2 & MMC_CAP2_PACKED_CMD))
 		if (!debugfs_create_file("wr_pack_stats", S_IRUSR, root, card,
 					 &mmc_dbg_wr_pack_stats_fops))
 			goto err;
@@ -326,7 +326,7 @@ static int mmc_read_ext_csd(struct mmc_card *card, u8 *ext_csd)
 	}
 
 	card->ext_csd.rev = ext_csd[EXT_CSD_REV];
-	if (card->ext_csd.rev > 7) {
+	if (card->ext_csd.rev > 8) {
 		pr_err("%s: unrecognised EXT_CSD revision %d\n",
 			mmc_hostname(card->host), card->ext_csd.rev);
 		err = -EINVAL;
@@ -599,6 +599,17 @@ static int mmc_read_ext_csd(struct mmc_card *card, u8 *ext_csd)
 			ext_csd[EXT_CSD_MAX_PACKED_READS];
 	}
 
+	/* eMMC v5.1 or later */
+	if (card->ext_csd.rev >= 8) {
+		card->ext_csd.cmdq_support = ext_csd[EXT_CSD_CMDQ_SUPPORT] &
+			EXT_CSD_CMDQ_SUPPORTED;
+		card->ext_csd.cmdq_depth = (ext_csd[EXT_CSD_CMDQ_DEPTH] &
+			EXT_CSD_CMDQ_DEPTH_MASK) + 1;
+	} else {
+		card->ext_csd.cmdq_support = false;
+		card->ext_csd.cmdq_depth = 0;
+	}
+
 out:
 	return err;
 }
@@ -1385,6 +1396,8 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 		}
 
 		card = oldcard;
+		/* The command queue is disabled again by the reset */
+		card->ext_csd.cmdq_en = false;
 	} else {
 		/*
 		 * Allocate card structure.
@@ -1623,6 +1636,16 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 				goto free_card;
 		}
 
+		if ((host->caps2 & MMC_CAP2_PACKED_RD) &&
+		    (card->ext_csd.max_packed_reads > 0)) {
+			card->wr_pack_stats.rd_packing_events = kzalloc(
+				(card->ext_csd.max_packed_reads + 1) *
+				sizeof(*card->wr_pack_stats.rd_packing_events),
+				GFP_KERNEL);
+			if (!card->wr_pack_stats.rd_packing_events)
+				goto free_card;
+		}
+
 		if (card->ext_csd.bkops_en) {
 			INIT_DELAYED_WORK(&card->bkops_info.dw,
 					  mmc_start_idle_time_bkops);
@@ -1787,6 +1810,10 @@ static int mmc_suspend(struct mmc_host *host)
 	if (err)
 		goto out;
 
+	err = mmc_cmdq_ctrl(host->card, false);
+	if (err)
+		goto out;
+
 	if (mmc_card_can_sleep(host))
 		err = mmc_card_sleep(host);
 	else if (!mmc_host_is_spi(host))
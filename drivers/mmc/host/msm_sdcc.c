@@ -47,6 +47,7 @@
 #include <linux/slab.h>
 #include <linux/pm_qos.h>
 #include <linux/iopoll.h>
+#include <trace/events/mmc.h>
 
 #include <asm/cacheflush.h>
 #include <asm/div64.h>
@@ -1243,6 +1244,7 @@ msmsdcc_start_command_deferred(struct msmsdcc_host *host,
 			(!host->curr.mrq->sbc &&
 			(cmd->opcode == MMC_READ_SINGLE_BLOCK ||
 			cmd->opcode == MMC_READ_MULTIPLE_BLOCK ||
+			cmd->opcode == MMC_EXECUTE_READ_TASK ||
 			cmd->opcode == SD_IO_RW_EXTENDED))) {
 			msmsdcc_enable_cdr_cm_sdc4_dll(host);
 			if (host->en_auto_cmd19 &&
@@ -2312,6 +2314,7 @@ msmsdcc_request(struct mmc_host *mmc, struct mmc_request *mrq)
 
 		if ((mrq->cmd->opcode == MMC_WRITE_BLOCK) ||
 		    (mrq->cmd->opcode == MMC_WRITE_MULTIPLE_BLOCK) ||
+		    (mrq->cmd->opcode == MMC_EXECUTE_WRITE_TASK) ||
 		    ((mrq->cmd->opcode == SD_IO_RW_EXTENDED) &&
 		     is_data_pend_for_cmd53(host)))
 			host->curr.use_wr_data_pend = true;
@@ -2727,6 +2730,13 @@ static inline int msmsdcc_is_pwrsave(struct msmsdcc_host *host)
 	return 0;
 }
 
+static inline void msmsdcc_trace_pm_phase(struct msmsdcc_host *host,
+					  const char *phase, ktime_t start)
+{
+	trace_mmc_pm_phase(mmc_hostname(host->mmc), phase,
+			   ktime_to_us(ktime_sub(ktime_get(), start)));
+}
+
 /*
  * Any function calling msmsdcc_setup_clocks must
  * acquire clk_mutex. May sleep.
@@ -2734,9 +2744,14 @@ static inline int msmsdcc_is_pwrsave(struct msmsdcc_host *host)
 static int msmsdcc_setup_clocks(struct msmsdcc_host *host, bool enable)
 {
 	int rc = 0;
+	ktime_t start;
 
 	if (enable && !atomic_read(&host->clks_on)) {
+		start = ktime_get();
 		msmsdcc_msm_bus_cancel_work_and_set_vote(host, &host->mmc->ios);
+		msmsdcc_trace_pm_phase(host, "bus_vote", start);
+
+		start = ktime_get();
 
 		if (!IS_ERR_OR_NULL(host->bus_clk)) {
 			rc = clk_prepare_enable(host->bus_clk);
@@ -2763,6 +2778,7 @@ static int msmsdcc_setup_clocks(struct msmsdcc_host *host, bool enable)
 		mb();
 		msmsdcc_delay(host);
 		atomic_set(&host->clks_on, 1);
+		msmsdcc_trace_pm_phase(host, "clk_enable", start);
 	} else if (!enable && atomic_read(&host->clks_on)) {
 		mb();
 		msmsdcc_delay(host);
@@ -4193,6 +4209,7 @@ static int msmsdcc_execute_tuning(struct mmc_host *mmc, u32 opcode)
 	const u32 *tuning_block_pattern = tuning_block_64;
 	int size = sizeof(tuning_block_64); /* Tuning pattern size in bytes */
 	bool is_tuning_all_phases;
+	ktime_t start = ktime_get();
 
 	pr_debug("%s: Enter %s\n", mmc_hostname(mmc), __func__);
 
@@ -4312,6 +4329,7 @@ out:
 	if (!rc)
 		host->tuning_done = true;
 	spin_unlock_irqrestore(&host->lock, flags);
+	msmsdcc_trace_pm_phase(host, "tuning", start);
 exit:
 	pr_debug("%s: Exit %s\n", mmc_hostname(mmc), __func__);
 	return rc;
@@ -6134,6 +6152,7 @@ msmsdcc_probe(struct platform_device *pdev)
 				MMC_CAP_SET_XPC_180);
 
 	mmc->caps2 |= MMC_CAP2_PACKED_WR;
+	mmc->caps2 |= MMC_CAP2_PACKED_RD;
 	mmc->caps2 |= MMC_CAP2_PACKED_WR_CONTROL;
 	mmc->caps2 |= (MMC_CAP2_BOOTPART_NOACC | MMC_CAP2_DETECT_ON_ERR);
 	mmc->caps2 |= MMC_CAP2_SANITIZE;
@@ -6141,6 +6160,7 @@ msmsdcc_probe(struct platform_device *pdev)
 	mmc->caps2 |= MMC_CAP2_POWEROFF_NOTIFY;
 	mmc->caps2 |= MMC_CAP2_STOP_REQUEST;
 	mmc->caps2 |= MMC_CAP2_ASYNC_SDIO_IRQ_4BIT_MODE;
+	mmc->caps2 |= MMC_CAP2_CMDQ;
 
 	if (plat->nonremovable)
 		mmc->caps |= MMC_CAP_NONREMOVABLE;
@@ -6777,6 +6797,7 @@ msmsdcc_runtime_resume(struct device *dev)
 	struct msmsdcc_host *host = mmc_priv(mmc);
 	unsigned long flags;
 	ktime_t start = ktime_get();
+	ktime_t phase;
 
 	if (host->plat->is_sdio_al_client)
 		goto out;
@@ -6788,7 +6809,9 @@ msmsdcc_runtime_resume(struct device *dev)
 			msmsdcc_ungate_clock(host);
 		}
 
+		phase = ktime_get();
 		mmc_resume_host(mmc);
+		msmsdcc_trace_pm_phase(host, "resume_host", phase);
 
 		/*
 		 * FIXME: Clearing of flags must be handled in clients
@@ -6814,6 +6837,7 @@ msmsdcc_runtime_resume(struct device *dev)
 	}
 	host->pending_resume = false;
 	pr_debug("%s: %s: end\n", mmc_hostname(mmc), __func__);
+	msmsdcc_trace_pm_phase(host, "runtime_resume", start);
 out:
 	msmsdcc_print_pm_stats(host, start, __func__, 0);
 	return 0;
@@ -71,6 +71,8 @@ MODULE_PARM_DESC(msm_rmnet_bam_headroom_check_failure,
 #define DEVICE_ACTIVE        1
 #define DEVICE_UNINITIALIZED 0
 
+#define RMNET_NAPI_WEIGHT  64
+
 #define HEADROOM_FOR_BAM   8 /* for mux header */
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 /* for padding by mux layer */
@@ -88,6 +90,8 @@ struct rmnet_private {
 	spinlock_t lock;
 	spinlock_t tx_queue_lock;
 	struct tasklet_struct tsklt;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
 	u32 operation_mode; /* IOCTL specified mode (protocol, QoS header) */
 	uint8_t device_up;
 	uint8_t in_reset;
@@ -270,6 +274,7 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 		if (RMNET_IS_MODE_IP(opmode)) {
 			/* Driver in IP mode */
 			skb->protocol = rmnet_ip_type_trans(skb, dev);
+			skb_reset_mac_header(skb);
 		} else {
 			/* Driver in Ethernet mode */
 			skb->protocol = eth_type_trans(skb, dev);
@@ -287,12 +292,53 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 			p->stats.rx_packets, skb->len);
 
 		/* Deliver to network stack */
-		netif_rx(skb);
+		if (!netif_running(dev)) {
+			netif_rx_ni(skb);
+			return;
+		}
+
+		/*
+		 * GRO only merges TCP segments with a verified checksum,
+		 * a valid IP header sums to zero so the packet sum works.
+		 */
+		skb->csum = csum_partial(skb->data, skb->len, 0);
+		skb->ip_summed = CHECKSUM_COMPLETE;
+		skb_queue_tail(&p->rx_queue, skb);
+
+		local_bh_disable();
+		napi_schedule(&p->napi);
+		local_bh_enable();
 	} else
 		pr_err("[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
 }
 
+/* Rx NAPI poll, feeds the frames queued by bam_recv_notify() to GRO */
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+						napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&p->rx_queue);
+		if (!skb)
+			break;
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a frame may have been queued after the queue ran dry */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
 static struct sk_buff *_rmnet_add_headroom(struct sk_buff **skb,
 					   struct net_device *dev)
 {
@@ -448,14 +494,17 @@ static int __rmnet_open(struct net_device *dev)
 
 static int rmnet_open(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
 	int rc = 0;
 
 	DBG0("[%s] rmnet_open()\n", dev->name);
 
 	rc = __rmnet_open(dev);
 
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&p->napi);
 		netif_start_queue(dev);
+	}
 
 	return rc;
 }
@@ -478,10 +527,14 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_stop(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
+
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	__rmnet_close(dev);
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
+	skb_queue_purge(&p->rx_queue);
 
 	return 0;
 }
@@ -722,6 +775,12 @@ static int rmnet_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd)
 
 static void __init rmnet_setup(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
+
+	skb_queue_head_init(&p->rx_queue);
+	netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
+	napi_hash_add(&p->napi);
+
 	/* Using Ethernet mode by default */
 	dev->netdev_ops = &rmnet_ops_ether;
 	ether_setup(dev);
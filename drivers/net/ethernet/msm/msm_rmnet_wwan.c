@@ -39,6 +39,7 @@
 #define IPA_RM_INACTIVITY_TIMER 1000
 #define WWAN_DEVICE_COUNT (8)
 #define WWAN_DATA_LEN 2000
+#define WWAN_NAPI_WEIGHT 64
 #define HEADROOM_FOR_A2_MUX   8 /* for mux header */
 #define TAILROOM              8 /* for padding by mux layer */
 
@@ -74,6 +75,8 @@ static enum a2_mux_logical_channel_id
  * @stats: iface statistics
  * @ch_id: channel id
  * @lock: spinlock for mutual exclusion
+ * @napi: rx NAPI context
+ * @rx_queue: rx packets waiting for the NAPI poll
  * @device_status: holds device status
  *
  * WWAN private - holds all relevant info about WWAN driver
@@ -82,6 +85,8 @@ struct wwan_private {
 	struct net_device_stats stats;
 	uint32_t ch_id;
 	spinlock_t lock;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
 	struct completion resource_granted_completion;
 	enum wwan_device_status device_status;
 };
@@ -109,11 +114,14 @@ static __be16 wwan_ip_type_trans(struct sk_buff *skb)
 }
 
 /**
- * a2_mux_recv_notify() - Deliver an RX packet to network stack
+ * a2_mux_recv_notify() - Queue an RX packet for the NAPI poll
  *
  * @skb: skb to be delivered
  * @dev: network device
  *
+ * Called by A2 MUX with the channel lock held and interrupts off, so the
+ * packet is only queued here and handed to GRO from wwan_poll().
+ *
  * Return codes:
  * None
  */
@@ -123,12 +131,60 @@ static void a2_mux_recv_notify(void *dev, struct sk_buff *skb)
 
 	skb->dev = dev;
 	skb->protocol = wwan_ip_type_trans(skb);
+	skb_reset_mac_header(skb);
 	wwan_ptr->stats.rx_packets++;
 	wwan_ptr->stats.rx_bytes += skb->len;
 	pr_debug("[%s] Rx packet #%lu len=%d\n",
 		skb->dev->name,
 		wwan_ptr->stats.rx_packets, skb->len);
-	netif_rx(skb);
+
+	if (!netif_running(skb->dev)) {
+		netif_rx(skb);
+		return;
+	}
+
+	/*
+	 * GRO only merges TCP segments with a verified checksum, a valid IP
+	 * header sums to zero so the sum over the packet can be used.
+	 */
+	skb->csum = csum_partial(skb->data, skb->len, 0);
+	skb->ip_summed = CHECKSUM_COMPLETE;
+	skb_queue_tail(&wwan_ptr->rx_queue, skb);
+	napi_schedule(&wwan_ptr->napi);
+}
+
+/**
+ * wwan_poll() - NAPI poll, deliver queued RX packets through GRO
+ *
+ * @napi: NAPI context of the device
+ * @budget: maximum number of packets to deliver
+ *
+ * Return codes:
+ * number of packets delivered
+ */
+static int wwan_poll(struct napi_struct *napi, int budget)
+{
+	struct wwan_private *wwan_ptr =
+		container_of(napi, struct wwan_private, napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget) {
+		skb = skb_dequeue(&wwan_ptr->rx_queue);
+		if (!skb)
+			break;
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* a packet may have been queued after the queue ran dry */
+		if (!skb_queue_empty(&wwan_ptr->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
 }
 
 /**
@@ -387,12 +443,15 @@ static int __wwan_open(struct net_device *dev)
  */
 static int wwan_open(struct net_device *dev)
 {
+	struct wwan_private *wwan_ptr = netdev_priv(dev);
 	int rc = 0;
 
 	pr_debug("[%s] wwan_open()\n", dev->name);
 	rc = __wwan_open(dev);
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&wwan_ptr->napi);
 		netif_start_queue(dev);
+	}
 	return rc;
 }
 
@@ -453,9 +512,13 @@ static int __wwan_close(struct net_device *dev)
  */
 static int wwan_stop(struct net_device *dev)
 {
+	struct wwan_private *wwan_ptr = netdev_priv(dev);
+
 	pr_debug("[%s] wwan_stop()\n", dev->name);
 	__wwan_close(dev);
 	netif_stop_queue(dev);
+	napi_disable(&wwan_ptr->napi);
+	skb_queue_purge(&wwan_ptr->rx_queue);
 	return 0;
 }
 
@@ -686,6 +749,10 @@ static int __init wwan_init(void)
 		wwan_ptr = netdev_priv(dev);
 		wwan_ptr->ch_id = n;
 		spin_lock_init(&wwan_ptr->lock);
+		skb_queue_head_init(&wwan_ptr->rx_queue);
+		netif_napi_add(dev, &wwan_ptr->napi, wwan_poll,
+			       WWAN_NAPI_WEIGHT);
+		napi_hash_add(&wwan_ptr->napi);
 		init_completion(&wwan_ptr->resource_granted_completion);
 		memset(&ipa_rm_params, 0, sizeof(struct ipa_rm_create_params));
 		ipa_rm_params.name = ipa_rm_resource_by_ch_id[n];
@@ -1,4 +1,4 @@
-/* Copyright (c) 2012,2014, The Linux Foundation. All rights reserved.
+/* Copyright (c) 2012,2014-2015, The Linux Foundation. All rights reserved.
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 and
@@ -14,124 +14,187 @@
 #include <linux/err.h>
 #include <linux/wcnss_wlan.h>
 #include <linux/spinlock.h>
+#include <linux/sort.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 static DEFINE_SPINLOCK(alloc_lock);
 
-struct wcnss_prealloc {
-	int occupied;
+/*
+ * The preallocated memory is split in size classes. Each class keeps its
+ * free chunks on a stack so a request is served from the smallest class
+ * that fits without scanning the chunks, and falls over to the next larger
+ * class only when that one is exhausted. The number of chunks per class can
+ * be changed on the kernel command line with wcnss_prealloc.class_count=.
+ */
+struct wcnss_prealloc_class {
 	unsigned int size;
+	unsigned int count;
+	unsigned int used;
+	unsigned int peak;
+	unsigned long hits;
+	unsigned long borrowed;
+	unsigned long misses;
+	void **free;
+};
+
+struct wcnss_prealloc_chunk {
 	void *ptr;
+	struct wcnss_prealloc_class *class;
 };
 
 /* pre-alloced mem for WLAN driver */
-static struct wcnss_prealloc wcnss_allocs[] = {
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 12 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 16 * 1024, NULL},
-	{0, 24 * 1024, NULL},
-	{0, 24 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 76 * 1024, NULL},
+static struct wcnss_prealloc_class wcnss_classes[] = {
+	{ .size = 8  * 1024 },
+	{ .size = 12 * 1024 },
+	{ .size = 16 * 1024 },
+	{ .size = 24 * 1024 },
+	{ .size = 32 * 1024 },
+	{ .size = 64 * 1024 },
+	{ .size = 76 * 1024 },
+};
+
+static unsigned int class_count[ARRAY_SIZE(wcnss_classes)] = {
+	8, 36, 6, 2, 8, 4, 1,
 };
+module_param_array(class_count, uint, NULL, 0444);
+MODULE_PARM_DESC(class_count,
+	"Chunks per size class (8K,12K,16K,24K,32K,64K,76K)");
+
+/* every chunk sorted by address, to find the owner class on put */
+static struct wcnss_prealloc_chunk *wcnss_chunks;
+static unsigned int wcnss_nr_chunks;
+static unsigned long wcnss_oversize;
+static unsigned int wcnss_max_oversize;
+static struct dentry *wcnss_prealloc_dent;
+
+static int wcnss_chunk_cmp(const void *a, const void *b)
+{
+	const struct wcnss_prealloc_chunk *ca = a, *cb = b;
+
+	if (ca->ptr == cb->ptr)
+		return 0;
+	return ca->ptr < cb->ptr ? -1 : 1;
+}
+
+static struct wcnss_prealloc_chunk *wcnss_chunk_find(void *ptr)
+{
+	unsigned int lo = 0, hi = wcnss_nr_chunks, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (wcnss_chunks[mid].ptr == ptr)
+			return &wcnss_chunks[mid];
+		if (wcnss_chunks[mid].ptr < ptr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
 
 int wcnss_prealloc_init(void)
 {
-	int i;
+	struct wcnss_prealloc_class *class;
+	unsigned int total = 0;
+	int i, j, n = 0;
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++)
+		total += class_count[i];
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		wcnss_allocs[i].occupied = 0;
-		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
-		if (wcnss_allocs[i].ptr == NULL)
-			return -ENOMEM;
+	wcnss_chunks = kcalloc(total, sizeof(*wcnss_chunks), GFP_KERNEL);
+	if (wcnss_chunks == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		class = &wcnss_classes[i];
+		class->used = 0;
+		class->count = 0;
+		class->free = kcalloc(class_count[i], sizeof(void *),
+				GFP_KERNEL);
+		if (class->free == NULL)
+			goto fail;
+
+		for (j = 0; j < class_count[i]; j++) {
+			void *ptr = kmalloc(class->size, GFP_KERNEL);
+
+			if (ptr == NULL)
+				goto fail;
+			class->free[class->count++] = ptr;
+			wcnss_chunks[n].ptr = ptr;
+			wcnss_chunks[n].class = class;
+			n++;
+		}
 	}
 
+	wcnss_nr_chunks = n;
+	sort(wcnss_chunks, n, sizeof(*wcnss_chunks), wcnss_chunk_cmp, NULL);
+
 	return 0;
+
+fail:
+	wcnss_nr_chunks = n;
+	wcnss_prealloc_deinit();
+	return -ENOMEM;
 }
 
 void wcnss_prealloc_deinit(void)
 {
-	int i = 0;
+	int i;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		kfree(wcnss_allocs[i].ptr);
-		wcnss_allocs[i].ptr = NULL;
+	for (i = 0; i < wcnss_nr_chunks; i++)
+		kfree(wcnss_chunks[i].ptr);
+
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		kfree(wcnss_classes[i].free);
+		wcnss_classes[i].free = NULL;
+		wcnss_classes[i].count = 0;
+		wcnss_classes[i].used = 0;
 	}
+
+	kfree(wcnss_chunks);
+	wcnss_chunks = NULL;
+	wcnss_nr_chunks = 0;
 }
 
 void *wcnss_prealloc_get(unsigned int size)
 {
-	int i = 0;
+	struct wcnss_prealloc_class *class, *want = NULL;
 	unsigned long flags;
+	void *ptr;
+	int i;
 
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		class = &wcnss_classes[i];
+		if (class->size < size)
 			continue;
 
-		if (wcnss_allocs[i].size > size) {
-			/* we found the slot */
-			wcnss_allocs[i].occupied = 1;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			return wcnss_allocs[i].ptr;
-		}
+		if (want == NULL)
+			want = class;
+
+		if (class->used == class->count)
+			continue;
+
+		/* we found the slot */
+		ptr = class->free[class->count - ++class->used];
+		if (class->used > class->peak)
+			class->peak = class->used;
+		if (class == want)
+			class->hits++;
+		else
+			class->borrowed++;
+		spin_unlock_irqrestore(&alloc_lock, flags);
+		return ptr;
+	}
+
+	if (want) {
+		want->misses++;
+	} else {
+		wcnss_oversize++;
+		if (size > wcnss_max_oversize)
+			wcnss_max_oversize = size;
 	}
 	spin_unlock_irqrestore(&alloc_lock, flags);
 	pr_err("wcnss: %s: prealloc not available for size: %d\n",
@@ -143,30 +206,75 @@ EXPORT_SYMBOL(wcnss_prealloc_get);
 
 int wcnss_prealloc_put(void *ptr)
 {
-	int i = 0;
+	struct wcnss_prealloc_chunk *chunk;
+	struct wcnss_prealloc_class *class;
 	unsigned long flags;
 
+	chunk = wcnss_chunk_find(ptr);
+	if (chunk == NULL)
+		return 0;
+
+	class = chunk->class;
 	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			return 1;
-		}
+	class->free[class->count - class->used--] = ptr;
+	spin_unlock_irqrestore(&alloc_lock, flags);
+
+	return 1;
+}
+EXPORT_SYMBOL(wcnss_prealloc_put);
+
+static int wcnss_prealloc_stats_show(struct seq_file *s, void *unused)
+{
+	struct wcnss_prealloc_class *class;
+	unsigned long flags;
+	int i;
+
+	seq_puts(s, "size count used peak hits borrowed misses\n");
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(wcnss_classes); i++) {
+		class = &wcnss_classes[i];
+		seq_printf(s, "%u %u %u %u %lu %lu %lu\n", class->size,
+				class->count, class->used, class->peak,
+				class->hits, class->borrowed, class->misses);
 	}
+	seq_printf(s, "oversize: %lu (largest %u)\n", wcnss_oversize,
+			wcnss_max_oversize);
 	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return 0;
 }
-EXPORT_SYMBOL(wcnss_prealloc_put);
+
+static int wcnss_prealloc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wcnss_prealloc_stats_show, inode->i_private);
+}
+
+static const struct file_operations wcnss_prealloc_stats_fops = {
+	.open = wcnss_prealloc_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 
 static int __init wcnss_pre_alloc_init(void)
 {
-	return wcnss_prealloc_init();
+	int ret;
+
+	ret = wcnss_prealloc_init();
+	if (ret)
+		return ret;
+
+	wcnss_prealloc_dent = debugfs_create_file("wcnss_prealloc", 0444,
+			NULL, NULL, &wcnss_prealloc_stats_fops);
+	if (IS_ERR(wcnss_prealloc_dent))
+		wcnss_prealloc_dent = NULL;
+
+	return 0;
 }
 
 static void __exit wcnss_pre_alloc_exit(void)
 {
+	debugfs_remove(wcnss_prealloc_dent);
 	wcnss_prealloc_deinit();
 }
 
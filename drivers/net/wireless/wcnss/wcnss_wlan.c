@@ -2915,6 +2915,9 @@ wcnss_wlan_probe(struct platform_device *pdev)
 	 */
 	pr_info(DEVICE " probed in built-in mode\n");
 
+	/* WLAN suspend and resume only talk to WCNSS over SMD */
+	device_enable_async_suspend(&pdev->dev);
+
 	misc_register(&wcnss_usr_ctrl);
 
 	return misc_register(&wcnss_misc);
@@ -2981,7 +2984,7 @@ static void __exit wcnss_wlan_exit(void)
 	platform_driver_unregister(&wcnss_wlan_driver);
 }
 
-module_init(wcnss_wlan_init);
+async_initcall(wcnss_wlan_init);
 module_exit(wcnss_wlan_exit);
 
 MODULE_LICENSE("GPL v2");
@@ -612,12 +612,12 @@ static struct i2c_driver pn544_driver = {
  * module load/unload record keeping
  */
 
-static int __init pn544_dev_init(void)
+static int pn544_dev_init(void)
 {
 	pr_info("Loading pn544 driver\n");
 	return i2c_add_driver(&pn544_driver);
 }
-module_init(pn544_dev_init);
+deferred_initcall(pn544_dev_init);
 
 static void __exit pn544_dev_exit(void)
 {
@@ -818,14 +818,14 @@ static void handle_a2_mux_cmd(struct sk_buff *rx_skb)
 		IPAERR("bad hdr magic %x rvd %d cmd %d pad %d ch %d len %d\n",
 		       rx_hdr->magic_num, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
 		return;
 	}
 	if (rx_hdr->ch_id >= A2_MUX_NUM_CHANNELS) {
 		IPAERR("bad LCID %d rsvd %d cmd %d pad %d ch %d len %d\n",
 			rx_hdr->ch_id, rx_hdr->reserved, rx_hdr->cmd,
 			rx_hdr->pad_len, rx_hdr->ch_id, rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
 		return;
 	}
 	switch (rx_hdr->cmd) {
@@ -841,7 +841,7 @@ static void handle_a2_mux_cmd(struct sk_buff *rx_skb)
 								__func__);
 			a2_mux_ctx->disconnect_ack = 0;
 		}
-		dev_kfree_skb_any(rx_skb);
+		skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
 		if (a2_mux_ctx->a2_mux_send_power_vote_on_init_once) {
 			kickoff_ul_wakeup_func(NULL);
 			a2_mux_ctx->a2_mux_send_power_vote_on_init_once = 0;
@@ -855,7 +855,7 @@ static void handle_a2_mux_cmd(struct sk_buff *rx_skb)
 			ul_wakeup();
 		}
 		handle_a2_mux_cmd_open(rx_hdr);
-		dev_kfree_skb_any(rx_skb);
+		skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
 		break;
 	case BAM_MUX_HDR_CMD_CLOSE:
 		/* probably should drop pending write */
@@ -867,14 +867,14 @@ static void handle_a2_mux_cmd(struct sk_buff *rx_skb)
 			~BAM_CH_REMOTE_OPEN;
 		spin_unlock_irqrestore(
 			&a2_mux_ctx->bam_ch[rx_hdr->ch_id].lock, flags);
-		dev_kfree_skb_any(rx_skb);
+		skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
 		break;
 	default:
 		IPAERR("bad hdr.magic %x rvd %d cmd %d pad %d ch %d len %d\n",
 			rx_hdr->magic_num, rx_hdr->reserved,
 			rx_hdr->cmd, rx_hdr->pad_len, rx_hdr->ch_id,
 			rx_hdr->pkt_len);
-		dev_kfree_skb_any(rx_skb);
+		skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
 		return;
 	}
 }
@@ -1857,6 +1857,13 @@ static int ipa_init(const struct ipa_plat_drv_res *resource_p)
 		result = -ENOMEM;
 		goto fail_rx_pkt_wrapper_cache;
 	}
+	ipa_ctx->rx_recycle = skb_recycle_pool_create(IPA_RX_SKB_SIZE,
+			IPA_RX_RECYCLE_MAX);
+	if (!ipa_ctx->rx_recycle) {
+		IPAERR(":ipa rx recycle pool create failed\n");
+		result = -ENOMEM;
+		goto fail_rx_recycle;
+	}
 	ipa_ctx->tree_node_cache =
 	   kmem_cache_create("IPA TREE", sizeof(struct ipa_tree_node), 0, 0,
 			   NULL);
@@ -1936,6 +1943,7 @@ static int ipa_init(const struct ipa_plat_drv_res *resource_p)
 			atomic_set(&ipa_ctx->sys[i].curr_polling_state, 1);
 		else
 			atomic_set(&ipa_ctx->sys[i].curr_polling_state, 0);
+		ipa_init_sys_polling(&ipa_ctx->sys[i], i == IPA_A5_LAN_WAN_IN);
 	}
 
 	ipa_ctx->rx_wq = create_singlethread_workqueue("ipa rx wq");
@@ -2059,6 +2067,9 @@ static int ipa_init(const struct ipa_plat_drv_res *resource_p)
 			result = -ENODEV;
 			goto fail_cdev_add;
 		}
+
+		/* flows stay on the CPU path if the offload can't start */
+		ipa_nat_offload_init();
 	}
 
 	/* gate IPA clocks */
@@ -2098,6 +2109,8 @@ fail_rx_wq:
 fail_dma_pool:
 	kmem_cache_destroy(ipa_ctx->tree_node_cache);
 fail_tree_node_cache:
+	skb_recycle_pool_destroy(ipa_ctx->rx_recycle);
+fail_rx_recycle:
 	kmem_cache_destroy(ipa_ctx->rx_pkt_wrapper_cache);
 fail_rx_pkt_wrapper_cache:
 	kmem_cache_destroy(ipa_ctx->tx_pkt_wrapper_cache);
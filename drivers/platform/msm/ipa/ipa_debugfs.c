@@ -105,6 +105,7 @@ static struct dentry *dfile_dbg_cnt;
 static struct dentry *dfile_msg;
 static struct dentry *dfile_ip4_nat;
 static struct dentry *dfile_rm_stats;
+static struct dentry *dfile_polling;
 static char dbg_buff[IPA_MAX_MSG_LEN];
 static s8 ep_reg_idx;
 
@@ -633,10 +634,15 @@ static ssize_t ipa_read_stats(struct file *file, char __user *ubuf,
 	int i;
 	int cnt = 0;
 	uint connect = 0;
+	struct skb_recycle_stats recycle;
+	unsigned long allocs;
 
 	for (i = 0; i < IPA_NUM_PIPES; i++)
 		connect |= (ipa_ctx->ep[i].valid << i);
 
+	skb_recycle_pool_stats(ipa_ctx->rx_recycle, &recycle);
+	allocs = recycle.alloc_hits + recycle.alloc_misses;
+
 	nbytes = scnprintf(dbg_buff, IPA_MAX_MSG_LEN,
 			"sw_tx=%u\n"
 			"hw_tx=%u\n"
@@ -652,7 +658,9 @@ static ssize_t ipa_read_stats(struct file *file, char __user *ubuf,
 			"a2_power_off_reqs_in=%u\n"
 			"a2_power_off_reqs_out=%u\n"
 			"a2_power_modem_acks=%u\n"
-			"a2_power_apps_acks=%u\n",
+			"a2_power_apps_acks=%u\n"
+			"nat_offload_flows=%u\n"
+			"nat_offload_collisions=%u\n",
 			ipa_ctx->stats.tx_sw_pkts,
 			ipa_ctx->stats.tx_hw_pkts,
 			ipa_ctx->stats.rx_pkts,
@@ -667,7 +675,9 @@ static ssize_t ipa_read_stats(struct file *file, char __user *ubuf,
 			ipa_ctx->stats.a2_power_off_reqs_in,
 			ipa_ctx->stats.a2_power_off_reqs_out,
 			ipa_ctx->stats.a2_power_modem_acks,
-			ipa_ctx->stats.a2_power_apps_acks);
+			ipa_ctx->stats.a2_power_apps_acks,
+			ipa_ctx->stats.nat_offload_flows,
+			ipa_ctx->stats.nat_offload_collisions);
 	cnt += nbytes;
 
 	for (i = 0; i < MAX_NUM_EXCP; i++) {
@@ -677,6 +687,19 @@ static ssize_t ipa_read_stats(struct file *file, char __user *ubuf,
 		cnt += nbytes;
 	}
 
+	nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+			"rx_recycle_hits=%lu\n"
+			"rx_recycle_misses=%lu\n"
+			"rx_recycle_recycled=%lu\n"
+			"rx_recycle_dropped=%lu\n"
+			"rx_recycle_hit_pct=%lu\n",
+			recycle.alloc_hits,
+			recycle.alloc_misses,
+			recycle.recycled,
+			recycle.dropped,
+			allocs ? recycle.alloc_hits * 100 / allocs : 0);
+	cnt += nbytes;
+
 	for (i = 0; i < IPA_BRIDGE_TYPE_MAX; i++) {
 		nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
 				"brg_pkt[%u:%s][dl]=%u\n"
@@ -742,6 +765,106 @@ static ssize_t ipa_read_dbg_cnt(struct file *file, char __user *ubuf,
 	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, nbytes);
 }
 
+static ssize_t ipa_read_polling(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	static const u32 pipes[] = { IPA_A5_LAN_WAN_OUT, IPA_A5_LAN_WAN_IN };
+	struct ipa_sys_context *sys;
+	u64 intr_us;
+	u64 poll_us;
+	s64 cur_us;
+	int nbytes;
+	int cnt = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(pipes); i++) {
+		sys = &ipa_ctx->sys[pipes[i]];
+
+		/* add the time spent so far in the current mode */
+		intr_us = sys->intr_us;
+		poll_us = sys->poll_us;
+		cur_us = ktime_us_delta(ktime_get(), sys->mode_ts);
+		if (atomic_read(&sys->curr_polling_state))
+			poll_us += cur_us;
+		else
+			intr_us += cur_us;
+
+		nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+				"sys[%u:%s]\n"
+				"inactivity_min=%u\n"
+				"inactivity_max=%u\n"
+				"rate_hi=%u\n"
+				"min_sleep_us=%u\n"
+				"max_sleep_us=%u\n"
+				"rate=%u\n"
+				"inactivity=%u\n"
+				"mode=%s\n"
+				"intr_us=%llu\n"
+				"poll_us=%llu\n"
+				"intr_to_poll=%u\n"
+				"poll_to_intr=%u\n",
+				pipes[i], pipes[i] == IPA_A5_LAN_WAN_IN ?
+				"rx" : "tx",
+				sys->poll.inactivity_min,
+				sys->poll.inactivity_max,
+				sys->poll.rate_hi,
+				sys->poll.min_sleep_us,
+				sys->poll.max_sleep_us,
+				sys->poll_rate,
+				ipa_poll_inactivity(sys),
+				atomic_read(&sys->curr_polling_state) ?
+				"poll" : "intr",
+				intr_us, poll_us,
+				sys->intr_to_poll,
+				sys->poll_to_intr);
+		cnt += nbytes;
+	}
+
+	nbytes = scnprintf(dbg_buff + cnt, IPA_MAX_MSG_LEN - cnt,
+			"repl_pool_len=%u\n",
+			ipa_ctx->sys[IPA_A5_LAN_WAN_IN].repl_pool_len);
+	cnt += nbytes;
+
+	return simple_read_from_buffer(ubuf, count, ppos, dbg_buff, cnt);
+}
+
+/*
+ * Expected format: <sys> <inactivity_min> <inactivity_max> <rate_hi>
+ * <min_sleep_us> <max_sleep_us>, with <sys> the LAN/WAN OUT or IN index
+ */
+static ssize_t ipa_write_polling(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	unsigned long missing;
+	struct ipa_poll_params poll;
+	u32 pipe;
+
+	if (sizeof(dbg_buff) < count + 1)
+		return -EFAULT;
+
+	missing = copy_from_user(dbg_buff, buf, count);
+	if (missing)
+		return -EFAULT;
+
+	dbg_buff[count] = '\0';
+	if (sscanf(dbg_buff, "%u %u %u %u %u %u", &pipe,
+			&poll.inactivity_min, &poll.inactivity_max,
+			&poll.rate_hi, &poll.min_sleep_us,
+			&poll.max_sleep_us) != 6)
+		return -EINVAL;
+
+	if ((pipe != IPA_A5_LAN_WAN_OUT && pipe != IPA_A5_LAN_WAN_IN) ||
+	    poll.inactivity_min > poll.inactivity_max ||
+	    poll.min_sleep_us > poll.max_sleep_us) {
+		IPAERR("invalid polling parameters\n");
+		return -EINVAL;
+	}
+
+	ipa_ctx->sys[pipe].poll = poll;
+
+	return count;
+}
+
 static ssize_t ipa_read_msg(struct file *file, char __user *ubuf,
 		size_t count, loff_t *ppos)
 {
@@ -1055,6 +1178,11 @@ const struct file_operations ipa_rm_stats = {
 	.read = ipa_rm_read_stats,
 };
 
+const struct file_operations ipa_polling_ops = {
+	.read = ipa_read_polling,
+	.write = ipa_write_polling,
+};
+
 void ipa_debugfs_init(void)
 {
 	const mode_t read_only_mode = S_IRUSR | S_IRGRP | S_IROTH;
@@ -1159,6 +1287,13 @@ void ipa_debugfs_init(void)
 		IPAERR("fail to create file for debug_fs rm_stats\n");
 		goto fail;
 	}
+
+	dfile_polling = debugfs_create_file("polling", read_write_mode, dent,
+			0, &ipa_polling_ops);
+	if (!dfile_polling || IS_ERR(dfile_polling)) {
+		IPAERR("fail to create file for debug_fs polling\n");
+		goto fail;
+	}
 	return;
 
 fail:
@@ -13,21 +13,28 @@
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/dmapool.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/math64.h>
 #include <linux/netdevice.h>
 #include "ipa_i.h"
 
 
 #define IPA_LAST_DESC_CNT 0xFFFF
+#define POLLING_INACTIVITY_MIN_RX 10
 #define POLLING_INACTIVITY_RX 40
 #define POLLING_MIN_SLEEP_RX 950
 #define POLLING_MAX_SLEEP_RX 1050
+#define POLLING_INACTIVITY_MIN_TX 10
 #define POLLING_INACTIVITY_TX 40
 #define POLLING_MIN_SLEEP_TX 400
 #define POLLING_MAX_SLEEP_TX 500
+#define POLLING_RATE_HI 8
 
 static void replenish_rx_work_func(struct work_struct *work);
 static struct delayed_work replenish_rx_work;
+static void repl_pool_work_func(struct work_struct *work);
+static DECLARE_WORK(repl_pool_work, repl_pool_work_func);
 static void ipa_wq_handle_rx(struct work_struct *work);
 static DECLARE_WORK(rx_work, ipa_wq_handle_rx);
 static void ipa_wq_handle_tx(struct work_struct *work);
@@ -142,6 +149,99 @@ int ipa_handle_tx_core(struct ipa_sys_context *sys, bool process_all,
 	return cnt;
 }
 
+/**
+ * ipa_init_sys_polling() - Set the default polling tunables of a system pipe
+ * @sys:	system pipe context
+ * @rx:	true for the Rx pipe, false for a Tx pipe
+ *
+ * Also initializes the mode statistics and the Rx replenish pool.
+ */
+void ipa_init_sys_polling(struct ipa_sys_context *sys, bool rx)
+{
+	if (rx) {
+		sys->poll.inactivity_min = POLLING_INACTIVITY_MIN_RX;
+		sys->poll.inactivity_max = POLLING_INACTIVITY_RX;
+		sys->poll.min_sleep_us = POLLING_MIN_SLEEP_RX;
+		sys->poll.max_sleep_us = POLLING_MAX_SLEEP_RX;
+	} else {
+		sys->poll.inactivity_min = POLLING_INACTIVITY_MIN_TX;
+		sys->poll.inactivity_max = POLLING_INACTIVITY_TX;
+		sys->poll.min_sleep_us = POLLING_MIN_SLEEP_TX;
+		sys->poll.max_sleep_us = POLLING_MAX_SLEEP_TX;
+	}
+	sys->poll.rate_hi = POLLING_RATE_HI;
+	sys->mode_ts = ktime_get();
+	INIT_LIST_HEAD(&sys->repl_pool);
+	spin_lock_init(&sys->repl_lock);
+}
+
+/**
+ * ipa_sys_mode_switch() - Account the time spent in the mode being left
+ * @sys:	system pipe context
+ * @to_poll:	true when switching from interrupt to polling mode
+ *
+ * Must be called before curr_polling_state is changed, the state machine
+ * then guarantees only one context updates the statistics at a time.
+ */
+static void ipa_sys_mode_switch(struct ipa_sys_context *sys, bool to_poll)
+{
+	ktime_t now = ktime_get();
+	s64 delta = ktime_us_delta(now, sys->mode_ts);
+
+	if (to_poll) {
+		sys->intr_us += delta;
+		sys->intr_to_poll++;
+	} else {
+		sys->poll_us += delta;
+		sys->poll_to_intr++;
+	}
+	sys->mode_ts = now;
+}
+
+/**
+ * ipa_poll_inactivity() - Number of empty polling cycles before switching
+ * back to interrupt mode, scaled by the measured packet rate
+ * @sys:	system pipe context
+ */
+u32 ipa_poll_inactivity(struct ipa_sys_context *sys)
+{
+	struct ipa_poll_params *poll = &sys->poll;
+	u32 rate;
+
+	if (poll->inactivity_max <= poll->inactivity_min || !poll->rate_hi)
+		return poll->inactivity_min;
+
+	rate = min(sys->poll_rate, poll->rate_hi);
+	return poll->inactivity_min + div_u64((u64)(poll->inactivity_max -
+			poll->inactivity_min) * rate, poll->rate_hi);
+}
+
+/**
+ * ipa_poll_update_rate() - Fold the packet rate of a polling period into
+ * the running average
+ * @sys:	system pipe context
+ * @pkts:	packets handled during the period
+ * @start:	start of the period
+ * @last:	time the last packet was handled
+ *
+ * The trailing empty cycles are not part of the measure, and the period is
+ * at least one polling cycle long so a lone packet doesn't look like a burst.
+ */
+static void ipa_poll_update_rate(struct ipa_sys_context *sys, u32 pkts,
+		ktime_t start, ktime_t last)
+{
+	s64 us = ktime_us_delta(last, start);
+	u32 rate;
+
+	if (us < sys->poll.max_sleep_us)
+		us = sys->poll.max_sleep_us;
+	if (us <= 0)
+		us = 1;
+
+	rate = div64_s64((s64)pkts * USEC_PER_MSEC, us);
+	sys->poll_rate = (3 * sys->poll_rate + rate) / 4;
+}
+
 /**
  * ipa_tx_switch_to_intr_mode() - Operate the Tx data path in interrupt mode
  */
@@ -172,6 +272,7 @@ static void ipa_tx_switch_to_intr_mode(struct ipa_sys_context *sys)
 		IPAERR("sps_set_config() failed %d\n", ret);
 		goto fail;
 	}
+	ipa_sys_mode_switch(sys, false);
 	atomic_set(&sys->curr_polling_state, 0);
 	ipa_handle_tx_core(sys, true, false);
 	return;
@@ -186,18 +287,25 @@ static void ipa_handle_tx(struct ipa_sys_context *sys)
 {
 	int inactive_cycles = 0;
 	int cnt;
+	u32 pkts = 0;
+	ktime_t start, last;
 
 	ipa_inc_client_enable_clks();
+	start = last = ktime_get();
 	do {
 		cnt = ipa_handle_tx_core(sys, true, true);
 		if (cnt == 0) {
 			inactive_cycles++;
-			usleep_range(POLLING_MIN_SLEEP_TX,
-					POLLING_MAX_SLEEP_TX);
+			usleep_range(sys->poll.min_sleep_us,
+					sys->poll.max_sleep_us);
 		} else {
 			inactive_cycles = 0;
+			pkts += cnt;
+			last = ktime_get();
 		}
-	} while (inactive_cycles <= POLLING_INACTIVITY_TX);
+	} while (inactive_cycles <= ipa_poll_inactivity(sys));
+
+	ipa_poll_update_rate(sys, pkts, start, last);
 
 	ipa_tx_switch_to_intr_mode(sys);
 	ipa_dec_client_disable_clks();
@@ -612,6 +720,7 @@ static void ipa_sps_irq_tx_notify(struct sps_event_notify *notify)
 				IPAERR("sps_set_config() failed %d\n", ret);
 				break;
 			}
+			ipa_sys_mode_switch(sys, true);
 			atomic_set(&sys->curr_polling_state, 1);
 			queue_work(ipa_ctx->tx_wq, &tx_work);
 		}
@@ -658,7 +767,7 @@ static void ipa_sps_irq_tx_no_aggr_notify(struct sps_event_notify *notify)
  *  - Free the packet from the cache
  *  - Prepare a proper skb
  *  - Call the endpoints notify function, passing the skb in the parameters
- *  - Replenish the rx cache
+ *  - Replenish the rx cache once a batch of buffers was consumed
  */
 int ipa_handle_rx_core(struct ipa_sys_context *sys, bool process_all,
 		bool in_poll_state)
@@ -739,8 +848,9 @@ int ipa_handle_rx_core(struct ipa_sys_context *sys, bool process_all,
 			IPAERR("drop pipe=%d ep_valid=%d client_notify=%p\n",
 			  src_pipe, ipa_ctx->ep[src_pipe].valid,
 			  ipa_ctx->ep[src_pipe].client_notify);
-			dev_kfree_skb(rx_skb);
-			ipa_replenish_rx_cache();
+			skb_recycle_pool_free(ipa_ctx->rx_recycle, rx_skb);
+			if (IPA_RX_POOL_CEIL - sys->len >= IPA_RX_REPL_BATCH)
+				ipa_replenish_rx_cache();
 			++cnt;
 			continue;
 		}
@@ -759,7 +869,8 @@ int ipa_handle_rx_core(struct ipa_sys_context *sys, bool process_all,
 
 		IPADBG("pulling %d bytes from skb\n", pull_len);
 		skb_pull(rx_skb, pull_len);
-		ipa_replenish_rx_cache();
+		if (IPA_RX_POOL_CEIL - sys->len >= IPA_RX_REPL_BATCH)
+			ipa_replenish_rx_cache();
 		ep->client_notify(ep->priv, IPA_RECEIVE,
 				(unsigned long)(rx_skb));
 		cnt++;
@@ -798,6 +909,7 @@ static void ipa_rx_switch_to_intr_mode(struct ipa_sys_context *sys)
 		IPAERR("sps_set_config() failed %d\n", ret);
 		goto fail;
 	}
+	ipa_sys_mode_switch(sys, false);
 	atomic_set(&sys->curr_polling_state, 0);
 	ipa_handle_rx_core(sys, true, false);
 	return;
@@ -845,6 +957,7 @@ static void ipa_sps_irq_rx_notify(struct sps_event_notify *notify)
 				IPAERR("sps_set_config() failed %d\n", ret);
 				break;
 			}
+			ipa_sys_mode_switch(sys, true);
 			atomic_set(&sys->curr_polling_state, 1);
 			queue_work(ipa_ctx->rx_wq, &rx_work);
 		}
@@ -875,18 +988,25 @@ static void ipa_handle_rx(struct ipa_sys_context *sys)
 {
 	int inactive_cycles = 0;
 	int cnt;
+	u32 pkts = 0;
+	ktime_t start, last;
 
 	ipa_inc_client_enable_clks();
+	start = last = ktime_get();
 	do {
 		cnt = ipa_handle_rx_core(sys, true, true);
 		if (cnt == 0) {
 			inactive_cycles++;
-			usleep_range(POLLING_MIN_SLEEP_RX,
-					POLLING_MAX_SLEEP_RX);
+			usleep_range(sys->poll.min_sleep_us,
+					sys->poll.max_sleep_us);
 		} else {
 			inactive_cycles = 0;
+			pkts += cnt;
+			last = ktime_get();
 		}
-	} while (inactive_cycles <= POLLING_INACTIVITY_RX);
+	} while (inactive_cycles <= ipa_poll_inactivity(sys));
+
+	ipa_poll_update_rate(sys, pkts, start, last);
 
 	ipa_rx_switch_to_intr_mode(sys);
 	ipa_dec_client_disable_clks();
@@ -1251,94 +1371,181 @@ static void ipa_wq_handle_rx(struct work_struct *work)
 	ipa_handle_rx(&ipa_ctx->sys[IPA_A5_LAN_WAN_IN]);
 }
 
+static struct ipa_rx_pkt_wrapper *ipa_alloc_rx_pkt(gfp_t flag)
+{
+	struct ipa_rx_pkt_wrapper *rx_pkt;
+	void *ptr;
+
+	rx_pkt = kmem_cache_zalloc(ipa_ctx->rx_pkt_wrapper_cache, flag);
+	if (!rx_pkt) {
+		IPAERR("failed to alloc rx wrapper\n");
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&rx_pkt->link);
+
+	rx_pkt->skb = skb_recycle_pool_alloc(ipa_ctx->rx_recycle, NULL, flag);
+	if (rx_pkt->skb == NULL) {
+		IPAERR("failed to alloc skb\n");
+		goto fail_skb_alloc;
+	}
+	ptr = skb_put(rx_pkt->skb, IPA_RX_SKB_SIZE);
+	rx_pkt->dma_address = dma_map_single(NULL, ptr,
+					     IPA_RX_SKB_SIZE,
+					     DMA_FROM_DEVICE);
+	if (rx_pkt->dma_address == 0 || rx_pkt->dma_address == ~0) {
+		IPAERR("dma_map_single failure %p for %p\n",
+		       (void *)rx_pkt->dma_address, ptr);
+		goto fail_dma_mapping;
+	}
+
+	return rx_pkt;
+
+fail_dma_mapping:
+	dev_kfree_skb(rx_pkt->skb);
+fail_skb_alloc:
+	kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
+	return NULL;
+}
+
+static void ipa_free_rx_pkt(struct ipa_rx_pkt_wrapper *rx_pkt)
+{
+	dma_unmap_single(NULL, rx_pkt->dma_address, IPA_RX_SKB_SIZE,
+			 DMA_FROM_DEVICE);
+	dev_kfree_skb(rx_pkt->skb);
+	kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
+}
+
+/**
+ * ipa_get_rx_pkt() - Get a mapped rx wrapper, from the replenish pool when
+ * it has one, from the allocator otherwise
+ * @sys:	Rx system pipe context
+ */
+static struct ipa_rx_pkt_wrapper *ipa_get_rx_pkt(struct ipa_sys_context *sys)
+{
+	struct ipa_rx_pkt_wrapper *rx_pkt = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&sys->repl_lock, flags);
+	if (!list_empty(&sys->repl_pool)) {
+		rx_pkt = list_first_entry(&sys->repl_pool,
+					  struct ipa_rx_pkt_wrapper, link);
+		list_del_init(&rx_pkt->link);
+		sys->repl_pool_len--;
+	}
+	spin_unlock_irqrestore(&sys->repl_lock, flags);
+
+	if (!rx_pkt)
+		rx_pkt = ipa_alloc_rx_pkt(GFP_NOWAIT | __GFP_NOWARN);
+
+	return rx_pkt;
+}
+
+/**
+ * ipa_fill_rx_pool() - Refill the replenish pool up to IPA_RX_REPL_POOL_SZ
+ * @sys:	Rx system pipe context
+ *
+ * Runs in process context so the buffers can be allocated with GFP_KERNEL
+ * away from the Rx path.
+ */
+static void ipa_fill_rx_pool(struct ipa_sys_context *sys)
+{
+	struct ipa_rx_pkt_wrapper *rx_pkt;
+	unsigned long flags;
+
+	while (sys->repl_pool_len < IPA_RX_REPL_POOL_SZ) {
+		rx_pkt = ipa_alloc_rx_pkt(GFP_KERNEL);
+		if (!rx_pkt)
+			break;
+
+		spin_lock_irqsave(&sys->repl_lock, flags);
+		list_add_tail(&rx_pkt->link, &sys->repl_pool);
+		sys->repl_pool_len++;
+		spin_unlock_irqrestore(&sys->repl_lock, flags);
+	}
+}
+
+static void repl_pool_work_func(struct work_struct *work)
+{
+	ipa_fill_rx_pool(&ipa_ctx->sys[IPA_A5_LAN_WAN_IN]);
+}
+
 /**
  * ipa_replenish_rx_cache() - Replenish the Rx packets cache.
  *
- * The function allocates buffers in the rx_pkt_wrapper_cache cache until there
- * are IPA_RX_POOL_CEIL buffers in the cache.
- *   - Allocate a buffer in the cache
- *   - Initialized the packets link
- *   - Initialize the packets work struct
- *   - Allocate the packets socket buffer (skb)
- *   - Fill the packets skb with data
- *   - Make the packet DMAable
- *   - Add the packet to the system pipe linked list
- *   - Initiate a SPS transfer so that SPS driver will use this packet later.
+ * The function queues buffers on the Rx pipe until there are
+ * IPA_RX_POOL_CEIL buffers in the cache.
+ *   - Take the missing buffers from the replenish pool, allocate the
+ *     remaining ones (wrapper, skb and DMA mapping)
+ *   - Add the packets to the system pipe linked list
+ *   - Initiate the SPS transfers so that SPS driver will use these packets
+ *     later. Only the last transfer of the batch is submitted to the BAM,
+ *     the previous ones are flagged SPS_IOVEC_FLAG_NO_SUBMIT.
+ *   - Kick the refill of the replenish pool when it runs low.
  */
 void ipa_replenish_rx_cache(void)
 {
-	void *ptr;
 	struct ipa_rx_pkt_wrapper *rx_pkt;
+	struct ipa_rx_pkt_wrapper *next;
 	int ret;
-	int rx_len_cached = 0;
+	int cnt = 0;
+	bool failed = false;
+	u32 flags;
 	struct ipa_sys_context *sys = &ipa_ctx->sys[IPA_A5_LAN_WAN_IN];
-	gfp_t flag = GFP_NOWAIT | __GFP_NOWARN;
+	LIST_HEAD(batch);
 
-	rx_len_cached = sys->len;
-
-	while (rx_len_cached < IPA_RX_POOL_CEIL) {
-		rx_pkt = kmem_cache_zalloc(ipa_ctx->rx_pkt_wrapper_cache,
-					   flag);
-		if (!rx_pkt) {
-			IPAERR("failed to alloc rx wrapper\n");
-			goto fail_kmem_cache_alloc;
-		}
-
-		INIT_LIST_HEAD(&rx_pkt->link);
-
-		rx_pkt->skb = __dev_alloc_skb(IPA_RX_SKB_SIZE, flag);
-		if (rx_pkt->skb == NULL) {
-			IPAERR("failed to alloc skb\n");
-			goto fail_skb_alloc;
-		}
-		ptr = skb_put(rx_pkt->skb, IPA_RX_SKB_SIZE);
-		rx_pkt->dma_address = dma_map_single(NULL, ptr,
-						     IPA_RX_SKB_SIZE,
-						     DMA_FROM_DEVICE);
-		if (rx_pkt->dma_address == 0 || rx_pkt->dma_address == ~0) {
-			IPAERR("dma_map_single failure %p for %p\n",
-			       (void *)rx_pkt->dma_address, ptr);
-			goto fail_dma_mapping;
-		}
+	while (sys->len + cnt < IPA_RX_POOL_CEIL) {
+		rx_pkt = ipa_get_rx_pkt(sys);
+		if (!rx_pkt)
+			break;
+		list_add_tail(&rx_pkt->link, &batch);
+		cnt++;
+	}
 
-		list_add_tail(&rx_pkt->link, &sys->head_desc_list);
-		rx_len_cached = ++sys->len;
+	list_for_each_entry_safe(rx_pkt, next, &batch, link) {
+		flags = list_is_last(&rx_pkt->link, &batch) ?
+			0 : SPS_IOVEC_FLAG_NO_SUBMIT;
+		list_move_tail(&rx_pkt->link, &sys->head_desc_list);
+		sys->len++;
 
 		ret = sps_transfer_one(sys->ep->ep_hdl, rx_pkt->dma_address,
 				       IPA_RX_SKB_SIZE, rx_pkt,
-				       0);
+				       flags);
 
 		if (ret) {
 			IPAERR("sps_transfer_one failed %d\n", ret);
-			goto fail_sps_transfer;
+			list_del(&rx_pkt->link);
+			sys->len--;
+			ipa_free_rx_pkt(rx_pkt);
+			failed = true;
+			break;
 		}
 	}
 
+	list_for_each_entry_safe(rx_pkt, next, &batch, link) {
+		list_del(&rx_pkt->link);
+		ipa_free_rx_pkt(rx_pkt);
+	}
+
 	ipa_ctx->stats.rx_q_len = sys->len;
 
-	return;
+	if (sys->repl_pool_len < IPA_RX_REPL_POOL_SZ / 2)
+		schedule_work(&repl_pool_work);
 
-fail_sps_transfer:
-	list_del(&rx_pkt->link);
-	rx_len_cached = --sys->len;
-	dma_unmap_single(NULL, rx_pkt->dma_address, IPA_RX_SKB_SIZE,
-			 DMA_FROM_DEVICE);
-fail_dma_mapping:
-	dev_kfree_skb(rx_pkt->skb);
-fail_skb_alloc:
-	kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
-fail_kmem_cache_alloc:
-	if (rx_len_cached == 0) {
+	/*
+	 * Retry later when the pipe ran dry, or when a failed transfer may
+	 * have left descriptors of the batch unsubmitted
+	 */
+	if (sys->len == 0 || failed) {
 		IPA_STATS_INC_CNT(ipa_ctx->stats.rx_repl_repost);
 		schedule_delayed_work(&replenish_rx_work,
 				msecs_to_jiffies(100));
 	}
-	ipa_ctx->stats.rx_q_len = sys->len;
-	return;
 }
 
 static void replenish_rx_work_func(struct work_struct *work)
 {
+	ipa_fill_rx_pool(&ipa_ctx->sys[IPA_A5_LAN_WAN_IN]);
 	ipa_replenish_rx_cache();
 }
 
@@ -1355,10 +1562,14 @@ void ipa_cleanup_rx(void)
 	list_for_each_entry_safe(rx_pkt, r,
 				 &sys->head_desc_list, link) {
 		list_del(&rx_pkt->link);
-		dma_unmap_single(NULL, rx_pkt->dma_address, IPA_RX_SKB_SIZE,
-				 DMA_FROM_DEVICE);
-		dev_kfree_skb(rx_pkt->skb);
-		kmem_cache_free(ipa_ctx->rx_pkt_wrapper_cache, rx_pkt);
+		ipa_free_rx_pkt(rx_pkt);
+	}
+
+	cancel_work_sync(&repl_pool_work);
+	list_for_each_entry_safe(rx_pkt, r, &sys->repl_pool, link) {
+		list_del(&rx_pkt->link);
+		ipa_free_rx_pkt(rx_pkt);
 	}
+	sys->repl_pool_len = 0;
 }
 
@@ -115,6 +115,9 @@
 
 #define IPA_RX_POOL_CEIL 32
 #define IPA_RX_SKB_SIZE 2048
+#define IPA_RX_REPL_BATCH 8
+#define IPA_RX_REPL_POOL_SZ 16
+#define IPA_RX_RECYCLE_MAX 64
 
 #define IPA_DFLT_HDR_NAME "ipa_excp_hdr"
 #define IPA_INVALID_L4_PROTOCOL 0xFF
@@ -365,6 +368,29 @@ struct ipa_ep_context {
 	bool suspended;
 };
 
+/**
+ * struct ipa_poll_params - IPA system pipe polling tunables
+ * @inactivity_min: empty polling cycles before leaving polling mode when
+ * the pipe is quiet
+ * @inactivity_max: empty polling cycles before leaving polling mode when
+ * the packet rate reaches @rate_hi
+ * @rate_hi: packet rate, in packets per ms, at which polling lasts longest
+ * @min_sleep_us: minimal sleep between two polling cycles
+ * @max_sleep_us: maximal sleep between two polling cycles
+ *
+ * The number of empty cycles tolerated in polling mode grows linearly with
+ * the measured packet rate between @inactivity_min and @inactivity_max, so
+ * bursty high throughput traffic stays in polling mode while sparse traffic
+ * goes back to interrupt mode quickly.
+ */
+struct ipa_poll_params {
+	u32 inactivity_min;
+	u32 inactivity_max;
+	u32 rate_hi;
+	u32 min_sleep_us;
+	u32 max_sleep_us;
+};
+
 /**
  * struct ipa_sys_context - IPA endpoint context for system to BAM pipes
  * @head_desc_list: header descriptors list
@@ -372,6 +398,17 @@ struct ipa_ep_context {
  * @spinlock: protects the list and its size
  * @event: used to request CALLBACK mode from SPS driver
  * @ep: IPA EP context
+ * @poll: polling tunables of the pipe
+ * @poll_rate: averaged packet rate of the last polling periods, in packets
+ * per ms
+ * @mode_ts: time of the last switch between interrupt and polling mode
+ * @intr_us: total time spent in interrupt mode
+ * @poll_us: total time spent in polling mode
+ * @intr_to_poll: number of switches from interrupt to polling mode
+ * @poll_to_intr: number of switches from polling to interrupt mode
+ * @repl_pool: preallocated and mapped rx wrappers used by the replenish
+ * @repl_pool_len: the size of the above list
+ * @repl_lock: protects the replenish pool and its size
  *
  * IPA context specific to the system-bam pipes a.k.a LAN IN/OUT and WAN
  */
@@ -383,6 +420,16 @@ struct ipa_sys_context {
 	struct ipa_ep_context *ep;
 	atomic_t curr_polling_state;
 	struct delayed_work switch_to_intr_work;
+	struct ipa_poll_params poll;
+	u32 poll_rate;
+	ktime_t mode_ts;
+	u64 intr_us;
+	u64 poll_us;
+	u32 intr_to_poll;
+	u32 poll_to_intr;
+	struct list_head repl_pool;
+	u32 repl_pool_len;
+	spinlock_t repl_lock;
 };
 
 /**
@@ -487,6 +534,7 @@ struct ipa_rx_pkt_wrapper {
  * @size_base_tables: base table size
  * @size_expansion_tables: expansion table size
  * @public_ip_addr: ip address of nat table
+ * @table_index: index of the nat table
  */
 struct ipa_nat_mem {
 	struct class *class;
@@ -508,6 +556,7 @@ struct ipa_nat_mem {
 	u32 size_base_tables;
 	u32 size_expansion_tables;
 	u32 public_ip_addr;
+	u8 table_index;
 };
 
 /**
@@ -556,6 +605,8 @@ struct ipa_stats {
 	u32 a2_power_off_reqs_out;
 	u32 a2_power_modem_acks;
 	u32 a2_power_apps_acks;
+	u32 nat_offload_flows;
+	u32 nat_offload_collisions;
 };
 
 /**
@@ -581,6 +632,7 @@ struct ipa_stats {
  * @rt_tbl_cache: routing table cache
  * @tx_pkt_wrapper_cache: Tx packets cache
  * @rx_pkt_wrapper_cache: Rx packets cache
+ * @rx_recycle: Rx skbs recycling pool
  * @tree_node_cache: tree nodes cache
  * @rt_idx_bitmap: routing table index bitmap
  * @lock: this does NOT protect the linked lists within ipa_sys_context
@@ -638,6 +690,7 @@ struct ipa_context {
 	struct kmem_cache *rt_tbl_cache;
 	struct kmem_cache *tx_pkt_wrapper_cache;
 	struct kmem_cache *rx_pkt_wrapper_cache;
+	struct skb_recycle_pool *rx_recycle;
 	struct kmem_cache *tree_node_cache;
 	unsigned long rt_idx_bitmap[IPA_IP_MAX];
 	struct mutex lock;
@@ -810,6 +863,22 @@ int ipa_cfg_route(struct ipa_route *route);
 int ipa_send_cmd(u16 num_desc, struct ipa_desc *descr);
 void ipa_replenish_rx_cache(void);
 void ipa_cleanup_rx(void);
+void ipa_init_sys_polling(struct ipa_sys_context *sys, bool rx);
+u32 ipa_poll_inactivity(struct ipa_sys_context *sys);
+
+#ifdef CONFIG_IPA_NAT_OFFLOAD
+int ipa_nat_offload_init(void);
+void ipa_nat_offload_flush(void);
+#else
+static inline int ipa_nat_offload_init(void)
+{
+	return 0;
+}
+
+static inline void ipa_nat_offload_flush(void)
+{
+}
+#endif
 int ipa_cfg_filter(u32 disable);
 void ipa_wq_write_done(struct work_struct *work);
 int ipa_handle_rx_core(struct ipa_sys_context *sys, bool process_all,
@@ -302,6 +302,7 @@ int ipa_nat_init_cmd(struct ipa_ioc_v4_nat_init *init)
 
 	ipa_ctx->nat_mem.public_ip_addr = init->ip_addr;
 	IPADBG("Table ip address:0x%x", ipa_ctx->nat_mem.public_ip_addr);
+	ipa_ctx->nat_mem.table_index = init->tbl_index;
 
 	ipa_ctx->nat_mem.ipv4_rules_addr =
 	 (char *)ipa_ctx->nat_mem.nat_base_address + init->ipv4_rules_offset;
@@ -473,6 +474,8 @@ int ipa_nat_del_cmd(struct ipa_ioc_v4_nat_del *del)
 	cmd->size_expansion_tables = 0;
 	cmd->public_ip_addr = del->public_ip_addr;
 
+	ipa_nat_offload_flush();
+
 	desc.opcode = IPA_IP_V4_NAT_INIT;
 	desc.type = IPA_IMM_CMD_DESC;
 	desc.callback = NULL;
@@ -0,0 +1,458 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/hash.h>
+#include <linux/in.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <net/net_namespace.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_ecache.h>
+#include "ipa_i.h"
+
+/*
+ * In-kernel offload of the tethered IPv4 NAT flows.
+ *
+ * Once a source NATed TCP or UDP connection towards the public address of
+ * the IPA NAT table is assured by conntrack, its translation is written to
+ * the system memory NAT table so the following packets are translated and
+ * routed by the IPA without crossing the APPS CPU. The entry is removed when
+ * conntrack destroys the connection. As conntrack no longer sees the
+ * offloaded packets, the HW time stamp of each entry is sampled periodically
+ * and the conntrack timeout is pushed out while the flow is active.
+ *
+ * Only free base table entries are used: a flow whose base or index hash
+ * collides keeps going through the CPU. The tables are owned by the kernel
+ * in this mode, so userspace must not add NAT rules while it is enabled.
+ */
+
+#define IPA_NAT_RULE_WORDS	8
+#define IPA_NAT_RULE_ENABLE	0x8000
+#define IPA_NAT_BASE_TBL	0
+#define IPA_NAT_INDX_TBL	2
+#define IPA_NAT_OFFLOAD_HASH_BITS	8
+#define IPA_NAT_OFFLOAD_SYNC_MS	5000
+
+static bool nat_offload;
+module_param(nat_offload, bool, 0444);
+MODULE_PARM_DESC(nat_offload,
+		"offload tethered conntrack flows to the IPA NAT table");
+
+/**
+ * struct ipa_nat_flow - an IPv4 connection tracked by the NAT offload
+ * @hnode: link in the flow hash, keyed by conntrack entry
+ * @todo: link in the list of flows the work has to process
+ * @ct: the conntrack entry, referenced while the flow exists
+ * @rule_idx: index of the rule in the base table
+ * @indx_idx: index of the entry in the index table
+ * @time_stamp: HW time stamp of the rule at the last sync
+ * @programmed: the rule is in the NAT table
+ * @dead: conntrack destroyed the connection
+ */
+struct ipa_nat_flow {
+	struct hlist_node hnode;
+	struct list_head todo;
+	struct nf_conn *ct;
+	u16 rule_idx;
+	u16 indx_idx;
+	u32 time_stamp;
+	bool programmed;
+	bool dead;
+};
+
+static struct {
+	spinlock_t lock;
+	struct hlist_head hash[1 << IPA_NAT_OFFLOAD_HASH_BITS];
+	struct list_head todo;
+	struct work_struct work;
+	struct delayed_work sync_work;
+} ipa_nat_offload;
+
+static struct hlist_head *ipa_nat_flow_bucket(struct nf_conn *ct)
+{
+	return &ipa_nat_offload.hash[hash_ptr(ct, IPA_NAT_OFFLOAD_HASH_BITS)];
+}
+
+static struct ipa_nat_flow *ipa_nat_flow_find(struct nf_conn *ct)
+{
+	struct ipa_nat_flow *flow;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(flow, node, ipa_nat_flow_bucket(ct), hnode)
+		if (flow->ct == ct)
+			return flow;
+
+	return NULL;
+}
+
+static u16 ipa_nat_dst_hash(u32 trgt_ip, u16 trgt_port, u16 public_port,
+		u8 proto, u16 mask)
+{
+	u16 hash = (u16)trgt_ip ^ (u16)(trgt_ip >> 16) ^ trgt_port ^
+		public_port ^ proto;
+
+	return hash & mask;
+}
+
+static u16 ipa_nat_src_hash(u32 priv_ip, u16 priv_port, u32 trgt_ip,
+		u16 trgt_port, u8 proto, u16 mask)
+{
+	u16 hash = (u16)priv_ip ^ (u16)(priv_ip >> 16) ^ priv_port ^
+		(u16)trgt_ip ^ (u16)(trgt_ip >> 16) ^ trgt_port ^ proto;
+
+	return hash & mask;
+}
+
+/* one's complement delta to apply to a checksum covering @from turned @to */
+static u16 ipa_nat_csum_delta(u32 from, u32 to, u16 from_port, u16 to_port)
+{
+	u32 sum;
+
+	sum = (to >> 16) + (to & 0xFFFF) + (~from >> 16) + (~from & 0xFFFF) +
+		to_port + (u16)~from_port;
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+
+	return sum;
+}
+
+static u32 *ipa_nat_rule(u16 idx)
+{
+	return (u32 *)ipa_ctx->nat_mem.ipv4_rules_addr +
+		idx * IPA_NAT_RULE_WORDS;
+}
+
+static u32 *ipa_nat_indx(u16 idx)
+{
+	return (u32 *)ipa_ctx->nat_mem.index_table_addr + idx;
+}
+
+static int ipa_nat_offload_dma(u16 rule_flags, u16 rule_idx, u16 indx_idx,
+		u16 indx_data)
+{
+	struct {
+		struct ipa_ioc_nat_dma_cmd cmd;
+		struct ipa_ioc_nat_dma_one dma[2];
+	} req;
+
+	/* index entry first so enabled rules are always reachable */
+	req.cmd.entries = 2;
+	req.dma[0].table_index = ipa_ctx->nat_mem.table_index;
+	req.dma[0].base_addr = IPA_NAT_INDX_TBL;
+	req.dma[0].offset = indx_idx * sizeof(u32);
+	req.dma[0].data = indx_data;
+	req.dma[1].table_index = ipa_ctx->nat_mem.table_index;
+	req.dma[1].base_addr = IPA_NAT_BASE_TBL;
+	/* upper half of the fifth word holds the rule flags */
+	req.dma[1].offset = rule_idx * IPA_NAT_RULE_WORDS * sizeof(u32) +
+		4 * sizeof(u32) + sizeof(u16);
+	req.dma[1].data = rule_flags;
+
+	return ipa_nat_dma_cmd(&req.cmd);
+}
+
+/*
+ * Called with the NAT memory lock held. Returns 0 when the flow is in the
+ * table, a negative value when it has to stay on the CPU path.
+ */
+static int ipa_nat_offload_insert(struct ipa_nat_flow *flow)
+{
+	struct ipa_nat_mem *nat = &ipa_ctx->nat_mem;
+	struct nf_conntrack_tuple *orig;
+	struct nf_conntrack_tuple *reply;
+	u32 priv_ip, trgt_ip, pub_ip;
+	u16 priv_port, trgt_port, pub_port;
+	u8 proto;
+	u32 *rule, *indx;
+	int i;
+
+	if (!nat->is_sys_mem || !nat->ipv4_rules_addr ||
+	    !nat->index_table_addr || !nat->size_base_tables ||
+	    !nat->public_ip_addr)
+		return -ENODEV;
+
+	orig = &flow->ct->tuplehash[IP_CT_DIR_ORIGINAL].tuple;
+	reply = &flow->ct->tuplehash[IP_CT_DIR_REPLY].tuple;
+
+	pub_ip = ntohl(reply->dst.u3.ip);
+	if (pub_ip != nat->public_ip_addr)
+		return -EINVAL;
+
+	priv_ip = ntohl(orig->src.u3.ip);
+	priv_port = ntohs(orig->src.u.all);
+	trgt_ip = ntohl(orig->dst.u3.ip);
+	trgt_port = ntohs(orig->dst.u.all);
+	pub_port = ntohs(reply->dst.u.all);
+	proto = orig->dst.protonum;
+
+	flow->rule_idx = ipa_nat_dst_hash(trgt_ip, trgt_port, pub_port,
+			proto, nat->size_base_tables);
+	flow->indx_idx = ipa_nat_src_hash(priv_ip, priv_port, trgt_ip,
+			trgt_port, proto, nat->size_base_tables);
+
+	/* index entries use 0 as the empty rule reference */
+	if (!flow->rule_idx)
+		goto collision;
+
+	rule = ipa_nat_rule(flow->rule_idx);
+	for (i = 0; i < IPA_NAT_RULE_WORDS; i++)
+		if (rule[i])
+			goto collision;
+
+	indx = ipa_nat_indx(flow->indx_idx);
+	if (*indx)
+		goto collision;
+
+	rule[0] = priv_ip;
+	rule[1] = trgt_ip;
+	rule[2] = pub_port << 16;
+	rule[3] = (trgt_port << 16) | priv_port;
+	rule[4] = ipa_nat_csum_delta(priv_ip, pub_ip, 0, 0);
+	rule[5] = proto << 24;
+	rule[6] = flow->indx_idx << 16;
+	rule[7] = ipa_nat_csum_delta(priv_ip, pub_ip, priv_port,
+			pub_port) << 16;
+	wmb();
+
+	if (ipa_nat_offload_dma(IPA_NAT_RULE_ENABLE, flow->rule_idx,
+				flow->indx_idx, flow->rule_idx)) {
+		IPAERR("fail to enable nat rule %u\n", flow->rule_idx);
+		memset(rule, 0, IPA_NAT_RULE_WORDS * sizeof(u32));
+		*indx = 0;
+		return -EIO;
+	}
+
+	flow->time_stamp = rule[5] & 0xFFFFFF;
+	IPA_STATS_INC_CNT(ipa_ctx->stats.nat_offload_flows);
+	IPADBG("offloaded %pI4h:%u->%pI4h:%u proto %u rule %u indx %u\n",
+	       &priv_ip, priv_port, &trgt_ip, trgt_port, proto,
+	       flow->rule_idx, flow->indx_idx);
+	return 0;
+
+collision:
+	IPA_STATS_INC_CNT(ipa_ctx->stats.nat_offload_collisions);
+	return -EBUSY;
+}
+
+/* Called with the NAT memory lock held */
+static void ipa_nat_offload_remove(struct ipa_nat_flow *flow)
+{
+	if (ipa_nat_offload_dma(0, flow->rule_idx, flow->indx_idx, 0))
+		IPAERR("fail to disable nat rule %u\n", flow->rule_idx);
+
+	memset(ipa_nat_rule(flow->rule_idx), 0,
+	       IPA_NAT_RULE_WORDS * sizeof(u32));
+	*ipa_nat_indx(flow->indx_idx) = 0;
+	IPADBG("removed nat rule %u indx %u\n", flow->rule_idx,
+	       flow->indx_idx);
+}
+
+static void ipa_nat_flow_free(struct ipa_nat_flow *flow)
+{
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+static void ipa_nat_offload_work_func(struct work_struct *work)
+{
+	struct ipa_nat_flow *flow;
+	bool dead;
+	int ret;
+
+	mutex_lock(&ipa_ctx->nat_mem.lock);
+	for (;;) {
+		spin_lock_bh(&ipa_nat_offload.lock);
+		flow = NULL;
+		if (!list_empty(&ipa_nat_offload.todo)) {
+			flow = list_first_entry(&ipa_nat_offload.todo,
+					struct ipa_nat_flow, todo);
+			list_del_init(&flow->todo);
+			dead = flow->dead;
+			if (dead)
+				hlist_del(&flow->hnode);
+		}
+		spin_unlock_bh(&ipa_nat_offload.lock);
+
+		if (!flow)
+			break;
+
+		if (dead) {
+			if (flow->programmed)
+				ipa_nat_offload_remove(flow);
+			ipa_nat_flow_free(flow);
+			continue;
+		}
+
+		ret = ipa_nat_offload_insert(flow);
+
+		spin_lock_bh(&ipa_nat_offload.lock);
+		if (!ret) {
+			flow->programmed = true;
+		} else if (!flow->dead) {
+			/* keep it on the CPU path, conntrack won't retry */
+			hlist_del(&flow->hnode);
+			spin_unlock_bh(&ipa_nat_offload.lock);
+			ipa_nat_flow_free(flow);
+			continue;
+		}
+		spin_unlock_bh(&ipa_nat_offload.lock);
+	}
+	mutex_unlock(&ipa_ctx->nat_mem.lock);
+}
+
+/*
+ * Push out the conntrack timeout of the flows the IPA translated since the
+ * last sync, by the time elapsed since then.
+ */
+static void ipa_nat_offload_sync_work_func(struct work_struct *work)
+{
+	struct ipa_nat_flow *flow;
+	struct hlist_node *node;
+	u32 time_stamp;
+	int i;
+
+	mutex_lock(&ipa_ctx->nat_mem.lock);
+	spin_lock_bh(&ipa_nat_offload.lock);
+	for (i = 0; i < ARRAY_SIZE(ipa_nat_offload.hash); i++) {
+		hlist_for_each_entry(flow, node, &ipa_nat_offload.hash[i],
+				hnode) {
+			if (!flow->programmed || flow->dead)
+				continue;
+
+			time_stamp = ipa_nat_rule(flow->rule_idx)[5] & 0xFFFFFF;
+			if (time_stamp == flow->time_stamp)
+				continue;
+
+			flow->time_stamp = time_stamp;
+			mod_timer_pending(&flow->ct->timeout,
+				flow->ct->timeout.expires +
+				msecs_to_jiffies(IPA_NAT_OFFLOAD_SYNC_MS));
+		}
+	}
+	spin_unlock_bh(&ipa_nat_offload.lock);
+	mutex_unlock(&ipa_ctx->nat_mem.lock);
+
+	queue_delayed_work(system_power_efficient_wq,
+		&ipa_nat_offload.sync_work,
+			msecs_to_jiffies(IPA_NAT_OFFLOAD_SYNC_MS));
+}
+
+static int ipa_nat_offload_event(unsigned int events, struct nf_ct_event *item)
+{
+	struct nf_conn *ct = item->ct;
+	struct ipa_nat_flow *flow;
+	u8 proto;
+
+	if (!(events & ((1 << IPCT_ASSURED) | (1 << IPCT_DESTROY))))
+		return 0;
+
+	if (nf_ct_l3num(ct) != AF_INET || !(ct->status & IPS_SRC_NAT))
+		return 0;
+
+	proto = nf_ct_protonum(ct);
+	if (proto != IPPROTO_TCP && proto != IPPROTO_UDP)
+		return 0;
+
+	spin_lock_bh(&ipa_nat_offload.lock);
+	flow = ipa_nat_flow_find(ct);
+	if (events & (1 << IPCT_DESTROY)) {
+		if (flow && !flow->dead) {
+			flow->dead = true;
+			if (list_empty(&flow->todo))
+				list_add_tail(&flow->todo,
+					      &ipa_nat_offload.todo);
+			schedule_work(&ipa_nat_offload.work);
+		}
+	} else if (!flow) {
+		flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+		if (flow) {
+			nf_conntrack_get(&ct->ct_general);
+			flow->ct = ct;
+			hlist_add_head(&flow->hnode, ipa_nat_flow_bucket(ct));
+			list_add_tail(&flow->todo, &ipa_nat_offload.todo);
+			schedule_work(&ipa_nat_offload.work);
+		}
+	}
+	spin_unlock_bh(&ipa_nat_offload.lock);
+
+	return 0;
+}
+
+static struct nf_ct_event_notifier ipa_nat_offload_notifier = {
+	.fcn = ipa_nat_offload_event,
+};
+
+/**
+ * ipa_nat_offload_flush() - Forget the offloaded rules of a NAT table
+ *
+ * Called before the NAT table is deleted. The flows stay tracked until
+ * conntrack destroys them but their rules are no longer touched.
+ */
+void ipa_nat_offload_flush(void)
+{
+	struct ipa_nat_flow *flow;
+	struct hlist_node *node;
+	int i;
+
+	if (!nat_offload)
+		return;
+
+	mutex_lock(&ipa_ctx->nat_mem.lock);
+	spin_lock_bh(&ipa_nat_offload.lock);
+	for (i = 0; i < ARRAY_SIZE(ipa_nat_offload.hash); i++)
+		hlist_for_each_entry(flow, node, &ipa_nat_offload.hash[i],
+				hnode)
+			flow->programmed = false;
+	spin_unlock_bh(&ipa_nat_offload.lock);
+	mutex_unlock(&ipa_ctx->nat_mem.lock);
+}
+
+/**
+ * ipa_nat_offload_init() - Start offloading the tethered conntrack flows
+ *
+ * Does nothing unless the nat_offload module parameter is set.
+ *
+ * Returns:	0 on success, negative on failure
+ */
+int ipa_nat_offload_init(void)
+{
+	int result;
+
+	if (!nat_offload)
+		return 0;
+
+	spin_lock_init(&ipa_nat_offload.lock);
+	INIT_LIST_HEAD(&ipa_nat_offload.todo);
+	INIT_WORK(&ipa_nat_offload.work, ipa_nat_offload_work_func);
+	INIT_DELAYED_WORK(&ipa_nat_offload.sync_work,
+			ipa_nat_offload_sync_work_func);
+
+	result = nf_conntrack_register_notifier(&init_net,
+			&ipa_nat_offload_notifier);
+	if (result) {
+		IPAERR("fail to register conntrack notifier %d\n", result);
+		nat_offload = false;
+		return result;
+	}
+
+	queue_delayed_work(system_power_efficient_wq,
+		&ipa_nat_offload.sync_work,
+			msecs_to_jiffies(IPA_NAT_OFFLOAD_SYNC_MS));
+	IPADBG("nat offload enabled\n");
+
+	return 0;
+}
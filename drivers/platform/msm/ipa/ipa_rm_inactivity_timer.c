@@ -12,6 +12,7 @@
 
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/timer.h>
@@ -20,6 +21,15 @@
 #include <mach/ipa.h>
 #include "ipa_i.h"
 
+/*
+ * The timeout follows the idle gaps seen between a release and the next
+ * request, within 1/4 and 4 times the timeout given at init time.
+ */
+#define IPA_RM_IT_RANGE_SHIFT 2
+
+static bool adaptive_timeout = true;
+module_param(adaptive_timeout, bool, 0644);
+
 /**
  * struct ipa_rm_it_private - IPA RM Inactivity Timer private
  *	data
@@ -31,6 +41,11 @@
  * @release_in_prog: boolean flag indicates if release resource
  *			is scheduled for happen in the future.
  * @jiffies: number of jiffies for timeout
+ * @min_jiffies: lowest timeout the adaptive timeout may use
+ * @max_jiffies: highest timeout the adaptive timeout may use
+ * @avg_gap: running average of the idle gaps worth bridging, in jiffies
+ * @release_time: when the last release was asked for
+ * @idle: a release was asked for and no request followed yet
  *
  * WWAN private - holds all relevant info about WWAN driver
  */
@@ -41,6 +56,11 @@ struct ipa_rm_it_private {
 	struct delayed_work work;
 	bool release_in_prog;
 	unsigned long jiffies;
+	unsigned long min_jiffies;
+	unsigned long max_jiffies;
+	unsigned long avg_gap;
+	unsigned long release_time;
+	bool idle;
 };
 
 static struct ipa_rm_it_private ipa_rm_it_handles[IPA_RM_RESOURCE_MAX];
@@ -84,6 +104,31 @@ static void ipa_rm_inactivity_timer_func(struct work_struct *work)
 		&ipa_rm_it_handles[me->resource_name].lock, flags);
 }
 
+/**
+ * ipa_rm_inactivity_timer_adapt() - adjust the timeout to an idle gap
+ * @me: the inactivity timer, with its lock held
+ * @gap: jiffies between the release and the request that followed it
+ *
+ * Gaps up to the highest timeout are the pauses within bursty traffic.
+ * Keeping the resource up across them avoids releasing and requesting
+ * it again, so the timeout tracks twice their average. A longer gap is
+ * a real idle period, for which any timeout only wastes power, so it
+ * decays the average and the timeout shrinks toward the lowest.
+ */
+static void ipa_rm_inactivity_timer_adapt(struct ipa_rm_it_private *me,
+					  unsigned long gap)
+{
+	if (gap > me->max_jiffies)
+		gap = 0;
+
+	me->avg_gap = (me->avg_gap * 3 + gap) / 4;
+	me->jiffies = clamp(me->avg_gap * 2, me->min_jiffies,
+			    me->max_jiffies);
+
+	IPADBG("%s: resource %d gap %lu timeout %lu\n", __func__,
+	    me->resource_name, gap, me->jiffies);
+}
+
 /**
 * ipa_rm_inactivity_timer_init() - Init function for IPA RM
 * inactivity timer. This function shall be called prior calling
@@ -117,6 +162,14 @@ int ipa_rm_inactivity_timer_init(enum ipa_rm_resource_name resource_name,
 	spin_lock_init(&ipa_rm_it_handles[resource_name].lock);
 	ipa_rm_it_handles[resource_name].resource_name = resource_name;
 	ipa_rm_it_handles[resource_name].jiffies = msecs_to_jiffies(msecs);
+	ipa_rm_it_handles[resource_name].min_jiffies = max_t(unsigned long,
+		ipa_rm_it_handles[resource_name].jiffies >>
+		IPA_RM_IT_RANGE_SHIFT, 1);
+	ipa_rm_it_handles[resource_name].max_jiffies =
+		ipa_rm_it_handles[resource_name].jiffies << IPA_RM_IT_RANGE_SHIFT;
+	ipa_rm_it_handles[resource_name].avg_gap =
+		ipa_rm_it_handles[resource_name].jiffies / 2;
+	ipa_rm_it_handles[resource_name].idle = false;
 	ipa_rm_it_handles[resource_name].release_in_prog = false;
 
 	INIT_DELAYED_WORK(&ipa_rm_it_handles[resource_name].work,
@@ -191,6 +244,10 @@ int ipa_rm_inactivity_timer_request_resource(
 	spin_lock_irqsave(&ipa_rm_it_handles[resource_name].lock, flags);
 	cancel_delayed_work(&ipa_rm_it_handles[resource_name].work);
 	ipa_rm_it_handles[resource_name].release_in_prog = false;
+	if (ipa_rm_it_handles[resource_name].idle && adaptive_timeout)
+		ipa_rm_inactivity_timer_adapt(&ipa_rm_it_handles[resource_name],
+			jiffies - ipa_rm_it_handles[resource_name].release_time);
+	ipa_rm_it_handles[resource_name].idle = false;
 	spin_unlock_irqrestore(&ipa_rm_it_handles[resource_name].lock, flags);
 	ret = ipa_rm_request_resource(resource_name);
 	IPADBG("%s: resource %d: returning %d\n", __func__, resource_name, ret);
@@ -200,7 +257,9 @@ int ipa_rm_inactivity_timer_request_resource(
 /**
 * ipa_rm_inactivity_timer_release_resource() - Sets the
 * inactivity timer to the timeout set by
-* ipa_rm_inactivity_timer_init(). When the timeout expires, IPA
+* ipa_rm_inactivity_timer_init(), as adapted to the idle gaps seen
+* since unless the adaptive_timeout parameter is cleared. When the
+* timeout expires, IPA
 * RM inactivity timer will call to ipa_rm_release_resource().
 * If a call to ipa_rm_inactivity_timer_request_resource() was
 * made BEFORE the timout has expired, rge timer will be
@@ -216,6 +275,7 @@ int ipa_rm_inactivity_timer_release_resource(
 				enum ipa_rm_resource_name resource_name)
 {
 	unsigned long flags;
+	unsigned long timeout;
 	IPADBG("%s: resource %d\n", __func__, resource_name);
 
 	if (resource_name < 0 ||
@@ -238,11 +298,14 @@ int ipa_rm_inactivity_timer_release_resource(
 		return 0;
 	}
 	ipa_rm_it_handles[resource_name].release_in_prog = true;
+	ipa_rm_it_handles[resource_name].release_time = jiffies;
+	ipa_rm_it_handles[resource_name].idle = true;
+	timeout = ipa_rm_it_handles[resource_name].jiffies;
 	spin_unlock_irqrestore(&ipa_rm_it_handles[resource_name].lock, flags);
 
 	IPADBG("%s: setting delayed work\n", __func__);
-	schedule_delayed_work(&ipa_rm_it_handles[resource_name].work,
-			      ipa_rm_it_handles[resource_name].jiffies);
+	queue_delayed_work(system_power_efficient_wq,
+		&ipa_rm_it_handles[resource_name].work, timeout);
 
 	return 0;
 }
@@ -2244,7 +2244,8 @@ int teth_bridge_driver_init(void)
 		goto fail_cdev_add;
 	}
 
-	teth_ctx->teth_wq = create_workqueue(TETH_WORKQUEUE_NAME);
+	teth_ctx->teth_wq = alloc_workqueue(TETH_WORKQUEUE_NAME,
+		WQ_MEM_RECLAIM | WQ_POWER_EFFICIENT, 1);
 	if (!teth_ctx->teth_wq) {
 		TETH_ERR("workqueue creation failed\n");
 		goto fail_cdev_add;
@@ -1630,6 +1630,55 @@ int sps_transfer(struct sps_pipe *h, struct sps_transfer *transfer)
 }
 EXPORT_SYMBOL(sps_transfer);
 
+/**
+ * Perform a batch of DMA transfers on an SPS connection end point
+ *
+ */
+int sps_transfer_batch(struct sps_pipe *h, struct sps_iovec *iovecs,
+		       void **users, u32 count)
+{
+	struct sps_pipe *pipe = h;
+	struct sps_bam *bam;
+	int result;
+	u32 i;
+
+	SPS_DBG("sps:%s.", __func__);
+
+	if (h == NULL) {
+		SPS_ERR("sps:%s:pipe is NULL.\n", __func__);
+		return SPS_ERROR;
+	} else if (iovecs == NULL) {
+		SPS_ERR("sps:%s:iovec list is NULL.\n", __func__);
+		return SPS_ERROR;
+	} else if (count == 0) {
+		SPS_ERR("sps:%s:iovec list is empty.\n", __func__);
+		return SPS_ERROR;
+	}
+
+	/* Verify content of IOVECs */
+	for (i = 0; i < count; i++) {
+		if (iovecs[i].size > SPS_IOVEC_MAX_SIZE) {
+			SPS_ERR("sps:%s:iovec size is invalid.\n", __func__);
+			return SPS_ERROR;
+		}
+
+		if (sps_check_iovec_flags(iovecs[i].flags))
+			return SPS_ERROR;
+	}
+
+	bam = sps_bam_lock(pipe);
+	if (bam == NULL)
+		return SPS_ERROR;
+
+	result = sps_bam_pipe_transfer_batch(bam, pipe->pipe_index, iovecs,
+					     users, count);
+
+	sps_bam_unlock(bam);
+
+	return result;
+}
+EXPORT_SYMBOL(sps_transfer_batch);
+
 /**
  * Perform a single DMA transfer on an SPS connection end point
  *
@@ -2279,6 +2328,40 @@ int sps_get_iovec(struct sps_pipe *h, struct sps_iovec *iovec)
 }
 EXPORT_SYMBOL(sps_get_iovec);
 
+/**
+ * Read a batch of event queue entries
+ *
+ */
+int sps_get_iovecs(struct sps_pipe *h, struct sps_iovec *iovecs, u32 max,
+		   u32 *count)
+{
+	struct sps_pipe *pipe = h;
+	struct sps_bam *bam;
+	int result;
+
+	SPS_DBG("sps:%s.", __func__);
+
+	if (h == NULL) {
+		SPS_ERR("sps:%s:pipe is NULL.\n", __func__);
+		return SPS_ERROR;
+	} else if (iovecs == NULL || count == NULL) {
+		SPS_ERR("sps:%s:iovec or count pointer is NULL.\n", __func__);
+		return SPS_ERROR;
+	}
+
+	bam = sps_bam_lock(pipe);
+	if (bam == NULL)
+		return SPS_ERROR;
+
+	/* Get the iovecs from the BAM pipe descriptor FIFO */
+	result = sps_bam_pipe_get_iovecs(bam, pipe->pipe_index, iovecs, max,
+					 count);
+	sps_bam_unlock(bam);
+
+	return result;
+}
+EXPORT_SYMBOL(sps_get_iovecs);
+
 /**
  * Perform timer control
  *
@@ -1444,21 +1444,16 @@ int sps_bam_pipe_transfer_one(struct sps_bam *dev,
 }
 
 /**
- * Submit a transfer to a BAM pipe
+ * Check that a BAM pipe has room for a number of descriptors
  *
  */
-int sps_bam_pipe_transfer(struct sps_bam *dev,
-			 u32 pipe_index, struct sps_transfer *transfer)
+static int sps_bam_pipe_check_room(struct sps_bam *dev, u32 pipe_index,
+				   u32 needed)
 {
-	struct sps_iovec *iovec;
-	u32 count;
-	u32 flags;
-	void *user;
-	int n;
-	int result;
 	struct sps_pipe *pipe = dev->pipes[pipe_index];
+	u32 count;
 
-	if (transfer->iovec_count == 0) {
+	if (needed == 0) {
 		SPS_ERR("sps:iovec count zero: BAM %pa pipe %d\n",
 			BAM_ID(dev), pipe_index);
 		return SPS_ERROR;
@@ -1471,12 +1466,31 @@ int sps_bam_pipe_transfer(struct sps_bam *dev,
 	} else
 		sps_bam_get_free_count(dev, pipe_index, &count);
 
-	if (count < transfer->iovec_count) {
+	if (count < needed) {
 		SPS_ERR("sps:Insufficient free desc: BAM %pa pipe %d: %d\n",
 			BAM_ID(dev), pipe_index, count);
 		return SPS_ERROR;
 	}
 
+	return 0;
+}
+
+/**
+ * Submit a transfer to a BAM pipe
+ *
+ */
+int sps_bam_pipe_transfer(struct sps_bam *dev,
+			 u32 pipe_index, struct sps_transfer *transfer)
+{
+	struct sps_iovec *iovec;
+	u32 flags;
+	void *user;
+	int n;
+	int result;
+
+	if (sps_bam_pipe_check_room(dev, pipe_index, transfer->iovec_count))
+		return SPS_ERROR;
+
 	user = NULL;		/* NULL for all except last descriptor */
 	for (n = (int)transfer->iovec_count - 1, iovec = transfer->iovec;
 	    n >= 0; n--, iovec++) {
@@ -1499,6 +1513,40 @@ int sps_bam_pipe_transfer(struct sps_bam *dev,
 	return 0;
 }
 
+/**
+ * Submit a batch of transfers to a BAM pipe
+ *
+ */
+int sps_bam_pipe_transfer_batch(struct sps_bam *dev, u32 pipe_index,
+				struct sps_iovec *iovecs, void **users,
+				u32 count)
+{
+	u32 n, flags;
+	int result;
+
+	if (sps_bam_pipe_check_room(dev, pipe_index, count))
+		return SPS_ERROR;
+
+	/* Only the last descriptor notifies the pipe */
+	for (n = 0; n < count; n++) {
+		flags = iovecs[n].flags;
+		if (n < count - 1)
+			flags |= SPS_IOVEC_FLAG_NO_SUBMIT;
+		else
+			flags &= ~SPS_IOVEC_FLAG_NO_SUBMIT;
+
+		result = sps_bam_pipe_transfer_one(dev, pipe_index,
+						   iovecs[n].addr,
+						   iovecs[n].size,
+						   users ? users[n] : NULL,
+						   flags);
+		if (result)
+			return SPS_ERROR;
+	}
+
+	return 0;
+}
+
 /**
  * Allocate an event tracking struct
  *
@@ -1984,26 +2032,17 @@ int sps_bam_pipe_get_event(struct sps_bam *dev,
 }
 
 /**
- * Get processed I/O vector
+ * Fetch the next completed descriptor of a pipe, if any
+ *
+ * @return true if @iovec was filled in, false if there is none
  */
-int sps_bam_pipe_get_iovec(struct sps_bam *dev, u32 pipe_index,
+static bool pipe_pop_iovec(struct sps_bam *dev, u32 pipe_index,
 			   struct sps_iovec *iovec)
 {
 	struct sps_pipe *pipe = dev->pipes[pipe_index];
 	struct sps_iovec *desc;
 	u32 read_offset;
 
-	/* Is this a valid pipe configured for get_iovec use? */
-	if (!pipe->sys.ack_xfers ||
-	    (pipe->state & BAM_STATE_BAM2BAM) != 0 ||
-	    (pipe->state & BAM_STATE_REMOTE)) {
-		return SPS_ERROR;
-	}
-
-	/* If pipe is polled and queue is enabled, perform polling operation */
-	if ((pipe->polled || pipe->hybrid) && !pipe->sys.no_queue)
-		pipe_handler_eot(dev, pipe);
-
 	/* Is there a completed descriptor? */
 	if (pipe->sys.no_queue)
 		read_offset =
@@ -2011,11 +2050,8 @@ int sps_bam_pipe_get_iovec(struct sps_bam *dev, u32 pipe_index,
 	else
 		read_offset = pipe->sys.cache_offset;
 
-	if (read_offset == pipe->sys.acked_offset) {
-		/* No, so clear the iovec to indicate FIFO is empty */
-		memset(iovec, 0, sizeof(*iovec));
-		return 0;
-	}
+	if (read_offset == pipe->sys.acked_offset)
+		return false;
 
 	/* Fetch next descriptor */
 	desc = (struct sps_iovec *) (pipe->sys.desc_buf +
@@ -2030,6 +2066,63 @@ int sps_bam_pipe_get_iovec(struct sps_bam *dev, u32 pipe_index,
 	if (pipe->sys.acked_offset >= pipe->desc_size)
 		pipe->sys.acked_offset = 0;
 
+	return true;
+}
+
+/**
+ * Get processed I/O vector
+ */
+int sps_bam_pipe_get_iovec(struct sps_bam *dev, u32 pipe_index,
+			   struct sps_iovec *iovec)
+{
+	struct sps_pipe *pipe = dev->pipes[pipe_index];
+
+	/* Is this a valid pipe configured for get_iovec use? */
+	if (!pipe->sys.ack_xfers ||
+	    (pipe->state & BAM_STATE_BAM2BAM) != 0 ||
+	    (pipe->state & BAM_STATE_REMOTE)) {
+		return SPS_ERROR;
+	}
+
+	/* If pipe is polled and queue is enabled, perform polling operation */
+	if ((pipe->polled || pipe->hybrid) && !pipe->sys.no_queue)
+		pipe_handler_eot(dev, pipe);
+
+	/* No completed descriptor, so clear the iovec to indicate FIFO is empty */
+	if (!pipe_pop_iovec(dev, pipe_index, iovec))
+		memset(iovec, 0, sizeof(*iovec));
+
+	return 0;
+}
+
+/**
+ * Get processed I/O vectors
+ */
+int sps_bam_pipe_get_iovecs(struct sps_bam *dev, u32 pipe_index,
+			    struct sps_iovec *iovecs, u32 max, u32 *count)
+{
+	struct sps_pipe *pipe = dev->pipes[pipe_index];
+	u32 n;
+
+	*count = 0;
+
+	/* Is this a valid pipe configured for get_iovec use? */
+	if (!pipe->sys.ack_xfers ||
+	    (pipe->state & BAM_STATE_BAM2BAM) != 0 ||
+	    (pipe->state & BAM_STATE_REMOTE)) {
+		return SPS_ERROR;
+	}
+
+	/* Poll once for the whole batch */
+	if ((pipe->polled || pipe->hybrid) && !pipe->sys.no_queue)
+		pipe_handler_eot(dev, pipe);
+
+	for (n = 0; n < max; n++)
+		if (!pipe_pop_iovec(dev, pipe_index, &iovecs[n]))
+			break;
+
+	*count = n;
+
 	return 0;
 }
 
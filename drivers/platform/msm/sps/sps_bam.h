@@ -485,6 +485,50 @@ int sps_bam_pipe_get_event(struct sps_bam *dev, u32 pipe_index,
 int sps_bam_pipe_get_iovec(struct sps_bam *dev, u32 pipe_index,
 			   struct sps_iovec *iovec);
 
+/**
+ * Submit a batch of transfers to a BAM pipe
+ *
+ * This function queues a descriptor per I/O vector, each with its own user
+ * pointer, and notifies the pipe once.
+ *
+ * @dev - pointer to BAM device descriptor
+ *
+ * @pipe_index - pipe index
+ *
+ * @iovecs - array of I/O vectors
+ *
+ * @users - array of user pointers, or NULL
+ *
+ * @count - number of I/O vectors
+ *
+ * @return 0 on success, negative value on error
+ *
+ */
+int sps_bam_pipe_transfer_batch(struct sps_bam *dev, u32 pipe_index,
+				struct sps_iovec *iovecs, void **users,
+				u32 count);
+
+/**
+ * Get processed I/O vectors
+ *
+ * This function fetches up to @max processed I/O vectors, polling the
+ * pipe at most once.
+ *
+ * @dev - pointer to BAM device descriptor
+ *
+ * @pipe_index - pipe index
+ *
+ * @iovecs - array of I/O vector structs (output)
+ *
+ * @max - size of @iovecs
+ *
+ * @count - number of I/O vectors fetched (output)
+ *
+ * @return 0 on success, negative value on error
+ */
+int sps_bam_pipe_get_iovecs(struct sps_bam *dev, u32 pipe_index,
+			    struct sps_iovec *iovecs, u32 max, u32 *count);
+
 /**
  * Determine whether a BAM pipe descriptor FIFO is empty
  *
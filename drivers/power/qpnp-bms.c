@@ -86,6 +86,8 @@
 #define SOC_INVALID			0x7E
 
 #define IAVG_SAMPLES 16
+#define OCV_FOR_PC_CACHE_SZ 4
+#define PC_STEPS 101
 
 /* FCC learning constants */
 #define MAX_FCC_CYCLES				5
@@ -246,6 +248,19 @@ struct qpnp_bms_chip {
 	unsigned int			vadc_v1250;
 
 	int				system_load_count;
+	/* find_ocv_for_pc() results, see find_ocv_for_pc_cached() */
+	struct {
+		bool			valid;
+		int			batt_temp;
+		int			pc;
+		int			ocv_uv;
+	}				ocv_for_pc_cache[OCV_FOR_PC_CACHE_SZ];
+	int				ocv_for_pc_next;
+	/* per pc ocv and rbatt at uuc_lut_temp, see uuc_lut_lookup() */
+	int				uuc_lut_temp;
+	int				uuc_ocv_mv[PC_STEPS];
+	int				uuc_rbatt_mohm[PC_STEPS];
+	DECLARE_BITMAP(uuc_lut_valid, PC_STEPS);
 	int				prev_uuc_iavg_ma;
 	int				prev_pc_unusable;
 	int				ibat_at_cv_ua;
@@ -1076,27 +1091,77 @@ static int find_ocv_for_pc(struct qpnp_bms_chip *chip, int batt_temp, int pc)
 	return ocv_mv * 1000;
 }
 
+/*
+ * The reverse lookup above walks the pc/ocv table in 1-5mV steps and is
+ * mostly asked for the same few (temperature, pc) pairs: the soc wakeup
+ * threshold and the ocv faked after charging. Its result only depends on
+ * the battery profile, so keep the last few.
+ */
+static int find_ocv_for_pc_cached(struct qpnp_bms_chip *chip, int batt_temp,
+				  int pc)
+{
+	int i, ocv_uv;
+
+	for (i = 0; i < OCV_FOR_PC_CACHE_SZ; i++) {
+		if (chip->ocv_for_pc_cache[i].valid &&
+		    chip->ocv_for_pc_cache[i].batt_temp == batt_temp &&
+		    chip->ocv_for_pc_cache[i].pc == pc)
+			return chip->ocv_for_pc_cache[i].ocv_uv;
+	}
+
+	ocv_uv = find_ocv_for_pc(chip, batt_temp, pc);
+	i = chip->ocv_for_pc_next;
+	chip->ocv_for_pc_next = (i + 1) % OCV_FOR_PC_CACHE_SZ;
+	chip->ocv_for_pc_cache[i].valid = true;
+	chip->ocv_for_pc_cache[i].batt_temp = batt_temp;
+	chip->ocv_for_pc_cache[i].pc = pc;
+	chip->ocv_for_pc_cache[i].ocv_uv = ocv_uv;
+	return ocv_uv;
+}
+
+static void invalidate_lut_caches(struct qpnp_bms_chip *chip)
+{
+	int i;
+
+	for (i = 0; i < OCV_FOR_PC_CACHE_SZ; i++)
+		chip->ocv_for_pc_cache[i].valid = false;
+	bitmap_zero(chip->uuc_lut_valid, PC_STEPS);
+}
+
 #define OCV_RAW_UNINITIALIZED	0xFFFF
 #define MIN_OCV_UV		2000000
+#define CC_READ_LEN		5
+#define OCV_FOR_SOC_OFFSET	(BMS1_OCV_FOR_SOC_DATA0 - BMS1_CC_DATA0)
+#define CC_OCV_READ_LEN		(OCV_FOR_SOC_OFFSET + 2)
 static int read_soc_params_raw(struct qpnp_bms_chip *chip,
 				struct raw_soc_params *raw,
 				int batt_temp)
 {
-	int warm_reset, rc;
+	int warm_reset, rc, i;
+	u8 data[CC_OCV_READ_LEN];
+	uint64_t cc_raw = 0;
 
 	mutex_lock(&chip->bms_output_lock);
 
 	lock_output_data(chip);
 
-	rc = qpnp_read_wrapper(chip, (u8 *)&raw->last_good_ocv_raw,
-			chip->base + BMS1_OCV_FOR_SOC_DATA0, 2);
+	/*
+	 * The coulomb counter and the ocv for soc sit within one 8 byte
+	 * extended register read of each other, take both in one transfer.
+	 */
+	rc = qpnp_read_wrapper(chip, data, chip->base + BMS1_CC_DATA0,
+			CC_OCV_READ_LEN);
 	if (rc) {
-		pr_err("Error reading ocv: rc = %d\n", rc);
+		pr_err("Error reading cc and ocv: rc = %d\n", rc);
 		goto param_err;
 	}
+	for (i = CC_READ_LEN - 1; i >= 0; i--)
+		cc_raw = (cc_raw << 8) | data[i];
+	raw->cc = convert_s36_to_s64(cc_raw);
+	raw->last_good_ocv_raw = data[OCV_FOR_SOC_OFFSET] |
+		(data[OCV_FOR_SOC_OFFSET + 1] << 8);
 
-	rc = read_cc_raw(chip, &raw->cc, CC);
-	rc |= read_cc_raw(chip, &raw->shdw_cc, SHDW_CC);
+	rc = read_cc_raw(chip, &raw->shdw_cc, SHDW_CC);
 	if (rc) {
 		pr_err("Failed to read raw cc data, rc = %d\n", rc);
 		goto param_err;
@@ -1129,7 +1194,7 @@ static int read_soc_params_raw(struct qpnp_bms_chip *chip,
 		chip->done_charging = false;
 		/* if we just finished charging, reset CC and fake 100% */
 		chip->ocv_reading_at_100 = raw->last_good_ocv_raw;
-		chip->last_ocv_uv = find_ocv_for_pc(chip, batt_temp, 100);
+		chip->last_ocv_uv = find_ocv_for_pc_cached(chip, batt_temp, 100);
 		raw->last_good_ocv_uv = chip->last_ocv_uv;
 		raw->cc = 0;
 		raw->shdw_cc = 0;
@@ -1240,22 +1305,19 @@ static int calculate_cc(struct qpnp_bms_chip *chip, int64_t cc,
 					int cc_type, int clear_cc)
 {
 	struct qpnp_iadc_calib calibration;
-	struct qpnp_vadc_result result;
 	int64_t cc_voltage_uv, cc_pvh, cc_uah, *software_counter;
 	int rc;
 
 	software_counter = cc_type == SHDW_CC ?
 			&chip->software_shdw_cc_uah : &chip->software_cc_uah;
-	rc = qpnp_vadc_read(chip->vadc_dev, DIE_TEMP, &result);
-	if (rc) {
-		pr_err("could not read pmic die temperature: %d\n", rc);
-		return *software_counter;
-	}
 
+	/*
+	 * The die temperature compensation is applied by the iadc driver in
+	 * qpnp_iadc_comp_result(), from its own reading; converting one here
+	 * as well only cost an adc conversion per counter.
+	 */
 	qpnp_iadc_get_gain_and_offset(chip->iadc_dev, &calibration);
-	pr_debug("%scc = %lld, die_temp = %lld\n",
-			cc_type == SHDW_CC ? "shdw_" : "",
-			cc, result.physical);
+	pr_debug("%scc = %lld\n", cc_type == SHDW_CC ? "shdw_" : "", cc);
 	cc_voltage_uv = cc_reading_to_uv(cc);
 	cc_voltage_uv = cc_adjust_for_gain(cc_voltage_uv,
 					calibration.gain_raw
@@ -1307,6 +1369,29 @@ out:
 	chip->last_cc_uah = cc_uah;
 }
 
+/*
+ * The unusable charge search below needs the ocv and rbatt of the battery
+ * at each pc for the current temperature, two table interpolations per
+ * step on every soc calculation. They do not change until the battery
+ * temperature does, so remember the ones looked up at uuc_lut_temp.
+ */
+static void uuc_lut_lookup(struct qpnp_bms_chip *chip, int batt_temp, int pc,
+			   int *ocv_mv, int *rbatt_mohm)
+{
+	if (chip->uuc_lut_temp != batt_temp) {
+		bitmap_zero(chip->uuc_lut_valid, PC_STEPS);
+		chip->uuc_lut_temp = batt_temp;
+	}
+	if (!test_bit(pc, chip->uuc_lut_valid)) {
+		chip->uuc_ocv_mv[pc] = interpolate_ocv(chip->pc_temp_ocv_lut,
+				batt_temp, pc);
+		chip->uuc_rbatt_mohm[pc] = get_rbatt(chip, pc, batt_temp);
+		__set_bit(pc, chip->uuc_lut_valid);
+	}
+	*ocv_mv = chip->uuc_ocv_mv[pc];
+	*rbatt_mohm = chip->uuc_rbatt_mohm[pc];
+}
+
 static int calculate_termination_uuc(struct qpnp_bms_chip *chip,
 					struct soc_params *params,
 					int batt_temp, int uuc_iavg_ma,
@@ -1321,10 +1406,8 @@ static int calculate_termination_uuc(struct qpnp_bms_chip *chip,
 	int prev_rbatt_mohm = 0;
 	int uuc_rbatt_mohm;
 
-	for (i = 0; i <= 100; i++) {
-		ocv_mv = interpolate_ocv(chip->pc_temp_ocv_lut,
-				batt_temp, i);
-		rbatt_mohm = get_rbatt(chip, i, batt_temp);
+	for (i = 0; i < PC_STEPS; i++) {
+		uuc_lut_lookup(chip, batt_temp, i, &ocv_mv, &rbatt_mohm);
 		unusable_uv = (rbatt_mohm * uuc_iavg_ma)
 							+ (chip->v_cutoff_uv);
 		delta_uv = ocv_mv * 1000 - unusable_uv;
@@ -2031,7 +2114,7 @@ static int charging_adjustments(struct qpnp_bms_chip *chip,
 	if (chg_soc > chip->prev_chg_soc) {
 		chip->prev_chg_soc = chg_soc;
 
-		chip->charging_adjusted_ocv = find_ocv_for_pc(chip, batt_temp,
+		chip->charging_adjusted_ocv = find_ocv_for_pc_cached(chip, batt_temp,
 				find_pc_for_soc(chip, params, chg_soc));
 		pr_debug("CC CHG ADJ OCV = %d CHG SOC %d\n",
 				chip->charging_adjusted_ocv,
@@ -2326,7 +2409,7 @@ static void configure_soc_wakeup(struct qpnp_bms_chip *chip,
 	cc_raw_64 = convert_cc_uah_to_raw(chip, target_cc_uah);
 	cc_raw = convert_s64_to_s36(cc_raw_64);
 
-	target_ocv_uv = find_ocv_for_pc(chip, batt_temp,
+	target_ocv_uv = find_ocv_for_pc_cached(chip, batt_temp,
 				find_pc_for_soc(chip, params, target_soc));
 	ocv_raw = convert_vbatt_uv_to_raw(chip, target_ocv_uv);
 
@@ -2377,7 +2460,7 @@ static int calculate_raw_soc(struct qpnp_bms_chip *chip,
 		 * in a bad soc. Adjust ocv to get 0 soc
 		 */
 		pr_debug("soc is %d, adjusting pon ocv to make it 0\n", soc);
-		chip->last_ocv_uv = find_ocv_for_pc(chip, batt_temp,
+		chip->last_ocv_uv = find_ocv_for_pc_cached(chip, batt_temp,
 				find_pc_for_soc(chip, params, 0));
 		params->ocv_charge_uah = find_ocv_charge_for_soc(chip,
 				params, 0);
@@ -2449,7 +2532,7 @@ static int calculate_state_of_charge(struct qpnp_bms_chip *chip,
 		 */
 		pr_debug("soc = %d before forcing shutdown_soc = %d\n",
 							soc, shutdown_soc);
-		chip->last_ocv_uv = find_ocv_for_pc(chip, batt_temp,
+		chip->last_ocv_uv = find_ocv_for_pc_cached(chip, batt_temp,
 				find_pc_for_soc(chip, &params, shutdown_soc));
 		params.ocv_charge_uah = find_ocv_charge_for_soc(chip,
 				&params, shutdown_soc);
@@ -3761,6 +3844,7 @@ assign_data:
 		chip->v_cutoff_uv = batt_data->cutoff_uv;
 	if (batt_data->iterm_ua >= 0 && dt_data)
 		chip->chg_term_ua = batt_data->iterm_ua;
+	invalidate_lut_caches(chip);
 
 	if (chip->pc_temp_ocv_lut == NULL) {
 		pr_err("temp ocv lut table has not been loaded\n");
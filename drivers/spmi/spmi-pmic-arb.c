@@ -274,12 +274,57 @@ static int pmic_arb_cmd(struct spmi_controller *ctrl, u8 opc, u8 sid)
 	return rc;
 }
 
+/* Read transaction with a pmic-arb opcode, pmic_arb->lock must be held */
+static int __pmic_arb_read(struct spmi_pmic_arb_dev *pmic_arb,
+				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
+{
+	u32 cmd;
+	int rc;
+
+	cmd = (opc << 27) | ((sid & 0xf) << 20) | (addr << 4) | (bc & 0x7);
+
+	pmic_arb_save_stat_before_txn(pmic_arb);
+	pmic_arb_write(pmic_arb, PMIC_ARB_CMD(pmic_arb->channel), cmd);
+	rc = pmic_arb_wait_for_done(pmic_arb);
+	if (rc)
+		return rc;
+
+	/* Read from FIFO, note 'bc' is actually number of bytes minus 1 */
+	pa_read_data(pmic_arb, buf, PMIC_ARB_RDATA0(pmic_arb->channel)
+							, min_t(u8, bc, 3));
+
+	if (bc > 3)
+		pa_read_data(pmic_arb, buf + 4,
+				PMIC_ARB_RDATA1(pmic_arb->channel), bc - 4);
+	return 0;
+}
+
+/* Write transaction with a pmic-arb opcode, pmic_arb->lock must be held */
+static int __pmic_arb_write(struct spmi_pmic_arb_dev *pmic_arb,
+				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
+{
+	u32 cmd;
+
+	cmd = (opc << 27) | ((sid & 0xf) << 20) | (addr << 4) | (bc & 0x7);
+
+	/* Write data to FIFOs */
+	pmic_arb_save_stat_before_txn(pmic_arb);
+	pa_write_data(pmic_arb, buf, PMIC_ARB_WDATA0(pmic_arb->channel)
+							, min_t(u8, bc, 3));
+	if (bc > 3)
+		pa_write_data(pmic_arb, buf + 4,
+				PMIC_ARB_WDATA1(pmic_arb->channel), bc - 4);
+
+	/* Start the transaction */
+	pmic_arb_write(pmic_arb, PMIC_ARB_CMD(pmic_arb->channel), cmd);
+	return pmic_arb_wait_for_done(pmic_arb);
+}
+
 static int pmic_arb_read_cmd(struct spmi_controller *ctrl,
 				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
 {
 	struct spmi_pmic_arb_dev *pmic_arb = spmi_get_ctrldata(ctrl);
 	unsigned long flags;
-	u32 cmd;
 	int rc;
 
 	if (bc >= PMIC_ARB_MAX_TRANS_BYTES) {
@@ -301,24 +346,8 @@ static int pmic_arb_read_cmd(struct spmi_controller *ctrl,
 	else
 		return -EINVAL;
 
-	cmd = (opc << 27) | ((sid & 0xf) << 20) | (addr << 4) | (bc & 0x7);
-
 	spin_lock_irqsave(&pmic_arb->lock, flags);
-	pmic_arb_save_stat_before_txn(pmic_arb);
-	pmic_arb_write(pmic_arb, PMIC_ARB_CMD(pmic_arb->channel), cmd);
-	rc = pmic_arb_wait_for_done(pmic_arb);
-	if (rc)
-		goto done;
-
-	/* Read from FIFO, note 'bc' is actually number of bytes minus 1 */
-	pa_read_data(pmic_arb, buf, PMIC_ARB_RDATA0(pmic_arb->channel)
-							, min_t(u8, bc, 3));
-
-	if (bc > 3)
-		pa_read_data(pmic_arb, buf + 4,
-				PMIC_ARB_RDATA1(pmic_arb->channel), bc - 4);
-
-done:
+	rc = __pmic_arb_read(pmic_arb, opc, sid, addr, bc, buf);
 	spin_unlock_irqrestore(&pmic_arb->lock, flags);
 	if (rc)
 		pmic_arb_dbg_err_dump(pmic_arb, rc, "read", opc, sid, addr, bc,
@@ -331,7 +360,6 @@ static int pmic_arb_write_cmd(struct spmi_controller *ctrl,
 {
 	struct spmi_pmic_arb_dev *pmic_arb = spmi_get_ctrldata(ctrl);
 	unsigned long flags;
-	u32 cmd;
 	int rc;
 
 	if (bc >= PMIC_ARB_MAX_TRANS_BYTES) {
@@ -355,20 +383,8 @@ static int pmic_arb_write_cmd(struct spmi_controller *ctrl,
 	else
 		return -EINVAL;
 
-	cmd = (opc << 27) | ((sid & 0xf) << 20) | (addr << 4) | (bc & 0x7);
-
-	/* Write data to FIFOs */
 	spin_lock_irqsave(&pmic_arb->lock, flags);
-	pmic_arb_save_stat_before_txn(pmic_arb);
-	pa_write_data(pmic_arb, buf, PMIC_ARB_WDATA0(pmic_arb->channel)
-							, min_t(u8, bc, 3));
-	if (bc > 3)
-		pa_write_data(pmic_arb, buf + 4,
-				PMIC_ARB_WDATA1(pmic_arb->channel), bc - 4);
-
-	/* Start the transaction */
-	pmic_arb_write(pmic_arb, PMIC_ARB_CMD(pmic_arb->channel), cmd);
-	rc = pmic_arb_wait_for_done(pmic_arb);
+	rc = __pmic_arb_write(pmic_arb, opc, sid, addr, bc, buf);
 	spin_unlock_irqrestore(&pmic_arb->lock, flags);
 
 	if (rc)
@@ -378,6 +394,47 @@ static int pmic_arb_write_cmd(struct spmi_controller *ctrl,
 	return rc;
 }
 
+/*
+ * Run a batch of extended register long accesses back to back under one
+ * lock, every access split into transactions of up to 8 bytes.
+ */
+static int pmic_arb_xfer_batch(struct spmi_controller *ctrl, u8 sid,
+				struct spmi_xfer *xfers, int num)
+{
+	struct spmi_pmic_arb_dev *pmic_arb = spmi_get_ctrldata(ctrl);
+	struct spmi_xfer *x = xfers;
+	unsigned long flags;
+	int i, pos = 0;
+	u8 bc = 0;
+	int rc = 0;
+
+	spin_lock_irqsave(&pmic_arb->lock, flags);
+	for (i = 0; i < num && !rc; i++) {
+		x = &xfers[i];
+		for (pos = 0; pos < x->len; pos += bc + 1) {
+			bc = min_t(int, x->len - pos,
+				PMIC_ARB_MAX_TRANS_BYTES) - 1;
+			if (x->write)
+				rc = __pmic_arb_write(pmic_arb,
+					PMIC_ARB_OP_EXT_WRITEL, sid,
+					x->addr + pos, bc, x->buf + pos);
+			else
+				rc = __pmic_arb_read(pmic_arb,
+					PMIC_ARB_OP_EXT_READL, sid,
+					x->addr + pos, bc, x->buf + pos);
+			if (rc)
+				break;
+		}
+	}
+	spin_unlock_irqrestore(&pmic_arb->lock, flags);
+
+	if (rc)
+		pmic_arb_dbg_err_dump(pmic_arb, rc, x->write ? "write" : "read",
+			x->write ? PMIC_ARB_OP_EXT_WRITEL : PMIC_ARB_OP_EXT_READL,
+			sid, x->addr + pos, bc, x->buf + pos);
+	return rc;
+}
+
 /* APID to PPID */
 static u16 get_peripheral_id(struct spmi_pmic_arb_dev *pmic_arb, u8 apid)
 {
@@ -823,6 +880,7 @@ static int __devinit spmi_pmic_arb_probe(struct platform_device *pdev)
 	pmic_arb->controller.cmd = pmic_arb_cmd;
 	pmic_arb->controller.read_cmd = pmic_arb_read_cmd;
 	pmic_arb->controller.write_cmd =  pmic_arb_write_cmd;
+	pmic_arb->controller.xfer_batch = pmic_arb_xfer_batch;
 
 	ret = spmi_add_controller(&pmic_arb->controller);
 	if (ret)
@@ -36,6 +36,22 @@ static DEFINE_IDA(spmi_devid_ida);
 static struct device_type spmi_dev_type;
 static struct device_type spmi_ctrl_type;
 
+/**
+ * struct spmi_reg_cache: cached copy of a range of slave registers
+ * @list: entry in the controller's reg_caches list
+ * @sid: slave identifier
+ * @addr: first register of the range
+ * @len: number of registers
+ * @data: register values
+ */
+struct spmi_reg_cache {
+	struct list_head	list;
+	u8			sid;
+	u16			addr;
+	int			len;
+	u8			data[];
+};
+
 /* Forward declarations */
 struct bus_type spmi_bus_type;
 static int spmi_register_controller(struct spmi_controller *ctrl);
@@ -74,6 +90,9 @@ int spmi_add_controller(struct spmi_controller *ctrl)
 
 	pr_debug("adding controller for bus %d (0x%p)\n", ctrl->nr, ctrl);
 
+	INIT_LIST_HEAD(&ctrl->reg_caches);
+	spin_lock_init(&ctrl->cache_lock);
+
 	if (ctrl->nr & ~MAX_ID_MASK) {
 		pr_err("invalid bus identifier %d\n", ctrl->nr);
 		return -EINVAL;
@@ -148,6 +167,14 @@ int spmi_del_controller(struct spmi_controller *ctrl)
 	device_unregister(&ctrl->dev);
 	wait_for_completion(&ctrl->dev_released);
 
+	while (!list_empty(&ctrl->reg_caches)) {
+		struct spmi_reg_cache *cache = list_first_entry(
+				&ctrl->reg_caches, struct spmi_reg_cache, list);
+
+		list_del(&cache->list);
+		kfree(cache);
+	}
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(spmi_del_controller);
@@ -399,6 +426,55 @@ static inline int spmi_write_cmd(struct spmi_controller *ctrl,
 	return ctrl->write_cmd(ctrl, opcode, sid, addr, bc, buf);
 }
 
+/* Copy a cached range to buf, returns false if it isn't cached */
+static bool spmi_reg_cache_read(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, u8 *buf, int len)
+{
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+	bool hit = false;
+
+	if (list_empty(&ctrl->reg_caches))
+		return false;
+
+	spin_lock_irqsave(&ctrl->cache_lock, flags);
+	list_for_each_entry(cache, &ctrl->reg_caches, list) {
+		if (cache->sid == sid && addr >= cache->addr &&
+		    addr + len <= cache->addr + cache->len) {
+			memcpy(buf, &cache->data[addr - cache->addr], len);
+			hit = true;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&ctrl->cache_lock, flags);
+
+	return hit;
+}
+
+/* Update the cached registers overlapping a successful write */
+static void spmi_reg_cache_write(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, u8 *buf, int len)
+{
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+	int start, end;
+
+	if (list_empty(&ctrl->reg_caches))
+		return;
+
+	spin_lock_irqsave(&ctrl->cache_lock, flags);
+	list_for_each_entry(cache, &ctrl->reg_caches, list) {
+		if (cache->sid != sid)
+			continue;
+		start = max_t(int, addr, cache->addr);
+		end = min_t(int, addr + len, cache->addr + cache->len);
+		if (start < end)
+			memcpy(&cache->data[start - cache->addr],
+				&buf[start - addr], end - start);
+	}
+	spin_unlock_irqrestore(&ctrl->cache_lock, flags);
+}
+
 /*
  * register read/write: 5-bit address, 1 byte of data
  * extended register read/write: 8-bit address, up to 16 bytes of data
@@ -464,6 +540,9 @@ int spmi_ext_register_readl(struct spmi_controller *ctrl,
 	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 || len > 8)
 		return -EINVAL;
 
+	if (ctrl && spmi_reg_cache_read(ctrl, sid, addr, buf, len))
+		return 0;
+
 	return spmi_read_cmd(ctrl, SPMI_CMD_EXT_READL, sid, addr, len - 1, buf);
 }
 EXPORT_SYMBOL_GPL(spmi_ext_register_readl);
@@ -480,12 +559,16 @@ EXPORT_SYMBOL_GPL(spmi_ext_register_readl);
 int spmi_register_write(struct spmi_controller *ctrl, u8 sid, u8 addr, u8 *buf)
 {
 	u8 op = SPMI_CMD_WRITE;
+	int rc;
 
 	/* 4-bit Slave Identifier, 5-bit register address */
 	if (sid > SPMI_MAX_SLAVE_ID || addr > 0x1F)
 		return -EINVAL;
 
-	return spmi_write_cmd(ctrl, op, sid, addr, 0, buf);
+	rc = spmi_write_cmd(ctrl, op, sid, addr, 0, buf);
+	if (!rc)
+		spmi_reg_cache_write(ctrl, sid, addr, buf, 1);
+	return rc;
 }
 EXPORT_SYMBOL_GPL(spmi_register_write);
 
@@ -524,12 +607,16 @@ int spmi_ext_register_write(struct spmi_controller *ctrl,
 				u8 sid, u8 addr, u8 *buf, int len)
 {
 	u8 op = SPMI_CMD_EXT_WRITE;
+	int rc;
 
 	/* 4-bit Slave Identifier, 8-bit register address, up to 16 bytes */
 	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 || len > 16)
 		return -EINVAL;
 
-	return spmi_write_cmd(ctrl, op, sid, addr, len - 1, buf);
+	rc = spmi_write_cmd(ctrl, op, sid, addr, len - 1, buf);
+	if (!rc)
+		spmi_reg_cache_write(ctrl, sid, addr, buf, len);
+	return rc;
 }
 EXPORT_SYMBOL_GPL(spmi_ext_register_write);
 
@@ -548,15 +635,150 @@ int spmi_ext_register_writel(struct spmi_controller *ctrl,
 				u8 sid, u16 addr, u8 *buf, int len)
 {
 	u8 op = SPMI_CMD_EXT_WRITEL;
+	int rc;
 
 	/* 4-bit Slave Identifier, 16-bit register address, up to 8 bytes */
 	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 || len > 8)
 		return -EINVAL;
 
-	return spmi_write_cmd(ctrl, op, sid, addr, len - 1, buf);
+	rc = spmi_write_cmd(ctrl, op, sid, addr, len - 1, buf);
+	if (!rc)
+		spmi_reg_cache_write(ctrl, sid, addr, buf, len);
+	return rc;
 }
 EXPORT_SYMBOL_GPL(spmi_ext_register_writel);
 
+/**
+ * spmi_ext_register_xfer_batch() - batch of extended register long accesses
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @xfers: reads and writes to do, in order.
+ * @num: number of entries in @xfers.
+ *
+ * Controllers without a batch operation get one transaction of up to
+ * 8 bytes per chunk, exactly as if the client had made the calls itself.
+ */
+int spmi_ext_register_xfer_batch(struct spmi_controller *ctrl,
+				u8 sid, struct spmi_xfer *xfers, int num)
+{
+	struct spmi_xfer *x;
+	int i, pos, len, rc = 0;
+
+	if (!ctrl || ctrl->dev.type != &spmi_ctrl_type)
+		return -EINVAL;
+	if (sid > SPMI_MAX_SLAVE_ID || num <= 0)
+		return -EINVAL;
+	for (i = 0; i < num; i++)
+		if (!xfers[i].len || !xfers[i].buf ||
+		    xfers[i].addr + xfers[i].len > 0x10000)
+			return -EINVAL;
+
+	if (ctrl->xfer_batch) {
+		rc = ctrl->xfer_batch(ctrl, sid, xfers, num);
+	} else {
+		for (i = 0; i < num && !rc; i++) {
+			x = &xfers[i];
+			for (pos = 0; pos < x->len && !rc; pos += len) {
+				len = min_t(int, x->len - pos, 8);
+				rc = x->write ?
+					spmi_write_cmd(ctrl,
+						SPMI_CMD_EXT_WRITEL, sid,
+						x->addr + pos, len - 1,
+						x->buf + pos) :
+					spmi_read_cmd(ctrl,
+						SPMI_CMD_EXT_READL, sid,
+						x->addr + pos, len - 1,
+						x->buf + pos);
+			}
+		}
+	}
+	if (rc)
+		return rc;
+
+	for (i = 0; i < num; i++)
+		if (xfers[i].write)
+			spmi_reg_cache_write(ctrl, sid, xfers[i].addr,
+					xfers[i].buf, xfers[i].len);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(spmi_ext_register_xfer_batch);
+
+/**
+ * spmi_ext_register_cache() - cache a range of registers
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @ad: first register of the range (16-bit address).
+ * @len: number of registers in the range.
+ *
+ * Each range may only be registered once. Returns 0 on success, or the
+ * error of reading the range.
+ */
+int spmi_ext_register_cache(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, int len)
+{
+	struct spmi_reg_cache *cache;
+	struct spmi_xfer xfer;
+	unsigned long flags;
+	int rc;
+
+	if (!ctrl || len <= 0)
+		return -EINVAL;
+
+	cache = kzalloc(sizeof(*cache) + len, GFP_KERNEL);
+	if (!cache)
+		return -ENOMEM;
+
+	cache->sid = sid;
+	cache->addr = addr;
+	cache->len = len;
+
+	xfer.addr = addr;
+	xfer.buf = cache->data;
+	xfer.len = len;
+	xfer.write = false;
+	rc = spmi_ext_register_xfer_batch(ctrl, sid, &xfer, 1);
+	if (rc) {
+		kfree(cache);
+		return rc;
+	}
+
+	spin_lock_irqsave(&ctrl->cache_lock, flags);
+	list_add_tail(&cache->list, &ctrl->reg_caches);
+	spin_unlock_irqrestore(&ctrl->cache_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(spmi_ext_register_cache);
+
+/**
+ * spmi_ext_register_cache_drop() - stop caching a range of registers
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @ad: first register of a range given to spmi_ext_register_cache().
+ */
+void spmi_ext_register_cache_drop(struct spmi_controller *ctrl,
+				u8 sid, u16 addr)
+{
+	struct spmi_reg_cache *cache, *found = NULL;
+	unsigned long flags;
+
+	if (!ctrl)
+		return;
+
+	spin_lock_irqsave(&ctrl->cache_lock, flags);
+	list_for_each_entry(cache, &ctrl->reg_caches, list) {
+		if (cache->sid == sid && cache->addr == addr) {
+			list_del(&cache->list);
+			found = cache;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&ctrl->cache_lock, flags);
+
+	kfree(found);
+}
+EXPORT_SYMBOL_GPL(spmi_ext_register_cache_drop);
+
 /**
  * spmi_command_reset() - sends RESET command to the specified slave
  * @dev: SPMI device.
@@ -22,7 +22,9 @@
 #include <linux/file.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -128,9 +130,18 @@ static int binder_set_stop_on_user_error(const char *val,
 module_param_call(stop_on_user_error, binder_set_stop_on_user_error,
 	param_get_int, &binder_stop_on_user_error, S_IWUSR | S_IRUGO);
 
+static int binder_max_cached_pages = 16;
+module_param_named(max_cached_pages, binder_max_cached_pages,
+		   int, S_IWUSR | S_IRUGO);
+
 static bool binder_global_pid_lookups = true;
 module_param_named(global_pid_lookups, binder_global_pid_lookups, bool, S_IRUGO);
 
+/* Round trips (or one-way queueing delays) above this fire a tracepoint */
+static uint binder_slow_transaction_us = 100000;
+module_param_named(slow_transaction_us, binder_slow_transaction_us,
+		   uint, S_IWUSR | S_IRUGO);
+
 #define binder_debug(mask, x...) \
 	do { \
 		if (binder_debug_mask & mask) \
@@ -176,6 +187,33 @@ struct binder_stats {
 
 static struct binder_stats binder_stats;
 
+/*
+ * Transaction latency histograms.  Bucket 0 counts samples below 1us,
+ * bucket n counts samples in [2^(n-1), 2^n) us and the last bucket
+ * collects everything above.  All updates happen under binder_main_lock.
+ *
+ * queue:   submission to dequeue by the receiving thread
+ * reply:   dequeue of a call to submission of its reply (service time)
+ * total:   submission of a call to submission of its reply (round trip),
+ *          accounted to the caller
+ */
+#define BINDER_LATENCY_BUCKETS 20
+
+struct binder_latency_stats {
+	u32 queue[BINDER_LATENCY_BUCKETS];
+	u32 reply[BINDER_LATENCY_BUCKETS];
+	u32 total[BINDER_LATENCY_BUCKETS];
+};
+
+static inline void binder_latency_add(u32 *hist, s64 us)
+{
+	int bucket = 0;
+
+	if (us > 0)
+		bucket = min_t(int, ilog2(us) + 1, BINDER_LATENCY_BUCKETS - 1);
+	hist[bucket]++;
+}
+
 static inline void binder_stats_deleted(enum binder_stat_types type)
 {
 	binder_stats.obj_deleted[type]++;
@@ -266,7 +304,8 @@ struct binder_node {
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
 	unsigned txn_security_ctx:1;
-	unsigned min_priority:8;
+	unsigned sched_policy:2;
+	unsigned min_priority:8;	/* kernel prio, see binder_to_kernel_prio */
 	struct list_head async_todo;
 };
 
@@ -353,6 +392,69 @@ struct binder_proc {
 	struct binder_context *context;
 };
 
+/**
+ * struct binder_proc_ext - binder process bookkeeping
+ * @proc:            element for binder_procs list
+ * @cred                  struct cred associated with the `struct file`
+ *                        in binder_open()
+ *                        (invariant after initialized)
+ * @alloc_lock:           protects the buffer allocator: @proc.buffers,
+ *                        @proc.free_buffers, @proc.allocated_buffers,
+ *                        @proc.free_async_space and @proc.pages.
+ *                        Nests inside binder_main_lock.
+ * @tmp_ref:              number of transactions copying into a buffer
+ *                        of this proc without binder_main_lock held
+ *                        (protected by binder_main_lock)
+ * @is_dead:              set once binder_deferred_release() ran, the
+ *                        allocator is torn down when @tmp_ref drops
+ *                        to zero (protected by binder_main_lock)
+ *
+ * Extended binder_proc -- needed to add the "cred" field without
+ * changing the KMI for binder_proc.
+ */
+/*
+ * A scheduling policy together with a kernel priority (0..MAX_RT_PRIO-1
+ * for the RT classes, MAX_RT_PRIO.. for the fair classes), as found in
+ * task_struct->policy and task_struct->normal_prio.
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
+struct binder_proc_ext {
+	struct binder_proc proc;
+	struct binder_priority default_priority;
+	const struct cred *cred;
+	struct mutex alloc_lock;
+	int tmp_ref;
+	bool is_dead;
+	struct binder_latency_stats latency;
+
+	/*
+	 * Pages whose last buffer went away stay mapped on cached_pages,
+	 * most recently freed first, so the next allocation over them
+	 * does not need mmap_sem.  page_lru has one node per page of the
+	 * mapping and is empty for pages that are unmapped or in use.
+	 */
+	struct list_head *page_lru;
+	struct list_head cached_pages;
+	int nr_cached_pages;
+	unsigned long page_range_hits;
+	unsigned long page_range_misses;
+};
+
+static inline struct binder_proc_ext *to_binder_proc_ext(
+	struct binder_proc *proc)
+{
+	return container_of(proc, struct binder_proc_ext, proc);
+}
+
+static inline const struct cred *binder_get_cred(struct binder_proc *proc)
+{
+	return to_binder_proc_ext(proc)->cred;
+}
+
 enum {
 	BINDER_LOOPER_STATE_REGISTERED  = 0x01,
 	BINDER_LOOPER_STATE_ENTERED     = 0x02,
@@ -375,6 +477,9 @@ struct binder_thread {
 		/* we are also waiting on */
 	wait_queue_head_t wait;
 	struct binder_stats stats;
+	struct binder_latency_stats latency;
+	/* BR_TRANSACTION_COMPLETE for the last transaction or reply sent */
+	struct binder_work tcomplete;
 };
 
 struct binder_transaction {
@@ -391,10 +496,12 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	uid_t	sender_euid;
 	binder_uintptr_t security_ctx;
+	ktime_t	start_time;
+	ktime_t	dequeue_time;
 };
 
 static void
@@ -462,21 +569,132 @@ static inline void binder_unlock(const char *tag)
 	mutex_unlock(&binder_main_lock);
 }
 
-static void binder_set_nice(long nice)
+#define BINDER_NICE_TO_PRIO(nice)	(MAX_RT_PRIO + (nice) + 20)
+#define BINDER_PRIO_TO_NICE(prio)	((prio) - MAX_RT_PRIO - 20)
+
+static bool is_rt_policy(int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static bool is_fair_policy(int policy)
+{
+	return policy == SCHED_NORMAL || policy == SCHED_BATCH;
+}
+
+static bool binder_supported_policy(int policy)
+{
+	return is_fair_policy(policy) || is_rt_policy(policy);
+}
+
+static int binder_to_userspace_prio(int policy, int kernel_priority)
+{
+	if (is_fair_policy(policy))
+		return BINDER_PRIO_TO_NICE(kernel_priority);
+	else
+		return MAX_USER_RT_PRIO - 1 - kernel_priority;
+}
+
+static int binder_to_kernel_prio(int policy, int user_priority)
+{
+	if (is_fair_policy(policy))
+		return BINDER_NICE_TO_PRIO(user_priority);
+	else
+		return MAX_USER_RT_PRIO - 1 - user_priority;
+}
+
+/*
+ * Switch current to @desired, clamped to what RLIMIT_RTPRIO and
+ * RLIMIT_NICE allow unless the task has CAP_SYS_NICE.  Binder threads
+ * never hand an inherited priority down to children they fork.
+ */
+static void binder_set_priority(struct binder_priority desired)
 {
-	long min_nice;
-	if (can_nice(current, nice)) {
-		set_user_nice(current, nice);
+	struct task_struct *task = current;
+	unsigned int policy = desired.sched_policy;
+	int priority;
+	bool has_cap_nice;
+
+	if (task->policy == policy && task->normal_prio == desired.prio)
 		return;
+
+	has_cap_nice = has_capability_noaudit(task, CAP_SYS_NICE);
+	priority = binder_to_userspace_prio(policy, desired.prio);
+
+	if (is_rt_policy(policy) && !has_cap_nice) {
+		long max_rtprio = task_rlimit(task, RLIMIT_RTPRIO);
+
+		if (max_rtprio == 0) {
+			policy = SCHED_NORMAL;
+			priority = -20;
+		} else if (priority > max_rtprio) {
+			priority = max_rtprio;
+		}
 	}
-	min_nice = 20 - current->signal->rlim[RLIMIT_NICE].rlim_cur;
-	binder_debug(BINDER_DEBUG_PRIORITY_CAP,
-		     "%d: nice value %ld not allowed use %ld instead\n",
-		      current->pid, nice, min_nice);
-	set_user_nice(current, min_nice);
-	if (min_nice < 20)
+
+	if (is_fair_policy(policy) && !has_cap_nice) {
+		long min_nice = 20 - task_rlimit(task, RLIMIT_NICE);
+
+		if (min_nice > 19) {
+			binder_user_error("%d RLIMIT_NICE not set\n",
+					  task->pid);
+			return;
+		} else if (priority < min_nice) {
+			priority = min_nice;
+		}
+	}
+
+	if (policy != desired.sched_policy ||
+	    binder_to_kernel_prio(policy, priority) != desired.prio)
+		binder_debug(BINDER_DEBUG_PRIORITY_CAP,
+			     "%d: priority %d (policy %u) not allowed, using %d (policy %u) instead\n",
+			     task->pid, desired.prio, desired.sched_policy,
+			     binder_to_kernel_prio(policy, priority), policy);
+
+	if (is_rt_policy(policy)) {
+		struct sched_param params = { .sched_priority = priority };
+
+		sched_setscheduler_nocheck(task, policy | SCHED_RESET_ON_FORK,
+					   &params);
+	} else {
+		struct sched_param params = { .sched_priority = 0 };
+
+		if (task->policy != policy)
+			sched_setscheduler_nocheck(task,
+						   policy | SCHED_RESET_ON_FORK,
+						   &params);
+		set_user_nice(task, priority);
+	}
+}
+
+/*
+ * Called by the thread that picked up synchronous or one-way transaction
+ * @t for @node: remember the thread's own priority so it can be restored
+ * on reply, then run at the caller's priority or the node's minimum,
+ * whichever is higher.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority desired = t->priority;
+	struct binder_priority node_prio = {
+		.sched_policy = node->sched_policy,
+		.prio = node->min_priority,
+	};
+
+	t->saved_priority.sched_policy = current->policy;
+	t->saved_priority.prio = current->normal_prio;
+
+	if (node_prio.prio < desired.prio ||
+	    (node_prio.prio == desired.prio &&
+	     node_prio.sched_policy == SCHED_FIFO))
+		desired = node_prio;
+
+	/* a one-way call never lowers the priority of the thread running it */
+	if ((t->flags & TF_ONE_WAY) && desired.prio >= t->saved_priority.prio)
 		return;
-	binder_user_error("%d RLIMIT_NICE not set\n", current->pid);
+
+	binder_set_priority(desired);
 }
 
 static size_t binder_buffer_size(struct binder_proc *proc,
@@ -547,8 +765,8 @@ static void binder_insert_allocated_buffer(struct binder_proc *proc,
 	rb_insert_color(&new_buffer->rb_node, &proc->allocated_buffers);
 }
 
-static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
-						  uintptr_t user_ptr)
+static struct binder_buffer *__binder_buffer_lookup(struct binder_proc *proc,
+						    uintptr_t user_ptr)
 {
 	struct rb_node *n = proc->allocated_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -571,15 +789,202 @@ static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
 	return NULL;
 }
 
+static struct binder_buffer *binder_buffer_lookup(struct binder_proc *proc,
+						  uintptr_t user_ptr)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+	struct binder_buffer *buffer;
+
+	mutex_lock(&eproc->alloc_lock);
+	buffer = __binder_buffer_lookup(proc, user_ptr);
+	mutex_unlock(&eproc->alloc_lock);
+
+	return buffer;
+}
+
+/*
+ * Largest block binder_alloc_pages() asks the page allocator for before
+ * splitting it into the single pages the buffer is built from.
+ */
+#define BINDER_PAGE_ALLOC_ORDER 4
+
+static int binder_alloc_pages(struct binder_proc *proc, struct page **pages,
+			      int nr_pages)
+{
+	int i = 0;
+
+	while (i < nr_pages) {
+		int order = min(ilog2(nr_pages - i), BINDER_PAGE_ALLOC_ORDER);
+		struct page *page = NULL;
+		int j;
+
+		if (order)
+			page = alloc_pages(GFP_KERNEL | __GFP_HIGHMEM |
+					   __GFP_ZERO | __GFP_NORETRY |
+					   __GFP_NOWARN, order);
+		if (page) {
+			split_page(page, order);
+		} else {
+			order = 0;
+			page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM |
+					  __GFP_ZERO);
+			if (page == NULL) {
+				pr_err("%d: binder_alloc_buf failed for page %d/%d\n",
+				       proc->pid, i, nr_pages);
+				goto err;
+			}
+		}
+		for (j = 0; j < (1 << order); j++) {
+			BUG_ON(pages[i]);
+			pages[i++] = page + j;
+		}
+	}
+	return 0;
+
+err:
+	while (i--) {
+		__free_page(pages[i]);
+		pages[i] = NULL;
+	}
+	return -ENOMEM;
+}
+
+/*
+ * Allocate and map @nr_pages unmapped pages starting at page @index of
+ * the buffer.  The pages come from the allocator in blocks where
+ * possible and are mapped into the kernel with a single map_vm_area()
+ * call; only the user side has to be filled one page at a time.
+ */
+static int binder_map_pages(struct binder_proc *proc,
+			    struct vm_area_struct *vma, int index, int nr_pages)
+{
+	struct page **pages = &proc->pages[index];
+	struct page **page_array_ptr = pages;
+	void *start = proc->buffer + index * PAGE_SIZE;
+	unsigned long user_start = (uintptr_t)start + proc->user_buffer_offset;
+	struct vm_struct tmp_area;
+	int i;
+
+	if (binder_alloc_pages(proc, pages, nr_pages))
+		return -ENOMEM;
+
+	tmp_area.addr = start;
+	tmp_area.size = nr_pages * PAGE_SIZE + PAGE_SIZE /* guard page? */;
+	if (map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr)) {
+		pr_err("%d: binder_alloc_buf failed to map %d pages at %pK in kernel\n",
+		       proc->pid, nr_pages, start);
+		goto err_map_kernel_failed;
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		unsigned long user_page_addr = user_start + i * PAGE_SIZE;
+
+		if (vm_insert_page(vma, user_page_addr, pages[i])) {
+			pr_err("%d: binder_alloc_buf failed to map page at %lx in userspace\n",
+			       proc->pid, user_page_addr);
+			goto err_vm_insert_page_failed;
+		}
+		/* vm_insert_page does not seem to increment the refcount */
+	}
+	return 0;
+
+err_vm_insert_page_failed:
+	if (i)
+		zap_page_range(vma, user_start, i * PAGE_SIZE, NULL);
+	unmap_kernel_range((unsigned long)start, nr_pages * PAGE_SIZE);
+err_map_kernel_failed:
+	for (i = 0; i < nr_pages; i++) {
+		__free_page(pages[i]);
+		pages[i] = NULL;
+	}
+	return -ENOMEM;
+}
+
+static void binder_unmap_page(struct binder_proc *proc,
+			      struct vm_area_struct *vma, int index)
+{
+	void *page_addr = proc->buffer + index * PAGE_SIZE;
+
+	if (vma)
+		zap_page_range(vma, (uintptr_t)page_addr +
+			       proc->user_buffer_offset, PAGE_SIZE, NULL);
+	unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+	__free_page(proc->pages[index]);
+	proc->pages[index] = NULL;
+}
+
+static void binder_cache_page(struct binder_proc *proc, int index)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+
+	BUG_ON(!proc->pages[index]);
+	BUG_ON(!list_empty(&eproc->page_lru[index]));
+	list_add(&eproc->page_lru[index], &eproc->cached_pages);
+	eproc->nr_cached_pages++;
+}
+
+static void binder_uncache_page(struct binder_proc *proc, int index)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+
+	BUG_ON(list_empty(&eproc->page_lru[index]));
+	list_del_init(&eproc->page_lru[index]);
+	eproc->nr_cached_pages--;
+}
+
+/* Caller holds mmap_sem of the vma's mm, if there is one */
+static void __binder_trim_page_cache(struct binder_proc *proc,
+				     struct vm_area_struct *vma)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+
+	while (eproc->nr_cached_pages > max(binder_max_cached_pages, 0)) {
+		struct list_head *lru = eproc->cached_pages.prev;
+
+		list_del_init(lru);
+		eproc->nr_cached_pages--;
+		binder_unmap_page(proc, vma, lru - eproc->page_lru);
+	}
+}
+
+static void binder_trim_page_cache(struct binder_proc *proc)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+	struct vm_area_struct *vma = NULL;
+	struct mm_struct *mm;
+
+	if (eproc->nr_cached_pages <= binder_max_cached_pages)
+		return;
+
+	mm = get_task_mm(proc->tsk);
+	if (mm) {
+		down_write(&mm->mmap_sem);
+		if (mmget_still_valid(mm)) {
+			vma = proc->vma;
+			if (vma && mm != proc->vma_vm_mm) {
+				pr_err("%d: vma mm and task mm mismatch\n",
+					proc->pid);
+				vma = NULL;
+			}
+		}
+	}
+
+	__binder_trim_page_cache(proc, vma);
+
+	if (mm) {
+		up_write(&mm->mmap_sem);
+		mmput(mm);
+	}
+}
+
 static int binder_update_page_range(struct binder_proc *proc, int allocate,
 				    void *start, void *end,
 				    struct vm_area_struct *vma)
 {
-	void *page_addr;
-	unsigned long user_page_addr;
-	struct vm_struct tmp_area;
-	struct page **page;
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
 	struct mm_struct *mm;
+	int first, last, i, n;
+	bool missing = false;
 
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "%d: %s pages %pK-%pK\n", proc->pid,
@@ -590,6 +995,29 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 
 	trace_binder_update_page_range(proc, allocate, start, end);
 
+	first = (start - proc->buffer) / PAGE_SIZE;
+	last = (end - proc->buffer) / PAGE_SIZE;
+
+	if (allocate == 0) {
+		for (i = first; i < last; i++)
+			binder_cache_page(proc, i);
+		binder_trim_page_cache(proc);
+		return 0;
+	}
+
+	/* pages still on the cache are taken back without touching the mm */
+	for (i = first; i < last; i++) {
+		if (proc->pages[i])
+			binder_uncache_page(proc, i);
+		else
+			missing = true;
+	}
+	if (!missing) {
+		eproc->page_range_hits++;
+		return 0;
+	}
+	eproc->page_range_misses++;
+
 	if (vma)
 		mm = NULL;
 	else
@@ -597,11 +1025,8 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 
 	if (mm) {
 		down_write(&mm->mmap_sem);
-		if (!mmget_still_valid(mm)) {
-			if (allocate == 0)
-				goto free_range;
+		if (!mmget_still_valid(mm))
 			goto err_no_vma;
-		}
 		vma = proc->vma;
 		if (vma && mm != proc->vma_vm_mm) {
 			pr_err("%d: vma mm and task mm mismatch\n",
@@ -610,45 +1035,20 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		}
 	}
 
-	if (allocate == 0)
-		goto free_range;
-
 	if (vma == NULL) {
 		pr_err("%d: binder_alloc_buf failed to map pages in userspace, no vma\n",
 			proc->pid);
 		goto err_no_vma;
 	}
 
-	for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE) {
-		int ret;
-		struct page **page_array_ptr;
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-
-		BUG_ON(*page);
-		*page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO);
-		if (*page == NULL) {
-			pr_err("%d: binder_alloc_buf failed for page at %pK\n",
-				proc->pid, page_addr);
-			goto err_alloc_page_failed;
-		}
-		tmp_area.addr = page_addr;
-		tmp_area.size = PAGE_SIZE + PAGE_SIZE /* guard page? */;
-		page_array_ptr = page;
-		ret = map_vm_area(&tmp_area, PAGE_KERNEL, &page_array_ptr);
-		if (ret) {
-			pr_err("%d: binder_alloc_buf failed to map page at %pK in kernel\n",
-			       proc->pid, page_addr);
-			goto err_map_kernel_failed;
-		}
-		user_page_addr =
-			(uintptr_t)page_addr + proc->user_buffer_offset;
-		ret = vm_insert_page(vma, user_page_addr, page[0]);
-		if (ret) {
-			pr_err("%d: binder_alloc_buf failed to map page at %lx in userspace\n",
-			       proc->pid, user_page_addr);
-			goto err_vm_insert_page_failed;
-		}
-		/* vm_insert_page does not seem to increment the refcount */
+	for (i = first; i < last; i += n) {
+		n = 1;
+		if (proc->pages[i])
+			continue;
+		while (i + n < last && !proc->pages[i + n])
+			n++;
+		if (binder_map_pages(proc, vma, i, n))
+			goto err_map_failed;
 	}
 	if (mm) {
 		up_write(&mm->mmap_sem);
@@ -656,22 +1056,14 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 	}
 	return 0;
 
-free_range:
-	for (page_addr = end - PAGE_SIZE; page_addr >= start;
-	     page_addr -= PAGE_SIZE) {
-		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
-		if (vma)
-			zap_page_range(vma, (uintptr_t)page_addr +
-				proc->user_buffer_offset, PAGE_SIZE, NULL);
-err_vm_insert_page_failed:
-		unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
-err_map_kernel_failed:
-		__free_page(*page);
-		*page = NULL;
-err_alloc_page_failed:
-		;
-	}
 err_no_vma:
+	vma = NULL;
+err_map_failed:
+	/* whatever is mapped in the range goes back to the cache */
+	for (i = first; i < last; i++)
+		if (proc->pages[i])
+			binder_cache_page(proc, i);
+	__binder_trim_page_cache(proc, vma);
 	if (mm) {
 		up_write(&mm->mmap_sem);
 		mmput(mm);
@@ -679,11 +1071,11 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size,
-					      size_t extra_buffers_size,
-					      int is_async)
+static struct binder_buffer *__binder_alloc_buf(struct binder_proc *proc,
+						size_t data_size,
+						size_t offsets_size,
+						size_t extra_buffers_size,
+						int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -792,6 +1184,27 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+/*
+ * Only needs the allocator lock, so this may be called without
+ * binder_main_lock as long as the caller holds a tmp ref on @proc.
+ */
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size,
+					      size_t extra_buffers_size,
+					      int is_async)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+	struct binder_buffer *buffer;
+
+	mutex_lock(&eproc->alloc_lock);
+	buffer = __binder_alloc_buf(proc, data_size, offsets_size,
+				    extra_buffers_size, is_async);
+	mutex_unlock(&eproc->alloc_lock);
+
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -847,8 +1260,8 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
-			    struct binder_buffer *buffer)
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
@@ -902,6 +1315,81 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+
+	mutex_lock(&eproc->alloc_lock);
+	__binder_free_buf(proc, buffer);
+	mutex_unlock(&eproc->alloc_lock);
+}
+
+/* Frees what binder_deferred_release() left for the last tmp ref. */
+static void binder_free_proc(struct binder_proc *proc)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+	struct rb_node *n;
+	int buffers, page_count;
+
+	buffers = 0;
+	mutex_lock(&eproc->alloc_lock);
+	while ((n = rb_first(&proc->allocated_buffers))) {
+		struct binder_buffer *buffer;
+
+		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		__binder_free_buf(proc, buffer);
+		buffers++;
+	}
+	mutex_unlock(&eproc->alloc_lock);
+
+	binder_stats_deleted(BINDER_STAT_PROC);
+
+	page_count = 0;
+	if (proc->pages) {
+		int i;
+
+		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+			void *page_addr;
+
+			if (!proc->pages[i])
+				continue;
+
+			page_addr = proc->buffer + i * PAGE_SIZE;
+			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+				     "%s: %d: page %d at %pK not freed\n",
+				     __func__, proc->pid, i, page_addr);
+			unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+			__free_page(proc->pages[i]);
+			page_count++;
+		}
+		kfree(proc->pages);
+		kfree(eproc->page_lru);
+		vfree(proc->buffer);
+	}
+
+	put_task_struct(proc->tsk);
+
+	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+		     "%s: %d buffers %d, pages %d\n",
+		     __func__, proc->pid, buffers, page_count);
+
+	kfree(eproc);
+}
+
+static void binder_proc_inc_tmpref(struct binder_proc *proc)
+{
+	to_binder_proc_ext(proc)->tmp_ref++;
+}
+
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+
+	if (--eproc->tmp_ref == 0 && eproc->is_dead)
+		binder_free_proc(proc);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   binder_uintptr_t ptr)
 {
@@ -921,6 +1409,21 @@ static struct binder_node *binder_get_node(struct binder_proc *proc,
 	return NULL;
 }
 
+static void binder_init_node_priority(struct binder_node *node, __u32 flags)
+{
+	int policy = (flags & FLAT_BINDER_FLAG_SCHED_POLICY_MASK) >>
+			FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT;
+	int priority = flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
+
+	if (is_fair_policy(policy))
+		priority = clamp_t(int, (s8)priority, -20, 19);
+	else
+		priority = clamp_t(int, priority, 1, MAX_USER_RT_PRIO - 1);
+
+	node->sched_policy = policy;
+	node->min_priority = binder_to_kernel_prio(policy, priority);
+}
+
 static struct binder_node *binder_new_node(struct binder_proc *proc,
 					   struct flat_binder_object *fp)
 {
@@ -956,6 +1459,7 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	node->cookie = cookie;
 	node->work.type = BINDER_WORK_NODE;
 	node->txn_security_ctx = 0; /*!!(flags & FLAT_BINDER_FLAG_TXN_SECURITY_CTX);*/
+	binder_init_node_priority(node, flags);
 	INIT_LIST_HEAD(&node->work.entry);
 	INIT_LIST_HEAD(&node->async_todo);
 	binder_debug(BINDER_DEBUG_INTERNAL_REFS,
@@ -1217,6 +1721,51 @@ static int binder_dec_ref(struct binder_ref **ptr_to_ref, int strong)
 	return 0;
 }
 
+static void binder_transaction_dequeued(struct binder_thread *thread,
+					struct binder_transaction *t)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(thread->proc);
+	s64 queue_us;
+
+	t->dequeue_time = ktime_get();
+	queue_us = ktime_us_delta(t->dequeue_time, t->start_time);
+	binder_latency_add(thread->latency.queue, queue_us);
+	binder_latency_add(eproc->latency.queue, queue_us);
+
+	/* one-way transactions never see a reply, check them here */
+	if ((t->flags & TF_ONE_WAY) && binder_slow_transaction_us &&
+	    queue_us >= binder_slow_transaction_us)
+		trace_binder_transaction_slow(t, thread, queue_us, 0, queue_us);
+}
+
+static void binder_transaction_replied(struct binder_thread *thread,
+				       struct binder_thread *caller,
+				       struct binder_transaction *in_reply_to)
+{
+	ktime_t now = ktime_get();
+	s64 queue_us, reply_us, total_us;
+
+	queue_us = ktime_us_delta(in_reply_to->dequeue_time,
+				  in_reply_to->start_time);
+	reply_us = ktime_us_delta(now, in_reply_to->dequeue_time);
+	total_us = ktime_us_delta(now, in_reply_to->start_time);
+
+	binder_latency_add(thread->latency.reply, reply_us);
+	binder_latency_add(to_binder_proc_ext(thread->proc)->latency.reply,
+			   reply_us);
+	if (caller) {
+		binder_latency_add(caller->latency.total, total_us);
+		binder_latency_add(
+			to_binder_proc_ext(caller->proc)->latency.total,
+			total_us);
+	}
+
+	if (binder_slow_transaction_us &&
+	    total_us >= binder_slow_transaction_us)
+		trace_binder_transaction_slow(in_reply_to, thread, queue_us,
+					      reply_us, total_us);
+}
+
 static void binder_pop_transaction(struct binder_thread *target_thread,
 				   struct binder_transaction *t)
 {
@@ -1285,29 +1834,6 @@ static void binder_send_failed_reply(struct binder_transaction *t,
 	}
 }
 
-/**
- * struct binder_proc_ext - binder process bookkeeping
- * @proc:            element for binder_procs list
- * @cred                  struct cred associated with the `struct file`
- *                        in binder_open()
- *                        (invariant after initialized)
- *
- * Extended binder_proc -- needed to add the "cred" field without
- * changing the KMI for binder_proc.
- */
-struct binder_proc_ext {
-	struct binder_proc proc;
-	const struct cred *cred;
-};
-
-static inline const struct cred *binder_get_cred(struct binder_proc *proc)
-{
-	struct binder_proc_ext *eproc;
-
-	eproc = container_of(proc, struct binder_proc_ext, proc);
-	return eproc->cred;
-}
-
 /**
  * binder_validate_object() - checks for a valid metadata object in a buffer.
  * @buffer:	binder_buffer that we're parsing.
@@ -1603,7 +2129,6 @@ static int binder_translate_binder(struct flat_binder_object *fp,
 		if (!node)
 			return -ENOMEM;
 
-		node->min_priority = fp->flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
 		node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
 	}
 	if (fp->cookie != node->cookie) {
@@ -1856,6 +2381,23 @@ static int binder_fixup_parent(struct binder_transaction *t,
 	return 0;
 }
 
+/*
+ * A synchronous transaction to a proc that is already waiting on us
+ * further down the call stack goes to the thread that is waiting.
+ */
+static struct binder_thread *binder_stack_target_thread(
+	struct binder_thread *thread, struct binder_proc *target_proc)
+{
+	struct binder_transaction *tmp;
+	struct binder_thread *target_thread = NULL;
+
+	for (tmp = thread->transaction_stack; tmp; tmp = tmp->from_parent) {
+		if (tmp->from && tmp->from->proc == target_proc)
+			target_thread = tmp->from;
+	}
+	return target_thread;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply,
@@ -1880,6 +2422,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_context *context = proc->context;
 	char *secctx = NULL;
 	u32 secctx_sz = 0;
+	bool copy_failed;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1898,7 +2441,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("%d:%d got reply transaction with bad transaction stack, transaction %d has target %d:%d\n",
 				proc->pid, thread->pid, in_reply_to->debug_id,
@@ -1969,21 +2512,12 @@ static void binder_transaction(struct binder_proc *proc,
 				return_error = BR_FAILED_REPLY;
 				goto err_bad_call_stack;
 			}
-			while (tmp) {
-				if (tmp->from && tmp->from->proc == target_proc)
-					target_thread = tmp->from;
-				tmp = tmp->from_parent;
-			}
+			target_thread = binder_stack_target_thread(thread,
+								   target_proc);
 		}
 	}
-	if (target_thread) {
+	if (target_thread)
 		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
@@ -1993,11 +2527,20 @@ static void binder_transaction(struct binder_proc *proc,
 		goto err_alloc_t_failed;
 	}
 	binder_stats_created(BINDER_STAT_TRANSACTION);
+	t->start_time = ktime_get();
 
-	tcomplete = kzalloc(sizeof(*tcomplete), GFP_KERNEL);
-	if (tcomplete == NULL) {
-		return_error = BR_FAILED_REPLY;
-		goto err_alloc_tcomplete_failed;
+	/*
+	 * A thread usually reads the completion of what it sent before it
+	 * sends again, only batched writes need more than the embedded one.
+	 */
+	if (list_empty(&thread->tcomplete.entry)) {
+		tcomplete = &thread->tcomplete;
+	} else {
+		tcomplete = kzalloc(sizeof(*tcomplete), GFP_KERNEL);
+		if (tcomplete == NULL) {
+			return_error = BR_FAILED_REPLY;
+			goto err_alloc_tcomplete_failed;
+		}
 	}
 	binder_stats_created(BINDER_STAT_TRANSACTION_COMPLETE);
 
@@ -2032,7 +2575,14 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	if (!(t->flags & TF_ONE_WAY) &&
+	    binder_supported_policy(current->policy)) {
+		/* synchronous callers lend their own class and priority */
+		t->priority.sched_policy = current->policy;
+		t->priority.prio = current->normal_prio;
+	} else {
+		t->priority = to_binder_proc_ext(target_proc)->default_priority;
+	}
 
 	if (target_node && target_node->txn_security_ctx) {
 		u32 secid;
@@ -2055,52 +2605,119 @@ static void binder_transaction(struct binder_proc *proc,
 
 	trace_binder_transaction(reply, t, target_node);
 
+	/*
+	 * Allocating the buffer and copying the payload into it only need
+	 * the target's allocator lock, and nobody else can see the buffer
+	 * until it is queued below, so do that without binder_main_lock.
+	 * The local strong ref keeps target_node around and the tmp ref
+	 * keeps target_proc's buffer space mapped if it dies meanwhile;
+	 * everything else that was looked up is checked again afterwards.
+	 */
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+	binder_proc_inc_tmpref(target_proc);
+	binder_unlock(__func__);
+
+	copy_failed = false;
 	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, extra_buffers_size,
 		!reply && (t->flags & TF_ONE_WAY));
+	if (t->buffer) {
+		t->buffer->debug_id = t->debug_id;
+		t->buffer->target_node = target_node;
+		if (secctx) {
+			size_t buf_offset = ALIGN(tr->data_size, sizeof(void *)) +
+					    ALIGN(tr->offsets_size, sizeof(void *)) +
+					    ALIGN(extra_buffers_size, sizeof(void *)) -
+					    ALIGN(secctx_sz, sizeof(u64));
+			char *kptr = t->buffer->data + buf_offset;
+
+			t->security_ctx = (binder_uintptr_t)(
+					(uintptr_t)kptr +
+					target_proc->user_buffer_offset);
+			memcpy(kptr, secctx, secctx_sz);
+			security_release_secctx(secctx, secctx_sz);
+			secctx = NULL;
+		}
+		if (copy_from_user(t->buffer->data,
+				   (const void __user *)(uintptr_t)
+				   tr->data.ptr.buffer, tr->data_size)) {
+			binder_user_error("%d:%d got transaction with invalid data ptr\n",
+					proc->pid, thread->pid);
+			copy_failed = true;
+		} else if (copy_from_user(t->buffer->data +
+					  ALIGN(tr->data_size, sizeof(void *)),
+					  (const void __user *)(uintptr_t)
+					  tr->data.ptr.offsets,
+					  tr->offsets_size)) {
+			binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
+					proc->pid, thread->pid);
+			copy_failed = true;
+		}
+	}
+
+	binder_lock(__func__);
+	if (to_binder_proc_ext(target_proc)->is_dead) {
+		/*
+		 * Released while we were unlocked: its nodes, and with them
+		 * our ref on target_node, are gone already.
+		 */
+		if (t->buffer)
+			binder_free_buf(target_proc, t->buffer);
+		binder_proc_dec_tmpref(target_proc);
+		return_error = BR_DEAD_REPLY;
+		goto err_dead_target;
+	}
+	binder_proc_dec_tmpref(target_proc);
+
 	if (t->buffer == NULL) {
+		if (target_node)
+			binder_dec_node(target_node, 1, 0);
 		return_error = BR_FAILED_REPLY;
 		goto err_binder_alloc_buf_failed;
 	}
-	if (secctx) {
-		size_t buf_offset = ALIGN(tr->data_size, sizeof(void *)) +
-				    ALIGN(tr->offsets_size, sizeof(void *)) +
-				    ALIGN(extra_buffers_size, sizeof(void *)) -
-				    ALIGN(secctx_sz, sizeof(u64));
-		char *kptr = t->buffer->data + buf_offset;
-
-		t->security_ctx = (binder_uintptr_t)(
-				(uintptr_t)kptr +
-				target_proc->user_buffer_offset);
-		memcpy(kptr, secctx, secctx_sz);
-		security_release_secctx(secctx, secctx_sz);
-		secctx = NULL;
-	}
-	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
-	t->buffer->target_node = target_node;
 	trace_binder_transaction_alloc_buf(t->buffer);
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
 	off_start = (binder_size_t *)(t->buffer->data +
 				      ALIGN(tr->data_size, sizeof(void *)));
 	offp = off_start;
 
-	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
-			   tr->data.ptr.buffer, tr->data_size)) {
-		binder_user_error("%d:%d got transaction with invalid data ptr\n",
-				proc->pid, thread->pid);
+	if (copy_failed) {
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, (const void __user *)(uintptr_t)
-			   tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
-				proc->pid, thread->pid);
-		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+
+	/* the threads we picked may have exited while we were unlocked */
+	if (reply) {
+		target_thread = in_reply_to->from;
+		if (target_thread == NULL) {
+			return_error = BR_DEAD_REPLY;
+			goto err_copy_data_failed;
+		}
+		if (target_thread->transaction_stack != in_reply_to) {
+			binder_user_error("%d:%d got reply transaction with bad target transaction stack %d, expected %d\n",
+				proc->pid, thread->pid,
+				target_thread->transaction_stack ?
+				target_thread->transaction_stack->debug_id : 0,
+				in_reply_to->debug_id);
+			return_error = BR_FAILED_REPLY;
+			in_reply_to = NULL;
+			target_thread = NULL;
+			goto err_copy_data_failed;
+		}
+	} else if (target_thread) {
+		target_thread = binder_stack_target_thread(thread, target_proc);
+	}
+	t->to_thread = target_thread;
+	if (target_thread) {
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
 	}
+
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(binder_size_t))) {
 		binder_user_error("%d:%d got transaction with invalid offsets size, %lld\n",
 				proc->pid, thread->pid, (u64)tr->offsets_size);
@@ -2246,6 +2863,7 @@ static void binder_transaction(struct binder_proc *proc,
 	}
 	if (reply) {
 		BUG_ON(t->buffer->async_transaction != 0);
+		binder_transaction_replied(thread, target_thread, in_reply_to);
 		binder_pop_transaction(target_thread, in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -2287,11 +2905,13 @@ err_copy_data_failed:
 	t->buffer->transaction = NULL;
 	binder_free_buf(target_proc, t->buffer);
 err_binder_alloc_buf_failed:
+err_dead_target:
 err_bad_extra_size:
 	if (secctx)
 		security_release_secctx(secctx, secctx_sz);
 err_get_secctx_failed:
-	kfree(tcomplete);
+	if (tcomplete != &thread->tcomplete)
+		kfree(tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 err_alloc_tcomplete_failed:
 	kfree(t);
@@ -2783,7 +3403,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(to_binder_proc_ext(proc)->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2842,8 +3462,12 @@ retry:
 				     "%d:%d BR_TRANSACTION_COMPLETE\n",
 				     proc->pid, thread->pid);
 
-			list_del(&w->entry);
-			kfree(w);
+			if (w == &thread->tcomplete) {
+				list_del_init(&w->entry);
+			} else {
+				list_del(&w->entry);
+				kfree(w);
+			}
 			binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 		} break;
 		case BINDER_WORK_NODE: {
@@ -2957,13 +3581,7 @@ retry:
 
 			trd->target.ptr = target_node->ptr;
 			trd->cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			trd->target.ptr = 0;
@@ -3010,6 +3628,7 @@ retry:
 		ptr += trsize;
 
 		trace_binder_transaction_received(t);
+		binder_transaction_dequeued(thread, t);
 		binder_stat_br(proc, thread, cmd);
 		binder_debug(BINDER_DEBUG_TRANSACTION,
 			     "%d:%d %s %d %d:%d, cmd %d size %zd-%zd ptr %016llx-%016llx\n",
@@ -3131,6 +3750,8 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 		thread->pid = current->pid;
 		init_waitqueue_head(&thread->wait);
 		INIT_LIST_HEAD(&thread->todo);
+		INIT_LIST_HEAD(&thread->tcomplete.entry);
+		thread->tcomplete.type = BINDER_WORK_TRANSACTION_COMPLETE;
 		rb_link_node(&thread->rb_node, parent, p);
 		rb_insert_color(&thread->rb_node, &proc->threads);
 		thread->looper |= BINDER_LOOPER_STATE_NEED_RETURN;
@@ -3175,6 +3796,10 @@ static int binder_free_thread(struct binder_proc *proc,
 	}
 	if (send_reply)
 		binder_send_failed_reply(send_reply, BR_DEAD_REPLY);
+	if (!list_empty(&thread->tcomplete.entry)) {
+		list_del_init(&thread->tcomplete.entry);
+		binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
+	}
 	binder_release_work(&thread->todo);
 	kfree(thread);
 	binder_stats_deleted(BINDER_STAT_THREAD);
@@ -3422,8 +4047,10 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	int ret;
 	struct vm_struct *area;
 	struct binder_proc *proc = filp->private_data;
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
 	const char *failure_string;
 	struct binder_buffer *buffer;
+	int i;
 
 	if (proc->tsk != current->group_leader)
 		return -EINVAL;
@@ -3475,6 +4102,14 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 		failure_string = "alloc page array";
 		goto err_alloc_pages_failed;
 	}
+	eproc->page_lru = kmalloc(sizeof(eproc->page_lru[0]) * ((vma->vm_end - vma->vm_start) / PAGE_SIZE), GFP_KERNEL);
+	if (eproc->page_lru == NULL) {
+		ret = -ENOMEM;
+		failure_string = "alloc page lru";
+		goto err_alloc_page_lru_failed;
+	}
+	for (i = 0; i < (vma->vm_end - vma->vm_start) / PAGE_SIZE; i++)
+		INIT_LIST_HEAD(&eproc->page_lru[i]);
 	proc->buffer_size = vma->vm_end - vma->vm_start;
 
 	vma->vm_ops = &binder_vm_ops;
@@ -3501,6 +4136,18 @@ static int binder_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 
 err_alloc_small_buf_failed:
+	for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+		if (!proc->pages[i])
+			continue;
+		unmap_kernel_range((unsigned long)proc->buffer + i * PAGE_SIZE,
+				   PAGE_SIZE);
+		__free_page(proc->pages[i]);
+	}
+	INIT_LIST_HEAD(&eproc->cached_pages);
+	eproc->nr_cached_pages = 0;
+	kfree(eproc->page_lru);
+	eproc->page_lru = NULL;
+err_alloc_page_lru_failed:
 	kfree(proc->pages);
 	proc->pages = NULL;
 err_alloc_pages_failed:
@@ -3532,9 +4179,18 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	get_task_struct(current->group_leader);
 	proc->tsk = current->group_leader;
 	eproc->cred = get_cred(filp->f_cred);
+	mutex_init(&eproc->alloc_lock);
+	INIT_LIST_HEAD(&eproc->cached_pages);
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
 	proc->default_priority = task_nice(current);
+	if (binder_supported_policy(current->policy)) {
+		eproc->default_priority.sched_policy = current->policy;
+		eproc->default_priority.prio = current->normal_prio;
+	} else {
+		eproc->default_priority.sched_policy = SCHED_NORMAL;
+		eproc->default_priority.prio = BINDER_NICE_TO_PRIO(0);
+	}
 	binder_dev = container_of(filp->private_data, struct binder_device,
 				  miscdev);
 	proc->context = &binder_dev->context;
@@ -3607,12 +4263,13 @@ static int binder_release(struct inode *nodp, struct file *filp)
 
 static void binder_deferred_release(struct binder_proc *proc)
 {
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
 	struct hlist_node *pos;
 	struct binder_transaction *t;
 	struct binder_context *context = proc->context;
 	struct rb_node *n;
-	int threads, nodes, incoming_refs, outgoing_refs, buffers,
-		active_transactions, page_count;
+	int threads, nodes, incoming_refs, outgoing_refs,
+		active_transactions;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
@@ -3689,8 +4346,8 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_release_work(&proc->todo);
 	binder_release_work(&proc->delivered_death);
 
-	buffers = 0;
-	while ((n = rb_first(&proc->allocated_buffers))) {
+	mutex_lock(&eproc->alloc_lock);
+	for (n = rb_first(&proc->allocated_buffers); n; n = rb_next(n)) {
 		struct binder_buffer *buffer;
 
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
@@ -3703,43 +4360,21 @@ static void binder_deferred_release(struct binder_proc *proc)
 			       proc->pid, t->debug_id);
 			/*BUG();*/
 		}
-
-		binder_free_buf(proc, buffer);
-		buffers++;
-	}
-
-	binder_stats_deleted(BINDER_STAT_PROC);
-
-	page_count = 0;
-	if (proc->pages) {
-		int i;
-
-		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			void *page_addr;
-
-			if (!proc->pages[i])
-				continue;
-
-			page_addr = proc->buffer + i * PAGE_SIZE;
-			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-				     "%s: %d: page %d at %pK not freed\n",
-				     __func__, proc->pid, i, page_addr);
-			unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
-			__free_page(proc->pages[i]);
-			page_count++;
-		}
-		kfree(proc->pages);
-		vfree(proc->buffer);
 	}
-
-	put_task_struct(proc->tsk);
+	mutex_unlock(&eproc->alloc_lock);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
-		     "%s: %d threads %d, nodes %d (ref %d), refs %d, active transactions %d, buffers %d, pages %d\n",
+		     "%s: %d threads %d, nodes %d (ref %d), refs %d, active transactions %d\n",
 		     __func__, proc->pid, threads, nodes, incoming_refs,
-		     outgoing_refs, active_transactions, buffers, page_count);
+		     outgoing_refs, active_transactions);
 
-	kfree(proc);
+	/*
+	 * Senders still copying into our buffers free what is left when
+	 * they drop their tmp ref.
+	 */
+	eproc->is_dead = true;
+	if (!eproc->tmp_ref)
+		binder_free_proc(proc);
 }
 
 static void binder_deferred_func(struct work_struct *work)
@@ -3774,7 +4409,7 @@ static void binder_deferred_func(struct work_struct *work)
 			binder_deferred_flush(proc);
 
 		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); /* frees proc */
+			binder_deferred_release(proc); /* may free proc */
 
 		binder_unlock(__func__);
 		if (files)
@@ -3800,13 +4435,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %pK from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %pK from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3959,9 +4595,11 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&to_binder_proc_ext(proc)->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&to_binder_proc_ext(proc)->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -4094,8 +4732,10 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	mutex_lock(&to_binder_proc_ext(proc)->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	mutex_unlock(&to_binder_proc_ext(proc)->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
 
 	count = 0;
@@ -4175,6 +4815,100 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static void print_binder_latency_stats(struct seq_file *m, const char *prefix,
+				       struct binder_latency_stats *lat)
+{
+	int i;
+
+	for (i = 0; i < BINDER_LATENCY_BUCKETS; i++)
+		if (lat->queue[i] || lat->reply[i] || lat->total[i])
+			break;
+	if (i == BINDER_LATENCY_BUCKETS)
+		return;
+
+	seq_printf(m, "%s\n", prefix);
+	seq_printf(m, "    %-16s %10s %10s %10s\n",
+		   "usecs", "queue", "reply", "total");
+	for (i = 0; i < BINDER_LATENCY_BUCKETS; i++) {
+		char range[24];
+
+		if (!lat->queue[i] && !lat->reply[i] && !lat->total[i])
+			continue;
+		if (i == 0)
+			snprintf(range, sizeof(range), "0-1");
+		else if (i == BINDER_LATENCY_BUCKETS - 1)
+			snprintf(range, sizeof(range), "%lu+", 1UL << (i - 1));
+		else
+			snprintf(range, sizeof(range), "%lu-%lu",
+				 1UL << (i - 1), 1UL << i);
+		seq_printf(m, "    %-16s %10u %10u %10u\n", range,
+			   lat->queue[i], lat->reply[i], lat->total[i]);
+	}
+}
+
+static void print_binder_proc_latency(struct seq_file *m,
+				      struct binder_proc *proc)
+{
+	struct rb_node *n;
+	char prefix[32];
+
+	seq_puts(m, "binder proc latency:\n");
+	snprintf(prefix, sizeof(prefix), "  proc %d", proc->pid);
+	print_binder_latency_stats(m, prefix,
+				   &to_binder_proc_ext(proc)->latency);
+	for (n = rb_first(&proc->threads); n != NULL; n = rb_next(n)) {
+		struct binder_thread *thread = rb_entry(n, struct binder_thread,
+							rb_node);
+
+		snprintf(prefix, sizeof(prefix), "  thread %d", thread->pid);
+		print_binder_latency_stats(m, prefix, &thread->latency);
+	}
+}
+
+static void print_binder_proc_alloc(struct seq_file *m,
+				    struct binder_proc *proc)
+{
+	struct binder_proc_ext *eproc = to_binder_proc_ext(proc);
+	size_t free_size = 0, largest_free = 0, allocated_size = 0;
+	int free_count = 0, allocated_count = 0, mapped_pages = 0;
+	struct rb_node *n;
+	int i;
+
+	mutex_lock(&eproc->alloc_lock);
+	if (!proc->buffer)
+		goto out;
+	for (n = rb_first(&proc->free_buffers); n != NULL; n = rb_next(n)) {
+		size_t size = binder_buffer_size(proc, rb_entry(n,
+					struct binder_buffer, rb_node));
+
+		free_count++;
+		free_size += size;
+		largest_free = max(largest_free, size);
+	}
+	for (n = rb_first(&proc->allocated_buffers); n != NULL;
+	     n = rb_next(n)) {
+		allocated_count++;
+		allocated_size += binder_buffer_size(proc, rb_entry(n,
+					struct binder_buffer, rb_node));
+	}
+	for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++)
+		if (proc->pages[i])
+			mapped_pages++;
+
+	seq_puts(m, "binder proc alloc:\n");
+	seq_printf(m, "  free: %d buffers, %zd bytes, largest %zd\n",
+		   free_count, free_size, largest_free);
+	seq_printf(m, "  allocated: %d buffers, %zd bytes\n",
+		   allocated_count, allocated_size);
+	seq_printf(m, "  pages: %d mapped, %d cached, of %d\n",
+		   mapped_pages, eproc->nr_cached_pages,
+		   (int)(proc->buffer_size / PAGE_SIZE));
+	seq_printf(m, "  page ranges: %lu already mapped, %lu mapped\n",
+		   eproc->page_range_hits, eproc->page_range_misses);
+out:
+	mutex_unlock(&eproc->alloc_lock);
+}
+
 static int binder_proc_show(struct seq_file *m, void *unused)
 {
 	struct binder_proc *itr;
@@ -4189,6 +4923,8 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 		if (itr->pid == pid) {
 			seq_puts(m, "binder proc state:\n");
 			print_binder_proc(m, itr, 1);
+			print_binder_proc_latency(m, itr);
+			print_binder_proc_alloc(m, itr);
 		}
 	}
 	if (do_lock)
@@ -144,6 +144,42 @@ TRACE_EVENT(binder_transaction_received,
 	TP_printk("transaction=%d", __entry->debug_id)
 );
 
+TRACE_EVENT(binder_transaction_slow,
+	TP_PROTO(struct binder_transaction *t, struct binder_thread *thread,
+		 s64 queue_us, s64 reply_us, s64 total_us),
+	TP_ARGS(t, thread, queue_us, reply_us, total_us),
+
+	TP_STRUCT__entry(
+		__field(int, debug_id)
+		__field(int, from_proc)
+		__field(int, from_thread)
+		__field(int, to_proc)
+		__field(int, to_thread)
+		__field(unsigned int, code)
+		__field(unsigned int, flags)
+		__field(s64, queue_us)
+		__field(s64, reply_us)
+		__field(s64, total_us)
+	),
+	TP_fast_assign(
+		__entry->debug_id = t->debug_id;
+		__entry->from_proc = t->from ? t->from->proc->pid : 0;
+		__entry->from_thread = t->from ? t->from->pid : 0;
+		__entry->to_proc = thread->proc->pid;
+		__entry->to_thread = thread->pid;
+		__entry->code = t->code;
+		__entry->flags = t->flags;
+		__entry->queue_us = queue_us;
+		__entry->reply_us = reply_us;
+		__entry->total_us = total_us;
+	),
+	TP_printk("transaction=%d from %d:%d to %d:%d code=0x%x flags=0x%x queue_us=%lld reply_us=%lld total_us=%lld",
+		  __entry->debug_id, __entry->from_proc, __entry->from_thread,
+		  __entry->to_proc, __entry->to_thread, __entry->code,
+		  __entry->flags, __entry->queue_us, __entry->reply_us,
+		  __entry->total_us)
+);
+
 TRACE_EVENT(binder_transaction_node_to_ref,
 	TP_PROTO(struct binder_transaction *t, struct binder_node *node,
 		 struct binder_ref *ref),
@@ -46,6 +46,13 @@
 #include <linux/fs.h>
 #include <linux/cpuset.h>
 #include <linux/zcache.h>
+#include <linux/vmpressure.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+#include <linux/msm_kgsl.h>
+
+#define CREATE_TRACE_POINTS
+#include "lowmemorykiller_trace.h"
 
 #ifdef CONFIG_HIGHMEM
 #define _ZONE ZONE_HIGHMEM
@@ -69,6 +76,11 @@ static int lowmem_minfree[6] = {
 };
 static int lowmem_minfree_size = 4;
 static int lmk_fast_run = 1;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_VMPRESSURE
+static int lmk_vmpressure;
+#else
+#define lmk_vmpressure 0
+#endif
 
 static unsigned long lowmem_deathpending_timeout;
 
@@ -96,6 +108,115 @@ static int test_task_flag(struct task_struct *p, int flag)
 
 static DEFINE_MUTEX(scan_mutex);
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+/*
+ * Thread group leaders, highest oom_score_adj leftmost. Nests inside
+ * tasklist_lock and outside task_lock().
+ */
+static DEFINE_SPINLOCK(lmk_adj_lock);
+static struct rb_root lmk_adj_tree = RB_ROOT;
+
+static void __lmk_adj_tree_insert(struct task_struct *p)
+{
+	struct rb_node **link = &lmk_adj_tree.rb_node;
+	struct rb_node *parent = NULL;
+	int adj = p->signal->oom_score_adj;
+
+	while (*link) {
+		struct task_struct *entry;
+
+		parent = *link;
+		entry = rb_entry(parent, struct task_struct, adj_node);
+		if (adj > entry->signal->oom_score_adj)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+
+	rb_link_node(&p->adj_node, parent, link);
+	rb_insert_color(&p->adj_node, &lmk_adj_tree);
+}
+
+void lmk_adj_tree_add(struct task_struct *p)
+{
+	if (p->flags & PF_KTHREAD)
+		return;
+
+	spin_lock(&lmk_adj_lock);
+	__lmk_adj_tree_insert(p);
+	spin_unlock(&lmk_adj_lock);
+}
+
+void lmk_adj_tree_del(struct task_struct *p)
+{
+	spin_lock(&lmk_adj_lock);
+	if (!RB_EMPTY_NODE(&p->adj_node)) {
+		rb_erase(&p->adj_node, &lmk_adj_tree);
+		RB_CLEAR_NODE(&p->adj_node);
+	}
+	spin_unlock(&lmk_adj_lock);
+}
+
+/* a non-leader exec()ed and takes over as thread group leader */
+void lmk_adj_tree_replace(struct task_struct *old, struct task_struct *new)
+{
+	spin_lock(&lmk_adj_lock);
+	if (!RB_EMPTY_NODE(&old->adj_node)) {
+		rb_replace_node(&old->adj_node, &new->adj_node, &lmk_adj_tree);
+		RB_CLEAR_NODE(&old->adj_node);
+	}
+	spin_unlock(&lmk_adj_lock);
+}
+
+/* re-sort the thread group of @p after its oom_score_adj changed */
+void lmk_adj_tree_update(struct task_struct *p)
+{
+	struct task_struct *leader;
+
+	rcu_read_lock();
+	spin_lock(&lmk_adj_lock);
+	leader = p->group_leader;
+	if (!RB_EMPTY_NODE(&leader->adj_node)) {
+		rb_erase(&leader->adj_node, &lmk_adj_tree);
+		__lmk_adj_tree_insert(leader);
+	}
+	spin_unlock(&lmk_adj_lock);
+	rcu_read_unlock();
+}
+
+static struct task_struct *lowmem_next_candidate(struct rb_node *node)
+{
+	return node ? rb_entry(node, struct task_struct, adj_node) : NULL;
+}
+
+/* candidates come in decreasing oom_score_adj order */
+#define for_each_lowmem_candidate(p)					\
+	for (p = lowmem_next_candidate(rb_first(&lmk_adj_tree)); p;	\
+	     p = lowmem_next_candidate(rb_next(&p->adj_node)))
+#define lowmem_candidates_sorted	1
+
+static void lowmem_candidates_lock(void)
+{
+	spin_lock(&lmk_adj_lock);
+}
+
+static void lowmem_candidates_unlock(void)
+{
+	spin_unlock(&lmk_adj_lock);
+}
+#else
+#define for_each_lowmem_candidate(p)	for_each_process(p)
+#define lowmem_candidates_sorted	0
+
+static inline void lowmem_candidates_lock(void)
+{
+}
+
+static inline void lowmem_candidates_unlock(void)
+{
+}
+#endif
+
 int can_use_cma_pages(gfp_t gfp_mask)
 {
 	int can_use = 0;
@@ -265,7 +386,13 @@ void tune_lmk_param(int *other_free, int *other_file, struct shrink_control *sc)
 	}
 }
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Kill at most one process if memory is below one of the minfree levels.
+ * With @critical set, the file cache is not counted as free memory.
+ * Returns the number of pages on the LRU lists, as lowmem_shrink() does.
+ */
+static int lowmem_scan(struct shrink_control *sc, unsigned long nr_to_scan,
+		       bool critical)
 {
 	struct task_struct *tsk;
 	struct task_struct *selected = NULL;
@@ -279,7 +406,8 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free;
 	int other_file;
-	unsigned long nr_to_scan = sc->nr_to_scan;
+	unsigned int nr_scanned = 0;
+	ktime_t scan_start;
 
 	if (nr_to_scan > 0) {
 		if (mutex_lock_interruptible(&scan_mutex) < 0)
@@ -304,7 +432,8 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		array_size = lowmem_minfree_size;
 	for (i = 0; i < array_size; i++) {
 		minfree = lowmem_minfree[i];
-		if (other_free < minfree && other_file < minfree) {
+		if (other_free < minfree &&
+		    (other_file < minfree || critical)) {
 			min_score_adj = lowmem_adj[i];
 			break;
 		}
@@ -328,11 +457,14 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	}
 	selected_oom_score_adj = min_score_adj;
 
+	scan_start = ktime_get();
 	rcu_read_lock();
-	for_each_process(tsk) {
+	lowmem_candidates_lock();
+	for_each_lowmem_candidate(tsk) {
 		struct task_struct *p;
 		int oom_score_adj;
 
+		nr_scanned++;
 		if (tsk->flags & PF_KTHREAD)
 			continue;
 
@@ -342,6 +474,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 
 		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
 			if (test_task_flag(tsk, TIF_MEMDIE)) {
+				lowmem_candidates_unlock();
 				rcu_read_unlock();
 				/* give the system time to free up the memory */
 				msleep_interruptible(20);
@@ -357,15 +490,21 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		oom_score_adj = p->signal->oom_score_adj;
 		if (oom_score_adj < min_score_adj) {
 			task_unlock(p);
+			if (lowmem_candidates_sorted)
+				break;
 			continue;
 		}
-		tasksize = get_mm_rss(p->mm);
+		/* GPU memory goes away with the process too */
+		tasksize = get_mm_rss(p->mm) + kgsl_process_mem_pages(p->tgid);
 		task_unlock(p);
 		if (tasksize <= 0)
 			continue;
 		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
+			if (oom_score_adj < selected_oom_score_adj) {
+				if (lowmem_candidates_sorted)
+					break;
 				continue;
+			}
 			if (oom_score_adj == selected_oom_score_adj &&
 			    tasksize <= selected_tasksize)
 				continue;
@@ -376,6 +515,11 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		lowmem_print(2, "select '%s' (%d), adj %d, size %d, to kill\n",
 			     p->comm, p->pid, oom_score_adj, tasksize);
 	}
+	/* selected stays valid under rcu_read_lock() */
+	lowmem_candidates_unlock();
+	trace_lowmemory_scan(min_score_adj, nr_scanned,
+			     ktime_to_ns(ktime_sub(ktime_get(), scan_start)));
+
 	if (selected) {
 		lowmem_print(1, "Killing '%s' (%d), adj %d,\n" \
 				"   to free %ldkB on behalf of '%s' (%d) because\n" \
@@ -421,19 +565,71 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	return rem;
 }
 
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	/* in vmpressure mode kills are left to lowmem_vmpressure_notify() */
+	return lowmem_scan(sc, lmk_vmpressure ? 0 : sc->nr_to_scan, false);
+}
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_VMPRESSURE
+static int lowmem_vmpressure_notify(struct notifier_block *nb,
+				    unsigned long level, void *data)
+{
+	struct shrink_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.nr_to_scan = 1,
+	};
+
+	if (!lmk_vmpressure || level < VMPRESSURE_MEDIUM)
+		return NOTIFY_DONE;
+
+	/* one event, one kill: let the last victim exit first */
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout))
+		return NOTIFY_DONE;
+
+	lowmem_print(3, "vmpressure level %lu\n", level);
+	lowmem_scan(&sc, sc.nr_to_scan, level == VMPRESSURE_CRITICAL);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call = lowmem_vmpressure_notify,
+};
+
+static void lowmem_vmpressure_register(void)
+{
+	vmpressure_register_notifier(&lowmem_vmpressure_nb);
+}
+
+static void lowmem_vmpressure_unregister(void)
+{
+	vmpressure_unregister_notifier(&lowmem_vmpressure_nb);
+}
+#else
+static inline void lowmem_vmpressure_register(void)
+{
+}
+static inline void lowmem_vmpressure_unregister(void)
+{
+}
+#endif
+
 static int __init lowmem_init(void)
 {
 	register_shrinker(&lowmem_shrinker);
+	lowmem_vmpressure_register();
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+	lowmem_vmpressure_unregister();
 	unregister_shrinker(&lowmem_shrinker);
 }
 
@@ -529,6 +725,9 @@ module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 module_param_named(lmk_fast_run, lmk_fast_run, int, S_IRUGO | S_IWUSR);
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_VMPRESSURE
+module_param_named(vmpressure, lmk_vmpressure, int, S_IRUGO | S_IWUSR);
+#endif
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
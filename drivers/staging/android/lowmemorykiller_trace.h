@@ -0,0 +1,56 @@
+/*
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_LOWMEMORYKILLER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _LOWMEMORYKILLER_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/log2.h>
+
+/*
+ * One event per victim search. usecs_log2 is the histogram bucket of
+ * the scan time: bucket n holds scans of [2^n, 2^(n+1)) microseconds.
+ */
+TRACE_EVENT(lowmemory_scan,
+	TP_PROTO(int min_score_adj, unsigned int nr_scanned, u64 duration_ns),
+	TP_ARGS(min_score_adj, nr_scanned, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(int, min_score_adj)
+		__field(unsigned int, nr_scanned)
+		__field(u64, duration_ns)
+		__field(unsigned int, usecs_log2)
+	),
+	TP_fast_assign(
+		u64 usecs = div_u64(duration_ns, NSEC_PER_USEC);
+
+		__entry->min_score_adj = min_score_adj;
+		__entry->nr_scanned = nr_scanned;
+		__entry->duration_ns = duration_ns;
+		__entry->usecs_log2 = usecs ? ilog2(usecs) : 0;
+	),
+	TP_printk("min_score_adj=%d nr_scanned=%u duration_ns=%llu usecs_log2=%u",
+		  __entry->min_score_adj, __entry->nr_scanned,
+		  (unsigned long long)__entry->duration_ns,
+		  __entry->usecs_log2)
+);
+
+#endif /* _LOWMEMORYKILLER_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_PATH .
+#define TRACE_INCLUDE_FILE lowmemorykiller_trace
+#include <trace/define_trace.h>
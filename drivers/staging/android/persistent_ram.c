@@ -19,7 +19,9 @@
 #include <linux/init.h>
 #include <linux/io.h>
 #include <linux/list.h>
+#include <linux/lz4.h>
 #include <linux/memblock.h>
+#include <linux/mm.h>
 #include <linux/persistent_ram.h>
 #include <linux/rslib.h>
 #include <linux/slab.h>
@@ -34,6 +36,27 @@ struct persistent_ram_buffer {
 
 #define PERSISTENT_RAM_SIG (0x43474244) /* DBGC */
 
+/*
+ * Compressed zones collect writes in a block kept at the end of the zone,
+ * outside of the ring.  When the block is full it is lz4 compressed into a
+ * record in the ring, so the ring holds several times more text.  The
+ * block itself is not covered by ECC.
+ */
+#define PERSISTENT_RAM_BLOCK_SIZE	4096
+#define PERSISTENT_RAM_LZ4_SIG		0x5a4c	/* LZ */
+#define PERSISTENT_RAM_RAW_SIG		0x5752	/* RW */
+
+struct persistent_ram_block {
+	uint32_t    len;
+	uint8_t     data[PERSISTENT_RAM_BLOCK_SIZE];
+};
+
+struct persistent_ram_record {
+	uint16_t    sig;
+	uint16_t    len;
+	uint8_t     data[0];
+};
+
 static __devinitdata LIST_HEAD(persistent_ram_list);
 
 static inline size_t buffer_size(struct persistent_ram_zone *prz)
@@ -270,18 +293,18 @@ persistent_ram_save_old(struct persistent_ram_zone *prz)
 	prz->old_log_size = size;
 	memcpy(prz->old_log, &buffer->data[start], size - start);
 	memcpy(prz->old_log + size - start, &buffer->data[0], start);
+
+	if (prz->block)
+		persistent_ram_decompress_old(prz);
 }
 
-int notrace persistent_ram_write(struct persistent_ram_zone *prz,
+static int notrace persistent_ram_write_ring(struct persistent_ram_zone *prz,
 	const void *s, unsigned int count)
 {
 	int rem;
 	int c = count;
 	size_t start;
 
-	if (unlikely(prz->buffer->sig != PERSISTENT_RAM_SIG))
-		return -EINVAL;
-
 	if (unlikely(c > prz->buffer_size)) {
 		s += c - prz->buffer_size;
 		c = prz->buffer_size;
@@ -305,6 +328,183 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 	return count;
 }
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_COMPRESS
+static void notrace persistent_ram_flush_block(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_record *rec = prz->record;
+	struct persistent_ram_block *block = prz->block;
+	size_t len;
+
+	if (lz4_compress(prz->block_data, block->len, rec->data, &len,
+			 prz->lz4_wrkmem) || len >= block->len) {
+		rec->sig = PERSISTENT_RAM_RAW_SIG;
+		len = block->len;
+		memcpy(rec->data, prz->block_data, len);
+	} else {
+		rec->sig = PERSISTENT_RAM_LZ4_SIG;
+	}
+	rec->len = len;
+
+	persistent_ram_write_ring(prz, rec, sizeof(*rec) + len);
+	block->len = 0;
+}
+
+/*
+ * The block is also kept in normal memory so lz4 doesn't have to read the
+ * uncached mapping.  Callers of a compressed zone serialize their writes.
+ */
+static int notrace persistent_ram_write_block(struct persistent_ram_zone *prz,
+	const void *s, unsigned int count)
+{
+	struct persistent_ram_block *block = prz->block;
+	unsigned int c = count;
+	unsigned int n;
+
+	while (c) {
+		n = min_t(unsigned int, c,
+			  PERSISTENT_RAM_BLOCK_SIZE - block->len);
+		memcpy(block->data + block->len, s, n);
+		memcpy(prz->block_data + block->len, s, n);
+		block->len += n;
+		s += n;
+		c -= n;
+
+		if (block->len == PERSISTENT_RAM_BLOCK_SIZE)
+			persistent_ram_flush_block(prz);
+	}
+
+	return count;
+}
+
+static bool __devinit persistent_ram_decode_record(const uint8_t *p,
+	size_t avail, uint8_t *dest, size_t *used)
+{
+	struct persistent_ram_record rec;
+	size_t len = PERSISTENT_RAM_BLOCK_SIZE;
+
+	if (avail < sizeof(rec))
+		return false;
+	memcpy(&rec, p, sizeof(rec));
+	if (rec.len > avail - sizeof(rec))
+		return false;
+
+	p += sizeof(rec);
+	if (rec.sig == PERSISTENT_RAM_RAW_SIG) {
+		if (rec.len != PERSISTENT_RAM_BLOCK_SIZE)
+			return false;
+		memcpy(dest, p, rec.len);
+	} else if (rec.sig == PERSISTENT_RAM_LZ4_SIG) {
+		if (lz4_decompress_unknownoutputsize(p, rec.len, dest, &len) ||
+		    len != PERSISTENT_RAM_BLOCK_SIZE)
+			return false;
+	} else {
+		return false;
+	}
+
+	*used = sizeof(rec) + rec.len;
+	return true;
+}
+
+/*
+ * Replace the saved ring of a compressed zone with the text it holds.  The
+ * oldest record was likely overwritten in part, so records are searched
+ * for and only the ones that decode to a full block are kept.
+ */
+static void __devinit
+persistent_ram_decompress_old(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_block *block = prz->block;
+	size_t block_len = min_t(size_t, block->len, PERSISTENT_RAM_BLOCK_SIZE);
+	size_t size = prz->old_log_size;
+	size_t pos, used, n = 0;
+	uint8_t *old = (uint8_t *)prz->old_log;
+	uint8_t *dest;
+
+	for (pos = 0; pos < size; ) {
+		if (persistent_ram_decode_record(old + pos, size - pos,
+						 prz->block_data, &used)) {
+			n++;
+			pos += used;
+		} else {
+			pos++;
+		}
+	}
+
+	dest = vmalloc(n * PERSISTENT_RAM_BLOCK_SIZE + block_len);
+	if (dest == NULL) {
+		pr_err("persistent_ram: failed to allocate buffer\n");
+		return;
+	}
+
+	n = 0;
+	for (pos = 0; pos < size; ) {
+		if (persistent_ram_decode_record(old + pos, size - pos,
+				dest + n * PERSISTENT_RAM_BLOCK_SIZE, &used)) {
+			n++;
+			pos += used;
+		} else {
+			pos++;
+		}
+	}
+	memcpy(dest + n * PERSISTENT_RAM_BLOCK_SIZE, block->data, block_len);
+
+	kfree(old);
+	prz->old_log = (char *)dest;
+	prz->old_log_size = n * PERSISTENT_RAM_BLOCK_SIZE + block_len;
+}
+
+static int __devinit persistent_ram_init_block(struct persistent_ram_zone *prz)
+{
+	if (prz->buffer_size < 2 * sizeof(struct persistent_ram_block)) {
+		pr_err("persistent_ram: zone too small for compression\n");
+		return -EINVAL;
+	}
+
+	prz->block_data = kmalloc(PERSISTENT_RAM_BLOCK_SIZE, GFP_KERNEL);
+	prz->record = kmalloc(sizeof(struct persistent_ram_record) +
+		lz4_compressbound(PERSISTENT_RAM_BLOCK_SIZE), GFP_KERNEL);
+	prz->lz4_wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	if (!prz->block_data || !prz->record || !prz->lz4_wrkmem) {
+		kfree(prz->block_data);
+		kfree(prz->record);
+		kfree(prz->lz4_wrkmem);
+		return -ENOMEM;
+	}
+
+	prz->buffer_size -= sizeof(struct persistent_ram_block);
+	prz->block = (struct persistent_ram_block *)
+		(prz->buffer->data + prz->buffer_size);
+	return 0;
+}
+#else
+static inline int persistent_ram_write_block(struct persistent_ram_zone *prz,
+	const void *s, unsigned int count)
+{
+	return -EINVAL;
+}
+
+static inline void persistent_ram_decompress_old(struct persistent_ram_zone *prz)
+{
+}
+
+static inline int persistent_ram_init_block(struct persistent_ram_zone *prz)
+{
+	return -EINVAL;
+}
+#endif
+
+int notrace persistent_ram_write(struct persistent_ram_zone *prz,
+	const void *s, unsigned int count)
+{
+	if (unlikely(prz->buffer->sig != PERSISTENT_RAM_SIG))
+		return -EINVAL;
+
+	if (prz->block)
+		return persistent_ram_write_block(prz, s, count);
+
+	return persistent_ram_write_ring(prz, s, count);
+}
+
 size_t persistent_ram_old_size(struct persistent_ram_zone *prz)
 {
 	return prz->old_log_size;
@@ -317,7 +517,10 @@ void *persistent_ram_old(struct persistent_ram_zone *prz)
 
 void persistent_ram_free_old(struct persistent_ram_zone *prz)
 {
-	kfree(prz->old_log);
+	if (is_vmalloc_addr(prz->old_log))
+		vfree(prz->old_log);
+	else
+		kfree(prz->old_log);
 	prz->old_log = NULL;
 	prz->old_log_size = 0;
 }
@@ -360,8 +563,9 @@ static int persistent_ram_buffer_map(phys_addr_t start, phys_addr_t size,
 	return 0;
 }
 
-static int __devinit persistent_ram_buffer_init(const char *name,
-		struct persistent_ram_zone *prz, struct persistent_ram **ramp)
+static int __devinit persistent_ram_find_desc(const char *name,
+		phys_addr_t *startp, phys_addr_t *sizep,
+		struct persistent_ram **ramp)
 {
 	int i;
 	struct persistent_ram *ram;
@@ -374,8 +578,9 @@ static int __devinit persistent_ram_buffer_init(const char *name,
 			desc = &ram->descs[i];
 			if (!strcmp(desc->name, name)) {
 				*ramp = ram;
-				return persistent_ram_buffer_map(start,
-						desc->size, prz);
+				*startp = start;
+				*sizep = desc->size;
+				return 0;
 			}
 			start += desc->size;
 		}
@@ -385,9 +590,10 @@ static int __devinit persistent_ram_buffer_init(const char *name,
 }
 
 static  __devinit
-struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
+struct persistent_ram_zone *__persistent_ram_init(phys_addr_t start,
+		phys_addr_t size, struct persistent_ram *ram, bool ecc,
+		bool compress)
 {
-	struct persistent_ram *ram;
 	struct persistent_ram_zone *prz;
 	int ret = -ENOMEM;
 
@@ -399,7 +605,7 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 
 	INIT_LIST_HEAD(&prz->node);
 
-	ret = persistent_ram_buffer_init(dev_name(dev), prz, &ram);
+	ret = persistent_ram_buffer_map(start, size, prz);
 	if (ret) {
 		pr_err("persistent_ram: failed to initialize buffer\n");
 		goto err;
@@ -410,6 +616,12 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 	if (ret)
 		goto err;
 
+	if (compress) {
+		ret = persistent_ram_init_block(prz);
+		if (ret)
+			goto err;
+	}
+
 	if (prz->buffer->sig == PERSISTENT_RAM_SIG) {
 		if (buffer_size(prz) > prz->buffer_size ||
 		    buffer_start(prz) > buffer_size(prz))
@@ -430,6 +642,8 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 	prz->buffer->sig = PERSISTENT_RAM_SIG;
 	atomic_set(&prz->buffer->start, 0);
 	atomic_set(&prz->buffer->size, 0);
+	if (prz->block)
+		prz->block->len = 0;
 
 	return prz;
 err:
@@ -440,7 +654,83 @@ err:
 struct persistent_ram_zone * __devinit
 persistent_ram_init_ringbuffer(struct device *dev, bool ecc)
 {
-	return __persistent_ram_init(dev, ecc);
+	struct persistent_ram *ram;
+	phys_addr_t start, size;
+	int ret;
+
+	ret = persistent_ram_find_desc(dev_name(dev), &start, &size, &ram);
+	if (ret) {
+		pr_err("persistent_ram: failed to initialize buffer\n");
+		return ERR_PTR(ret);
+	}
+
+	return __persistent_ram_init(start, size, ram, ecc, false);
+}
+
+/**
+ * persistent_ram_init_compressed - Set up a compressed zone
+ * @dev: Device whose name is the name of the persistent ram descriptor
+ * @ecc: Whether to protect the ring with ECC
+ *
+ * Writes are collected in blocks that are lz4 compressed into the ring,
+ * and persistent_ram_old() returns the decompressed text of the last boot.
+ * Writers must be serialized by the caller.
+ */
+struct persistent_ram_zone * __devinit
+persistent_ram_init_compressed(struct device *dev, bool ecc)
+{
+	struct persistent_ram *ram;
+	phys_addr_t start, size;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_ANDROID_PERSISTENT_RAM_COMPRESS))
+		return persistent_ram_init_ringbuffer(dev, ecc);
+
+	ret = persistent_ram_find_desc(dev_name(dev), &start, &size, &ram);
+	if (ret) {
+		pr_err("persistent_ram: failed to initialize buffer\n");
+		return ERR_PTR(ret);
+	}
+
+	return __persistent_ram_init(start, size, ram, ecc, true);
+}
+
+/**
+ * persistent_ram_init_percpu - Split a descriptor into one zone per CPU
+ * @dev: Device whose name is the name of the persistent ram descriptor
+ * @ecc: Whether to protect the zones with ECC
+ * @przs: Array of @n zones to fill in
+ * @n: Number of zones, normally nr_cpu_ids
+ *
+ * Each zone has its own header and ring, so CPUs writing to their own zone
+ * never touch the same ring pointers.  @n must not change across reboots
+ * for the old contents to be found again.
+ */
+int __devinit persistent_ram_init_percpu(struct device *dev, bool ecc,
+		struct persistent_ram_zone **przs, int n)
+{
+	struct persistent_ram *ram;
+	phys_addr_t start, size;
+	int i, ret;
+
+	ret = persistent_ram_find_desc(dev_name(dev), &start, &size, &ram);
+	if (ret) {
+		pr_err("persistent_ram: failed to initialize buffer\n");
+		return ret;
+	}
+
+	size = (size / n) & ~7;
+	if (size <= sizeof(struct persistent_ram_buffer))
+		return -EINVAL;
+
+	for (i = 0; i < n; i++) {
+		przs[i] = __persistent_ram_init(start + i * size, size, ram,
+						ecc, false);
+		if (IS_ERR(przs[i]))
+			return PTR_ERR(przs[i]);
+	}
+
+	return 0;
 }
 
 int __init persistent_ram_early_init(struct persistent_ram *ram)
@@ -21,17 +21,24 @@
 #include <linux/platform_device.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/trace_clock.h>
 
 #include "../../../kernel/trace/trace.h"
 
+/*
+ * Each CPU writes its records into its own zone.  The timestamp is
+ * trace_clock_local() in microseconds, truncated to 32 bits, which is
+ * enough to interleave the CPUs of the last few minutes before a reset.
+ */
 struct persistent_trace_record {
 	unsigned long ip;
 	unsigned long parent_ip;
+	u32 time_us;
 };
 
 #define REC_SIZE sizeof(struct persistent_trace_record)
 
-static struct persistent_ram_zone *persistent_trace;
+static struct persistent_ram_zone *persistent_trace[NR_CPUS];
 
 static int persistent_trace_enabled;
 
@@ -101,8 +108,8 @@ static void persistent_trace_call(unsigned long ip, unsigned long parent_ip)
 	if (likely(disabled == 1)) {
 		rec.ip = ip;
 		rec.parent_ip = parent_ip;
-		rec.ip |= cpu;
-		persistent_ram_write(persistent_trace, &rec, sizeof(rec));
+		rec.time_us = (u32)(trace_clock_local() >> 10);
+		persistent_ram_write(persistent_trace[cpu], &rec, sizeof(rec));
 	}
 
 	atomic_dec(&data->disabled);
@@ -123,11 +130,33 @@ static struct tracer persistent_tracer __read_mostly = {
 };
 
 struct persistent_trace_seq_data {
+	int cpu;
 	const void *ptr;
 	size_t off;
 	size_t size;
 };
 
+/* Point @data at record @idx of the old records of the CPUs from @cpu on */
+static bool persistent_trace_seq_find(struct persistent_trace_seq_data *data,
+		int cpu, loff_t idx)
+{
+	size_t count;
+
+	for (; cpu < nr_cpu_ids; cpu++) {
+		data->ptr = persistent_ram_old(persistent_trace[cpu]);
+		data->size = persistent_ram_old_size(persistent_trace[cpu]);
+		count = data->size / REC_SIZE;
+		if (idx < count) {
+			data->cpu = cpu;
+			data->off = data->size % REC_SIZE + idx * REC_SIZE;
+			return true;
+		}
+		idx -= count;
+	}
+
+	return false;
+}
+
 void *persistent_trace_seq_start(struct seq_file *s, loff_t *pos)
 {
 	struct persistent_trace_seq_data *data;
@@ -136,13 +165,7 @@ void *persistent_trace_seq_start(struct seq_file *s, loff_t *pos)
 	if (!data)
 		return NULL;
 
-	data->ptr = persistent_ram_old(persistent_trace);
-	data->size = persistent_ram_old_size(persistent_trace);
-	data->off = data->size % REC_SIZE;
-
-	data->off += *pos * REC_SIZE;
-
-	if (data->off + REC_SIZE > data->size) {
+	if (!persistent_trace_seq_find(data, 0, *pos)) {
 		kfree(data);
 		return NULL;
 	}
@@ -159,13 +182,13 @@ void *persistent_trace_seq_next(struct seq_file *s, void *v, loff_t *pos)
 {
 	struct persistent_trace_seq_data *data = v;
 
+	(*pos)++;
 	data->off += REC_SIZE;
 
-	if (data->off + REC_SIZE > data->size)
+	if (data->off + REC_SIZE > data->size &&
+	    !persistent_trace_seq_find(data, data->cpu + 1, 0))
 		return NULL;
 
-	(*pos)++;
-
 	return data;
 }
 
@@ -176,8 +199,8 @@ int persistent_trace_seq_show(struct seq_file *s, void *v)
 
 	rec = (struct persistent_trace_record *)(data->ptr + data->off);
 
-	seq_printf(s, "%ld %08lx  %08lx  %pf <- %pF\n",
-		rec->ip & 3, rec->ip, rec->parent_ip,
+	seq_printf(s, "%d %10u %08lx  %08lx  %pf <- %pF\n",
+		data->cpu, rec->time_us, rec->ip, rec->parent_ip,
 		(void *)rec->ip, (void *)rec->parent_ip);
 
 	return 0;
@@ -205,20 +228,25 @@ static const struct file_operations persistent_trace_old_fops = {
 static int __devinit persistent_trace_probe(struct platform_device *pdev)
 {
 	struct dentry *d;
-	int ret;
-
-	persistent_trace = persistent_ram_init_ringbuffer(&pdev->dev, false);
-	if (IS_ERR(persistent_trace)) {
-		pr_err("persistent_trace: failed to init ringbuffer: %ld\n",
-				PTR_ERR(persistent_trace));
-		return PTR_ERR(persistent_trace);
+	size_t old_size = 0;
+	int cpu, ret;
+
+	ret = persistent_ram_init_percpu(&pdev->dev, false, persistent_trace,
+					 nr_cpu_ids);
+	if (ret) {
+		pr_err("persistent_trace: failed to init ringbuffers: %d\n",
+				ret);
+		return ret;
 	}
 
 	ret = register_tracer(&persistent_tracer);
 	if (ret)
 		pr_err("persistent_trace: failed to register tracer");
 
-	if (persistent_ram_old_size(persistent_trace) > 0) {
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++)
+		old_size += persistent_ram_old_size(persistent_trace[cpu]);
+
+	if (old_size > 0) {
 		d = debugfs_create_file("persistent_trace", S_IRUGO, NULL,
 			NULL, &persistent_trace_old_fops);
 		if (IS_ERR_OR_NULL(d))
@@ -37,9 +37,28 @@ enum {
 };
 
 enum {
+	/**
+	 * @FLAT_BINDER_FLAG_PRIORITY_MASK: minimum priority of the node
+	 *
+	 * Interpreted according to the scheduling policy below: a signed
+	 * nice value for SCHED_NORMAL and SCHED_BATCH, an RT priority
+	 * (1..99) for SCHED_FIFO and SCHED_RR.  Threads handling a call on
+	 * the node run at least at this priority, or at the caller's
+	 * priority if that is higher.
+	 */
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
 
+	/**
+	 * @FLAT_BINDER_FLAG_SCHED_POLICY_MASK: bits 9-10, minimum policy
+	 *
+	 * Holds SCHED_NORMAL, SCHED_FIFO, SCHED_RR or SCHED_BATCH, which
+	 * conveniently fit in two bits.
+	 */
+	FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT = 9,
+	FLAT_BINDER_FLAG_SCHED_POLICY_MASK =
+		3U << FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT,
+
 	/**
 	 * @FLAT_BINDER_FLAG_TXN_SECURITY_CTX: request security contexts
 	 *
@@ -1266,6 +1266,16 @@ typedef enum
 #define CFG_ENABLE_ROAM_DELAY_STATS_MAX              ( 1 )
 #define CFG_ENABLE_ROAM_DELAY_STATS_DEFAULT          ( 0 )
 
+/*
+ * Bitmask of the CPUs the VOSS RX thread may run on, 0 leaves it to the
+ * scheduler. Keeping it off the CPU taking the WCNSS interrupts leaves that
+ * CPU free for the stack processing of the delivered frames.
+ */
+#define CFG_RX_THREAD_CPU_AFFINITY_NAME              "gRxThreadCpuAffinity"
+#define CFG_RX_THREAD_CPU_AFFINITY_MIN               ( 0 )
+#define CFG_RX_THREAD_CPU_AFFINITY_MAX               ( 0xFF )
+#define CFG_RX_THREAD_CPU_AFFINITY_DEFAULT           ( 0 )
+
 #ifdef WLAN_FEATURE_NEIGHBOR_ROAMING
 #define CFG_NEIGHBOR_SCAN_TIMER_PERIOD_NAME             "gNeighborScanTimerPeriod"
 #define CFG_NEIGHBOR_SCAN_TIMER_PERIOD_MIN              (3)
@@ -2702,6 +2712,7 @@ typedef struct
 #endif
 
    v_BOOL_t      gEnableRoamDelayStats;
+   v_U32_t       rxThreadCpuAffinity;
 #ifdef WLAN_FEATURE_NEIGHBOR_ROAMING
    v_U16_t       nNeighborScanPeriod;
    v_U8_t        nNeighborReassocRssiThreshold;
@@ -1866,6 +1866,13 @@ REG_TABLE_ENTRY g_registry_table[] =
                  CFG_ENABLE_ROAM_DELAY_STATS_MIN,
                  CFG_ENABLE_ROAM_DELAY_STATS_MAX ),
 
+   REG_VARIABLE( CFG_RX_THREAD_CPU_AFFINITY_NAME, WLAN_PARAM_HexInteger,
+                 hdd_config_t, rxThreadCpuAffinity,
+                 VAR_FLAGS_OPTIONAL | VAR_FLAGS_RANGE_CHECK_ASSUME_DEFAULT,
+                 CFG_RX_THREAD_CPU_AFFINITY_DEFAULT,
+                 CFG_RX_THREAD_CPU_AFFINITY_MIN,
+                 CFG_RX_THREAD_CPU_AFFINITY_MAX ),
+
 #ifdef WLAN_FEATURE_NEIGHBOR_ROAMING
    REG_DYNAMIC_VARIABLE( CFG_NEIGHBOR_SCAN_TIMER_PERIOD_NAME, WLAN_PARAM_Integer,
                  hdd_config_t, nNeighborScanPeriod,
@@ -3767,6 +3774,7 @@ static void print_hdd_cfg(hdd_context_t *pHddCtx)
 #endif
 
   VOS_TRACE(VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_INFO_HIGH, "Name = [gEnableRoamDelayStats] Value = [%u] ",pHddCtx->cfg_ini->gEnableRoamDelayStats);
+  VOS_TRACE(VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_INFO_HIGH, "Name = [gRxThreadCpuAffinity] Value = [0x%x] ",pHddCtx->cfg_ini->rxThreadCpuAffinity);
 #ifdef WLAN_FEATURE_NEIGHBOR_ROAMING
   VOS_TRACE(VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_INFO_HIGH, "Name = [nNeighborReassocRssiThreshold] Value = [%u] ",pHddCtx->cfg_ini->nNeighborReassocRssiThreshold);
   VOS_TRACE(VOS_MODULE_ID_HDD, VOS_TRACE_LEVEL_INFO_HIGH, "Name = [nNeighborLookupRssiThreshold] Value = [%u] ",pHddCtx->cfg_ini->nNeighborLookupRssiThreshold);
@@ -9912,6 +9912,9 @@ int hdd_wlan_startup(struct device *dev )
       goto err_vos_nv_close;
    }
 
+   if (pHddCtx->cfg_ini->rxThreadCpuAffinity)
+      vos_sched_set_rx_thread_affinity(pHddCtx->cfg_ini->rxThreadCpuAffinity);
+
    pHddCtx->hHal = (tHalHandle)vos_get_context( VOS_MODULE_ID_SME, pVosContext );
 
    if ( NULL == pHddCtx->hHal )
@@ -2524,6 +2524,45 @@ VOS_STATUS  hdd_rx_packet_monitor_cbk(v_VOID_t *vosContext,vos_pkt_t *pVosPacket
 return status;
 }
 
+/**============================================================================
+  @brief hdd_rx_deliver_batch() - Hand a batch of received frames to the
+  network stack.
+
+  The frames are queued to the backlog with bottom halves disabled, so the
+  stack processes the whole batch in a single softirq run on the CPUs picked
+  by RPS, instead of running softirqs once per frame as netif_rx_ni() does.
+
+  @param pAdapter : [in] pointer to the adapter the frames were received on
+  @param rxq      : [in] queue of frames to deliver, empty on return
+
+  @return         : None
+  ===========================================================================*/
+static void hdd_rx_deliver_batch(hdd_adapter_t *pAdapter,
+                                 struct sk_buff_head *rxq)
+{
+   struct sk_buff *skb;
+   int rxstat;
+
+   if (skb_queue_empty(rxq))
+      return;
+
+   local_bh_disable();
+   while ((skb = __skb_dequeue(rxq)) != NULL)
+   {
+      rxstat = netif_rx(skb);
+      if (NET_RX_SUCCESS == rxstat)
+      {
+         ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
+         ++pAdapter->hdd_stats.hddTxRxStats.pkt_rx_count;
+      }
+      else
+      {
+         ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
+      }
+   }
+   local_bh_enable();
+}
+
 /**============================================================================
   @brief hdd_rx_packet_cbk() - Receive callback registered with TL.
   TL will call this to notify the HDD when one or more packets were
@@ -2545,8 +2584,8 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
    hdd_adapter_t *pAdapter = NULL;
    hdd_context_t *pHddCtx = NULL;
    VOS_STATUS status = VOS_STATUS_E_FAILURE;
-   int rxstat;
    struct sk_buff *skb = NULL;
+   struct sk_buff_head rxq;
    vos_pkt_t* pVosPacket;
    vos_pkt_t* pNextVosPacket;
    v_U8_t proto_type;
@@ -2579,6 +2618,9 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
 
    ++pAdapter->hdd_stats.hddTxRxStats.rxChains;
 
+   // frames are collected here and delivered once the chain is consumed
+   __skb_queue_head_init(&rxq);
+
    // walk the chain until all are processed
    pVosPacket = pVosPacketChain;
    do
@@ -2593,6 +2635,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
          ++pAdapter->hdd_stats.hddTxRxStats.rxDropped;
          VOS_TRACE( VOS_MODULE_ID_HDD_DATA, VOS_TRACE_LEVEL_ERROR,
                          "%s: Failure walking packet chain", __func__);
+         hdd_rx_deliver_batch(pAdapter, &rxq);
          return VOS_STATUS_E_FAILURE;
       }
 
@@ -2603,6 +2646,7 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
          ++pAdapter->hdd_stats.hddTxRxStats.rxDropped;
          VOS_TRACE( VOS_MODULE_ID_HDD_DATA, VOS_TRACE_LEVEL_ERROR,
                                 "%s: Failure extracting skb from vos pkt", __func__);
+         hdd_rx_deliver_batch(pAdapter, &rxq);
          return VOS_STATUS_E_FAILURE;
       }
 
@@ -2615,6 +2659,8 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
       {
          VOS_TRACE(VOS_MODULE_ID_HDD_DATA, VOS_TRACE_LEVEL_FATAL,
            "Magic cookie(%x) for adapter sanity verification is invalid", pAdapter->magic);
+         kfree_skb(skb);
+         __skb_queue_purge(&rxq);
          return eHAL_STATUS_FAILURE;
       }
 
@@ -2682,21 +2728,15 @@ VOS_STATUS hdd_rx_packet_cbk( v_VOID_t *vosContext,
                           HDD_WAKE_LOCK_DURATION,
                           WIFI_POWER_EVENT_WAKELOCK_HOLD_RX);
 #endif
-      rxstat = netif_rx_ni(skb);
-      if (NET_RX_SUCCESS == rxstat)
-      {
-         ++pAdapter->hdd_stats.hddTxRxStats.rxDelivered;
-         ++pAdapter->hdd_stats.hddTxRxStats.pkt_rx_count;
-      }
-      else
-      {
-         ++pAdapter->hdd_stats.hddTxRxStats.rxRefused;
-      }
+      __skb_queue_tail(&rxq, skb);
+
       // now process the next packet in the chain
       pVosPacket = pNextVosPacket;
 
    } while (pVosPacket);
 
+   hdd_rx_deliver_batch(pAdapter, &rxq);
+
    //Return the entire VOS packet chain to the resource pool
    status = vos_pkt_return_packet( pVosPacketChain );
    if(!VOS_IS_STATUS_SUCCESS( status ))
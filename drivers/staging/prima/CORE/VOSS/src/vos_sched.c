@@ -59,6 +59,7 @@
 #include "wlan_qct_pal_msg.h"
 #include <linux/spinlock.h>
 #include <linux/kthread.h>
+#include <linux/cpumask.h>
 #include <linux/wcnss_wlan.h>
 
 /*---------------------------------------------------------------------------
@@ -1915,6 +1916,42 @@ int vos_sched_is_rx_thread(int threadID)
    return ((gpVosSchedContext->RxThread) && (threadID == gpVosSchedContext->RxThread->pid));
 }
 
+/*-------------------------------------------------------------------------
+ This helper function restricts the RX thread to the CPUs set in cpuMask,
+ a mask of 0 lets it run on any CPU
+ ------------------------------------------------------------------------*/
+VOS_STATUS vos_sched_set_rx_thread_affinity(v_U32_t cpuMask)
+{
+   struct cpumask mask;
+   int cpu;
+
+   if ((gpVosSchedContext == NULL) || (gpVosSchedContext->RxThread == NULL))
+   {
+      VOS_TRACE(VOS_MODULE_ID_VOSS, VOS_TRACE_LEVEL_ERROR,
+          "%s: RX thread is not running",__func__);
+      return VOS_STATUS_E_FAILURE;
+   }
+
+   cpumask_clear(&mask);
+   for_each_possible_cpu(cpu)
+   {
+      if ((cpu < 32) && (cpuMask & (1 << cpu)))
+         cpumask_set_cpu(cpu, &mask);
+   }
+
+   if (cpumask_empty(&mask))
+      cpumask_copy(&mask, cpu_possible_mask);
+
+   if (set_cpus_allowed_ptr(gpVosSchedContext->RxThread, &mask))
+   {
+      VOS_TRACE(VOS_MODULE_ID_VOSS, VOS_TRACE_LEVEL_ERROR,
+          "%s: Failed to set RX thread affinity to 0x%x",__func__, cpuMask);
+      return VOS_STATUS_E_FAILURE;
+   }
+
+   return VOS_STATUS_SUCCESS;
+}
+
 /*-------------------------------------------------------------------------
  This helper function helps determine if thread id is of MC thread
  ------------------------------------------------------------------------*/
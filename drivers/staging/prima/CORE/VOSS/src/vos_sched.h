@@ -362,6 +362,7 @@ typedef struct _VosContextType
  
 int vos_sched_is_tx_thread(int threadID);
 int vos_sched_is_rx_thread(int threadID);
+VOS_STATUS vos_sched_set_rx_thread_affinity(v_U32_t cpuMask);
 int vos_sched_is_mc_thread(int threadID);
 /*---------------------------------------------------------------------------
   
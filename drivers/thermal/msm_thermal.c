@@ -41,6 +41,7 @@
 #include <mach/rpm-smd.h>
 #include <mach/scm.h>
 #include <linux/sched.h>
+#include <linux/tick.h>
 
 #define MAX_CURRENT_UA 1000000
 #define MAX_RAILS 5
@@ -98,6 +99,16 @@ static uint32_t default_cpu_temp_limit;
 static bool default_temp_limit_enabled;
 static bool default_temp_limit_probed;
 static bool default_temp_limit_nodes_called;
+static bool freq_pid_enabled;
+static bool budget_enabled;
+static LIST_HEAD(budget_clients);
+static DEFINE_MUTEX(budget_mutex);
+static struct msm_thermal_budget_client cpu_budget = {
+	.name = "cpu",
+	.limit = 100,
+};
+static u64 budget_prev_idle[NR_CPUS];
+static u64 budget_prev_wall[NR_CPUS];
 
 enum thermal_threshold {
 	HOTPLUG_THRESHOLD_HIGH,
@@ -130,6 +141,23 @@ struct cpu_info {
 	bool freq_thresh_clear;
 };
 
+/*
+ * State of the closed loop frequency controller. The error is the
+ * temperature above limit_temp_degC, the output the frequency (kHz) taken
+ * off the maximum:
+ *
+ *   out = kp * err + ki * integral(err) + kd * d(temp)/dt
+ *
+ * with kp in kHz/degC, ki in kHz/(degC * s) and kd in kHz/(degC/s).
+ */
+struct freq_pid_state {
+	bool init;
+	long prev_temp;
+	int64_t integral;	/* degC * ms */
+	int64_t slope;		/* mdegC / s, smoothed */
+};
+static struct freq_pid_state freq_pid;
+
 struct threshold_info;
 struct therm_threshold {
 	int32_t sensor_id;
@@ -1288,14 +1316,207 @@ exit:
 	return ret;
 }
 
+/*
+ * Compute the frequency cap for @temp with the PID controller. Returns
+ * UINT_MAX while no limit is needed.
+ */
+static uint32_t freq_pid_get_max_freq(long temp)
+{
+	struct freq_pid_state *pid = &freq_pid;
+	uint32_t hw_max = table[limit_idx_high].frequency;
+	uint32_t hw_min = table[limit_idx_low].frequency;
+	uint32_t dt = msm_thermal_info.poll_ms;
+	long err = temp - msm_thermal_info.limit_temp_degC;
+	int64_t out, inst_slope;
+	int i;
+
+	if (!pid->init || !dt) {
+		pid->init = true;
+		pid->prev_temp = temp;
+		pid->slope = 0;
+		pid->integral = 0;
+	}
+
+	/* Smooth the slope, tsens only reports whole degrees */
+	inst_slope = div_s64((int64_t)(temp - pid->prev_temp) * 1000000,
+			     dt ? dt : 1);
+	pid->slope = div_s64(pid->slope * 3 + inst_slope, 4);
+	pid->prev_temp = temp;
+
+	/* Cold enough: reset the controller and lift the limit */
+	if (err <= -msm_thermal_info.temp_hysteresis_degC && !pid->integral) {
+		limit_idx = limit_idx_high;
+		return UINT_MAX;
+	}
+
+	out = (int64_t)msm_thermal_info.freq_pid_kp * err +
+		div_s64((int64_t)msm_thermal_info.freq_pid_ki * pid->integral,
+			1000) +
+		div_s64((int64_t)msm_thermal_info.freq_pid_kd * pid->slope,
+			1000);
+
+	/* Anti-windup: stop integrating while pinned at the minimum */
+	if (!(err > 0 && out >= hw_max - hw_min)) {
+		pid->integral += (int64_t)err * dt;
+		if (pid->integral < 0)
+			pid->integral = 0;
+	}
+
+	if (out <= 0) {
+		limit_idx = limit_idx_high;
+		return UINT_MAX;
+	}
+	if (out >= hw_max - hw_min) {
+		limit_idx = limit_idx_low;
+		return hw_min;
+	}
+
+	/* Snap to the highest table frequency under the cap */
+	for (i = limit_idx_high; i > limit_idx_low; i--)
+		if (table[i].frequency != CPUFREQ_ENTRY_INVALID &&
+		    table[i].frequency <= hw_max - out)
+			break;
+	limit_idx = i;
+	return i == limit_idx_high ? UINT_MAX : table[i].frequency;
+}
+
+int msm_thermal_budget_register(struct msm_thermal_budget_client *client)
+{
+	mutex_lock(&budget_mutex);
+	client->throttle = 0;
+	client->limit = 100;
+	list_add_tail(&client->list, &budget_clients);
+	mutex_unlock(&budget_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL(msm_thermal_budget_register);
+
+void msm_thermal_budget_unregister(struct msm_thermal_budget_client *client)
+{
+	mutex_lock(&budget_mutex);
+	list_del(&client->list);
+	mutex_unlock(&budget_mutex);
+}
+EXPORT_SYMBOL(msm_thermal_budget_unregister);
+
+/* Average busy percentage of the mitigated CPUs since the last call */
+static unsigned int budget_get_cpu_util(void)
+{
+	u64 idle, wall, idle_delta, wall_delta;
+	u64 busy = 0, total = 0;
+	uint32_t cpu;
+
+	for_each_online_cpu(cpu) {
+		if (!(msm_thermal_info.bootup_freq_control_mask & BIT(cpu)))
+			continue;
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		if (idle == -1ULL)
+			continue;
+		idle_delta = idle - budget_prev_idle[cpu];
+		wall_delta = wall - budget_prev_wall[cpu];
+		budget_prev_idle[cpu] = idle;
+		budget_prev_wall[cpu] = wall;
+		if (idle_delta > wall_delta)
+			continue;
+		busy += wall_delta - idle_delta;
+		total += wall_delta;
+	}
+
+	return total ? div64_u64(busy * 100, total) : 0;
+}
+
+/*
+ * Split @throttle percent of mitigation, as requested for the CPUs alone,
+ * between the CPUs and the budget clients. The sum stays @throttle times
+ * the number of units, each unit's share is proportional to how idle it
+ * is, and a unit that can't be throttled further passes the rest on.
+ */
+static void budget_allocate(unsigned int throttle)
+{
+	struct msm_thermal_budget_client *c;
+	unsigned int n = 0, remaining, assigned, weight_sum, t, pass;
+
+	list_for_each_entry(c, &budget_clients, list) {
+		c->util = c->get_util ? min(c->get_util(c->data), 100U) :
+			budget_get_cpu_util();
+		c->throttle = 0;
+		n++;
+	}
+
+	remaining = throttle * n;
+	for (pass = 0; pass < n && remaining; pass++) {
+		weight_sum = 0;
+		list_for_each_entry(c, &budget_clients, list)
+			if (c->throttle < 100)
+				weight_sum += 101 - c->util;
+		if (!weight_sum)
+			break;
+
+		assigned = 0;
+		list_for_each_entry(c, &budget_clients, list) {
+			if (c->throttle >= 100)
+				continue;
+			t = remaining * (101 - c->util) / weight_sum;
+			t = min(t, 100 - c->throttle);
+			c->throttle += t;
+			assigned += t;
+		}
+		if (!assigned)
+			break;
+		remaining -= assigned;
+	}
+
+	list_for_each_entry(c, &budget_clients, list) {
+		if (!c->set_limit || c->limit == 100 - c->throttle)
+			continue;
+		c->limit = 100 - c->throttle;
+		pr_debug("%s budget: util %u%% limit %u%%\n", c->name, c->util,
+			c->limit);
+		c->set_limit(c->data, c->limit);
+	}
+}
+
+/*
+ * Turn the mitigation the controller asks for (limit_idx) into the CPUs'
+ * share of the budget and return the resulting CPU frequency cap.
+ */
+static uint32_t budget_get_cpu_max_freq(void)
+{
+	uint32_t hw_max = table[limit_idx_high].frequency;
+	uint32_t cap, throttle = 0;
+	int i;
+
+	if (limit_idx != limit_idx_high)
+		throttle = (hw_max - table[limit_idx].frequency) * 100ULL /
+			hw_max;
+
+	mutex_lock(&budget_mutex);
+	budget_allocate(throttle);
+	throttle = cpu_budget.throttle;
+	mutex_unlock(&budget_mutex);
+
+	if (!throttle)
+		return UINT_MAX;
+
+	cap = (uint64_t)hw_max * (100 - throttle) / 100;
+	for (i = limit_idx_high; i > limit_idx_low; i--)
+		if (table[i].frequency != CPUFREQ_ENTRY_INVALID &&
+		    table[i].frequency <= cap)
+			break;
+	return table[i].frequency;
+}
+
 static void do_freq_control(long temp)
 {
 	uint32_t cpu = 0;
 	uint32_t max_freq = cpus[cpu].limited_max_freq;
 
-	if (temp >= msm_thermal_info.limit_temp_degC) {
+	if (freq_pid_enabled) {
+		max_freq = freq_pid_get_max_freq(temp);
+	} else if (temp >= msm_thermal_info.limit_temp_degC) {
 		if (limit_idx == limit_idx_low)
-			return;
+			goto budget;
 
 		limit_idx -= msm_thermal_info.bootup_freq_step;
 		if (limit_idx < limit_idx_low)
@@ -1304,7 +1525,7 @@ static void do_freq_control(long temp)
 	} else if (temp < msm_thermal_info.limit_temp_degC -
 		 msm_thermal_info.temp_hysteresis_degC) {
 		if (limit_idx == limit_idx_high)
-			return;
+			goto budget;
 
 		limit_idx += msm_thermal_info.bootup_freq_step;
 		if (limit_idx >= limit_idx_high) {
@@ -1314,6 +1535,10 @@ static void do_freq_control(long temp)
 			max_freq = table[limit_idx].frequency;
 	}
 
+budget:
+	if (budget_enabled)
+		max_freq = budget_get_cpu_max_freq();
+
 	if (max_freq == cpus[cpu].limited_max_freq)
 		return;
 
@@ -1667,6 +1892,16 @@ set_freq_exit:
 	return ret;
 }
 
+/*
+ * Mask of the CPUs core control currently keeps offline. Hotplug policies
+ * must not try to bring these up.
+ */
+uint32_t msm_thermal_get_cpus_offlined(void)
+{
+	return core_control_enabled ? cpus_offlined : 0;
+}
+EXPORT_SYMBOL(msm_thermal_get_cpus_offlined);
+
 int therm_set_threshold(struct threshold_info *thresh_inp)
 {
 	int ret = 0, i = 0, err = 0;
@@ -3043,6 +3278,38 @@ PROBE_RESET_EXIT:
 	return ret;
 }
 
+/*
+ * Optional "qcom,freq-pid-control" = <kp ki kd> replaces the step-wise
+ * bootup frequency mitigation with a closed loop controller.
+ */
+static int probe_freq_pid(struct device_node *node,
+		struct msm_thermal_data *data,
+		struct platform_device *pdev)
+{
+	char *key = NULL;
+	uint32_t gains[3];
+	int ret = 0;
+
+	key = "qcom,freq-pid-control";
+	ret = of_property_read_u32_array(node, key, gains, ARRAY_SIZE(gains));
+	if (ret)
+		goto PROBE_PID_EXIT;
+
+	data->freq_pid_kp = gains[0];
+	data->freq_pid_ki = gains[1];
+	data->freq_pid_kd = gains[2];
+	freq_pid_enabled = true;
+
+PROBE_PID_EXIT:
+	if (ret) {
+		dev_dbg(&pdev->dev,
+		"%s:Failed reading node=%s, key=%s err=%d. Using step control\n",
+			__func__, node->full_name, key, ret);
+		freq_pid_enabled = false;
+	}
+	return ret;
+}
+
 static int probe_freq_mitigation(struct device_node *node,
 		struct msm_thermal_data *data,
 		struct platform_device *pdev)
@@ -3125,6 +3392,12 @@ static int __devinit msm_thermal_dev_probe(struct platform_device *pdev)
 	key = "qcom,freq-control-mask";
 	ret = of_property_read_u32(node, key, &data.bootup_freq_control_mask);
 
+	probe_freq_pid(node, &data, pdev);
+
+	budget_enabled = of_property_read_bool(node, "qcom,cpu-gpu-budget");
+	if (budget_enabled)
+		msm_thermal_budget_register(&cpu_budget);
+
 	ret = probe_cc(node, &data, pdev);
 
 	ret = probe_freq_mitigation(node, &data, pdev);
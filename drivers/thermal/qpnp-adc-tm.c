@@ -1367,6 +1367,8 @@ static int qpnp_adc_tm_read_status(struct qpnp_adc_tm_chip *chip)
 	uint32_t btm_chan_num = 0;
 	struct qpnp_adc_thr_client_info *client_info = NULL;
 	struct list_head *thr_list;
+	struct spmi_xfer xfers[2];
+	u8 status[2], enables[3];
 
 	if (qpnp_adc_tm_is_valid(chip))
 		return -ENODEV;
@@ -1379,41 +1381,33 @@ static int qpnp_adc_tm_read_status(struct qpnp_adc_tm_chip *chip)
 		goto fail;
 	}
 
-	rc = qpnp_adc_tm_read_reg(chip, QPNP_ADC_TM_STATUS_LOW, &status_low);
+	/*
+	 * Read the status and the enables in one batch, STATUS_LOW and
+	 * STATUS_HIGH as well as MULTI_MEAS_EN, LOW_THR_INT_EN and
+	 * HIGH_THR_INT_EN are consecutive registers.
+	 */
+	xfers[0].addr = chip->adc->offset + QPNP_ADC_TM_STATUS_LOW;
+	xfers[0].buf = status;
+	xfers[0].len = 2;
+	xfers[0].write = false;
+	xfers[1].addr = chip->adc->offset + QPNP_ADC_TM_MULTI_MEAS_EN;
+	xfers[1].buf = enables;
+	xfers[1].len = 3;
+	xfers[1].write = false;
+	rc = spmi_ext_register_xfer_batch(chip->adc->spmi->ctrl,
+					chip->adc->slave, xfers, 2);
 	if (rc) {
-		pr_err("adc-tm-tm read status low failed with %d\n", rc);
-		goto fail;
-	}
-
-	rc = qpnp_adc_tm_read_reg(chip, QPNP_ADC_TM_STATUS_HIGH, &status_high);
-	if (rc) {
-		pr_err("adc-tm-tm read status high failed with %d\n", rc);
-		goto fail;
-	}
-
-	rc = qpnp_adc_tm_read_reg(chip, QPNP_ADC_TM_LOW_THR_INT_EN,
-						&adc_tm_low_thr_set);
-	if (rc) {
-		pr_err("adc-tm-tm read low thr failed with %d\n", rc);
-		goto fail;
-	}
-
-	rc = qpnp_adc_tm_read_reg(chip, QPNP_ADC_TM_HIGH_THR_INT_EN,
-						&adc_tm_high_thr_set);
-	if (rc) {
-		pr_err("adc-tm-tm read high thr failed with %d\n", rc);
+		pr_err("adc-tm-tm read status failed with %d\n", rc);
 		goto fail;
 	}
+	status_low = status[0];
+	status_high = status[1];
+	qpnp_adc_tm_meas_en = enables[0];
+	adc_tm_low_thr_set = enables[1];
+	adc_tm_high_thr_set = enables[2];
 
 	/* Check which interrupt threshold is lower and measure against the
 	 * enabled channel */
-	rc = qpnp_adc_tm_read_reg(chip, QPNP_ADC_TM_MULTI_MEAS_EN,
-							&qpnp_adc_tm_meas_en);
-	if (rc) {
-		pr_err("adc-tm-tm read status high failed with %d\n", rc);
-		goto fail;
-	}
-
 	adc_tm_low_enable = qpnp_adc_tm_meas_en & status_low;
 	adc_tm_low_enable &= adc_tm_low_thr_set;
 	adc_tm_high_enable = qpnp_adc_tm_meas_en & status_high;
@@ -59,6 +59,7 @@
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
 #include <linux/gpio.h>
+#include <linux/ktime.h>
 #include <asm/atomic.h>
 #include <asm/irq.h>
 
@@ -90,6 +91,13 @@ static int hs_serial_debug_mask = INFO_LEV;
 module_param_named(debug_mask, hs_serial_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Longest the rx stale timeout is stretched to while data streams in at
+ * high baud rates, see msm_hs_adapt_rx_stale(). 0 keeps it fixed.
+ */
+static unsigned int rx_stale_max_us = 1000;
+module_param(rx_stale_max_us, uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #define MSM_HS_DBG(x...) do { \
 	if (hs_serial_debug_mask >= DBG_LEV) { \
 		if (ipc_msm_hs_log_ctxt) \
@@ -193,6 +201,10 @@ struct msm_hs_rx {
 	struct msm_hs_sps_ep_conn_data prod;
 	bool rx_cmd_queued;
 	bool rx_cmd_exec;
+	unsigned long stale_base;	/* stale timeout for the baud rate */
+	unsigned long stale_max;	/* rx_stale_max_us in characters */
+	unsigned long stale;		/* stale timeout programmed */
+	ktime_t last_rx;
 };
 enum buffer_states {
 	NONE_PENDING = 0x0,
@@ -260,7 +272,8 @@ static struct of_device_id msm_hs_match_table[] = {
 
 #define MSM_UARTDM_BURST_SIZE 16   /* DM burst size (in bytes) */
 #define UARTDM_TX_BUF_SIZE UART_XMIT_SIZE
-#define UARTDM_RX_BUF_SIZE 512
+/* at most 2K, the rx offset kept in buffer_pending has 11 bits */
+#define UARTDM_RX_BUF_SIZE 2048
 #define RETRY_TIMEOUT 5
 #define UARTDM_NR 256
 #define BAM_PIPE_MIN 0
@@ -771,6 +784,17 @@ reg_event_err:
 	return ret;
 }
 
+static void msm_hs_write_rx_stale(struct uart_port *uport,
+				  unsigned long rxstale)
+{
+	unsigned long data;
+
+	data = rxstale & UARTDM_IPR_STALE_LSB_BMSK;
+	data |= UARTDM_IPR_STALE_TIMEOUT_MSB_BMSK & (rxstale << 2);
+
+	msm_hs_write(uport, UART_DM_IPR, data);
+}
+
 /*
  * programs the UARTDM_CSR register with correct bit rates
  *
@@ -784,7 +808,6 @@ static void msm_hs_set_bps_locked(struct uart_port *uport,
 			       unsigned int bps)
 {
 	unsigned long rxstale;
-	unsigned long data;
 	struct msm_hs_port *msm_uport = UARTDM_TO_MSM(uport);
 
 	switch (bps) {
@@ -895,10 +918,14 @@ static void msm_hs_set_bps_locked(struct uart_port *uport,
 		WARN_ON(1);
 	}
 
-	data = rxstale & UARTDM_IPR_STALE_LSB_BMSK;
-	data |= UARTDM_IPR_STALE_TIMEOUT_MSB_BMSK & (rxstale << 2);
-
-	msm_hs_write(uport, UART_DM_IPR, data);
+	msm_uport->rx.stale_base = rxstale;
+	msm_uport->rx.stale = rxstale;
+	msm_uport->rx.stale_max = rxstale;
+	if (bps > 460800)
+		msm_uport->rx.stale_max = max_t(unsigned long, rxstale,
+			div_u64((u64)(bps / 10) * rx_stale_max_us,
+				USEC_PER_SEC));
+	msm_hs_write_rx_stale(uport, rxstale);
 	/*
 	 * It is suggested to do reset of transmitter and receiver after
 	 * changing any protocol configuration. Here Baud rate and stale
@@ -913,7 +940,7 @@ static void msm_hs_set_std_bps_locked(struct uart_port *uport,
 			       unsigned int bps)
 {
 	unsigned long rxstale;
-	unsigned long data;
+	struct msm_hs_port *msm_uport = UARTDM_TO_MSM(uport);
 
 	switch (bps) {
 	case 9600:
@@ -952,10 +979,10 @@ static void msm_hs_set_std_bps_locked(struct uart_port *uport,
 		break;
 	}
 
-	data = rxstale & UARTDM_IPR_STALE_LSB_BMSK;
-	data |= UARTDM_IPR_STALE_TIMEOUT_MSB_BMSK & (rxstale << 2);
-
-	msm_hs_write(uport, UART_DM_IPR, data);
+	msm_uport->rx.stale_base = rxstale;
+	msm_uport->rx.stale = rxstale;
+	msm_uport->rx.stale_max = rxstale;
+	msm_hs_write_rx_stale(uport, rxstale);
 }
 
 
@@ -1380,14 +1407,15 @@ static void flip_insert_work(struct work_struct *work)
 	if (msm_uport->rx.buffer_pending & CHARS_NORMAL) {
 		int rx_count, rx_offset;
 		rx_count = (msm_uport->rx.buffer_pending & 0xFFFF0000) >> 16;
-		rx_offset = (msm_uport->rx.buffer_pending & 0xFFD0) >> 5;
+		rx_offset = (msm_uport->rx.buffer_pending & 0xFFE0) >> 5;
 		retval = tty_insert_flip_string(tty, msm_uport->rx.buffer +
 						rx_offset, rx_count);
 		msm_uport->rx.buffer_pending &= (FIFO_OVERRUN |
 						 PARITY_ERROR);
 		if (retval != rx_count)
 			msm_uport->rx.buffer_pending |= CHARS_NORMAL |
-				retval << 8 | (rx_count - retval) << 16;
+				(rx_offset + retval) << 5 |
+				(rx_count - retval) << 16;
 	}
 	if (msm_uport->rx.buffer_pending)
 		schedule_delayed_work(&msm_uport->rx.flip_insert_work,
@@ -1402,6 +1430,38 @@ static void flip_insert_work(struct work_struct *work)
 	tty_flip_buffer_push(tty);
 }
 
+/*
+ * Each rx transfer completes on a stale event, after the line has been
+ * idle for the stale timeout. The timeout set for the baud rate is a few
+ * characters, so with A2DP streaming or BLE scanning every HCI packet
+ * costs a BAM interrupt and a trip through this tasklet. While transfers
+ * complete back to back the timeout is doubled, up to rx_stale_max_us
+ * worth of characters, so bursts of packets land in one transfer; once
+ * the line has been quiet for a while it goes back to the base value to
+ * keep isolated events low latency.
+ */
+static void msm_hs_adapt_rx_stale(struct msm_hs_port *msm_uport)
+{
+	struct msm_hs_rx *rx = &msm_uport->rx;
+	ktime_t now = ktime_get();
+	s64 gap = ktime_us_delta(now, rx->last_rx);
+	unsigned long stale = rx->stale;
+
+	rx->last_rx = now;
+	if (rx->stale_max <= rx->stale_base ||
+	    msm_uport->clk_state != MSM_HS_CLK_ON)
+		return;
+
+	if (gap < 2 * rx_stale_max_us)
+		stale = min(2 * stale, rx->stale_max);
+	else if (gap > 8 * rx_stale_max_us)
+		stale = rx->stale_base;
+	if (stale != rx->stale) {
+		rx->stale = stale;
+		msm_hs_write_rx_stale(&msm_uport->uport, stale);
+	}
+}
+
 static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 {
 	int retval;
@@ -1507,6 +1567,7 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 		}
 	}
 	if (!msm_uport->rx.buffer_pending && !msm_uport->rx.rx_cmd_queued) {
+		msm_hs_adapt_rx_stale(msm_uport);
 		msm_uport->rx.flush = FLUSH_NONE;
 		msm_uport->rx_bam_inprogress = true;
 		sps_pipe_handle = rx->prod.pipe_handle;
@@ -52,7 +52,7 @@ static int smd_tty_channels_len = ARRAY_SIZE(smd_default_tty_channels);
 static void smd_tty_notify(void *priv, unsigned event)
 {
 	unsigned char *ptr;
-	int avail;
+	int avail, pushed = 0;
 	struct smd_tty_info *info = priv;
 	struct tty_struct *tty;
 
@@ -71,6 +71,8 @@ static void smd_tty_notify(void *priv, unsigned event)
 			break;
 
 		avail = tty_prepare_flip_string(tty, &ptr, avail);
+		if (avail == 0)
+			break;
 
 		if (smd_read(info->ch, ptr, avail) != avail) {
 			/* shouldn't be possible since we're in interrupt
@@ -79,12 +81,15 @@ static void smd_tty_notify(void *priv, unsigned event)
 			*/
 			pr_err("OOPS - smd_tty_buffer mismatch?!");
 		}
+		pushed = 1;
+	}
 
+	/* hand everything drained to the ldisc and wake its readers once */
+	if (pushed)
 		tty_flip_buffer_push(tty);
-	}
 
-	/* XXX only when writable and necessary */
-	tty_wakeup(tty);
+	if (smd_write_avail(info->ch))
+		tty_wakeup(tty);
 	tty_kref_put(tty);
 }
 
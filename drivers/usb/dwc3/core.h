@@ -46,6 +46,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/mm.h>
 #include <linux/debugfs.h>
+#include <linux/hrtimer.h>
 
 #include <linux/usb/ch9.h>
 #include <linux/usb/gadget.h>
@@ -464,6 +465,12 @@ struct dwc3_event_buffer {
  * @name: a human readable name e.g. ep1out-bulk
  * @direction: true for TX, false for RX
  * @stream_capable: true when streams are enabled
+ * @moderation_timer: delays starting an IN transfer to batch requests
+ * @stat_transfers: number of transfers started
+ * @stat_requests: number of requests handed to the controller
+ * @stat_trbs: number of TRBs handed to the controller
+ * @stat_moderated: number of transfers started by @moderation_timer
+ * @stat_max_batch: largest number of requests in a single transfer
  */
 struct dwc3_ep {
 	struct usb_ep		endpoint;
@@ -500,6 +507,13 @@ struct dwc3_ep {
 
 	unsigned		direction:1;
 	unsigned		stream_capable:1;
+
+	struct hrtimer		moderation_timer;
+	unsigned long		stat_transfers;
+	unsigned long		stat_requests;
+	unsigned long		stat_trbs;
+	unsigned long		stat_moderated;
+	unsigned		stat_max_batch;
 };
 
 enum dwc3_phy {
@@ -712,6 +726,7 @@ struct dwc3_scratchpad_array {
  * @mem: points to start of memory which is used for this struct.
  * @hwparams: copy of hwparams registers
  * @root: debugfs root folder pointer
+ * @moderation_us: time bulk IN requests are held to be batched, 0 disables
  * @tx_fifo_size: Available RAM size for TX fifo allocation
  * @err_evt_seen: previous event in queue was erratic error
  * @irq_cnt: total irq count
@@ -795,6 +810,7 @@ struct dwc3 {
 
 	struct dwc3_hwparams	hwparams;
 	struct dentry		*root;
+	u32			moderation_us;
 
 	u8			test_mode;
 	u8			test_mode_nr;
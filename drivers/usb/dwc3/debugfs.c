@@ -1061,6 +1061,70 @@ const struct file_operations dwc3_gadget_dbg_data_fops = {
 	.release		= single_release,
 };
 
+static int dwc3_ep_stats_show(struct seq_file *s, void *unused)
+{
+	struct dwc3		*dwc = s->private;
+	struct dwc3_ep		*dep;
+	unsigned long		flags;
+	int			i;
+
+	seq_puts(s, "ep transfers requests trbs moderated max_batch\n");
+
+	spin_lock_irqsave(&dwc->lock, flags);
+	for (i = 2; i < DWC3_ENDPOINTS_NUM; i++) {
+		dep = dwc->eps[i];
+		if (!dep || !dep->stat_transfers)
+			continue;
+
+		seq_printf(s, "%s %lu %lu %lu %lu %u\n", dep->name,
+			dep->stat_transfers, dep->stat_requests,
+			dep->stat_trbs, dep->stat_moderated,
+			dep->stat_max_batch);
+	}
+	spin_unlock_irqrestore(&dwc->lock, flags);
+
+	return 0;
+}
+
+static int dwc3_ep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dwc3_ep_stats_show, inode->i_private);
+}
+
+static ssize_t dwc3_ep_stats_clear(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file		*s = file->private_data;
+	struct dwc3		*dwc = s->private;
+	struct dwc3_ep		*dep;
+	unsigned long		flags;
+	int			i;
+
+	spin_lock_irqsave(&dwc->lock, flags);
+	for (i = 0; i < DWC3_ENDPOINTS_NUM; i++) {
+		dep = dwc->eps[i];
+		if (!dep)
+			continue;
+
+		dep->stat_transfers = 0;
+		dep->stat_requests = 0;
+		dep->stat_trbs = 0;
+		dep->stat_moderated = 0;
+		dep->stat_max_batch = 0;
+	}
+	spin_unlock_irqrestore(&dwc->lock, flags);
+
+	return count;
+}
+
+const struct file_operations dwc3_ep_stats_fops = {
+	.open			= dwc3_ep_stats_open,
+	.write			= dwc3_ep_stats_clear,
+	.read			= seq_read,
+	.llseek			= seq_lseek,
+	.release		= single_release,
+};
+
 int __devinit dwc3_debugfs_init(struct dwc3 *dwc)
 {
 	struct dentry		*root;
@@ -1130,6 +1194,20 @@ int __devinit dwc3_debugfs_init(struct dwc3 *dwc)
 		ret = -ENOMEM;
 		goto err1;
 	}
+
+	file = debugfs_create_file("ep_stats", S_IRUGO | S_IWUSR, root,
+			dwc, &dwc3_ep_stats_fops);
+	if (!file) {
+		ret = -ENOMEM;
+		goto err1;
+	}
+
+	file = debugfs_create_u32("moderation_us", S_IRUGO | S_IWUSR, root,
+			&dwc->moderation_us);
+	if (!file) {
+		ret = -ENOMEM;
+		goto err1;
+	}
 	return 0;
 
 err1:
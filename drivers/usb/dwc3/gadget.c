@@ -730,6 +730,8 @@ static int __dwc3_gadget_ep_disable(struct dwc3_ep *dep)
 	struct dwc3		*dwc = dep->dwc;
 	u32			reg;
 
+	/* the timer checks DWC3_EP_ENABLED if it is already running */
+	hrtimer_try_to_cancel(&dep->moderation_timer);
 	dwc3_remove_requests(dwc, dep);
 
 	/* make sure HW endpoint isn't stalled */
@@ -1210,9 +1212,52 @@ static int __dwc3_gadget_kick_transfer(struct dwc3_ep *dep, u16 cmd_param,
 		WARN_ON_ONCE(!dep->resource_index);
 	}
 
+	if (start_new && !usb_endpoint_xfer_isoc(dep->endpoint.desc)) {
+		unsigned	batch = 0;
+
+		list_for_each_entry(req1, &dep->req_queued, list)
+			batch++;
+
+		dep->stat_transfers++;
+		dep->stat_requests += batch;
+		dep->stat_trbs += dep->free_slot - dep->busy_slot;
+		if (batch > dep->stat_max_batch)
+			dep->stat_max_batch = batch;
+	}
+
 	return 0;
 }
 
+/*
+ * Bulk IN requests queued on an idle endpoint are held for moderation_us so
+ * that the requests queued meanwhile go out in the same transfer, with a
+ * single completion interrupt for all of them.
+ */
+static enum hrtimer_restart dwc3_gadget_moderation_timer(struct hrtimer *t)
+{
+	struct dwc3_ep		*dep = container_of(t, struct dwc3_ep,
+						moderation_timer);
+	struct dwc3		*dwc = dep->dwc;
+	unsigned long		flags;
+	int			ret;
+
+	spin_lock_irqsave(&dwc->lock, flags);
+	if ((dep->flags & DWC3_EP_ENABLED) &&
+			(dep->flags & DWC3_EP_PENDING_REQUEST) &&
+			!list_empty(&dep->request_list)) {
+		dep->stat_moderated++;
+		ret = __dwc3_gadget_kick_transfer(dep, 0, true);
+		if (ret && ret != -EBUSY) {
+			dbg_event(dep->number, "QUEUE", ret);
+			dev_dbg(dwc->dev, "%s: failed to kick transfers\n",
+					dep->name);
+		}
+	}
+	spin_unlock_irqrestore(&dwc->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 static void __dwc3_gadget_start_isoc(struct dwc3 *dwc,
 		struct dwc3_ep *dep, u32 cur_uf)
 {
@@ -1318,6 +1363,16 @@ static int __dwc3_gadget_ep_queue(struct dwc3_ep *dep, struct dwc3_request *req)
 			return 0;
 		}
 
+		if (dwc->moderation_us && dep->direction &&
+				usb_endpoint_xfer_bulk(dep->endpoint.desc)) {
+			if (!hrtimer_active(&dep->moderation_timer))
+				hrtimer_start(&dep->moderation_timer,
+					ns_to_ktime(dwc->moderation_us *
+						NSEC_PER_USEC),
+					HRTIMER_MODE_REL);
+			return 0;
+		}
+
 		ret = __dwc3_gadget_kick_transfer(dep, 0, true);
 		if (ret && ret != -EBUSY) {
 			dbg_event(dep->number, "QUEUE", ret);
@@ -2050,6 +2105,9 @@ static int __devinit dwc3_gadget_init_hw_endpoints(struct dwc3 *dwc,
 
 		INIT_LIST_HEAD(&dep->request_list);
 		INIT_LIST_HEAD(&dep->req_queued);
+		hrtimer_init(&dep->moderation_timer, CLOCK_MONOTONIC,
+				HRTIMER_MODE_REL);
+		dep->moderation_timer.function = dwc3_gadget_moderation_timer;
 	}
 
 	return 0;
@@ -2240,6 +2298,21 @@ static void dwc3_endpoint_transfer_complete(struct dwc3 *dwc,
 	if (clean_busy)
 		dep->flags &= ~DWC3_EP_BUSY;
 
+	/*
+	 * Requests queued while the transfer was running go out right away
+	 * as the next batch instead of waiting for XferNotReady, which saves
+	 * an interrupt per transfer.
+	 */
+	if (clean_busy && start_new && (dep->flags & DWC3_EP_ENABLED) &&
+			!usb_endpoint_xfer_isoc(dep->endpoint.desc) &&
+			!list_empty(&dep->request_list)) {
+		int	ret;
+
+		ret = __dwc3_gadget_kick_transfer(dep, 0, 1);
+		if (ret && ret != -EBUSY)
+			dbg_event(dep->number, "QUEUE", ret);
+	}
+
 	/*
 	 * WORKAROUND: This is the 2nd half of U1/U2 -> U0 workaround.
 	 * See dwc3_gadget_linksts_change_interrupt() for 1st half.
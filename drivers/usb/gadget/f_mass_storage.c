@@ -310,6 +310,9 @@ static const char fsg_string_interface[] = "Mass Storage";
 
 #include "storage_common.c"
 
+/* Most full buffers handed to the backing file by a single write */
+#define FSG_WRITE_BATCH		8
+
 #ifdef CONFIG_USB_CSW_HACK
 static int write_error_after_csw_sent;
 static int csw_hack_sent;
@@ -914,6 +917,8 @@ static int do_write(struct fsg_common *common)
 	unsigned int		amount;
 	ssize_t			nwritten;
 	int			rc;
+	struct iovec		iov[FSG_WRITE_BATCH];
+	int			nr_iov;
 
 #ifdef CONFIG_USB_CSW_HACK
 	int			i;
@@ -1057,14 +1062,54 @@ static int do_write(struct fsg_common *common)
 			if (amount == 0)
 				goto empty_write;
 
+			/*
+			 * Hand the buffers that filled up in the meantime to
+			 * the backing file together with this one.  Only
+			 * complete, block aligned buffers that stay within
+			 * the file are merged, anything else is left for the
+			 * checks above on the next pass.
+			 */
+			iov[0].iov_base = bh->buf;
+			iov[0].iov_len = amount;
+			nr_iov = 1;
+			while (nr_iov < FSG_WRITE_BATCH &&
+			       amount == bh->bulk_out_intended_length) {
+				struct fsg_buffhd *nbh =
+					common->next_buffhd_to_drain;
+				unsigned int n;
+
+				if (nbh->state != BUF_STATE_FULL)
+					break;
+				smp_rmb();
+				n = nbh->outreq->actual;
+				if (nbh->outreq->status != 0 ||
+				    n != nbh->bulk_out_intended_length ||
+				    n & (curlun->blksize - 1) ||
+				    curlun->file_length - file_offset <
+						amount + n)
+					break;
+
+				common->next_buffhd_to_drain = nbh->next;
+				nbh->state = BUF_STATE_EMPTY;
+				iov[nr_iov].iov_base = nbh->buf;
+				iov[nr_iov].iov_len = n;
+				nr_iov++;
+				amount += n;
+			}
+
 			/* Perform the write */
 			file_offset_tmp = file_offset;
 #ifdef CONFIG_USB_MSC_PROFILING
 			start = ktime_get();
 #endif
-			nwritten = vfs_write(curlun->filp,
-					     (char __user *)bh->buf,
-					     amount, &file_offset_tmp);
+			if (nr_iov == 1)
+				nwritten = vfs_write(curlun->filp,
+						     (char __user *)bh->buf,
+						     amount, &file_offset_tmp);
+			else
+				nwritten = vfs_writev(curlun->filp,
+					(const struct iovec __user *)iov,
+					nr_iov, &file_offset_tmp);
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 			      (unsigned long long)file_offset, (int)nwritten);
 #ifdef CONFIG_USB_MSC_PROFILING
@@ -30,6 +30,9 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
+#include <linux/vmalloc.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -37,6 +40,9 @@
 #include <linux/usb/f_mtp.h>
 
 #define MTP_BULK_BUFFER_SIZE       16384
+#define MTP_TX_SG_SIZE             (64 * 1024)
+#define MTP_TX_SG_ENTRIES          (MTP_TX_SG_SIZE / PAGE_SIZE + 1)
+#define MTP_RX_BATCH_SIZE          (1024 * 1024)
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -51,7 +57,8 @@
 
 /* number of tx and rx requests to allocate */
 #define MTP_TX_REQ_MAX 8
-#define RX_REQ_MAX 2
+#define MTP_TX_SG_REQ_MAX 8
+#define RX_REQ_MAX 4
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -76,6 +83,14 @@ module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
 unsigned int mtp_tx_reqs = MTP_TX_REQ_MAX;
 module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
 
+/* send page cache pages directly when the controller supports SG */
+bool mtp_tx_sg = true;
+module_param(mtp_tx_sg, bool, S_IRUGO | S_IWUSR);
+
+/* received data is collected up to this size before writing the file */
+unsigned int mtp_rx_batch_len = MTP_RX_BATCH_SIZE;
+module_param(mtp_rx_batch_len, uint, S_IRUGO);
+
 static const char mtp_shortname[] = "mtp_usb";
 
 struct mtp_dev {
@@ -95,6 +110,7 @@ struct mtp_dev {
 	atomic_t ioctl_excl;
 
 	struct list_head tx_idle;
+	struct list_head tx_sg_idle;
 	struct list_head intr_idle;
 
 	wait_queue_head_t read_wq;
@@ -102,6 +118,7 @@ struct mtp_dev {
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
+	void *rx_batch;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -376,6 +393,89 @@ static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 	}
 }
 
+static struct usb_request *mtp_sg_request_new(struct usb_ep *ep)
+{
+	struct usb_request *req = usb_ep_alloc_request(ep, GFP_KERNEL);
+	if (!req)
+		return NULL;
+
+	req->sg = kmalloc(MTP_TX_SG_ENTRIES * sizeof(struct scatterlist),
+			GFP_KERNEL);
+	if (!req->sg) {
+		usb_ep_free_request(ep, req);
+		return NULL;
+	}
+	req->buf = NULL;
+	req->num_sgs = 0;
+
+	return req;
+}
+
+static void mtp_sg_request_free(struct usb_request *req, struct usb_ep *ep)
+{
+	if (req) {
+		kfree(req->sg);
+		usb_ep_free_request(ep, req);
+	}
+}
+
+static void mtp_sg_put_pages(struct usb_request *req)
+{
+	int i;
+
+	for (i = 0; i < req->num_sgs; i++)
+		page_cache_release(sg_page(&req->sg[i]));
+	req->num_sgs = 0;
+}
+
+/*
+ * Point an SG request at the page cache pages backing len bytes of the
+ * file at offset, reading them in if they are not cached.  Each page is
+ * held until the request completes.
+ */
+static int mtp_sg_fill(struct usb_request *req, struct file *filp,
+		loff_t offset, int len)
+{
+	struct address_space *mapping = filp->f_mapping;
+	pgoff_t index = offset >> PAGE_CACHE_SHIFT;
+	pgoff_t last = (offset + len - 1) >> PAGE_CACHE_SHIFT;
+	unsigned int off = offset & ~PAGE_CACHE_MASK;
+	struct page *page;
+	int chunk;
+
+	sg_init_table(req->sg, MTP_TX_SG_ENTRIES);
+	req->num_sgs = 0;
+
+	while (len > 0) {
+		page = find_get_page(mapping, index);
+		if (!page) {
+			page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					index, last - index + 1);
+		} else if (PageReadahead(page)) {
+			page_cache_async_readahead(mapping, &filp->f_ra, filp,
+					page, index, last - index + 1);
+		}
+		if (!page || !PageUptodate(page)) {
+			if (page)
+				page_cache_release(page);
+			page = read_mapping_page(mapping, index, filp);
+			if (IS_ERR(page)) {
+				mtp_sg_put_pages(req);
+				return PTR_ERR(page);
+			}
+		}
+
+		chunk = min_t(int, len, PAGE_CACHE_SIZE - off);
+		sg_set_page(&req->sg[req->num_sgs++], page, chunk, off);
+		len -= chunk;
+		off = 0;
+		index++;
+	}
+	sg_mark_end(&req->sg[req->num_sgs - 1]);
+
+	return 0;
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -432,11 +532,25 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->write_wq);
 }
 
+static void mtp_complete_in_sg(struct usb_ep *ep, struct usb_request *req)
+{
+	struct mtp_dev *dev = _mtp_dev;
+
+	if (req->status != 0)
+		dev->state = STATE_ERROR;
+
+	mtp_sg_put_pages(req);
+	mtp_req_put(dev, &dev->tx_sg_idle, req);
+
+	wake_up(&dev->write_wq);
+}
+
 static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	/* OUT requests complete in order, count them for receive_file_work */
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -514,6 +628,15 @@ retry_tx_alloc:
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
 
+	/* SG requests are optional, they only speed up send_file_work */
+	for (i = 0; cdev->gadget->sg_supported && i < MTP_TX_SG_REQ_MAX; i++) {
+		req = mtp_sg_request_new(dev->ep_in);
+		if (!req)
+			break;
+		req->complete = mtp_complete_in_sg;
+		mtp_req_put(dev, &dev->tx_sg_idle, req);
+	}
+
 	/*
 	 * The RX buffer should be aligned to EP max packet for
 	 * some controllers.  At bind time, we don't know the
@@ -537,6 +660,11 @@ retry_rx_alloc:
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
+
+	/* without the batch buffer every request is written on its own */
+	if (!dev->rx_batch && mtp_rx_batch_len >= mtp_rx_req_len)
+		dev->rx_batch = vmalloc(mtp_rx_batch_len);
+
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
 		if (!req)
@@ -741,11 +869,14 @@ static void send_file_work(struct work_struct *data)
 	struct usb_request *req = 0;
 	struct mtp_data_header *header;
 	struct file *filp;
+	struct inode *inode;
 	loff_t offset;
 	int64_t count;
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool use_sg = false;
+	bool sg_req = false;
 
 	/* read our parameters */
 	smp_rmb();
@@ -760,6 +891,12 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	inode = filp->f_path.dentry->d_inode;
+	if (mtp_tx_sg && !list_empty(&dev->tx_sg_idle) &&
+			S_ISREG(inode->i_mode) &&
+			filp->f_mapping->a_ops->readpage)
+		use_sg = true;
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -778,10 +915,20 @@ static void send_file_work(struct work_struct *data)
 		if (count == 0)
 			sendZLP = 0;
 
+		/*
+		 * Full chunks of the file body go out as SG requests over the
+		 * page cache pages, the header and the tail use a bounce
+		 * buffer.  Every request but the last stays a multiple of the
+		 * packet size so the host doesn't see a short packet early.
+		 */
+		sg_req = use_sg && !hdr_size && count >= MTP_TX_SG_SIZE &&
+			offset + MTP_TX_SG_SIZE <= i_size_read(inode);
+
 		/* get an idle tx request to use */
 		req = 0;
 		ret = wait_event_interruptible(dev->write_wq,
-			(req = mtp_req_get(dev, &dev->tx_idle))
+			(req = mtp_req_get(dev,
+				sg_req ? &dev->tx_sg_idle : &dev->tx_idle))
 			|| dev->state != STATE_BUSY);
 		if (dev->state == STATE_CANCELED) {
 			r = -ECANCELED;
@@ -792,6 +939,17 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
+		if (sg_req) {
+			xfer = MTP_TX_SG_SIZE;
+			ret = mtp_sg_fill(req, filp, offset, xfer);
+			if (ret < 0) {
+				r = ret;
+				break;
+			}
+			offset += xfer;
+			goto queue;
+		}
+
 		if (count > mtp_tx_req_len)
 			xfer = mtp_tx_req_len;
 		else
@@ -816,10 +974,13 @@ static void send_file_work(struct work_struct *data)
 		xfer = ret + hdr_size;
 		hdr_size = 0;
 
+queue:
 		req->length = xfer;
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			if (sg_req)
+				mtp_sg_put_pages(req);
 			if (dev->state != STATE_OFFLINE)
 				dev->state = STATE_ERROR;
 			r = -EIO;
@@ -833,7 +994,8 @@ static void send_file_work(struct work_struct *data)
 	}
 
 	if (req)
-		mtp_req_put(dev, &dev->tx_idle, req);
+		mtp_req_put(dev, sg_req ? &dev->tx_sg_idle : &dev->tx_idle,
+				req);
 
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
@@ -841,17 +1003,37 @@ static void send_file_work(struct work_struct *data)
 	smp_wmb();
 }
 
+/* write the data collected in the receive batch buffer to the file */
+static int mtp_rx_flush(struct mtp_dev *dev, struct file *filp,
+		loff_t *offset, size_t *batched)
+{
+	int ret;
+
+	if (!*batched)
+		return 0;
+
+	ret = vfs_write(filp, dev->rx_batch, *batched, offset);
+	DBG(dev->cdev, "vfs_write %d\n", ret);
+	if (ret != *batched)
+		return -EIO;
+	*batched = 0;
+
+	return 0;
+}
+
 /* read from USB and write to a local file */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, requested = 0;
+	size_t batched = 0;
+	unsigned actual;
+	int ret, queued = 0, next_queue = 0, next_done = 0, completed = 0;
 	int r = 0;
 
 	/* read our parameters */
@@ -870,74 +1052,98 @@ static void receive_file_work(struct work_struct *data)
 		DBG(cdev, "%s- count(%lld) not multiple of mtu(%d)\n", __func__,
 						count, dev->ep_out->maxpacket);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	dev->rx_done = 0;
+	while (count > 0) {
+		/*
+		 * Keep reads queued for as much of the transfer as is known,
+		 * so the host isn't held up while the file is written.  An
+		 * open ended transfer (0xFFFFFFFF) ends with a short packet,
+		 * only one read is queued ahead then so nothing past its end
+		 * is consumed.
+		 */
+		while (queued < RX_REQ_MAX && (count == 0xFFFFFFFF ?
+				queued == 0 : requested < count)) {
+			req = dev->rx_req[next_queue];
 
 			/* some h/w expects size to be aligned to ep's MTU */
-			read_req->length = mtp_rx_req_len;
+			req->length = mtp_rx_req_len;
 
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				if (dev->state != STATE_OFFLINE)
 					dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			next_queue = (next_queue + 1) % RX_REQ_MAX;
+			requested += req->length;
+			queued++;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %pK %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[next_done];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_done > completed || dev->state != STATE_BUSY);
+		if (dev->rx_done <= completed || dev->state != STATE_BUSY) {
+			if (dev->state == STATE_CANCELED)
+				r = -ECANCELED;
+			else
 				r = -EIO;
-				if (dev->state != STATE_OFFLINE)
-					dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+			goto out;
 		}
+		completed++;
+		queued--;
+		next_done = (next_done + 1) % RX_REQ_MAX;
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED
-					|| dev->state == STATE_OFFLINE) {
-				if (dev->state == STATE_OFFLINE)
-					r = -EIO;
-				else
-					r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* Check if we aligned the size due to MTU constraint */
-			if (count < read_req->length)
-				read_req->actual = (read_req->actual > count ?
-						count : read_req->actual);
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		DBG(cdev, "rx %pK %d\n", req, req->actual);
+		actual = req->actual;
+		/* Check if we aligned the size due to MTU constraint */
+		if (count < req->length && actual > count)
+			actual = count;
+		/* if xfer_file_length is 0xFFFFFFFF, then we read until
+		 * we get a zero length packet
+		 */
+		if (count != 0xFFFFFFFF)
+			count -= actual;
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
+			DBG(cdev, "got short packet\n");
+			count = 0;
+		}
 
-			write_req = read_req;
-			read_req = NULL;
+		if (!dev->rx_batch) {
+			ret = vfs_write(filp, req->buf, actual, &offset);
+			DBG(cdev, "vfs_write %d\n", ret);
+			if (ret != actual)
+				r = -EIO;
+		} else {
+			if (batched + actual > mtp_rx_batch_len)
+				r = mtp_rx_flush(dev, filp, &offset, &batched);
+			if (!r) {
+				memcpy(dev->rx_batch + batched, req->buf,
+						actual);
+				batched += actual;
+			}
 		}
+		if (r) {
+			if (dev->state != STATE_OFFLINE)
+				dev->state = STATE_ERROR;
+			goto out;
+		}
+	}
+
+	r = mtp_rx_flush(dev, filp, &offset, &batched);
+	if (r && dev->state != STATE_OFFLINE)
+		dev->state = STATE_ERROR;
+
+out:
+	/* drop the reads still queued after an error or an early EOF */
+	while (queued--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[next_done]);
+		next_done = (next_done + 1) % RX_REQ_MAX;
 	}
 
 	DBG(cdev, "receive_file_work returning %d\n", r);
@@ -1263,8 +1469,12 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
+	while ((req = mtp_req_get(dev, &dev->tx_sg_idle)))
+		mtp_sg_request_free(req, dev->ep_in);
 	for (i = 0; i < RX_REQ_MAX; i++)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+	vfree(dev->rx_batch);
+	dev->rx_batch = NULL;
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -1393,6 +1603,7 @@ static int mtp_setup(void)
 	atomic_set(&dev->open_excl, 0);
 	atomic_set(&dev->ioctl_excl, 0);
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->tx_sg_idle);
 	INIT_LIST_HEAD(&dev->intr_idle);
 
 	dev->wq = create_singlethread_workqueue("f_mtp");
@@ -232,33 +232,41 @@ static struct fsg_lun *fsg_lun_from_dev(struct device *dev)
 #define EP0_BUFSIZE	256
 #define DELAYED_STATUS	(EP0_BUFSIZE + 999)	/* An impossibly large value */
 
+#define FSG_MIN_NUM_BUFFERS	2
+#define FSG_MAX_NUM_BUFFERS	32
+
 #ifdef CONFIG_USB_CSW_HACK
 #define fsg_num_buffers		4
 #else
-#ifdef CONFIG_USB_GADGET_DEBUG_FILES
 
+/*
+ * Number of buffers we will use.
+ * 2 is usually enough for good buffering pipeline, a deeper ring keeps
+ * the bulk endpoints busy while the worker waits for the backing file.
+ */
 static unsigned int fsg_num_buffers = CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS;
 module_param_named(num_buffers, fsg_num_buffers, uint, S_IRUGO);
 MODULE_PARM_DESC(num_buffers, "Number of pipeline buffers");
 
-#else
+#endif /* CONFIG_USB_CSW_HACK */
 
 /*
- * Number of buffers we will use.
- * 2 is usually enough for good buffering pipeline
+ * Readahead window of the backing files.  Hosts read the medium in long
+ * sequential runs, so a window well above the block device default lets
+ * the page cache fetch the next LBA range while the current one is sent.
  */
-#define fsg_num_buffers	CONFIG_USB_GADGET_STORAGE_NUM_BUFFERS
-
-#endif /* CONFIG_USB_DEBUG */
-#endif /* CONFIG_USB_CSW_HACK */
+static unsigned int fsg_readahead_kb = 1024;
+module_param_named(readahead_kb, fsg_readahead_kb, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(readahead_kb, "Readahead window of the backing files in KB");
 
 /* check if fsg_num_buffers is within a valid range */
 static inline int fsg_num_buffers_validate(void)
 {
-	if (fsg_num_buffers >= 2 && fsg_num_buffers <= 4)
+	if (fsg_num_buffers >= FSG_MIN_NUM_BUFFERS &&
+	    fsg_num_buffers <= FSG_MAX_NUM_BUFFERS)
 		return 0;
 	pr_err("fsg_num_buffers %u is out of range (%d to %d)\n",
-	       fsg_num_buffers, 2 ,4);
+	       fsg_num_buffers, FSG_MIN_NUM_BUFFERS, FSG_MAX_NUM_BUFFERS);
 	return -EINVAL;
 }
 
@@ -722,6 +730,11 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		goto out;
 	}
 
+	/* Never shrink a window the backing device already asks for */
+	if (fsg_readahead_kb)
+		filp->f_ra.ra_pages = max_t(unsigned long, filp->f_ra.ra_pages,
+				fsg_readahead_kb >> (PAGE_CACHE_SHIFT - 10));
+
 	get_file(filp);
 	curlun->ro = ro;
 	curlun->filp = filp;
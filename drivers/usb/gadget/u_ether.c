@@ -19,6 +19,7 @@
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/hrtimer.h>
 
 #include "u_ether.h"
 
@@ -66,6 +67,7 @@ struct eth_dev {
 	int			no_tx_req_used;
 	int			tx_skb_hold_count;
 	u32			tx_req_bufsize;
+	struct hrtimer		tx_timer;
 
 	struct sk_buff_head	rx_frames;
 
@@ -97,6 +99,11 @@ static unsigned qmult = 10;
 module_param(qmult, uint, S_IRUGO|S_IWUSR);
 MODULE_PARM_DESC(qmult, "queue length multiplier at high/super speed");
 
+/* a partly filled multi packet transfer is sent after this long */
+static unsigned tx_aggr_usecs = 300;
+module_param(tx_aggr_usecs, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_aggr_usecs, "max time a packet waits for aggregation");
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget)
 {
@@ -456,6 +463,12 @@ static void process_rx_w(struct work_struct *work)
 	if (!dev->port_usb)
 		return;
 
+	/*
+	 * The frames unpacked from an aggregated transfer are handed to the
+	 * stack together, bottom halves run once for the whole batch instead
+	 * of once per frame as with netif_rx_ni().
+	 */
+	local_bh_disable();
 	while ((skb = skb_dequeue(&dev->rx_frames))) {
 		if (status < 0
 				|| ETH_HLEN > skb->len
@@ -470,8 +483,9 @@ static void process_rx_w(struct work_struct *work)
 		dev->net->stats.rx_packets++;
 		dev->net->stats.rx_bytes += skb->len;
 
-		status = netif_rx_ni(skb);
+		status = netif_rx(skb);
 	}
+	local_bh_enable();
 
 	if (netif_running(dev->net))
 		rx_fill(dev, GFP_KERNEL);
@@ -490,6 +504,30 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+/* set up the zlp framing of a tx request, returns the length to send */
+static int tx_req_framing(struct eth_dev *dev, struct usb_request *req,
+		struct usb_ep *in, int length)
+{
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (dev->port_usb->is_fixed &&
+	    length == dev->port_usb->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0) {
+		req->zero = 0;
+		length++;
+	}
+
+	return length;
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb;
@@ -543,27 +581,8 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 			list_del(&new_req->list);
 			spin_unlock(&dev->req_lock);
 			if (new_req->length > 0) {
-				length = new_req->length;
-
-				/* NCM requires no zlp if transfer is
-				 * dwNtbInMaxSize */
-				if (dev->port_usb->is_fixed &&
-					length == dev->port_usb->fixed_in_len &&
-					(length % in->maxpacket) == 0)
-					new_req->zero = 0;
-				else
-					new_req->zero = 1;
-
-				/* use zlp framing on tx for strict CDC-Ether
-				 * conformance, though any robust network rx
-				 * path ignores extra padding. and some hardware
-				 * doesn't like to write zlps.
-				 */
-				if (new_req->zero && !dev->zlp &&
-						(length % in->maxpacket) == 0) {
-					new_req->zero = 0;
-					length++;
-				}
+				length = tx_req_framing(dev, new_req, in,
+						new_req->length);
 
 				new_req->length = length;
 				retval = usb_ep_queue(in, new_req, GFP_ATOMIC);
@@ -579,6 +598,7 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 				case 0:
 					spin_lock(&dev->req_lock);
 					dev->no_tx_req_used++;
+					dev->tx_skb_hold_count = 0;
 					spin_unlock(&dev->req_lock);
 					net->trans_start = jiffies;
 				}
@@ -614,6 +634,65 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 		netif_wake_queue(dev->net);
 }
 
+/*
+ * Packets are only held for aggregation while enough transfers are in
+ * flight for one of their completions to send them.  The timer bounds the
+ * wait when the completions are slow to come.
+ */
+static enum hrtimer_restart tx_aggr_timeout(struct hrtimer *timer)
+{
+	struct eth_dev		*dev = container_of(timer, struct eth_dev,
+							tx_timer);
+	struct usb_request	*req = NULL;
+	struct usb_ep		*in = NULL;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		in = dev->port_usb->in_ep;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	if (!in)
+		return HRTIMER_NORESTART;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (dev->tx_skb_hold_count && !list_empty(&dev->tx_reqs)) {
+		req = container_of(dev->tx_reqs.next, struct usb_request,
+					list);
+		if (req->length > 0) {
+			list_del(&req->list);
+			dev->no_tx_req_used++;
+			dev->tx_skb_hold_count = 0;
+		} else {
+			req = NULL;
+		}
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (!req)
+		return HRTIMER_NORESTART;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb)
+		req->length = tx_req_framing(dev, req, in, req->length);
+	spin_unlock_irqrestore(&dev->lock, flags);
+	req->no_interrupt = 0;
+
+	if (usb_ep_queue(in, req, GFP_ATOMIC)) {
+		DBG(dev, "tx aggr queue err\n");
+		dev->net->stats.tx_dropped++;
+		req->length = 0;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		dev->no_tx_req_used--;
+		list_add_tail(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	} else {
+		dev->net->trans_start = jiffies;
+	}
+
+	return HRTIMER_NORESTART;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -774,6 +853,12 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 			if (dev->no_tx_req_used > TX_REQ_THRESHOLD) {
 				list_add(&req->list, &dev->tx_reqs);
 				spin_unlock_irqrestore(&dev->req_lock, flags);
+				if (tx_aggr_usecs &&
+					!hrtimer_active(&dev->tx_timer))
+					hrtimer_start(&dev->tx_timer,
+						ns_to_ktime(tx_aggr_usecs *
+							NSEC_PER_USEC),
+						HRTIMER_MODE_REL);
 				goto success;
 			}
 		}
@@ -788,23 +873,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		req->context = skb;
 	}
 
-	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-	if (dev->port_usb->is_fixed &&
-	    length == dev->port_usb->fixed_in_len &&
-	    (length % in->maxpacket) == 0)
-		req->zero = 0;
-	else
-		req->zero = 1;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0) {
-		req->zero = 0;
-		length++;
-	}
-
+	length = tx_req_framing(dev, req, in, length);
 	req->length = length;
 
 	/* throttle high/super speed IRQ rate back slightly */
@@ -1038,6 +1107,8 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_WORK(&dev->rx_work, process_rx_w);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_timer.function = tx_aggr_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
 
@@ -1226,6 +1297,7 @@ void gether_disconnect(struct gether *link)
 
 	netif_stop_queue(dev->net);
 	netif_carrier_off(dev->net);
+	hrtimer_cancel(&dev->tx_timer);
 
 	/* disable endpoints, forcing (synchronous) completion
 	 * of all pending i/o.  then free the request objects
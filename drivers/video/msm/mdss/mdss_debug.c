@@ -409,6 +409,11 @@ int mdss_debugfs_init(struct mdss_data_type *mdata)
 		return -ENODEV;
 	}
 
+	if (mdss_create_frame_debug(mdd)) {
+		mdss_debugfs_cleanup(mdd);
+		return -ENODEV;
+	}
+
 	mdata->debug_inf.debug_data = mdd;
 
 	return 0;
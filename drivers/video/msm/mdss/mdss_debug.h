@@ -38,6 +38,27 @@
 #define ATRACE_INT(name, value) \
 	trace_mdp_trace_counter(current->tgid, name, value)
 
+/**
+ * enum mdss_frame_stage - Stages timestamped by the frame latency records
+ * @MDSS_FRAME_QUEUED:	Commit queued by pan display
+ * @MDSS_FRAME_START:	Commit picked up by the commit thread
+ * @MDSS_FRAME_FENCE:	Acquire fences signaled
+ * @MDSS_FRAME_BEGIN:	Display commit started
+ * @MDSS_FRAME_CFG_DONE: Pipes, mixers and bandwidth programmed
+ * @MDSS_FRAME_FLUSHED:	Flush written to the hardware
+ * @MDSS_FRAME_DONE:	Vsync or pingpong done for the frame
+ */
+enum mdss_frame_stage {
+	MDSS_FRAME_QUEUED,
+	MDSS_FRAME_START,
+	MDSS_FRAME_FENCE,
+	MDSS_FRAME_BEGIN,
+	MDSS_FRAME_CFG_DONE,
+	MDSS_FRAME_FLUSHED,
+	MDSS_FRAME_DONE,
+	MDSS_FRAME_STAGE_MAX,
+};
+
 #ifdef CONFIG_DEBUG_FS
 struct mdss_debug_base {
 	struct mdss_debug_data *mdd;
@@ -62,6 +83,7 @@ struct mdss_debug_data {
 	struct dentry *root;
 	struct list_head base_list;
 	struct debug_log logd;
+	struct dentry *frame;
 };
 
 int mdss_debugfs_init(struct mdss_data_type *mdata);
@@ -79,6 +101,9 @@ void mdss_xlog(const char *name, ...);
 void mdss_xlog_dump(void);
 void mdss_dump_reg(char __iomem *base, int len);
 void mdss_xlog_tout_handler(const char *name, ...);
+
+int mdss_create_frame_debug(struct mdss_debug_data *mdd);
+void mdss_frame_stamp(int fb, enum mdss_frame_stage stage);
 #else
 static inline int mdss_debugfs_init(struct mdss_data_type *mdata) { return 0; }
 static inline int mdss_debug_register_base(const char *name, void __iomem *base,
@@ -100,5 +125,6 @@ static inline void mdss_xlog_dump(void) { }
 static inline void mdss_dump_reg(char __iomem *base, int len) { }
 static inline void mdss_dsi_debug_check_te(struct mdss_panel_data *pdata) { }
 static inline void mdss_xlog_tout_handler(const char *name, ...) { }
+static inline void mdss_frame_stamp(int fb, enum mdss_frame_stage stage) { }
 #endif
 #endif /* MDSS_DEBUG_H */
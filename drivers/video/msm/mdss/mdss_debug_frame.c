@@ -0,0 +1,280 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/string.h>
+
+#include "mdss.h"
+#include "mdss_mdp.h"
+#include "mdss_debug.h"
+
+/*
+ * Per frame latency records. A frame is opened when it is queued by
+ * pan display, stamped as it moves through the commit thread and the
+ * ctl notifier events, and handed over to the in flight queue once it is
+ * flushed to the hardware. The oldest in flight frame is completed by the
+ * next frame done (vsync or pingpong done) and then lands in a ring of
+ * records and a histogram of its queue to done latency.
+ */
+
+#define MDSS_FRAME_MAX_FB	4
+#define MDSS_FRAME_INFLIGHT	2
+#define MDSS_FRAME_ENTRY	128
+#define MDSS_FRAME_HIST_BUCKETS	34	/* 1ms buckets, last one is overflow */
+
+struct mdss_frame_record {
+	u32 fb;
+	u32 seq;
+	ktime_t t[MDSS_FRAME_STAGE_MAX];
+};
+
+struct mdss_frame_fb {
+	struct mdss_frame_record cur;
+	bool cur_valid;
+	struct mdss_frame_record inflight[MDSS_FRAME_INFLIGHT];
+	int inflight_cnt;
+	u32 seq;
+	u32 dropped;
+	u32 hist[MDSS_FRAME_HIST_BUCKETS];
+};
+
+struct mdss_dbg_frame {
+	struct mdss_frame_fb fbs[MDSS_FRAME_MAX_FB];
+	struct mdss_frame_record records[MDSS_FRAME_ENTRY];
+	int first;
+	int cnt;
+	u32 enable;
+	spinlock_t lock;
+} mdss_dbg_frame;
+
+static const char * const mdss_frame_stage_names[MDSS_FRAME_STAGE_MAX] = {
+	[MDSS_FRAME_QUEUED] = "queued",
+	[MDSS_FRAME_START] = "start",
+	[MDSS_FRAME_FENCE] = "fence",
+	[MDSS_FRAME_BEGIN] = "begin",
+	[MDSS_FRAME_CFG_DONE] = "cfg",
+	[MDSS_FRAME_FLUSHED] = "flush",
+	[MDSS_FRAME_DONE] = "done",
+};
+
+static void mdss_frame_complete(struct mdss_frame_fb *ffb,
+		struct mdss_frame_record *rec)
+{
+	s64 us;
+	int bucket;
+
+	mdss_dbg_frame.records[mdss_dbg_frame.first] = *rec;
+	mdss_dbg_frame.first = (mdss_dbg_frame.first + 1) % MDSS_FRAME_ENTRY;
+	if (mdss_dbg_frame.cnt < MDSS_FRAME_ENTRY)
+		mdss_dbg_frame.cnt++;
+
+	us = ktime_us_delta(rec->t[MDSS_FRAME_DONE], rec->t[MDSS_FRAME_QUEUED]);
+	bucket = (int) min_t(s64, us / USEC_PER_MSEC,
+			MDSS_FRAME_HIST_BUCKETS - 1);
+	ffb->hist[bucket]++;
+}
+
+/**
+ * mdss_frame_stamp() - Timestamp a stage of the current frame
+ * @fb:		Index of the framebuffer the frame belongs to
+ * @stage:	Stage the frame just went through
+ *
+ * MDSS_FRAME_QUEUED opens a new record, MDSS_FRAME_FLUSHED moves it to the
+ * in flight queue and MDSS_FRAME_DONE completes the oldest in flight frame.
+ * Frames that never reach the hardware are discarded by the next queue.
+ */
+void mdss_frame_stamp(int fb, enum mdss_frame_stage stage)
+{
+	struct mdss_frame_fb *ffb;
+	struct mdss_frame_record *rec;
+	unsigned long flags;
+	ktime_t now;
+	int i;
+
+	if (!mdss_dbg_frame.enable || fb < 0 || fb >= MDSS_FRAME_MAX_FB ||
+	    stage >= MDSS_FRAME_STAGE_MAX)
+		return;
+
+	now = ktime_get();
+	ffb = &mdss_dbg_frame.fbs[fb];
+
+	spin_lock_irqsave(&mdss_dbg_frame.lock, flags);
+	switch (stage) {
+	case MDSS_FRAME_QUEUED:
+		memset(&ffb->cur, 0, sizeof(ffb->cur));
+		ffb->cur.fb = fb;
+		ffb->cur.seq = ffb->seq++;
+		ffb->cur.t[stage] = now;
+		ffb->cur_valid = true;
+		break;
+	case MDSS_FRAME_FLUSHED:
+		if (!ffb->cur_valid)
+			break;
+		ffb->cur.t[stage] = now;
+		ffb->cur_valid = false;
+		if (ffb->inflight_cnt == MDSS_FRAME_INFLIGHT) {
+			/* a frame done was missed, forget the oldest frame */
+			for (i = 1; i < MDSS_FRAME_INFLIGHT; i++)
+				ffb->inflight[i - 1] = ffb->inflight[i];
+			ffb->inflight_cnt--;
+			ffb->dropped++;
+		}
+		ffb->inflight[ffb->inflight_cnt++] = ffb->cur;
+		break;
+	case MDSS_FRAME_DONE:
+		if (!ffb->inflight_cnt)
+			break;
+		rec = &ffb->inflight[0];
+		rec->t[stage] = now;
+		mdss_frame_complete(ffb, rec);
+		for (i = 1; i < ffb->inflight_cnt; i++)
+			ffb->inflight[i - 1] = ffb->inflight[i];
+		ffb->inflight_cnt--;
+		break;
+	default:
+		if (ffb->cur_valid)
+			ffb->cur.t[stage] = now;
+		break;
+	}
+	spin_unlock_irqrestore(&mdss_dbg_frame.lock, flags);
+}
+
+static int mdss_frame_records_show(struct seq_file *s, void *unused)
+{
+	struct mdss_frame_record *rec;
+	unsigned long flags;
+	int i, n, stage;
+
+	seq_puts(s, "fb seq");
+	for (stage = 0; stage < MDSS_FRAME_STAGE_MAX; stage++)
+		seq_printf(s, " %s", mdss_frame_stage_names[stage]);
+	seq_puts(s, " (us from queued)\n");
+
+	spin_lock_irqsave(&mdss_dbg_frame.lock, flags);
+	i = (mdss_dbg_frame.first + MDSS_FRAME_ENTRY - mdss_dbg_frame.cnt) %
+		MDSS_FRAME_ENTRY;
+	for (n = 0; n < mdss_dbg_frame.cnt; n++) {
+		rec = &mdss_dbg_frame.records[i];
+		seq_printf(s, "%u %u", rec->fb, rec->seq);
+		for (stage = 0; stage < MDSS_FRAME_STAGE_MAX; stage++) {
+			if (!ktime_to_ns(rec->t[stage]))
+				seq_puts(s, " -");
+			else
+				seq_printf(s, " %lld", ktime_us_delta(
+					rec->t[stage],
+					rec->t[MDSS_FRAME_QUEUED]));
+		}
+		seq_puts(s, "\n");
+		i = (i + 1) % MDSS_FRAME_ENTRY;
+	}
+	spin_unlock_irqrestore(&mdss_dbg_frame.lock, flags);
+
+	return 0;
+}
+
+static int mdss_frame_records_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mdss_frame_records_show, inode->i_private);
+}
+
+static const struct file_operations mdss_frame_records_fops = {
+	.open = mdss_frame_records_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mdss_frame_hist_show(struct seq_file *s, void *unused)
+{
+	struct mdss_frame_fb *ffb;
+	unsigned long flags;
+	int fb, i;
+
+	spin_lock_irqsave(&mdss_dbg_frame.lock, flags);
+	for (fb = 0; fb < MDSS_FRAME_MAX_FB; fb++) {
+		ffb = &mdss_dbg_frame.fbs[fb];
+		if (!ffb->seq)
+			continue;
+
+		seq_printf(s, "fb%d: frames=%u dropped=%u\n", fb, ffb->seq,
+				ffb->dropped);
+		for (i = 0; i < MDSS_FRAME_HIST_BUCKETS - 1; i++) {
+			if (ffb->hist[i])
+				seq_printf(s, "  %2d-%2dms: %u\n", i, i + 1,
+						ffb->hist[i]);
+		}
+		if (ffb->hist[i])
+			seq_printf(s, "  >=%dms: %u\n", i, ffb->hist[i]);
+	}
+	spin_unlock_irqrestore(&mdss_dbg_frame.lock, flags);
+
+	return 0;
+}
+
+static int mdss_frame_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mdss_frame_hist_show, inode->i_private);
+}
+
+static ssize_t mdss_frame_hist_write(struct file *file,
+		const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct mdss_frame_fb *ffb;
+	unsigned long flags;
+	int fb;
+
+	/* any write clears the histograms and the records */
+	spin_lock_irqsave(&mdss_dbg_frame.lock, flags);
+	for (fb = 0; fb < MDSS_FRAME_MAX_FB; fb++) {
+		ffb = &mdss_dbg_frame.fbs[fb];
+		memset(ffb->hist, 0, sizeof(ffb->hist));
+		ffb->dropped = 0;
+	}
+	mdss_dbg_frame.first = 0;
+	mdss_dbg_frame.cnt = 0;
+	spin_unlock_irqrestore(&mdss_dbg_frame.lock, flags);
+
+	return count;
+}
+
+static const struct file_operations mdss_frame_hist_fops = {
+	.open = mdss_frame_hist_open,
+	.read = seq_read,
+	.write = mdss_frame_hist_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int mdss_create_frame_debug(struct mdss_debug_data *mdd)
+{
+	spin_lock_init(&mdss_dbg_frame.lock);
+	mdss_dbg_frame.enable = 1;
+
+	mdd->frame = debugfs_create_dir("frame", mdd->root);
+	if (IS_ERR_OR_NULL(mdd->frame)) {
+		pr_err("debugfs_create_dir fail, error %ld\n",
+		       PTR_ERR(mdd->frame));
+		mdd->frame = NULL;
+		return -ENODEV;
+	}
+	debugfs_create_file("records", 0444, mdd->frame, NULL,
+			    &mdss_frame_records_fops);
+	debugfs_create_file("histogram", 0644, mdd->frame, NULL,
+			    &mdss_frame_hist_fops);
+	debugfs_create_bool("enable", 0644, mdd->frame,
+			    &mdss_dbg_frame.enable);
+	return 0;
+}
@@ -55,6 +55,7 @@
 #include <mach/msm_memtypes.h>
 
 #include "mdss_fb.h"
+#include "mdss_debug.h"
 #include "mdss_mdp_splash_logo.h"
 
 #include "mdss_livedisplay.h"
@@ -369,10 +370,16 @@ static void __mdss_fb_idle_notify_work(struct work_struct *work)
 	struct delayed_work *dw = to_delayed_work(work);
 	struct msm_fb_data_type *mfd = container_of(dw, struct msm_fb_data_type,
 		idle_notify_work);
+	struct fb_event event;
 
 	/* Notify idle-ness here */
 	pr_debug("Idle timeout %dms expired!\n", mfd->idle_time);
 	sysfs_notify(&mfd->fbi->dev->kobj, NULL, "idle_notify");
+
+	/* Let in-kernel clients (e.g. cpu-boost) see it as well */
+	event.info = mfd->fbi;
+	event.data = NULL;
+	fb_notifier_call_chain(FB_EVENT_IDLE, &event);
 }
 
 static ssize_t mdss_fb_get_idle_time(struct device *dev,
@@ -1171,7 +1178,8 @@ static int mdss_fb_blank_unblank(struct msm_fb_data_type *mfd)
 
 		/* Start the work thread to signal idle time */
 		if (mfd->idle_time)
-			schedule_delayed_work(&mfd->idle_notify_work,
+			queue_delayed_work(system_power_efficient_wq,
+				&mfd->idle_notify_work,
 				msecs_to_jiffies(mfd->idle_time));
 	}
 
@@ -2389,9 +2397,11 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 
 	switch (event) {
 	case MDP_NOTIFY_FRAME_BEGIN:
+		mdss_frame_stamp(mfd->index, MDSS_FRAME_BEGIN);
 		if (mfd->idle_time) {
 			cancel_delayed_work_sync(&mfd->idle_notify_work);
-			schedule_delayed_work(&mfd->idle_notify_work,
+			queue_delayed_work(system_power_efficient_wq,
+				&mfd->idle_notify_work,
 				msecs_to_jiffies(mfd->idle_time));
 		}
 		break;
@@ -2402,10 +2412,12 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 			sync_pt_data->temp_fen_cnt = 0;
 			__mdss_fb_wait_for_fence_sub(sync_pt_data,
 				sync_pt_data->temp_fen, fence_cnt);
+			mdss_frame_stamp(mfd->index, MDSS_FRAME_FENCE);
 		}
 		break;
 	case MDP_NOTIFY_FRAME_FLUSHED:
 		pr_debug("%s: frame flushed\n", sync_pt_data->fence_name);
+		mdss_frame_stamp(mfd->index, MDSS_FRAME_FLUSHED);
 		sync_pt_data->flushed = true;
 		break;
 	case MDP_NOTIFY_FRAME_TIMEOUT:
@@ -2414,9 +2426,11 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 		break;
 	case MDP_NOTIFY_FRAME_DONE:
 		pr_debug("%s: frame done\n", sync_pt_data->fence_name);
+		mdss_frame_stamp(mfd->index, MDSS_FRAME_DONE);
 		mdss_fb_signal_timeline(sync_pt_data);
 		break;
 	case MDP_NOTIFY_FRAME_CFG_DONE:
+		mdss_frame_stamp(mfd->index, MDSS_FRAME_CFG_DONE);
 		if (sync_pt_data->async_wait_fences)
 			__mdss_fb_copy_fence(sync_pt_data,
 					sync_pt_data->temp_fen,
@@ -2534,6 +2548,7 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 	atomic_inc(&mfd->mdp_sync_pt_data.commit_cnt);
 	atomic_inc(&mfd->commits_pending);
 	atomic_inc(&mfd->kickoff_pending);
+	mdss_frame_stamp(mfd->index, MDSS_FRAME_QUEUED);
 	wake_up_all(&mfd->commit_wait_q);
 	mutex_unlock(&mfd->mdp_sync_pt_data.sync_mutex);
 	if (wait_for_finish)
@@ -2614,8 +2629,11 @@ static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd)
 	struct msm_fb_backup_type *fb_backup = &mfd->msm_fb_backup;
 	int ret = -ENOSYS;
 
-	if (!sync_pt_data->async_wait_fences)
+	mdss_frame_stamp(mfd->index, MDSS_FRAME_START);
+	if (!sync_pt_data->async_wait_fences) {
 		mdss_fb_wait_for_fence(sync_pt_data);
+		mdss_frame_stamp(mfd->index, MDSS_FRAME_FENCE);
+	}
 	sync_pt_data->flushed = false;
 
 	if (fb_backup->disp_commit.flags & MDP_DISPLAY_COMMIT_OVERLAY) {
@@ -2632,8 +2650,12 @@ static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd)
 			pr_err("pan display failed %x on fb%d\n", ret,
 					mfd->index);
 	}
-	if (!ret)
+	if (!ret) {
 		mdss_fb_update_backlight(mfd);
+		/* devices deferred at boot can probe once a frame is out */
+		if (mfd->index == 0)
+			run_deferred_initcalls();
+	}
 
 	if (IS_ERR_VALUE(ret) || !sync_pt_data->flushed) {
 		mdss_fb_release_kickoff(mfd);
@@ -2989,6 +3011,7 @@ static int mdss_fb_handle_buf_sync_ioctl(struct msm_sync_pt_data *sync_pt_data,
 	int rel_fen_fd;
 	int retire_fen_fd;
 	int val;
+	u32 start;
 
 	if ((buf_sync->acq_fen_fd_cnt > MDP_MAX_FENCE_FD) ||
 				(sync_pt_data->timeline == NULL))
@@ -3002,14 +3025,33 @@ static int mdss_fb_handle_buf_sync_ioctl(struct msm_sync_pt_data *sync_pt_data,
 		return ret;
 	}
 
-	if (sync_pt_data->acq_fen_cnt) {
+	mutex_lock(&sync_pt_data->sync_mutex);
+
+	/*
+	 * The fences of a frame that the display thread hasn't picked up yet
+	 * are still pending. Rather than blocking the caller until the GPU is
+	 * done with them, add the new fences to the same set so the next
+	 * kickoff waits for both; waiting early for the newer frame is safe.
+	 * Only wait here when they don't fit together.
+	 */
+	if (sync_pt_data->acq_fen_cnt &&
+			(sync_pt_data->acq_fen_cnt + buf_sync->acq_fen_fd_cnt >
+			 MDP_MAX_FENCE_FD)) {
 		pr_warn("%s: currently %d fences active. waiting...\n",
 				sync_pt_data->fence_name,
 				sync_pt_data->acq_fen_cnt);
+		mutex_unlock(&sync_pt_data->sync_mutex);
 		mdss_fb_wait_for_fence(sync_pt_data);
+		mutex_lock(&sync_pt_data->sync_mutex);
+	}
+
+	start = sync_pt_data->acq_fen_cnt;
+	if (start + buf_sync->acq_fen_fd_cnt > MDP_MAX_FENCE_FD) {
+		ret = -EBUSY;
+		mutex_unlock(&sync_pt_data->sync_mutex);
+		return ret;
 	}
 
-	mutex_lock(&sync_pt_data->sync_mutex);
 	for (i = 0; i < buf_sync->acq_fen_fd_cnt; i++) {
 		fence = sync_fence_fdget(acq_fen_fd[i]);
 		if (fence == NULL) {
@@ -3019,9 +3061,9 @@ static int mdss_fb_handle_buf_sync_ioctl(struct msm_sync_pt_data *sync_pt_data,
 			ret = -EINVAL;
 			break;
 		}
-		sync_pt_data->acq_fen[i] = fence;
+		sync_pt_data->acq_fen[start + i] = fence;
 	}
-	sync_pt_data->acq_fen_cnt = i;
+	sync_pt_data->acq_fen_cnt = start + i;
 	if (ret)
 		goto buf_sync_err_1;
 
@@ -3108,9 +3150,9 @@ buf_sync_err_3:
 buf_sync_err_2:
 	sync_fence_put(rel_fence);
 buf_sync_err_1:
-	for (i = 0; i < sync_pt_data->acq_fen_cnt; i++)
+	for (i = start; i < sync_pt_data->acq_fen_cnt; i++)
 		sync_fence_put(sync_pt_data->acq_fen[i]);
-	sync_pt_data->acq_fen_cnt = 0;
+	sync_pt_data->acq_fen_cnt = start;
 	mutex_unlock(&sync_pt_data->sync_mutex);
 	return ret;
 }
@@ -3051,7 +3051,8 @@ static int hdmi_tx_dev_init(struct hdmi_tx_ctrl *hdmi_ctrl)
 
 	INIT_LIST_HEAD(&hdmi_ctrl->cable_notify_handlers);
 
-	hdmi_ctrl->workq = create_workqueue("hdmi_tx_workq");
+	hdmi_ctrl->workq = alloc_workqueue("hdmi_tx_workq",
+		WQ_MEM_RECLAIM | WQ_POWER_EFFICIENT, 1);
 	if (!hdmi_ctrl->workq) {
 		DEV_ERR("%s: hdmi_tx_workq creation failed.\n", __func__);
 		rc = -EPERM;
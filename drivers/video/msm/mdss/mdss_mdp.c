@@ -53,6 +53,7 @@
 #include "mdss.h"
 #include "mdss_fb.h"
 #include "mdss_mdp.h"
+#include "mdss_mdp_rotator.h"
 #include "mdss_panel.h"
 #include "mdss_debug.h"
 
@@ -1400,6 +1401,9 @@ static int mdss_mdp_probe(struct platform_device *pdev)
 		pr_err("unable to initialize mdss pp resources\n");
 		goto probe_done;
 	}
+	rc = mdss_mdp_rotator_init();
+	if (rc)
+		goto probe_done;
 	rc = mdss_mdp_bus_scale_register(mdata);
 	if (rc) {
 		pr_err("unable to register bus scaling\n");
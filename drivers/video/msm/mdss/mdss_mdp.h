@@ -175,6 +175,30 @@ struct mdss_mdp_perf_params {
 	u32 mdp_clk_rate;
 };
 
+/*
+ * Everything mdss_mdp_perf_calc_pipe() depends on. If it matches the last
+ * calculation of a pipe the cached result is reused.
+ */
+struct mdss_mdp_perf_key {
+	struct mdss_mdp_img_rect src;
+	struct mdss_mdp_img_rect dst;
+	struct mdss_mdp_format_params *fmt;
+	u32 flags;
+	u32 bwc_mode;
+	u32 smp_bytes;
+	u32 fps;
+	u32 v_total;
+	u32 xres;
+	u32 mixer_num;
+	u32 mixer_type;
+	u8 rotator_mode;
+	u8 is_video_mode;
+	u8 vert_deci;
+	u8 is_fbc;
+	u8 is_caf;
+	u8 apply_fudge;
+};
+
 struct mdss_mdp_ctl {
 	u32 num;
 	char __iomem *base;
@@ -190,6 +214,7 @@ struct mdss_mdp_ctl {
 
 	bool is_video_mode;
 	u32 play_cnt;
+	bool pc_restore;
 	u32 vsync_cnt;
 	u32 underrun_cnt;
 
@@ -203,6 +228,8 @@ struct mdss_mdp_ctl {
 	struct mdss_mdp_perf_params cur_perf;
 	struct mdss_mdp_perf_params new_perf;
 	u32 perf_transaction_status;
+	u32 perf_bw_hold;
+	u32 perf_clk_hold;
 
 	struct mdss_data_type *mdata;
 	struct msm_fb_data_type *mfd;
@@ -424,6 +451,10 @@ struct mdss_mdp_pipe {
 	u8 vert_deci;
 	struct mdss_mdp_img_rect src;
 	struct mdss_mdp_img_rect dst;
+	struct mdss_mdp_img_rect prev_dst; /* dst of the last kickoff */
+	struct mdss_mdp_perf_key perf_key;
+	struct mdss_mdp_perf_params perf_cache;
+	bool perf_cache_valid;
 	struct mdss_mdp_format_params *src_fmt;
 	struct mdss_mdp_plane_sizes src_planes;
 
@@ -499,6 +530,17 @@ struct mdss_overlay_private {
 	struct work_struct retire_work;
 	int retire_cnt;
 	bool kickoff_released;
+
+	/* static screen detection, see __overlay_static_update() */
+	u32 static_frames;
+	u32 static_cnt;
+	bool static_screen;
+
+	/* content rate driven fps, see __overlay_dfps_kickoff() */
+	bool dfps_auto;
+	ktime_t dfps_last_kickoff;
+	u32 dfps_avg_us;
+	struct delayed_work dfps_work;
 };
 
 struct mdss_mdp_commit_cb {
@@ -785,6 +827,8 @@ void mdss_mdp_intersect_rect(struct mdss_mdp_img_rect *res_rect,
 void mdss_mdp_crop_rect(struct mdss_mdp_img_rect *src_rect,
 	struct mdss_mdp_img_rect *dst_rect,
 	const struct mdss_mdp_img_rect *sci_rect);
+void mdss_mdp_union_rect(struct mdss_mdp_img_rect *res_rect,
+	const struct mdss_mdp_img_rect *rect);
 
 
 int mdss_mdp_wb_kickoff(struct msm_fb_data_type *mfd,
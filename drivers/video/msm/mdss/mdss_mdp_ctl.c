@@ -326,6 +326,7 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 	struct mdss_mdp_img_rect src, dst;
 	bool is_fbc = false;
 	struct mdss_mdp_prefill_params prefill_params;
+	struct mdss_mdp_perf_key key;
 
 	if (!pipe || !perf || !pipe->mixer)
 		return -EINVAL;
@@ -357,6 +358,32 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 	if (roi)
 		mdss_mdp_crop_rect(&src, &dst, roi);
 
+	/* memset so that the padding compares equal too */
+	memset(&key, 0, sizeof(key));
+	key.src = src;
+	key.dst = dst;
+	key.fmt = pipe->src_fmt;
+	key.flags = pipe->flags;
+	key.bwc_mode = pipe->bwc_mode;
+	key.smp_bytes = mdss_mdp_smp_get_size(pipe);
+	key.fps = fps;
+	key.v_total = v_total;
+	key.xres = xres;
+	key.mixer_num = mixer->num;
+	key.mixer_type = mixer->type;
+	key.rotator_mode = mixer->rotator_mode;
+	key.is_video_mode = mixer->ctl->is_video_mode;
+	key.vert_deci = pipe->vert_deci;
+	key.is_fbc = is_fbc;
+	key.is_caf = mdss_mdp_perf_is_caf(pipe);
+	key.apply_fudge = apply_fudge;
+
+	if (pipe->perf_cache_valid &&
+			!memcmp(&key, &pipe->perf_key, sizeof(key))) {
+		*perf = pipe->perf_cache;
+		return 0;
+	}
+
 	pr_debug("v_total=%d, xres=%d fps=%d\n", v_total, xres, fps);
 
 	/*
@@ -402,7 +429,7 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 	else
 		perf->mdp_clk_rate = rate;
 
-	prefill_params.smp_bytes = mdss_mdp_smp_get_size(pipe);
+	prefill_params.smp_bytes = key.smp_bytes;
 	prefill_params.xres = xres;
 	prefill_params.src_w = src.w;
 	prefill_params.src_h = src_h;
@@ -411,7 +438,7 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 	prefill_params.dst_y = dst.y;
 	prefill_params.bpp = pipe->src_fmt->bpp;
 	prefill_params.is_yuv = pipe->src_fmt->is_yuv;
-	prefill_params.is_caf = mdss_mdp_perf_is_caf(pipe);
+	prefill_params.is_caf = key.is_caf;
 	prefill_params.is_fbc = is_fbc;
 	prefill_params.is_bwc = pipe->bwc_mode;
 	prefill_params.is_tile = pipe->src_fmt->tile;
@@ -429,6 +456,10 @@ int mdss_mdp_perf_calc_pipe(struct mdss_mdp_pipe *pipe,
 		 mixer->num, pipe->num, perf->mdp_clk_rate, perf->bw_overlap,
 		 perf->prefill_bytes);
 
+	pipe->perf_key = key;
+	pipe->perf_cache = *perf;
+	pipe->perf_cache_valid = true;
+
 	return 0;
 }
 
@@ -868,6 +899,19 @@ u32 mdss_mdp_ctl_perf_get_transaction_status(struct mdss_mdp_ctl *ctl)
 	return transaction_status;
 }
 
+/*
+ * Number of frames a higher bandwidth or clock vote is kept after the
+ * composition got lighter, so scrolling and layers coming and going don't
+ * bounce the votes around.
+ */
+#define MDSS_MDP_PERF_HOLD_FRAMES	3
+
+/* Last votes and when they were made, protected by mdss_mdp_ctl_lock */
+static u64 mdss_mdp_bus_vote;
+static ktime_t mdss_mdp_bus_vote_time;
+static u32 mdss_mdp_clk_vote;
+static ktime_t mdss_mdp_clk_vote_time;
+
 static inline void mdss_mdp_ctl_perf_update_bus(struct mdss_mdp_ctl *ctl)
 {
 	u64 bw_sum_of_intfs = 0;
@@ -892,6 +936,14 @@ static inline void mdss_mdp_ctl_perf_update_bus(struct mdss_mdp_ctl *ctl)
 	bus_ab_quota = apply_fudge_factor(bw_sum_of_intfs,
 		&mdss_res->ab_factor);
 	trace_mdp_perf_update_bus(bus_ab_quota, bus_ib_quota);
+	if (bus_ib_quota != mdss_mdp_bus_vote) {
+		ktime_t now = ktime_get();
+
+		trace_mdp_perf_bus_vote(mdss_mdp_bus_vote, bus_ib_quota,
+			(u32) ktime_us_delta(now, mdss_mdp_bus_vote_time));
+		mdss_mdp_bus_vote = bus_ib_quota;
+		mdss_mdp_bus_vote_time = now;
+	}
 	ATRACE_INT("bus_quota", bus_ib_quota);
 	mdss_bus_scale_set_quota(MDSS_HW_MDP, bus_ab_quota, bus_ib_quota);
 	pr_debug("ab=%llu ib=%llu\n", bus_ab_quota, bus_ib_quota);
@@ -969,6 +1021,22 @@ static int mdss_mdp_select_clk_lvl(struct mdss_mdp_ctl *ctl,
 	return clk_rate;
 }
 
+/*
+ * __mdss_mdp_perf_vote_lower() - decide whether a lower vote can be applied
+ * @hold: per ctl count of frames the lower vote has been pending
+ *
+ * Returns true once the lower vote has been asked for on
+ * MDSS_MDP_PERF_HOLD_FRAMES frames in a row.
+ */
+static inline bool __mdss_mdp_perf_vote_lower(u32 *hold)
+{
+	if (++(*hold) < MDSS_MDP_PERF_HOLD_FRAMES)
+		return false;
+
+	*hold = 0;
+	return true;
+}
+
 static void mdss_mdp_ctl_perf_update(struct mdss_mdp_ctl *ctl,
 		int params_changed)
 {
@@ -1000,8 +1068,12 @@ static void mdss_mdp_ctl_perf_update(struct mdss_mdp_ctl *ctl,
 		 * later once the hw configuration has been flushed to
 		 * MDP
 		 */
+		if (!params_changed && (new->bw_ctl >= old->bw_ctl))
+			ctl->perf_bw_hold = 0;
+
 		if ((params_changed && (new->bw_ctl > old->bw_ctl)) ||
-		    (!params_changed && (new->bw_ctl < old->bw_ctl))) {
+		    (!params_changed && (new->bw_ctl < old->bw_ctl) &&
+		     __mdss_mdp_perf_vote_lower(&ctl->perf_bw_hold))) {
 			pr_debug("c=%d p=%d new_bw=%llu,old_bw=%llu\n",
 				ctl->num, params_changed, new->bw_ctl,
 				old->bw_ctl);
@@ -1009,15 +1081,22 @@ static void mdss_mdp_ctl_perf_update(struct mdss_mdp_ctl *ctl,
 			update_bus = 1;
 		}
 
+		if (!params_changed &&
+				(new->mdp_clk_rate >= old->mdp_clk_rate))
+			ctl->perf_clk_hold = 0;
+
 		if ((params_changed && (new->mdp_clk_rate > old->mdp_clk_rate))
 		    || (!params_changed && (new->mdp_clk_rate <
-					    old->mdp_clk_rate))) {
+					    old->mdp_clk_rate) &&
+			__mdss_mdp_perf_vote_lower(&ctl->perf_clk_hold))) {
 			old->mdp_clk_rate = new->mdp_clk_rate;
 			update_clk = 1;
 		}
 	} else {
 		memset(old, 0, sizeof(old));
 		memset(new, 0, sizeof(new));
+		ctl->perf_bw_hold = 0;
+		ctl->perf_clk_hold = 0;
 		update_bus = 1;
 		update_clk = 1;
 	}
@@ -1038,6 +1117,15 @@ static void mdss_mdp_ctl_perf_update(struct mdss_mdp_ctl *ctl,
 		}
 
 		clk_rate  = mdss_mdp_select_clk_lvl(ctl, clk_rate);
+		if (clk_rate != mdss_mdp_clk_vote) {
+			ktime_t now = ktime_get();
+
+			trace_mdp_perf_clk_vote(mdss_mdp_clk_vote, clk_rate,
+				(u32) ktime_us_delta(now,
+					mdss_mdp_clk_vote_time));
+			mdss_mdp_clk_vote = clk_rate;
+			mdss_mdp_clk_vote_time = now;
+		}
 		ATRACE_INT("mdp_clk", clk_rate);
 		mdss_mdp_set_clk_rate(clk_rate);
 		pr_debug("update clk rate = %d HZ\n", clk_rate);
@@ -1761,7 +1849,9 @@ static void mdss_mdp_ctl_restore_sub(struct mdss_mdp_ctl *ctl)
  *
  * This function is called whenever MDP comes out of a power collapse as
  * a result of a screen update. It restores the MDP controller's software
- * state to the hardware registers.
+ * state to the hardware registers. Only the interface and tearcheck setup
+ * is written here, the rest of the path is marked through pc_restore and
+ * reapplied by the next kickoff, see mdss_mdp_ctl_pc_restore().
  */
 void mdss_mdp_ctl_restore(void)
 {
@@ -1778,7 +1868,8 @@ void mdss_mdp_ctl_restore(void)
 
 		pr_debug("restoring ctl%d, intf_type=%d\n", cnum,
 			ctl->intf_type);
-		ctl->play_cnt = 0;
+		/* pipes, mixers and dspp are reprogrammed on next kickoff */
+		ctl->pc_restore = true;
 		sctl = mdss_mdp_get_split_ctl(ctl);
 		mdss_mdp_ctl_restore_sub(ctl);
 		if (sctl) {
@@ -2624,6 +2715,46 @@ int mdss_mdp_display_wait4pingpong(struct mdss_mdp_ctl *ctl)
 	return ret;
 }
 
+/**
+ * mdss_mdp_ctl_pc_restore() - reapply mixer state lost in idle power collapse
+ * @ctl:	Control path that was restored by mdss_mdp_ctl_restore()
+ * @sctl:	Split display control path, or NULL
+ *
+ * The panel still holds the last frame, so instead of going through the
+ * full ctl start sequence only what the kickoff itself does not program is
+ * marked here: the mixers are set to be reprogrammed and the dspp post
+ * processing features that are enabled are flagged dirty so that
+ * mdss_mdp_pp_setup_locked() writes them back from the driver's copy.
+ * Must be called with ctl->lock held and the clocks on.
+ */
+static void mdss_mdp_ctl_pc_restore(struct mdss_mdp_ctl *ctl,
+		struct mdss_mdp_ctl *sctl)
+{
+	struct mdss_mdp_ctl *tmp = ctl;
+
+	ATRACE_BEGIN(__func__);
+	MDSS_XLOG(ctl->num, ctl->play_cnt);
+	do {
+		if (tmp->mixer_left) {
+			mdss_mdp_pp_resume(tmp, tmp->mixer_left->num);
+			tmp->mixer_left->params_changed++;
+		}
+		if (tmp->mixer_right) {
+			mdss_mdp_pp_resume(tmp, tmp->mixer_right->num);
+			tmp->mixer_right->params_changed++;
+			if (!sctl)
+				mdss_mdp_ctl_write(tmp,
+					MDSS_MDP_REG_CTL_PACK_3D, 0);
+		}
+		if (tmp->panel_data->panel_info.fbc.enabled)
+			mdss_mdp_ctl_fbc_enable(1, tmp->mixer_left,
+					&tmp->panel_data->panel_info);
+		tmp->pc_restore = false;
+		tmp = (tmp == ctl) ? sctl : NULL;
+	} while (tmp);
+	ATRACE_END(__func__);
+}
+
 int mdss_mdp_display_commit(struct mdss_mdp_ctl *ctl, void *arg,
 	struct mdss_mdp_commit_cb *commit_cb)
 {
@@ -2647,11 +2778,14 @@ int mdss_mdp_display_commit(struct mdss_mdp_ctl *ctl, void *arg,
 
 	sctl = mdss_mdp_get_split_ctl(ctl);
 
+	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON);
+
+	if (ctl->pc_restore || (sctl && sctl->pc_restore))
+		mdss_mdp_ctl_pc_restore(ctl, sctl);
+
 	mixer1_changed = (ctl->mixer_left && ctl->mixer_left->params_changed);
 	mixer2_changed = (ctl->mixer_right && ctl->mixer_right->params_changed);
 
-	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON);
-
 	/*
 	 * We could have released the bandwidth if there were no transactions
 	 * pending, so we want to re-calculate the bandwidth in this situation
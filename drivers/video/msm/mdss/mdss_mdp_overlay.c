@@ -50,6 +50,12 @@
 #define OVERLAY_MAX 10
 #define BUF_POOL_SIZE 32
 
+/* identical kickoffs before the screen is reported as static */
+#define MDSS_MDP_STATIC_FRAMES 5
+
+/* how often the automatic fps is re-evaluated while the screen updates */
+#define DFPS_EVAL_MS 500
+
 static int mdss_mdp_overlay_free_fb_pipe(struct msm_fb_data_type *mfd);
 static int mdss_mdp_overlay_fb_parse_dt(struct msm_fb_data_type *mfd);
 static int mdss_mdp_overlay_off(struct msm_fb_data_type *mfd);
@@ -520,6 +526,28 @@ static struct mdss_mdp_pipe *mdss_mdp_overlay_pipe_reuse(
 	return pipe;
 }
 
+/*
+ * __overlay_dma_capable() - check if a layer fits a DMA pipe
+ *
+ * DMA pipes have no scaler, CSC or decimation, so only unscaled RGB
+ * layers can be moved there. Without a dedicated wfd block the DMA pipes
+ * are shared with the writeback mixers and are left alone.
+ */
+static bool __overlay_dma_capable(struct mdss_data_type *mdata,
+		struct mdp_overlay *req, struct mdss_mdp_format_params *fmt)
+{
+	if (!mdata->has_wfd_blk || fmt->is_yuv)
+		return false;
+
+	if (req->flags & (MDP_OV_PIPE_SHARE | MDP_SOURCE_ROTATED_90 |
+			MDP_BWC_EN | MDP_DECIMATION_EN | MDP_DEINTERLACE |
+			MDP_OVERLAY_PP_CFG_EN))
+		return false;
+
+	return (req->src_rect.w == req->dst_rect.w) &&
+		(req->src_rect.h == req->dst_rect.h);
+}
+
 int mdss_mdp_overlay_pipe_setup(struct msm_fb_data_type *mfd,
 				       struct mdp_overlay *req,
 				       struct mdss_mdp_pipe **ppipe)
@@ -623,6 +651,20 @@ int mdss_mdp_overlay_pipe_setup(struct msm_fb_data_type *mfd,
 			pipe = mdss_mdp_pipe_alloc(mixer, pipe_type);
 		}
 
+		/*
+		 * Once RGB and VIG pipes are used up, unscaled RGB layers
+		 * can still go to a free or pending cleanup DMA pipe rather
+		 * than failing and falling back to GPU composition.
+		 */
+		if ((req->pipe_type == PIPE_TYPE_AUTO) && !pipe &&
+			__overlay_dma_capable(mdp5_data->mdata, req, fmt)) {
+			pipe_type = MDSS_MDP_PIPE_TYPE_DMA;
+			pipe = mdss_mdp_pipe_alloc(mixer, pipe_type);
+			if (!pipe)
+				pipe = mdss_mdp_overlay_pipe_reuse(mfd,
+						pipe_type);
+		}
+
 		if (pipe == NULL) {
 			pr_err("error allocating pipe\n");
 			return -ENODEV;
@@ -1341,8 +1383,11 @@ static int __overlay_queue_pipes(struct msm_fb_data_type *mfd)
 			}
 		}
 
-		/* ensure pipes are reconfigured after power off/on */
-		if (ctl->play_cnt == 0)
+		/*
+		 * ensure pipes are reconfigured after power off/on and after
+		 * idle power collapse
+		 */
+		if ((ctl->play_cnt == 0) || ctl->pc_restore)
 			pipe->params_changed++;
 
 		if (buf && (buf->state == MDP_BUF_STATE_READY)) {
@@ -1423,6 +1468,146 @@ static int mdss_mdp_commit_cb(enum mdp_commit_stage_type commit_stage,
 	return ret;
 }
 
+static bool __pipe_buf_flipped(struct mdss_mdp_pipe *pipe)
+{
+	struct mdss_mdp_data *buf;
+
+	buf = list_first_entry_or_null(&pipe->buf_queue,
+			struct mdss_mdp_data, pipe_list);
+	if (!buf)
+		return false;
+
+	return (buf->state == MDP_BUF_STATE_READY) ||
+		!list_is_last(&buf->pipe_list, &pipe->buf_queue);
+}
+
+/*
+ * __overlay_auto_roi() - compute the partial update region of a commit
+ *
+ * Used when userspace didn't supply a ROI. The region is the bounding box of
+ * the pipes that got a new buffer, that moved or changed (old and new
+ * position) and that are being removed. Returns false if the whole frame has
+ * to be sent.
+ */
+static bool __overlay_auto_roi(struct msm_fb_data_type *mfd,
+		struct mdss_mdp_img_rect *roi)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_mdp_ctl *ctl = mfd_to_ctl(mfd);
+	struct mdss_mdp_pipe *pipe;
+	bool partial = true;
+
+	*roi = (struct mdss_mdp_img_rect) {0, 0, 0, 0};
+
+	/* mdss_mdp_set_roi() falls back to full frame for everything else */
+	if (ctl->mixer_right || (ctl->play_cnt == 0) ||
+			(ctl->panel_data->panel_info.type != MIPI_CMD_PANEL) ||
+			!ctl->panel_data->panel_info.partial_update_enabled)
+		partial = false;
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_cleanup, list)
+		mdss_mdp_union_rect(roi, &pipe->prev_dst);
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+		if (pipe->params_changed) {
+			mdss_mdp_union_rect(roi, &pipe->prev_dst);
+			mdss_mdp_union_rect(roi, &pipe->dst);
+		} else if (__pipe_buf_flipped(pipe)) {
+			mdss_mdp_union_rect(roi, &pipe->dst);
+		}
+		pipe->prev_dst = pipe->dst;
+	}
+
+	if (!roi->w || !roi->h)
+		return false;
+
+	/*
+	 * Panels only take whole lines reliably, so only the rows are
+	 * trimmed.
+	 */
+	roi->x = 0;
+	roi->w = ctl->mixer_left->width;
+	if (roi->y + roi->h > ctl->mixer_left->height)
+		roi->h = ctl->mixer_left->height - roi->y;
+
+	return partial;
+}
+
+/*
+ * __overlay_static_update() - track kickoffs that didn't change anything
+ *
+ * After static_frames kickoffs in a row without a new buffer or pipe change
+ * the screen is reported as static through the static_screen sysfs node,
+ * so that the composer can flatten the layers once (e.g. through the
+ * writeback interface) and scan out only the result. The first changed
+ * kickoff reports it as dynamic again so the flattened buffer is dropped.
+ */
+static void __overlay_static_update(struct msm_fb_data_type *mfd,
+		bool changed)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+
+	if (changed) {
+		mdp5_data->static_cnt = 0;
+		if (mdp5_data->static_screen) {
+			mdp5_data->static_screen = false;
+			sysfs_notify(&mfd->fbi->dev->kobj, NULL,
+				"static_screen");
+		}
+		return;
+	}
+
+	if (!mdp5_data->static_frames || mdp5_data->static_screen)
+		return;
+
+	if (++mdp5_data->static_cnt >= mdp5_data->static_frames) {
+		mdp5_data->static_screen = true;
+		sysfs_notify(&mfd->fbi->dev->kobj, NULL, "static_screen");
+	}
+}
+
+/*
+ * __overlay_dfps_kickoff() - account a kickoff for the automatic fps
+ *
+ * Keeps a running average of the time between kickoffs. Kickoffs are paced
+ * by the panel, so content keeping up with the current rate may want more;
+ * raising the fps is then done right away, lowering it is left to the
+ * periodic evaluation in the dfps work.
+ */
+static void __overlay_dfps_kickoff(struct msm_fb_data_type *mfd)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_panel_info *pinfo = mfd->panel_info;
+	ktime_t now = ktime_get();
+	s64 interval;
+	u32 fps;
+
+	if (!mdp5_data->dfps_auto)
+		return;
+
+	interval = ktime_us_delta(now, mdp5_data->dfps_last_kickoff);
+	mdp5_data->dfps_last_kickoff = now;
+
+	/* restart the average after an idle period */
+	if (interval <= 0 || interval >= USEC_PER_SEC || !mdp5_data->dfps_avg_us)
+		mdp5_data->dfps_avg_us = USEC_PER_SEC / pinfo->max_fps;
+	else
+		mdp5_data->dfps_avg_us = (mdp5_data->dfps_avg_us * 3 +
+			(u32) interval) / 4;
+
+	fps = DIV_ROUND_CLOSEST(USEC_PER_SEC, mdp5_data->dfps_avg_us);
+
+	if ((pinfo->mipi.frame_rate < pinfo->max_fps) &&
+			((fps * 10 >= pinfo->mipi.frame_rate * 9) ||
+			 (interval >= USEC_PER_SEC))) {
+		cancel_delayed_work(&mdp5_data->dfps_work);
+		schedule_delayed_work(&mdp5_data->dfps_work, 0);
+	} else if (!delayed_work_pending(&mdp5_data->dfps_work)) {
+		schedule_delayed_work(&mdp5_data->dfps_work,
+			msecs_to_jiffies(DFPS_EVAL_MS));
+	}
+}
+
 int mdss_mdp_overlay_kickoff(struct msm_fb_data_type *mfd,
 				struct mdp_display_commit *data)
 {
@@ -1432,6 +1617,9 @@ int mdss_mdp_overlay_kickoff(struct msm_fb_data_type *mfd,
 	int ret = 0;
 	int sd_in_pipe = 0;
 	struct mdss_mdp_commit_cb commit_cb;
+	struct mdp_display_commit auto_commit;
+	struct mdss_mdp_img_rect roi;
+	bool auto_roi;
 
 	if (!ctl)
 		return -ENODEV;
@@ -1496,6 +1684,24 @@ int mdss_mdp_overlay_kickoff(struct msm_fb_data_type *mfd,
 
 	__vsync_set_vsync_handler(mfd);
 
+	/*
+	 * Without a ROI from userspace find the region that changed since
+	 * the last kickoff, so cursor blinks and clock updates on command
+	 * mode panels don't resend the whole frame. An empty ROI makes
+	 * mdss_mdp_set_roi() go back to full frame.
+	 */
+	auto_roi = __overlay_auto_roi(mfd, &roi);
+	__overlay_static_update(mfd, roi.w && roi.h);
+	__overlay_dfps_kickoff(mfd);
+	if ((mfd->panel.type != WRITEBACK_PANEL) &&
+			(!data || !data->roi.w || !data->roi.h)) {
+		memset(&auto_commit, 0, sizeof(auto_commit));
+		if (auto_roi)
+			auto_commit.roi = (struct mdp_rect)
+				{roi.x, roi.y, roi.w, roi.h};
+		data = &auto_commit;
+	}
+
 	if (data)
 		mdss_mdp_set_roi(ctl, data);
 
@@ -2214,21 +2420,13 @@ static ssize_t dynamic_fps_sysfs_rda_dfps(struct device *dev,
 	return ret;
 } /* dynamic_fps_sysfs_rda_dfps */
 
-static ssize_t dynamic_fps_sysfs_wta_dfps(struct device *dev,
-	struct device_attribute *attr, const char *buf, size_t count)
+static int __mdss_mdp_overlay_set_fps(struct msm_fb_data_type *mfd,
+	int dfps)
 {
-	int dfps, rc = 0;
+	int rc = 0;
 	struct mdss_panel_data *pdata;
-	struct fb_info *fbi = dev_get_drvdata(dev);
-	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
 	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
 
-	rc = kstrtoint(buf, 10, &dfps);
-	if (rc) {
-		pr_err("%s: kstrtoint failed. rc=%d\n", __func__, rc);
-		return rc;
-	}
-
 	if (!mdp5_data->ctl || !mdss_mdp_ctl_is_power_on(mdp5_data->ctl))
 		return 0;
 
@@ -2241,7 +2439,7 @@ static ssize_t dynamic_fps_sysfs_wta_dfps(struct device *dev,
 	if (dfps == pdata->panel_info.mipi.frame_rate) {
 		pr_debug("%s: FPS is already %d\n",
 			__func__, dfps);
-		return count;
+		return 0;
 	}
 
 	mutex_lock(&mdp5_data->dfps_lock);
@@ -2268,15 +2466,145 @@ static ssize_t dynamic_fps_sysfs_wta_dfps(struct device *dev,
 	}
 	pdata->panel_info.new_fps = dfps;
 	mutex_unlock(&mdp5_data->dfps_lock);
-	return count;
+	return 0;
+}
+
+static ssize_t dynamic_fps_sysfs_wta_dfps(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	int dfps, rc = 0;
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+
+	rc = kstrtoint(buf, 10, &dfps);
+	if (rc) {
+		pr_err("%s: kstrtoint failed. rc=%d\n", __func__, rc);
+		return rc;
+	}
+
+	/* a fixed rate from userspace overrides the automatic one */
+	mdp5_data->dfps_auto = false;
+	cancel_delayed_work_sync(&mdp5_data->dfps_work);
+
+	rc = __mdss_mdp_overlay_set_fps(mfd, dfps);
+
+	return rc ? rc : count;
 } /* dynamic_fps_sysfs_wta_dfps */
 
+/*
+ * Only the porch update mode changes the rate without blanking, the other
+ * modes would flicker on every automatic switch.
+ */
+static bool __dfps_auto_supported(struct msm_fb_data_type *mfd)
+{
+	struct mdss_panel_info *pinfo = mfd->panel_info;
+
+	return (pinfo->type == MIPI_VIDEO_PANEL) && pinfo->dynamic_fps &&
+		(pinfo->dfps_update == DFPS_IMMEDIATE_PORCH_UPDATE_MODE) &&
+		pinfo->min_fps && (pinfo->min_fps < pinfo->max_fps);
+}
+
+/*
+ * __dfps_content_fps() - pick the panel rate for a content rate
+ *
+ * Uses the lowest multiple of the content rate the panel supports so that
+ * every content frame is shown for the same number of refreshes.
+ */
+static u32 __dfps_content_fps(struct mdss_panel_info *pinfo, u32 content)
+{
+	u32 fps;
+
+	if (!content)
+		return pinfo->min_fps;
+
+	/* limited by the current rate, the content may be faster */
+	if (content * 10 >= pinfo->mipi.frame_rate * 9)
+		return pinfo->max_fps;
+
+	for (fps = content; fps < pinfo->min_fps; fps += content)
+		;
+
+	return min(fps, pinfo->max_fps);
+}
+
+static void __overlay_dfps_work_handler(struct work_struct *work)
+{
+	struct mdss_overlay_private *mdp5_data =
+		container_of(work, typeof(*mdp5_data), dfps_work.work);
+	struct msm_fb_data_type *mfd = mdp5_data->ctl ?
+		mdp5_data->ctl->mfd : NULL;
+	struct mdss_panel_info *pinfo;
+	s64 idle;
+	u32 fps;
+
+	if (!mfd || !mdp5_data->dfps_auto)
+		return;
+
+	pinfo = mfd->panel_info;
+	idle = ktime_us_delta(ktime_get(), mdp5_data->dfps_last_kickoff);
+
+	if (idle >= DFPS_EVAL_MS * USEC_PER_MSEC) {
+		/* nothing changed on the screen, refresh as slow as possible */
+		fps = pinfo->min_fps;
+	} else {
+		fps = __dfps_content_fps(pinfo, DIV_ROUND_CLOSEST(
+			USEC_PER_SEC, mdp5_data->dfps_avg_us));
+		schedule_delayed_work(&mdp5_data->dfps_work,
+			msecs_to_jiffies(DFPS_EVAL_MS));
+	}
+
+	if (fps != pinfo->mipi.frame_rate) {
+		pr_debug("fb%d: content fps=%d\n", mfd->index, fps);
+		__mdss_mdp_overlay_set_fps(mfd, fps);
+	}
+}
+
+static ssize_t dynamic_fps_sysfs_rda_auto(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", mdp5_data->dfps_auto);
+}
+
+static ssize_t dynamic_fps_sysfs_wta_auto(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	int enable, rc;
+
+	rc = kstrtoint(buf, 10, &enable);
+	if (rc) {
+		pr_err("%s: kstrtoint failed. rc=%d\n", __func__, rc);
+		return rc;
+	}
+
+	if (enable && !__dfps_auto_supported(mfd))
+		return -EINVAL;
+
+	mdp5_data->dfps_auto = !!enable;
+	if (!enable) {
+		cancel_delayed_work_sync(&mdp5_data->dfps_work);
+		rc = __mdss_mdp_overlay_set_fps(mfd, mfd->panel_info->max_fps);
+	}
+
+	return rc ? rc : count;
+}
+
 
 static DEVICE_ATTR(dynamic_fps, S_IRUGO | S_IWUSR, dynamic_fps_sysfs_rda_dfps,
 	dynamic_fps_sysfs_wta_dfps);
+static DEVICE_ATTR(dynamic_fps_auto, S_IRUGO | S_IWUSR,
+	dynamic_fps_sysfs_rda_auto, dynamic_fps_sysfs_wta_auto);
 
 static struct attribute *dynamic_fps_fs_attrs[] = {
 	&dev_attr_dynamic_fps.attr,
+	&dev_attr_dynamic_fps_auto.attr,
 	NULL,
 };
 static struct attribute_group dynamic_fps_fs_attrs_group = {
@@ -2368,13 +2696,60 @@ static ssize_t mdss_mdp_ad_store(struct device *dev,
 }
 
 
+static ssize_t mdss_mdp_static_screen_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", mdp5_data->static_screen);
+}
+
+static ssize_t mdss_mdp_static_frames_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", mdp5_data->static_frames);
+}
+
+static ssize_t mdss_mdp_static_frames_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	u32 frames;
+
+	if (kstrtouint(buf, 10, &frames)) {
+		pr_err("Invalid input for static_frames\n");
+		return -EINVAL;
+	}
+
+	mutex_lock(&mdp5_data->ov_lock);
+	mdp5_data->static_frames = frames;
+	mdp5_data->static_cnt = 0;
+	mutex_unlock(&mdp5_data->ov_lock);
+
+	return count;
+}
+
 static DEVICE_ATTR(vsync_event, S_IRUGO, mdss_mdp_vsync_show_event, NULL);
 static DEVICE_ATTR(ad, S_IRUGO | S_IWUSR | S_IWGRP, mdss_mdp_ad_show,
 	mdss_mdp_ad_store);
+static DEVICE_ATTR(static_screen, S_IRUGO, mdss_mdp_static_screen_show,
+	NULL);
+static DEVICE_ATTR(static_frames, S_IRUGO | S_IWUSR | S_IWGRP,
+	mdss_mdp_static_frames_show, mdss_mdp_static_frames_store);
 
 static struct attribute *mdp_overlay_sysfs_attrs[] = {
 	&dev_attr_vsync_event.attr,
 	&dev_attr_ad.attr,
+	&dev_attr_static_screen.attr,
+	&dev_attr_static_frames.attr,
 	NULL,
 };
 
@@ -3284,6 +3659,8 @@ static int mdss_mdp_overlay_off(struct msm_fb_data_type *mfd)
 	if (!mdss_mdp_ctl_is_power_on(mdp5_data->ctl))
 		return 0;
 
+	cancel_delayed_work_sync(&mdp5_data->dfps_work);
+
 	/*
 	 * Keep a reference to the runtime pm until the overlay is turned
 	 * off, and then release this last reference at the end. This will
@@ -3629,6 +4006,7 @@ static int __vsync_retire_setup(struct msm_fb_data_type *mfd)
 		__vsync_retire_handle_vsync;
 	mdp5_data->vsync_retire_handler.cmd_post_flush = false;
 	INIT_WORK(&mdp5_data->retire_work, __vsync_retire_work_handler);
+	INIT_DELAYED_WORK(&mdp5_data->dfps_work, __overlay_dfps_work_handler);
 
 	return 0;
 }
@@ -3694,6 +4072,7 @@ int mdss_mdp_overlay_init(struct msm_fb_data_type *mfd)
 	mutex_init(&mdp5_data->ov_lock);
 	mutex_init(&mdp5_data->dfps_lock);
 	mdp5_data->hw_refresh = true;
+	mdp5_data->static_frames = MDSS_MDP_STATIC_FRAMES;
 	mdp5_data->overlay_play_enable = true;
 
 	mdp5_data->mdata = dev_get_drvdata(mfd->pdev->dev.parent);
@@ -3730,6 +4109,7 @@ int mdss_mdp_overlay_init(struct msm_fb_data_type *mfd)
 			pr_err("Error dfps sysfs creation ret=%d\n", rc);
 			goto init_fail;
 		}
+		mdp5_data->dfps_auto = __dfps_auto_supported(mfd);
 	}
 
 	if (mfd->panel_info->mipi.dynamic_switch_enabled ||
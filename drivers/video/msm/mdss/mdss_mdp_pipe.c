@@ -702,6 +702,8 @@ static void mdss_mdp_pipe_free(struct kref *kref)
 	pipe->mixer = NULL;
 	memset(&pipe->scale, 0, sizeof(struct mdp_scale_data));
 	memset(&pipe->req_data, 0, sizeof(pipe->req_data));
+	memset(&pipe->prev_dst, 0, sizeof(pipe->prev_dst));
+	pipe->perf_cache_valid = false;
 }
 
 static int mdss_mdp_is_pipe_idle(struct mdss_mdp_pipe *pipe,
@@ -2585,12 +2585,20 @@ int mdss_mdp_user_pcc_config(struct mdp_pcc_cfg_data *config)
 	mutex_lock(&mdss_pp_mutex);
 	disp_num = config->block - MDP_LOGICAL_BLOCK_DISP_0;
 
+	/* livedisplay reapplies its setting on every unblank */
+	if (!memcmp(&mdss_pp_res->user_pcc_disp_cfg[disp_num], config,
+			sizeof(*config))) {
+		pr_debug("user pcc unchanged on disp %d\n", disp_num);
+		goto user_pcc_exit;
+	}
+
 	mdss_pp_res->user_pcc_disp_cfg[disp_num] = *config;
 	pcc_combine(&mdss_pp_res->raw_pcc_disp_cfg[disp_num],
 				&mdss_pp_res->user_pcc_disp_cfg[disp_num],
 				&mdss_pp_res->pcc_disp_cfg[disp_num]);
 	mdss_pp_res->pp_disp_flags[disp_num] |= PP_FLAGS_DIRTY_PCC;
 
+user_pcc_exit:
 	mutex_unlock(&mdss_pp_mutex);
 	return ret;
 }
@@ -2630,6 +2638,9 @@ int mdss_mdp_pcc_config(struct mdp_pcc_cfg_data *config,
 		pp_read_pcc_regs(addr, config);
 		*copyback = 1;
 		mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF);
+	} else if (!memcmp(&mdss_pp_res->raw_pcc_disp_cfg[disp_num], config,
+			sizeof(*config))) {
+		pr_debug("pcc unchanged on disp %d\n", disp_num);
 	} else {
 		mdss_pp_res->raw_pcc_disp_cfg[disp_num] = *config;
 		pcc_combine(&mdss_pp_res->raw_pcc_disp_cfg[disp_num],
@@ -2740,6 +2751,7 @@ int mdss_mdp_igc_lut_config(struct mdp_igc_lut_data *config,
 	struct mdp_igc_lut_data local_cfg;
 	char __iomem *igc_addr;
 	struct mdss_data_type *mdata = mdss_mdp_get_mdata();
+	u32 *lut = NULL;
 
 	if ((config->block < MDP_LOGICAL_BLOCK_DISP_0) ||
 		(config->block >= MDP_BLOCK_MAX))
@@ -2796,26 +2808,44 @@ int mdss_mdp_igc_lut_config(struct mdp_igc_lut_data *config,
 		*copyback = 1;
 		mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF);
 	} else {
+		lut = kmalloc(2 * IGC_LUT_ENTRIES * sizeof(u32), GFP_KERNEL);
+		if (!lut) {
+			ret = -ENOMEM;
+			goto igc_config_exit;
+		}
 		if (copy_from_kernel) {
-			memcpy(&mdss_pp_res->igc_lut_c0c1[disp_num][0],
-			config->c0_c1_data, config->len * sizeof(u32));
-			memcpy(&mdss_pp_res->igc_lut_c2[disp_num][0],
-			config->c2_data, config->len * sizeof(u32));
+			memcpy(lut, config->c0_c1_data,
+				config->len * sizeof(u32));
+			memcpy(lut + IGC_LUT_ENTRIES, config->c2_data,
+				config->len * sizeof(u32));
 		} else {
-			if (copy_from_user(
-				&mdss_pp_res->igc_lut_c0c1[disp_num][0],
-				config->c0_c1_data,
+			if (copy_from_user(lut, config->c0_c1_data,
 				config->len * sizeof(u32))) {
 				ret = -EFAULT;
 				goto igc_config_exit;
 			}
-			if (copy_from_user(
-				&mdss_pp_res->igc_lut_c2[disp_num][0],
+			if (copy_from_user(lut + IGC_LUT_ENTRIES,
 				config->c2_data, config->len * sizeof(u32))) {
 				ret = -EFAULT;
 				goto igc_config_exit;
 			}
 		}
+
+		/* rewriting an unchanged table costs 768 register writes */
+		if ((mdss_pp_res->igc_disp_cfg[disp_num].ops == config->ops) &&
+			!memcmp(&mdss_pp_res->igc_lut_c0c1[disp_num][0], lut,
+				IGC_LUT_ENTRIES * sizeof(u32)) &&
+			!memcmp(&mdss_pp_res->igc_lut_c2[disp_num][0],
+				lut + IGC_LUT_ENTRIES,
+				IGC_LUT_ENTRIES * sizeof(u32))) {
+			pr_debug("igc lut unchanged on disp %d\n", disp_num);
+			goto igc_config_exit;
+		}
+
+		memcpy(&mdss_pp_res->igc_lut_c0c1[disp_num][0], lut,
+			IGC_LUT_ENTRIES * sizeof(u32));
+		memcpy(&mdss_pp_res->igc_lut_c2[disp_num][0],
+			lut + IGC_LUT_ENTRIES, IGC_LUT_ENTRIES * sizeof(u32));
 		mdss_pp_res->igc_disp_cfg[disp_num] = *config;
 		mdss_pp_res->igc_disp_cfg[disp_num].c0_c1_data =
 			&mdss_pp_res->igc_lut_c0c1[disp_num][0];
@@ -2826,6 +2856,7 @@ int mdss_mdp_igc_lut_config(struct mdp_igc_lut_data *config,
 
 igc_config_exit:
 	mutex_unlock(&mdss_pp_mutex);
+	kfree(lut);
 	return ret;
 }
 static void pp_update_gc_one_lut(char __iomem *addr,
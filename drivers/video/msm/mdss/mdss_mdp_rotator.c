@@ -17,6 +17,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #include <linux/sync.h>
 #include <linux/sw_sync.h>
 
@@ -30,11 +31,14 @@
 static DEFINE_MUTEX(rotator_lock);
 static struct mdss_mdp_rotator_session rotator_session[MAX_ROTATOR_SESSIONS];
 static LIST_HEAD(rotator_queue);
+static struct workqueue_struct *rotator_wq;
 
 static int mdss_mdp_rotator_finish(struct mdss_mdp_rotator_session *rot);
 static void mdss_mdp_rotator_commit_wq_handler(struct work_struct *work);
 static int mdss_mdp_rotator_busy_wait(struct mdss_mdp_rotator_session *rot);
 static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot);
+static int mdss_mdp_rotator_queue_start(struct mdss_mdp_rotator_session *rot);
+static void mdss_mdp_rotator_queue_wait(struct mdss_mdp_rotator_session *rot);
 static struct msm_sync_pt_data *mdss_mdp_rotator_sync_pt_create(
 			struct mdss_mdp_rotator_session *rot);
 
@@ -309,9 +313,18 @@ static void mdss_mdp_rotator_commit_wq_handler(struct work_struct *work)
 	rot = container_of(work, struct mdss_mdp_rotator_session, commit_work);
 
 	mutex_lock(&rotator_lock);
-	ret = mdss_mdp_rotator_queue_helper(rot);
+	ret = mdss_mdp_rotator_queue_start(rot);
 	if (ret)
 		pr_err("rotator queue failed\n");
+	mutex_unlock(&rotator_lock);
+
+	/*
+	 * Wait for completion outside of rotator_lock so that sessions
+	 * running on other writeback blocks can be queued in the meantime.
+	 * The session can't go away under us, finish flushes this work.
+	 */
+	if (!ret)
+		mdss_mdp_rotator_queue_wait(rot);
 
 	if (rot->rot_sync_pt_data) {
 		atomic_inc(&rot->rot_sync_pt_data->commit_cnt);
@@ -319,8 +332,6 @@ static void mdss_mdp_rotator_commit_wq_handler(struct work_struct *work)
 	} else {
 		pr_err("rot_sync_pt_data is NULL\n");
 	}
-
-	mutex_unlock(&rotator_lock);
 }
 
 static struct msm_sync_pt_data *mdss_mdp_rotator_sync_pt_create(
@@ -366,7 +377,8 @@ static int mdss_mdp_rotator_busy_wait_ex(struct mdss_mdp_rotator_session *rot)
 	return 0;
 }
 
-static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot)
+/* kick off all parts of a session, must be called with rotator_lock held */
+static int mdss_mdp_rotator_queue_start(struct mdss_mdp_rotator_session *rot)
 {
 	int ret;
 	struct mdss_mdp_rotator_session *tmp;
@@ -377,13 +389,27 @@ static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot)
 		ret = mdss_mdp_rotator_queue_sub(tmp,
 				&rot->src_buf, &rot->dst_buf);
 
-	if (ret) {
+	if (ret)
 		pr_err("rotation failed %d for rot=%d\n", ret, rot->session_id);
-		return ret;
-	}
+
+	return ret;
+}
+
+static void mdss_mdp_rotator_queue_wait(struct mdss_mdp_rotator_session *rot)
+{
+	struct mdss_mdp_rotator_session *tmp;
 
 	for (tmp = rot; tmp; tmp = tmp->next)
 		mdss_mdp_rotator_busy_wait(tmp);
+}
+
+static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot)
+{
+	int ret;
+
+	ret = mdss_mdp_rotator_queue_start(rot);
+	if (!ret)
+		mdss_mdp_rotator_queue_wait(rot);
 
 	return ret;
 }
@@ -393,7 +419,7 @@ static int mdss_mdp_rotator_queue(struct mdss_mdp_rotator_session *rot)
 	int ret = 0;
 
 	if (rot->use_sync_pt)
-		schedule_work(&rot->commit_work);
+		queue_work(rotator_wq, &rot->commit_work);
 	else
 		ret = mdss_mdp_rotator_queue_helper(rot);
 
@@ -733,3 +759,21 @@ int mdss_mdp_rotator_unset(int ndx)
 	mutex_unlock(&rotator_lock);
 	return ret;
 }
+
+/**
+ * mdss_mdp_rotator_init() - create the rotator work queue
+ *
+ * Queued rotations run from a high priority work queue so that sessions on
+ * different writeback blocks execute concurrently instead of one after the
+ * other on the system work queue.
+ */
+int mdss_mdp_rotator_init(void)
+{
+	rotator_wq = alloc_workqueue("mdss_rot", WQ_HIGHPRI, 0);
+	if (!rotator_wq) {
+		pr_err("unable to create rotator work queue\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
@@ -258,6 +258,31 @@ void mdss_mdp_intersect_rect(struct mdss_mdp_img_rect *res_rect,
 		*res_rect = (struct mdss_mdp_img_rect){l, t, (r-l), (b-t)};
 }
 
+/*
+ * mdss_mdp_union_rect() - grow res_rect so that it also covers rect. An empty
+ * res_rect is replaced by rect.
+ */
+void mdss_mdp_union_rect(struct mdss_mdp_img_rect *res_rect,
+	const struct mdss_mdp_img_rect *rect)
+{
+	int l, t, r, b;
+
+	if (!rect->w || !rect->h)
+		return;
+
+	if (!res_rect->w || !res_rect->h) {
+		*res_rect = *rect;
+		return;
+	}
+
+	l = min(res_rect->x, rect->x);
+	t = min(res_rect->y, rect->y);
+	r = max((res_rect->x + res_rect->w), (rect->x + rect->w));
+	b = max((res_rect->y + res_rect->h), (rect->y + rect->h));
+
+	*res_rect = (struct mdss_mdp_img_rect){l, t, (r-l), (b-t)};
+}
+
 void mdss_mdp_crop_rect(struct mdss_mdp_img_rect *src_rect,
 	struct mdss_mdp_img_rect *dst_rect,
 	const struct mdss_mdp_img_rect *sci_rect)
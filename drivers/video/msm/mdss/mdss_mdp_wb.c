@@ -636,7 +636,7 @@ int mdss_mdp_wb_kickoff(struct msm_fb_data_type *mfd,
 	if (wb) {
 		mutex_lock(&wb->lock);
 		/* in case of reinit of control path need to reset secure */
-		if (ctl->play_cnt == 0)
+		if ((ctl->play_cnt == 0) || ctl->pc_restore)
 			mdss_mdp_wb_set_secure(ctl->mfd, wb->is_secure);
 		if (!list_empty(&wb->free_queue) && wb->state != WB_STOPING &&
 		    wb->state != WB_STOP) {
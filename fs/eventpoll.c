@@ -35,6 +35,7 @@
 #include <linux/anon_inodes.h>
 #include <linux/device.h>
 #include <linux/freezer.h>
+#include <linux/hrtimer.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
 #include <asm/mman.h>
@@ -89,7 +90,7 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET | EPOLLCOALESCE)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -202,6 +203,13 @@ struct eventpoll {
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
 
+	/*
+	 * Timer delivering the wakeup for a batch of EPOLLCOALESCE events,
+	 * and whether it is armed. Protected by ->lock.
+	 */
+	struct hrtimer coalesce_timer;
+	int coalesce_pending;
+
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
 
@@ -248,6 +256,9 @@ struct ep_send_events_data {
 /* Maximum number of epoll watched descriptors, per user */
 static long max_user_watches __read_mostly;
 
+/* Maximum delay of the wakeup for EPOLLCOALESCE descriptors, in usecs */
+static int coalesce_usecs __read_mostly = 500;
+
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
  */
@@ -283,6 +294,8 @@ static LIST_HEAD(tfile_check_list);
 
 static long zero;
 static long long_max = LONG_MAX;
+static int int_zero;
+static int coalesce_usecs_max = USEC_PER_SEC / 10;
 
 ctl_table epoll_table[] = {
 	{
@@ -294,6 +307,15 @@ ctl_table epoll_table[] = {
 		.extra1		= &zero,
 		.extra2		= &long_max,
 	},
+	{
+		.procname	= "coalesce_usecs",
+		.data		= &coalesce_usecs,
+		.maxlen		= sizeof(coalesce_usecs),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &int_zero,
+		.extra2		= &coalesce_usecs_max,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -682,6 +704,8 @@ static void ep_free(struct eventpoll *ep)
 	struct rb_node *rbp;
 	struct epitem *epi;
 
+	hrtimer_cancel(&ep->coalesce_timer);
+
 	/* We need to release all tasks waiting for these file */
 	if (waitqueue_active(&ep->poll_wait))
 		ep_poll_safewake(&ep->poll_wait);
@@ -830,6 +854,32 @@ void eventpoll_release_file(struct file *file)
 	mutex_unlock(&epmutex);
 }
 
+/*
+ * Delivers the wakeup that ep_poll_callback() held back for a batch of
+ * EPOLLCOALESCE events.
+ */
+static enum hrtimer_restart ep_coalesce_timer_fn(struct hrtimer *timer)
+{
+	int pwake = 0;
+	unsigned long flags;
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    coalesce_timer);
+
+	spin_lock_irqsave(&ep->lock, flags);
+	ep->coalesce_pending = 0;
+	if (waitqueue_active(&ep->wq))
+		wake_up_locked(&ep->wq);
+	if (waitqueue_active(&ep->poll_wait))
+		pwake++;
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	/* We have to call this outside the lock */
+	if (pwake)
+		ep_poll_safewake(&ep->poll_wait);
+
+	return HRTIMER_NORESTART;
+}
+
 static int ep_alloc(struct eventpoll **pep)
 {
 	int error;
@@ -850,6 +900,8 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	hrtimer_init(&ep->coalesce_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ep->coalesce_timer.function = ep_coalesce_timer_fn;
 
 	*pep = ep;
 
@@ -900,6 +952,8 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
+	unsigned int events;
+	int usecs;
 
 	if ((unsigned long)key & POLLFREE) {
 		ep_pwq_from_wait(wait)->whead = NULL;
@@ -912,6 +966,19 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 		list_del_init(&wait->task_list);
 	}
 
+	/*
+	 * Filter out the events nobody is interested in before touching
+	 * ep->lock, a socket watched for POLLIN also reports every POLLOUT
+	 * and that is the bulk of the callbacks on a busy epoll set. A stale
+	 * mask here is fine: ep_modify() publishes the new mask with a full
+	 * barrier before polling the file, so an event we skip is seen by
+	 * its f_op->poll() call. The checks are repeated under the lock.
+	 */
+	events = ACCESS_ONCE(epi->event.events);
+	if (!(events & ~EP_PRIVATE_BITS) ||
+	    (key && !((unsigned long) key & events)))
+		return 1;
+
 	spin_lock_irqsave(&ep->lock, flags);
 
 	/*
@@ -960,6 +1027,24 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 		__pm_stay_awake(epi->ws);
 	}
 
+	/*
+	 * An EPOLLCOALESCE descriptor only arms the batch timer, the events
+	 * becoming ready until it expires are reported with a single wakeup.
+	 * A waiter entering ep_poll() meanwhile finds the ready list filled
+	 * and does not sleep, so only tasks already asleep are delayed.
+	 */
+	usecs = ACCESS_ONCE(coalesce_usecs);
+	if ((epi->event.events & EPOLLCOALESCE) && usecs &&
+	    (waitqueue_active(&ep->wq) || waitqueue_active(&ep->poll_wait))) {
+		if (!ep->coalesce_pending) {
+			ep->coalesce_pending = 1;
+			hrtimer_start(&ep->coalesce_timer,
+				      ns_to_ktime((u64)usecs * NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		}
+		goto out_unlock;
+	}
+
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
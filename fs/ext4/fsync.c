@@ -213,11 +213,23 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 	int ret;
 	tid_t commit_tid;
 	bool needs_barrier = false;
+	bool whole = start == 0 && end == LLONG_MAX;
+	unsigned int data_seq;
 
 	J_ASSERT(ext4_journal_current_handle() == NULL);
 
 	trace_ext4_sync_file_enter(file, datasync);
 
+	/*
+	 * Page writeback in the range is waited for below, but a direct
+	 * write may still be in flight: only a flush with none of those
+	 * going can cover everything written up to data_seq.
+	 */
+	data_seq = atomic_read(&ei->i_data_seq);
+	smp_mb();
+	if (atomic_read(&inode->i_dio_count))
+		whole = false;
+
 	ret = filemap_write_and_wait_range(inode->i_mapping, start, end);
 	if (ret)
 		return ret;
@@ -261,8 +273,22 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
 	ret = jbd2_complete_transaction(journal, commit_tid);
-	if (needs_barrier)
-		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL);
+	/*
+	 * The metadata is already committed. If nothing of the file's data
+	 * has been written since the last fsync flushed the disk cache, as
+	 * when sqlite syncs a file it didn't touch since, there is nothing
+	 * for another flush to make durable.
+	 */
+	if (needs_barrier && whole && data_seq == ei->i_flushed_seq)
+		needs_barrier = false;
+	if (needs_barrier) {
+		int err = blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL,
+					     NULL);
+		if (err)
+			whole = false;
+	}
+	if (!ret && whole)
+		ei->i_flushed_seq = data_seq;
  out:
 	mutex_unlock(&inode->i_mutex);
 	trace_ext4_sync_file_exit(inode, ret);
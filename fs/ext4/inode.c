@@ -2015,6 +2015,7 @@ static int ext4_writepage(struct page *page,
 	struct inode *inode = page->mapping->host;
 
 	trace_ext4_writepage(page);
+	atomic_inc(&EXT4_I(inode)->i_data_seq);
 	size = i_size_read(inode);
 	if (page->index == size >> PAGE_CACHE_SHIFT)
 		len = size & ~PAGE_CACHE_MASK;
@@ -2293,6 +2294,7 @@ static int ext4_da_writepages(struct address_space *mapping,
 	 */
 	if (!mapping->nrpages || !mapping_tagged(mapping, PAGECACHE_TAG_DIRTY))
 		return 0;
+	atomic_inc(&EXT4_I(inode)->i_data_seq);
 
 	/*
 	 * If the filesystem has aborted, it is read-only, so return
@@ -3120,10 +3122,15 @@ static ssize_t ext4_direct_IO(int rw, struct kiocb *iocb,
 		return 0;
 
 	trace_ext4_direct_IO_enter(inode, offset, iov_length(iov, nr_segs), rw);
+	/* before and after: fsync must see a write that may still be going */
+	if (rw == WRITE)
+		atomic_inc(&EXT4_I(inode)->i_data_seq);
 	if (ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS))
 		ret = ext4_ext_direct_IO(rw, iocb, iov, offset, nr_segs);
 	else
 		ret = ext4_ind_direct_IO(rw, iocb, iov, offset, nr_segs);
+	if (rw == WRITE)
+		atomic_inc(&EXT4_I(inode)->i_data_seq);
 	trace_ext4_direct_IO_exit(inode, offset,
 				iov_length(iov, nr_segs), rw, ret);
 	return ret;
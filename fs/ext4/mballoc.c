@@ -92,6 +92,11 @@
  * The reason for having a per cpu locality group is to reduce the contention
  * between CPUs. It is possible to get scheduled at this point.
  *
+ * With /sys/fs/ext4/<partition>/mb_dir_locality set, the locality group is
+ * picked from the block group of the inode instead, so that small files
+ * created in the same directory share the same prealloc space and end up
+ * next to each other on disk, whichever CPU writes them out or fsyncs them.
+ *
  * The locality group prealloc space is used looking at whether we have
  * enough free space (pa_free) within the prealloc space.
  *
@@ -3940,6 +3945,22 @@ static inline void ext4_mb_show_ac(struct ext4_allocation_context *ac)
  *
  * One can tune this size via /sys/fs/ext4/<partition>/mb_stream_req
  */
+static struct ext4_locality_group *
+ext4_mb_dir_locality_group(struct ext4_sb_info *sbi, struct inode *inode)
+{
+	unsigned int n = EXT4_I(inode)->i_block_group % num_possible_cpus();
+	int cpu;
+
+	/*
+	 * new inodes are placed in their parent's block group whenever
+	 * possible, so this is a cheap stand-in for the parent directory
+	 */
+	for_each_possible_cpu(cpu)
+		if (!n--)
+			break;
+	return per_cpu_ptr(sbi->s_locality_groups, cpu);
+}
+
 static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 {
 	struct ext4_sb_info *sbi = EXT4_SB(ac->ac_sb);
@@ -3981,7 +4002,10 @@ static void ext4_mb_group_or_file(struct ext4_allocation_context *ac)
 	 * per cpu locality group is to reduce the contention between block
 	 * request from multiple CPUs.
 	 */
-	ac->ac_lg = __this_cpu_ptr(sbi->s_locality_groups);
+	if (sbi->s_mb_dir_locality)
+		ac->ac_lg = ext4_mb_dir_locality_group(sbi, ac->ac_inode);
+	else
+		ac->ac_lg = __this_cpu_ptr(sbi->s_locality_groups);
 
 	/* we're going to use group allocation */
 	ac->ac_flags |= EXT4_MB_HINT_GROUP_ALLOC;
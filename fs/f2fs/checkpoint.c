@@ -896,6 +896,61 @@ int f2fs_sync_inode_meta(struct f2fs_sb_info *sbi)
 /*
  * Freeze all the FS-operations for checkpoint.
  */
+void flush_nodes_work(struct work_struct *work)
+{
+	struct f2fs_sb_info *sbi = container_of(work, struct f2fs_sb_info,
+								cp_node_work);
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = LONG_MAX,
+		.for_reclaim = 0,
+	};
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	sync_node_pages(sbi, &wbc);
+	blk_finish_plug(&plug);
+}
+
+/*
+ * Write back the bulk of the dirty dentry and node pages before
+ * block_operations() takes cp_rwsem, so that the section which stalls
+ * every fs operation only has to deal with what got dirtied meanwhile.
+ * Node pages which are already dirty are flushed by a worker while this
+ * context flushes the dentry pages, then the node pages dirtied by the
+ * latter are picked up here.  Errors are left to block_operations(),
+ * which redoes all of this under the lock anyway.
+ */
+static void pre_flush_operations(struct f2fs_sb_info *sbi)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = LONG_MAX,
+		.for_reclaim = 0,
+	};
+	struct blk_plug plug;
+	bool queued = false;
+
+	if (get_pages(sbi, F2FS_DIRTY_NODES))
+		queued = queue_work(system_unbound_wq, &sbi->cp_node_work);
+
+	blk_start_plug(&plug);
+	if (get_pages(sbi, F2FS_DIRTY_DENTS))
+		sync_dirty_inodes(sbi, DIR_INODE);
+	if (get_pages(sbi, F2FS_DIRTY_IMETA))
+		f2fs_sync_inode_meta(sbi);
+	blk_finish_plug(&plug);
+
+	if (queued)
+		flush_work(&sbi->cp_node_work);
+
+	if (get_pages(sbi, F2FS_DIRTY_NODES)) {
+		blk_start_plug(&plug);
+		sync_node_pages(sbi, &wbc);
+		blk_finish_plug(&plug);
+	}
+}
+
 static int block_operations(struct f2fs_sb_info *sbi)
 {
 	struct writeback_control wbc = {
@@ -1179,6 +1234,10 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		goto out;
 	}
 
+	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start pre_flush");
+
+	pre_flush_operations(sbi);
+
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start block_ops");
 
 	err = block_operations(sbi);
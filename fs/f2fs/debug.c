@@ -130,6 +130,28 @@ static void update_sit_info(struct f2fs_sb_info *sbi)
 		si->avg_vblocks = 0;
 }
 
+/*
+ * This function counts, per segment type, how full the in-use segments are,
+ * which tells how well hot and cold blocks end up separated.
+ */
+static void update_vblocks_hist(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_stat_info *si = F2FS_STAT(sbi);
+	struct seg_entry *se;
+	unsigned int segno, bucket;
+
+	memset(si->vblocks_hist, 0, sizeof(si->vblocks_hist));
+	for (segno = 0; segno < MAIN_SEGS(sbi); segno++) {
+		se = get_seg_entry(sbi, segno);
+		if (!se->valid_blocks || se->type >= NR_CURSEG_TYPE)
+			continue;
+		bucket = se->valid_blocks * NR_VBLOCKS_HIST / sbi->blocks_per_seg;
+		if (bucket >= NR_VBLOCKS_HIST)
+			bucket = NR_VBLOCKS_HIST - 1;
+		si->vblocks_hist[se->type][bucket]++;
+	}
+}
+
 /*
  * This function calculates memory footprint.
  */
@@ -209,6 +231,15 @@ get_cache:
 	si->page_mem += (unsigned long long)npages << PAGE_SHIFT;
 }
 
+static const char *seg_type_name[NR_CURSEG_TYPE] = {
+	[CURSEG_HOT_DATA]	= "Hot data",
+	[CURSEG_WARM_DATA]	= "Warm data",
+	[CURSEG_COLD_DATA]	= "Cold data",
+	[CURSEG_HOT_NODE]	= "Hot node",
+	[CURSEG_WARM_NODE]	= "Warm node",
+	[CURSEG_COLD_NODE]	= "Cold node",
+};
+
 static int stat_show(struct seq_file *s, void *v)
 {
 	struct f2fs_stat_info *si;
@@ -343,6 +374,32 @@ static int stat_show(struct seq_file *s, void *v)
 		seq_printf(s, "\nBDF: %u, avg. vblocks: %u\n",
 			   si->bimodal, si->avg_vblocks);
 
+		update_vblocks_hist(si->sbi);
+		seq_puts(s, "\nValid blocks per segment (%):\n");
+		seq_puts(s, "              ");
+		for (j = 0; j < NR_VBLOCKS_HIST; j++)
+			seq_printf(s, " %6d", j * 100 / NR_VBLOCKS_HIST);
+		seq_putc(s, '\n');
+		for (j = CURSEG_HOT_DATA; j <= CURSEG_COLD_NODE; j++) {
+			int k;
+
+			seq_printf(s, "  - %-9s:", seg_type_name[j]);
+			for (k = 0; k < NR_VBLOCKS_HIST; k++)
+				seq_printf(s, " %6u", si->vblocks_hist[j][k]);
+			seq_putc(s, '\n');
+		}
+
+		if (si->sbi->gc_thread) {
+			struct f2fs_gc_kthread *gc_th = si->sbi->gc_thread;
+
+			seq_printf(s, "\nBG GC idle prediction: %s\n",
+				   gc_th->idle_predict ? "on" : "off");
+			seq_printf(s, "  - avg. idle window: %u ms\n",
+				   gc_th->avg_idle_ms);
+			seq_printf(s, "  - avg. gc pass: %u ms\n",
+				   gc_th->avg_gc_ms);
+		}
+
 		/* memory footprint */
 		update_mem_info(si->sbi);
 		seq_printf(s, "\nMemory: %llu KB\n",
@@ -539,49 +539,61 @@ static unsigned int f2fs_update_extent_tree_range(struct inode *inode,
 	return !__is_extent_same(&prev, &et->largest);
 }
 
-unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
+/*
+ * Free the extent trees of evicted inodes which have no extent cached any
+ * more.  Caller should hold sbi->extent_tree_lock for writing.
+ */
+static unsigned int __free_zombie_trees(struct f2fs_sb_info *sbi,
+							int nr_free)
 {
 	struct extent_tree *et, *next;
-	struct extent_node *en;
-	unsigned int node_cnt = 0, tree_cnt = 0;
-	int remained;
-
-	if (!test_opt(sbi, EXTENT_CACHE))
-		return 0;
+	unsigned int tree_cnt = 0;
 
-	if (!atomic_read(&sbi->total_zombie_tree))
-		goto free_node;
-
-	if (!down_write_trylock(&sbi->extent_tree_lock))
-		goto out;
-
-	/* 1. remove unreferenced extent tree */
 	list_for_each_entry_safe(et, next, &sbi->zombie_list, list) {
-		if (atomic_read(&et->node_cnt)) {
-			write_lock(&et->lock);
-			node_cnt += __free_extent_tree(sbi, et);
-			write_unlock(&et->lock);
-		}
-		f2fs_bug_on(sbi, atomic_read(&et->node_cnt));
+		if (atomic_read(&et->node_cnt))
+			continue;
 		list_del_init(&et->list);
 		radix_tree_delete(&sbi->extent_tree_root, et->ino);
 		kmem_cache_free(extent_tree_slab, et);
 		atomic_dec(&sbi->total_ext_tree);
 		atomic_dec(&sbi->total_zombie_tree);
-		tree_cnt++;
 
-		if (node_cnt + tree_cnt >= nr_shrink)
-			goto unlock_out;
+		if (++tree_cnt >= nr_free)
+			break;
 		cond_resched();
 	}
-	up_write(&sbi->extent_tree_lock);
+	return tree_cnt;
+}
+
+unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
+{
+	struct extent_tree *et;
+	struct extent_node *en;
+	unsigned int node_cnt = 0, tree_cnt = 0;
+	int remained;
+
+	if (!test_opt(sbi, EXTENT_CACHE))
+		return 0;
 
-free_node:
-	/* 2. remove LRU extent entries */
 	if (!down_write_trylock(&sbi->extent_tree_lock))
 		goto out;
 
-	remained = nr_shrink - (node_cnt + tree_cnt);
+	/* 1. remove unreferenced extent trees which are already empty */
+	if (atomic_read(&sbi->total_zombie_tree)) {
+		tree_cnt = __free_zombie_trees(sbi, nr_shrink);
+		if (tree_cnt >= nr_shrink)
+			goto unlock_out;
+	}
+
+	/*
+	 * 2. remove LRU extent entries
+	 *
+	 * Extents of evicted inodes stay on the LRU along with everything
+	 * else instead of being dropped ahead of it, so the mappings of big
+	 * files which get opened again after their inode was reclaimed
+	 * (apks, odex files after a low memory kill) outlive colder ones.
+	 */
+	remained = nr_shrink - tree_cnt;
 
 	spin_lock(&sbi->extent_lock);
 	for (; remained > 0; remained--) {
@@ -607,6 +619,12 @@ free_node:
 	}
 	spin_unlock(&sbi->extent_lock);
 
+	/* 3. remove unreferenced extent trees emptied by the above */
+	if (node_cnt + tree_cnt < nr_shrink &&
+				atomic_read(&sbi->total_zombie_tree))
+		tree_cnt += __free_zombie_trees(sbi,
+					nr_shrink - node_cnt - tree_cnt);
+
 unlock_out:
 	up_write(&sbi->extent_tree_lock);
 out:
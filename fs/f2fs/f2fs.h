@@ -147,20 +147,13 @@ struct f2fs_mount_info {
 #define F2FS_CLEAR_FEATURE(sb, mask)					\
 	F2FS_SB(sb)->raw_super->feature &= ~cpu_to_le32(mask)
 
-#define CRCPOLY_LE 0xedb88320
-
+/*
+ * Bit reflected CRC32 seeded with the magic and without final inversion,
+ * which is exactly what the slice-by-8 library crc32_le() computes.
+ */
 static inline __u32 f2fs_crc32(void *buf, size_t len)
 {
-	unsigned char *p = (unsigned char *)buf;
-	__u32 crc = F2FS_SUPER_MAGIC;
-	int i;
-
-	while (len--) {
-		crc ^= *p++;
-		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
-	}
-	return crc;
+	return crc32_le(F2FS_SUPER_MAGIC, buf, len);
 }
 
 static inline bool f2fs_crc_valid(__u32 blk_crc, void *buf, size_t buf_size)
@@ -853,6 +846,7 @@ struct f2fs_sb_info {
 	struct rw_semaphore cp_rwsem;		/* blocking FS operations */
 	struct rw_semaphore node_write;		/* locking node writes */
 	wait_queue_head_t cp_wait;
+	struct work_struct cp_node_work;	/* node flush ahead of checkpoint */
 	unsigned long last_time[MAX_TIME];	/* to store time in jiffies */
 	long interval_time[MAX_TIME];		/* to store thresholds */
 
@@ -2112,6 +2106,7 @@ int get_valid_checkpoint(struct f2fs_sb_info *);
 void update_dirty_page(struct inode *, struct page *);
 void remove_dirty_inode(struct inode *);
 int sync_dirty_inodes(struct f2fs_sb_info *, enum inode_type);
+void flush_nodes_work(struct work_struct *);
 int write_checkpoint(struct f2fs_sb_info *, struct cp_control *);
 void init_ino_entry_info(struct f2fs_sb_info *);
 int __init create_checkpoint_caches(void);
@@ -2163,6 +2158,8 @@ bool space_for_roll_forward(struct f2fs_sb_info *);
  * debug.c
  */
 #ifdef CONFIG_F2FS_STAT_FS
+#define NR_VBLOCKS_HIST		10	/* buckets of 10% valid blocks */
+
 struct f2fs_stat_info {
 	struct list_head stat_list;
 	struct f2fs_sb_info *sbi;
@@ -2179,6 +2176,7 @@ struct f2fs_stat_info {
 	int inline_xattr, inline_inode, inline_dir, orphans;
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
+	unsigned int vblocks_hist[NR_CURSEG_TYPE][NR_VBLOCKS_HIST];
 	int util_free, util_valid, util_invalid;
 	int rsvd_segs, overp_segs;
 	int dirty_count, node_pages, meta_pages;
@@ -23,11 +23,74 @@
 #include "gc.h"
 #include <trace/events/f2fs.h>
 
+/*
+ * Foreground activity as seen from the block layer: reads in flight on the
+ * whole device and sync requests queued on it, plus filesystem calls made
+ * within the idle interval.  Async writes are left out on purpose, since
+ * most of them are writeback of what background gc itself just moved.
+ */
+static bool gc_device_busy(struct f2fs_sb_info *sbi)
+{
+	struct block_device *bdev = sbi->sb->s_bdev;
+	struct request_queue *q = bdev_get_queue(bdev);
+
+	if (atomic_read(&bdev->bd_disk->part0.in_flight[READ]))
+		return true;
+	if (q->rq.count[BLK_RW_SYNC])
+		return true;
+	return !f2fs_time_over(sbi, REQ_TIME);
+}
+
+static inline void gc_update_avg(unsigned int *avg, unsigned int sample)
+{
+	if (!*avg)
+		*avg = sample;
+	else
+		*avg = *avg - (*avg >> 3) + (sample >> 3);
+}
+
+/*
+ * Track how long the device stays quiet between bursts of foreground I/O
+ * and only let background gc start when the current quiet period is
+ * expected to last long enough for one gc pass:
+ *  - the device has been quiet for at least idle_min_time, and
+ *  - either it has already been quiet for longer than the average window
+ *    (screen off, the window is likely to go on), or what remains of an
+ *    average window still fits an average gc pass.
+ */
+static bool gc_idle_predicted(struct f2fs_sb_info *sbi,
+				struct f2fs_gc_kthread *gc_th)
+{
+	unsigned int idle_ms;
+
+	if (gc_device_busy(sbi)) {
+		if (gc_th->idle_start) {
+			gc_update_avg(&gc_th->avg_idle_ms,
+				jiffies_to_msecs(jiffies - gc_th->idle_start));
+			gc_th->idle_start = 0;
+		}
+		return false;
+	}
+
+	if (!gc_th->idle_start) {
+		gc_th->idle_start = jiffies;
+		return false;
+	}
+
+	idle_ms = jiffies_to_msecs(jiffies - gc_th->idle_start);
+	if (idle_ms < gc_th->idle_min_time)
+		return false;
+	if (idle_ms >= gc_th->avg_idle_ms)
+		return true;
+	return gc_th->avg_idle_ms - idle_ms >= gc_th->avg_gc_ms;
+}
+
 static int gc_thread_func(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
+	unsigned long start;
 	long wait_ms;
 
 	wait_ms = gc_th->min_sleep_time;
@@ -63,22 +126,42 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
-			increase_sleep_time(gc_th, &wait_ms);
-			mutex_unlock(&sbi->gc_mutex);
-			continue;
-		}
+		if (gc_th->idle_predict) {
+			if (!gc_idle_predicted(sbi, gc_th)) {
+				wait_ms = gc_th->idle_poll_time;
+				mutex_unlock(&sbi->gc_mutex);
+				continue;
+			}
+			/* keep cleaning while the window lasts */
+			if (has_enough_invalid_blocks(sbi))
+				wait_ms = gc_th->idle_poll_time;
+			else
+				wait_ms = gc_th->min_sleep_time;
+		} else {
+			if (!is_idle(sbi)) {
+				increase_sleep_time(gc_th, &wait_ms);
+				mutex_unlock(&sbi->gc_mutex);
+				continue;
+			}
 
-		if (has_enough_invalid_blocks(sbi))
-			decrease_sleep_time(gc_th, &wait_ms);
-		else
-			increase_sleep_time(gc_th, &wait_ms);
+			if (has_enough_invalid_blocks(sbi))
+				decrease_sleep_time(gc_th, &wait_ms);
+			else
+				increase_sleep_time(gc_th, &wait_ms);
+		}
 
 		stat_inc_bggc_count(sbi);
 
 		/* if return value is not zero, no victim was selected */
-		if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC)))
+		start = jiffies;
+		if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC))) {
 			wait_ms = gc_th->no_gc_sleep_time;
+			/* we won't be watching the device for a while */
+			gc_th->idle_start = 0;
+		} else if (gc_th->idle_predict) {
+			gc_update_avg(&gc_th->avg_gc_ms,
+					jiffies_to_msecs(jiffies - start));
+		}
 
 		trace_f2fs_background_gc(sbi->sb, wait_ms,
 				prefree_segments(sbi), free_segments(sbi));
@@ -108,6 +191,13 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	gc_th->gc_idle = 0;
 
+	gc_th->idle_predict = 0;
+	gc_th->idle_poll_time = DEF_GC_IDLE_POLL_TIME;
+	gc_th->idle_min_time = DEF_GC_IDLE_MIN_TIME;
+	gc_th->idle_start = 0;
+	gc_th->avg_idle_ms = 0;
+	gc_th->avg_gc_ms = 0;
+
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
@@ -16,6 +16,10 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+
+/* idle window prediction, see gc_idle_predicted() */
+#define DEF_GC_IDLE_POLL_TIME		500	/* milliseconds */
+#define DEF_GC_IDLE_MIN_TIME		2000	/* quiet time before any GC */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -33,6 +37,19 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/*
+	 * for scheduling background gc into device idle windows:
+	 * idle_start is when the device was last seen going quiet,
+	 * avg_idle_ms and avg_gc_ms are running averages of the observed
+	 * idle window length and of one background gc pass.
+	 */
+	unsigned int idle_predict;
+	unsigned int idle_poll_time;
+	unsigned int idle_min_time;
+	unsigned long idle_start;
+	unsigned int avg_idle_ms;
+	unsigned int avg_gc_ms;
 };
 
 struct gc_inode_list {
@@ -44,6 +44,8 @@ static void fuse_request_init(struct fuse_req *req)
 	INIT_LIST_HEAD(&req->intr_entry);
 	init_waitqueue_head(&req->waitq);
 	atomic_set(&req->count, 1);
+	req->pages = req->inline_pages;
+	req->max_pages = FUSE_MAX_PAGES_PER_REQ;
 }
 
 struct fuse_req *fuse_request_alloc(void)
@@ -65,9 +67,35 @@ struct fuse_req *fuse_request_alloc_nofs(void)
 
 void fuse_request_free(struct fuse_req *req)
 {
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
 	kmem_cache_free(fuse_req_cachep, req);
 }
 
+/*
+ * Most requests carry no pages at all, so only those that read or write
+ * file data get a vector for more than FUSE_MAX_PAGES_PER_REQ pages. If
+ * it can't be had the request simply stays at the embedded one.
+ */
+void fuse_req_alloc_pages(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct page **pages;
+
+	if (fc->max_pages <= req->max_pages)
+		return;
+
+	pages = kcalloc(fc->max_pages, sizeof(pages[0]),
+			GFP_KERNEL | __GFP_NOWARN);
+	if (!pages)
+		return;
+
+	BUG_ON(req->num_pages);
+	if (req->pages != req->inline_pages)
+		kfree(req->pages);
+	req->pages = pages;
+	req->max_pages = fc->max_pages;
+}
+
 static void block_sigs(sigset_t *oldset)
 {
 	sigset_t mask;
@@ -664,7 +664,7 @@ static int fuse_readpages_fill(void *_data, struct page *page)
 	fuse_wait_on_page_writeback(inode, page->index);
 
 	if (req->num_pages &&
-	    (req->num_pages == FUSE_MAX_PAGES_PER_REQ ||
+	    (req->num_pages == req->max_pages ||
 	     (req->num_pages + 1) * PAGE_CACHE_SIZE > fc->max_read ||
 	     req->pages[req->num_pages - 1]->index + 1 != page->index)) {
 		fuse_send_readpages(req, data->file);
@@ -673,6 +673,7 @@ static int fuse_readpages_fill(void *_data, struct page *page)
 			unlock_page(page);
 			return PTR_ERR(req);
 		}
+		fuse_req_alloc_pages(fc, req);
 	}
 
 #ifdef CONFIG_CMA
@@ -736,6 +737,7 @@ static int fuse_readpages(struct file *file, struct address_space *mapping,
 	err = PTR_ERR(data.req);
 	if (IS_ERR(data.req))
 		goto out;
+	fuse_req_alloc_pages(fc, data.req);
 
 	err = read_cache_pages(mapping, pages, fuse_readpages_fill, &data);
 	if (!err) {
@@ -922,7 +924,7 @@ static ssize_t fuse_fill_write_pages(struct fuse_req *req,
 		if (!fc->big_writes)
 			break;
 	} while (iov_iter_count(ii) && count < fc->max_write &&
-		 req->num_pages < FUSE_MAX_PAGES_PER_REQ && offset == 0);
+		 req->num_pages < req->max_pages && offset == 0);
 
 	return count > 0 ? count : err;
 }
@@ -952,6 +954,8 @@ static ssize_t fuse_perform_write(struct file *file,
 			err = PTR_ERR(req);
 			break;
 		}
+		if (fc->big_writes)
+			fuse_req_alloc_pages(fc, req);
 
 		count = fuse_fill_write_pages(req, mapping, ii, pos);
 		if (count <= 0) {
@@ -1118,9 +1122,9 @@ static int fuse_get_user_pages(struct fuse_req *req, const char __user *buf,
 		return 0;
 	}
 
-	nbytes = min_t(size_t, nbytes, FUSE_MAX_PAGES_PER_REQ << PAGE_SHIFT);
+	nbytes = min_t(size_t, nbytes, req->max_pages << PAGE_SHIFT);
 	npages = (nbytes + offset + PAGE_SIZE - 1) >> PAGE_SHIFT;
-	npages = clamp(npages, 1, FUSE_MAX_PAGES_PER_REQ);
+	npages = clamp_t(int, npages, 1, req->max_pages);
 	npages = get_user_pages_fast(user_addr, npages, !write, req->pages);
 	if (npages < 0)
 		return npages;
@@ -1152,6 +1156,7 @@ ssize_t fuse_direct_io(struct file *file, const char __user *buf,
 	req = fuse_get_req(fc);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
+	fuse_req_alloc_pages(fc, req);
 
 	while (count) {
 		size_t nres;
@@ -1188,6 +1193,7 @@ ssize_t fuse_direct_io(struct file *file, const char __user *buf,
 			req = fuse_get_req(fc);
 			if (IS_ERR(req))
 				break;
+			fuse_req_alloc_pages(fc, req);
 		}
 	}
 	if (!IS_ERR(req))
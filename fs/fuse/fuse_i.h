@@ -26,6 +26,9 @@
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+/** Max number of pages of a read or write with FUSE_BIG_REQUESTS */
+#define FUSE_MAX_BIG_PAGES_PER_REQ 256
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -303,7 +306,13 @@ struct fuse_req {
 	} misc;
 
 	/** page vector */
-	struct page *pages[FUSE_MAX_PAGES_PER_REQ];
+	struct page **pages;
+
+	/** size of the page vector */
+	unsigned max_pages;
+
+	/** page vector unless fuse_req_alloc_pages() gave a bigger one */
+	struct page *inline_pages[FUSE_MAX_PAGES_PER_REQ];
 
 	/** number of pages in vector */
 	unsigned num_pages;
@@ -365,6 +374,9 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages of a read or write request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
@@ -682,6 +694,11 @@ struct fuse_req *fuse_request_alloc_nofs(void);
  */
 void fuse_request_free(struct fuse_req *req);
 
+/**
+ * Let a request carry fc->max_pages pages, if it can be allocated
+ */
+void fuse_req_alloc_pages(struct fuse_conn *fc, struct fuse_req *req);
+
 /**
  * Get a request, may fail with -ENOMEM
  */
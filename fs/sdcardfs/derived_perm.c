@@ -20,6 +20,25 @@
 
 #include "sdcardfs.h"
 
+/*
+ * Derived state is a function of the parent's derived state, the name and
+ * the package list. The generation below is bumped whenever the package
+ * list changes, a node is renamed or a root is set up, which covers every
+ * way for an existing parent's state to change. A node whose state was
+ * derived in the current generation, from the same parent data and name,
+ * is therefore still up to date and a repeated lookup does not need to
+ * redo the string compares and package list hashing. It starts at 1 so
+ * that freshly zeroed inode data never matches.
+ */
+static atomic_t derived_gen = ATOMIC_INIT(1);
+
+void sdcardfs_invalidate_derived(void)
+{
+	/* order the update that invalidates against the new generation */
+	smp_mb__before_atomic_inc();
+	atomic_inc(&derived_gen);
+}
+
 /* copy derived state from parent inode */
 static void inherit_derived_state(struct inode *parent, struct inode *child)
 {
@@ -46,6 +65,7 @@ void setup_derived_state(struct inode *inode, perm_t perm, userid_t userid,
 	info->data->under_android = false;
 	info->data->under_cache = false;
 	info->data->under_obb = false;
+	sdcardfs_invalidate_derived();
 }
 
 /* While renaming, there is a point where we want the path from dentry,
@@ -57,6 +77,7 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	struct sdcardfs_inode_info *info = SDCARDFS_I(dentry->d_inode);
 	struct sdcardfs_inode_info *parent_info = SDCARDFS_I(parent->d_inode);
 	struct sdcardfs_inode_data *parent_data = parent_info->data;
+	unsigned int gen = atomic_read(&derived_gen);
 	appid_t appid;
 	unsigned long user_num;
 	int err;
@@ -75,6 +96,19 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	 * of using the inode permissions.
 	 */
 
+	smp_rmb();
+	if (info->data->derived_gen == gen &&
+	    info->data->derived_parent == parent_data &&
+	    info->data->derived_hash == name->hash)
+		return;
+	/*
+	 * The generation was read before deriving, so a package list change
+	 * racing with us leaves a stale stamp and forces another pass.
+	 */
+	info->data->derived_gen = gen;
+	info->data->derived_parent = parent_data;
+	info->data->derived_hash = name->hash;
+
 	inherit_derived_state(parent->d_inode, dentry->d_inode);
 
 	/* Files don't get special labels */
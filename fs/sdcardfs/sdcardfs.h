@@ -166,6 +166,11 @@ struct sdcardfs_inode_data {
 	bool under_android;
 	bool under_cache;
 	bool under_obb;
+
+	/* what the state above was derived from, see derived_perm.c */
+	unsigned int derived_gen;
+	struct sdcardfs_inode_data *derived_parent;
+	unsigned int derived_hash;
 };
 
 /* sdcardfs inode data in memory */
@@ -501,6 +506,7 @@ struct limit_search {
 	userid_t userid;
 };
 
+extern void sdcardfs_invalidate_derived(void);
 extern void setup_derived_state(struct inode *inode, perm_t perm,
 			userid_t userid, uid_t uid);
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_ALLOC_BENCH_H
+#define _LINUX_ALLOC_BENCH_H
+
+#include <linux/types.h>
+
+struct dentry;
+
+/**
+ * struct alloc_bench_ops - An allocator timed by lib/alloc_bench.c
+ * @name: Name of the debugfs file that runs the benchmark
+ * @setup: Optional, create the state passed to the other callbacks
+ * @teardown: Optional, release the state created by @setup
+ * @alloc: Allocate @size bytes and store a cookie for @free in @cookie
+ * @free: Release an allocation made by @alloc
+ * @sizes: Zero terminated list of sizes to time, NULL for the default list
+ * @dent: Private to alloc_bench
+ */
+struct alloc_bench_ops {
+	const char *name;
+	int (*setup)(void **priv);
+	void (*teardown)(void *priv);
+	int (*alloc)(void *priv, size_t size, unsigned long *cookie);
+	void (*free)(void *priv, unsigned long cookie);
+	const size_t *sizes;
+	struct dentry *dent;
+};
+
+#ifdef CONFIG_ALLOC_BENCH
+int alloc_bench_register(struct alloc_bench_ops *ops);
+void alloc_bench_unregister(struct alloc_bench_ops *ops);
+#else
+static inline int alloc_bench_register(struct alloc_bench_ops *ops)
+{
+	return 0;
+}
+
+static inline void alloc_bench_unregister(struct alloc_bench_ops *ops)
+{
+}
+#endif
+
+#endif /* _LINUX_ALLOC_BENCH_H */
@@ -25,6 +25,10 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			bool sync, bool *contended);
 extern int compact_pgdat(pg_data_t *pgdat, int order);
 extern void reset_isolation_suitable(pg_data_t *pgdat);
+extern int sysctl_kcompactd_order;
+extern int sysctl_kcompactd_extfrag_threshold;
+extern int sysctl_kcompactd_interval_ms;
+extern void wakeup_kcompactd(int order);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
 
 /* Do not skip compaction more than 64 times */
@@ -89,6 +93,10 @@ static inline void reset_isolation_suitable(pg_data_t *pgdat)
 {
 }
 
+static inline void wakeup_kcompactd(int order)
+{
+}
+
 static inline unsigned long compaction_suitable(struct zone *zone, int order)
 {
 	return COMPACT_SKIPPED;
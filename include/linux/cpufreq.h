@@ -349,6 +349,15 @@ static inline unsigned int cpufreq_quick_get_max(unsigned int cpu)
 }
 #endif
 
+/* boost the CPUs for a touch that is about to be reported */
+#ifdef CONFIG_CPU_FREQ
+void cpu_boost_input_irq(void);
+#else
+static inline void cpu_boost_input_irq(void)
+{
+}
+#endif
+
 
 /*********************************************************************
  *                       CPUFREQ DEFAULT GOVERNOR                    *
@@ -425,6 +434,14 @@ void cpufreq_frequency_table_put_attr(unsigned int cpu);
  *                         CPUFREQ STATS                             *
  *********************************************************************/
 
+struct seq_file;
+struct pid_namespace;
+struct pid;
+
 void acct_update_power(struct task_struct *p, cputime_t cputime);
+void cpufreq_task_stats_init(struct task_struct *p);
+void cpufreq_task_stats_free(struct task_struct *p);
+int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
+			    struct pid *pid, struct task_struct *p);
 
 #endif /* _LINUX_CPUFREQ_H */
@@ -36,6 +36,7 @@ struct cpuidle_state_usage {
 
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	mispredict; /* left before target_residency */
 };
 
 struct cpuidle_state {
@@ -94,6 +95,7 @@ struct cpuidle_device {
 	unsigned int		cpu;
 
 	int			last_residency;
+	int			wakeup_irq;
 	int			state_count;
 	struct cpuidle_state_usage	states_usage[CPUIDLE_STATE_MAX];
 	struct cpuidle_state_kobj *kobjs[CPUIDLE_STATE_MAX];
@@ -111,6 +113,10 @@ struct cpuidle_device {
 
 DECLARE_PER_CPU(struct cpuidle_device *, cpuidle_devices);
 
+/* wakeup_irq values that are not interrupt numbers */
+#define CPUIDLE_WAKEUP_NONE	-1
+#define CPUIDLE_WAKEUP_PENDING	-2
+
 /**
  * cpuidle_get_last_residency - retrieves the last state's residency time
  * @dev: the target CPU
@@ -160,6 +166,18 @@ extern int cpuidle_wrap_enter(struct cpuidle_device *dev,
 					struct cpuidle_driver *drv, int index));
 extern int cpuidle_play_dead(void);
 
+/**
+ * cpuidle_note_wakeup_irq - records the interrupt that ended an idle period
+ * @irq: the interrupt being handled
+ */
+static inline void cpuidle_note_wakeup_irq(unsigned int irq)
+{
+	struct cpuidle_device *dev = __this_cpu_read(cpuidle_devices);
+
+	if (dev && dev->wakeup_irq == CPUIDLE_WAKEUP_PENDING)
+		dev->wakeup_irq = irq;
+}
+
 #else
 static inline void disable_cpuidle(void) { }
 static inline int cpuidle_idle_call(void) { return -ENODEV; }
@@ -185,6 +203,7 @@ static inline int cpuidle_wrap_enter(struct cpuidle_device *dev,
 					struct cpuidle_driver *drv, int index))
 { return -ENODEV; }
 static inline int cpuidle_play_dead(void) {return -ENODEV; }
+static inline void cpuidle_note_wakeup_irq(unsigned int irq) { }
 
 #endif
 
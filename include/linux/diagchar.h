@@ -24,6 +24,7 @@
 #define DCI_LOG_MASKS_TYPE	0x00000100
 #define DCI_EVENT_MASKS_TYPE	0x00000200
 #define DCI_PKT_TYPE		0x00000400
+#define MD_RING_DATA_TYPE	0x00000800
 
 #define USB_MODE			1
 #define MEMORY_DEVICE_MODE		2
@@ -57,6 +58,7 @@
 #define DIAG_IOCTL_REMOTE_DEV		32
 #define DIAG_IOCTL_VOTE_REAL_TIME	33
 #define DIAG_IOCTL_GET_REAL_TIME	34
+#define DIAG_IOCTL_MD_RING_INIT		35
 
 /* PC Tools IDs */
 #define APQ8060_TOOLS_ID	4062
@@ -184,6 +186,42 @@ struct diagpkt_delay_params {
 	int *num_bytes_ptr;
 };
 
+/*
+ * Memory device ring.  After DIAG_IOCTL_MD_RING_INIT the logging process
+ * mmaps the device: a diag_md_ring_hdr followed, at DIAG_MD_RING_HDR_SIZE,
+ * by the data area.  The kernel appends records at head, the reader
+ * consumes them from tail; both are free running byte counts.  A read()
+ * returns MD_RING_DATA_TYPE once watermark bytes are queued or data has
+ * waited flush_ms.  Data that doesn't fit is still returned by read().
+ */
+#define DIAG_MD_RING_VERSION	1
+#define DIAG_MD_RING_HDR_SIZE	64
+#define DIAG_MD_RING_ALIGN	8
+
+#define DIAG_MD_RING_REC_DATA	1
+#define DIAG_MD_RING_REC_PAD	2	/* skip to the start of the ring */
+
+struct diag_md_ring_params {
+	uint32_t size;		/* data area size, a power of 2 */
+	uint32_t watermark;	/* 0 for a quarter of the ring */
+	uint32_t flush_ms;	/* 0 for the default */
+};
+
+struct diag_md_ring_hdr {
+	uint32_t version;
+	uint32_t size;
+	uint32_t head;		/* written by the kernel */
+	uint32_t tail;		/* written by the reader */
+	uint32_t overflow;	/* packets returned by read() instead */
+};
+
+/* Each record is padded to DIAG_MD_RING_ALIGN bytes */
+struct diag_md_ring_rec {
+	uint16_t type;
+	uint16_t peripheral;
+	uint32_t len;		/* payload bytes that follow */
+};
+
 static const uint32_t msg_bld_masks_0[] = {
 	MSG_LVL_LOW,
 	MSG_LVL_MED,
@@ -147,6 +147,9 @@ typedef void (*ctor_fn_t)(void);
 
 /* Defined in init/main.c */
 extern int do_one_initcall(initcall_t fn);
+extern int schedule_async_initcall(initcall_t fn);
+extern int schedule_deferred_initcall(initcall_t fn);
+extern void run_deferred_initcalls(void);
 extern char __initdata boot_command_line[];
 extern char *saved_command_line;
 extern unsigned int reset_devices;
@@ -212,6 +215,24 @@ extern bool initcall_debug;
 
 #define __initcall(fn) device_initcall(fn)
 
+/*
+ * async_initcall() runs fn on the async threads, in parallel with the other
+ * device initcalls.  All of them are done before the late initcalls start.
+ *
+ * deferred_initcall() runs fn once the first frame has been displayed, or
+ * after a timeout, for devices that are not needed to boot.  fn is called
+ * after the init sections are freed, so it must not be marked __init.
+ */
+#define async_initcall(fn)					\
+	static int __init __async_initcall_##fn(void)		\
+	{ return schedule_async_initcall(fn); }			\
+	device_initcall(__async_initcall_##fn)
+
+#define deferred_initcall(fn)					\
+	static int __init __deferred_initcall_##fn(void)	\
+	{ return schedule_deferred_initcall(fn); }		\
+	device_initcall(__deferred_initcall_##fn)
+
 #define __exitcall(fn) \
 	static exitcall_t __exitcall_##fn __exit_call = fn
 
@@ -289,6 +310,8 @@ void __init parse_early_options(char *cmdline);
 #define fs_initcall(fn)			module_init(fn)
 #define device_initcall(fn)		module_init(fn)
 #define late_initcall(fn)		module_init(fn)
+#define async_initcall(fn)		module_init(fn)
+#define deferred_initcall(fn)		module_init(fn)
 
 #define security_initcall(fn)		module_init(fn)
 
@@ -423,6 +423,24 @@ static inline void input_mt_sync(struct input_dev *dev)
 	input_event(dev, EV_SYN, SYN_MT_REPORT, 0);
 }
 
+/**
+ * input_set_timestamp - set the time the current packet was sampled
+ * @dev: input device the packet is reported on
+ * @timestamp: CLOCK_MONOTONIC time of the sample, e.g. taken in the IRQ
+ *
+ * Must be called before the first event of the packet. evdev then stamps
+ * the events up to and including the next SYN_REPORT with @timestamp
+ * instead of the time they were delivered.
+ */
+static inline void input_set_timestamp(struct input_dev *dev,
+				       ktime_t timestamp)
+{
+	struct timespec ts = ktime_to_timespec(timestamp);
+
+	input_event(dev, EV_SYN, SYN_TIME_SEC, ts.tv_sec);
+	input_event(dev, EV_SYN, SYN_TIME_NSEC, ts.tv_nsec);
+}
+
 void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
 
 /**
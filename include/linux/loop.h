@@ -13,6 +13,7 @@
 #include <linux/blkdev.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <uapi/linux/loop.h>
 
 /* Possible states of device */
@@ -23,6 +24,15 @@ enum {
 };
 
 struct loop_func_table;
+struct loop_device;
+
+/* Upper bound of reads a loop device has in flight on its backing file */
+#define LOOP_READ_WORKERS	4
+
+struct loop_read_worker {
+	struct work_struct	work;
+	struct loop_device	*lo;
+};
 
 struct loop_device {
 	int		lo_number;
@@ -58,6 +68,11 @@ struct loop_device {
 	struct task_struct	*lo_thread;
 	wait_queue_head_t	lo_event;
 
+	struct bio_list		lo_read_list;
+	struct workqueue_struct	*lo_read_wq;
+	struct loop_read_worker	lo_read_worker[LOOP_READ_WORKERS];
+	unsigned int		lo_read_next;
+
 	struct request_queue	*lo_queue;
 	struct gendisk		*lo_disk;
 };
@@ -192,6 +192,10 @@ static inline void mem_cgroup_dec_page_stat(struct page *page,
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 						gfp_t gfp_mask,
 						unsigned long *total_scanned);
+bool mem_cgroup_soft_reclaim_eligible(struct mem_cgroup *memcg,
+				      struct mem_cgroup *root);
+void mem_cgroup_count_reclaim(struct mem_cgroup *memcg, bool kswapd,
+			      unsigned long scanned, unsigned long reclaimed);
 u64 mem_cgroup_get_limit(struct mem_cgroup *memcg);
 
 void mem_cgroup_count_vm_event(struct mm_struct *mm, enum vm_event_item idx);
@@ -397,6 +401,18 @@ unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 	return 0;
 }
 
+static inline bool mem_cgroup_soft_reclaim_eligible(struct mem_cgroup *memcg,
+						    struct mem_cgroup *root)
+{
+	return false;
+}
+
+static inline void mem_cgroup_count_reclaim(struct mem_cgroup *memcg,
+					    bool kswapd, unsigned long scanned,
+					    unsigned long reclaimed)
+{
+}
+
 static inline
 u64 mem_cgroup_get_limit(struct mem_cgroup *memcg)
 {
@@ -1533,6 +1533,22 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+#ifdef CONFIG_READAHEAD_LEARNING
+extern unsigned int sysctl_readahead_learn_ms;
+
+void ra_pattern_record(struct address_space *mapping, pgoff_t index);
+void ra_pattern_replay(struct file *filp);
+int ra_pattern_advise(struct address_space *mapping, int advice);
+void ra_pattern_free(struct address_space *mapping);
+#else
+static inline void ra_pattern_replay(struct file *filp) {}
+static inline int ra_pattern_advise(struct address_space *mapping, int advice)
+{
+	return -EINVAL;
+}
+static inline void ra_pattern_free(struct address_space *mapping) {}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
@@ -86,6 +86,9 @@ struct mmc_ext_csd {
 	bool			bkops_en;	/* background enable bit */
 	unsigned int            data_sector_size;       /* 512 bytes or 4KB */
 	unsigned int            data_tag_unit_size;     /* DATA TAG UNIT size */
+	bool			cmdq_support;	/* command queue support bit */
+	bool			cmdq_en;	/* command queue enable bit */
+	unsigned int		cmdq_depth;	/* command queue depth */
 	unsigned int		boot_ro_lock;		/* ro lock support */
 	bool			boot_ro_lockable;
 	u8			raw_exception_status;	/* 53 */
@@ -208,6 +211,18 @@ enum mmc_packed_stop_reasons {
 	MAX_REASONS,
 };
 
+enum mmc_no_packed_reasons {
+	NO_PACK_UNSUPPORTED = 0,
+	NO_PACK_CONTROL,
+	NO_PACK_REL_WRITE,
+	NO_PACK_LARGE_SEC_ALIGN,
+	NO_PACK_FUA,
+	NO_PACK_LARGE_REQ,
+	NO_PACK_HOST_BUSY,
+	NO_PACK_SINGLE,
+	MAX_NO_PACK_REASONS,
+};
+
 enum mmc_blk_status {
 	MMC_BLK_SUCCESS = 0,
 	MMC_BLK_PARTIAL,
@@ -225,7 +240,9 @@ enum mmc_blk_status {
 
 struct mmc_wr_pack_stats {
 	u32 *packing_events;
+	u32 *rd_packing_events;
 	u32 pack_stop_reason[MAX_REASONS];
+	u32 no_pack_reason[MAX_NO_PACK_REASONS];
 	spinlock_t lock;
 	bool enabled;
 	bool print_in_read;
@@ -202,6 +202,7 @@ extern void mmc_release_host(struct mmc_host *host);
 extern int mmc_try_claim_host(struct mmc_host *host);
 extern void mmc_set_ios(struct mmc_host *host);
 extern int mmc_flush_cache(struct mmc_card *);
+extern int mmc_cmdq_ctrl(struct mmc_card *, bool);
 
 extern int mmc_detect_card_removed(struct mmc_host *host);
 
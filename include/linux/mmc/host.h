@@ -15,6 +15,7 @@
 #include <linux/device.h>
 #include <linux/fault-inject.h>
 #include <linux/wakelock.h>
+#include <linux/ktime.h>
 
 #include <linux/mmc/core.h>
 #include <linux/mmc/pm.h>
@@ -309,6 +310,7 @@ struct mmc_host {
 #define MMC_CAP2_CORE_PM	(1 << 23)       /* use PM framework */
 #define MMC_CAP2_HS400		(MMC_CAP2_HS400_1_8V | \
 				 MMC_CAP2_HS400_1_2V)
+#define MMC_CAP2_CMDQ		(1 << 24)	/* Allow command queueing */
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
 
 	int			clk_requests;	/* internal reference counter */
@@ -357,6 +359,9 @@ struct mmc_host {
 	struct wake_lock	detect_wake_lock;
 	const char		*wlock_name;
 	int			detect_change;	/* card detect flag */
+
+	struct work_struct	early_resume_work; /* resume ahead of I/O */
+	ktime_t			early_resume_start;
 	struct mmc_hotplug	hotplug;
 
 	const struct mmc_bus_ops *bus_ops;	/* current bus driver */
@@ -439,6 +444,7 @@ extern bool mmc_host_may_gate_card(struct mmc_card *);
 extern int mmc_add_host(struct mmc_host *);
 extern void mmc_remove_host(struct mmc_host *);
 extern void mmc_free_host(struct mmc_host *);
+extern void mmc_host_early_resume(struct mmc_host *);
 
 #ifdef CONFIG_MMC_EMBEDDED_SDIO
 extern void mmc_set_embedded_sdio_data(struct mmc_host *host,
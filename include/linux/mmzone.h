@@ -35,6 +35,13 @@
  */
 #define PAGE_ALLOC_COSTLY_ORDER 3
 
+/*
+ * Orders up to PCP_HIGH_ORDER_MAX are cached on the per-cpu pagesets in
+ * addition to order-0 pages, so that kernel stacks, skbs and slabs do
+ * not need zone->lock on every allocation and free.
+ */
+#define PCP_HIGH_ORDER_MAX PAGE_ALLOC_COSTLY_ORDER
+
 enum {
 	MIGRATE_UNMOVABLE,
 	MIGRATE_RECLAIMABLE,
@@ -152,6 +159,8 @@ enum zone_stat_item {
 	NR_ANON_TRANSPARENT_HUGEPAGES,
 	NR_FREE_CMA_PAGES,
 	NR_SWAPCACHE,
+	WORKINGSET_REFAULT,	/* evicted file pages read back in */
+	WORKINGSET_ACTIVATE,	/* refaulted pages activated as working set */
 	NR_VM_ZONE_STAT_ITEMS };
 
 /*
@@ -235,6 +244,14 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/*
+	 * Blocks of order 1 to PCP_HIGH_ORDER_MAX, one list per order and
+	 * migrate type.  high_count is in base pages and is kept below
+	 * high in the same way as count.
+	 */
+	int high_count;
+	struct list_head high_lists[PCP_HIGH_ORDER_MAX][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
@@ -426,6 +443,9 @@ struct zone {
 	/* Zone statistics */
 	atomic_long_t		vm_stat[NR_VM_ZONE_STAT_ITEMS];
 
+	/* Evictions and activations of inactive file pages, see workingset.c */
+	atomic_long_t		inactive_age;
+
 	/*
 	 * The target ratio of ACTIVE_ANON to INACTIVE_ANON pages on
 	 * this zone's LRU.  Maintained by the pageout code.
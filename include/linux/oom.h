@@ -53,6 +53,39 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+/*
+ * The lowmemorykiller keeps thread group leaders sorted by oom_score_adj.
+ * add/del/replace are called with tasklist_lock held for writing.
+ */
+static inline void lmk_adj_tree_init(struct task_struct *p)
+{
+	RB_CLEAR_NODE(&p->adj_node);
+}
+extern void lmk_adj_tree_add(struct task_struct *p);
+extern void lmk_adj_tree_del(struct task_struct *p);
+extern void lmk_adj_tree_replace(struct task_struct *old,
+				 struct task_struct *new);
+extern void lmk_adj_tree_update(struct task_struct *p);
+#else
+static inline void lmk_adj_tree_init(struct task_struct *p)
+{
+}
+static inline void lmk_adj_tree_add(struct task_struct *p)
+{
+}
+static inline void lmk_adj_tree_del(struct task_struct *p)
+{
+}
+static inline void lmk_adj_tree_replace(struct task_struct *old,
+					struct task_struct *new)
+{
+}
+static inline void lmk_adj_tree_update(struct task_struct *p)
+{
+}
+#endif
+
 /* sysctls */
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
@@ -200,6 +200,19 @@ static inline void page_unfreeze_refs(struct page *page, int count)
 	atomic_set(&page->_count, count);
 }
 
+/*
+ * Let readahead learning see an access to @index, if a pattern is being
+ * learnt for @mapping.
+ */
+static inline void page_cache_record_access(struct address_space *mapping,
+					    pgoff_t index)
+{
+#ifdef CONFIG_READAHEAD_LEARNING
+	if (unlikely(mapping->ra_pattern))
+		ra_pattern_record(mapping, index);
+#endif
+}
+
 #ifdef CONFIG_NUMA
 extern struct page *__page_cache_alloc(gfp_t gfp);
 #else
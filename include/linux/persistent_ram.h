@@ -21,6 +21,8 @@
 #include <linux/types.h>
 
 struct persistent_ram_buffer;
+struct persistent_ram_block;
+struct persistent_ram_record;
 
 struct persistent_ram_descriptor {
 	const char	*name;
@@ -60,6 +62,12 @@ struct persistent_ram_zone {
 	int ecc_symsize;
 	int ecc_poly;
 
+	/* lz4 compression */
+	struct persistent_ram_block *block;
+	uint8_t *block_data;
+	struct persistent_ram_record *record;
+	void *lz4_wrkmem;
+
 	char *old_log;
 	size_t old_log_size;
 	size_t old_log_footer_size;
@@ -70,6 +78,10 @@ int persistent_ram_early_init(struct persistent_ram *ram);
 
 struct persistent_ram_zone *persistent_ram_init_ringbuffer(struct device *dev,
 		bool ecc);
+struct persistent_ram_zone *persistent_ram_init_compressed(struct device *dev,
+		bool ecc);
+int persistent_ram_init_percpu(struct device *dev, bool ecc,
+		struct persistent_ram_zone **przs, int n);
 
 int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 	unsigned int count);
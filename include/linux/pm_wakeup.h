@@ -55,6 +55,8 @@ struct wakeup_source {
 	ktime_t last_time;
 	ktime_t start_prevent_time;
 	ktime_t prevent_sleep_time;
+	ktime_t cost_time;
+	u64			cpu_cost;
 	unsigned long		event_count;
 	unsigned long		active_count;
 	unsigned long		relax_count;
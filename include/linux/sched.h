@@ -112,6 +112,14 @@ extern unsigned long this_cpu_load(void);
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+extern unsigned int sysctl_sched_ravg_window;
+extern unsigned int sysctl_sched_demand_notify_pct;
+extern struct atomic_notifier_head cpu_demand_notifier_head;
+extern unsigned int sched_get_cpu_demand(int cpu);
+extern void sched_set_demand_callbacks(int enable);
+#endif
+
 extern void calc_global_load(unsigned long ticks);
 extern void update_cpu_load_nohz(void);
 
@@ -1176,6 +1184,8 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+
+	u64			rt_wakeup_start;
 };
 #endif
 
@@ -1222,6 +1232,33 @@ struct sched_rt_entity {
 #endif
 };
 
+#define RAVG_HIST_SIZE  5
+
+/* ravg tracks the recent, window-based cpu demand of a task */
+struct ravg {
+	/*
+	 * 'window_start' marks the beginning of the current window and
+	 * 'mark_start' the last time the task's accounting was updated
+	 * within it.
+	 *
+	 * 'sum' is the time the task has spent running in the current
+	 * window.
+	 *
+	 * 'sum_history' keeps the busy time of the last RAVG_HIST_SIZE
+	 * completed windows, most recent first.
+	 *
+	 * 'demand' is the task's demand derived from sum_history: the
+	 * larger of its average and of the most recent window.
+	 *
+	 * 'accounted' is set while 'demand' is included in the
+	 * cumulative demand of the task's runqueue.
+	 */
+	u64 window_start, mark_start;
+	u32 sum, demand;
+	u32 sum_history[RAVG_HIST_SIZE];
+	int accounted;
+};
+
 /*
  * default timeslice is 100 msecs (used only for SCHED_RR tasks).
  * Timeslices get refilled after they expire.
@@ -1255,6 +1292,9 @@ struct task_struct {
 	const struct sched_class *sched_class;
 	struct sched_entity se;
 	struct sched_rt_entity rt;
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	struct ravg ravg;
+#endif
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
 #endif
@@ -1297,6 +1337,10 @@ struct task_struct {
 #endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+	/* thread group leaders only, see lmk_adj_tree_add() */
+	struct rb_node adj_node;
+#endif
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
@@ -1373,6 +1417,8 @@ struct task_struct {
 	cputime_t utime, stime, utimescaled, stimescaled;
 	cputime_t gtime;
 	unsigned long long cpu_power;
+	cputime_t *time_in_state;	/* indexed like cpufreq task_freq_table */
+	unsigned int max_state;
 
 #ifndef CONFIG_VIRT_CPU_ACCOUNTING
 	cputime_t prev_utime, prev_stime;
@@ -2790,6 +2836,17 @@ static inline void set_task_cpu(struct task_struct *p, unsigned int cpu)
 
 #endif /* CONFIG_SMP */
 
+/*
+ * Passed to migration_notifier_head callbacks when a task of a group with
+ * notify_on_migrate set moves between CPUs. @load is the task's windowed
+ * demand in percent of the window, or 0 if it is not tracked.
+ */
+struct migration_notify_data {
+	int src_cpu;
+	int dest_cpu;
+	int load;
+};
+
 extern struct atomic_notifier_head migration_notifier_head;
 
 extern long sched_setaffinity(pid_t pid, const struct cpumask *new_mask);
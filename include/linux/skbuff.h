@@ -370,6 +370,7 @@ typedef unsigned char *sk_buff_data_t;
  *	@no_fcs:  Request NIC to treat last 4 bytes as Ethernet FCS
  *	@dma_cookie: a cookie to one of several possible DMA operations
  *		done by skb DMA functions
+ *	@napi_id: id of the NAPI struct this skb came from
  *	@secmark: security marking
  *	@mark: Generic packet mark
  *	@dropcount: total number of sk_receive_queue overflows
@@ -470,8 +471,11 @@ struct sk_buff {
 	/* 9/11 bit hole (depending on ndisc_nodetype presence) */
 	kmemcheck_bitfield_end(flags2);
 
-#ifdef CONFIG_NET_DMA
-	dma_cookie_t		dma_cookie;
+#if defined CONFIG_NET_DMA || defined CONFIG_NET_RX_BUSY_POLL
+	union {
+		unsigned int	napi_id;
+		dma_cookie_t	dma_cookie;
+	};
 #endif
 #ifdef CONFIG_NETWORK_SECMARK
 	__u32			secmark;
@@ -575,6 +579,33 @@ static inline struct sk_buff *alloc_skb_fclone(unsigned int size,
 extern void skb_recycle(struct sk_buff *skb);
 extern bool skb_recycle_check(struct sk_buff *skb, int skb_size);
 
+/**
+ * struct skb_recycle_stats - skb recycling pool counters
+ * @alloc_hits: allocations served from the pool
+ * @alloc_misses: allocations that fell back to the allocator
+ * @recycled: freed skbs put back in the pool
+ * @dropped: freed skbs the pool could not take back
+ */
+struct skb_recycle_stats {
+	unsigned long alloc_hits;
+	unsigned long alloc_misses;
+	unsigned long recycled;
+	unsigned long dropped;
+};
+
+struct skb_recycle_pool;
+
+extern struct skb_recycle_pool *skb_recycle_pool_create(unsigned int skb_size,
+							unsigned int max);
+extern void skb_recycle_pool_destroy(struct skb_recycle_pool *pool);
+extern struct sk_buff *skb_recycle_pool_alloc(struct skb_recycle_pool *pool,
+					      struct net_device *dev,
+					      gfp_t gfp_mask);
+extern void skb_recycle_pool_free(struct skb_recycle_pool *pool,
+				  struct sk_buff *skb);
+extern void skb_recycle_pool_stats(struct skb_recycle_pool *pool,
+				   struct skb_recycle_stats *stats);
+
 extern struct sk_buff *skb_morph(struct sk_buff *dst, struct sk_buff *src);
 extern int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask);
 extern struct sk_buff *skb_clone(struct sk_buff *skb,
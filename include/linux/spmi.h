@@ -43,6 +43,20 @@ enum spmi_commands {
 
 struct spmi_device;
 
+/**
+ * struct spmi_xfer: one extended register access of a transfer batch
+ * @addr: slave register address (16-bit address)
+ * @buf: data to write, or buffer to be populated with data from the Slave
+ * @len: number of bytes, split into transactions of up to 8 bytes
+ * @write: write the register(s) instead of reading them
+ */
+struct spmi_xfer {
+	u16			addr;
+	u8			*buf;
+	u16			len;
+	bool			write;
+};
+
 /**
  * struct spmi_controller: interface to the SPMI master controller
  * @nr: board-specific number identifier for this controller/bus
@@ -50,6 +64,10 @@ struct spmi_device;
  * @cmd: sends a non-data command sequence on the SPMI bus.
  * @read_cmd: sends a register read command sequence on the SPMI bus.
  * @write_cmd: sends a register write command sequence on the SPMI bus.
+ * @xfer_batch: optional, sends a list of extended register long reads and
+ *	writes to one slave in a row, without giving up the bus in between.
+ * @reg_caches: register ranges cached by spmi_ext_register_cache().
+ * @cache_lock: protects @reg_caches.
  */
 struct spmi_controller {
 	struct device		dev;
@@ -60,6 +78,10 @@ struct spmi_controller {
 				u8 opcode, u8 sid, u16 addr, u8 bc, u8 *buf);
 	int		(*write_cmd)(struct spmi_controller *,
 				u8 opcode, u8 sid, u16 addr, u8 bc, u8 *buf);
+	int		(*xfer_batch)(struct spmi_controller *, u8 sid,
+				struct spmi_xfer *xfers, int num);
+	struct list_head	reg_caches;
+	spinlock_t		cache_lock;
 };
 #define to_spmi_controller(d) container_of(d, struct spmi_controller, dev)
 
@@ -372,6 +394,47 @@ extern int spmi_ext_register_write(struct spmi_controller *ctrl,
 extern int spmi_ext_register_writel(struct spmi_controller *ctrl,
 					u8 sid, u16 ad, u8 *buf, int len);
 
+/**
+ * spmi_ext_register_xfer_batch() - batch of extended register long accesses
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @xfers: reads and writes to do, in order.
+ * @num: number of entries in @xfers.
+ *
+ * Does every access of @xfers on the Slave device, each one of any length,
+ * and stops at the first one that fails. Controllers that support it run
+ * the whole batch in one go, so polling a peripheral costs one bus
+ * acquisition instead of one per register. Keep batches to a few tens of
+ * bytes, the bus stays claimed for the whole batch.
+ */
+extern int spmi_ext_register_xfer_batch(struct spmi_controller *ctrl,
+					u8 sid, struct spmi_xfer *xfers,
+					int num);
+
+/**
+ * spmi_ext_register_cache() - cache a range of registers
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @ad: first register of the range (16-bit address).
+ * @len: number of registers in the range.
+ *
+ * Reads the range once and serves later spmi_ext_register_readl() calls
+ * that fall entirely within it from memory. Writes through this API keep
+ * the cache up to date. Only meant for static and configuration registers
+ * that the hardware never changes by itself.
+ */
+extern int spmi_ext_register_cache(struct spmi_controller *ctrl,
+					u8 sid, u16 ad, int len);
+
+/**
+ * spmi_ext_register_cache_drop() - stop caching a range of registers
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @ad: first register of a range given to spmi_ext_register_cache().
+ */
+extern void spmi_ext_register_cache_drop(struct spmi_controller *ctrl,
+					u8 sid, u16 ad);
+
 /**
  * spmi_command_reset() - sends RESET command to the specified slave
  * @ctrl: SPMI controller.
@@ -360,6 +360,8 @@ extern bool pm_get_wakeup_count(unsigned int *count, bool block);
 extern bool pm_save_wakeup_count(unsigned int count);
 extern void pm_wakep_autosleep_enabled(bool set);
 extern void pm_get_active_wakeup_sources(char *pending_sources, size_t max);
+extern void pm_wakeup_cost_start(void);
+extern void pm_wakeup_cost_end(u64 cpu_us);
 static inline void lock_system_sleep(void)
 {
 	current->flags |= PF_FREEZER_SKIP;
@@ -419,6 +421,23 @@ static inline void queue_up_suspend_work(void) {}
 
 #endif /* !CONFIG_PM_AUTOSLEEP */
 
+#ifdef CONFIG_SUSPEND_TIME
+
+/* kernel/power/suspend_time.c */
+void suspend_time_resume_start(void);
+void suspend_time_device_resumed(struct device *dev, ktime_t delta,
+				 bool async);
+void suspend_time_resume_end(void);
+
+#else /* !CONFIG_SUSPEND_TIME */
+
+static inline void suspend_time_resume_start(void) {}
+static inline void suspend_time_device_resumed(struct device *dev,
+					       ktime_t delta, bool async) {}
+static inline void suspend_time_resume_end(void) {}
+
+#endif /* !CONFIG_SUSPEND_TIME */
+
 #ifdef CONFIG_ARCH_SAVE_PAGE_KEYS
 /*
  * The ARCH_SAVE_PAGE_KEYS functions can be used by an architecture
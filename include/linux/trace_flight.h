@@ -0,0 +1,42 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_TRACE_FLIGHT_H
+#define _LINUX_TRACE_FLIGHT_H
+
+#include <linux/types.h>
+
+enum flight_event {
+	FLIGHT_SCHED_SWITCH,	/* a: prev pid, b: next pid | prev state << 24 */
+	FLIGHT_IRQ_ENTRY,	/* a: irq */
+	FLIGHT_IRQ_EXIT,	/* a: irq, b: handler return value */
+	FLIGHT_CPU_FREQ,	/* a: frequency in kHz, b: cpu */
+	FLIGHT_BLOCK_ISSUE,	/* a: sector, b: bytes | write << 31 */
+	FLIGHT_BLOCK_COMPLETE,	/* a: sector, b: bytes | write << 31 */
+	FLIGHT_MARK,		/* a, b: caller defined */
+	FLIGHT_EVENT_MAX,
+};
+
+#ifdef CONFIG_TRACE_FLIGHT_RECORDER
+void trace_flight_record(enum flight_event type, u32 a, u32 b);
+void trace_flight_trigger(const char *reason);
+#else
+static inline void trace_flight_record(enum flight_event type, u32 a, u32 b)
+{
+}
+
+static inline void trace_flight_trigger(const char *reason)
+{
+}
+#endif
+
+#endif /* _LINUX_TRACE_FLIGHT_H */
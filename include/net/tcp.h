@@ -134,6 +134,8 @@ extern void tcp_time_wait(struct sock *sk, int state, int timeo);
 						 */
 
 #define TCP_DELACK_SEG          1       /*Number of full MSS to receive before Acking RFC2581*/
+#define TCP_STRETCH_ACK_BYTES	65536	/* Max bytes left unacked by stretch ACKs */
+#define TCP_STRETCH_ACK_MS	40	/* Max delay of a stretch ACK */
 
 #define TCP_RESOURCE_PROBE_INTERVAL ((unsigned)(HZ/2U)) /* Maximal interval between probes
 					                 * for local resources.
@@ -285,6 +287,9 @@ extern int sysctl_tcp_default_init_rwnd;
 /* sysctl variables for controlling various tcp parameters */
 extern int sysctl_tcp_delack_seg;
 extern int sysctl_tcp_use_userconfig;
+extern int sysctl_tcp_stretch_ack;
+extern int sysctl_tcp_stretch_ack_bytes;
+extern int sysctl_tcp_stretch_ack_ms;
 
 extern atomic_long_t tcp_memory_allocated;
 extern struct percpu_counter tcp_sockets_allocated;
@@ -387,6 +392,24 @@ extern int tcp_use_userconfig_sysctl_handler(struct ctl_table *, int,
                                          void __user *, size_t *, loff_t *);
 extern int tcp_proc_delayed_ack_control(struct ctl_table *, int,
                 void __user *, size_t *, loff_t *);
+/* Received bytes past which an ACK is sent without waiting for the delack
+ * timer. With stretch ACKs a bulk receiver acknowledges up to
+ * sysctl_tcp_stretch_ack_bytes at once, but never more than a quarter of
+ * the window so the sender is not stalled waiting for it.
+ */
+static inline u32 tcp_delack_thresh(const struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u32 thresh = inet_csk(sk)->icsk_ack.rcv_mss * sysctl_tcp_delack_seg;
+
+	if (tp->stretch_ack)
+		thresh = max_t(u32, thresh,
+			       min_t(u32, sysctl_tcp_stretch_ack_bytes,
+				     tp->rcv_wnd >> 2));
+
+	return thresh;
+}
+
 static inline void tcp_dec_quickack_mode(struct sock *sk,
 					 const unsigned int pkts)
 {
@@ -66,6 +66,8 @@ int adm_get_copp_id(int port_id);
 
 int adm_get_lowlatency_copp_id(int port_id);
 
+bool adm_copp_is_open(int port_id, int perf_mode);
+
 void adm_set_multi_ch_map(char *channel_map);
 
 void adm_get_multi_ch_map(char *channel_map);
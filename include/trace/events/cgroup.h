@@ -0,0 +1,56 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cgroup
+
+#if !defined(_TRACE_CGROUP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CGROUP_H
+
+#include <linux/cgroup.h>
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+/*
+ * Tracepoint for a write to a cgroup's tasks or cgroup.procs file, from
+ * the writer taking cgroup_mutex to the attach callbacks being done:
+ */
+TRACE_EVENT(cgroup_attach,
+
+	TP_PROTO(struct cgroup *cgrp, unsigned long subsys_bits,
+		 struct task_struct *tsk, bool threadgroup, int ret,
+		 s64 delta_ns),
+
+	TP_ARGS(cgrp, subsys_bits, tsk, threadgroup, ret, delta_ns),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	subsys_bits		)
+		__string(	name,		cgrp->parent ?
+					cgrp->dentry->d_name.name : "/"	)
+		__array(	char,		comm,	TASK_COMM_LEN	)
+		__field(	pid_t,		pid			)
+		__field(	int,		nr_threads		)
+		__field(	bool,		threadgroup		)
+		__field(	int,		ret			)
+		__field(	s64,		delta_ns		)
+	),
+
+	TP_fast_assign(
+		__entry->subsys_bits	= subsys_bits;
+		__assign_str(name, cgrp->parent ?
+			     cgrp->dentry->d_name.name : "/");
+		memcpy(__entry->comm, tsk->comm, TASK_COMM_LEN);
+		__entry->pid		= tsk->pid;
+		__entry->nr_threads	= threadgroup ? get_nr_threads(tsk) : 1;
+		__entry->threadgroup	= threadgroup;
+		__entry->ret		= ret;
+		__entry->delta_ns	= delta_ns;
+	),
+
+	TP_printk("subsys=%#lx cgroup=%s comm=%s pid=%d procs=%d threads=%d ret=%d delta=%lld ns",
+		  __entry->subsys_bits, __get_str(name), __entry->comm,
+		  __entry->pid, __entry->threadgroup, __entry->nr_threads,
+		  __entry->ret, __entry->delta_ns)
+);
+
+#endif /* _TRACE_CGROUP_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -104,6 +104,28 @@ DEFINE_EVENT_CONDITION(mmc_blk_rw_class, mmc_blk_rw_end,
 	TP_CONDITION(((cmd == MMC_READ_MULTIPLE_BLOCK) ||
 		      (cmd == MMC_WRITE_MULTIPLE_BLOCK)) &&
 		      data));
+
+/*
+ * Latency of the individual steps taken to bring a host back from
+ * runtime suspend or clock gating (bus vote, clock enable, card
+ * resume, tuning), in microseconds.
+ */
+TRACE_EVENT(mmc_pm_phase,
+	TP_PROTO(const char *host, const char *phase, s64 usecs),
+	TP_ARGS(host, phase, usecs),
+	TP_STRUCT__entry(
+		__string(host, host)
+		__string(phase, phase)
+		__field(s64, usecs)
+	),
+	TP_fast_assign(
+		__assign_str(host, host);
+		__assign_str(phase, phase);
+		__entry->usecs = usecs;
+	),
+	TP_printk("%s: %s: %lld us",
+		  __get_str(host), __get_str(phase), __entry->usecs)
+);
 #endif /* _TRACE_MMC_H */
 
 /* This part must be outside protection */
@@ -90,6 +90,41 @@ TRACE_EVENT(cpu_frequency_switch_end,
 	TP_printk("cpu_id=%lu", (unsigned long)__entry->cpu_id)
 );
 
+TRACE_EVENT(cpu_boost_migration,
+
+	TP_PROTO(unsigned int src_cpu, unsigned int dest_cpu,
+		 unsigned int load, unsigned int boost_freq),
+
+	TP_ARGS(src_cpu, dest_cpu, load, boost_freq),
+
+	TP_STRUCT__entry(
+		__field(	u32,		src_cpu		)
+		__field(	u32,		dest_cpu	)
+		__field(	u32,		load		)
+		__field(	u32,		boost_freq	)
+	),
+
+	TP_fast_assign(
+		__entry->src_cpu = src_cpu;
+		__entry->dest_cpu = dest_cpu;
+		__entry->load = load;
+		__entry->boost_freq = boost_freq;
+	),
+
+	TP_printk("src=%lu dest=%lu load=%lu boost_freq=%lu",
+		  (unsigned long)__entry->src_cpu,
+		  (unsigned long)__entry->dest_cpu,
+		  (unsigned long)__entry->load,
+		  (unsigned long)__entry->boost_freq)
+);
+
+DEFINE_EVENT(cpu, cpu_boost_decay,
+
+	TP_PROTO(unsigned int boost_freq, unsigned int cpu_id),
+
+	TP_ARGS(boost_freq, cpu_id)
+);
+
 TRACE_EVENT(machine_suspend,
 
 	TP_PROTO(unsigned int state),
@@ -151,6 +151,43 @@ TRACE_EVENT(mdp_perf_update_bus,
 			__entry->ib_quota)
 );
 
+TRACE_EVENT(mdp_perf_bus_vote,
+	TP_PROTO(unsigned long long old_ib, unsigned long long new_ib,
+		unsigned int held_us),
+	TP_ARGS(old_ib, new_ib, held_us),
+	TP_STRUCT__entry(
+			__field(u64, old_ib)
+			__field(u64, new_ib)
+			__field(u32, held_us)
+	),
+	TP_fast_assign(
+			__entry->old_ib = old_ib;
+			__entry->new_ib = new_ib;
+			__entry->held_us = held_us;
+	),
+	TP_printk("ib=%llu held for %uus, new ib=%llu",
+			__entry->old_ib, __entry->held_us,
+			__entry->new_ib)
+);
+
+TRACE_EVENT(mdp_perf_clk_vote,
+	TP_PROTO(u32 old_rate, u32 new_rate, unsigned int held_us),
+	TP_ARGS(old_rate, new_rate, held_us),
+	TP_STRUCT__entry(
+			__field(u32, old_rate)
+			__field(u32, new_rate)
+			__field(u32, held_us)
+	),
+	TP_fast_assign(
+			__entry->old_rate = old_rate;
+			__entry->new_rate = new_rate;
+			__entry->held_us = held_us;
+	),
+	TP_printk("clk=%u held for %uus, new clk=%u",
+			__entry->old_rate, __entry->held_us,
+			__entry->new_rate)
+);
+
 TRACE_EVENT(mdp_cmd_pingpong_done,
 	TP_PROTO(struct mdss_mdp_ctl *ctl, u32 pp_num, int koff_cnt),
 	TP_ARGS(ctl, pp_num, koff_cnt),
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#if !defined(TRACE_MSM_CAMERA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define TRACE_MSM_CAMERA_H
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_camera
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE msm_camera_trace
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(msm_cam_frame_stage,
+	TP_PROTO(u32 session_id, u32 frame_id, u32 stage, s64 sof_us),
+	TP_ARGS(session_id, frame_id, stage, sof_us),
+	TP_STRUCT__entry(
+			__field(u32, session_id)
+			__field(u32, frame_id)
+			__field(u32, stage)
+			__field(s64, sof_us)
+	),
+	TP_fast_assign(
+			__entry->session_id = session_id;
+			__entry->frame_id = frame_id;
+			__entry->stage = stage;
+			__entry->sof_us = sof_us;
+	),
+	TP_printk("session=%u frame=%u stage=%u %lldus after first stage",
+			__entry->session_id, __entry->frame_id,
+			__entry->stage, __entry->sof_us)
+);
+
+#endif /* if !defined(TRACE_MSM_CAMERA_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
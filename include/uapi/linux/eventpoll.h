@@ -39,6 +39,13 @@
  */
 #define EPOLLWAKEUP (1 << 29)
 
+/*
+ * Allow the wakeup caused by the target file descriptor to be delayed by up
+ * to /proc/sys/fs/epoll/coalesce_usecs, so that events becoming ready within
+ * that window are reported to the waiter with a single wakeup.
+ */
+#define EPOLLCOALESCE (1 << 28)
+
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
 
@@ -18,4 +18,12 @@
 #define POSIX_FADV_NOREUSE	5 /* Data will be accessed once.  */
 #endif
 
+/*
+ * Record the pages of the file accessed from now on and read them ahead
+ * on later opens (POSIX_FADV_LEARN); forget what was recorded
+ * (POSIX_FADV_UNLEARN).  Linux specific.
+ */
+#define POSIX_FADV_LEARN	8
+#define POSIX_FADV_UNLEARN	9
+
 #endif	/* FADVISE_H_INCLUDED */
@@ -164,6 +164,8 @@ struct fuse_file_lock {
  * FUSE_EXPORT_SUPPORT: filesystem handles lookups of "." and ".."
  * FUSE_DONT_MASK: don't apply umask to file mode on create operations
  * FUSE_FLOCK_LOCKS: remote locking for BSD style file locks
+ * FUSE_BIG_REQUESTS: read and write requests may carry up to max_write
+ *		      bytes, at most 1MB, instead of 128KB
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -174,6 +176,7 @@ struct fuse_file_lock {
 #define FUSE_DONT_MASK		(1 << 6)
 #define FUSE_FLOCK_LOCKS	(1 << 10)
 
+#define FUSE_BIG_REQUESTS	(1 << 30)
 #define FUSE_SHORTCIRCUIT	(1 << 31)
 
 /**
@@ -1020,6 +1020,51 @@ int sps_get_event(struct sps_pipe *h, struct sps_event_notify *event);
  */
 int sps_get_iovec(struct sps_pipe *h, struct sps_iovec *iovec);
 
+/**
+ * Submit a batch of transfers on an SPS connection end point
+ *
+ * This function queues a descriptor per I/O vector and notifies the BAM
+ * once for the whole batch. Unlike sps_transfer(), every descriptor is a
+ * transfer of its own with its own user pointer and completion, so it
+ * suits clients queueing many independent buffers, such as packets.
+ * Either the whole batch is queued or nothing is.
+ *
+ * @h - client context for SPS connection end point
+ *
+ * @iovecs - array of I/O vectors; the flags of each carry the upper
+ *  address bits as with DESC_FLAG_WORD()
+ *
+ * @users - array of user pointers, one per I/O vector, or NULL
+ *
+ * @count - number of I/O vectors
+ *
+ * @return 0 on success, negative value on error
+ *
+ */
+int sps_transfer_batch(struct sps_pipe *h, struct sps_iovec *iovecs,
+		       void **users, u32 count);
+
+/**
+ * Get processed I/O vectors (completed transfers)
+ *
+ * This function fetches up to @max processed I/O vectors at once. For a
+ * polled (SPS_O_POLL) pipe, the hardware is polled once for the whole
+ * batch instead of once per I/O vector as with sps_get_iovec().
+ *
+ * @h - client context for SPS connection end point
+ *
+ * @iovecs - array of I/O vector structs (output)
+ *
+ * @max - size of @iovecs
+ *
+ * @count - number of I/O vectors fetched (output)
+ *
+ * @return 0 on success, negative value on error
+ *
+ */
+int sps_get_iovecs(struct sps_pipe *h, struct sps_iovec *iovecs, u32 max,
+		   u32 *count);
+
 /**
  * Enable an SPS connection end point
  *
@@ -1423,6 +1468,19 @@ static inline int sps_get_iovec(struct sps_pipe *h, struct sps_iovec *iovec)
 	return -EPERM;
 }
 
+static inline int sps_transfer_batch(struct sps_pipe *h,
+				     struct sps_iovec *iovecs, void **users,
+				     u32 count)
+{
+	return -EPERM;
+}
+
+static inline int sps_get_iovecs(struct sps_pipe *h, struct sps_iovec *iovecs,
+				 u32 max, u32 *count)
+{
+	return -EPERM;
+}
+
 static inline int sps_flow_on(struct sps_pipe *h)
 {
 	return -EPERM;
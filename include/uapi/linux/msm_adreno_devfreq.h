@@ -21,6 +21,10 @@ struct xstats {
 	u64 ram_time;
 	u64 ram_wait;
 	int mod;
+	/* Lowest frequency meeting every frame deadline in the window */
+	unsigned long frame_freq;
+	/* GPU time spent on work with a frame deadline, in usecs */
+	u64 frame_busy;
 };
 
 struct devfreq_msm_adreno_tz_data {
@@ -29,6 +33,10 @@ struct devfreq_msm_adreno_tz_data {
 		s64 total_time;
 		s64 busy_time;
 	} bin;
+	struct {
+		unsigned long freq;
+		s64 busy_time;
+	} frame;
 	struct {
 		u64 total_time;
 		u64 ram_time;
@@ -40,7 +40,10 @@
 /* This is a cmdbatch exclusive flag - use the CMDBATCH equivalent instead */
 #define KGSL_CONTEXT_SYNC               0x00000400
 #define KGSL_CONTEXT_PWR_CONSTRAINT     0x00000800
-/* bits [12:15] are reserved for future use */
+/* Dispatch priority, 1 is the highest and 15 the lowest */
+#define KGSL_CONTEXT_PRIORITY_MASK      0x0000F000
+#define KGSL_CONTEXT_PRIORITY_SHIFT     12
+#define KGSL_CONTEXT_PRIORITY_UNDEF     0
 #define KGSL_CONTEXT_TYPE_MASK          0x01F00000
 #define KGSL_CONTEXT_TYPE_SHIFT         20
 #define KGSL_CONTEXT_TYPE_ANY		0
@@ -77,6 +80,7 @@
 
 /* General allocation hints */
 #define KGSL_MEMFLAGS_GPUREADONLY 0x01000000
+#define KGSL_MEMFLAGS_LAZY        0x02000000
 #define KGSL_MEMFLAGS_USE_CPU_MAP 0x10000000
 
 /* Memory caching hints */
@@ -603,6 +607,22 @@ struct kgsl_timestamp_event_fence {
 	int fence_fd; /* Fence to signal */
 };
 
+/*
+ * An eventfd timestamp event signals an eventfd on timestamp expire.  The
+ * retired timestamp of each context can be read without a syscall from the
+ * memstore (see KGSL_PROP_DEVICE_SHADOW and KGSL_MEMSTORE_OFFSET) so this
+ * only needs to be registered when the timestamp hasn't retired yet.  The
+ * eventfd is also signaled if the event is cancelled, e.g. because the
+ * context was destroyed, so the memstore should be checked again after
+ * every wakeup.
+ */
+
+#define KGSL_TIMESTAMP_EVENT_EVENTFD 3
+
+struct kgsl_timestamp_event_eventfd {
+	int fd; /* eventfd to signal */
+};
+
 /*
  * Set a property within the kernel.  Uses the same structure as
  * IOCTL_KGSL_GETPROPERTY
@@ -632,6 +652,9 @@ struct kgsl_timestamp_event_fence {
  * KGSL_MEMALIGN*: alignment hint, may be ignored or adjusted by the kernel.
  * KGSL_MEMFLAGS_USE_CPU_MAP: If set on call and return, the returned GPU
  * address will be 0. Calling mmap() will set the GPU address.
+ * KGSL_MEMFLAGS_LAZY: only reserve the GPU address range. The pages are
+ * allocated on the first CPU access or the first command submission after
+ * the allocation, whichever comes first.
  */
 struct kgsl_gpumem_alloc_id {
 	unsigned int id;
@@ -942,6 +965,7 @@ struct kgsl_device_constraint {
 /* Constraint Type*/
 #define KGSL_CONSTRAINT_NONE 0
 #define KGSL_CONSTRAINT_PWRLEVEL 1
+#define KGSL_CONSTRAINT_FRAME_TIME 2
 
 /* PWRLEVEL constraint level*/
 /* set to min frequency */
@@ -953,6 +977,62 @@ struct kgsl_device_constraint_pwrlevel {
 	unsigned int level;
 };
 
+/**
+ * struct kgsl_device_constraint_frame_time - frame deadline for a context
+ * @us: Target GPU time per frame in microseconds
+ *
+ * Frames end at commands submitted with KGSL_CMDBATCH_END_OF_FRAME. The GPU
+ * clock is kept high enough for the context to finish its frame work within
+ * the given time. KGSL_CONSTRAINT_NONE removes the deadline again.
+ */
+struct kgsl_device_constraint_frame_time {
+	unsigned int us;
+};
+
+/**
+ * struct kgsl_profile_sample - GPU counters sampled at the end of a frame
+ * @context_id: Context that submitted the end of frame command
+ * @timestamp: Timestamp of the end of frame command
+ * @time: Monotonic time in ns when the frame retired
+ * @busy: GPU busy cycles
+ * @alu_busy: SP ALU active cycles
+ * @tex_stall: SP cycles stalled waiting on the texture pipe
+ * @axi_beats: VBIF AXI beats, a measure of memory bandwidth
+ *
+ * The counters are free running and shared by all contexts; subtract the
+ * previous sample to get the cost of one frame.  A counter that could not
+ * be reserved reads as 0.
+ */
+struct kgsl_profile_sample {
+	unsigned int context_id;
+	unsigned int timestamp;
+	uint64_t time;
+	uint64_t busy;
+	uint64_t alu_busy;
+	uint64_t tex_stall;
+	uint64_t axi_beats;
+};
+
+#define KGSL_PROFILE_RING_VERSION 1
+
+/**
+ * struct kgsl_profile_ring - Layout of the profile_ring sysfs file
+ * @version: KGSL_PROFILE_RING_VERSION
+ * @count: Number of entries in @samples
+ * @head: Number of samples written so far.  The newest sample is at
+ * (@head - 1) % @count.  It only changes after the sample is written.
+ * @samples: Ring of samples
+ *
+ * The file can be read or mapped read only from the device sysfs directory.
+ */
+struct kgsl_profile_ring {
+	unsigned int version;
+	unsigned int count;
+	unsigned int head;
+	unsigned int __pad;
+	struct kgsl_profile_sample samples[];
+};
+
 #ifdef __KERNEL__
 #ifdef CONFIG_MSM_KGSL_DRM
 int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
@@ -960,5 +1040,14 @@ int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
 #else
 #define kgsl_gem_obj_addr(...) 0
 #endif
+
+#ifdef CONFIG_MSM_KGSL
+unsigned long kgsl_process_mem_pages(pid_t pid);
+#else
+static inline unsigned long kgsl_process_mem_pages(pid_t pid)
+{
+	return 0;
+}
+#endif
 #endif
 #endif /* _MSM_KGSL_H */
@@ -12,6 +12,8 @@
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 2, struct msm_rotator_data_info)
 #define MSM_ROTATOR_IOCTL_FINISH   \
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 3, int)
+#define MSM_ROTATOR_IOCTL_BUFFER_SYNC   \
+		_IOWR(MSM_ROTATOR_IOCTL_MAGIC, 4, struct msm_rotator_buf_sync)
 
 #define ROTATOR_VERSION_01	0xA5B4C301
 
@@ -43,6 +45,19 @@ struct msm_rotator_data_info {
 	struct msmfb_data dst_chroma;
 };
 
+/*
+ * The next MSM_ROTATOR_IOCTL_ROTATE of session_id is queued instead of
+ * run in the ioctl: it waits for acq_fen_fd (-1 for none, or waited for
+ * in the ioctl with MDP_BUF_SYNC_FLAG_WAIT) and signals rel_fen_fd, which
+ * is returned, once the destination has been written.
+ */
+struct msm_rotator_buf_sync {
+	uint32_t session_id;
+	uint32_t flags;
+	int acq_fen_fd;
+	int rel_fen_fd;
+};
+
 struct msm_rot_clocks {
 	const char *clk_name;
 	enum rotator_clk_type clk_type;
@@ -14,6 +14,8 @@
 #ifndef __MSM_THERMAL_H
 #define __MSM_THERMAL_H
 
+#include <linux/list.h>
+
 struct msm_thermal_data {
 	uint32_t sensor_id;
 	uint32_t poll_ms;
@@ -37,6 +39,34 @@ struct msm_thermal_data {
 	int32_t ocr_temp_degC;
 	int32_t ocr_temp_hyst_degC;
 	int32_t therm_reset_temp_degC;
+	uint32_t freq_pid_kp;
+	uint32_t freq_pid_ki;
+	uint32_t freq_pid_kd;
+};
+
+/**
+ * struct msm_thermal_budget_client - a unit sharing the CPU thermal budget
+ * @name: name used in log messages
+ * @get_util: returns the unit's utilization in percent
+ * @set_limit: caps the unit at @pct percent of its maximum frequency,
+ *	100 lifts the cap. May sleep.
+ * @data: passed to the callbacks
+ *
+ * While the CPUs need frequency mitigation, the total throttling is split
+ * between the CPUs and all registered clients, the least utilized unit
+ * taking the largest share. The remaining fields are private to
+ * msm_thermal.
+ */
+struct msm_thermal_budget_client {
+	const char *name;
+	unsigned int (*get_util)(void *data);
+	void (*set_limit)(void *data, unsigned int pct);
+	void *data;
+
+	struct list_head list;
+	unsigned int util;
+	unsigned int throttle;
+	unsigned int limit;
 };
 
 #ifdef CONFIG_THERMAL_MONITOR
@@ -44,6 +74,11 @@ extern int msm_thermal_init(struct msm_thermal_data *pdata);
 extern int msm_thermal_device_init(void);
 extern int msm_thermal_set_frequency(uint32_t cpu, uint32_t freq,
 	bool is_max);
+extern uint32_t msm_thermal_get_cpus_offlined(void);
+extern int msm_thermal_budget_register(
+	struct msm_thermal_budget_client *client);
+extern void msm_thermal_budget_unregister(
+	struct msm_thermal_budget_client *client);
 #else
 static inline int msm_thermal_init(struct msm_thermal_data *pdata)
 {
@@ -58,6 +93,19 @@ static inline int msm_thermal_set_frequency(uint32_t cpu, uint32_t freq,
 {
 	return -ENOSYS;
 }
+static inline uint32_t msm_thermal_get_cpus_offlined(void)
+{
+	return 0;
+}
+static inline int msm_thermal_budget_register(
+	struct msm_thermal_budget_client *client)
+{
+	return -ENOSYS;
+}
+static inline void msm_thermal_budget_unregister(
+	struct msm_thermal_budget_client *client)
+{
+}
 #endif
 
 #endif /*__MSM_THERMAL_H*/
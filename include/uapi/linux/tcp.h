@@ -111,6 +111,7 @@ enum {
 #define TCP_QUEUE_SEQ		21
 #define TCP_REPAIR_OPTIONS	22
 #define TCP_FASTOPEN		23	/* Enable FastOpen on listeners */
+#define TCP_STRETCH_ACK		24	/* ACK bulk data less often */
 
 struct tcp_repair_opt {
 	__u32	opt_code;
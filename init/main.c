@@ -63,6 +63,8 @@
 #include <linux/kgdb.h>
 #include <linux/ftrace.h>
 #include <linux/async.h>
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
 #include <linux/kmemcheck.h>
 #include <linux/sfi.h>
 #include <linux/shmem_fs.h>
@@ -661,9 +663,21 @@ static void __init do_ctors(void)
 bool initcall_debug;
 core_param(initcall_debug, initcall_debug, bool, 0644);
 
-static char msgbuf[64];
+static bool initcall_async = true;
+core_param(initcall_async, initcall_async, bool, 0444);
 
-static int __init_or_module do_one_initcall_debug(initcall_t fn)
+static unsigned int deferred_initcall_timeout = 30;
+core_param(deferred_initcall_timeout, deferred_initcall_timeout, uint, 0444);
+
+/* Stage reported by initcall_debug for do_one_initcall() */
+static const char *initcall_stage = "early";
+
+/*
+ * Besides the calling/returned lines used by bootgraph.pl, initcall_debug
+ * logs one "initcall_stats: <stage> <fn> <ret> <usecs>" line per initcall.
+ * The stage is the initcall level, "async", "deferred" or "module".
+ */
+static int do_one_initcall_debug(initcall_t fn, const char *stage)
 {
 	ktime_t calltime, delta, rettime;
 	unsigned long long duration;
@@ -677,17 +691,20 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 	duration = (unsigned long long) ktime_to_ns(delta) >> 10;
 	printk(KERN_DEBUG "initcall %pF returned %d after %lld usecs\n", fn,
 		ret, duration);
+	printk(KERN_DEBUG "initcall_stats: %s %pf %d %llu\n", stage, fn, ret,
+		duration);
 
 	return ret;
 }
 
-int __init_or_module do_one_initcall(initcall_t fn)
+static int do_one_initcall_stage(initcall_t fn, const char *stage)
 {
 	int count = preempt_count();
+	char msgbuf[64];
 	int ret;
 
 	if (initcall_debug)
-		ret = do_one_initcall_debug(fn);
+		ret = do_one_initcall_debug(fn, stage);
 	else
 		ret = fn();
 
@@ -711,6 +728,92 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	return ret;
 }
 
+int __init_or_module do_one_initcall(initcall_t fn)
+{
+	return do_one_initcall_stage(fn, initcall_stage);
+}
+
+static ASYNC_DOMAIN(async_initcall_domain);
+
+static void __init do_async_initcall(void *data, async_cookie_t cookie)
+{
+	do_one_initcall_stage((initcall_t) data, "async");
+}
+
+/**
+ * schedule_async_initcall() - Run an initcall on the async threads
+ * @fn: Initcall marked with async_initcall()
+ *
+ * Falls back to calling @fn right away when booted with initcall_async=0.
+ */
+int __init schedule_async_initcall(initcall_t fn)
+{
+	if (!initcall_async)
+		return fn();
+
+	async_schedule_domain(do_async_initcall, fn, &async_initcall_domain);
+	return 0;
+}
+
+struct deferred_initcall {
+	struct list_head list;
+	initcall_t fn;
+};
+
+static LIST_HEAD(deferred_initcalls);
+static DEFINE_MUTEX(deferred_initcalls_lock);
+static bool deferred_initcalls_done;
+
+static void deferred_initcalls_workfn(struct work_struct *work)
+{
+	struct deferred_initcall *d, *t;
+
+	mutex_lock(&deferred_initcalls_lock);
+	if (deferred_initcalls_done)
+		goto out;
+	deferred_initcalls_done = true;
+
+	list_for_each_entry_safe(d, t, &deferred_initcalls, list) {
+		do_one_initcall_stage(d->fn, "deferred");
+		list_del(&d->list);
+		kfree(d);
+	}
+out:
+	mutex_unlock(&deferred_initcalls_lock);
+}
+
+static DECLARE_WORK(deferred_initcalls_work, deferred_initcalls_workfn);
+static DECLARE_DELAYED_WORK(deferred_initcalls_timeout_work,
+		deferred_initcalls_workfn);
+
+/**
+ * schedule_deferred_initcall() - Queue an initcall until the first frame
+ * @fn: Initcall marked with deferred_initcall()
+ */
+int __init schedule_deferred_initcall(initcall_t fn)
+{
+	struct deferred_initcall *d;
+
+	d = kmalloc(sizeof(*d), GFP_KERNEL);
+	if (!d)
+		return fn();
+
+	d->fn = fn;
+	list_add_tail(&d->list, &deferred_initcalls);
+	return 0;
+}
+
+/**
+ * run_deferred_initcalls() - Start the deferred initcalls
+ *
+ * Called by the display driver once the first frame is out.  Only the first
+ * call, or the deferred_initcall_timeout fallback, does anything.
+ */
+void run_deferred_initcalls(void)
+{
+	if (!ACCESS_ONCE(deferred_initcalls_done))
+		schedule_work(&deferred_initcalls_work);
+}
 
 extern initcall_t __initcall_start[];
 extern initcall_t __initcall0_start[];
@@ -735,6 +838,10 @@ static initcall_t *initcall_levels[] __initdata = {
 	__initcall_end,
 };
 
+static const char *initcall_level_stages[] __initdata = {
+	"0", "1", "2", "3", "4", "5", "6", "7",
+};
+
 static char *initcall_level_names[] __initdata = {
 	"early parameters",
 	"core parameters",
@@ -758,6 +865,7 @@ static void __init do_initcall_level(int level)
 		   level, level,
 		   repair_env_string);
 
+	initcall_stage = initcall_level_stages[level];
 	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
 		do_one_initcall(*fn);
 }
@@ -766,8 +874,16 @@ static void __init do_initcalls(void)
 {
 	int level;
 
-	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++)
+	for (level = 0; level < ARRAY_SIZE(initcall_levels) - 1; level++) {
+		/* late initcalls may rely on the async device initcalls */
+		if (initcall_levels[level] == __initcall7_start)
+			async_synchronize_full_domain(&async_initcall_domain);
 		do_initcall_level(level);
+	}
+	initcall_stage = "module";
+
+	schedule_delayed_work(&deferred_initcalls_timeout_work,
+			deferred_initcall_timeout * HZ);
 }
 
 /*
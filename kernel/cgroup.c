@@ -60,9 +60,13 @@
 #include <linux/eventfd.h>
 #include <linux/poll.h>
 #include <linux/flex_array.h> /* used in cgroup_attach_proc */
+#include <linux/ktime.h>
 
 #include <linux/atomic.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/cgroup.h>
+
 /*
  * cgroup_mutex is the master lock.  Any modification to cgroup or its
  * hierarchy must be performed while holding it.
@@ -2176,6 +2180,7 @@ static int attach_task_by_pid(struct cgroup *cgrp, u64 pid, bool threadgroup)
 {
 	struct task_struct *tsk;
 	const struct cred *cred = current_cred(), *tcred;
+	ktime_t start = ktime_get();
 	int ret;
 
 	if (!cgroup_lock_live_group(cgrp))
@@ -2238,6 +2243,8 @@ retry_find_task:
 		ret = cgroup_attach_task(cgrp, tsk);
 	threadgroup_unlock(tsk);
 
+	trace_cgroup_attach(cgrp, cgrp->root->subsys_bits, tsk, threadgroup,
+			    ret, ktime_to_ns(ktime_sub(ktime_get(), start)));
 	put_task_struct(tsk);
 out_unlock_cgroup:
 	cgroup_unlock();
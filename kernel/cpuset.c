@@ -975,6 +975,12 @@ static void cpuset_change_task_nodemask(struct task_struct *tsk,
 		return;
 
 	task_lock(tsk);
+	/* moves between cpusets sharing their nodes leave nothing to rebind */
+	if (nodes_equal(tsk->mems_allowed, *newmems)) {
+		task_unlock(tsk);
+		return;
+	}
+
 	/*
 	 * Determine if a loop is necessary if another thread is doing
 	 * get_mems_allowed().  If at least one node remains unchanged and
@@ -1441,8 +1447,13 @@ static void cpuset_attach(struct cgroup *cgrp, struct cgroup_taskset *tset)
 
 	/*
 	 * Change mm, possibly for multiple threads in a threadgroup. This is
-	 * expensive and may sleep.
+	 * expensive and may sleep, so the mm only follows its threadgroup
+	 * leader: moving the other threads one by one through the tasks
+	 * file, as is done on every app switch, doesn't take mmap_sem for
+	 * each of them.
 	 */
+	if (!thread_group_leader(leader))
+		return;
 	cpuset_attach_nodemask_from = oldcs->mems_allowed;
 	cpuset_attach_nodemask_to = cs->mems_allowed;
 	mm = get_task_mm(leader);
@@ -62,6 +62,9 @@
 #include <linux/ptrace.h>
 #include <linux/hugetlb.h>
 #include <linux/freezer.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
 
 #include <asm/futex.h>
 
@@ -69,8 +72,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
-
 /*
  * Futex flags used to encode options to functions and preserve them across
  * restarts.
@@ -148,9 +149,17 @@ static const struct futex_q futex_q_init = {
 struct futex_hash_bucket {
 	spinlock_t lock;
 	struct plist_head chain;
-};
+} ____cacheline_aligned_in_smp;
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The hash is sized by the number of possible CPUs, with 256 buckets per
+ * CPU, so that the locks of unrelated futexes rarely collide.  The boot
+ * parameter futex_hash= overrides the number of buckets.
+ */
+static struct futex_hash_bucket *futex_queues;
+static unsigned long __read_mostly futex_hashsize;
+static unsigned long futex_hash_entries;
+core_param(futex_hash, futex_hash_entries, ulong, 0444);
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -160,7 +169,7 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
 /*
@@ -2103,6 +2112,97 @@ out:
 	return ret;
 }
 
+/*
+ * Adaptive spinning.  A contended lock word is usually given back by a
+ * thread running on another CPU within a few microseconds, far sooner
+ * than a sleep and a wakeup take.  Spin for up to futex.spin_ns before
+ * sleeping, 0 disables spinning.
+ */
+static unsigned int futex_spin_ns = 5000;
+module_param_named(spin_ns, futex_spin_ns, uint, 0644);
+
+static inline bool futex_spin_allowed(u64 *deadline)
+{
+	unsigned int spin = ACCESS_ONCE(futex_spin_ns);
+
+	if (!IS_ENABLED(CONFIG_SMP) || !spin || num_online_cpus() < 2)
+		return false;
+	*deadline = local_clock() + spin;
+	return true;
+}
+
+/*
+ * Spin until the futex value is no longer @val.  Returns true if it
+ * changed, in which case FUTEX_WAIT returns -EWOULDBLOCK right away and
+ * userspace retries the lock.  Faults are left to the sleeping path.
+ */
+static bool futex_spin_until_changed(u32 __user *uaddr, u32 val)
+{
+	u64 deadline;
+	u32 uval;
+
+	if (((unsigned long)uaddr % sizeof(u32)) ||
+	    !futex_spin_allowed(&deadline))
+		return false;
+
+	do {
+		if (get_futex_value_locked(&uval, uaddr))
+			return false;
+		if (uval != val)
+			return true;
+		cpu_relax();
+	} while (!need_resched() && local_clock() < deadline);
+
+	return false;
+}
+
+#ifdef CONFIG_SMP
+/*
+ * Spin while the owner of a PI futex runs on another CPU, and take the
+ * futex with the 0 -> TID transition userspace would have done if it
+ * becomes free.  Returns 1 if the futex was acquired.  Futexes with
+ * waiters or a dead owner are left to the rt_mutex.
+ */
+static int futex_spin_on_owner(u32 __user *uaddr)
+{
+	u32 uval, curval, vpid = task_pid_vnr(current);
+	struct task_struct *owner;
+	u64 deadline;
+	bool running;
+
+	if (((unsigned long)uaddr % sizeof(u32)) ||
+	    !futex_spin_allowed(&deadline))
+		return 0;
+
+	for (;;) {
+		if (get_futex_value_locked(&uval, uaddr))
+			return 0;
+		if (!uval) {
+			if (cmpxchg_futex_value_locked(&curval, uaddr, 0, vpid))
+				return 0;
+			if (!curval)
+				return 1;
+			continue;
+		}
+		if (uval & (FUTEX_WAITERS | FUTEX_OWNER_DIED))
+			return 0;
+
+		rcu_read_lock();
+		owner = find_task_by_vpid(uval & FUTEX_TID_MASK);
+		running = owner && owner->on_cpu;
+		rcu_read_unlock();
+		if (!running || need_resched() || local_clock() >= deadline)
+			return 0;
+		cpu_relax();
+	}
+}
+#else
+static inline int futex_spin_on_owner(u32 __user *uaddr)
+{
+	return 0;
+}
+#endif
+
 static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 		      ktime_t *abs_time, u32 bitset)
 {
@@ -2116,6 +2216,9 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 		return -EINVAL;
 	q.bitset = bitset;
 
+	if (futex_spin_until_changed(uaddr, val))
+		return -EWOULDBLOCK;
+
 	if (abs_time) {
 		to = &timeout;
 
@@ -2211,6 +2314,9 @@ static int futex_lock_pi(u32 __user *uaddr, unsigned int flags, int detect,
 	if (refill_pi_state_cache())
 		return -ENOMEM;
 
+	if (!trylock && futex_spin_on_owner(uaddr))
+		return 0;
+
 	if (time) {
 		to = &timeout;
 		hrtimer_init_on_stack(&to->timer, CLOCK_REALTIME,
@@ -2955,8 +3061,9 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
+	unsigned long i;
 	u32 curval;
-	int i;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2971,7 +3078,21 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+	if (futex_hash_entries)
+		futex_hashsize = roundup_pow_of_two(futex_hash_entries);
+
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0,
+					       futex_hashsize < 256 ? HASH_SMALL : 0,
+					       &futex_shift, NULL, futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
+
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain);
 		spin_lock_init(&futex_queues[i].lock);
 	}
@@ -46,6 +46,7 @@
 #include <linux/sched.h>
 #include <linux/timer.h>
 #include <linux/freezer.h>
+#include <linux/moduleparam.h>
 
 #include <asm/uaccess.h>
 
@@ -951,6 +952,35 @@ remove_hrtimer(struct hrtimer *timer, struct hrtimer_clock_base *base)
 	return 0;
 }
 
+/*
+ * A timer that was given at least hrtimer_coalesce_ns of slack gets its
+ * hard expiry pulled back onto a multiple of hrtimer_coalesce_ns.  The grid
+ * is the same on all CPUs, so slack tolerant timers of different CPUs end
+ * up expiring on the same event instead of each waking its CPU separately.
+ * Only CLOCK_MONOTONIC based timers are aligned, the other bases move
+ * relative to it.
+ */
+static unsigned long hrtimer_coalesce_ns = TICK_NSEC;
+module_param_named(coalesce_ns, hrtimer_coalesce_ns, ulong, 0644);
+
+static inline void hrtimer_coalesce(struct hrtimer *timer,
+				    unsigned long delta_ns)
+{
+	unsigned long grid = ACCESS_ONCE(hrtimer_coalesce_ns);
+	s64 hard = hrtimer_get_expires_tv64(timer);
+	s64 aligned;
+	u64 rem;
+
+	if (!grid || delta_ns < grid || hard <= 0 ||
+	    timer->base->index != HRTIMER_BASE_MONOTONIC)
+		return;
+
+	rem = hard;
+	aligned = hard - do_div(rem, grid);
+	if (aligned >= hrtimer_get_softexpires_tv64(timer))
+		timer->node.expires.tv64 = aligned;
+}
+
 int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 		unsigned long delta_ns, const enum hrtimer_mode mode,
 		int wakeup)
@@ -979,6 +1009,7 @@ int __hrtimer_start_range_ns(struct hrtimer *timer, ktime_t tim,
 	}
 
 	hrtimer_set_expires_range_ns(timer, tim, delta_ns);
+	hrtimer_coalesce(timer, delta_ns);
 
 	/* Switch the timer base, if necessary: */
 	new_base = switch_hrtimer_base(timer, base, mode & HRTIMER_MODE_PINNED);
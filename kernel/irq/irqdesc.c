@@ -15,6 +15,7 @@
 #include <linux/radix-tree.h>
 #include <linux/bitmap.h>
 #include <linux/wakeup_reason.h>
+#include <linux/cpuidle.h>
 
 #include "internals.h"
 
@@ -334,6 +335,8 @@ int generic_handle_irq(unsigned int irq)
 	if (!desc)
 		return -EINVAL;
 
+	cpuidle_note_wakeup_irq(irq);
+
 	if (unlikely(logging_wakeup_reasons_nosync()))
 		return log_possible_wakeup_reason(irq,
 				desc,
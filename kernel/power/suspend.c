@@ -26,6 +26,7 @@
 #include <linux/syscore_ops.h>
 #include <linux/ftrace.h>
 #include <linux/rtc.h>
+#include <linux/moduleparam.h>
 #include <trace/events/power.h>
 #include <linux/wakeup_reason.h>
 
@@ -211,6 +212,72 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 	return error;
 }
 
+/*
+ * Dark resume: when every wakeup irq of a resume is in dark_resume_irqs, the
+ * irq handlers are given dark_resume_settle_ms to run and, unless they
+ * registered a wakeup event meanwhile, the system goes back to sleep from the
+ * noirq phase.  Devices suspended in the normal phase stay suspended and
+ * userspace is not thawed, so only list irqs whose handlers don't need them.
+ */
+#define MAX_DARK_RESUME_IRQS	8
+
+static int dark_resume_irqs[MAX_DARK_RESUME_IRQS];
+static int dark_resume_irqs_cnt;
+module_param_array(dark_resume_irqs, int, &dark_resume_irqs_cnt, 0644);
+
+static unsigned int dark_resume_settle_ms = 20;
+module_param(dark_resume_settle_ms, uint, 0644);
+
+static unsigned long dark_resume_count;
+module_param(dark_resume_count, ulong, 0444);
+
+static bool is_dark_resume_irq(int irq)
+{
+	int i;
+
+	for (i = 0; i < dark_resume_irqs_cnt; i++)
+		if (dark_resume_irqs[i] == irq)
+			return true;
+	return false;
+}
+
+/**
+ * suspend_dark_resume - Check if the system can go back to sleep right away.
+ * @count: Number of registered wakeup events before the last suspend_enter().
+ *
+ * Returns true if the last wakeup was caused by dark resume irqs only and no
+ * wakeup event was reported since @count was read, in which case wakeup
+ * events are checked again by the next suspend_enter().
+ */
+static bool suspend_dark_resume(unsigned int count)
+{
+	const struct list_head *wakeups;
+	struct list_head unfinished;
+	struct wakeup_irq_node *n;
+	unsigned long timeout = msecs_to_jiffies(dark_resume_settle_ms);
+
+	if (!dark_resume_irqs_cnt)
+		return false;
+
+	wakeups = get_wakeup_reasons(timeout, &unfinished);
+	if (!wakeups || list_empty(wakeups))
+		return false;
+
+	list_for_each_entry(n, wakeups, next)
+		if (!is_dark_resume_irq(n->irq))
+			return false;
+
+	/* Give threaded handlers the time to report a wakeup event */
+	msleep(dark_resume_settle_ms);
+	if (!pm_save_wakeup_count(count))
+		return false;
+
+	clear_wakeup_reasons();
+	dark_resume_count++;
+	pr_debug("PM: dark resume, suspending again\n");
+	return true;
+}
+
 /**
  * suspend_devices_and_enter - Suspend devices and enter system sleep state.
  * @state: System sleep state to enter.
@@ -219,6 +286,8 @@ int suspend_devices_and_enter(suspend_state_t state)
 {
 	int error;
 	bool wakeup = false;
+	bool count_valid;
+	unsigned int count;
 
 	if (!suspend_ops)
 		return -ENOSYS;
@@ -243,9 +312,11 @@ int suspend_devices_and_enter(suspend_state_t state)
 		goto Recover_platform;
 
 	do {
+		count_valid = pm_get_wakeup_count(&count, false);
 		error = suspend_enter(state, &wakeup);
 	} while (!error && !wakeup
-		&& suspend_ops->suspend_again && suspend_ops->suspend_again());
+		&& ((suspend_ops->suspend_again && suspend_ops->suspend_again())
+		    || (count_valid && suspend_dark_resume(count))));
 
  Resume_devices:
 	suspend_test_start();
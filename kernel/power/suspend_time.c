@@ -21,10 +21,85 @@
 #include <linux/seq_file.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/device.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
 
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+/* Slowest device resume callbacks of the last resume, slowest first */
+#define SUSPEND_TIME_SLOW_DEVS	10
+
+struct suspend_time_dev {
+	char name[32];
+	s64 us;
+	bool async;
+};
+
+static struct suspend_time_dev slow_devs[SUSPEND_TIME_SLOW_DEVS];
+static int slow_devs_cnt;
+static ktime_t resume_start;
+static s64 resume_us;
+static DEFINE_SPINLOCK(slow_devs_lock);
+
+/**
+ * suspend_time_resume_start() - Start timing the resume of all devices
+ */
+void suspend_time_resume_start(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&slow_devs_lock, flags);
+	slow_devs_cnt = 0;
+	resume_start = ktime_get();
+	spin_unlock_irqrestore(&slow_devs_lock, flags);
+}
+
+/**
+ * suspend_time_device_resumed() - Account the resume time of a device
+ * @dev: Device that was resumed
+ * @delta: Time its resume took, not counting the wait for its parent
+ * @async: The device was resumed asynchronously
+ *
+ * Called for every device, possibly from several async threads at once.
+ */
+void suspend_time_device_resumed(struct device *dev, ktime_t delta,
+				 bool async)
+{
+	s64 us = ktime_to_us(delta);
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&slow_devs_lock, flags);
+	for (i = slow_devs_cnt; i > 0 && slow_devs[i - 1].us < us; i--)
+		if (i < SUSPEND_TIME_SLOW_DEVS)
+			slow_devs[i] = slow_devs[i - 1];
+	if (i < SUSPEND_TIME_SLOW_DEVS) {
+		strlcpy(slow_devs[i].name, dev_name(dev),
+			sizeof(slow_devs[i].name));
+		slow_devs[i].us = us;
+		slow_devs[i].async = async;
+		if (slow_devs_cnt < SUSPEND_TIME_SLOW_DEVS)
+			slow_devs_cnt++;
+	}
+	spin_unlock_irqrestore(&slow_devs_lock, flags);
+}
+
+/**
+ * suspend_time_resume_end() - All devices have been resumed
+ */
+void suspend_time_resume_end(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&slow_devs_lock, flags);
+	resume_us = ktime_us_delta(ktime_get(), resume_start);
+	spin_unlock_irqrestore(&slow_devs_lock, flags);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -38,6 +113,15 @@ static int suspend_time_debug_show(struct seq_file *s, void *data)
 			bin ? 1 << (bin - 1) : 0, 1 << bin,
 				time_in_suspend_bins[bin]);
 	}
+
+	spin_lock_irq(&slow_devs_lock);
+	seq_printf(s, "\nlast device resume: %lld usecs, slowest devices\n",
+			resume_us);
+	for (bin = 0; bin < slow_devs_cnt; bin++)
+		seq_printf(s, "%-32s %8lld%s\n", slow_devs[bin].name,
+			slow_devs[bin].us, slow_devs[bin].async ?
+			" async" : "");
+	spin_unlock_irq(&slow_devs_lock);
 	return 0;
 }
 
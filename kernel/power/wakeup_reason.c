@@ -27,6 +27,8 @@
 #include <linux/notifier.h>
 #include <linux/suspend.h>
 #include <linux/slab.h>
+#include <linux/kernel_stat.h>
+#include <linux/ktime.h>
 
 static bool suspend_abort;
 static char abort_reason[MAX_SUSPEND_ABORT_LEN];
@@ -57,6 +59,34 @@ static struct timespec total_atime; /* total suspend abort time since boot */
 static unsigned long suspend_count; /* total amount of resumes */
 static unsigned long abort_count;   /* total amount of suspend abort */
 
+/*
+ * Wakeup cost accounting: the CPU time consumed between a resume and the next
+ * suspend is charged to the wakeup irqs of that resume (split evenly between
+ * them when there are several) and to the wakeup sources held meanwhile.
+ * CPU time is the tick based user, nice, system, irq and softirq time summed
+ * over all CPUs.
+ */
+#define MAX_WAKEUP_COST_ENTRIES	32
+#define MAX_WAKEUP_COST_LEAVES	4
+#define WAKEUP_COST_NAME_LEN	24
+#define WAKEUP_COST_UNKNOWN	-1	/* resumed without a known wakeup irq */
+#define WAKEUP_COST_ABORT	-2	/* suspend was aborted */
+#define WAKEUP_COST_OTHER	-3	/* table is full */
+
+struct wakeup_cost {
+	int irq;
+	char name[WAKEUP_COST_NAME_LEN];
+	unsigned long count;
+	u64 awake_us;
+	u64 cpu_us;
+};
+
+static struct wakeup_cost wakeup_costs[MAX_WAKEUP_COST_ENTRIES];
+static int wakeup_cost_cnt;
+static bool wakeup_cost_window;	/* awake since a resume */
+static ktime_t wakeup_cost_start;	/* monotonic time at resume */
+static u64 wakeup_cost_busy;	/* busy cputime at resume, in jiffies */
+
 static void init_wakeup_irq_node(struct wakeup_irq_node *p, int irq)
 {
 	p->irq = irq;
@@ -300,14 +330,42 @@ static ssize_t suspend_since_boot_show(struct kobject *kobj,
 				jiffies_to_msecs(wakeup_ready_wait));
 }
 
+/*
+ * One line per wakeup reason: irq, name, number of resumes, then the awake
+ * time and CPU time charged to it in milliseconds.  Negative irqs stand for
+ * the unknown, abort and other buckets.
+ */
+static ssize_t wakeup_cost_show(struct kobject *kobj,
+			struct kobj_attribute *attr, char *buf)
+{
+	struct wakeup_cost *c;
+	unsigned long flags;
+	int i, len = 0;
+
+	spin_lock_irqsave(&resume_reason_lock, flags);
+	for (i = 0; i < wakeup_cost_cnt; i++) {
+		c = &wakeup_costs[i];
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				"%d %s %lu %llu %llu\n", c->irq,
+				c->name[0] ? c->name : "-", c->count,
+				div_u64(c->awake_us, USEC_PER_MSEC),
+				div_u64(c->cpu_us, USEC_PER_MSEC));
+	}
+	spin_unlock_irqrestore(&resume_reason_lock, flags);
+
+	return len;
+}
+
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
 static struct kobj_attribute suspend_time = __ATTR_RO(last_suspend_time);
 static struct kobj_attribute suspend_since_boot = __ATTR_RO(suspend_since_boot);
+static struct kobj_attribute wakeup_cost = __ATTR_RO(wakeup_cost);
 
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
 	&suspend_time.attr,
 	&suspend_since_boot.attr,
+	&wakeup_cost.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -573,16 +631,122 @@ void clear_wakeup_reasons(void)
 	spin_unlock_irqrestore(&resume_reason_lock, flags);
 }
 
+static u64 wakeup_cost_busy_jiffies(void)
+{
+	u64 busy = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+		busy += cpustat[CPUTIME_USER] + cpustat[CPUTIME_NICE] +
+			cpustat[CPUTIME_SYSTEM] + cpustat[CPUTIME_IRQ] +
+			cpustat[CPUTIME_SOFTIRQ];
+	}
+	return cputime64_to_jiffies64(busy);
+}
+
+static struct wakeup_cost *wakeup_cost_entry(int irq, const char *name)
+{
+	struct wakeup_cost *c;
+	int i;
+
+	for (i = 0; i < wakeup_cost_cnt; i++)
+		if (wakeup_costs[i].irq == irq)
+			return &wakeup_costs[i];
+
+	/* the last slot is kept for everything that doesn't fit */
+	if (wakeup_cost_cnt == MAX_WAKEUP_COST_ENTRIES - 1) {
+		irq = WAKEUP_COST_OTHER;
+		name = "other";
+		for (i = 0; i < wakeup_cost_cnt; i++)
+			if (wakeup_costs[i].irq == irq)
+				return &wakeup_costs[i];
+	}
+
+	c = &wakeup_costs[wakeup_cost_cnt++];
+	c->irq = irq;
+	strlcpy(c->name, name, sizeof(c->name));
+	return c;
+}
+
+struct wakeup_cost_cookie {
+	int irq[MAX_WAKEUP_COST_LEAVES];
+	const char *name[MAX_WAKEUP_COST_LEAVES];
+	int cnt;
+};
+
+static bool collect_leaf_node(struct wakeup_irq_node *n, void *_p)
+{
+	struct wakeup_cost_cookie *c = _p;
+
+	if (n->child)
+		return true;
+
+	c->irq[c->cnt] = n->irq;
+	if (n->desc && n->desc->action && n->desc->action->name)
+		c->name[c->cnt] = n->desc->action->name;
+	else
+		c->name[c->cnt] = "";
+	return ++c->cnt < MAX_WAKEUP_COST_LEAVES;
+}
+
+/*
+ * Closes the awake period opened by the last resume and charges it to the
+ * wakeup reasons of that resume, which are still in place at this point.
+ * Returns the CPU time of the period in microseconds.
+ */
+static u64 wakeup_cost_account_nolock(void)
+{
+	struct wakeup_cost_cookie cookie = { .cnt = 0 };
+	struct wakeup_cost *c;
+	u64 cpu_us, awake_us;
+	int i;
+
+	cpu_us = div_u64((wakeup_cost_busy_jiffies() - wakeup_cost_busy) *
+			 USEC_PER_SEC, HZ);
+	awake_us = ktime_to_us(ktime_sub(ktime_get(), wakeup_cost_start));
+
+	if (suspend_abort) {
+		cookie.irq[0] = WAKEUP_COST_ABORT;
+		cookie.name[0] = "abort";
+		cookie.cnt = 1;
+	} else {
+		walk_irq_node_tree(base_irq_nodes, collect_leaf_node, &cookie);
+		if (!cookie.cnt) {
+			cookie.irq[0] = WAKEUP_COST_UNKNOWN;
+			cookie.name[0] = "unknown";
+			cookie.cnt = 1;
+		}
+	}
+
+	for (i = 0; i < cookie.cnt; i++) {
+		c = wakeup_cost_entry(cookie.irq[i], cookie.name[i]);
+		c->count++;
+		c->awake_us += div_u64(awake_us, cookie.cnt);
+		c->cpu_us += div_u64(cpu_us, cookie.cnt);
+	}
+
+	return cpu_us;
+}
+
 /* Detects a suspend and clears all the previous wake up reasons*/
 static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		unsigned long pm_event, void *unused)
 {
 	struct timespec xtom; /* wall_to_monotonic, ignored */
 	unsigned long flags;
+	bool cost_end = false;
+	u64 cost_cpu_us = 0;
 
 	spin_lock_irqsave(&resume_reason_lock, flags);
 	switch (pm_event) {
 	case PM_SUSPEND_PREPARE:
+		if (wakeup_cost_window) {
+			cost_cpu_us = wakeup_cost_account_nolock();
+			wakeup_cost_window = false;
+			cost_end = true;
+		}
 		clear_wakeup_reasons_nolock();
 
 		get_xtime_and_monotonic_and_sleep_offset(&last_xtime, &xtom,
@@ -613,11 +777,19 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 #else
 		print_wakeup_sources();
 #endif
+		wakeup_cost_window = true;
+		wakeup_cost_start = ktime_get();
+		wakeup_cost_busy = wakeup_cost_busy_jiffies();
 		break;
 	default:
 		break;
 	}
 	spin_unlock_irqrestore(&resume_reason_lock, flags);
+
+	if (cost_end)
+		pm_wakeup_cost_end(cost_cpu_us);
+	else if (pm_event == PM_POST_SUSPEND)
+		pm_wakeup_cost_start();
 	return NOTIFY_DONE;
 }
 
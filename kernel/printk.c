@@ -42,6 +42,7 @@
 #include <linux/notifier.h>
 #include <linux/rculist.h>
 #include <linux/poll.h>
+#include <linux/workqueue.h>
 
 #include <asm/uaccess.h>
 
@@ -1482,64 +1483,16 @@ static size_t cont_print_text(char *text, size_t size)
 	return textlen;
 }
 
-asmlinkage int vprintk_emit(int facility, int level,
-				const char *dict, size_t dictlen,
-				const char *fmt, va_list args)
+/*
+ * Store the formatted text of one printk() call, handling its syslog prefix,
+ * trailing newline and continuation lines.  Called with logbuf_lock held.
+ * A zero @ts_nsec means now.
+ */
+static size_t log_text(int facility, int level, const char *dict,
+		       size_t dictlen, u64 ts_nsec, char *text,
+		       size_t text_len)
 {
-	static int recursion_bug;
-	static char textbuf[LOG_LINE_MAX];
-	char *text = textbuf;
-	size_t text_len;
 	enum log_flags lflags = 0;
-	unsigned long flags;
-	int this_cpu;
-	int printed_len = 0;
-
-	boot_delay_msec();
-	printk_delay();
-
-	/* This stops the holder of console_sem just where we want him */
-	local_irq_save(flags);
-	this_cpu = smp_processor_id();
-
-	/*
-	 * Ouch, printk recursed into itself!
-	 */
-	if (unlikely(logbuf_cpu == this_cpu)) {
-		/*
-		 * If a crash is occurring during printk() on this CPU,
-		 * then try to get the crash message out but make sure
-		 * we can't deadlock. Otherwise just return to avoid the
-		 * recursion and return - but flag the recursion so that
-		 * it can be printed at the next appropriate moment:
-		 */
-		if (!oops_in_progress && !lockdep_recursing(current)) {
-			recursion_bug = 1;
-			goto out_restore_irqs;
-		}
-		zap_locks();
-	}
-
-	lockdep_off();
-	raw_spin_lock(&logbuf_lock);
-	logbuf_cpu = this_cpu;
-
-	if (recursion_bug) {
-		static const char recursion_msg[] =
-			"BUG: recent printk recursion!";
-
-		recursion_bug = 0;
-		printed_len += strlen(recursion_msg);
-		/* emit KERN_CRIT message */
-		log_store(0, 2, LOG_PREFIX|LOG_NEWLINE, 0,
-			  NULL, 0, recursion_msg, printed_len);
-	}
-
-	/*
-	 * The printf needs to come first; we need the syslog
-	 * prefix which might be passed-in as a parameter.
-	 */
-	text_len = vscnprintf(text, sizeof(textbuf), fmt, args);
 
 	/* mark and strip a trailing newline */
 	if (text_len && text[text_len-1] == '\n') {
@@ -1577,7 +1530,7 @@ asmlinkage int vprintk_emit(int facility, int level,
 
 		/* buffer line if possible, otherwise store it right away */
 		if (!cont_add(facility, level, text, text_len))
-			log_store(facility, level, lflags | LOG_CONT, 0,
+			log_store(facility, level, lflags | LOG_CONT, ts_nsec,
 				  dict, dictlen, text, text_len);
 	} else {
 		bool stored = false;
@@ -1595,10 +1548,202 @@ asmlinkage int vprintk_emit(int facility, int level,
 		}
 
 		if (!stored)
-			log_store(facility, level, lflags, 0,
+			log_store(facility, level, lflags, ts_nsec,
 				  dict, dictlen, text, text_len);
 	}
-	printed_len += text_len;
+	return text_len;
+}
+
+/*
+ * printk() from hard interrupt context doesn't take logbuf_lock or drive the
+ * consoles.  The message is formatted into a small per-CPU staging buffer
+ * instead, and printk_tick() kicks a work item that moves the staged
+ * messages into the log buffer with their original timestamps and then
+ * pushes them to the consoles from process context.  The per-CPU lock is
+ * only ever shared with that work item.  When the staging buffer is full
+ * the message takes the regular path.
+ */
+#define PRINTK_STAGE_SIZE	4096
+
+struct printk_stage_hdr {
+	u64 ts_nsec;
+	u16 len;
+	s8 level;
+	u8 facility;
+};
+
+struct printk_stage {
+	raw_spinlock_t lock;
+	size_t len;
+	char buf[PRINTK_STAGE_SIZE] __aligned(8);
+};
+
+static DEFINE_PER_CPU(struct printk_stage, printk_stage) = {
+	.lock = __RAW_SPIN_LOCK_UNLOCKED(printk_stage.lock),
+};
+
+static bool printk_stage_enabled = true;
+module_param_named(irq_staging, printk_stage_enabled, bool,
+		   S_IRUGO | S_IWUSR);
+
+static inline void printk_stage_mark_pending(void);
+
+static int printk_stage(int facility, int level, const char *fmt,
+			va_list args)
+{
+	struct printk_stage *stage;
+	struct printk_stage_hdr *hdr;
+	unsigned long flags;
+	size_t room;
+	int len = -1;
+	va_list ap;
+
+	local_irq_save(flags);
+	stage = &__get_cpu_var(printk_stage);
+	raw_spin_lock(&stage->lock);
+
+	room = PRINTK_STAGE_SIZE - stage->len;
+	if (room <= sizeof(*hdr))
+		goto out;
+	room = min_t(size_t, room - sizeof(*hdr), LOG_LINE_MAX);
+
+	hdr = (struct printk_stage_hdr *)(stage->buf + stage->len);
+	va_copy(ap, args);
+	len = vsnprintf((char *)(hdr + 1), room, fmt, ap);
+	va_end(ap);
+	if (len >= room && room < LOG_LINE_MAX) {
+		/* doesn't fit, leave it to the regular path */
+		len = -1;
+		goto out;
+	}
+	len = min_t(int, len, room - 1);
+
+	hdr->ts_nsec = local_clock();
+	hdr->len = len;
+	hdr->level = level;
+	hdr->facility = facility;
+	stage->len += ALIGN(sizeof(*hdr) + len, 8);
+	printk_stage_mark_pending();
+out:
+	raw_spin_unlock(&stage->lock);
+	local_irq_restore(flags);
+	return len;
+}
+
+static void printk_stage_flush(struct work_struct *work)
+{
+	static char buf[PRINTK_STAGE_SIZE] __aligned(8);
+	static DEFINE_MUTEX(flush_lock);
+	struct printk_stage *stage;
+	struct printk_stage_hdr *hdr;
+	unsigned long flags;
+	size_t len, pos;
+	int cpu;
+
+	mutex_lock(&flush_lock);
+	for_each_possible_cpu(cpu) {
+		stage = &per_cpu(printk_stage, cpu);
+
+		raw_spin_lock_irqsave(&stage->lock, flags);
+		len = stage->len;
+		memcpy(buf, stage->buf, len);
+		stage->len = 0;
+		raw_spin_unlock_irqrestore(&stage->lock, flags);
+
+		if (!len)
+			continue;
+
+		raw_spin_lock_irqsave(&logbuf_lock, flags);
+		for (pos = 0; pos < len;
+		     pos += ALIGN(sizeof(*hdr) + hdr->len, 8)) {
+			hdr = (struct printk_stage_hdr *)(buf + pos);
+			log_text(hdr->facility, hdr->level, NULL, 0,
+				 hdr->ts_nsec, (char *)(hdr + 1), hdr->len);
+		}
+		raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+	}
+	mutex_unlock(&flush_lock);
+
+	/* push the new records to the consoles */
+	console_lock();
+	console_unlock();
+}
+
+static DECLARE_WORK(printk_stage_work, printk_stage_flush);
+
+static void printk_stage_kick(void)
+{
+	schedule_work(&printk_stage_work);
+}
+
+asmlinkage int vprintk_emit(int facility, int level,
+				const char *dict, size_t dictlen,
+				const char *fmt, va_list args)
+{
+	static int recursion_bug;
+	static char textbuf[LOG_LINE_MAX];
+	char *text = textbuf;
+	size_t text_len;
+	unsigned long flags;
+	int this_cpu;
+	int printed_len = 0;
+
+	boot_delay_msec();
+	printk_delay();
+
+	if (printk_stage_enabled && in_irq() && !dict && !oops_in_progress &&
+	    keventd_up()) {
+		int len = printk_stage(facility, level, fmt, args);
+
+		if (len >= 0)
+			return len;
+	}
+
+	/* This stops the holder of console_sem just where we want him */
+	local_irq_save(flags);
+	this_cpu = smp_processor_id();
+
+	/*
+	 * Ouch, printk recursed into itself!
+	 */
+	if (unlikely(logbuf_cpu == this_cpu)) {
+		/*
+		 * If a crash is occurring during printk() on this CPU,
+		 * then try to get the crash message out but make sure
+		 * we can't deadlock. Otherwise just return to avoid the
+		 * recursion and return - but flag the recursion so that
+		 * it can be printed at the next appropriate moment:
+		 */
+		if (!oops_in_progress && !lockdep_recursing(current)) {
+			recursion_bug = 1;
+			goto out_restore_irqs;
+		}
+		zap_locks();
+	}
+
+	lockdep_off();
+	raw_spin_lock(&logbuf_lock);
+	logbuf_cpu = this_cpu;
+
+	if (recursion_bug) {
+		static const char recursion_msg[] =
+			"BUG: recent printk recursion!";
+
+		recursion_bug = 0;
+		printed_len += strlen(recursion_msg);
+		/* emit KERN_CRIT message */
+		log_store(0, 2, LOG_PREFIX|LOG_NEWLINE, 0,
+			  NULL, 0, recursion_msg, printed_len);
+	}
+
+	/*
+	 * The printf needs to come first; we need the syslog
+	 * prefix which might be passed-in as a parameter.
+	 */
+	text_len = vscnprintf(text, sizeof(textbuf), fmt, args);
+
+	printed_len += log_text(facility, level, dict, dictlen, 0, text,
+				text_len);
 
 	/*
 	* Try to acquire and then immediately release the console semaphore.
@@ -1707,6 +1852,7 @@ static void call_console_drivers(int level, const char *text, size_t len) {}
 static size_t msg_print_text(const struct log *msg, enum log_flags prev,
 			     bool syslog, char *buf, size_t size) { return 0; }
 static size_t cont_print_text(char *text, size_t size) { return 0; }
+static void printk_stage_kick(void) {}
 
 #endif /* CONFIG_PRINTK */
 
@@ -1966,6 +2112,7 @@ int is_console_locked(void)
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_STAGE	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
@@ -1980,6 +2127,8 @@ void printk_tick(void)
 		}
 		if (pending & PRINTK_PENDING_WAKEUP)
 			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_STAGE)
+			printk_stage_kick();
 	}
 }
 
@@ -1990,6 +2139,11 @@ int printk_needs_cpu(int cpu)
 	return __this_cpu_read(printk_pending);
 }
 
+static inline void printk_stage_mark_pending(void)
+{
+	this_cpu_or(printk_pending, PRINTK_PENDING_STAGE);
+}
+
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
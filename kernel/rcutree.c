@@ -1625,6 +1625,7 @@ void rcu_check_callbacks(int cpu, int user)
 {
 	trace_rcu_utilization("Start scheduler-tick");
 	increment_cpu_stall_ticks();
+	rcu_nocb_do_deferred_wakeup(cpu);
 	if (user || rcu_is_cpu_rrupt_from_idle()) {
 
 		/*
@@ -1865,13 +1866,16 @@ static void rcu_leak_callback(struct rcu_head *rhp)
 
 /*
  * Helper function for call_rcu() and friends.  The cpu argument will
- * normally be -1, indicating "currently running CPU".  It may specify
- * a CPU only if that CPU is a no-CBs CPU.  Currently, only _rcu_barrier()
- * is expected to specify a CPU.
+ * normally be RCU_CALL_CURRENT, indicating "currently running CPU", whose
+ * callbacks are handed to its offload kthread if it is a no-CBs CPU.
+ * It may specify a CPU only if that CPU is a no-CBs CPU.  Currently, only
+ * _rcu_barrier() is expected to specify a CPU.  RCU_CALL_NO_OFFLOAD
+ * queues on the current CPU's own lists even if it is a no-CBs CPU, which
+ * the offload kthreads use to wait for grace periods.
  */
 static void
 __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
-	   struct rcu_state *rsp, bool lazy)
+	   struct rcu_state *rsp, int cpu, bool lazy)
 {
 	unsigned long flags;
 	struct rcu_data *rdp;
@@ -1897,6 +1901,18 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	/* Hand the callback to a no-CBs CPU's kthread, if any. */
+	if (cpu != RCU_CALL_NO_OFFLOAD) {
+		if (cpu >= 0)
+			rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (__call_rcu_nocb(rdp, head, lazy, flags)) {
+			local_irq_restore(flags);
+			return;
+		}
+		WARN_ON_ONCE(cpu >= 0);
+		rdp = this_cpu_ptr(rsp->rda);
+	}
+
 	/* Add the callback to our list. */
 	rdp->qlen++;
 	if (lazy)
@@ -1958,7 +1974,7 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
  */
 void call_rcu_sched(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_sched_state, 0);
+	__call_rcu(head, func, &rcu_sched_state, RCU_CALL_CURRENT, 0);
 }
 EXPORT_SYMBOL_GPL(call_rcu_sched);
 
@@ -1967,7 +1983,7 @@ EXPORT_SYMBOL_GPL(call_rcu_sched);
  */
 void call_rcu_bh(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_bh_state, 0);
+	__call_rcu(head, func, &rcu_bh_state, RCU_CALL_CURRENT, 0);
 }
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
@@ -2247,7 +2263,8 @@ static int rcu_cpu_has_callbacks(int cpu)
 	/* RCU callbacks either ready or pending? */
 	return per_cpu(rcu_sched_data, cpu).nxtlist ||
 	       per_cpu(rcu_bh_data, cpu).nxtlist ||
-	       rcu_preempt_cpu_has_callbacks(cpu);
+	       rcu_preempt_cpu_has_callbacks(cpu) ||
+	       rcu_nocb_need_deferred_wakeup(cpu);
 }
 
 /*
@@ -2262,26 +2279,24 @@ static void rcu_barrier_callback(struct rcu_head *notused)
 
 /*
  * Called with preemption disabled, and from cross-cpu IRQ context.
+ * The callback goes behind this CPU's own lists even on a no-CBs CPU,
+ * whose offloaded callbacks are covered by rcu_nocb_barrier().
  */
 static void rcu_barrier_func(void *type)
 {
 	int cpu = smp_processor_id();
 	struct rcu_head *head = &per_cpu(rcu_barrier_head, cpu);
-	void (*call_rcu_func)(struct rcu_head *head,
-			      void (*func)(struct rcu_head *head));
+	struct rcu_state *rsp = type;
 
 	atomic_inc(&rcu_barrier_cpu_count);
-	call_rcu_func = type;
-	call_rcu_func(head, rcu_barrier_callback);
+	__call_rcu(head, rcu_barrier_callback, rsp, RCU_CALL_NO_OFFLOAD, 0);
 }
 
 /*
  * Orchestrate the specified type of RCU barrier, waiting for all
  * RCU callbacks of the specified type to complete.
  */
-static void _rcu_barrier(struct rcu_state *rsp,
-			 void (*call_rcu_func)(struct rcu_head *head,
-					       void (*func)(struct rcu_head *head)))
+static void _rcu_barrier(struct rcu_state *rsp)
 {
 	int cpu;
 	unsigned long flags;
@@ -2326,6 +2341,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	 * callbacks.
 	 */
 	for_each_possible_cpu(cpu) {
+		rcu_nocb_barrier(rsp, cpu);
 		preempt_disable();
 		rdp = per_cpu_ptr(rsp->rda, cpu);
 		if (cpu_is_offline(cpu)) {
@@ -2334,7 +2350,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 				schedule_timeout_interruptible(1);
 		} else if (ACCESS_ONCE(rdp->qlen)) {
 			smp_call_function_single(cpu, rcu_barrier_func,
-						 (void *)call_rcu_func, 1);
+						 (void *)rsp, 1);
 			preempt_enable();
 		} else {
 			preempt_enable();
@@ -2355,7 +2371,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	raw_spin_unlock_irqrestore(&rsp->onofflock, flags);
 	atomic_inc(&rcu_barrier_cpu_count);
 	smp_mb__after_atomic_inc(); /* Ensure atomic_inc() before callback. */
-	call_rcu_func(&rh, rcu_barrier_callback);
+	__call_rcu(&rh, rcu_barrier_callback, rsp, RCU_CALL_NO_OFFLOAD, 0);
 
 	/*
 	 * Now that we have an rcu_barrier_callback() callback on each
@@ -2378,7 +2394,7 @@ static void _rcu_barrier(struct rcu_state *rsp,
  */
 void rcu_barrier_bh(void)
 {
-	_rcu_barrier(&rcu_bh_state, call_rcu_bh);
+	_rcu_barrier(&rcu_bh_state);
 }
 EXPORT_SYMBOL_GPL(rcu_barrier_bh);
 
@@ -2387,7 +2403,7 @@ EXPORT_SYMBOL_GPL(rcu_barrier_bh);
  */
 void rcu_barrier_sched(void)
 {
-	_rcu_barrier(&rcu_sched_state, call_rcu_sched);
+	_rcu_barrier(&rcu_sched_state);
 }
 EXPORT_SYMBOL_GPL(rcu_barrier_sched);
 
@@ -2415,6 +2431,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	WARN_ON_ONCE(atomic_read(&rdp->dynticks->dynticks) != 1);
 	rdp->cpu = cpu;
 	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
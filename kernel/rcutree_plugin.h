@@ -701,7 +701,7 @@ static void rcu_preempt_do_callbacks(void)
  */
 void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_preempt_state, 0);
+	__call_rcu(head, func, &rcu_preempt_state, RCU_CALL_CURRENT, 0);
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
@@ -715,7 +715,7 @@ EXPORT_SYMBOL_GPL(call_rcu);
 void kfree_call_rcu(struct rcu_head *head,
 		    void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_preempt_state, 1);
+	__call_rcu(head, func, &rcu_preempt_state, RCU_CALL_CURRENT, 1);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
@@ -944,7 +944,7 @@ static int rcu_preempt_cpu_has_callbacks(int cpu)
  */
 void rcu_barrier(void)
 {
-	_rcu_barrier(&rcu_preempt_state, call_rcu);
+	_rcu_barrier(&rcu_preempt_state);
 }
 EXPORT_SYMBOL_GPL(rcu_barrier);
 
@@ -1120,7 +1120,7 @@ static void rcu_preempt_process_callbacks(void)
 void kfree_call_rcu(struct rcu_head *head,
 		    void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_sched_state, 1);
+	__call_rcu(head, func, &rcu_sched_state, RCU_CALL_CURRENT, 1);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
@@ -2104,3 +2104,324 @@ static void increment_cpu_stall_ticks(void)
 }
 
 #endif /* #else #ifdef CONFIG_RCU_CPU_STALL_INFO */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback processing from the boot-time-specified set of CPUs
+ * specified by rcu_nocb_mask.  For each CPU in the set, there is a
+ * kthread for each flavor of RCU that takes callbacks from the
+ * corresponding CPU, waits for a grace period to elapse, and invokes
+ * the callbacks.  These kthreads are not bound to their CPU, so they
+ * can be placed, for example, on housekeeping CPUs, leaving the no-CBs
+ * CPUs free of RCU softirq processing.  The no-CBs CPUs still have to
+ * pass through quiescent states, which dyntick-idle takes care of.
+ */
+
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+static bool rcu_nocb_poll;	    /* Offload kthreads are to poll. */
+module_param(rcu_nocb_poll, bool, 0444);
+static int rcu_nocb_batch_ms;	    /* Let callbacks pile up this long. */
+module_param(rcu_nocb_batch_ms, int, 0644);
+static DEFINE_PER_CPU(struct rcu_head, rcu_nocb_barrier_head);
+
+/* Parse the boot-time rcu_nocb_mask CPU list from the kernel parameters. */
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Enqueue the specified callback onto the specified no-CBs CPU's list,
+ * which can be done from any CPU.  The kthread is awakened when the list
+ * was empty, except with interrupts disabled, where the waker might hold
+ * scheduler locks: the wakeup is then left to the next scheduling-clock
+ * interrupt of the CPU that queued the callback.
+ */
+static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
+				    struct rcu_head *rhp, bool lazy,
+				    unsigned long flags)
+{
+	struct rcu_head **old_rhpp;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+	if (lazy)
+		atomic_long_inc(&rdp->nocb_q_count_lazy);
+
+	if (rcu_nocb_poll || old_rhpp != &rdp->nocb_head)
+		return;
+	if (irqs_disabled_flags(flags))
+		__this_cpu_ptr(rdp->rsp->rda)->nocb_defer_wakeup = true;
+	else
+		wake_up(&rdp->nocb_wq);
+}
+
+/*
+ * This is a helper for __call_rcu(), which invokes this when the normal
+ * callback queue is inoperable.  If this is not a no-CBs CPU, or its
+ * kthreads are not running yet, this function returns false, and the
+ * callback goes on the CPU's own lists.  Called with interrupts disabled.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy, unsigned long flags)
+{
+	if (!is_nocb_cpu(rdp->cpu) || !ACCESS_ONCE(rdp->nocb_kthread))
+		return false;
+	__call_rcu_nocb_enqueue(rdp, rhp, lazy, flags);
+	if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+		trace_rcu_kfree_callback(rdp->rsp->name, rhp,
+					 (unsigned long)rhp->func,
+				atomic_long_read(&rdp->nocb_q_count_lazy),
+				atomic_long_read(&rdp->nocb_q_count));
+	else
+		trace_rcu_callback(rdp->rsp->name, rhp,
+				   atomic_long_read(&rdp->nocb_q_count_lazy),
+				   atomic_long_read(&rdp->nocb_q_count));
+	return true;
+}
+
+/*
+ * Make _rcu_barrier() wait for the callbacks offloaded from the specified
+ * CPU, whether or not it is online.  The offload kthread invokes its
+ * callbacks in order, so a barrier callback queued behind them completes
+ * after all of them.  Called before _rcu_barrier() posts the barrier
+ * callback for the CPU's own lists.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp, int cpu)
+{
+	struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+
+	if (!is_nocb_cpu(cpu) || !ACCESS_ONCE(rdp->nocb_kthread))
+		return;
+	atomic_inc(&rcu_barrier_cpu_count);
+	__call_rcu(&per_cpu(rcu_nocb_barrier_head, cpu), rcu_barrier_callback,
+		   rsp, cpu, 0);
+}
+
+/* Does this CPU owe an offload kthread a wakeup? */
+static bool rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	bool ret = per_cpu(rcu_sched_data, cpu).nocb_defer_wakeup ||
+		   per_cpu(rcu_bh_data, cpu).nocb_defer_wakeup;
+
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	ret = ret || per_cpu(rcu_preempt_data, cpu).nocb_defer_wakeup;
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	return ret;
+}
+
+/*
+ * Deferred wakeups are recorded in the rcu_data of the CPU that queued
+ * the callback, but the kthread to wake is the one of the target CPU,
+ * which is only known to be the same CPU for a normal call_rcu().  Wake
+ * every kthread of the flavor that might have been missed; a spurious
+ * wakeup finds an empty list and goes back to sleep.
+ */
+static void rcu_nocb_wake_flavor(struct rcu_state *rsp, int cpu)
+{
+	struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+	int i;
+
+	if (!ACCESS_ONCE(rdp->nocb_defer_wakeup))
+		return;
+	ACCESS_ONCE(rdp->nocb_defer_wakeup) = false;
+	for_each_cpu(i, rcu_nocb_mask) {
+		struct rcu_data *nrdp = per_cpu_ptr(rsp->rda, i);
+
+		if (ACCESS_ONCE(nrdp->nocb_head))
+			wake_up(&nrdp->nocb_wq);
+	}
+}
+
+/* Do the wakeups deferred by __call_rcu_nocb_enqueue(). */
+static void rcu_nocb_do_deferred_wakeup(int cpu)
+{
+	if (!have_rcu_nocb_mask)
+		return;
+	rcu_nocb_wake_flavor(&rcu_sched_state, cpu);
+	rcu_nocb_wake_flavor(&rcu_bh_state, cpu);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_nocb_wake_flavor(&rcu_preempt_state, cpu);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+}
+
+struct rcu_nocb_gp {
+	struct rcu_head head;
+	struct completion done;
+};
+
+static void rcu_nocb_gp_done(struct rcu_head *rhp)
+{
+	complete(&container_of(rhp, struct rcu_nocb_gp, head)->done);
+}
+
+/*
+ * Wait for a grace period of the kthread's flavor.  The callback goes on
+ * the lists of whatever CPU the kthread runs on, even a no-CBs one, so
+ * offload kthreads never wait on each other.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_nocb_gp gp;
+
+	init_rcu_head_on_stack(&gp.head);
+	init_completion(&gp.done);
+	__call_rcu(&gp.head, rcu_nocb_gp_done, rdp->rsp,
+		   RCU_CALL_NO_OFFLOAD, 0);
+	wait_for_completion(&gp.done);
+	destroy_rcu_head_on_stack(&gp.head);
+}
+
+/*
+ * Per-rcu_data kthread.  Takes the whole list of callbacks at once,
+ * optionally after letting it grow for rcu_nocb_batch_ms, so a single
+ * grace period covers the batch, then invokes the callbacks.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next, **tail;
+	long c, cl;
+	int batch;
+
+	for (;;) {
+		/* Wait for callbacks to appear. */
+		if (!rcu_nocb_poll)
+			wait_event_interruptible(rdp->nocb_wq,
+						 ACCESS_ONCE(rdp->nocb_head));
+		if (!ACCESS_ONCE(rdp->nocb_head)) {
+			if (rcu_nocb_poll)
+				schedule_timeout_interruptible(1);
+			flush_signals(current);
+			continue;
+		}
+
+		batch = ACCESS_ONCE(rcu_nocb_batch_ms);
+		if (batch > 0)
+			schedule_timeout_interruptible(msecs_to_jiffies(batch));
+
+		/* Move callbacks to the local list and wait for a GP. */
+		list = ACCESS_ONCE(rdp->nocb_head);
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		atomic_long_set(&rdp->nocb_q_count, 0);
+		atomic_long_set(&rdp->nocb_q_count_lazy, 0);
+		rcu_nocb_wait_gp(rdp);
+
+		/* Each pass through the following loop invokes a callback. */
+		trace_rcu_batch_start(rdp->rsp->name, 0, 0, -1);
+		c = cl = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for enqueuing to complete, if needed. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			if (__rcu_reclaim(rdp->rsp->name, list))
+				cl++;
+			c++;
+			local_bh_enable();
+			list = next;
+			cond_resched();
+		}
+		trace_rcu_batch_end(rdp->rsp->name, c, !!list, 0, 0, 1);
+		rdp->n_nocb_invoked += c;
+	}
+	return 0;
+}
+
+/* Initialize per-rcu_data variables for no-CBs CPUs. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/*
+ * Create a kthread for each RCU flavor for each no-CBs CPU.  They are
+ * named rcuo<flavor>/<cpu>, with the flavor taken from the first letter
+ * after the "rcu_" of the flavor's name (s, b or p).
+ */
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (!cpu_possible(cpu))
+			continue;
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_run(rcu_nocb_kthread, rdp,
+				"rcuo%c/%d", rsp->name[4], cpu);
+		if (IS_ERR(t)) {
+			pr_err("RCU: no-CBs kthread for CPU %d failed: %ld\n",
+			       cpu, PTR_ERR(t));
+			continue;
+		}
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+	}
+}
+
+static int __init rcu_spawn_all_nocb_kthreads(void)
+{
+	char buf[64];
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "\tOffload RCU callbacks from CPUs: %s%s.\n", buf,
+	       rcu_nocb_poll ? " (polled)" : "");
+	rcu_spawn_nocb_kthreads(&rcu_sched_state);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	return 0;
+}
+early_initcall(rcu_spawn_all_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy, unsigned long flags)
+{
+	return false;
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp, int cpu)
+{
+}
+
+static bool rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return false;
+}
+
+static void rcu_nocb_do_deferred_wakeup(int cpu)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
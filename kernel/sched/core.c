@@ -770,6 +770,7 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(p);
+	inc_cumulative_demand(rq, p, flags);
 	p->sched_class->enqueue_task(rq, p, flags);
 	trace_sched_enq_deq_task(p, 1);
 }
@@ -778,6 +779,7 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_dequeued(p);
+	dec_cumulative_demand(rq, p, flags);
 	p->sched_class->dequeue_task(rq, p, flags);
 	trace_sched_enq_deq_task(p, 0);
 }
@@ -1169,6 +1171,7 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	if (task_cpu(p) != new_cpu) {
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, NULL, 0);
+		sched_ravg_migrate(p, new_cpu);
 	}
 
 	__set_task_cpu(p, new_cpu);
@@ -1537,6 +1540,8 @@ static void sched_ttwu_pending(void)
 	}
 
 	raw_spin_unlock(&rq->lock);
+
+	check_for_demand_change(cpu_of(rq));
 }
 
 void scheduler_ipi(void)
@@ -1639,6 +1644,7 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 	unsigned long flags;
 	int cpu, src_cpu, success = 0;
 	int notify = 0;
+	struct migration_notify_data mnd;
 
 	/*
 	 * If we are going to wake up a thread waiting for CONDITION we
@@ -1703,14 +1709,22 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 stat:
 	ttwu_stat(p, cpu, wake_flags);
 
-	if (src_cpu != cpu && task_notify_on_migrate(p))
+	if (src_cpu != cpu && task_notify_on_migrate(p)) {
+		mnd.src_cpu = src_cpu;
+		mnd.dest_cpu = cpu;
+		mnd.load = task_load_pct(p);
 		notify = 1;
+	}
 out:
 	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
 
 	if (notify)
 		atomic_notifier_call_chain(&migration_notifier_head,
-					   cpu, (void *)src_cpu);
+					   0, (void *)&mnd);
+
+	check_for_demand_change(cpu);
+	if (src_cpu != cpu)
+		check_for_demand_change(src_cpu);
 	return success;
 }
 
@@ -1800,6 +1814,10 @@ static void __sched_fork(struct task_struct *p)
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	memset(&p->ravg, 0, sizeof(p->ravg));
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -1914,6 +1932,8 @@ void wake_up_new_task(struct task_struct *p)
 		p->sched_class->task_woken(rq, p);
 #endif
 	task_rq_unlock(rq, p, &flags);
+
+	check_for_demand_change(cpu_of(rq));
 }
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -2044,6 +2064,7 @@ static void finish_task_switch(struct rq *rq, struct task_struct *prev)
 #endif /* __ARCH_WANT_INTERRUPTS_ON_CTXSW */
 	finish_lock_switch(rq, prev);
 	finish_arch_post_lock_switch();
+	check_for_demand_change(cpu_of(rq));
 
 	fire_sched_in_preempt_notifiers(current);
 	if (mm)
@@ -3309,9 +3330,12 @@ void scheduler_tick(void)
 	raw_spin_lock(&rq->lock);
 	update_rq_clock(rq);
 	update_cpu_load_active(rq);
+	sched_demand_tick(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
 
+	check_for_demand_change(cpu);
+
 	perf_event_task_tick();
 
 #ifdef CONFIG_SMP
@@ -3512,6 +3536,8 @@ need_resched:
 
 	put_prev_task(rq, prev);
 	next = pick_next_task(rq);
+	update_task_ravg(prev, rq, 1);
+	update_task_ravg(next, rq, 0);
 	clear_tsk_need_resched(prev);
 	rq->skip_clock_update = 0;
 
@@ -5351,6 +5377,7 @@ EXPORT_SYMBOL_GPL(set_cpus_allowed_ptr);
 static int __migrate_task(struct task_struct *p, int src_cpu, int dest_cpu)
 {
 	struct rq *rq_dest, *rq_src;
+	struct migration_notify_data mnd;
 	bool moved = false;
 	int ret = 0;
 
@@ -5379,15 +5406,23 @@ static int __migrate_task(struct task_struct *p, int src_cpu, int dest_cpu)
 		enqueue_task(rq_dest, p, 0);
 		check_preempt_curr(rq_dest, p, 0);
 		moved = true;
+		mnd.load = task_load_pct(p);
 	}
 done:
 	ret = 1;
 fail:
 	double_rq_unlock(rq_src, rq_dest);
 	raw_spin_unlock(&p->pi_lock);
-	if (moved && task_notify_on_migrate(p))
+	if (moved && task_notify_on_migrate(p)) {
+		mnd.src_cpu = src_cpu;
+		mnd.dest_cpu = dest_cpu;
 		atomic_notifier_call_chain(&migration_notifier_head,
-					   dest_cpu, (void *)src_cpu);
+					   0, (void *)&mnd);
+	}
+	if (moved) {
+		check_for_demand_change(src_cpu);
+		check_for_demand_change(dest_cpu);
+	}
 	return ret;
 }
 
@@ -305,6 +305,11 @@ static void print_cpu(struct seq_file *m, int cpu)
 	P(ttwu_count);
 	P(ttwu_local);
 
+	P(rt_select_idle);
+	P(rt_wakeup_count);
+	P64(rt_wakeup_lat_sum);
+	P64(rt_wakeup_lat_max);
+
 #undef P
 #undef P64
 #endif
@@ -1144,8 +1144,11 @@ enqueue_task_rt(struct rq *rq, struct task_struct *p, int flags)
 {
 	struct sched_rt_entity *rt_se = &p->rt;
 
-	if (flags & ENQUEUE_WAKEUP)
+	if (flags & ENQUEUE_WAKEUP) {
 		rt_se->timeout = 0;
+		schedstat_set(p->se.statistics.rt_wakeup_start,
+			      sched_clock_cpu(cpu_of(rq)));
+	}
 
 	enqueue_rt_entity(rt_se, flags & ENQUEUE_HEAD);
 
@@ -1204,6 +1207,35 @@ static void yield_task_rt(struct rq *rq)
 #ifdef CONFIG_SMP
 static int find_lowest_rq(struct task_struct *task);
 
+/*
+ * Fast path for waking RT tasks: cpupri already tracks the idle CPUs, so
+ * pick one of those, the waking CPU first and then the ones following
+ * @prev_cpu, before falling back to the full priority search.
+ */
+static int find_idle_rt_cpu(struct task_struct *p, int prev_cpu)
+{
+	struct cpupri_vec *vec;
+	int this_cpu = smp_processor_id();
+	int cpu;
+
+	vec = &task_rq(p)->rd->cpupri.pri_to_cpu[CPUPRI_IDLE];
+	if (!atomic_read(&vec->count))
+		return -1;
+
+	/* Pairs with the barriers in cpupri_set() */
+	smp_rmb();
+
+	if (cpumask_test_cpu(this_cpu, vec->mask) &&
+	    cpumask_test_cpu(this_cpu, tsk_cpus_allowed(p)))
+		return this_cpu;
+
+	cpu = cpumask_next_and(prev_cpu, vec->mask, tsk_cpus_allowed(p));
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first_and(vec->mask, tsk_cpus_allowed(p));
+
+	return cpu < nr_cpu_ids ? cpu : -1;
+}
+
 static int
 select_task_rq_rt(struct task_struct *p, int sd_flag, int flags)
 {
@@ -1251,7 +1283,12 @@ select_task_rq_rt(struct task_struct *p, int sd_flag, int flags)
 	    (curr->rt.nr_cpus_allowed < 2 ||
 	     curr->prio <= p->prio) &&
 	    (p->rt.nr_cpus_allowed > 1)) {
-		int target = find_lowest_rq(p);
+		int target = find_idle_rt_cpu(p, cpu);
+
+		if (target == -1)
+			target = find_lowest_rq(p);
+		else
+			schedstat_inc(rq, rt_select_idle);
 
 		/*
 		 * Don't bother moving it if the destination CPU is
@@ -1361,13 +1398,38 @@ static struct task_struct *_pick_next_task_rt(struct rq *rq)
 	return p;
 }
 
+#ifdef CONFIG_SCHEDSTATS
+static void update_rt_wakeup_latency(struct rq *rq, struct task_struct *p)
+{
+	u64 start = p->se.statistics.rt_wakeup_start;
+	u64 delta;
+
+	if (!start)
+		return;
+
+	p->se.statistics.rt_wakeup_start = 0;
+	delta = sched_clock_cpu(cpu_of(rq)) - start;
+	if ((s64)delta < 0)
+		return;
+
+	rq->rt_wakeup_count++;
+	rq->rt_wakeup_lat_sum += delta;
+	rq->rt_wakeup_lat_max = max(rq->rt_wakeup_lat_max, delta);
+}
+#else
+static inline void
+update_rt_wakeup_latency(struct rq *rq, struct task_struct *p) { }
+#endif
+
 static struct task_struct *pick_next_task_rt(struct rq *rq)
 {
 	struct task_struct *p = _pick_next_task_rt(rq);
 
 	/* The running task is never eligible for pushing */
-	if (p)
+	if (p) {
 		dequeue_pushable_task(rq, p);
+		update_rt_wakeup_latency(rq, p);
+	}
 
 #ifdef CONFIG_SMP
 	/*
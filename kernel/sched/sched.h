@@ -3,6 +3,7 @@
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
 #include <linux/stop_machine.h>
+#include <linux/notifier.h>
 
 #include "cpupri.h"
 
@@ -460,11 +461,24 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* RT wakeup placement and wakeup-to-run latency */
+	unsigned int rt_select_idle;
+	unsigned int rt_wakeup_count;
+	u64 rt_wakeup_lat_sum;
+	u64 rt_wakeup_lat_max;
 #endif
 
 #ifdef CONFIG_SMP
 	struct llist_head wake_list;
 #endif
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+	/* sum of ravg.demand of the tasks queued on this runqueue */
+	u64 cumulative_demand;
+	/* set when a change of cumulative_demand is to be reported */
+	int demand_notify;
+#endif
 };
 
 static inline int cpu_of(struct rq *rq)
@@ -936,6 +950,48 @@ static inline void dec_nr_running(struct rq *rq)
 	rq->nr_running--;
 }
 
+#ifdef CONFIG_SCHED_FREQ_INPUT
+extern void update_task_ravg(struct task_struct *p, struct rq *rq,
+			     int running);
+extern void inc_cumulative_demand(struct rq *rq, struct task_struct *p,
+				  int flags);
+extern void dec_cumulative_demand(struct rq *rq, struct task_struct *p,
+				  int flags);
+extern void sched_ravg_migrate(struct task_struct *p, unsigned int new_cpu);
+extern void sched_demand_tick(struct rq *rq);
+
+/*
+ * Report a pending change of @cpu's demand. Must be called without any
+ * runqueue lock held, as the governors may wake up their own threads.
+ */
+static inline void check_for_demand_change(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+
+	if (rq->demand_notify && xchg(&rq->demand_notify, 0))
+		atomic_notifier_call_chain(&cpu_demand_notifier_head,
+					   cpu, NULL);
+}
+
+/* Windowed demand of @p in percent of the window */
+static inline int task_load_pct(struct task_struct *p)
+{
+	return div64_u64((u64)p->ravg.demand * 100, sysctl_sched_ravg_window);
+}
+#else
+static inline void update_task_ravg(struct task_struct *p, struct rq *rq,
+				    int running) { }
+static inline void inc_cumulative_demand(struct rq *rq,
+					 struct task_struct *p, int flags) { }
+static inline void dec_cumulative_demand(struct rq *rq,
+					 struct task_struct *p, int flags) { }
+static inline void sched_ravg_migrate(struct task_struct *p,
+				      unsigned int new_cpu) { }
+static inline void sched_demand_tick(struct rq *rq) { }
+static inline void check_for_demand_change(int cpu) { }
+static inline int task_load_pct(struct task_struct *p) { return 0; }
+#endif
+
 extern void update_rq_clock(struct rq *rq);
 
 extern void activate_task(struct rq *rq, struct task_struct *p, int flags);
@@ -19,6 +19,8 @@
 #include <linux/sched.h>
 #include <linux/math64.h>
 
+#include "sched.h"
+
 static DEFINE_PER_CPU(u64, nr_prod_sum);
 static DEFINE_PER_CPU(u64, last_time);
 static DEFINE_PER_CPU(u64, nr);
@@ -104,3 +106,181 @@ void sched_update_nr_prod(int cpu, unsigned long nr_running, bool inc)
 	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
+
+#ifdef CONFIG_SCHED_FREQ_INPUT
+/*
+ * Window size (in ns) over which per-task cpu demand is measured, and the
+ * minimum demand, as a percentage of the window, of a task whose wakeup,
+ * migration or exit is reported to the cpu_demand_notifier_head chain.
+ */
+__read_mostly unsigned int sysctl_sched_ravg_window = 20000000;
+__read_mostly unsigned int sysctl_sched_demand_notify_pct = 10;
+
+ATOMIC_NOTIFIER_HEAD(cpu_demand_notifier_head);
+EXPORT_SYMBOL(cpu_demand_notifier_head);
+
+/* Report every enqueue and tick, not only significant demand changes */
+static int demand_callbacks __read_mostly;
+
+/**
+ * sched_set_demand_callbacks
+ * @enable: Whether to call cpu_demand_notifier_head on every enqueue and tick.
+ *
+ * Lets a governor take its frequency decisions from the scheduler's
+ * enqueue and tick paths instead of sampling load from a timer.
+ */
+void sched_set_demand_callbacks(int enable)
+{
+	demand_callbacks = !!enable;
+}
+EXPORT_SYMBOL(sched_set_demand_callbacks);
+
+static inline int demand_is_significant(struct task_struct *p)
+{
+	return (u64)p->ravg.demand * 100 >
+		(u64)sysctl_sched_ravg_window * sysctl_sched_demand_notify_pct;
+}
+
+/*
+ * Push the busy time of a just completed window into the task's history
+ * and recompute its demand, keeping the runqueue's sum in sync.
+ */
+static void update_task_demand(struct task_struct *p, struct rq *rq, u32 sum)
+{
+	u32 *hist = p->ravg.sum_history;
+	u64 avg = sum;
+	u32 demand;
+	int i;
+
+	for (i = RAVG_HIST_SIZE - 1; i > 0; i--) {
+		hist[i] = hist[i - 1];
+		avg += hist[i];
+	}
+	hist[0] = sum;
+	do_div(avg, RAVG_HIST_SIZE);
+
+	demand = max_t(u32, avg, sum);
+	if (p->ravg.accounted)
+		rq->cumulative_demand = rq->cumulative_demand -
+					p->ravg.demand + demand;
+	p->ravg.demand = demand;
+}
+
+/**
+ * update_task_ravg
+ * @p: The task whose demand is updated.
+ * @rq: The runqueue @p belongs to, locked.
+ * @running: Whether @p has been running since its last update.
+ *
+ * Account the time since @p's last update to its current window, closing
+ * that window and any that elapsed since then as needed.
+ */
+void update_task_ravg(struct task_struct *p, struct rq *rq, int running)
+{
+	u64 window = sysctl_sched_ravg_window;
+	u64 wallclock = rq->clock;
+	u64 window_end, nr_windows;
+	int i;
+
+	if (is_idle_task(p))
+		return;
+
+	if (unlikely(!p->ravg.window_start)) {
+		p->ravg.window_start = wallclock;
+		p->ravg.mark_start = wallclock;
+		return;
+	}
+
+	/* Runqueue clocks are not synchronized across cpus */
+	if (wallclock < p->ravg.mark_start)
+		wallclock = p->ravg.mark_start;
+
+	window_end = p->ravg.window_start + window;
+	if (wallclock < window_end) {
+		if (running)
+			p->ravg.sum += wallclock - p->ravg.mark_start;
+		p->ravg.mark_start = wallclock;
+		return;
+	}
+
+	if (running && window_end > p->ravg.mark_start)
+		p->ravg.sum += window_end - p->ravg.mark_start;
+	update_task_demand(p, rq, min_t(u64, p->ravg.sum, window));
+
+	nr_windows = div64_u64(wallclock - window_end, window);
+	for (i = 0; i < min_t(u64, nr_windows, RAVG_HIST_SIZE); i++)
+		update_task_demand(p, rq, running ? window : 0);
+
+	p->ravg.window_start = window_end + nr_windows * window;
+	p->ravg.sum = running ? wallclock - p->ravg.window_start : 0;
+	p->ravg.mark_start = wallclock;
+}
+
+void inc_cumulative_demand(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (flags & ENQUEUE_WAKEUP) {
+		update_task_ravg(p, rq, 0);
+		if (demand_is_significant(p))
+			rq->demand_notify = 1;
+	}
+
+	rq->cumulative_demand += p->ravg.demand;
+	p->ravg.accounted = 1;
+
+	if (demand_callbacks)
+		rq->demand_notify = 1;
+}
+
+void sched_demand_tick(struct rq *rq)
+{
+	update_task_ravg(rq->curr, rq, 1);
+
+	if (demand_callbacks)
+		rq->demand_notify = 1;
+}
+
+void dec_cumulative_demand(struct rq *rq, struct task_struct *p, int flags)
+{
+	if (!p->ravg.accounted)
+		return;
+
+	rq->cumulative_demand -= p->ravg.demand;
+	p->ravg.accounted = 0;
+
+	if (p->state == TASK_DEAD && demand_is_significant(p))
+		rq->demand_notify = 1;
+}
+
+/*
+ * @p's demand leaves its current cpu with the dequeue preceding this and
+ * is added to @new_cpu's when it is enqueued there; flag both for the
+ * governor if it is worth reporting.
+ */
+void sched_ravg_migrate(struct task_struct *p, unsigned int new_cpu)
+{
+	if (demand_is_significant(p)) {
+		cpu_rq(task_cpu(p))->demand_notify = 1;
+		cpu_rq(new_cpu)->demand_notify = 1;
+	}
+}
+
+/**
+ * sched_get_cpu_demand
+ * @cpu: The cpu whose demand is requested.
+ * @return: Sum of the demand of the tasks queued on @cpu, as a percentage
+ *	    of the window size. May exceed 100 with several busy tasks.
+ */
+unsigned int sched_get_cpu_demand(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+	u64 demand;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	demand = rq->cumulative_demand;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+
+	return (unsigned int)div64_u64(demand * 100, sysctl_sched_ravg_window);
+}
+EXPORT_SYMBOL(sched_get_cpu_demand);
+#endif /* CONFIG_SCHED_FREQ_INPUT */
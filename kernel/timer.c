@@ -40,6 +40,7 @@
 #include <linux/irq_work.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/moduleparam.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -750,6 +751,34 @@ int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
+/*
+ * Deferrable timers are fine with firing late, that's what the flag says.
+ * Push their expiry to the next multiple of timer_coalesce_jiffies, a grid
+ * shared by all CPUs, as long as that adds no more than a quarter of the
+ * requested delay.  Periodic deferrable timers armed on different CPUs then
+ * expire on the same tick instead of each cutting an idle period short.
+ */
+static unsigned int timer_coalesce_jiffies = DIV_ROUND_UP(HZ, 50);
+module_param_named(coalesce_jiffies, timer_coalesce_jiffies, uint, 0644);
+
+static inline bool
+coalesce_deferrable(struct timer_list *timer, unsigned long *expires)
+{
+	unsigned long grid = ACCESS_ONCE(timer_coalesce_jiffies);
+	unsigned long aligned;
+	long delta = *expires - jiffies;
+
+	if (grid <= 1 || delta <= 0 || !tbase_get_deferrable(timer->base))
+		return false;
+
+	aligned = *expires + (grid - *expires % grid) % grid;
+	if (aligned - *expires > delta / 4)
+		return false;
+
+	*expires = aligned;
+	return true;
+}
+
 /*
  * Decide where to put the timer while taking the slack into account
  *
@@ -766,6 +795,9 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	unsigned long expires_limit, mask;
 	int bit;
 
+	if (coalesce_deferrable(timer, &expires))
+		return expires;
+
 	if (timer->slack >= 0) {
 		expires_limit = expires + timer->slack;
 	} else {
@@ -846,6 +878,8 @@ EXPORT_SYMBOL(mod_timer);
  */
 int mod_timer_pinned(struct timer_list *timer, unsigned long expires)
 {
+	coalesce_deferrable(timer, &expires);
+
 	if (timer->expires == expires && timer_pending(timer))
 		return 1;
 
@@ -887,6 +921,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	unsigned long flags;
 
 	BUG_ON(timer_pending(timer) || !timer->function);
+	coalesce_deferrable(timer, &timer->expires);
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
 	debug_activate(timer, timer->expires);
@@ -8,6 +8,7 @@
 #include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/time.h>
+#include <linux/trace_flight.h>
 #include <asm/local.h>
 
 struct rb_page {
@@ -58,6 +59,12 @@ MODULE_PARM_DESC(producer_fifo, "fifo prio for producer");
 module_param(consumer_fifo, uint, 0644);
 MODULE_PARM_DESC(consumer_fifo, "fifo prio for consumer");
 
+#ifdef CONFIG_TRACE_FLIGHT_RECORDER
+static int flight_bench;
+module_param(flight_bench, uint, 0644);
+MODULE_PARM_DESC(flight_bench, "also time the flight recorder");
+#endif
+
 static int read_events;
 
 static int kill_test;
@@ -357,6 +364,56 @@ static void ring_buffer_producer(void)
 	}
 }
 
+#ifdef CONFIG_TRACE_FLIGHT_RECORDER
+/*
+ * Same hammer against the flight recorder, which has no reader and no
+ * reservation, for a per event cost comparison. It overwrites the flight
+ * recorder's history with marks.
+ */
+static void ring_buffer_flight_producer(void)
+{
+	struct timeval start_tv;
+	struct timeval end_tv;
+	unsigned long long time;
+	unsigned long hit = 0;
+	int cnt = 0;
+
+	trace_printk("Starting flight recorder hammer\n");
+	do_gettimeofday(&start_tv);
+	do {
+		int i;
+
+		for (i = 0; i < write_iteration; i++) {
+			trace_flight_record(FLIGHT_MARK, smp_processor_id(), i);
+			hit++;
+		}
+		do_gettimeofday(&end_tv);
+
+		cnt++;
+#ifndef CONFIG_PREEMPT
+		if (cnt % wakeup_interval)
+			cond_resched();
+#endif
+	} while (end_tv.tv_sec < (start_tv.tv_sec + RUN_TIME) && !kill_test);
+	trace_printk("End flight recorder hammer\n");
+
+	time = end_tv.tv_sec - start_tv.tv_sec;
+	time *= USEC_PER_SEC;
+	time += (long long)((long)end_tv.tv_usec - (long)start_tv.tv_usec);
+
+	trace_printk("Flight time: %lld (usecs)\n", time);
+	trace_printk("Flight hit:  %ld\n", hit);
+
+	do_div(time, USEC_PER_MSEC);
+	if (time)
+		hit /= (long)time;
+
+	trace_printk("Flight entries per millisec: %ld\n", hit);
+	if (hit)
+		trace_printk("%ld ns per flight entry\n", NSEC_PER_MSEC / hit);
+}
+#endif
+
 static void wait_to_die(void)
 {
 	set_current_state(TASK_INTERRUPTIBLE);
@@ -403,6 +460,10 @@ static int ring_buffer_producer_thread(void *arg)
 		}
 
 		ring_buffer_producer();
+#ifdef CONFIG_TRACE_FLIGHT_RECORDER
+		if (flight_bench)
+			ring_buffer_flight_producer();
+#endif
 
 		trace_printk("Sleeping for 10 secs\n");
 		set_current_state(TASK_INTERRUPTIBLE);
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Flight recorder: an always-on, per-CPU overwrite ring of the last few
+ * scheduler, irq, cpufreq and block events. Events have a fixed 16 byte
+ * format and are written straight from the tracepoint probes with
+ * interrupts off: no ring_buffer reservation, no event filters and no
+ * string formatting. The ring is decoded only when it is read from
+ * debugfs, when a driver or userspace reports a jank with
+ * trace_flight_trigger(), or on a panic or oops. In the panic/oops case
+ * it is printed from a kmsg dumper registered ahead of pstore's, so it
+ * ends up in the pstore record of the crash.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/interrupt.h>
+#include <linux/blkdev.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/kmsg_dump.h>
+#include <linux/trace_flight.h>
+#include <trace/events/sched.h>
+#include <trace/events/irq.h>
+#include <trace/events/power.h>
+#include <trace/events/block.h>
+#include "trace.h"
+
+#define FLIGHT_ENTRIES		1024	/* per CPU, power of 2 */
+#define FLIGHT_TYPE_BITS	8
+
+struct flight_entry {
+	u64 ts_type;		/* local_clock() << FLIGHT_TYPE_BITS | type */
+	u32 a;
+	u32 b;
+};
+
+struct flight_cpu {
+	unsigned int head;
+	struct flight_entry ents[FLIGHT_ENTRIES];
+};
+
+static DEFINE_PER_CPU(struct flight_cpu, flight_cpus);
+
+static bool flight_enabled = true;
+static bool flight_recording __read_mostly;
+static DEFINE_MUTEX(flight_lock);
+
+/* Entries per CPU printed to the kernel log on a trigger or a crash */
+static unsigned int dump_entries = 64;
+module_param(dump_entries, uint, 0644);
+
+static int __init flight_setup(char *str)
+{
+	return !strtobool(str, &flight_enabled);
+}
+__setup("flight_recorder=", flight_setup);
+
+static const char * const flight_event_names[FLIGHT_EVENT_MAX] = {
+	[FLIGHT_SCHED_SWITCH] = "sched_switch",
+	[FLIGHT_IRQ_ENTRY] = "irq_entry",
+	[FLIGHT_IRQ_EXIT] = "irq_exit",
+	[FLIGHT_CPU_FREQ] = "cpu_freq",
+	[FLIGHT_BLOCK_ISSUE] = "block_issue",
+	[FLIGHT_BLOCK_COMPLETE] = "block_complete",
+	[FLIGHT_MARK] = "mark",
+};
+
+/**
+ * trace_flight_record() - Append an event to this CPU's flight recorder
+ * @type: Event type
+ * @a: First event argument, see enum flight_event
+ * @b: Second event argument, see enum flight_event
+ */
+void trace_flight_record(enum flight_event type, u32 a, u32 b)
+{
+	struct flight_cpu *fc;
+	struct flight_entry *e;
+	unsigned long flags;
+
+	if (!flight_recording)
+		return;
+
+	local_irq_save(flags);
+	fc = &__get_cpu_var(flight_cpus);
+	e = &fc->ents[fc->head++ & (FLIGHT_ENTRIES - 1)];
+	e->ts_type = (local_clock() << FLIGHT_TYPE_BITS) | type;
+	e->a = a;
+	e->b = b;
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(trace_flight_record);
+
+static void probe_sched_switch(void *ignore, struct task_struct *prev,
+			       struct task_struct *next)
+{
+	trace_flight_record(FLIGHT_SCHED_SWITCH, prev->pid,
+			    next->pid | (prev->state & 0xff) << 24);
+}
+
+static void probe_irq_entry(void *ignore, int irq, struct irqaction *action)
+{
+	trace_flight_record(FLIGHT_IRQ_ENTRY, irq, 0);
+}
+
+static void probe_irq_exit(void *ignore, int irq, struct irqaction *action,
+			   int ret)
+{
+	trace_flight_record(FLIGHT_IRQ_EXIT, irq, ret);
+}
+
+static void probe_cpu_frequency(void *ignore, unsigned int frequency,
+				unsigned int cpu)
+{
+	trace_flight_record(FLIGHT_CPU_FREQ, frequency, cpu);
+}
+
+#ifdef CONFIG_BLOCK
+static u32 flight_rq_bytes(struct request *rq, unsigned int bytes)
+{
+	return (bytes & ~BIT(31)) | (rq_data_dir(rq) == WRITE ? BIT(31) : 0);
+}
+
+static void probe_block_rq_issue(void *ignore, struct request_queue *q,
+				 struct request *rq)
+{
+	trace_flight_record(FLIGHT_BLOCK_ISSUE, blk_rq_pos(rq),
+			    flight_rq_bytes(rq, blk_rq_bytes(rq)));
+}
+
+static void probe_block_rq_complete(void *ignore, struct request_queue *q,
+				    struct request *rq, unsigned int nr_bytes)
+{
+	trace_flight_record(FLIGHT_BLOCK_COMPLETE, blk_rq_pos(rq),
+			    flight_rq_bytes(rq, nr_bytes));
+}
+
+static int flight_register_block(void)
+{
+	int ret;
+
+	ret = register_trace_block_rq_issue(probe_block_rq_issue, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_block_rq_complete(probe_block_rq_complete, NULL);
+	if (ret)
+		unregister_trace_block_rq_issue(probe_block_rq_issue, NULL);
+
+	return ret;
+}
+
+static void flight_unregister_block(void)
+{
+	unregister_trace_block_rq_complete(probe_block_rq_complete, NULL);
+	unregister_trace_block_rq_issue(probe_block_rq_issue, NULL);
+}
+#else
+static inline int flight_register_block(void)
+{
+	return 0;
+}
+
+static inline void flight_unregister_block(void)
+{
+}
+#endif
+
+static void flight_unregister(void)
+{
+	flight_unregister_block();
+	unregister_trace_cpu_frequency(probe_cpu_frequency, NULL);
+	unregister_trace_irq_handler_exit(probe_irq_exit, NULL);
+	unregister_trace_irq_handler_entry(probe_irq_entry, NULL);
+	unregister_trace_sched_switch(probe_sched_switch, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static int flight_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_switch(probe_sched_switch, NULL);
+	if (ret)
+		return ret;
+	ret = register_trace_irq_handler_entry(probe_irq_entry, NULL);
+	if (ret)
+		goto err_entry;
+	ret = register_trace_irq_handler_exit(probe_irq_exit, NULL);
+	if (ret)
+		goto err_exit;
+	ret = register_trace_cpu_frequency(probe_cpu_frequency, NULL);
+	if (ret)
+		goto err_freq;
+	ret = flight_register_block();
+	if (ret)
+		goto err_block;
+
+	return 0;
+
+err_block:
+	unregister_trace_cpu_frequency(probe_cpu_frequency, NULL);
+err_freq:
+	unregister_trace_irq_handler_exit(probe_irq_exit, NULL);
+err_exit:
+	unregister_trace_irq_handler_entry(probe_irq_entry, NULL);
+err_entry:
+	unregister_trace_sched_switch(probe_sched_switch, NULL);
+	return ret;
+}
+
+static void flight_format(char *buf, size_t size, int cpu,
+			  struct flight_entry *e)
+{
+	unsigned int type = e->ts_type & (BIT(FLIGHT_TYPE_BITS) - 1);
+	u64 ts = e->ts_type >> FLIGHT_TYPE_BITS;
+	unsigned long rem = do_div(ts, NSEC_PER_SEC);
+
+	snprintf(buf, size, "[%d] %5llu.%06lu %s %u %u", cpu, ts,
+		 rem / NSEC_PER_USEC, type < FLIGHT_EVENT_MAX ?
+		 flight_event_names[type] : "?", e->a, e->b);
+}
+
+/*
+ * Index of the oldest of the newest @max entries of @fc. The ring is only
+ * walked while recording is stopped or from the debugfs reader, where a
+ * few entries torn by concurrent writers are acceptable.
+ */
+static unsigned int flight_first(struct flight_cpu *fc, unsigned int max)
+{
+	max = min_t(unsigned int, max, FLIGHT_ENTRIES);
+
+	return fc->head - min(fc->head, max);
+}
+
+static void flight_dump_log(const char *reason)
+{
+	struct flight_cpu *fc;
+	char line[80];
+	unsigned int i;
+	int cpu;
+
+	pr_info("flight recorder dump (%s)\n", reason);
+	for_each_possible_cpu(cpu) {
+		fc = &per_cpu(flight_cpus, cpu);
+		for (i = flight_first(fc, dump_entries); i != fc->head; i++) {
+			flight_format(line, sizeof(line), cpu,
+				      &fc->ents[i & (FLIGHT_ENTRIES - 1)]);
+			pr_info("%s\n", line);
+		}
+	}
+}
+
+/**
+ * trace_flight_trigger() - Freeze the flight recorder and log its contents
+ * @reason: Short description of the trigger, printed with the dump
+ *
+ * Recording stops so the events leading up to the trigger stay in the
+ * ring for a later read of debugfs tracing/flight_recorder/events. Writing
+ * 1 to tracing/flight_recorder/enable restarts it.
+ */
+void trace_flight_trigger(const char *reason)
+{
+	if (!flight_recording)
+		return;
+
+	flight_recording = false;
+	flight_dump_log(reason);
+}
+EXPORT_SYMBOL_GPL(trace_flight_trigger);
+
+static void flight_kmsg_dump(struct kmsg_dumper *dumper,
+			     enum kmsg_dump_reason reason)
+{
+	flight_recording = false;
+	flight_dump_log(reason == KMSG_DUMP_PANIC ? "panic" : "oops");
+}
+
+/* Registered before any pstore backend, so its output is in their dump */
+static struct kmsg_dumper flight_dumper = {
+	.dump = flight_kmsg_dump,
+	.max_reason = KMSG_DUMP_OOPS,
+};
+
+static int flight_set_enabled(bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&flight_lock);
+	if (enable && !flight_enabled) {
+		ret = flight_register();
+		if (ret)
+			goto out;
+	} else if (!enable && flight_enabled) {
+		flight_recording = false;
+		flight_unregister();
+	}
+	flight_enabled = enable;
+	flight_recording = enable;
+out:
+	mutex_unlock(&flight_lock);
+	return ret;
+}
+
+static int flight_enable_get(void *data, u64 *val)
+{
+	*val = flight_recording;
+	return 0;
+}
+
+static int flight_enable_set(void *data, u64 val)
+{
+	return flight_set_enabled(!!val);
+}
+DEFINE_SIMPLE_ATTRIBUTE(flight_enable_fops, flight_enable_get,
+			flight_enable_set, "%llu\n");
+
+static ssize_t flight_trigger_write(struct file *file,
+		const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	char reason[32];
+	size_t len = min(count, sizeof(reason) - 1);
+
+	if (copy_from_user(reason, user_buf, len))
+		return -EFAULT;
+	reason[len] = '\0';
+	strim(reason);
+
+	trace_flight_trigger(reason);
+
+	return count;
+}
+
+static const struct file_operations flight_trigger_fops = {
+	.write = flight_trigger_write,
+};
+
+static int flight_events_show(struct seq_file *s, void *unused)
+{
+	struct flight_cpu *fc;
+	char line[80];
+	unsigned int i;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		fc = &per_cpu(flight_cpus, cpu);
+		for (i = flight_first(fc, FLIGHT_ENTRIES); i != fc->head; i++) {
+			flight_format(line, sizeof(line), cpu,
+				      &fc->ents[i & (FLIGHT_ENTRIES - 1)]);
+			seq_printf(s, "%s\n", line);
+		}
+	}
+
+	return 0;
+}
+
+static int flight_events_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, flight_events_show, inode->i_private);
+}
+
+static const struct file_operations flight_events_fops = {
+	.open = flight_events_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init trace_flight_init(void)
+{
+	int ret;
+
+	kmsg_dump_register(&flight_dumper);
+
+	if (!flight_enabled)
+		return 0;
+
+	ret = flight_register();
+	if (ret) {
+		pr_err("flight recorder: unable to register probes: %d\n", ret);
+		flight_enabled = false;
+		return 0;
+	}
+	flight_recording = true;
+
+	return 0;
+}
+core_initcall(trace_flight_init);
+
+static int __init trace_flight_debugfs_init(void)
+{
+	struct dentry *d_tracer = tracing_init_dentry();
+	struct dentry *dir;
+
+	if (!d_tracer)
+		return 0;
+
+	dir = debugfs_create_dir("flight_recorder", d_tracer);
+	if (!dir)
+		return 0;
+
+	debugfs_create_file("enable", S_IRUGO | S_IWUSR, dir, NULL,
+			    &flight_enable_fops);
+	debugfs_create_file("trigger", S_IWUSR, dir, NULL,
+			    &flight_trigger_fops);
+	debugfs_create_file("events", S_IRUSR, dir, NULL,
+			    &flight_events_fops);
+
+	return 0;
+}
+fs_initcall(trace_flight_debugfs_init);
@@ -42,6 +42,9 @@
 #include <linux/lockdep.h>
 #include <linux/idr.h>
 #include <linux/bug.h>
+#include <linux/moduleparam.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -198,6 +201,13 @@ struct cpu_workqueue_struct {
 	int			nr_active;	/* L: nr of active works */
 	int			max_active;	/* L: max active works */
 	struct list_head	delayed_works;	/* L: delayed works */
+#ifdef CONFIG_WORKQUEUE_STATS
+	u64			nr_executed;	/* L: executed works */
+	u64			lat_total;	/* L: queue to start, ns */
+	u64			lat_max;	/* L: longest queue to start */
+	u64			exec_total;	/* L: execution time, ns */
+	u64			exec_max;	/* L: longest execution */
+#endif
 };
 
 /*
@@ -268,12 +278,59 @@ struct workqueue_struct *system_nrt_wq __read_mostly;
 struct workqueue_struct *system_unbound_wq __read_mostly;
 struct workqueue_struct *system_freezable_wq __read_mostly;
 struct workqueue_struct *system_nrt_freezable_wq __read_mostly;
+struct workqueue_struct *system_power_efficient_wq __read_mostly;
+struct workqueue_struct *system_freezable_power_efficient_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_wq);
 EXPORT_SYMBOL_GPL(system_long_wq);
 EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
 EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
+EXPORT_SYMBOL_GPL(system_power_efficient_wq);
+EXPORT_SYMBOL_GPL(system_freezable_power_efficient_wq);
+
+/* see the comment above the definition of WQ_POWER_EFFICIENT */
+static bool wq_power_efficient = IS_ENABLED(CONFIG_WQ_POWER_EFFICIENT_DEFAULT);
+module_param_named(power_efficient, wq_power_efficient, bool, 0444);
+
+#ifdef CONFIG_WORKQUEUE_STATS
+static inline u64 wq_stats_clock(void)
+{
+	return local_clock();
+}
+
+static inline void work_stamp_queued(struct work_struct *work)
+{
+	work->queued = local_clock();
+}
+
+static inline u64 work_queued_time(struct work_struct *work)
+{
+	return work->queued;
+}
+
+/* called with gcwq->lock held */
+static void cwq_account_work(struct cpu_workqueue_struct *cwq, u64 queued,
+			     u64 start, u64 end)
+{
+	u64 lat = start > queued ? start - queued : 0;
+	u64 exec = end - start;
+
+	cwq->nr_executed++;
+	cwq->lat_total += lat;
+	cwq->exec_total += exec;
+	if (lat > cwq->lat_max)
+		cwq->lat_max = lat;
+	if (exec > cwq->exec_max)
+		cwq->exec_max = exec;
+}
+#else
+static inline u64 wq_stats_clock(void) { return 0; }
+static inline void work_stamp_queued(struct work_struct *work) { }
+static inline u64 work_queued_time(struct work_struct *work) { return 0; }
+static inline void cwq_account_work(struct cpu_workqueue_struct *cwq,
+				    u64 queued, u64 start, u64 end) { }
+#endif
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -936,6 +993,7 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+	work_stamp_queued(work);
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -1841,6 +1899,7 @@ __acquires(&gcwq->lock)
 	bool cpu_intensive = cwq->wq->flags & WQ_CPU_INTENSIVE;
 	int work_color;
 	struct worker *collision;
+	u64 queued, start, end;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -1889,6 +1948,10 @@ __acquires(&gcwq->lock)
 	if ((worker->flags & WORKER_UNBOUND) && need_more_worker(pool))
 		wake_up_worker(pool);
 
+	/* @work may be queued again once PENDING is cleared */
+	queued = work_queued_time(work);
+	start = wq_stats_clock();
+
 	spin_unlock_irq(&gcwq->lock);
 
 	smp_wmb();	/* paired with test_and_set_bit(PENDING) */
@@ -1903,6 +1966,7 @@ __acquires(&gcwq->lock)
 	 * point will only record its address.
 	 */
 	trace_workqueue_execute_end(work);
+	end = wq_stats_clock();
 	lock_map_release(&lockdep_map);
 	lock_map_release(&cwq->wq->lockdep_map);
 
@@ -1931,6 +1995,8 @@ __acquires(&gcwq->lock)
 	if (unlikely(cpu_intensive))
 		worker_clr_flags(worker, WORKER_CPU_INTENSIVE);
 
+	cwq_account_work(cwq, queued, start, end);
+
 	/* we're done with it, release */
 	hlist_del_init(&worker->hentry);
 	worker->current_work = NULL;
@@ -3031,6 +3097,9 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 	if (flags & WQ_MEM_RECLAIM)
 		flags |= WQ_RESCUER;
 
+	if ((flags & WQ_POWER_EFFICIENT) && wq_power_efficient)
+		flags |= WQ_UNBOUND;
+
 	max_active = max_active ?: WQ_DFL_ACTIVE;
 	max_active = wq_clamp_max_active(max_active, flags, wq->name);
 
@@ -3914,7 +3983,80 @@ out_unlock:
 }
 #endif /* CONFIG_FREEZER */
 
-static int __init init_workqueues(void)
+#if defined(CONFIG_WORKQUEUE_STATS) && defined(CONFIG_DEBUG_FS)
+static int wq_stats_show(struct seq_file *m, void *unused)
+{
+	struct workqueue_struct *wq;
+	unsigned int cpu;
+
+	seq_puts(m, "# workqueue cpu executed lat_avg_us lat_max_us "
+		 "exec_avg_us exec_max_us\n");
+
+	spin_lock_irq(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list) {
+		for_each_cwq_cpu(cpu, wq) {
+			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+			struct global_cwq *gcwq = cwq->pool->gcwq;
+			u64 nr, lat, lat_max, exec, exec_max;
+
+			spin_lock(&gcwq->lock);
+			nr = cwq->nr_executed;
+			lat = cwq->lat_total;
+			lat_max = cwq->lat_max;
+			exec = cwq->exec_total;
+			exec_max = cwq->exec_max;
+			spin_unlock(&gcwq->lock);
+
+			if (!nr)
+				continue;
+
+			seq_printf(m, "%s ", wq->name);
+			if (cpu == WORK_CPU_UNBOUND)
+				seq_puts(m, "unbound");
+			else
+				seq_printf(m, "%u", cpu);
+			seq_printf(m, " %llu %llu %llu %llu %llu\n", nr,
+				   div64_u64(lat, nr * NSEC_PER_USEC),
+				   div_u64(lat_max, NSEC_PER_USEC),
+				   div64_u64(exec, nr * NSEC_PER_USEC),
+				   div_u64(exec_max, NSEC_PER_USEC));
+		}
+	}
+	spin_unlock_irq(&workqueue_lock);
+
+	return 0;
+}
+
+static int wq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_stats_show, NULL);
+}
+
+static const struct file_operations wq_stats_fops = {
+	.open		= wq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_stats_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("workqueue", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("stats", 0444, dir, NULL, &wq_stats_fops)) {
+		debugfs_remove(dir);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(wq_stats_init);
+#endif
+
 {
 	unsigned int cpu;
 	int i;
@@ -3981,9 +4123,15 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	system_nrt_freezable_wq = alloc_workqueue("events_nrt_freezable",
 			WQ_NON_REENTRANT | WQ_FREEZABLE, 0);
+	system_power_efficient_wq = alloc_workqueue("events_power_efficient",
+					      WQ_POWER_EFFICIENT, 0);
+	system_freezable_power_efficient_wq = alloc_workqueue("events_freezable_power_efficient",
+					      WQ_FREEZABLE | WQ_POWER_EFFICIENT,
+					      0);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
-		!system_nrt_freezable_wq);
+		!system_nrt_freezable_wq || !system_power_efficient_wq ||
+		!system_freezable_power_efficient_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
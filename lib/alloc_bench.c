@@ -0,0 +1,488 @@
+/*
+ * Memory allocator benchmarks
+ *
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Every scenario is a file in debugfs alloc_bench/ and reading it runs
+ * the scenario. Allocators time up to "iterations" allocations of each
+ * size, capped at "max_bytes" held at once, then the frees. The zram
+ * scenario writes and reads back "zram_pages" pages of the device named
+ * by "zram_dev", each page "zram_random_pct" percent random (and so
+ * roughly that compressible). The device must not be in use, the
+ * benchmark overwrites it. Throughput and latency percentiles are
+ * reported for every pass.
+ *
+ * Drivers with allocators of their own register them with
+ * alloc_bench_register().
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/completion.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/sizes.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/zsmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/alloc_bench.h>
+#ifdef CONFIG_ION
+#include <linux/ion.h>
+#include <linux/msm_ion.h>
+#endif
+
+static unsigned int iterations = 1024;
+module_param(iterations, uint, 0644);
+
+static unsigned int max_bytes = 32 * 1024 * 1024;
+module_param(max_bytes, uint, 0644);
+
+static char *zram_dev;
+module_param(zram_dev, charp, 0644);
+
+static unsigned int zram_pages = 4096;
+module_param(zram_pages, uint, 0644);
+
+static unsigned int zram_random_pct = 25;
+module_param(zram_random_pct, uint, 0644);
+
+static const size_t bench_default_sizes[] = {
+	SZ_4K, SZ_64K, SZ_1M, 0,
+};
+
+/* Only one benchmark runs at a time, so the numbers don't interfere */
+static DEFINE_MUTEX(bench_mutex);
+static struct dentry *bench_dent;
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *) a, y = *(const u32 *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_header(struct seq_file *s)
+{
+	seq_printf(s, "%-6s %8s %6s %8s %8s %8s %8s %8s %8s\n",
+		   "op", "size", "count", "ops/s", "MB/s",
+		   "p50 ns", "p90 ns", "p99 ns", "max ns");
+}
+
+/* Sorts @ns */
+static void bench_report(struct seq_file *s, const char *op, size_t size,
+			 u32 *ns, unsigned int count)
+{
+	u64 total = 0;
+	unsigned int i;
+
+	if (!count)
+		return;
+
+	for (i = 0; i < count; i++)
+		total += ns[i];
+	total = max_t(u64, total, 1);
+
+	sort(ns, count, sizeof(*ns), bench_cmp, NULL);
+
+	seq_printf(s, "%-6s %8zu %6u %8llu %8llu %8u %8u %8u %8u\n",
+		   op, size, count,
+		   div64_u64((u64) count * NSEC_PER_SEC, total),
+		   div64_u64((u64) count * size * 1000, total),
+		   ns[count / 2], ns[count * 9 / 10], ns[count * 99 / 100],
+		   ns[count - 1]);
+}
+
+static int bench_run_ops(struct seq_file *s, struct alloc_bench_ops *ops)
+{
+	const size_t *size = ops->sizes ? ops->sizes : bench_default_sizes;
+	unsigned int max_count = iterations;
+	unsigned long *cookies;
+	void *priv = NULL;
+	u32 *ns;
+	int ret = 0;
+
+	if (!max_count)
+		return -EINVAL;
+
+	cookies = vmalloc(max_count * sizeof(*cookies));
+	ns = vmalloc(max_count * sizeof(*ns));
+	if (!cookies || !ns) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (ops->setup) {
+		ret = ops->setup(&priv);
+		if (ret)
+			goto out;
+	}
+
+	bench_header(s);
+	for (; *size; size++) {
+		unsigned int i, n, count;
+		ktime_t start;
+
+		count = min_t(size_t, max_count, max_t(size_t,
+						       max_bytes / *size, 1));
+
+		for (n = 0; n < count; n++) {
+			start = ktime_get();
+			ret = ops->alloc(priv, *size, &cookies[n]);
+			ns[n] = ktime_to_ns(ktime_sub(ktime_get(), start));
+			if (ret)
+				break;
+			cond_resched();
+		}
+		bench_report(s, "alloc", *size, ns, n);
+
+		for (i = 0; i < n; i++) {
+			start = ktime_get();
+			ops->free(priv, cookies[i]);
+			ns[i] = ktime_to_ns(ktime_sub(ktime_get(), start));
+			cond_resched();
+		}
+		bench_report(s, "free", *size, ns, n);
+
+		if (ret) {
+			seq_printf(s, "allocation %u of %zu failed: %d\n",
+				   n + 1, *size, ret);
+			ret = 0;
+			break;
+		}
+	}
+
+	if (ops->teardown)
+		ops->teardown(priv);
+out:
+	vfree(ns);
+	vfree(cookies);
+	return ret;
+}
+
+static int zs_bench_setup(void **priv)
+{
+	struct zs_pool *pool;
+
+	/* The same flags zram uses for its pool */
+	pool = zs_create_pool("alloc_bench", GFP_NOIO | __GFP_HIGHMEM);
+	if (!pool)
+		return -ENOMEM;
+
+	*priv = pool;
+	return 0;
+}
+
+static void zs_bench_teardown(void *priv)
+{
+	zs_destroy_pool(priv);
+}
+
+static int zs_bench_alloc(void *priv, size_t size, unsigned long *cookie)
+{
+	*cookie = zs_malloc(priv, size);
+
+	return *cookie ? 0 : -ENOMEM;
+}
+
+static void zs_bench_free(void *priv, unsigned long cookie)
+{
+	zs_free(priv, cookie);
+}
+
+static const size_t zs_bench_sizes[] = {
+	32, 64, 128, 256, 512, 1024, 2048, 3072, PAGE_SIZE, 0,
+};
+
+static struct alloc_bench_ops zs_bench_ops = {
+	.name = "zsmalloc",
+	.setup = zs_bench_setup,
+	.teardown = zs_bench_teardown,
+	.alloc = zs_bench_alloc,
+	.free = zs_bench_free,
+	.sizes = zs_bench_sizes,
+};
+
+#ifdef CONFIG_ION
+static unsigned int ion_flags;
+module_param(ion_flags, uint, 0644);
+
+static int ion_bench_setup(void **priv)
+{
+	struct ion_client *client;
+
+	client = msm_ion_client_create(-1, "alloc_bench");
+	if (IS_ERR_OR_NULL(client))
+		return client ? PTR_ERR(client) : -ENOMEM;
+
+	*priv = client;
+	return 0;
+}
+
+static void ion_bench_teardown(void *priv)
+{
+	ion_client_destroy(priv);
+}
+
+static int ion_bench_alloc(void *priv, size_t size, unsigned long *cookie)
+{
+	struct ion_handle *handle;
+
+	handle = ion_alloc(priv, size, PAGE_SIZE,
+			   ION_HEAP(ION_SYSTEM_HEAP_ID), ion_flags);
+	if (IS_ERR_OR_NULL(handle))
+		return handle ? PTR_ERR(handle) : -ENOMEM;
+
+	*cookie = (unsigned long) handle;
+	return 0;
+}
+
+static void ion_bench_free(void *priv, unsigned long cookie)
+{
+	ion_free(priv, (struct ion_handle *) cookie);
+}
+
+static struct alloc_bench_ops ion_bench_ops = {
+	.name = "ion_system_heap",
+	.setup = ion_bench_setup,
+	.teardown = ion_bench_teardown,
+	.alloc = ion_bench_alloc,
+	.free = ion_bench_free,
+};
+#endif
+
+struct bench_bio {
+	struct completion done;
+	int error;
+};
+
+static void bench_end_io(struct bio *bio, int error)
+{
+	struct bench_bio *b = bio->bi_private;
+
+	b->error = error;
+	complete(&b->done);
+}
+
+/* Returns the time the I/O took in ns, or a negative error code */
+static s64 bench_page_io(struct block_device *bdev, int rw,
+			 struct page *page, sector_t sector)
+{
+	struct bench_bio b;
+	struct bio *bio;
+	ktime_t start;
+	s64 ns;
+
+	bio = bio_alloc(GFP_KERNEL, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	init_completion(&b.done);
+	bio->bi_bdev = bdev;
+	bio->bi_sector = sector;
+	bio->bi_end_io = bench_end_io;
+	bio->bi_private = &b;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+
+	start = ktime_get();
+	submit_bio(rw | REQ_SYNC, bio);
+	wait_for_completion(&b.done);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	bio_put(bio);
+	return b.error ? b.error : ns;
+}
+
+static void bench_fill_page(struct page *page, unsigned int random_pct)
+{
+	u32 *p = kmap(page);
+	unsigned int i, nr = PAGE_SIZE / sizeof(*p) * random_pct / 100;
+
+	for (i = 0; i < nr; i++)
+		p[i] = prandom_u32();
+	memset(p + nr, 0, PAGE_SIZE - nr * sizeof(*p));
+	kunmap(page);
+}
+
+static int bench_run_zram(struct seq_file *s)
+{
+	const fmode_t mode = FMODE_READ | FMODE_WRITE | FMODE_EXCL;
+	unsigned int random_pct = min(zram_random_pct, 100U);
+	struct block_device *bdev;
+	struct page *page;
+	unsigned int i, n, count;
+	u32 *ns = NULL;
+	s64 ret = 0;
+
+	if (!zram_dev || !*zram_dev) {
+		seq_puts(s, "set the zram_dev parameter to an unused device\n");
+		return 0;
+	}
+
+	/* Exclusive, so that a zram device used for swap is refused */
+	bdev = blkdev_get_by_path(zram_dev, mode, &zram_dev);
+	if (IS_ERR(bdev)) {
+		seq_printf(s, "cannot open %s: %ld\n", zram_dev,
+			   PTR_ERR(bdev));
+		return 0;
+	}
+
+	count = min_t(u64, zram_pages,
+		      i_size_read(bdev->bd_inode) >> PAGE_SHIFT);
+	page = alloc_page(GFP_KERNEL);
+	if (count)
+		ns = vmalloc(count * sizeof(*ns));
+	if (!page || !ns) {
+		ret = count ? -ENOMEM : -ENOSPC;
+		goto out;
+	}
+
+	bench_header(s);
+
+	for (n = 0; n < count; n++) {
+		bench_fill_page(page, random_pct);
+		ret = bench_page_io(bdev, WRITE, page,
+				    (sector_t) n << (PAGE_SHIFT - 9));
+		if (ret < 0)
+			break;
+		ns[n] = ret;
+		cond_resched();
+	}
+	bench_report(s, "write", PAGE_SIZE, ns, n);
+
+	for (i = 0; i < n; i++) {
+		ret = bench_page_io(bdev, READ, page,
+				    (sector_t) i << (PAGE_SHIFT - 9));
+		if (ret < 0)
+			break;
+		ns[i] = ret;
+		cond_resched();
+	}
+	bench_report(s, "read", PAGE_SIZE, ns, i);
+
+out:
+	if (ret < 0)
+		seq_printf(s, "zram benchmark failed: %lld\n", ret);
+	vfree(ns);
+	if (page)
+		__free_page(page);
+	blkdev_put(bdev, mode);
+	return 0;
+}
+
+static int bench_show(struct seq_file *s, void *unused)
+{
+	struct alloc_bench_ops *ops = s->private;
+	int ret;
+
+	mutex_lock(&bench_mutex);
+	if (ops)
+		ret = bench_run_ops(s, ops);
+	else
+		ret = bench_run_zram(s);
+	mutex_unlock(&bench_mutex);
+
+	return ret;
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_show, inode->i_private);
+}
+
+static const struct file_operations bench_fops = {
+	.open = bench_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Called with bench_mutex held */
+static struct dentry *bench_get_dir(void)
+{
+	if (!bench_dent)
+		bench_dent = debugfs_create_dir("alloc_bench", NULL);
+
+	return bench_dent;
+}
+
+/**
+ * alloc_bench_register() - Add an allocator benchmark
+ * @ops: The allocator to time
+ *
+ * Creates the debugfs file alloc_bench/@ops->name, which runs the
+ * benchmark when read.
+ */
+int alloc_bench_register(struct alloc_bench_ops *ops)
+{
+	struct dentry *dir;
+	int ret = 0;
+
+	mutex_lock(&bench_mutex);
+	dir = bench_get_dir();
+	if (!IS_ERR_OR_NULL(dir))
+		ops->dent = debugfs_create_file(ops->name, 0400, dir, ops,
+						&bench_fops);
+	if (IS_ERR_OR_NULL(dir) || !ops->dent) {
+		pr_err("unable to create the %s benchmark\n", ops->name);
+		ops->dent = NULL;
+		ret = -ENOMEM;
+	}
+	mutex_unlock(&bench_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(alloc_bench_register);
+
+/**
+ * alloc_bench_unregister() - Remove an allocator benchmark
+ * @ops: The allocator passed to alloc_bench_register()
+ */
+void alloc_bench_unregister(struct alloc_bench_ops *ops)
+{
+	mutex_lock(&bench_mutex);
+	debugfs_remove(ops->dent);
+	ops->dent = NULL;
+	mutex_unlock(&bench_mutex);
+}
+EXPORT_SYMBOL(alloc_bench_unregister);
+
+static int __init alloc_bench_init(void)
+{
+	struct dentry *dir;
+
+	alloc_bench_register(&zs_bench_ops);
+#ifdef CONFIG_ION
+	alloc_bench_register(&ion_bench_ops);
+#endif
+
+	mutex_lock(&bench_mutex);
+	dir = bench_get_dir();
+	if (!IS_ERR_OR_NULL(dir))
+		debugfs_create_file("zram", 0400, dir, NULL, &bench_fops);
+	mutex_unlock(&bench_mutex);
+
+	return 0;
+}
+late_initcall(alloc_bench_init);
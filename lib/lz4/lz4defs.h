@@ -25,9 +25,7 @@
 typedef struct _U16_S { u16 v; } U16_S;
 typedef struct _U32_S { u32 v; } U32_S;
 typedef struct _U64_S { u64 v; } U64_S;
-#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)		\
-	|| defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6	\
-	&& defined(ARM_EFFICIENT_UNALIGNED_ACCESS)
+#if defined(CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS)
 
 #define A16(x) (((U16_S *)(x))->v)
 #define A32(x) (((U32_S *)(x))->v)
@@ -40,6 +38,29 @@ typedef struct _U64_S { u64 v; } U64_S;
 		A16(p) = v; \
 		p += 2; \
 	} while (0)
+#elif defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6
+/*
+ * ARMv6 and later load and store unaligned words in hardware, but the
+ * ARM get_unaligned() always goes a byte at a time.  Packed accesses let
+ * the compiler use single ldr/str without ever emitting the ldrd/ldm
+ * forms that would trap on an unaligned address.
+ */
+#include <linux/unaligned/packed_struct.h>
+
+#define A64(x) __get_unaligned_cpu64(x)
+#define A32(x) __get_unaligned_cpu32(x)
+#define A16(x) __get_unaligned_cpu16(x)
+
+#define PUT4(s, d) \
+	__put_unaligned_cpu32(__get_unaligned_cpu32(s), d)
+#define PUT8(s, d) \
+	__put_unaligned_cpu64(__get_unaligned_cpu64(s), d)
+
+#define LZ4_WRITE_LITTLEENDIAN_16(p, v)	\
+	do {	\
+		__put_unaligned_cpu16(v, p); \
+		p += 2; \
+	} while (0)
 #else /* CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS */
 
 #define A64(x) get_unaligned((u64 *)&(((U16_S *)(x))->v))
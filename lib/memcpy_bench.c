@@ -0,0 +1,167 @@
+/*
+ * memcpy() throughput microbenchmark
+ *
+ * Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Times memcpy(), and the NEON capable memcpy_large() where the platform
+ * provides one, for a range of sizes with aligned and misaligned sources.
+ * The results are printed when the benchmark is initialised (at boot when
+ * built in) and again on every read of debugfs memcpy_bench.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/gfp.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#ifdef CONFIG_ARCH_MSM
+#include <mach/memutils.h>
+#endif
+
+#define BENCH_ORDER	6			/* 256KB buffers */
+#define BENCH_BYTES	(16 * 1024 * 1024)	/* copied per measurement */
+
+struct bench_fn {
+	const char *name;
+	void *(*copy)(void *dest, const void *src, size_t n);
+};
+
+static void *bench_memcpy(void *dest, const void *src, size_t n)
+{
+	return memcpy(dest, src, n);
+}
+
+#ifdef CONFIG_ARCH_MSM
+static void *bench_memcpy_large(void *dest, const void *src, size_t n)
+{
+	return memcpy_large(dest, src, n);
+}
+#endif
+
+static const struct bench_fn bench_fns[] = {
+	{ "memcpy", bench_memcpy },
+#ifdef CONFIG_ARCH_MSM
+	{ "memcpy_large", bench_memcpy_large },
+#endif
+};
+
+static const size_t bench_sizes[] = {
+	64, 256, 1024, 4096, 16384, 65536, 131072,
+};
+
+static struct dentry *bench_dent;
+
+/* Returns the throughput in MB/s */
+static u64 bench_one(const struct bench_fn *fn, char *dst, const char *src,
+		     size_t size)
+{
+	unsigned int i, loops = max_t(size_t, BENCH_BYTES / size, 1);
+	ktime_t start;
+	u64 ns;
+
+	/* Warm the caches and TLBs up */
+	fn->copy(dst, src, size);
+
+	start = ktime_get();
+	for (i = 0; i < loops; i++)
+		fn->copy(dst, src, size);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return div64_u64((u64) loops * size * 1000, max_t(u64, ns, 1));
+}
+
+#define bench_print(s, fmt, ...)					\
+	do {								\
+		if (s)							\
+			seq_printf(s, fmt, ##__VA_ARGS__);		\
+		else							\
+			pr_info(fmt, ##__VA_ARGS__);			\
+	} while (0)
+
+static int bench_run(struct seq_file *s)
+{
+	unsigned long src, dst;
+	int f, i;
+
+	src = __get_free_pages(GFP_KERNEL, BENCH_ORDER);
+	dst = __get_free_pages(GFP_KERNEL, BENCH_ORDER);
+	if (!src || !dst) {
+		free_pages(src, BENCH_ORDER);
+		free_pages(dst, BENCH_ORDER);
+		return -ENOMEM;
+	}
+	memset((void *) src, 0x5a, PAGE_SIZE << BENCH_ORDER);
+
+	bench_print(s, "%-12s %8s %12s %12s\n", "function", "size",
+		    "aligned MB/s", "unalign MB/s");
+	for (f = 0; f < ARRAY_SIZE(bench_fns); f++) {
+		for (i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+			size_t size = bench_sizes[i];
+
+			bench_print(s, "%-12s %8zu %12llu %12llu\n",
+				    bench_fns[f].name, size,
+				    bench_one(&bench_fns[f], (char *) dst,
+					      (char *) src, size),
+				    bench_one(&bench_fns[f], (char *) dst,
+					      (char *) src + 1, size));
+			cond_resched();
+		}
+	}
+
+	free_pages(src, BENCH_ORDER);
+	free_pages(dst, BENCH_ORDER);
+	return 0;
+}
+
+static int bench_show(struct seq_file *s, void *unused)
+{
+	return bench_run(s);
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_show, inode->i_private);
+}
+
+static const struct file_operations bench_fops = {
+	.open = bench_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init memcpy_bench_init(void)
+{
+	bench_dent = debugfs_create_file("memcpy_bench", 0400, NULL, NULL,
+					 &bench_fops);
+
+	if (bench_run(NULL))
+		pr_err("unable to allocate the benchmark buffers\n");
+
+	return 0;
+}
+
+static void __exit memcpy_bench_exit(void)
+{
+	debugfs_remove(bench_dent);
+}
+
+late_initcall(memcpy_bench_init);
+module_exit(memcpy_bench_exit);
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("memcpy throughput microbenchmark");
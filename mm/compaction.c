@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -1187,4 +1189,127 @@ void compaction_unregister_node(struct node *node)
 }
 #endif /* CONFIG_SYSFS && CONFIG_NUMA */
 
+/*
+ * kcompactd: background compaction.
+ *
+ * High order allocations entering the slow path wake kcompactd, and it also
+ * polls every sysctl_kcompactd_interval_ms when that is non-zero.  Each zone
+ * whose fragmentation index for sysctl_kcompactd_order is above
+ * sysctl_kcompactd_extfrag_threshold is compacted with async migration,
+ * until a free page of that order is available again.  Zones at or below
+ * vm.extfrag_threshold are never compacted, so lower thresholds make no
+ * difference.  The thread runs at the lowest priority so that it only uses
+ * otherwise idle CPU time.
+ */
+int sysctl_kcompactd_order = PAGE_ALLOC_COSTLY_ORDER + 1;
+int sysctl_kcompactd_extfrag_threshold = 500;
+int sysctl_kcompactd_interval_ms;
+
+static struct task_struct *kcompactd_task;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static int kcompactd_max_order = -1;
+
+void wakeup_kcompactd(int order)
+{
+	if (!kcompactd_task || order < sysctl_kcompactd_order)
+		return;
+
+	if (order > ACCESS_ONCE(kcompactd_max_order))
+		kcompactd_max_order = order;
+	if (waitqueue_active(&kcompactd_wait))
+		wake_up_interruptible(&kcompactd_wait);
+}
+
+static bool kcompactd_zone_fragmented(struct zone *zone, int order)
+{
+	/* -1000 means an allocation would succeed and is filtered too */
+	if (fragmentation_index(zone, order) <=
+			sysctl_kcompactd_extfrag_threshold)
+		return false;
+
+	return compaction_suitable(zone, order) == COMPACT_CONTINUE;
+}
+
+static void kcompactd_do_work(int order)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.sync = false,
+		};
+
+		if (kthread_should_stop())
+			return;
+
+		if (!kcompactd_zone_fragmented(zone, order) ||
+		    compaction_deferred(zone, order))
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		count_compact_event(KCOMPACTD_WAKE);
+		compact_zone(zone, &cc);
+
+		if (zone_watermark_ok(zone, order, low_wmark_pages(zone),
+				      0, 0)) {
+			if (order >= zone->compact_order_failed)
+				zone->compact_order_failed = order + 1;
+		} else if (!cc.contended) {
+			defer_compaction(zone, order);
+		}
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+}
+
+static int kcompactd(void *p)
+{
+	int order;
+	long timeout;
+
+	set_freezable();
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		timeout = sysctl_kcompactd_interval_ms ?
+			msecs_to_jiffies(sysctl_kcompactd_interval_ms) :
+			MAX_SCHEDULE_TIMEOUT;
+		wait_event_freezable_timeout(kcompactd_wait,
+				ACCESS_ONCE(kcompactd_max_order) >= 0 ||
+				kthread_should_stop(), timeout);
+
+		order = xchg(&kcompactd_max_order, -1);
+		if (order < sysctl_kcompactd_order)
+			order = sysctl_kcompactd_order;
+		if (order <= 0 || order >= MAX_ORDER)
+			continue;
+
+		kcompactd_do_work(order);
+	}
+
+	return 0;
+}
+
+static int __init kcompactd_init(void)
+{
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, NULL, "kcompactd");
+	if (IS_ERR(task)) {
+		pr_err("Failed to start kcompactd\n");
+		return PTR_ERR(task);
+	}
+	kcompactd_task = task;
+	return 0;
+}
+module_init(kcompactd_init)
+
 #endif /* CONFIG_COMPACTION */
@@ -88,7 +88,6 @@ extern unsigned long highest_memmap_pfn;
 /*
  * in mm/vmscan.c:
  */
-extern int isolate_lru_page(struct page *page);
 extern void putback_lru_page(struct page *page);
 extern unsigned long zone_reclaimable_pages(struct zone *zone);
 extern bool zone_reclaimable(struct zone *zone);
@@ -369,3 +368,24 @@ extern u32 hwpoison_filter_enable;
 unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 					    struct list_head *page_list);
 extern void set_pageblock_order(void);
+
+#ifdef CONFIG_READAHEAD_RECORD
+/*
+ * in mm/readahead_record.c
+ */
+extern int readahead_recording;
+extern void __readahead_record(struct file *filp, pgoff_t start,
+			       unsigned long nr);
+
+static inline void readahead_record(struct file *filp, pgoff_t start,
+				    unsigned long nr)
+{
+	if (unlikely(readahead_recording))
+		__readahead_record(filp, start, nr);
+}
+#else
+static inline void readahead_record(struct file *filp, pgoff_t start,
+				    unsigned long nr)
+{
+}
+#endif
@@ -86,14 +86,19 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @priority: KSM_PRIO_HIGH if madvised to be scanned on every pass
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	unsigned int priority;
 };
 
+#define KSM_PRIO_NORMAL	0
+#define KSM_PRIO_HIGH	1
+
 /**
  * struct ksm_scan - cursor for scanning
  * @mm_slot: the current mm_slot we are scanning
@@ -192,6 +197,26 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 /* Boolean to indicate whether to use deferred timer or not */
 static bool use_deferred_timer;
 
+/* Scan normal priority mms only on every Nth full scan */
+static unsigned int ksm_normal_scan_interval = 1;
+
+/*
+ * With adaptive scanning, ksmd scans between ksm_thread_pages_to_scan_min
+ * and ksm_thread_pages_to_scan pages per batch, raising the rate while
+ * batches keep merging pages and lowering it while they do not.
+ */
+static bool ksm_adaptive_scan;
+static unsigned int ksm_thread_pages_to_scan_min = 10;
+static unsigned int ksm_thread_pages_to_scan_cur = 100;
+
+/* Raise the rate above 1/32 pages merged, lower it below 1/256 */
+#define KSM_YIELD_RAISE_SHIFT	5
+#define KSM_YIELD_LOWER_SHIFT	8
+
+/* Duration of the last completed full scan */
+static unsigned long ksm_full_scan_start;
+static unsigned int ksm_full_scan_msecs;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -1279,6 +1304,32 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Decide whether a normal priority mm sits out this full scan.  None
+ * of its rmap_items can be in the unstable tree, which was emptied when
+ * this scan started, but the ones it added during its last scan would
+ * look too old to remove_rmap_item_from_tree() once this scan is over:
+ * age them out here instead, keeping their oldchecksum.
+ */
+static bool ksm_skip_mm_slot(struct mm_slot *slot)
+{
+	struct rmap_item *rmap_item;
+
+	if (slot->priority == KSM_PRIO_HIGH || ksm_normal_scan_interval <= 1)
+		return false;
+	if (!(ksm_scan.seqnr % ksm_normal_scan_interval))
+		return false;
+	/* Let an exiting mm be torn down without waiting for its turn */
+	if (ksm_test_exit(slot->mm))
+		return false;
+
+	for (rmap_item = slot->rmap_list; rmap_item;
+	     rmap_item = rmap_item->rmap_list)
+		if (rmap_item->address & UNSTABLE_FLAG)
+			remove_rmap_item_from_tree(rmap_item);
+	return true;
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1304,6 +1355,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		lru_add_drain_all();
 
 		root_unstable_tree = RB_ROOT;
+		ksm_full_scan_start = jiffies;
 
 		spin_lock(&ksm_mmlist_lock);
 		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
@@ -1318,6 +1370,13 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 next_mm:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &slot->rmap_list;
+		if (ksm_skip_mm_slot(slot)) {
+			spin_lock(&ksm_mmlist_lock);
+			ksm_scan.mm_slot = list_entry(slot->mm_list.next,
+						struct mm_slot, mm_list);
+			spin_unlock(&ksm_mmlist_lock);
+			goto next_slot;
+		}
 	}
 
 	mm = slot->mm;
@@ -1401,33 +1460,66 @@ next_mm:
 		up_read(&mm->mmap_sem);
 	}
 
+next_slot:
 	/* Repeat until we've completed scanning the whole list */
 	slot = ksm_scan.mm_slot;
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+	ksm_full_scan_msecs = jiffies_to_msecs(jiffies - ksm_full_scan_start);
 	return NULL;
 }
 
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
+ *
+ * Returns the number of pages actually scanned.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static unsigned int ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned int scanned = 0;
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
+			break;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
+		scanned++;
 	}
+	return scanned;
+}
+
+/*
+ * Pick the size of ksmd's next batch from the number of pages the last
+ * batch merged.  Without adaptive scanning it is pages_to_scan.
+ */
+static void ksm_update_scan_rate(unsigned int scanned, unsigned long merged)
+{
+	unsigned int rate = ksm_thread_pages_to_scan_cur;
+
+	if (!ksm_adaptive_scan) {
+		ksm_thread_pages_to_scan_cur = ksm_thread_pages_to_scan;
+		return;
+	}
+
+	if (scanned) {
+		if (merged &&
+		    (merged << KSM_YIELD_RAISE_SHIFT) >= scanned)
+			rate = rate < UINT_MAX / 2 ? rate * 2 : UINT_MAX;
+		else if ((merged << KSM_YIELD_LOWER_SHIFT) < scanned)
+			rate /= 2;
+	}
+
+	rate = min(rate, ksm_thread_pages_to_scan);
+	rate = max(rate, ksm_thread_pages_to_scan_min);
+	ksm_thread_pages_to_scan_cur = max(rate, 1U);
 }
 
 static void process_timeout(unsigned long __data)
@@ -1477,8 +1569,17 @@ static int ksm_scan_thread(void *nothing)
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+		if (ksmd_should_run()) {
+			unsigned long sharing = ksm_pages_sharing;
+			unsigned int scanned;
+
+			scanned = ksm_do_scan(ksm_thread_pages_to_scan_cur);
+			if (ksm_pages_sharing > sharing)
+				sharing = ksm_pages_sharing - sharing;
+			else
+				sharing = 0;
+			ksm_update_scan_rate(scanned, sharing);
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -1506,10 +1607,11 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
+	case MADV_MERGEABLE_HIGH:
 		/*
 		 * Be somewhat over-protective for now!
 		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
+		if (*vm_flags & (VM_SHARED  | VM_MAYSHARE   |
 				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
 				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
 				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
@@ -1521,6 +1623,16 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 				return err;
 		}
 
+		if (advice == MADV_MERGEABLE_HIGH) {
+			struct mm_slot *mm_slot;
+
+			spin_lock(&ksm_mmlist_lock);
+			mm_slot = get_mm_slot(mm);
+			if (mm_slot)
+				mm_slot->priority = KSM_PRIO_HIGH;
+			spin_unlock(&ksm_mmlist_lock);
+		}
+
 		*vm_flags |= VM_MERGEABLE;
 		break;
 
@@ -1913,11 +2025,91 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 		return -EINVAL;
 
 	ksm_thread_pages_to_scan = nr_pages;
+	if (!ksm_adaptive_scan)
+		ksm_thread_pages_to_scan_cur = nr_pages;
 
 	return count;
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t pages_to_scan_min_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_pages_to_scan_min);
+}
+
+static ssize_t pages_to_scan_min_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	int err;
+	unsigned long nr_pages;
+
+	err = strict_strtoul(buf, 10, &nr_pages);
+	if (err || nr_pages > UINT_MAX)
+		return -EINVAL;
+
+	ksm_thread_pages_to_scan_min = nr_pages;
+
+	return count;
+}
+KSM_ATTR(pages_to_scan_min);
+
+static ssize_t pages_to_scan_current_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_pages_to_scan_cur);
+}
+KSM_ATTR_RO(pages_to_scan_current);
+
+static ssize_t adaptive_scan_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ksm_adaptive_scan);
+}
+
+static ssize_t adaptive_scan_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = kstrtoul(buf, 10, &enable);
+	if (err || enable > 1)
+		return -EINVAL;
+
+	ksm_adaptive_scan = enable;
+
+	return count;
+}
+KSM_ATTR(adaptive_scan);
+
+static ssize_t normal_scan_interval_show(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_normal_scan_interval);
+}
+
+static ssize_t normal_scan_interval_store(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  const char *buf, size_t count)
+{
+	unsigned long interval;
+	int err;
+
+	err = kstrtoul(buf, 10, &interval);
+	if (err || !interval || interval > UINT_MAX)
+		return -EINVAL;
+
+	ksm_normal_scan_interval = interval;
+
+	return count;
+}
+KSM_ATTR(normal_scan_interval);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -2033,6 +2225,13 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t full_scan_msecs_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_full_scan_msecs);
+}
+KSM_ATTR_RO(full_scan_msecs);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -2042,7 +2241,12 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&full_scan_msecs_attr.attr,
 	&deferred_timer_attr.attr,
+	&pages_to_scan_min_attr.attr,
+	&pages_to_scan_current_attr.attr,
+	&adaptive_scan_attr.attr,
+	&normal_scan_interval_attr.attr,
 	NULL,
 };
 
@@ -73,6 +73,7 @@ static long madvise_behavior(struct vm_area_struct * vma,
 		new_flags &= ~VM_NODUMP;
 		break;
 	case MADV_MERGEABLE:
+	case MADV_MERGEABLE_HIGH:
 	case MADV_UNMERGEABLE:
 		error = ksm_madvise(vma, start, end, behavior, &new_flags);
 		if (error)
@@ -304,6 +305,7 @@ madvise_behavior_valid(int behavior)
 	case MADV_DONTNEED:
 #ifdef CONFIG_KSM
 	case MADV_MERGEABLE:
+	case MADV_MERGEABLE_HIGH:
 	case MADV_UNMERGEABLE:
 #endif
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
@@ -349,6 +351,9 @@ madvise_behavior_valid(int behavior)
  *  MADV_MERGEABLE - the application recommends that KSM try to merge pages in
  *		this area with pages of identical content from other such areas.
  *  MADV_UNMERGEABLE- cancel MADV_MERGEABLE: no longer merge pages with others.
+ *  MADV_MERGEABLE_HIGH - as MADV_MERGEABLE, and also ask KSM to scan this
+ *		process on every pass, even when other processes are scanned
+ *		less often.
  *
  * return values:
  *  zero    - success
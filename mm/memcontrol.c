@@ -99,6 +99,10 @@ enum mem_cgroup_events_index {
 	MEM_CGROUP_EVENTS_COUNT,	/* # of pages paged in/out */
 	MEM_CGROUP_EVENTS_PGFAULT,	/* # of page-faults */
 	MEM_CGROUP_EVENTS_PGMAJFAULT,	/* # of major page-faults */
+	MEM_CGROUP_EVENTS_PGSCAN_KSWAPD,	/* # of pages scanned by kswapd */
+	MEM_CGROUP_EVENTS_PGSCAN_DIRECT,	/* # of pages scanned directly */
+	MEM_CGROUP_EVENTS_PGSTEAL_KSWAPD,	/* # of pages reclaimed by kswapd */
+	MEM_CGROUP_EVENTS_PGSTEAL_DIRECT,	/* # of pages reclaimed directly */
 	MEM_CGROUP_EVENTS_NSTATS,
 };
 /*
@@ -1309,6 +1313,49 @@ static unsigned long mem_cgroup_margin(struct mem_cgroup *memcg)
 	return margin >> PAGE_SHIFT;
 }
 
+/*
+ * Account reclaim done on the LRU lists of @memcg, whatever the reason for
+ * the reclaim was, so that memory.stat shows which groups pay for global
+ * memory pressure.
+ */
+void mem_cgroup_count_reclaim(struct mem_cgroup *memcg, bool kswapd,
+			      unsigned long scanned, unsigned long reclaimed)
+{
+	if (mem_cgroup_disabled() || !memcg)
+		return;
+
+	if (kswapd) {
+		this_cpu_add(memcg->stat->events[MEM_CGROUP_EVENTS_PGSCAN_KSWAPD],
+			     scanned);
+		this_cpu_add(memcg->stat->events[MEM_CGROUP_EVENTS_PGSTEAL_KSWAPD],
+			     reclaimed);
+	} else {
+		this_cpu_add(memcg->stat->events[MEM_CGROUP_EVENTS_PGSCAN_DIRECT],
+			     scanned);
+		this_cpu_add(memcg->stat->events[MEM_CGROUP_EVENTS_PGSTEAL_DIRECT],
+			     reclaimed);
+	}
+}
+
+/*
+ * Returns true if @memcg, or one of its ancestors up to @root, is above its
+ * soft limit.  Global reclaim goes through such groups first.
+ */
+bool mem_cgroup_soft_reclaim_eligible(struct mem_cgroup *memcg,
+				      struct mem_cgroup *root)
+{
+	if (mem_cgroup_disabled() || !memcg)
+		return false;
+
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		if (res_counter_soft_limit_excess(&memcg->res))
+			return true;
+		if (memcg == root)
+			break;
+	}
+	return false;
+}
+
 int mem_cgroup_swappiness(struct mem_cgroup *memcg)
 {
 	struct cgroup *cgrp = memcg->css.cgroup;
@@ -4094,6 +4141,10 @@ enum {
 	MCS_SWAP,
 	MCS_PGFAULT,
 	MCS_PGMAJFAULT,
+	MCS_PGSCAN_KSWAPD,
+	MCS_PGSCAN_DIRECT,
+	MCS_PGSTEAL_KSWAPD,
+	MCS_PGSTEAL_DIRECT,
 	MCS_INACTIVE_ANON,
 	MCS_ACTIVE_ANON,
 	MCS_INACTIVE_FILE,
@@ -4118,6 +4169,10 @@ struct {
 	{"swap", "total_swap"},
 	{"pgfault", "total_pgfault"},
 	{"pgmajfault", "total_pgmajfault"},
+	{"pgscan_kswapd", "total_pgscan_kswapd"},
+	{"pgscan_direct", "total_pgscan_direct"},
+	{"pgsteal_kswapd", "total_pgsteal_kswapd"},
+	{"pgsteal_direct", "total_pgsteal_direct"},
 	{"inactive_anon", "total_inactive_anon"},
 	{"active_anon", "total_active_anon"},
 	{"inactive_file", "total_inactive_file"},
@@ -4150,6 +4205,14 @@ mem_cgroup_get_local_stat(struct mem_cgroup *memcg, struct mcs_total_stat *s)
 	s->stat[MCS_PGFAULT] += val;
 	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGMAJFAULT);
 	s->stat[MCS_PGMAJFAULT] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGSCAN_KSWAPD);
+	s->stat[MCS_PGSCAN_KSWAPD] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGSCAN_DIRECT);
+	s->stat[MCS_PGSCAN_DIRECT] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGSTEAL_KSWAPD);
+	s->stat[MCS_PGSTEAL_KSWAPD] += val;
+	val = mem_cgroup_read_events(memcg, MEM_CGROUP_EVENTS_PGSTEAL_DIRECT);
+	s->stat[MCS_PGSTEAL_DIRECT] += val;
 
 	/* per zone stat */
 	val = mem_cgroup_nr_lru_pages(memcg, BIT(LRU_INACTIVE_ANON));
@@ -710,6 +710,54 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+/*
+ * Frees at least count base pages, or everything there is, from the
+ * high-order pcp lists.  The highest orders go first as they are the
+ * most useful to the buddy allocator.  pcp->high_count is updated here.
+ */
+static void free_pcp_high_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
+{
+	int order, migratetype;
+	int freed = 0;
+	int free = 0;
+	int cma_free = 0;
+	int mt = 0;
+
+	spin_lock(&zone->lock);
+	zone->pages_scanned = 0;
+
+	for (order = PCP_HIGH_ORDER_MAX; order > 0; order--) {
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+							migratetype++) {
+			struct list_head *list;
+			struct page *page;
+
+			list = &pcp->high_lists[order - 1][migratetype];
+			while (!list_empty(list) && freed < count) {
+				page = list_entry(list->prev, struct page, lru);
+				mt = get_pageblock_migratetype(page);
+				if (likely(mt != MIGRATE_ISOLATE))
+					mt = page_private(page);
+
+				list_del(&page->lru);
+				__free_one_page(page, zone, order, mt);
+				trace_mm_page_pcpu_drain(page, order, mt);
+				if (likely(mt != MIGRATE_ISOLATE)) {
+					free += 1 << order;
+					if (is_migrate_cma(mt))
+						cma_free += 1 << order;
+				}
+				freed += 1 << order;
+			}
+		}
+	}
+	pcp->high_count -= freed;
+	__mod_zone_page_state(zone, NR_FREE_PAGES, free);
+	__mod_zone_page_state(zone, NR_FREE_CMA_PAGES, cma_free);
+	spin_unlock(&zone->lock);
+}
+
 static void free_one_page(struct zone *zone,
 				struct page *page,
 				unsigned int order,
@@ -750,20 +798,59 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 	return true;
 }
 
+/*
+ * Put a block of order 1 to PCP_HIGH_ORDER_MAX on this cpu's pageset.
+ * Returns false if the block has to go back to the buddy allocator
+ * directly instead.  Must be called with interrupts disabled.
+ */
+static bool free_pcp_high_page(struct zone *zone, struct page *page,
+				unsigned int order, int migratetype)
+{
+	struct per_cpu_pages *pcp;
+
+	if (unlikely(migratetype == MIGRATE_ISOLATE) ||
+		     is_migrate_cma(migratetype))
+		return false;
+
+	/*
+	 * Blocks on the pcp lists are handed out to callers that did not
+	 * ask for __GFP_COMP, so tear down the compound page now rather
+	 * than in __free_one_page().
+	 */
+	if (PageCompound(page) && unlikely(destroy_compound_page(page, order)))
+		return true;
+
+	/* As in free_hot_cold_page(), RESERVE blocks sit on the movable list */
+	set_freepage_migratetype(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES)
+		migratetype = MIGRATE_MOVABLE;
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list_add(&page->lru, &pcp->high_lists[order - 1][migratetype]);
+	pcp->high_count += 1 << order;
+	if (pcp->high_count >= pcp->high)
+		free_pcp_high_bulk(zone, pcp->batch, pcp);
+
+	return true;
+}
+
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
+	int migratetype;
 	int wasMlocked = __TestClearPageMlocked(page);
 
 	if (!free_pages_prepare(page, order))
 		return;
 
+	migratetype = get_pageblock_migratetype(page);
 	local_irq_save(flags);
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (!order || order > PCP_HIGH_ORDER_MAX ||
+	    !free_pcp_high_page(page_zone(page), page, order, migratetype))
+		free_one_page(page_zone(page), page, order, migratetype);
 	local_irq_restore(flags);
 }
 
@@ -1277,6 +1364,8 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	if (pcp->high_count)
+		free_pcp_high_bulk(zone, pcp->batch, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1305,6 +1394,8 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		if (pcp->high_count)
+			free_pcp_high_bulk(zone, pcp->high_count, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1348,7 +1439,7 @@ void drain_all_pages(void)
 		bool has_pcps = false;
 		for_each_populated_zone(zone) {
 			pcp = per_cpu_ptr(zone->pageset, cpu);
-			if (pcp->pcp.count) {
+			if (pcp->pcp.count || pcp->pcp.high_count) {
 				has_pcps = true;
 				break;
 			}
@@ -1558,6 +1649,44 @@ int split_free_page(struct page *page)
 	return nr_pages;
 }
 
+/*
+ * Take a block of order 1 to PCP_HIGH_ORDER_MAX off this cpu's pageset,
+ * refilling the list from the buddy allocator with a batch scaled down
+ * by the order when it is empty.  Must be called with interrupts
+ * disabled.
+ */
+static struct page *rmqueue_pcp_high(struct zone *zone, unsigned int order,
+				int migratetype, int cold, gfp_t gfp_flags)
+{
+	struct per_cpu_pages *pcp;
+	struct list_head *list;
+	struct page *page;
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->high_lists[order - 1][migratetype];
+	if (list_empty(list)) {
+		int batch = max(1, pcp->batch >> (order + 1));
+
+		__count_vm_event(PCP_HIGH_ALLOC_MISS);
+		pcp->high_count += rmqueue_bulk(zone, order, batch, list,
+					migratetype, cold,
+					gfp_flags & __GFP_CMA) << order;
+		if (unlikely(list_empty(list)))
+			return NULL;
+	} else {
+		__count_vm_event(PCP_HIGH_ALLOC_HIT);
+	}
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+
+	list_del(&page->lru);
+	pcp->high_count -= 1 << order;
+	return page;
+}
+
 /*
  * Really, prep_compound_page() should be called from __rmqueue_bulk().  But
  * we cheat by calling it from here, in the order > 0 path.  Saves a branch
@@ -1610,16 +1739,24 @@ again:
 			 */
 			WARN_ON_ONCE(order > 1);
 		}
-		spin_lock_irqsave(&zone->lock, flags);
-		if (gfp_flags & __GFP_CMA)
-			page = __rmqueue_cma(zone, order, migratetype);
-		else
-			page = __rmqueue(zone, order, migratetype);
-		spin_unlock(&zone->lock);
-		if (!page)
-			goto failed;
-		__mod_zone_freepage_state(zone, -(1 << order),
+		if (order <= PCP_HIGH_ORDER_MAX) {
+			local_irq_save(flags);
+			page = rmqueue_pcp_high(zone, order, migratetype,
+						cold, gfp_flags);
+			if (!page)
+				goto failed;
+		} else {
+			spin_lock_irqsave(&zone->lock, flags);
+			if (gfp_flags & __GFP_CMA)
+				page = __rmqueue_cma(zone, order, migratetype);
+			else
+				page = __rmqueue(zone, order, migratetype);
+			spin_unlock(&zone->lock);
+			if (!page)
+				goto failed;
+			__mod_zone_freepage_state(zone, -(1 << order),
 					  get_freepage_migratetype(page));
+		}
 	}
 
 	__count_zone_vm_events(PGALLOC, zone, 1 << order);
@@ -2471,6 +2608,7 @@ restart:
 	if (!(gfp_mask & __GFP_NO_KSWAPD))
 		wake_all_kswapd(order, zonelist, high_zoneidx,
 						zone_idx(preferred_zone));
+	wakeup_kcompactd(order);
 
 	/*
 	 * OK, we're below the kswapd watermark and have kicked background
@@ -2969,9 +3107,10 @@ void show_free_areas(unsigned int filter)
 
 			pageset = per_cpu_ptr(zone->pageset, cpu);
 
-			printk("CPU %4d: hi:%5d, btch:%4d usd:%4d\n",
+			printk("CPU %4d: hi:%5d, btch:%4d usd:%4d high_usd:%4d\n",
 			       cpu, pageset->pcp.high,
-			       pageset->pcp.batch, pageset->pcp.count);
+			       pageset->pcp.batch, pageset->pcp.count,
+			       pageset->pcp.high_count);
 		}
 	}
 
@@ -4007,6 +4146,7 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int migratetype;
+	int order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -4016,6 +4156,12 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+
+	pcp->high_count = 0;
+	for (order = 0; order < PCP_HIGH_ORDER_MAX; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+							migratetype++)
+			INIT_LIST_HEAD(&pcp->high_lists[order][migratetype]);
 }
 
 /*
@@ -4123,6 +4269,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		free_pcp_high_bulk(zone, pcp->high_count, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -17,6 +17,11 @@
 #include <linux/task_io_accounting_ops.h>
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/fadvise.h>
+
+#include "internal.h"
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -198,8 +203,10 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	 * uptodate then the caller will launch readpage again, and
 	 * will then handle the error.
 	 */
-	if (ret)
+	if (ret) {
 		read_pages(mapping, filp, &page_pool, ret);
+		readahead_record(filp, offset, page_idx);
+	}
 	BUG_ON(!list_empty(&page_pool));
 out:
 	return ret;
@@ -567,3 +574,197 @@ page_cache_async_readahead(struct address_space *mapping,
 	ondemand_readahead(mapping, ra, filp, true, offset, req_size);
 }
 EXPORT_SYMBOL_GPL(page_cache_async_readahead);
+
+#ifdef CONFIG_READAHEAD_LEARNING
+/*
+ * Readahead learning.
+ *
+ * Files such as apks, odex files and shared libraries are read in an order
+ * which looks random to ondemand_readahead() but is the same on every
+ * application start.  After POSIX_FADV_LEARN, the page offsets accessed
+ * through read() and page faults during the next sysctl_readahead_learn_ms
+ * milliseconds are recorded as a short list of extents.  Every later open
+ * of the file for reading then submits asynchronous readahead of all those
+ * extents in one plugged batch, instead of taking one small synchronous
+ * read per miss.
+ *
+ * The pattern hangs off the address_space and lives as long as the inode.
+ */
+#define RA_PATTERN_EXTENTS	128
+#define RA_PATTERN_GAP		4	/* pages read across to join extents */
+
+enum ra_pattern_state {
+	RA_PATTERN_IDLE,
+	RA_PATTERN_RECORDING,
+	RA_PATTERN_LEARNT,
+};
+
+struct ra_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_pattern {
+	struct mutex lock;		/* protects all below */
+	enum ra_pattern_state state;
+	unsigned long deadline;		/* end of recording, in jiffies */
+	unsigned int nr_extents;
+	struct ra_extent extents[RA_PATTERN_EXTENTS];
+};
+
+unsigned int sysctl_readahead_learn_ms = 5000;
+
+static int ra_extent_cmp(const void *a, const void *b)
+{
+	const struct ra_extent *x = a, *y = b;
+
+	if (x->start < y->start)
+		return -1;
+	return x->start > y->start;
+}
+
+/*
+ * Stop recording: sort the extents and merge the overlapping ones.
+ * Called with pat->lock held.
+ */
+static void ra_pattern_finish(struct ra_pattern *pat)
+{
+	struct ra_extent *ext, *last;
+	unsigned int i, n = 0;
+
+	sort(pat->extents, pat->nr_extents, sizeof(struct ra_extent),
+	     ra_extent_cmp, NULL);
+
+	for (i = 0; i < pat->nr_extents; i++) {
+		ext = &pat->extents[i];
+		if (n) {
+			last = &pat->extents[n - 1];
+			if (ext->start <= last->start + last->nr) {
+				last->nr = max(last->start + last->nr,
+					       ext->start + ext->nr) - last->start;
+				continue;
+			}
+		}
+		pat->extents[n++] = *ext;
+	}
+	pat->nr_extents = n;
+	pat->state = RA_PATTERN_LEARNT;
+}
+
+void ra_pattern_record(struct address_space *mapping, pgoff_t index)
+{
+	struct ra_pattern *pat = mapping->ra_pattern;
+	struct ra_extent *ext;
+	unsigned int i;
+
+	if (ACCESS_ONCE(pat->state) != RA_PATTERN_RECORDING)
+		return;
+
+	mutex_lock(&pat->lock);
+	if (pat->state != RA_PATTERN_RECORDING)
+		goto out;
+
+	if (time_after(jiffies, pat->deadline)) {
+		ra_pattern_finish(pat);
+		goto out;
+	}
+
+	/* accesses mostly hit or extend one of the latest extents */
+	for (i = pat->nr_extents; i-- > 0; ) {
+		ext = &pat->extents[i];
+		if (index < ext->start) {
+			if (index + 1 == ext->start) {
+				ext->start--;
+				ext->nr++;
+				goto out;
+			}
+			continue;
+		}
+		if (index < ext->start + ext->nr)
+			goto out;
+		if (index < ext->start + ext->nr + RA_PATTERN_GAP) {
+			ext->nr = index - ext->start + 1;
+			goto out;
+		}
+	}
+
+	if (pat->nr_extents < RA_PATTERN_EXTENTS) {
+		ext = &pat->extents[pat->nr_extents++];
+		ext->start = index;
+		ext->nr = 1;
+	} else {
+		/* out of room, go with what we have */
+		ra_pattern_finish(pat);
+	}
+out:
+	mutex_unlock(&pat->lock);
+}
+
+void ra_pattern_replay(struct file *filp)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct ra_pattern *pat = mapping->ra_pattern;
+	struct blk_plug plug;
+	unsigned int i;
+
+	if (!pat || ACCESS_ONCE(pat->state) == RA_PATTERN_IDLE)
+		return;
+	if (!mapping->a_ops->readpage && !mapping->a_ops->readpages)
+		return;
+
+	mutex_lock(&pat->lock);
+	if (pat->state == RA_PATTERN_RECORDING &&
+	    time_after(jiffies, pat->deadline))
+		ra_pattern_finish(pat);
+
+	if (pat->state == RA_PATTERN_LEARNT) {
+		blk_start_plug(&plug);
+		for (i = 0; i < pat->nr_extents; i++)
+			force_page_cache_readahead(mapping, filp,
+						   pat->extents[i].start,
+						   pat->extents[i].nr);
+		blk_finish_plug(&plug);
+	}
+	mutex_unlock(&pat->lock);
+}
+
+int ra_pattern_advise(struct address_space *mapping, int advice)
+{
+	struct ra_pattern *pat = mapping->ra_pattern;
+
+	if (advice == POSIX_FADV_UNLEARN) {
+		if (pat) {
+			mutex_lock(&pat->lock);
+			pat->state = RA_PATTERN_IDLE;
+			pat->nr_extents = 0;
+			mutex_unlock(&pat->lock);
+		}
+		return 0;
+	}
+
+	if (!pat) {
+		pat = kzalloc(sizeof(*pat), GFP_KERNEL);
+		if (!pat)
+			return -ENOMEM;
+		mutex_init(&pat->lock);
+		if (cmpxchg(&mapping->ra_pattern, NULL, pat)) {
+			kfree(pat);
+			pat = mapping->ra_pattern;
+		}
+	}
+
+	mutex_lock(&pat->lock);
+	pat->nr_extents = 0;
+	pat->deadline = jiffies + msecs_to_jiffies(sysctl_readahead_learn_ms);
+	pat->state = RA_PATTERN_RECORDING;
+	mutex_unlock(&pat->lock);
+
+	return 0;
+}
+
+void ra_pattern_free(struct address_space *mapping)
+{
+	kfree(mapping->ra_pattern);
+	mapping->ra_pattern = NULL;
+}
+#endif /* CONFIG_READAHEAD_LEARNING */
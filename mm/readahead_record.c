@@ -0,0 +1,475 @@
+/*
+ * mm/readahead_record.c - record and replay the page cache working set
+ *
+ * While recording, every range of a regular file that has to be read from
+ * storage because it is not in the page cache is logged, merged with the
+ * previous range of the same file when they touch. The log is read back
+ * from /sys/kernel/debug/readahead_record/files as "<path> <start> <nr>"
+ * lines, in pages, and is typically taken over the boot of a device.
+ *
+ * Writing such lines to /sys/kernel/debug/readahead_record/replay and
+ * closing the file issues readahead for all of them, ordered by the device
+ * and the disk block backing the start of each range so that the storage
+ * sees mostly ascending reads. The readahead is not waited for.
+ *
+ * Recording is started by writing 1 to .../enable or at boot with
+ * readahead_record=<seconds>, and stops after that many seconds or when 0
+ * is written to .../enable.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/path.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
+#include <linux/sort.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/moduleparam.h>
+
+#include "internal.h"
+
+#define RAR_HASH_BITS	8
+#define RAR_LINE_MAX	(PATH_MAX + 48)
+
+struct rar_file {
+	struct hlist_node node;
+	struct inode *inode;
+	struct path path;
+	int last;		/* index of the latest extent of this file */
+};
+
+struct rar_extent {
+	struct rar_file *file;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct rar_req {
+	struct file *file;
+	bool owner;		/* the request holding the file reference */
+	dev_t dev;
+	sector_t block;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct rar_replay {
+	char line[RAR_LINE_MAX];
+	size_t len;
+	char last_path[PATH_MAX];
+	struct file *last_file;
+	struct rar_req *reqs;
+	int nr_reqs;
+	int max_reqs;
+};
+
+int readahead_recording __read_mostly;
+
+/* Maximum number of extents recorded, and replayed in one go */
+static unsigned int max_extents = 32768;
+module_param(max_extents, uint, 0644);
+
+static unsigned int boot_secs;
+
+static DEFINE_SPINLOCK(rar_lock);
+static DEFINE_MUTEX(rar_mutex);
+static struct hlist_head rar_hash[1 << RAR_HASH_BITS];
+static struct rar_extent *rar_extents;
+static unsigned int rar_nr_extents;
+static unsigned int rar_size;
+static unsigned long rar_dropped;
+
+static void rar_stop_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(rar_stop_work, rar_stop_workfn);
+
+static struct rar_file *rar_get_file(struct file *filp)
+{
+	struct inode *inode = filp->f_mapping->host;
+	struct hlist_head *head = &rar_hash[hash_ptr(inode, RAR_HASH_BITS)];
+	struct hlist_node *pos;
+	struct rar_file *rf;
+
+	hlist_for_each_entry(rf, pos, head, node)
+		if (rf->inode == inode)
+			return rf;
+
+	rf = kmalloc(sizeof(*rf), GFP_ATOMIC);
+	if (!rf)
+		return NULL;
+	rf->inode = inode;
+	rf->path = filp->f_path;
+	path_get(&rf->path);
+	rf->last = -1;
+	hlist_add_head(&rf->node, head);
+	return rf;
+}
+
+/**
+ * __readahead_record() - Log a range read in because of a page cache miss
+ * @filp:	File the range belongs to
+ * @start:	First page of the range
+ * @nr:		Number of pages in the range
+ *
+ * Called by the readahead and fault paths with readahead_recording set.
+ */
+void __readahead_record(struct file *filp, pgoff_t start, unsigned long nr)
+{
+	struct rar_file *rf;
+	struct rar_extent *ext;
+
+	if (!filp || !nr || !S_ISREG(filp->f_mapping->host->i_mode))
+		return;
+
+	spin_lock(&rar_lock);
+	if (!readahead_recording)
+		goto out;
+
+	rf = rar_get_file(filp);
+	if (!rf) {
+		rar_dropped++;
+		goto out;
+	}
+
+	if (rf->last >= 0) {
+		ext = &rar_extents[rf->last];
+		if (start <= ext->start + ext->nr && start + nr >= ext->start) {
+			pgoff_t end = max(start + nr, ext->start + ext->nr);
+
+			ext->start = min(start, ext->start);
+			ext->nr = end - ext->start;
+			goto out;
+		}
+	}
+
+	if (rar_nr_extents == rar_size) {
+		rar_dropped++;
+		goto out;
+	}
+	rf->last = rar_nr_extents;
+	ext = &rar_extents[rar_nr_extents++];
+	ext->file = rf;
+	ext->start = start;
+	ext->nr = nr;
+out:
+	spin_unlock(&rar_lock);
+}
+
+/* Drop the recorded log, called with rar_mutex held and recording off */
+static void rar_reset(void)
+{
+	struct hlist_node *pos, *tmp;
+	struct rar_file *rf;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(rar_hash); i++) {
+		hlist_for_each_entry_safe(rf, pos, tmp, &rar_hash[i], node) {
+			hlist_del(&rf->node);
+			path_put(&rf->path);
+			kfree(rf);
+		}
+	}
+	vfree(rar_extents);
+	rar_extents = NULL;
+	rar_nr_extents = 0;
+	rar_size = 0;
+	rar_dropped = 0;
+}
+
+static int rar_start(unsigned int secs)
+{
+	struct rar_extent *extents;
+	unsigned int size = max_extents;
+
+	if (readahead_recording)
+		return -EBUSY;
+
+	rar_reset();
+	extents = vmalloc(size * sizeof(*extents));
+	if (!extents)
+		return -ENOMEM;
+
+	spin_lock(&rar_lock);
+	rar_extents = extents;
+	rar_size = size;
+	readahead_recording = 1;
+	spin_unlock(&rar_lock);
+
+	if (secs)
+		schedule_delayed_work(&rar_stop_work, secs * HZ);
+	return 0;
+}
+
+static void rar_stop(void)
+{
+	spin_lock(&rar_lock);
+	readahead_recording = 0;
+	spin_unlock(&rar_lock);
+}
+
+static void rar_stop_workfn(struct work_struct *work)
+{
+	mutex_lock(&rar_mutex);
+	rar_stop();
+	pr_info("readahead_record: recorded %u extents, %lu dropped\n",
+		rar_nr_extents, rar_dropped);
+	mutex_unlock(&rar_mutex);
+}
+
+static void *rar_seq_start(struct seq_file *m, loff_t *pos)
+{
+	mutex_lock(&rar_mutex);
+	return *pos < rar_nr_extents ? pos : NULL;
+}
+
+static void *rar_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return *pos < rar_nr_extents ? pos : NULL;
+}
+
+static void rar_seq_stop(struct seq_file *m, void *v)
+{
+	mutex_unlock(&rar_mutex);
+}
+
+static int rar_seq_show(struct seq_file *m, void *v)
+{
+	struct rar_extent ext;
+
+	/* the latest extents may still be growing */
+	spin_lock(&rar_lock);
+	ext = rar_extents[*(loff_t *)v];
+	spin_unlock(&rar_lock);
+
+	seq_path(m, &ext.file->path, "\n");
+	seq_printf(m, " %lu %lu\n", ext.start, ext.nr);
+	return 0;
+}
+
+static const struct seq_operations rar_seq_ops = {
+	.start = rar_seq_start,
+	.next = rar_seq_next,
+	.stop = rar_seq_stop,
+	.show = rar_seq_show,
+};
+
+static int rar_files_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &rar_seq_ops);
+}
+
+static const struct file_operations rar_files_fops = {
+	.open = rar_files_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = seq_release,
+};
+
+static int rar_enable_get(void *data, u64 *val)
+{
+	*val = readahead_recording;
+	return 0;
+}
+
+static int rar_enable_set(void *data, u64 val)
+{
+	int ret = 0;
+
+	cancel_delayed_work_sync(&rar_stop_work);
+	mutex_lock(&rar_mutex);
+	if (val)
+		ret = rar_start(0);
+	else
+		rar_stop();
+	mutex_unlock(&rar_mutex);
+	return ret;
+}
+DEFINE_SIMPLE_ATTRIBUTE(rar_enable_fops, rar_enable_get, rar_enable_set,
+			"%llu\n");
+
+/* Parse one "<path> <start> <nr>" line into a replay request */
+static void rar_replay_line(struct rar_replay *rp)
+{
+	struct rar_req *req;
+	struct inode *inode;
+	unsigned long start, nr;
+	char *p, *path = rp->line;
+
+	rp->line[rp->len] = '\0';
+	rp->len = 0;
+
+	p = strrchr(path, ' ');
+	if (!p || kstrtoul(p + 1, 10, &nr) || !nr)
+		return;
+	*p = '\0';
+	p = strrchr(path, ' ');
+	if (!p || kstrtoul(p + 1, 10, &start))
+		return;
+	*p = '\0';
+
+	if (rp->nr_reqs == rp->max_reqs)
+		return;
+
+	/* the lines of one file usually follow each other */
+	if (!rp->last_file || strcmp(path, rp->last_path)) {
+		struct file *file;
+
+		file = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(file))
+			return;
+		if (!S_ISREG(file->f_mapping->host->i_mode)) {
+			fput(file);
+			return;
+		}
+		strlcpy(rp->last_path, path, sizeof(rp->last_path));
+		rp->last_file = file;
+		rp->reqs[rp->nr_reqs].owner = true;
+	} else {
+		rp->reqs[rp->nr_reqs].owner = false;
+	}
+
+	req = &rp->reqs[rp->nr_reqs++];
+	inode = rp->last_file->f_mapping->host;
+	req->file = rp->last_file;
+	req->dev = inode->i_sb->s_dev;
+	req->block = bmap(inode,
+			(sector_t)start << (PAGE_CACHE_SHIFT - inode->i_blkbits));
+	req->start = start;
+	req->nr = nr;
+}
+
+static int rar_req_cmp(const void *a, const void *b)
+{
+	const struct rar_req *ra = a, *rb = b;
+
+	if (ra->dev != rb->dev)
+		return ra->dev < rb->dev ? -1 : 1;
+	if (ra->block != rb->block)
+		return ra->block < rb->block ? -1 : 1;
+	return 0;
+}
+
+static void rar_req_swap(void *a, void *b, int size)
+{
+	struct rar_req tmp = *(struct rar_req *)a;
+
+	*(struct rar_req *)a = *(struct rar_req *)b;
+	*(struct rar_req *)b = tmp;
+}
+
+static int rar_replay_open(struct inode *inode, struct file *file)
+{
+	struct rar_replay *rp;
+
+	rp = vzalloc(sizeof(*rp));
+	if (!rp)
+		return -ENOMEM;
+	rp->max_reqs = max_extents;
+	rp->reqs = vmalloc(rp->max_reqs * sizeof(*rp->reqs));
+	if (!rp->reqs) {
+		vfree(rp);
+		return -ENOMEM;
+	}
+	file->private_data = rp;
+	return 0;
+}
+
+static ssize_t rar_replay_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct rar_replay *rp = file->private_data;
+	size_t i;
+	char c;
+
+	for (i = 0; i < count; i++) {
+		if (get_user(c, buf + i))
+			return -EFAULT;
+		if (c == '\n') {
+			rar_replay_line(rp);
+			continue;
+		}
+		if (rp->len == RAR_LINE_MAX - 1)
+			return -EINVAL;
+		rp->line[rp->len++] = c;
+	}
+	return count;
+}
+
+static int rar_replay_release(struct inode *inode, struct file *file)
+{
+	struct rar_replay *rp = file->private_data;
+	unsigned long pages = 0;
+	int i, files = 0;
+
+	if (rp->len)
+		rar_replay_line(rp);
+
+	sort(rp->reqs, rp->nr_reqs, sizeof(*rp->reqs), rar_req_cmp,
+	     rar_req_swap);
+
+	for (i = 0; i < rp->nr_reqs; i++) {
+		struct rar_req *req = &rp->reqs[i];
+
+		force_page_cache_readahead(req->file->f_mapping, req->file,
+					   req->start, req->nr);
+		pages += req->nr;
+	}
+	for (i = 0; i < rp->nr_reqs; i++) {
+		if (rp->reqs[i].owner) {
+			fput(rp->reqs[i].file);
+			files++;
+		}
+	}
+	pr_info("readahead_record: replayed %d extents, %lu pages of %d files\n",
+		rp->nr_reqs, pages, files);
+
+	vfree(rp->reqs);
+	vfree(rp);
+	return 0;
+}
+
+static const struct file_operations rar_replay_fops = {
+	.open = rar_replay_open,
+	.write = rar_replay_write,
+	.release = rar_replay_release,
+};
+
+static int __init readahead_record_setup(char *str)
+{
+	return kstrtouint(str, 0, &boot_secs) == 0;
+}
+__setup("readahead_record=", readahead_record_setup);
+
+static int __init readahead_record_init(void)
+{
+	struct dentry *root;
+
+	if (boot_secs) {
+		mutex_lock(&rar_mutex);
+		if (rar_start(boot_secs))
+			pr_err("readahead_record: cannot start recording\n");
+		mutex_unlock(&rar_mutex);
+	}
+
+	root = debugfs_create_dir("readahead_record", NULL);
+	if (!root)
+		return -ENOMEM;
+	debugfs_create_file("enable", 0600, root, NULL, &rar_enable_fops);
+	debugfs_create_file("files", 0400, root, NULL, &rar_files_fops);
+	debugfs_create_file("replay", 0200, root, NULL, &rar_replay_fops);
+	return 0;
+}
+fs_initcall(readahead_record_init);
@@ -30,6 +30,9 @@
 #include <linux/fault-inject.h>
 #include <linux/stacktrace.h>
 #include <linux/prefetch.h>
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
+#include <linux/hash.h>
 
 #include <trace/events/kmem.h>
 
@@ -2358,11 +2361,222 @@ redo:
 	return object;
 }
 
+#ifdef CONFIG_SLUB_ALLOC_PROFILE
+/*
+ * Sampling allocation profiler.  One in slub_profile_rate allocations
+ * made by each CPU is charged to its (cache, call site) pair in a table
+ * shared by all caches.  The table is only allocated once profiling is
+ * enabled from debugfs and is never touched by allocations that are not
+ * sampled, so the cost of an unsampled allocation is a per cpu decrement.
+ * Sites that don't fit in the table are only counted as dropped.
+ */
+#define SLUB_PROFILE_BITS	10
+#define SLUB_PROFILE_SITES	(1 << SLUB_PROFILE_BITS)
+#define SLUB_PROFILE_PROBES	8
+
+struct slub_profile_site {
+	struct kmem_cache *s;
+	unsigned long caller;
+	unsigned long samples;
+	unsigned long bytes;		/* requested bytes of the samples */
+	unsigned int min_size;
+	unsigned int max_size;
+};
+
+static struct slub_profile_site *slub_profile_sites;
+static unsigned int slub_profile_rate;
+static unsigned long slub_profile_dropped;
+static DEFINE_RAW_SPINLOCK(slub_profile_lock);
+static DEFINE_MUTEX(slub_profile_mutex);
+static DEFINE_PER_CPU(unsigned int, slub_profile_countdown);
+
+static noinline void __slub_profile_alloc(struct kmem_cache *s,
+		unsigned long caller, size_t size)
+{
+	struct slub_profile_site *site;
+	unsigned long flags;
+	unsigned int i, slot;
+
+	slot = hash_long(caller ^ (unsigned long)s, SLUB_PROFILE_BITS);
+
+	raw_spin_lock_irqsave(&slub_profile_lock, flags);
+	if (!slub_profile_sites)
+		goto out;
+	for (i = 0; i < SLUB_PROFILE_PROBES; i++) {
+		site = &slub_profile_sites[(slot + i) & (SLUB_PROFILE_SITES - 1)];
+		if (!site->s) {
+			site->s = s;
+			site->caller = caller;
+			site->min_size = UINT_MAX;
+		} else if (site->s != s || site->caller != caller)
+			continue;
+
+		site->samples++;
+		site->bytes += size;
+		site->min_size = min_t(unsigned int, site->min_size, size);
+		site->max_size = max_t(unsigned int, site->max_size, size);
+		goto out;
+	}
+	slub_profile_dropped++;
+out:
+	raw_spin_unlock_irqrestore(&slub_profile_lock, flags);
+}
+
+static __always_inline void slub_profile_alloc(struct kmem_cache *s,
+		void *object, unsigned long caller, size_t size)
+{
+	unsigned int rate = ACCESS_ONCE(slub_profile_rate);
+
+	if (likely(!rate) || unlikely(!object))
+		return;
+
+	if (likely(this_cpu_dec_return(slub_profile_countdown) < rate))
+		return;
+	this_cpu_write(slub_profile_countdown, rate - 1);
+	__slub_profile_alloc(s, caller, size);
+}
+
+/* Forget the sites of a cache that is going away. */
+static void slub_profile_forget(struct kmem_cache *s)
+{
+	unsigned long flags;
+	int i;
+
+	raw_spin_lock_irqsave(&slub_profile_lock, flags);
+	for (i = 0; slub_profile_sites && i < SLUB_PROFILE_SITES; i++)
+		if (slub_profile_sites[i].s == s)
+			slub_profile_sites[i].s = NULL;
+	raw_spin_unlock_irqrestore(&slub_profile_lock, flags);
+}
+
+static int slub_profile_show(struct seq_file *m, void *unused)
+{
+	struct slub_profile_site *site;
+	struct kmem_cache *s;
+	unsigned int rate = slub_profile_rate;
+	int i;
+
+	seq_printf(m, "# rate 1/%u dropped %lu\n", rate, slub_profile_dropped);
+	seq_puts(m, "# cache objsize samples est_allocs avg_size min_size "
+		 "max_size caller\n");
+
+	mutex_lock(&slub_profile_mutex);
+	down_read(&slub_lock);
+	list_for_each_entry(s, &slab_caches, list) {
+		for (i = 0; slub_profile_sites && i < SLUB_PROFILE_SITES; i++) {
+			struct slub_profile_site snap;
+
+			site = &slub_profile_sites[i];
+			raw_spin_lock_irq(&slub_profile_lock);
+			snap = *site;
+			raw_spin_unlock_irq(&slub_profile_lock);
+			if (snap.s != s || !snap.samples)
+				continue;
+
+			seq_printf(m, "%s %d %lu %lu %lu %u %u %pS\n",
+				   s->name, s->objsize, snap.samples,
+				   snap.samples * rate,
+				   snap.bytes / snap.samples,
+				   snap.min_size, snap.max_size,
+				   (void *)snap.caller);
+		}
+	}
+	up_read(&slub_lock);
+	mutex_unlock(&slub_profile_mutex);
+
+	return 0;
+}
+
+static int slub_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, slub_profile_show, NULL);
+}
+
+/* Any write clears the samples. */
+static ssize_t slub_profile_clear(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	mutex_lock(&slub_profile_mutex);
+	raw_spin_lock_irq(&slub_profile_lock);
+	if (slub_profile_sites)
+		memset(slub_profile_sites, 0,
+		       SLUB_PROFILE_SITES * sizeof(*slub_profile_sites));
+	slub_profile_dropped = 0;
+	raw_spin_unlock_irq(&slub_profile_lock);
+	mutex_unlock(&slub_profile_mutex);
+
+	return count;
+}
+
+static const struct file_operations slub_profile_fops = {
+	.open		= slub_profile_open,
+	.read		= seq_read,
+	.write		= slub_profile_clear,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int slub_profile_rate_get(void *data, u64 *val)
+{
+	*val = slub_profile_rate;
+	return 0;
+}
+
+/*
+ * A non zero rate allocates the table, which then stays around, so the
+ * previous samples can still be read after profiling is stopped with 0.
+ */
+static int slub_profile_rate_set(void *data, u64 val)
+{
+	struct slub_profile_site *sites;
+
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&slub_profile_mutex);
+	if (val && !slub_profile_sites) {
+		sites = vzalloc(SLUB_PROFILE_SITES * sizeof(*sites));
+		if (!sites) {
+			mutex_unlock(&slub_profile_mutex);
+			return -ENOMEM;
+		}
+		raw_spin_lock_irq(&slub_profile_lock);
+		slub_profile_sites = sites;
+		raw_spin_unlock_irq(&slub_profile_lock);
+	}
+	ACCESS_ONCE(slub_profile_rate) = val;
+	mutex_unlock(&slub_profile_mutex);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(slub_profile_rate_fops, slub_profile_rate_get,
+			slub_profile_rate_set, "%llu\n");
+
+static int __init slub_profile_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("slub_profile", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("rate", 0644, dir, NULL, &slub_profile_rate_fops);
+	debugfs_create_file("sites", 0644, dir, NULL, &slub_profile_fops);
+	return 0;
+}
+late_initcall(slub_profile_init);
+#else
+static inline void slub_profile_alloc(struct kmem_cache *s, void *object,
+		unsigned long caller, size_t size) { }
+static inline void slub_profile_forget(struct kmem_cache *s) { }
+#endif /* CONFIG_SLUB_ALLOC_PROFILE */
+
 void *kmem_cache_alloc(struct kmem_cache *s, gfp_t gfpflags)
 {
 	void *ret = slab_alloc(s, gfpflags, NUMA_NO_NODE, _RET_IP_);
 
 	trace_kmem_cache_alloc(_RET_IP_, ret, s->objsize, s->size, gfpflags);
+	slub_profile_alloc(s, ret, _RET_IP_, s->objsize);
 
 	return ret;
 }
@@ -2373,6 +2587,7 @@ void *kmem_cache_alloc_trace(struct kmem_cache *s, gfp_t gfpflags, size_t size)
 {
 	void *ret = slab_alloc(s, gfpflags, NUMA_NO_NODE, _RET_IP_);
 	trace_kmalloc(_RET_IP_, ret, size, s->size, gfpflags);
+	slub_profile_alloc(s, ret, _RET_IP_, size);
 	return ret;
 }
 EXPORT_SYMBOL(kmem_cache_alloc_trace);
@@ -2393,6 +2608,7 @@ void *kmem_cache_alloc_node(struct kmem_cache *s, gfp_t gfpflags, int node)
 
 	trace_kmem_cache_alloc_node(_RET_IP_, ret,
 				    s->objsize, s->size, gfpflags, node);
+	slub_profile_alloc(s, ret, _RET_IP_, s->objsize);
 
 	return ret;
 }
@@ -2407,6 +2623,7 @@ void *kmem_cache_alloc_node_trace(struct kmem_cache *s,
 
 	trace_kmalloc_node(_RET_IP_, ret,
 			   size, s->size, gfpflags, node);
+	slub_profile_alloc(s, ret, _RET_IP_, size);
 	return ret;
 }
 EXPORT_SYMBOL(kmem_cache_alloc_node_trace);
@@ -3192,6 +3409,7 @@ void kmem_cache_destroy(struct kmem_cache *s)
 		}
 		if (s->flags & SLAB_DESTROY_BY_RCU)
 			rcu_barrier();
+		slub_profile_forget(s);
 		sysfs_slab_remove(s);
 	} else
 		up_write(&slub_lock);
@@ -3344,6 +3562,7 @@ void *__kmalloc(size_t size, gfp_t flags)
 	ret = slab_alloc(s, flags, NUMA_NO_NODE, _RET_IP_);
 
 	trace_kmalloc(_RET_IP_, ret, size, s->size, flags);
+	slub_profile_alloc(s, ret, _RET_IP_, size);
 
 	return ret;
 }
@@ -3387,6 +3606,7 @@ void *__kmalloc_node(size_t size, gfp_t flags, int node)
 	ret = slab_alloc(s, flags, node, _RET_IP_);
 
 	trace_kmalloc_node(_RET_IP_, ret, size, s->size, flags, node);
+	slub_profile_alloc(s, ret, _RET_IP_, size);
 
 	return ret;
 }
@@ -4027,6 +4247,7 @@ void *__kmalloc_track_caller(size_t size, gfp_t gfpflags, unsigned long caller)
 
 	/* Honor the call site pointer we received. */
 	trace_kmalloc(caller, ret, size, s->size, gfpflags);
+	slub_profile_alloc(s, ret, caller, size);
 
 	return ret;
 }
@@ -4057,6 +4278,7 @@ void *__kmalloc_node_track_caller(size_t size, gfp_t gfpflags,
 
 	/* Honor the call site pointer we received. */
 	trace_kmalloc_node(caller, ret, size, s->size, gfpflags, node);
+	slub_profile_alloc(s, ret, caller, size);
 
 	return ret;
 }
@@ -26,6 +26,7 @@
 #include <linux/security.h>
 #include <linux/backing-dev.h>
 #include <linux/mutex.h>
+#include <linux/cpu.h>
 #include <linux/capability.h>
 #include <linux/syscalls.h>
 #include <linux/memcontrol.h>
@@ -433,18 +434,28 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * Allocate up to n swap entries for the swap cache, taking them from
+ * the highest priority swap type first and in a run from one cluster
+ * where possible.  Returns the number of entries stored in swp_entries.
+ */
+static int get_swap_pages(int n, swp_entry_t swp_entries[])
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
 	int hp_index;
+	int n_ret = 0;
+	long avail;
 
 	spin_lock(&swap_lock);
-	if (atomic_long_read(&nr_swap_pages) <= 0)
+	avail = atomic_long_read(&nr_swap_pages);
+	if (avail <= 0)
 		goto noswap;
-	atomic_long_dec(&nr_swap_pages);
+	if (n > avail)
+		n = avail;
+	atomic_long_sub(n, &nr_swap_pages);
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		hp_index = atomic_xchg(&highest_priority_index, -1);
@@ -489,20 +500,126 @@ swp_entry_t get_swap_page(void)
 
 		spin_unlock(&swap_lock);
 		/* This is called for allocating swap entry for cache */
-		offset = scan_swap_map(si, SWAP_HAS_CACHE);
+		while (n_ret < n) {
+			offset = scan_swap_map(si, SWAP_HAS_CACHE);
+			if (!offset)
+				break;
+			swp_entries[n_ret++] = swp_entry(type, offset);
+		}
 		spin_unlock(&si->lock);
-		if (offset)
-			return swp_entry(type, offset);
+		if (n_ret == n)
+			return n_ret;
 		spin_lock(&swap_lock);
 		next = swap_list.next;
 	}
 
-	atomic_long_inc(&nr_swap_pages);
+	atomic_long_add(n - n_ret, &nr_swap_pages);
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return n_ret;
+}
+
+/*
+ * Per-cpu caches of free swap slots.  Without them every page that
+ * reclaim swaps out takes swap_lock and the swap_info lock, which
+ * shows up as soon as several cpus reclaim to zram at once.  A cpu
+ * refills its cache with SWAP_SLOTS_CACHE_SIZE consecutive slots at a
+ * time, which also keeps the pages it swaps out together on disk.
+ *
+ * Slots sitting in a cache hold SWAP_HAS_CACHE and are not counted in
+ * nr_swap_pages.  swapoff drains the caches once the device is no
+ * longer SWP_WRITEOK, so that try_to_unuse() does not trip over them.
+ */
+#define SWAP_SLOTS_CACHE_SIZE	64
+
+struct swap_slots_cache {
+	struct mutex	alloc_lock;	/* protects nr, cur and slots */
+	int		nr;
+	int		cur;
+	swp_entry_t	slots[SWAP_SLOTS_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swp_slots);
+static bool swap_slots_cache_ready;
+
+/*
+ * Caching only pays off, and only leaves enough slots for everybody
+ * else, when swap is large compared to what the caches can hold.
+ */
+static inline bool swap_slots_cache_active(void)
+{
+	return swap_slots_cache_ready && total_swap_pages >
+		num_online_cpus() * SWAP_SLOTS_CACHE_SIZE * 5;
+}
+
+static void drain_swap_slots_cache(struct swap_slots_cache *cache)
+{
+	mutex_lock(&cache->alloc_lock);
+	while (cache->cur < cache->nr)
+		swapcache_free(cache->slots[cache->cur++], NULL);
+	cache->cur = cache->nr = 0;
+	mutex_unlock(&cache->alloc_lock);
 }
 
+static void drain_all_swap_slots_caches(void)
+{
+	int cpu;
+
+	if (!swap_slots_cache_ready)
+		return;
+
+	for_each_possible_cpu(cpu)
+		drain_swap_slots_cache(&per_cpu(swp_slots, cpu));
+}
+
+swp_entry_t get_swap_page(void)
+{
+	swp_entry_t entry = { 0 };
+
+	if (swap_slots_cache_active()) {
+		struct swap_slots_cache *cache;
+
+		/* The mutex, not the cpu, keeps the cache consistent */
+		cache = &per_cpu(swp_slots, raw_smp_processor_id());
+		mutex_lock(&cache->alloc_lock);
+		if (cache->cur == cache->nr) {
+			cache->cur = 0;
+			cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE,
+						   cache->slots);
+		}
+		if (cache->cur < cache->nr)
+			entry = cache->slots[cache->cur++];
+		mutex_unlock(&cache->alloc_lock);
+		if (entry.val)
+			return entry;
+	}
+
+	get_swap_pages(1, &entry);
+	return entry;
+}
+
+static int swap_slots_cpu_notify(struct notifier_block *self,
+				 unsigned long action, void *hcpu)
+{
+	int cpu = (unsigned long)hcpu;
+
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		drain_swap_slots_cache(&per_cpu(swp_slots, cpu));
+	return NOTIFY_OK;
+}
+
+static int __init swap_slots_cache_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		mutex_init(&per_cpu(swp_slots, cpu).alloc_lock);
+	hotcpu_notifier(swap_slots_cpu_notify, 0);
+	swap_slots_cache_ready = true;
+	return 0;
+}
+__initcall(swap_slots_cache_init);
+
 /* The only caller of this function is now susupend routine */
 swp_entry_t get_swap_page_of_type(int type)
 {
@@ -1661,6 +1778,9 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	spin_unlock(&p->lock);
 	spin_unlock(&swap_lock);
 
+	/* No cache can be refilled from p now: hand back what they hold */
+	drain_all_swap_slots_caches();
+
 	oom_score_adj = test_set_oom_score_adj(OOM_SCORE_ADJ_MAX);
 	err = try_to_unuse(type);
 	compare_swap_oom_score_adj(OOM_SCORE_ADJ_MAX, oom_score_adj);
@@ -366,6 +366,111 @@ static void __insert_vmap_area(struct vmap_area *va)
 
 static void purge_vmap_area_lazy(void);
 
+/*
+ * Per cpu cache of small purged areas.  Lazily freed areas are unmapped
+ * and their TLB entries flushed by the purge, after which they can be
+ * handed out again as they are: vmap() users such as kgsl and ion, which
+ * map and unmap buffers of the same few sizes over and over, then neither
+ * search the tree nor take vmap_area_lock.  Areas are cached by their
+ * exact size, guard page included, and stay in the tree while cached.
+ * The caches are flushed before an allocation gives up on the space.
+ *
+ * Lock order: vmap_area_lock, then vmap_area_cache.lock.
+ */
+#define VMAP_CACHE_PAGES	16	/* largest cached area, in pages */
+#define VMAP_CACHE_DEPTH	4	/* areas cached per size and cpu */
+
+struct vmap_area_cache {
+	spinlock_t lock;
+	unsigned int nr[VMAP_CACHE_PAGES];
+	struct list_head areas[VMAP_CACHE_PAGES];
+};
+
+static DEFINE_PER_CPU(struct vmap_area_cache, vmap_area_cache);
+
+static struct vmap_area *vmap_cache_get(unsigned long size,
+		unsigned long align, unsigned long vstart, unsigned long vend)
+{
+	unsigned long nr = size >> PAGE_SHIFT;
+	struct vmap_area_cache *vc;
+	struct vmap_area *va, *found = NULL;
+
+	if (nr > VMAP_CACHE_PAGES)
+		return NULL;
+
+	vc = &get_cpu_var(vmap_area_cache);
+	spin_lock(&vc->lock);
+	list_for_each_entry(va, &vc->areas[nr - 1], purge_list) {
+		if ((va->va_start & (align - 1)) || va->va_start < vstart ||
+		    va->va_end > vend)
+			continue;
+		list_del(&va->purge_list);
+		vc->nr[nr - 1]--;
+		found = va;
+		break;
+	}
+	spin_unlock(&vc->lock);
+	put_cpu_var(vmap_area_cache);
+
+	if (found) {
+		spin_lock(&vmap_area_lock);
+		found->flags = 0;
+		spin_unlock(&vmap_area_lock);
+	}
+	return found;
+}
+
+/* Called with vmap_area_lock held on an area whose TLB entries are gone. */
+static bool vmap_cache_put(struct vmap_area *va)
+{
+	unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
+	struct vmap_area_cache *vc;
+	bool cached = false;
+
+	if (nr > VMAP_CACHE_PAGES)
+		return false;
+
+	vc = this_cpu_ptr(&vmap_area_cache);
+	spin_lock(&vc->lock);
+	if (vc->nr[nr - 1] < VMAP_CACHE_DEPTH) {
+		list_move(&va->purge_list, &vc->areas[nr - 1]);
+		vc->nr[nr - 1]++;
+		cached = true;
+	}
+	spin_unlock(&vc->lock);
+
+	return cached;
+}
+
+static void __free_vmap_area(struct vmap_area *va);
+
+/* Give the address space of all cached areas back. */
+static void vmap_cache_drain(void)
+{
+	struct vmap_area *va, *n_va;
+	LIST_HEAD(valist);
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_area_cache *vc = &per_cpu(vmap_area_cache, cpu);
+
+		spin_lock(&vc->lock);
+		for (i = 0; i < VMAP_CACHE_PAGES; i++) {
+			list_splice_init(&vc->areas[i], &valist);
+			vc->nr[i] = 0;
+		}
+		spin_unlock(&vc->lock);
+	}
+
+	if (list_empty(&valist))
+		return;
+
+	spin_lock(&vmap_area_lock);
+	list_for_each_entry_safe(va, n_va, &valist, purge_list)
+		__free_vmap_area(va);
+	spin_unlock(&vmap_area_lock);
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -385,6 +490,10 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	BUG_ON(size & ~PAGE_MASK);
 	BUG_ON(!is_power_of_2(align));
 
+	va = vmap_cache_get(size, align, vstart, vend);
+	if (va)
+		return va;
+
 	va = kmalloc_node(sizeof(struct vmap_area),
 			gfp_mask & GFP_RECLAIM_MASK, node);
 	if (unlikely(!va))
@@ -488,6 +597,7 @@ overflow:
 	spin_unlock(&vmap_area_lock);
 	if (!purged) {
 		purge_vmap_area_lazy();
+		vmap_cache_drain();
 		purged = 1;
 		goto retry;
 	}
@@ -589,10 +699,26 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
  */
+static unsigned long vmap_lazy_max_pages;
+module_param_named(lazy_max_pages, vmap_lazy_max_pages, ulong, 0644);
+
+/*
+ * A purge flushes the TLB over the whole span of the areas it frees,
+ * which arch code usually does one page at a time.  Above this many
+ * pages, flush the freed areas one by one if they are sparse in the
+ * span, or the whole TLB once if there are that many pages to flush.
+ */
+static unsigned long vmap_purge_flush_all_pages = 512;
+module_param_named(purge_flush_all_pages, vmap_purge_flush_all_pages,
+		   ulong, 0644);
+
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
 
+	if (vmap_lazy_max_pages)
+		return vmap_lazy_max_pages;
+
 	log = fls(num_online_cpus());
 
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
@@ -612,6 +738,28 @@ void set_iounmap_nonlazy(void)
 	atomic_set(&vmap_lazy_nr, lazy_max_pages()+1);
 }
 
+static void vmap_purge_flush(unsigned long start, unsigned long end,
+		struct list_head *valist, int nr, int force_flush)
+{
+	unsigned long span = (end - start) >> PAGE_SHIFT;
+	unsigned long limit = ACCESS_ONCE(vmap_purge_flush_all_pages);
+	struct vmap_area *va;
+
+	if (!limit || span <= limit) {
+		flush_tlb_kernel_range(start, end);
+		return;
+	}
+
+	/* The caller's own range isn't described by the purged areas. */
+	if (force_flush || nr > limit) {
+		flush_tlb_all();
+		return;
+	}
+
+	list_for_each_entry(va, valist, purge_list)
+		flush_tlb_kernel_range(va->va_start, va->va_end);
+}
+
 /*
  * Purges all lazily-freed vmap areas.
  *
@@ -664,12 +812,13 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 		atomic_sub(nr, &vmap_lazy_nr);
 
 	if (nr || force_flush)
-		flush_tlb_kernel_range(*start, *end);
+		vmap_purge_flush(*start, *end, &valist, nr, force_flush);
 
 	if (nr) {
 		spin_lock(&vmap_area_lock);
 		list_for_each_entry_safe(va, n_va, &valist, purge_list)
-			__free_vmap_area(va);
+			if (!vmap_cache_put(va))
+				__free_vmap_area(va);
 		spin_unlock(&vmap_area_lock);
 	}
 	spin_unlock(&purge_lock);
@@ -1247,10 +1396,17 @@ void __init vmalloc_init(void)
 
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
+		struct vmap_area_cache *vc;
+		int j;
 
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
 		INIT_LIST_HEAD(&vbq->free);
+
+		vc = &per_cpu(vmap_area_cache, i);
+		spin_lock_init(&vc->lock);
+		for (j = 0; j < VMAP_CACHE_PAGES; j++)
+			INIT_LIST_HEAD(&vc->areas[j]);
 	}
 
 	/* Import existing vmlist entries. */
@@ -71,6 +71,13 @@ static const unsigned int vmpressure_level_critical = 95;
  */
 static const unsigned int vmpressure_level_critical_prio = ilog2(100 / 10);
 
+/*
+ * In-kernel listeners for system wide (root cgroup) pressure. They are
+ * called from the vmpressure work with the enum vmpressure_levels level
+ * of each reported event.
+ */
+static BLOCKING_NOTIFIER_HEAD(vmpressure_notifier);
+
 static struct vmpressure *work_to_vmpressure(struct work_struct *work)
 {
 	return container_of(work, struct vmpressure, work);
@@ -187,6 +194,10 @@ static void vmpressure_work_fn(struct work_struct *work)
 	mutex_unlock(&vmpr->sr_lock);
 	if (!report)
 		return;
+
+	if (!vmpressure_parent(vmpr))
+		blocking_notifier_call_chain(&vmpressure_notifier, level, NULL);
+
 	do {
 		if (vmpressure_event(vmpr, level))
 			break;
@@ -416,6 +427,30 @@ void vmpressure_unregister_event(struct cgroup *cg, struct cftype *cft,
 	mutex_unlock(&vmpr->events_lock);
 }
 
+/**
+ * vmpressure_register_notifier() - Get notified of system wide pressure
+ * @nb:		notifier block to add
+ *
+ * @nb->notifier_call is invoked from process context with the pressure
+ * level as @action each time an event is reported for the root cgroup,
+ * that is at the same rate as for userspace listeners. It may sleep.
+ */
+int vmpressure_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(vmpressure_register_notifier);
+
+/**
+ * vmpressure_unregister_notifier() - Stop system wide pressure notifications
+ * @nb:		notifier block passed to vmpressure_register_notifier()
+ */
+int vmpressure_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(vmpressure_unregister_notifier);
+
 /**
  * vmpressure_init() - Initialize vmpressure control structure
  * @vmpr:	Structure to be initialized
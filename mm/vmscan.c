@@ -591,6 +591,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 
 		freepage = mapping->a_ops->freepage;
 
+		workingset_eviction(mapping, page);
 		__delete_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -1054,6 +1055,64 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Reclaim pages isolated by the caller, typically /proc/pid/reclaim,
+ * regardless of their referenced state.  The pages may come from any
+ * zone, so they are handed to shrink_page_list() one zone at a time.
+ * The caller must have accounted each page in NR_ISOLATED_ANON or
+ * NR_ISOLATED_FILE; pages that could not be reclaimed are put back on
+ * the LRU.
+ */
+unsigned long reclaim_pages_from_list(struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+	};
+	unsigned long nr_reclaimed = 0;
+	unsigned long dummy1, dummy2;
+	struct page *page, *next;
+
+	while (!list_empty(page_list)) {
+		LIST_HEAD(zone_pages);
+		struct zone *zone = page_zone(lru_to_page(page_list));
+		int nr_isolated[2] = { 0, };
+
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_zone(page) != zone)
+				continue;
+			ClearPageActive(page);
+			nr_isolated[page_is_file_cache(page)]++;
+			list_move(&page->lru, &zone_pages);
+		}
+
+		nr_reclaimed += shrink_page_list(&zone_pages, zone, &sc,
+					TTU_UNMAP|TTU_IGNORE_ACCESS,
+					&dummy1, &dummy2, true);
+
+		while (!list_empty(&zone_pages)) {
+			page = lru_to_page(&zone_pages);
+			list_del(&page->lru);
+			nr_isolated[page_is_file_cache(page)]--;
+			dec_zone_page_state(page, NR_ISOLATED_ANON +
+					    page_is_file_cache(page));
+			putback_lru_page(page);
+		}
+
+		/* Whatever is left in nr_isolated[] was freed */
+		mod_zone_page_state(zone, NR_ISOLATED_ANON, -nr_isolated[0]);
+		mod_zone_page_state(zone, NR_ISOLATED_FILE, -nr_isolated[1]);
+		cond_resched();
+	}
+
+	return nr_reclaimed;
+}
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -1434,6 +1493,8 @@ shrink_inactive_list(unsigned long nr_to_scan, struct mem_cgroup_zone *mz,
 			__count_zone_vm_events(PGSTEAL_DIRECT, zone,
 					       nr_reclaimed);
 	}
+	mem_cgroup_count_reclaim(mz->mem_cgroup, current_is_kswapd(),
+				 nr_scanned, nr_reclaimed);
 
 	putback_inactive_pages(mz, &page_list);
 
@@ -1741,10 +1802,19 @@ static unsigned long shrink_list(enum lru_list lru, unsigned long nr_to_scan,
 	return shrink_inactive_list(nr_to_scan, mz, sc, lru);
 }
 
-static int vmscan_swappiness(struct scan_control *sc)
+/*
+ * Global reclaim honours the swappiness of the memcg which owns the lru
+ * lists being scanned, so that e.g. background apps can be swapped out
+ * more readily than the foreground one.
+ */
+static int vmscan_swappiness(struct mem_cgroup_zone *mz,
+			     struct scan_control *sc)
 {
-	if (global_reclaim(sc))
-		return vm_swappiness;
+	if (global_reclaim(sc)) {
+		if (!mz->mem_cgroup)
+			return vm_swappiness;
+		return mem_cgroup_swappiness(mz->mem_cgroup);
+	}
 	return mem_cgroup_swappiness(sc->target_mem_cgroup);
 }
 
@@ -1825,8 +1895,8 @@ static void get_scan_count(struct mem_cgroup_zone *mz, struct scan_control *sc,
 	 * With swappiness at 100, anonymous and file have the same priority.
 	 * This scanning priority is essentially the inverse of IO cost.
 	 */
-	anon_prio = vmscan_swappiness(sc);
-	file_prio = 200 - vmscan_swappiness(sc);
+	anon_prio = vmscan_swappiness(mz, sc);
+	file_prio = 200 - vmscan_swappiness(mz, sc);
 
 	/*
 	 * OK, so we have swap space and a fair amount of page cache
@@ -1871,7 +1941,7 @@ out:
 		unsigned long scan;
 
 		scan = zone_nr_lru_pages(mz, lru);
-		if (sc->priority || noswap || !vmscan_swappiness(sc)) {
+		if (sc->priority || noswap || !vmscan_swappiness(mz, sc)) {
 			scan >>= sc->priority;
 			if (!scan && force_scan)
 				scan = SWAP_CLUSTER_MAX;
@@ -2018,18 +2088,21 @@ restart:
 	throttle_vm_writeout(sc->gfp_mask);
 }
 
-static void shrink_zone(struct zone *zone, struct scan_control *sc)
+/*
+ * Shrink the lru lists of every memcg below sc->target_mem_cgroup in @zone,
+ * or with @soft_reclaim only those of the memcgs above their soft limit.
+ * Returns false if there was nothing to shrink.
+ */
+static bool __shrink_zone(struct zone *zone, struct scan_control *sc,
+			  bool soft_reclaim)
 {
-	unsigned long nr_reclaimed, nr_scanned;
 	struct mem_cgroup *root = sc->target_mem_cgroup;
 	struct mem_cgroup_reclaim_cookie reclaim = {
 		.zone = zone,
 		.priority = sc->priority,
 	};
 	struct mem_cgroup *memcg;
-
-	nr_reclaimed = sc->nr_reclaimed;
-	nr_scanned = sc->nr_scanned;
+	bool shrunk = false;
 
 	memcg = mem_cgroup_iter(root, NULL, &reclaim);
 	do {
@@ -2038,7 +2111,14 @@ static void shrink_zone(struct zone *zone, struct scan_control *sc)
 			.zone = zone,
 		};
 
+		if (soft_reclaim &&
+		    !mem_cgroup_soft_reclaim_eligible(memcg, root)) {
+			memcg = mem_cgroup_iter(root, memcg, &reclaim);
+			continue;
+		}
+
 		shrink_mem_cgroup_zone(&mz, sc);
+		shrunk = true;
 		/*
 		 * Limit reclaim has historically picked one memcg and
 		 * scanned it with decreasing priority levels until
@@ -2056,6 +2136,27 @@ static void shrink_zone(struct zone *zone, struct scan_control *sc)
 		memcg = mem_cgroup_iter(root, memcg, &reclaim);
 	} while (memcg);
 
+	return shrunk;
+}
+
+static void shrink_zone(struct zone *zone, struct scan_control *sc)
+{
+	unsigned long nr_reclaimed, nr_scanned;
+
+	nr_reclaimed = sc->nr_reclaimed;
+	nr_scanned = sc->nr_scanned;
+
+	/*
+	 * Under global pressure, go through the memcgs which exceed their
+	 * soft limit first, and only move on to everybody else when that
+	 * was not enough.
+	 */
+	if (global_reclaim(sc) && __shrink_zone(zone, sc, true) &&
+	    sc->nr_reclaimed >= sc->nr_to_reclaim)
+		goto out;
+
+	__shrink_zone(zone, sc, false);
+out:
 	vmpressure(sc->gfp_mask, sc->target_mem_cgroup,
 		   sc->nr_scanned - nr_scanned,
 		   sc->nr_reclaimed - nr_reclaimed);
@@ -0,0 +1,167 @@
+/*
+ * mm/workingset.c - refault distance based working set detection
+ *
+ * Every zone counts the pages moved out of its inactive file list, by
+ * eviction or activation, in zone->inactive_age. When reclaim evicts a
+ * page cache page, the zone and the current age are remembered as a
+ * shadow entry for (mapping, index). When the page is read back in, the
+ * difference between the age at that time and the age stored in its
+ * shadow is its refault distance: the number of pages the inactive list
+ * had to take in before the page was needed again. Given that the page
+ * would have stayed resident with an inactive list longer by that amount,
+ * and the active list is the only place those pages could come from, a
+ * refault distance up to the size of the active file list means the page
+ * belongs to the working set. It is activated straight away instead of
+ * having to win its way back through the inactive list, where it would be
+ * thrashed again by the next app switch.
+ *
+ * Shadow entries live in a fixed size hash table rather than in the page
+ * cache radix trees, so that none of the page cache lookups have to learn
+ * about them. A slot keeps a few more bits of the hash as a cookie, newer
+ * shadows simply replace older ones, and a refault consumes its shadow.
+ * Shadows are not removed on truncation: one left behind by a file that
+ * was deleted may at worst activate a single page of a new file.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/vmalloc.h>
+
+#define SHADOW_VALID		1UL
+#define SHADOW_COOKIE_BITS	8
+#define SHADOW_ZONE_BITS	(NODES_SHIFT + ZONES_SHIFT)
+#define SHADOW_AGE_SHIFT	(1 + SHADOW_COOKIE_BITS + SHADOW_ZONE_BITS)
+#define SHADOW_AGE_MASK		(~0UL >> SHADOW_AGE_SHIFT)
+
+static unsigned long *shadow_table __read_mostly;
+static unsigned int shadow_shift __read_mostly;
+
+static unsigned long *shadow_slot(struct address_space *mapping,
+				  pgoff_t index, unsigned long *cookie)
+{
+	u32 hash = jhash_2words((u32)(unsigned long)mapping, (u32)index,
+				(u32)((unsigned long)mapping >> 16));
+
+	*cookie = hash >> (32 - SHADOW_COOKIE_BITS);
+	return &shadow_table[hash & ((1U << shadow_shift) - 1)];
+}
+
+static unsigned long pack_shadow(struct zone *zone, unsigned long cookie,
+				 unsigned long age)
+{
+	unsigned long shadow;
+
+	shadow = age & SHADOW_AGE_MASK;
+	shadow = (shadow << NODES_SHIFT) | zone_to_nid(zone);
+	shadow = (shadow << ZONES_SHIFT) | zone_idx(zone);
+	shadow = (shadow << SHADOW_COOKIE_BITS) | cookie;
+	return (shadow << 1) | SHADOW_VALID;
+}
+
+static struct zone *unpack_shadow(unsigned long shadow, unsigned long *cookie,
+				  unsigned long *age)
+{
+	int nid, zid;
+
+	shadow >>= 1;
+	*cookie = shadow & ((1UL << SHADOW_COOKIE_BITS) - 1);
+	shadow >>= SHADOW_COOKIE_BITS;
+	zid = shadow & ((1UL << ZONES_SHIFT) - 1);
+	shadow >>= ZONES_SHIFT;
+	nid = shadow & ((1UL << NODES_SHIFT) - 1);
+	shadow >>= NODES_SHIFT;
+	*age = shadow;
+	return NODE_DATA(nid)->node_zones + zid;
+}
+
+/**
+ * workingset_eviction() - Remember a page cache page reclaim evicts
+ * @mapping:	Mapping the page is removed from
+ * @page:	Page being evicted
+ *
+ * Called with mapping->tree_lock held.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long cookie, age, *slot;
+
+	if (!shadow_table)
+		return;
+
+	age = atomic_long_inc_return(&zone->inactive_age);
+	slot = shadow_slot(mapping, page->index, &cookie);
+	ACCESS_ONCE(*slot) = pack_shadow(zone, cookie, age);
+}
+
+/**
+ * workingset_refault() - Evaluate the refault of a page cache page
+ * @mapping:	Mapping the page is being added to
+ * @index:	Index of the page in @mapping
+ *
+ * Returns true when the page was evicted recently enough that it would
+ * have stayed resident given the active file list as inactive space,
+ * i.e. when it should be activated.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	unsigned long cookie, shadow_cookie, eviction, distance, *slot;
+	unsigned long shadow;
+	struct zone *zone;
+
+	if (!shadow_table)
+		return false;
+
+	slot = shadow_slot(mapping, index, &cookie);
+	shadow = ACCESS_ONCE(*slot);
+	if (!(shadow & SHADOW_VALID))
+		return false;
+
+	zone = unpack_shadow(shadow, &shadow_cookie, &eviction);
+	if (shadow_cookie != cookie)
+		return false;
+	/* a racing eviction may have replaced it, the shadow is lossy */
+	cmpxchg(slot, shadow, 0);
+
+	distance = (atomic_long_read(&zone->inactive_age) - eviction) &
+		SHADOW_AGE_MASK;
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation() - Note a page moving to the active list
+ * @page:	Page being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static int __init workingset_init(void)
+{
+	unsigned long entries = rounddown_pow_of_two(totalram_pages);
+
+	shadow_shift = ilog2(entries);
+	shadow_table = vzalloc(entries * sizeof(*shadow_table));
+	if (!shadow_table)
+		pr_err("workingset: cannot allocate %lu shadow entries\n",
+		       entries);
+	return 0;
+}
+module_init(workingset_init);
@@ -25,8 +25,9 @@
 
 #include <linux/atomic.h>
 #include <linux/cleancache.h>
-#include <linux/cpu.h>
-#include <linux/crypto.h>
+#include <linux/err.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 #include <linux/page-flags.h>
 #include <linux/pagemap.h>
 #include <linux/highmem.h>
@@ -37,7 +38,10 @@
 #include <linux/radix-tree.h>
 #include <linux/rbtree.h>
 #include <linux/types.h>
-#include <linux/zbud.h>
+#include <linux/vmalloc.h>
+#include <linux/zsmalloc.h>
+
+#include "../drivers/block/zram/zcomp.h"
 
 /*
  * Enable/disable zcache (disabled by default)
@@ -60,12 +64,20 @@ module_param_named(max_pool_percent, zcache_max_pool_percent, uint, 0644);
 
 static unsigned int zcache_clear_percent = 4;
 module_param_named(clear_percent, zcache_clear_percent, uint, 0644);
+
+/*
+ * Only admit pages that were refaulted: pages evicted from the page cache
+ * before, or loaded back from zcache. Otherwise admit pages that have been
+ * on the active file list.
+ */
+static bool zcache_refault_admission = true;
+module_param_named(refault_admission, zcache_refault_admission, bool, 0644);
 /*
  * zcache statistics
  */
 static u64 zcache_pool_limit_hit;
 static u64 zcache_dup_entry;
-static u64 zcache_zbud_alloc_fail;
+static u64 zcache_zs_alloc_fail;
 static u64 zcache_evict_zpages;
 static u64 zcache_evict_filepages;
 static u64 zcache_inactive_pages_refused;
@@ -74,6 +86,7 @@ static u64 zcache_pool_shrink;
 static u64 zcache_pool_shrink_fail;
 static u64 zcache_pool_shrink_pages;
 static u64 zcache_store_failed;
+static u64 zcache_refault_admitted;
 static atomic_t zcache_stored_pages = ATOMIC_INIT(0);
 static atomic_t zcache_stored_zero_pages = ATOMIC_INIT(0);
 
@@ -87,28 +100,37 @@ static atomic_t zcache_stored_zero_pages = ATOMIC_INIT(0);
  */
 #define ZERO_HANDLE	((void *)~(~0UL >> 1))
 
+/* Pages compressing worse than this are not stored */
+#define ZCACHE_MAX_ZLEN	(PAGE_SIZE / 4 * 3)
+
 /*
  * Zcache receives pages for compression through the Cleancache API and is able
  * to evict pages from its own compressed pool on an LRU basis in the case that
  * the compressed pool is full.
  *
- * Zcache makes use of zbud for the managing the compressed memory pool. Each
- * allocation in zbud is not directly accessible by address.  Rather, a handle
- * (zaddr) is return by the allocation routine and that handle(zaddr must be
- * mapped before being accessed. The compressed memory pool grows on demand and
- * shrinks as compressed pages are freed.
+ * Zcache compresses with the zcomp backends of zram and stores the result
+ * in a zsmalloc pool shared by all filesystems. Each allocation in zsmalloc
+ * is not directly accessible by address. Rather, a handle is returned by
+ * the allocation routine and that handle must be mapped before being
+ * accessed. Every stored page is described by a zcache_entry, which sits on
+ * a global LRU list that the eviction walks from the oldest end.
  *
  * When a file page is passed from cleancache to zcache, zcache maintains a
- * mapping of the <filesystem_type, inode_number, page_index> to the zbud
- * address that references that compressed file page. This mapping is achieved
+ * mapping of the <filesystem_type, inode_number, page_index> to the
+ * zcache_entry that references that compressed file page. This mapping is achieved
  * with a red-black tree per filesystem type, plus a radix tree per red-black
  * node.
  *
  * A zcache pool with pool_id as the index is created when a filesystem mounted
  * Each zcache pool has a red-black tree, the inode number(rb_index) is the
  * search key. Each red-black tree node has a radix tree which use
- * page->index(ra_index) as the index. Each radix tree slot points to the zbud
- * address combining with some extra information(zcache_ra_handle).
+ * page->index(ra_index) as the index. Each radix tree slot points to the
+ * zcache_entry of the page, or is ZERO_HANDLE for a page of zeroes.
+ *
+ * Lock order: zcache_pool->rb_lock, zcache_rbnode->ra_lock, zcache_lru_lock.
+ * An entry is on the LRU exactly while it is in a radix tree, so the LRU
+ * only has to be changed under the ra_lock of its node, and the eviction
+ * can get from the LRU to the node with a trylock of ra_lock.
  */
 #define MAX_ZCACHE_POOLS 32
 /*
@@ -117,8 +139,6 @@ static atomic_t zcache_stored_zero_pages = ATOMIC_INIT(0);
 struct zcache_pool {
 	struct rb_root rbtree;
 	rwlock_t rb_lock;		/* Protects rbtree */
-	u64 size;
-	struct zbud_pool *pool;         /* Zbud pool used */
 };
 
 /*
@@ -146,35 +166,178 @@ struct zcache_rbnode {
 /*
  * Radix-tree leaf, indexed by page->index
  */
-struct zcache_ra_handle {
-	int rb_index;			/* Redblack tree index */
+struct zcache_entry {
+	struct list_head lru;		/* On zcache_lru, under ra_lock */
+	struct zcache_rbnode *rbnode;	/* Node of the radix tree */
+	unsigned long handle;		/* zsmalloc handle of the data */
 	int ra_index;			/* Radix tree index */
-	int zlen;			/* Compressed page size */
-	struct zcache_pool *zpool;	/* Finding zcache_pool during evict */
+	unsigned int zlen;		/* Compressed page size */
 };
 
+static struct zs_pool *zcache_zs_pool;
+static struct zcomp *zcache_comp;
+
+static LIST_HEAD(zcache_lru);
+static DEFINE_SPINLOCK(zcache_lru_lock);
+
 u64 zcache_pages(void)
 {
-	int i;
-	u64 count = 0;
-
-	for (i = 0; (i < MAX_ZCACHE_POOLS) && zcache.pools[i]; i++)
-		count += zcache.pools[i]->size;
+	if (!zcache_zs_pool)
+		return 0;
 
-	return count;
+	return zs_get_total_size_bytes(zcache_zs_pool) >> PAGE_SHIFT;
 }
 
 static struct kmem_cache *zcache_rbnode_cache;
+static struct kmem_cache *zcache_entry_cache;
 static int zcache_rbnode_cache_create(void)
 {
 	zcache_rbnode_cache = KMEM_CACHE(zcache_rbnode, 0);
-	return zcache_rbnode_cache == NULL;
+	if (!zcache_rbnode_cache)
+		return 1;
+	zcache_entry_cache = KMEM_CACHE(zcache_entry, 0);
+	if (!zcache_entry_cache) {
+		kmem_cache_destroy(zcache_rbnode_cache);
+		return 1;
+	}
+	return 0;
 }
 static void zcache_rbnode_cache_destroy(void)
 {
+	kmem_cache_destroy(zcache_entry_cache);
 	kmem_cache_destroy(zcache_rbnode_cache);
 }
 
+static void zcache_entry_free(struct zcache_entry *entry)
+{
+	zs_free(zcache_zs_pool, entry->handle);
+	kmem_cache_free(zcache_entry_cache, entry);
+	atomic_dec(&zcache_stored_pages);
+}
+
+/*
+ * Remove the page at @index from the radix tree of @rbnode and, for a
+ * compressed page, from the LRU. The caller owns what is returned.
+ *
+ * Caller must hold zcache_rbnode->ra_lock
+ */
+static void *zcache_ra_delete(struct zcache_rbnode *rbnode,
+		unsigned long index)
+{
+	struct zcache_entry *entry;
+
+	entry = radix_tree_delete(&rbnode->ratree, index);
+	if (entry && entry != ZERO_HANDLE) {
+		spin_lock(&zcache_lru_lock);
+		list_del_init(&entry->lru);
+		spin_unlock(&zcache_lru_lock);
+	}
+	return entry;
+}
+
+/*
+ * Evict the least recently stored page. An rbnode emptied here stays in
+ * its rbtree until the next load, invalidation or store for its inode.
+ *
+ * Returns the size of the freed compressed data, 0 if nothing was evicted.
+ */
+#define ZCACHE_EVICT_TRIES 16
+static unsigned int zcache_evict_entry(void)
+{
+	struct zcache_entry *entry;
+	struct zcache_rbnode *rbnode;
+	unsigned long flags;
+	unsigned int zlen;
+	int tries = 0;
+
+	spin_lock_irqsave(&zcache_lru_lock, flags);
+	list_for_each_entry(entry, &zcache_lru, lru) {
+		/* ra_lock nests outside of the LRU lock, only try it */
+		if (spin_trylock(&entry->rbnode->ra_lock))
+			goto found;
+		if (++tries == ZCACHE_EVICT_TRIES)
+			break;
+	}
+	spin_unlock_irqrestore(&zcache_lru_lock, flags);
+	zcache_reclaim_fail++;
+	return 0;
+
+found:
+	rbnode = entry->rbnode;
+	radix_tree_delete(&rbnode->ratree, entry->ra_index);
+	list_del_init(&entry->lru);
+	spin_unlock(&rbnode->ra_lock);
+	spin_unlock_irqrestore(&zcache_lru_lock, flags);
+
+	zlen = entry->zlen;
+	zcache_entry_free(entry);
+	zcache_evict_zpages++;
+	return zlen;
+}
+
+/*
+ * Refault detection. The keys of pages that were refused or loaded back are
+ * remembered in two generations of a hashed bitmap: a key found in either
+ * one when its page is stored again means the page has been read back
+ * since, i.e. it is part of the working set. A generation is cleared and
+ * reused once as many keys went in as half of its bits.
+ */
+static unsigned long *zcache_ghost[2];
+static unsigned int zcache_ghost_shift;
+static int zcache_ghost_gen;
+static atomic_t zcache_ghost_count = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(zcache_ghost_lock);
+
+static u32 zcache_ghost_hash(int pool_id, struct cleancache_filekey key,
+		pgoff_t index)
+{
+	return jhash_3words(pool_id, key.u.ino, index, 0) &
+		((1U << zcache_ghost_shift) - 1);
+}
+
+static bool zcache_ghost_test(u32 hash)
+{
+	return test_bit(hash, zcache_ghost[0]) ||
+		test_bit(hash, zcache_ghost[1]);
+}
+
+static void zcache_ghost_add(u32 hash)
+{
+	unsigned long flags;
+
+	set_bit(hash, zcache_ghost[ACCESS_ONCE(zcache_ghost_gen)]);
+	if (atomic_inc_return(&zcache_ghost_count) <
+			(1 << (zcache_ghost_shift - 1)))
+		return;
+
+	if (!spin_trylock_irqsave(&zcache_ghost_lock, flags))
+		return;
+	if (atomic_read(&zcache_ghost_count) >=
+			(1 << (zcache_ghost_shift - 1))) {
+		int gen = !zcache_ghost_gen;
+
+		bitmap_zero(zcache_ghost[gen], 1 << zcache_ghost_shift);
+		zcache_ghost_gen = gen;
+		atomic_set(&zcache_ghost_count, 0);
+	}
+	spin_unlock_irqrestore(&zcache_ghost_lock, flags);
+}
+
+static int __init zcache_ghost_init(void)
+{
+	int shift = ilog2(roundup_pow_of_two(max(totalram_pages, 1UL << 10)));
+
+	zcache_ghost[0] = vzalloc(BITS_TO_LONGS(1 << shift) * sizeof(long));
+	zcache_ghost[1] = vzalloc(BITS_TO_LONGS(1 << shift) * sizeof(long));
+	if (!zcache_ghost[0] || !zcache_ghost[1]) {
+		vfree(zcache_ghost[0]);
+		vfree(zcache_ghost[1]);
+		return -ENOMEM;
+	}
+	zcache_ghost_shift = shift;
+	return 0;
+}
+
 static int zcache_shrink(struct shrinker *s, struct shrink_control *sc)
 {
 	unsigned long active_file;
@@ -183,7 +346,7 @@ static int zcache_shrink(struct shrinker *s, struct shrink_control *sc)
 	unsigned long freed = 0;
 	unsigned long pool;
 	static bool running;
-	int i = 0;
+	unsigned long bytes = 0;
 	int retries;
 
 	if (running)
@@ -215,26 +378,25 @@ static int zcache_shrink(struct shrinker *s, struct shrink_control *sc)
 		zcache_pool_shrink++;
 
 reclaim:
+	/* evict the oldest compressed pages until file_gap pages are freed */
 	retries = file_gap;
 	while ((file_gap > 0) && retries) {
-		struct zcache_pool *zpool =
-			zcache.pools[i++ % MAX_ZCACHE_POOLS];
-		if (!zpool || !zpool->size)
-			continue;
-		if (zbud_reclaim_page(zpool->pool, 8)) {
+		unsigned int zlen = zcache_evict_entry();
+
+		if (!zlen) {
 			zcache_pool_shrink_fail++;
 			retries--;
 			continue;
 		}
-		freed++;
-		file_gap--;
+		bytes += zlen;
+		while (bytes >= PAGE_SIZE) {
+			bytes -= PAGE_SIZE;
+			freed++;
+			file_gap--;
+		}
 	}
 
 	zcache_pool_shrink_pages += freed;
-	for (i = 0; (i < MAX_ZCACHE_POOLS) && zcache.pools[i]; i++)
-		zcache.pools[i]->size =
-			zbud_get_pool_size(zcache.pools[i]->pool);
-
 	running = false;
 end:
 	return freed;
@@ -246,138 +408,32 @@ static struct shrinker zcache_shrinker = {
 };
 
 /*
- * Compression functions
- * (Below functions are copyed from zswap!)
+ * Compression functions, using the zcomp backends of zram
  */
-static struct crypto_comp * __percpu *zcache_comp_pcpu_tfms;
-
-enum comp_op {
-	ZCACHE_COMPOP_COMPRESS,
-	ZCACHE_COMPOP_DECOMPRESS
-};
-
-static int zcache_comp_op(enum comp_op op, const u8 *src, unsigned int slen,
-				u8 *dst, unsigned int *dlen)
-{
-	struct crypto_comp *tfm;
-	int ret;
-
-	tfm = *per_cpu_ptr(zcache_comp_pcpu_tfms, get_cpu());
-	switch (op) {
-	case ZCACHE_COMPOP_COMPRESS:
-		ret = crypto_comp_compress(tfm, src, slen, dst, dlen);
-		break;
-	case ZCACHE_COMPOP_DECOMPRESS:
-		ret = crypto_comp_decompress(tfm, src, slen, dst, dlen);
-		break;
-	default:
-		ret = -EINVAL;
-	}
-
-	put_cpu();
-	return ret;
-}
-
 static int __init zcache_comp_init(void)
 {
-	if (!crypto_has_comp(zcache_compressor, 0, 0)) {
+	zcache_comp = zcomp_create(zcache_compressor, ZCOMP_STRM_PERCPU);
+	if (IS_ERR(zcache_comp)) {
 		pr_info("%s compressor not available\n", zcache_compressor);
 		/* fall back to default compressor */
 		zcache_compressor = ZCACHE_COMPRESSOR_DEFAULT;
-		if (!crypto_has_comp(zcache_compressor, 0, 0))
+		zcache_comp = zcomp_create(zcache_compressor,
+				ZCOMP_STRM_PERCPU);
+		if (IS_ERR(zcache_comp)) {
 			/* can't even load the default compressor */
+			zcache_comp = NULL;
 			return -ENODEV;
+		}
 	}
 	pr_info("using %s compressor\n", zcache_compressor);
-
-	/* alloc percpu transforms */
-	zcache_comp_pcpu_tfms = alloc_percpu(struct crypto_comp *);
-	if (!zcache_comp_pcpu_tfms)
-		return -ENOMEM;
 	return 0;
 }
 
 static void zcache_comp_exit(void)
 {
-	/* free percpu transforms */
-	if (zcache_comp_pcpu_tfms)
-		free_percpu(zcache_comp_pcpu_tfms);
-}
-
-/*
- * Per-cpu code
- * (Below functions are also copyed from zswap!)
- */
-static DEFINE_PER_CPU(u8 *, zcache_dstmem);
-
-static int __zcache_cpu_notifier(unsigned long action, unsigned long cpu)
-{
-	struct crypto_comp *tfm;
-	u8 *dst;
-
-	switch (action) {
-	case CPU_UP_PREPARE:
-		tfm = crypto_alloc_comp(zcache_compressor, 0, 0);
-		if (IS_ERR(tfm)) {
-			pr_err("can't allocate compressor transform\n");
-			return NOTIFY_BAD;
-		}
-		*per_cpu_ptr(zcache_comp_pcpu_tfms, cpu) = tfm;
-		dst = kmalloc(PAGE_SIZE * 2, GFP_KERNEL);
-		if (!dst) {
-			pr_err("can't allocate compressor buffer\n");
-			crypto_free_comp(tfm);
-			*per_cpu_ptr(zcache_comp_pcpu_tfms, cpu) = NULL;
-			return NOTIFY_BAD;
-		}
-		per_cpu(zcache_dstmem, cpu) = dst;
-		break;
-	case CPU_DEAD:
-	case CPU_UP_CANCELED:
-		tfm = *per_cpu_ptr(zcache_comp_pcpu_tfms, cpu);
-		if (tfm) {
-			crypto_free_comp(tfm);
-			*per_cpu_ptr(zcache_comp_pcpu_tfms, cpu) = NULL;
-		}
-		dst = per_cpu(zcache_dstmem, cpu);
-		kfree(dst);
-		per_cpu(zcache_dstmem, cpu) = NULL;
-		break;
-	default:
-		break;
-	}
-	return NOTIFY_OK;
-}
-
-static int zcache_cpu_notifier(struct notifier_block *nb,
-				unsigned long action, void *pcpu)
-{
-	unsigned long cpu = (unsigned long)pcpu;
-
-	return __zcache_cpu_notifier(action, cpu);
-}
-
-static struct notifier_block zcache_cpu_notifier_block = {
-	.notifier_call = zcache_cpu_notifier
-};
-
-static int zcache_cpu_init(void)
-{
-	unsigned long cpu;
-
-	get_online_cpus();
-	for_each_online_cpu(cpu)
-		if (__zcache_cpu_notifier(CPU_UP_PREPARE, cpu) != NOTIFY_OK)
-			goto cleanup;
-	register_cpu_notifier(&zcache_cpu_notifier_block);
-	put_online_cpus();
-	return 0;
-
-cleanup:
-	for_each_online_cpu(cpu)
-		__zcache_cpu_notifier(CPU_UP_CANCELED, cpu);
-	put_online_cpus();
-	return -ENOMEM;
+	if (zcache_comp)
+		zcomp_destroy(zcache_comp);
+	zcache_comp = NULL;
 }
 
 /*
@@ -494,10 +550,11 @@ static void zcache_rbnode_isolate(struct zcache_pool *zpool,
 }
 
 /*
- * Store zaddr which allocated by zbud_alloc() to the hierarchy rbtree-ratree.
+ * Store the entry of a compressed page (or ZERO_HANDLE) to the hierarchy
+ * rbtree-ratree, and put it at the young end of the LRU.
  */
 static int zcache_store_zaddr(struct zcache_pool *zpool,
-		int ra_index, int rb_index, unsigned long zaddr)
+		int ra_index, int rb_index, void *zaddr)
 {
 	unsigned long flags;
 	struct zcache_rbnode *rbnode, *tmp;
@@ -539,21 +596,25 @@ static int zcache_store_zaddr(struct zcache_pool *zpool,
 
 	/* Succfully got a zcache_rbnode when arriving here */
 	spin_lock_irqsave(&rbnode->ra_lock, flags);
-	dup_zaddr = radix_tree_delete(&rbnode->ratree, ra_index);
+	dup_zaddr = zcache_ra_delete(rbnode, ra_index);
 	if (unlikely(dup_zaddr)) {
-		if (dup_zaddr == ZERO_HANDLE) {
+		if (dup_zaddr == ZERO_HANDLE)
 			atomic_dec(&zcache_stored_zero_pages);
-		} else {
-			zbud_free(zpool->pool, (unsigned long)dup_zaddr);
-			atomic_dec(&zcache_stored_pages);
-			zpool->size = zbud_get_pool_size(zpool->pool);
-		}
+		else
+			zcache_entry_free(dup_zaddr);
 		zcache_dup_entry++;
 	}
 
-	/* Insert zcache_ra_handle to ratree */
-	ret = radix_tree_insert(&rbnode->ratree, ra_index,
-				(void *)zaddr);
+	/* Insert zcache_entry to ratree */
+	ret = radix_tree_insert(&rbnode->ratree, ra_index, zaddr);
+	if (!ret && zaddr != ZERO_HANDLE) {
+		struct zcache_entry *entry = zaddr;
+
+		entry->rbnode = rbnode;
+		spin_lock(&zcache_lru_lock);
+		list_add_tail(&entry->lru, &zcache_lru);
+		spin_unlock(&zcache_lru_lock);
+	}
 	spin_unlock_irqrestore(&rbnode->ra_lock, flags);
 	if (unlikely(ret)) {
 		write_lock_irqsave(&zpool->rb_lock, flags);
@@ -589,7 +650,7 @@ static void *zcache_load_delete_zaddr(struct zcache_pool *zpool,
 	BUG_ON(rbnode->rb_index != rb_index);
 
 	spin_lock_irqsave(&rbnode->ra_lock, flags);
-	zaddr = radix_tree_delete(&rbnode->ratree, ra_index);
+	zaddr = zcache_ra_delete(rbnode, ra_index);
 	spin_unlock_irqrestore(&rbnode->ra_lock, flags);
 
 	/* rb_lock and ra_lock must be taken again in the given sequence */
@@ -624,23 +685,31 @@ out:
 static void zcache_store_page(int pool_id, struct cleancache_filekey key,
 		pgoff_t index, struct page *page)
 {
-	struct zcache_ra_handle *zhandle;
-	u8 *zpage, *src, *dst;
-	/* Address of zhandle + compressed data(zpage) */
-	unsigned long zaddr = 0;
-	unsigned int zlen = PAGE_SIZE;
+	struct zcache_entry *entry = NULL;
+	struct zcomp_strm *zstrm;
+	u8 *src, *dst;
+	size_t zlen = PAGE_SIZE;
 	bool zero = 0;
+	u32 hash;
 	int ret;
 
 	struct zcache_pool *zpool = zcache.pools[pool_id];
 
 	/*
 	 * Zcache will be ineffective if the compressed memory pool is full with
-	 * compressed inactive file pages and most of them will never be used
-	 * again.
-	 * So we refuse to compress pages that are not from active file list.
+	 * compressed file pages and most of them will never be used again.
+	 * So we only take pages that came back after a previous eviction, or
+	 * without refault admission, pages that were on the active file list.
 	 */
-	if (!PageWasActive(page)) {
+	hash = zcache_ghost_hash(pool_id, key, index);
+	if (zcache_refault_admission) {
+		if (!zcache_ghost_test(hash)) {
+			zcache_ghost_add(hash);
+			zcache_inactive_pages_refused++;
+			return;
+		}
+		zcache_refault_admitted++;
+	} else if (!PageWasActive(page)) {
 		zcache_inactive_pages_refused++;
 		return;
 	}
@@ -651,72 +720,76 @@ static void zcache_store_page(int pool_id, struct cleancache_filekey key,
 
 	if (zcache_is_full()) {
 		zcache_pool_limit_hit++;
-		if (zbud_reclaim_page(zpool->pool, 8)) {
-			zcache_reclaim_fail++;
+		if (!zcache_evict_entry())
 			return;
-		}
 		/*
-		 * Continue if reclaimed a page frame succ.
+		 * Continue if the oldest page was evicted succ.
 		 */
 		zcache_evict_filepages++;
-		zpool->size = zbud_get_pool_size(zpool->pool);
 	}
 
-	/* compress */
-	dst = get_cpu_var(zcache_dstmem);
+	entry = kmem_cache_alloc(zcache_entry_cache, GFP_ZCACHE);
+	if (!entry) {
+		zcache_store_failed++;
+		return;
+	}
+	INIT_LIST_HEAD(&entry->lru);
+
+	/* compress, we run with the mapping's tree_lock held: no sleeping */
+	zstrm = zcomp_strm_find_nowait(zcache_comp);
+	if (!zstrm) {
+		zcache_store_failed++;
+		goto free_entry;
+	}
 	src = kmap_atomic(page);
-	ret = zcache_comp_op(ZCACHE_COMPOP_COMPRESS, src, PAGE_SIZE, dst,
-			&zlen);
+	ret = zcomp_compress(zcache_comp, zstrm, src, &zlen);
 	kunmap_atomic(src);
 	if (ret) {
 		pr_err("zcache compress error ret %d\n", ret);
-		put_cpu_var(zcache_dstmem);
-		return;
+		goto release;
+	}
+	if (zlen > ZCACHE_MAX_ZLEN) {
+		/* not worth the memory, the page can be read back */
+		zcache_store_failed++;
+		goto release;
 	}
 
-	/* store zcache handle together with compressed page data */
-	ret = zbud_alloc(zpool->pool, zlen + sizeof(struct zcache_ra_handle),
-			GFP_ZCACHE, &zaddr);
-	if (ret) {
-		zcache_zbud_alloc_fail++;
-		put_cpu_var(zcache_dstmem);
-		return;
+	entry->handle = zs_malloc(zcache_zs_pool, zlen);
+	if (!entry->handle) {
+		zcache_zs_alloc_fail++;
+		goto release;
 	}
 
-	zhandle = (struct zcache_ra_handle *)zbud_map(zpool->pool, zaddr);
+	dst = zs_map_object(zcache_zs_pool, entry->handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, zlen);
+	zs_unmap_object(zcache_zs_pool, entry->handle);
+	zcomp_strm_release(zcache_comp, zstrm);
 
-	/* Compressed page data stored at the end of zcache_ra_handle */
-	zpage = (u8 *)(zhandle + 1);
-	memcpy(zpage, dst, zlen);
-	zbud_unmap(zpool->pool, zaddr);
-	put_cpu_var(zcache_dstmem);
+	entry->ra_index = index;
+	entry->zlen = zlen;
+	atomic_inc(&zcache_stored_pages);
 
 zero:
-	if (zero)
-		zaddr = (unsigned long)ZERO_HANDLE;
-
 	/* store zcache handle */
-	ret = zcache_store_zaddr(zpool, index, key.u.ino, zaddr);
+	ret = zcache_store_zaddr(zpool, index, key.u.ino,
+			zero ? ZERO_HANDLE : entry);
 	if (ret) {
 		zcache_store_failed++;
 		if (!zero)
-			zbud_free(zpool->pool, zaddr);
+			zcache_entry_free(entry);
 		return;
 	}
 
 	/* update stats */
-	if (zero) {
+	if (zero)
 		atomic_inc(&zcache_stored_zero_pages);
-	} else {
-		zhandle->ra_index = index;
-		zhandle->rb_index = key.u.ino;
-		zhandle->zlen = zlen;
-		zhandle->zpool = zpool;
-		atomic_inc(&zcache_stored_pages);
-		zpool->size = zbud_get_pool_size(zpool->pool);
-	}
 
 	return;
+
+release:
+	zcomp_strm_release(zcache_comp, zstrm);
+free_entry:
+	kmem_cache_free(zcache_entry_cache, entry);
 }
 
 static int zcache_load_page(int pool_id, struct cleancache_filekey key,
@@ -724,46 +797,34 @@ static int zcache_load_page(int pool_id, struct cleancache_filekey key,
 {
 	int ret = 0;
 	u8 *src, *dst;
-	void *zaddr;
-	unsigned int dlen = PAGE_SIZE;
-	struct zcache_ra_handle *zhandle;
+	struct zcache_entry *entry;
 	struct zcache_pool *zpool = zcache.pools[pool_id];
 
-	zaddr = zcache_load_delete_zaddr(zpool, key.u.ino, index);
-	if (!zaddr)
+	entry = zcache_load_delete_zaddr(zpool, key.u.ino, index);
+	if (!entry)
 		return -ENOENT;
-	else if (zaddr == ZERO_HANDLE)
-		goto map;
 
-	zhandle = (struct zcache_ra_handle *)zbud_map(zpool->pool,
-			(unsigned long)zaddr);
-	/* Compressed page data stored at the end of zcache_ra_handle */
-	src = (u8 *)(zhandle + 1);
-
-	/* decompress */
-map:
 	dst = kmap_atomic(page);
-	if (zaddr != ZERO_HANDLE) {
-		ret = zcache_comp_op(ZCACHE_COMPOP_DECOMPRESS, src,
-				zhandle->zlen, dst, &dlen);
-	} else {
+	if (entry == ZERO_HANDLE) {
 		memset(dst, 0, PAGE_SIZE);
 		kunmap_atomic(dst);
 		flush_dcache_page(page);
 		atomic_dec(&zcache_stored_zero_pages);
 		goto out;
 	}
+
+	/* decompress */
+	src = zs_map_object(zcache_zs_pool, entry->handle, ZS_MM_RO);
+	ret = zcomp_decompress(zcache_comp, src, entry->zlen, dst);
+	zs_unmap_object(zcache_zs_pool, entry->handle);
 	kunmap_atomic(dst);
-	zbud_unmap(zpool->pool, (unsigned long)zaddr);
-	zbud_free(zpool->pool, (unsigned long)zaddr);
+	flush_dcache_page(page);
+	zcache_entry_free(entry);
 
 	BUG_ON(ret);
-	BUG_ON(dlen != PAGE_SIZE);
-
-	/* update stats */
-	atomic_dec(&zcache_stored_pages);
-	zpool->size = zbud_get_pool_size(zpool->pool);
 out:
+	/* a page read back from zcache is admitted again on its eviction */
+	zcache_ghost_add(zcache_ghost_hash(pool_id, key, index));
 	SetPageWasActive(page);
 	return ret;
 }
@@ -775,13 +836,10 @@ static void zcache_flush_page(int pool_id, struct cleancache_filekey key,
 	void *zaddr = NULL;
 
 	zaddr = zcache_load_delete_zaddr(zpool, key.u.ino, index);
-	if (zaddr && (zaddr != ZERO_HANDLE)) {
-		zbud_free(zpool->pool, (unsigned long)zaddr);
-		atomic_dec(&zcache_stored_pages);
-		zpool->size = zbud_get_pool_size(zpool->pool);
-	} else if (zaddr == ZERO_HANDLE) {
+	if (zaddr && (zaddr != ZERO_HANDLE))
+		zcache_entry_free(zaddr);
+	else if (zaddr == ZERO_HANDLE)
 		atomic_dec(&zcache_stored_zero_pages);
-	}
 }
 
 #define FREE_BATCH 16
@@ -793,7 +851,6 @@ static void zcache_flush_ratree(struct zcache_pool *zpool,
 {
 	unsigned long index = 0;
 	int count, i;
-	struct zcache_ra_handle *zhandle;
 	void *zaddr = NULL;
 
 	do {
@@ -805,23 +862,14 @@ static void zcache_flush_ratree(struct zcache_pool *zpool,
 				index, FREE_BATCH);
 
 		for (i = 0; i < count; i++) {
-			if (zaddrs[i] == ZERO_HANDLE) {
-				zaddr = radix_tree_delete(&rbnode->ratree,
-					indices[i]);
-				if (zaddr)
-					atomic_dec(&zcache_stored_zero_pages);
-				continue;
-			}
-			zhandle = (struct zcache_ra_handle *)zbud_map(
-					zpool->pool, (unsigned long)zaddrs[i]);
-			index = zhandle->ra_index;
-			zaddr = radix_tree_delete(&rbnode->ratree, index);
+			index = indices[i];
+			zaddr = zcache_ra_delete(rbnode, index);
 			if (!zaddr)
 				continue;
-			zbud_unmap(zpool->pool, (unsigned long)zaddrs[i]);
-			zbud_free(zpool->pool, (unsigned long)zaddrs[i]);
-			atomic_dec(&zcache_stored_pages);
-			zpool->size = zbud_get_pool_size(zpool->pool);
+			if (zaddr == ZERO_HANDLE)
+				atomic_dec(&zcache_stored_zero_pages);
+			else
+				zcache_entry_free(zaddr);
 		}
 
 		index++;
@@ -897,44 +945,6 @@ static void zcache_flush_fs(int pool_id)
 	zcache_destroy_pool(zpool);
 }
 
-/*
- * Evict compressed pages from zcache pool on an LRU basis after the compressed
- * pool is full.
- */
-static int zcache_evict_zpage(struct zbud_pool *pool, unsigned long zaddr)
-{
-	struct zcache_pool *zpool;
-	struct zcache_ra_handle *zhandle;
-	void *zaddr_intree;
-
-	BUG_ON(zaddr == (unsigned long)ZERO_HANDLE);
-
-	zhandle = (struct zcache_ra_handle *)zbud_map(pool, zaddr);
-
-	zpool = zhandle->zpool;
-	/* There can be a race with zcache store */
-	if (!zpool)
-		return -EINVAL;
-
-	BUG_ON(pool != zpool->pool);
-
-	zaddr_intree = zcache_load_delete_zaddr(zpool, zhandle->rb_index,
-			zhandle->ra_index);
-	if (zaddr_intree) {
-		BUG_ON((unsigned long)zaddr_intree != zaddr);
-		zbud_unmap(pool, zaddr);
-		zbud_free(pool, zaddr);
-		atomic_dec(&zcache_stored_pages);
-		zpool->size = zbud_get_pool_size(pool);
-		zcache_evict_zpages++;
-	}
-	return 0;
-}
-
-static struct zbud_ops zcache_zbud_ops = {
-	.evict = zcache_evict_zpage
-};
-
 /* Return pool id */
 static int zcache_create_pool(void)
 {
@@ -947,17 +957,9 @@ static int zcache_create_pool(void)
 		goto out;
 	}
 
-	zpool->pool = zbud_create_pool(GFP_KERNEL, &zcache_zbud_ops);
-	if (!zpool->pool) {
-		kfree(zpool);
-		ret = -ENOMEM;
-		goto out;
-	}
-
 	spin_lock(&zcache.pool_lock);
 	if (zcache.num_pools == MAX_ZCACHE_POOLS) {
 		pr_err("Cannot create new pool (limit:%u)\n", MAX_ZCACHE_POOLS);
-		zbud_destroy_pool(zpool->pool);
 		kfree(zpool);
 		ret = -EPERM;
 		goto out_unlock;
@@ -997,7 +999,6 @@ static void zcache_destroy_pool(struct zcache_pool *zpool)
 	if (!RB_EMPTY_ROOT(&zpool->rbtree))
 		WARN_ON("Memory leak detected. Freeing non-empty pool!\n");
 
-	zbud_destroy_pool(zpool->pool);
 	kfree(zpool);
 }
 
@@ -1065,7 +1066,7 @@ static int __init zcache_debugfs_init(void)
 	debugfs_create_u64("pool_limit_hit", S_IRUGO, zcache_debugfs_root,
 			&zcache_pool_limit_hit);
 	debugfs_create_u64("reject_alloc_fail", S_IRUGO, zcache_debugfs_root,
-			&zcache_zbud_alloc_fail);
+			&zcache_zs_alloc_fail);
 	debugfs_create_u64("duplicate_entry", S_IRUGO, zcache_debugfs_root,
 			&zcache_dup_entry);
 	debugfs_create_file("pool_pages", S_IRUGO, zcache_debugfs_root, NULL,
@@ -1090,6 +1091,8 @@ static int __init zcache_debugfs_init(void)
 			zcache_debugfs_root, &zcache_pool_shrink_pages);
 	debugfs_create_u64("store_fail", S_IRUGO,
 			zcache_debugfs_root, &zcache_store_failed);
+	debugfs_create_u64("refault_admitted", S_IRUGO,
+			zcache_debugfs_root, &zcache_refault_admitted);
 	return 0;
 }
 
@@ -1125,9 +1128,14 @@ static int __init init_zcache(void)
 		pr_err("compressor initialization failed\n");
 		goto compfail;
 	}
-	if (zcache_cpu_init()) {
-		pr_err("per-cpu initialization failed\n");
-		goto pcpufail;
+	zcache_zs_pool = zs_create_pool("zcache", GFP_ZCACHE | __GFP_HIGHMEM);
+	if (!zcache_zs_pool) {
+		pr_err("zsmalloc pool creation failed\n");
+		goto poolfail;
+	}
+	if (zcache_ghost_init()) {
+		pr_err("refault filter allocation failed\n");
+		goto ghostfail;
 	}
 
 	spin_lock_init(&zcache.pool_lock);
@@ -1137,7 +1145,10 @@ static int __init init_zcache(void)
 		pr_warn("debugfs initialization failed\n");
 	register_shrinker(&zcache_shrinker);
 	return 0;
-pcpufail:
+ghostfail:
+	zs_destroy_pool(zcache_zs_pool);
+	zcache_zs_pool = NULL;
+poolfail:
 	zcache_comp_exit();
 compfail:
 	zcache_rbnode_cache_destroy();
@@ -1145,7 +1156,7 @@ error:
 	return -ENOMEM;
 }
 
-/* must be late so crypto has time to come up */
+/* must be late so zsmalloc has time to come up */
 late_initcall(init_zcache);
 
 MODULE_LICENSE("GPL");
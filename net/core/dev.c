@@ -135,6 +135,7 @@
 #include <linux/net_tstamp.h>
 #include <linux/static_key.h>
 #include <net/flow_keys.h>
+#include <net/busy_poll.h>
 
 #include "net-sysfs.h"
 
@@ -3563,6 +3564,7 @@ EXPORT_SYMBOL(skb_gro_reset_offset);
 
 gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
+	skb_mark_napi_id(skb, napi);
 	skb_gro_reset_offset(skb);
 
 	return napi_skb_finish(__napi_gro_receive(napi, skb), skb);
@@ -3778,7 +3780,8 @@ void __napi_complete(struct napi_struct *n)
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
 	BUG_ON(n->gro_list);
 
-	list_del(&n->poll_list);
+	/* a busy polled napi is on no poll_list, keep it a valid empty one */
+	list_del_init(&n->poll_list);
 	smp_mb__before_clear_bit();
 	clear_bit(NAPI_STATE_SCHED, &n->state);
 }
@@ -3802,6 +3805,132 @@ void napi_complete(struct napi_struct *n)
 }
 EXPORT_SYMBOL(napi_complete);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+unsigned int sysctl_net_busy_read __read_mostly;
+
+/* NAPI contexts that sockets may busy poll, by napi_id */
+static DEFINE_SPINLOCK(napi_hash_lock);
+static unsigned int napi_gen_id;
+#define NAPI_HASH_SIZE		256
+static struct hlist_head napi_hash[NAPI_HASH_SIZE];
+
+/* Packets handed up by one poll call of sk_busy_loop() */
+#define BUSY_POLL_BUDGET	8
+
+static inline u64 busy_loop_us_clock(void)
+{
+	return local_clock() >> 10;
+}
+
+struct napi_struct *napi_by_id(unsigned int napi_id)
+{
+	struct napi_struct *napi;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(napi, node,
+			&napi_hash[napi_id & (NAPI_HASH_SIZE - 1)],
+			napi_hash_node)
+		if (napi->napi_id == napi_id)
+			return napi;
+
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(napi_by_id);
+
+void napi_hash_add(struct napi_struct *napi)
+{
+	if (test_and_set_bit(NAPI_STATE_HASHED, &napi->state))
+		return;
+
+	spin_lock(&napi_hash_lock);
+
+	/* 0 is not a valid id, we also skip an id that is taken */
+	do {
+		if (unlikely(++napi_gen_id == 0))
+			napi_gen_id = 1;
+	} while (napi_by_id(napi_gen_id));
+	napi->napi_id = napi_gen_id;
+
+	hlist_add_head_rcu(&napi->napi_hash_node,
+			   &napi_hash[napi->napi_id & (NAPI_HASH_SIZE - 1)]);
+
+	spin_unlock(&napi_hash_lock);
+}
+EXPORT_SYMBOL_GPL(napi_hash_add);
+
+/* Returns true if @napi was hashed, and a grace period must pass */
+static bool napi_hash_del(struct napi_struct *napi)
+{
+	if (!test_and_clear_bit(NAPI_STATE_HASHED, &napi->state))
+		return false;
+
+	spin_lock(&napi_hash_lock);
+	hlist_del_rcu(&napi->napi_hash_node);
+	spin_unlock(&napi_hash_lock);
+
+	return true;
+}
+
+/**
+ * sk_busy_loop - poll the NAPI context a socket last received from
+ * @sk: socket with an empty receive queue
+ * @nonblock: poll only once instead of for up to sk_ll_usec
+ *
+ * The poll routine is run the way net_rx_action() runs it, after taking
+ * NAPI_STATE_SCHED, so it never races with the softirq or another busy
+ * poller. A context that is already scheduled is left to its owner. The
+ * driver's own napi_complete() re-arms its interrupt as usual.
+ *
+ * Returns true if the receive queue of @sk is no longer empty.
+ */
+bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	u64 end_time = busy_loop_us_clock() + ACCESS_ONCE(sk->sk_ll_usec);
+	struct napi_struct *napi;
+	bool rc = false;
+	void *have;
+	int work;
+
+	rcu_read_lock();
+
+	napi = napi_by_id(sk->sk_napi_id);
+	if (!napi)
+		goto out;
+
+	do {
+		local_bh_disable();
+		if (napi_schedule_prep(napi)) {
+			have = netpoll_poll_lock(napi);
+			work = napi->poll(napi, BUSY_POLL_BUDGET);
+			trace_napi_poll(napi);
+			/* more work pending, hand it back to the softirq */
+			if (work == BUSY_POLL_BUDGET) {
+				napi_complete(napi);
+				napi_schedule(napi);
+			}
+			netpoll_poll_unlock(have);
+		}
+		local_bh_enable();
+
+		rc = !skb_queue_empty(&sk->sk_receive_queue);
+		if (rc || nonblock)
+			break;
+		cpu_relax();
+	} while (!need_resched() && !signal_pending(current) &&
+		 time_before64(busy_loop_us_clock(), end_time));
+
+out:
+	rcu_read_unlock();
+	return rc;
+}
+EXPORT_SYMBOL(sk_busy_loop);
+#else
+static inline bool napi_hash_del(struct napi_struct *napi)
+{
+	return false;
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -3836,6 +3965,10 @@ void netif_napi_del(struct napi_struct *napi)
 
 	napi->gro_list = NULL;
 	napi->gro_count = 0;
+
+	/* busy pollers may still be looking at it under RCU */
+	if (napi_hash_del(napi))
+		synchronize_net();
 }
 EXPORT_SYMBOL(netif_napi_del);
 
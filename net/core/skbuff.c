@@ -582,6 +582,168 @@ bool skb_recycle_check(struct sk_buff *skb, int skb_size)
 }
 EXPORT_SYMBOL(skb_recycle_check);
 
+/*
+ * Per device receive buffer recycling. A driver creates a pool for the
+ * size of its receive buffers, allocates them with skb_recycle_pool_alloc()
+ * and hands the skbs it frees itself (drops, consumed control messages, tx
+ * completions) to skb_recycle_pool_free(). The skbs that can be reused are
+ * kept on a list of the local CPU, so the next receive replenish on that
+ * CPU needs neither the slab allocator nor a cache miss on a remote list.
+ */
+struct skb_recycle_cpu {
+	struct sk_buff_head list;
+	struct skb_recycle_stats stats;
+};
+
+struct skb_recycle_pool {
+	struct skb_recycle_cpu __percpu *cpu;
+	unsigned int skb_size;
+	unsigned int max;
+};
+
+/**
+ *	skb_recycle_pool_create - create an skb recycling pool
+ *	@skb_size: size of the receive buffers, as given to __netdev_alloc_skb()
+ *	@max: maximal number of skbs kept per CPU
+ *
+ *	Returns the pool, or %NULL on allocation failure.
+ */
+struct skb_recycle_pool *skb_recycle_pool_create(unsigned int skb_size,
+						 unsigned int max)
+{
+	struct skb_recycle_pool *pool;
+	int cpu;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	pool->cpu = alloc_percpu(struct skb_recycle_cpu);
+	if (!pool->cpu) {
+		kfree(pool);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu)
+		skb_queue_head_init(&per_cpu_ptr(pool->cpu, cpu)->list);
+	pool->skb_size = skb_size;
+	pool->max = max;
+
+	return pool;
+}
+EXPORT_SYMBOL(skb_recycle_pool_create);
+
+/**
+ *	skb_recycle_pool_destroy - free a pool and the skbs it holds
+ *	@pool: pool to destroy
+ */
+void skb_recycle_pool_destroy(struct skb_recycle_pool *pool)
+{
+	int cpu;
+
+	if (!pool)
+		return;
+
+	for_each_possible_cpu(cpu)
+		skb_queue_purge(&per_cpu_ptr(pool->cpu, cpu)->list);
+	free_percpu(pool->cpu);
+	kfree(pool);
+}
+EXPORT_SYMBOL(skb_recycle_pool_destroy);
+
+/**
+ *	skb_recycle_pool_alloc - allocate a receive buffer
+ *	@pool: pool to take the buffer from
+ *	@dev: network device to receive on
+ *	@gfp_mask: get_free_pages mask, used when the pool is empty
+ *
+ *	Returns a buffer of the pool size with NET_SKB_PAD headroom, like
+ *	__netdev_alloc_skb(), recycled on the local CPU when possible.
+ */
+struct sk_buff *skb_recycle_pool_alloc(struct skb_recycle_pool *pool,
+				       struct net_device *dev, gfp_t gfp_mask)
+{
+	struct skb_recycle_cpu *rc;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	rc = this_cpu_ptr(pool->cpu);
+	skb = __skb_dequeue(&rc->list);
+	if (skb)
+		rc->stats.alloc_hits++;
+	else
+		rc->stats.alloc_misses++;
+	local_irq_restore(flags);
+
+	if (skb) {
+		skb->dev = dev;
+		return skb;
+	}
+
+	return __netdev_alloc_skb(dev, pool->skb_size, gfp_mask);
+}
+EXPORT_SYMBOL(skb_recycle_pool_alloc);
+
+/**
+ *	skb_recycle_pool_free - free an skb, keeping it for reuse if possible
+ *	@pool: pool to give the buffer back to
+ *	@skb: buffer to free
+ *
+ *	The skb is kept when skb_recycle_check() accepts it for the pool size
+ *	and the local CPU list is not full, it is freed otherwise. The check
+ *	never recycles with interrupts disabled, those skbs are just freed.
+ */
+void skb_recycle_pool_free(struct skb_recycle_pool *pool, struct sk_buff *skb)
+{
+	struct skb_recycle_cpu *rc;
+	unsigned long flags;
+	bool recycled = false;
+
+	if (skb_recycle_check(skb, pool->skb_size)) {
+		local_irq_save(flags);
+		rc = this_cpu_ptr(pool->cpu);
+		if (skb_queue_len(&rc->list) < pool->max) {
+			__skb_queue_head(&rc->list, skb);
+			rc->stats.recycled++;
+			recycled = true;
+		} else {
+			rc->stats.dropped++;
+		}
+		local_irq_restore(flags);
+	} else {
+		local_irq_save(flags);
+		this_cpu_ptr(pool->cpu)->stats.dropped++;
+		local_irq_restore(flags);
+	}
+
+	if (!recycled)
+		dev_kfree_skb_any(skb);
+}
+EXPORT_SYMBOL(skb_recycle_pool_free);
+
+/**
+ *	skb_recycle_pool_stats - sum the counters of a pool over all CPUs
+ *	@pool: pool to read
+ *	@stats: filled with the totals
+ */
+void skb_recycle_pool_stats(struct skb_recycle_pool *pool,
+			    struct skb_recycle_stats *stats)
+{
+	struct skb_recycle_stats *s;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	for_each_possible_cpu(cpu) {
+		s = &per_cpu_ptr(pool->cpu, cpu)->stats;
+		stats->alloc_hits += s->alloc_hits;
+		stats->alloc_misses += s->alloc_misses;
+		stats->recycled += s->recycled;
+		stats->dropped += s->dropped;
+	}
+}
+EXPORT_SYMBOL(skb_recycle_pool_stats);
+
 static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 {
 	new->tstamp		= old->tstamp;
@@ -623,6 +785,10 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->vlan_tci		= old->vlan_tci;
 
 	skb_copy_secmark(new, old);
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id	= old->napi_id;
+#endif
 }
 
 /*
@@ -18,6 +18,7 @@
 
 #include <net/ip.h>
 #include <net/sock.h>
+#include <net/busy_poll.h>
 #include <net/net_ratelimit.h>
 
 static int zero = 0;
@@ -184,6 +185,15 @@ static struct ctl_table net_core_table[] = {
 	},
 #endif
 #endif /* CONFIG_NET */
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	{
+		.procname	= "busy_read",
+		.data		= &sysctl_net_busy_read,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec
+	},
+#endif
 	{
 		.procname	= "netdev_budget",
 		.data		= &netdev_budget,
@@ -46,6 +46,7 @@ static int tcp_delack_seg_min = TCP_DELACK_MIN;
 static int tcp_delack_seg_max = 60;
 static int tcp_use_userconfig_min;
 static int tcp_use_userconfig_max = 1;
+static int tcp_stretch_ack_ms_max = 500;
 
 /* Update system visible IP port range */
 static void set_local_port_range(int range[2])
@@ -830,6 +831,32 @@ static struct ctl_table ipv4_table[] = {
 		.extra1		    = &tcp_use_userconfig_min,
 		.extra2		    = &tcp_use_userconfig_max,
 	},
+	{
+		.procname	= "tcp_stretch_ack",
+		.data		= &sysctl_tcp_stretch_ack,
+		.maxlen		= sizeof(sysctl_tcp_stretch_ack),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+	{
+		.procname	= "tcp_stretch_ack_bytes",
+		.data		= &sysctl_tcp_stretch_ack_bytes,
+		.maxlen		= sizeof(sysctl_tcp_stretch_ack_bytes),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "tcp_stretch_ack_ms",
+		.data		= &sysctl_tcp_stretch_ack_ms,
+		.maxlen		= sizeof(sysctl_tcp_stretch_ack_ms),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &tcp_stretch_ack_ms_max,
+	},
 
 	{ }
 };
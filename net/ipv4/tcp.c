@@ -302,6 +302,15 @@ EXPORT_SYMBOL(sysctl_tcp_delack_seg);
 int sysctl_tcp_use_userconfig __read_mostly;
 EXPORT_SYMBOL(sysctl_tcp_use_userconfig);
 
+int sysctl_tcp_stretch_ack __read_mostly;
+EXPORT_SYMBOL(sysctl_tcp_stretch_ack);
+
+int sysctl_tcp_stretch_ack_bytes __read_mostly = TCP_STRETCH_ACK_BYTES;
+EXPORT_SYMBOL(sysctl_tcp_stretch_ack_bytes);
+
+int sysctl_tcp_stretch_ack_ms __read_mostly = TCP_STRETCH_ACK_MS;
+EXPORT_SYMBOL(sysctl_tcp_stretch_ack_ms);
+
 atomic_long_t tcp_memory_allocated;	/* Current allocated memory. */
 EXPORT_SYMBOL(tcp_memory_allocated);
 
@@ -1243,11 +1252,10 @@ void tcp_cleanup_rbuf(struct sock *sk, int copied)
 		   /* Delayed ACKs frequently hit locked sockets during bulk
 		    * receive. */
 		if (icsk->icsk_ack.blocked ||
-		    /* Once-per-sysctl_tcp_delack_seg segments
+		    /* Once-per-tcp_delack_thresh() bytes
 			  * ACK was not sent by tcp_input.c
 			  */
-		    tp->rcv_nxt - tp->rcv_wup > (icsk->icsk_ack.rcv_mss) *
-						sysctl_tcp_delack_seg ||
+		    tp->rcv_nxt - tp->rcv_wup > tcp_delack_thresh(sk) ||
 		    /*
 		     * If this read emptied read buffer, we send ACK, if
 		     * connection is not bidirectional, user drained
@@ -2354,6 +2362,13 @@ static int do_tcp_setsockopt(struct sock *sk, int level,
 			tp->thin_dupack = val;
 		break;
 
+	case TCP_STRETCH_ACK:
+		if (val < 0 || val > 1)
+			err = -EINVAL;
+		else
+			tp->stretch_ack = val;
+		break;
+
 	case TCP_CORK:
 		/* When set indicates to always queue non-full frames.
 		 * Later the user clears this option and we transmit
@@ -2712,6 +2727,10 @@ static int do_tcp_getsockopt(struct sock *sk, int level,
 		val = tp->thin_dupack;
 		break;
 
+	case TCP_STRETCH_ACK:
+		val = tp->stretch_ack;
+		break;
+
 	case TCP_USER_TIMEOUT:
 		val = jiffies_to_msecs(icsk->icsk_user_timeout);
 		break;
@@ -1909,6 +1909,7 @@ static int tcp_v4_init_sock(struct sock *sk)
 	u64_stats_init(&tp->syncp);
 
 	tp->reordering = sysctl_tcp_reordering;
+	tp->stretch_ack = !!sysctl_tcp_stretch_ack;
 	icsk->icsk_ca_ops = &tcp_init_congestion_ops;
 
 	sk->sk_state = TCP_CLOSE;
@@ -2892,6 +2892,12 @@ void tcp_send_delayed_ack(struct sock *sk)
 		ato = min(ato, max_ato);
 	}
 
+	/* Stretched ACKs are still sent within the configured delay */
+	if (tcp_sk(sk)->stretch_ack)
+		ato = min_t(int, ato,
+			    max_t(int, msecs_to_jiffies(sysctl_tcp_stretch_ack_ms),
+				  1));
+
 	/* Stay within the limit we were given */
 	timeout = jiffies + ato;
 
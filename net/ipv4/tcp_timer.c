@@ -40,6 +40,7 @@ static void tcp_keepalive_timer(unsigned long data);
 void set_tcp_default(void)
 {
 	sysctl_tcp_delack_seg	= TCP_DELACK_SEG;
+	sysctl_tcp_stretch_ack	= 0;
 }
 
 /*sysctl handler for tcp_ack realted master control */
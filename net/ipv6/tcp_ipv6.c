@@ -1875,6 +1875,7 @@ static int tcp_v6_init_sock(struct sock *sk)
 	tp->mss_cache = TCP_MSS_DEFAULT;
 
 	tp->reordering = sysctl_tcp_reordering;
+	tp->stretch_ack = !!sysctl_tcp_stretch_ack;
 
 	sk->sk_state = TCP_CLOSE;
 
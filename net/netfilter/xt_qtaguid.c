@@ -15,6 +15,7 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
@@ -187,6 +188,7 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
+ *       (tag_stat_cache, lockless on a hit)
  *       get_sock_stat()
  *         sock_tag_list_lock
  *       struct iface_stat->tag_stat_list_lock
@@ -235,6 +237,10 @@ static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
 static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
+static DEFINE_PER_CPU(struct tag_stat_cache_entry [1 << TAG_STAT_CACHE_BITS],
+		      tag_stat_cache);
+static atomic_t tag_stat_cache_gen = ATOMIC_INIT(0);
+
 static struct qtaguid_event_counts qtu_events;
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
@@ -1367,20 +1373,88 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 	spin_unlock_bh(&iface_stat_list_lock);
 }
 
-static void tag_stat_update(struct tag_stat *tag_entry,
+/*
+ * Forget every cached {sk, uid, dev} -> tag_stat mapping.
+ * Must be called after the change is made and before anything the cache
+ * could point to is freed.
+ */
+static void tag_stat_cache_invalidate(void)
+{
+	atomic_inc(&tag_stat_cache_gen);
+}
+
+static struct tag_stat_cache_entry *
+tag_stat_cache_entry(const struct sock *sk, const struct net_device *dev,
+		     uid_t uid)
+{
+	u32 key = (u32)(unsigned long)sk ^ (u32)(unsigned long)dev ^ uid;
+
+	return &__get_cpu_var(tag_stat_cache)[hash_32(key,
+						      TAG_STAT_CACHE_BITS)];
+}
+
+/* Bottom halves must be disabled */
+static void tag_stat_counters_update(struct tag_stat *tag_entry,
+				     int active_set, enum ifs_tx_rx direction,
+				     int proto, int bytes)
+{
+	struct tag_stat_counters *tsc;
+
+	tsc = &tag_entry->counters[smp_processor_id()];
+	u64_stats_update_begin(&tsc->syncp);
+	data_counters_update(&tsc->dc, active_set, direction, proto, bytes);
+	u64_stats_update_end(&tsc->syncp);
+}
+
+/* Bottom halves must be disabled */
+static void tag_stat_update(struct tag_stat *tag_entry, int active_set,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
-	int active_set;
-	active_set = get_active_counter_set(tag_entry->tn.tag);
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+	tag_stat_counters_update(tag_entry, active_set, direction,
+				 proto, bytes);
+	if (tag_entry->parent)
+		tag_stat_counters_update(tag_entry->parent, active_set,
+					 direction, proto, bytes);
+}
+
+/*
+ * Add up the per cpu buckets of a tag_stat. This is the only place the
+ * counters get folded, so it is done when the stats are read.
+ */
+void tag_stat_get_counters(struct tag_stat *ts, struct data_counters *dc)
+{
+	struct tag_stat_counters *tsc;
+	struct data_counters tmp;
+	unsigned int start;
+	int cpu, set, dir, proto;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		tsc = &ts->counters[cpu];
+		do {
+			start = u64_stats_fetch_begin_bh(&tsc->syncp);
+			tmp = tsc->dc;
+		} while (u64_stats_fetch_retry_bh(&tsc->syncp, start));
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS; proto++)
+					dc_add_byte_packets(dc, set, dir, proto,
+						tmp.bpc[set][dir][proto].bytes,
+						tmp.bpc[set][dir][proto].packets);
+	}
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts = container_of(head, struct tag_stat, rcu);
+
+	kfree(ts->counters);
+	kfree(ts);
 }
 
 /*
@@ -1400,32 +1474,80 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->counters = kzalloc(nr_cpu_ids *
+		sizeof(*new_tag_stat_entry->counters), GFP_ATOMIC);
+	if (!new_tag_stat_entry->counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
 	return new_tag_stat_entry;
 }
 
-static void if_tag_stat_update(const char *ifname, uid_t uid,
+/*
+ * Caller must hold rcu_read_lock() and keep it until it is done with the
+ * tag_stat: entries removed from the tree are only freed after a grace
+ * period.
+ */
+static void if_tag_stat_cache_fill(const struct net_device *net_dev,
+				   uid_t uid, const struct sock *sk,
+				   unsigned int gen, int active_set,
+				   struct tag_stat *ts)
+{
+	struct tag_stat_cache_entry *tce;
+
+	tce = tag_stat_cache_entry(sk, net_dev, uid);
+	tce->sk = sk;
+	tce->dev = net_dev;
+	tce->uid = uid;
+	tce->gen = gen;
+	tce->active_set = active_set;
+	tce->ts = ts;
+}
+
+static void if_tag_stat_update(const struct net_device *net_dev, uid_t uid,
 			       const struct sock *sk, enum ifs_tx_rx direction,
 			       int proto, int bytes)
 {
+	const char *ifname = net_dev->name;
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
+	struct tag_stat *uid_tag_stat;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
+	struct tag_stat_cache_entry *tce;
+	unsigned int gen;
+	int active_set;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
+	rcu_read_lock();
+	local_bh_disable();
+	gen = atomic_read(&tag_stat_cache_gen);
+	smp_rmb();
+	tce = tag_stat_cache_entry(sk, net_dev, uid);
+	if (tce->ts && tce->gen == gen && tce->sk == sk &&
+	    tce->dev == net_dev && tce->uid == uid) {
+		tag_stat_update(tce->ts, tce->active_set, direction, proto,
+				bytes);
+		local_bh_enable();
+		rcu_read_unlock();
+		return;
+	}
+	local_bh_enable();
 
 	spin_lock_bh(&iface_stat_list_lock);
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		pr_err_ratelimited("qtaguid: tag_stat: stat_update() "
 				   "%s not found\n", ifname);
 		return;
@@ -1463,8 +1585,13 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		active_set = get_active_counter_set(tag);
+		tag_stat_update(tag_stat_entry, active_set, direction, proto,
+				bytes);
+		if_tag_stat_cache_fill(net_dev, uid, sk, gen, active_set,
+				       tag_stat_entry);
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
@@ -1480,9 +1607,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
 			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+		uid_tag_stat = new_tag_stat;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_stat = tag_stat_entry;
 	}
 
 	if (acct_tag) {
@@ -1490,7 +1617,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		new_tag_stat = create_if_tag_stat(iface_entry, tag);
 		if (!new_tag_stat)
 			goto unlock;
-		new_tag_stat->parent_counters = uid_tag_counters;
+		new_tag_stat->parent = uid_tag_stat;
 	} else {
 		/*
 		 * For new_tag_stat to be still NULL here would require:
@@ -1502,9 +1629,13 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		BUG_ON(!new_tag_stat);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
+	active_set = get_active_counter_set(tag);
+	tag_stat_update(new_tag_stat, active_set, direction, proto, bytes);
+	if_tag_stat_cache_fill(net_dev, uid, sk, gen, active_set,
+			       new_tag_stat);
 unlock:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1527,6 +1658,9 @@ static int iface_netdev_event_handler(struct notifier_block *nb,
 	case NETDEV_UNREGISTER:
 		iface_stat_update(dev, event == NETDEV_DOWN);
 		atomic64_inc(&qtu_events.iface_events);
+		/* The net_device may come back under another name */
+		if (event == NETDEV_UNREGISTER)
+			tag_stat_cache_invalidate();
 		break;
 	}
 	return NOTIFY_DONE;
@@ -1738,7 +1872,7 @@ static void account_for_uid(const struct sk_buff *skb,
 		 par->hooknum, el_dev->name, el_dev->type,
 		 par->family, proto, direction);
 
-	if_tag_stat_update(el_dev->name, uid,
+	if_tag_stat_update(el_dev, uid,
 			   skb->sk ? skb->sk : alternate_sk,
 			   direction,
 			   proto, skb->len);
@@ -2119,6 +2253,7 @@ static int ctrl_cmd_delete(const char *input)
 				list_del(&st_entry->list);
 		}
 	}
+	tag_stat_cache_invalidate();
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
 
@@ -2137,6 +2272,7 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
 		kfree(tcs_entry);
+		tag_stat_cache_invalidate();
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2167,7 +2303,8 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				tag_stat_cache_invalidate();
+				call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2255,6 +2392,7 @@ static int ctrl_cmd_counter_set(const char *input)
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
 	tcs->active_set = counter_set;
+	tag_stat_cache_invalidate();
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2398,6 +2536,7 @@ static int ctrl_cmd_tag(const char *input)
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
+	tag_stat_cache_invalidate();
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
 	/* We keep the ref to the socket (file) until it is untagged */
@@ -2484,6 +2623,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * only during a cmd_delete().
 	 */
 	tag_ref_entry->num_sock_tags--;
+	tag_stat_cache_invalidate();
 	spin_unlock_bh(&sock_tag_list_lock);
 	/*
 	 * Release the sock_fd that was grabbed at tag time,
@@ -2583,6 +2723,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
 	struct data_counters *cnts;
+	struct data_counters dc;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2613,7 +2754,8 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		tag_stat_get_counters(ppi->ts_entry, &dc);
+		cnts = &dc;
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2880,6 +3022,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 	kfree(pqd_entry);
 	file->private_data = NULL;
 
+	tag_stat_cache_invalidate();
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
 
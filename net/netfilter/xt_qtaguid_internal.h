@@ -11,8 +11,11 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -204,14 +207,45 @@ struct tag_node {
 	tag_t tag;
 };
 
+/*
+ * One bucket per cpu: it is only written by its own cpu with bottom halves
+ * disabled, so packets are counted without taking any lock.
+ */
+struct tag_stat_counters {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	/* nr_cpu_ids buckets, added up by tag_stat_get_counters() */
+	struct tag_stat_counters *counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
+	/* Lockless cache users may still hold it after it is erased */
+	struct rcu_head rcu;
+};
+
+void tag_stat_get_counters(struct tag_stat *ts, struct data_counters *dc);
+
+/*
+ * Per cpu cache of the tag_stat that the packets of a {sk, uid, dev} were
+ * last billed to, together with the counter set that was active for it.
+ * An entry is only used while its gen matches the global one, which is
+ * bumped whenever sock tags, counter sets or tag_stats go away or change.
+ */
+#define TAG_STAT_CACHE_BITS 6
+
+struct tag_stat_cache_entry {
+	const struct sock *sk;  /* Only used as a number, never dereferenced */
+	const struct net_device *dev;
+	uid_t uid;
+	unsigned int gen;
+	int active_set;
+	struct tag_stat *ts;
 };
 
 struct iface_stat {
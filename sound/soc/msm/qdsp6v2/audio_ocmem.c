@@ -24,6 +24,9 @@
 #include <linux/of_device.h>
 #include <asm/mach-types.h>
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
 #include <mach/ocmem.h>
@@ -134,10 +137,118 @@ struct audio_ocmem_prv {
 	struct ramdump_segment ocmem_ramdump_segment;
 	dma_addr_t ocmem_dump_addr;
 	void *ocmem_dump_virt;
+	/* session stats, protected by audio_lock */
+	u32 sessions;
+	bool in_session;
+	bool mapped;
+	ktime_t session_start;
+	ktime_t map_start;
+	s64 mapped_us;
+	s64 last_session_us;
+	s64 last_mapped_us;
+	struct dentry *debugfs;
 };
 
 static struct audio_ocmem_prv audio_ocmem_lcl;
 
+/*
+ * While the low power segments of the DSP are mapped to OCMEM the DSP
+ * runs without touching DDR between buffer refills, so the time spent
+ * mapped is the time the session allowed DDR to stay in self refresh.
+ */
+static void audio_ocmem_stats_map(bool mapped)
+{
+	ktime_t now = ktime_get();
+
+	if (mapped && !audio_ocmem_lcl.mapped) {
+		audio_ocmem_lcl.map_start = now;
+	} else if (!mapped && audio_ocmem_lcl.mapped) {
+		audio_ocmem_lcl.mapped_us += ktime_us_delta(now,
+					audio_ocmem_lcl.map_start);
+	}
+	audio_ocmem_lcl.mapped = mapped;
+}
+
+static void audio_ocmem_session_start(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&audio_ocmem_lcl.audio_lock, flags);
+	audio_ocmem_lcl.sessions++;
+	audio_ocmem_lcl.in_session = true;
+	audio_ocmem_lcl.mapped = false;
+	audio_ocmem_lcl.mapped_us = 0;
+	audio_ocmem_lcl.session_start = ktime_get();
+	spin_unlock_irqrestore(&audio_ocmem_lcl.audio_lock, flags);
+}
+
+static void audio_ocmem_session_end(void)
+{
+	unsigned long flags;
+	s64 session_us, mapped_us;
+
+	spin_lock_irqsave(&audio_ocmem_lcl.audio_lock, flags);
+	if (!audio_ocmem_lcl.in_session) {
+		spin_unlock_irqrestore(&audio_ocmem_lcl.audio_lock, flags);
+		return;
+	}
+	audio_ocmem_stats_map(false);
+	session_us = ktime_us_delta(ktime_get(),
+				audio_ocmem_lcl.session_start);
+	mapped_us = audio_ocmem_lcl.mapped_us;
+	audio_ocmem_lcl.last_session_us = session_us;
+	audio_ocmem_lcl.last_mapped_us = mapped_us;
+	audio_ocmem_lcl.in_session = false;
+	spin_unlock_irqrestore(&audio_ocmem_lcl.audio_lock, flags);
+
+	pr_debug("%s: session %u: %lld ms, %lld ms in low power\n", __func__,
+		audio_ocmem_lcl.sessions, div_s64(session_us, USEC_PER_MSEC),
+		div_s64(mapped_us, USEC_PER_MSEC));
+}
+
+static int audio_ocmem_stats_show(struct seq_file *s, void *unused)
+{
+	unsigned long flags;
+	s64 session_us, mapped_us;
+	bool in_session;
+	u32 sessions;
+
+	spin_lock_irqsave(&audio_ocmem_lcl.audio_lock, flags);
+	sessions = audio_ocmem_lcl.sessions;
+	in_session = audio_ocmem_lcl.in_session;
+	if (in_session) {
+		session_us = ktime_us_delta(ktime_get(),
+					audio_ocmem_lcl.session_start);
+		mapped_us = audio_ocmem_lcl.mapped_us;
+		if (audio_ocmem_lcl.mapped)
+			mapped_us += ktime_us_delta(ktime_get(),
+					audio_ocmem_lcl.map_start);
+	} else {
+		session_us = audio_ocmem_lcl.last_session_us;
+		mapped_us = audio_ocmem_lcl.last_mapped_us;
+	}
+	spin_unlock_irqrestore(&audio_ocmem_lcl.audio_lock, flags);
+
+	seq_printf(s, "sessions: %u\n", sessions);
+	seq_printf(s, "%s session: %lld ms\n", in_session ? "current" : "last",
+		div_s64(session_us, USEC_PER_MSEC));
+	seq_printf(s, "low power: %lld ms\n", div_s64(mapped_us,
+		USEC_PER_MSEC));
+	return 0;
+}
+
+static int audio_ocmem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, audio_ocmem_stats_show, inode->i_private);
+}
+
+static const struct file_operations audio_ocmem_stats_fops = {
+	.open = audio_ocmem_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int audio_ocmem_client_cb(struct notifier_block *this,
 		 unsigned long event1, void *data)
 {
@@ -156,6 +267,7 @@ static int audio_ocmem_client_cb(struct notifier_block *this,
 		clear_bit_pos(audio_ocmem_lcl.audio_state,
 				OCMEM_STATE_MAP_TRANSITION);
 		set_bit_pos(audio_ocmem_lcl.audio_state, OCMEM_STATE_MAP_COMPL);
+		audio_ocmem_stats_map(true);
 		break;
 	case OCMEM_MAP_FAIL:
 		pr_debug("%s: map fail\n", __func__);
@@ -169,6 +281,7 @@ static int audio_ocmem_client_cb(struct notifier_block *this,
 				OCMEM_STATE_UNMAP_TRANSITION);
 		set_bit_pos(audio_ocmem_lcl.audio_state,
 				OCMEM_STATE_UNMAP_COMPL);
+		audio_ocmem_stats_map(false);
 		break;
 	case OCMEM_UNMAP_FAIL:
 		pr_debug("%s: unmap fail\n", __func__);
@@ -246,6 +359,7 @@ int audio_ocmem_enable(int cid)
 
 	pr_debug("%s, %p\n", __func__, &audio_ocmem_lcl);
 	atomic_set(&audio_ocmem_lcl.audio_state, OCMEM_STATE_DEFAULT);
+	audio_ocmem_session_start();
 	if (audio_ocmem_lcl.lp_memseg_ptr == NULL) {
 		/* Retrieve low power segments */
 		ret = core_get_low_power_segments(
@@ -543,6 +657,7 @@ fail_cmd2:
 	mutex_unlock(&audio_ocmem_lcl.state_process_lock);
 fail_cmd:
 	pr_debug("%s: exit\n", __func__);
+	audio_ocmem_session_end();
 	audio_ocmem_lcl.buf = NULL;
 	audio_ocmem_lcl.audio_ocmem_running = false;
 	return ret;
@@ -960,6 +1075,8 @@ static int ocmem_audio_client_probe(struct platform_device *pdev)
 		goto destroy_voice_wq;
 	}
 	audio_ocmem_lcl.lp_memseg_ptr = NULL;
+	audio_ocmem_lcl.debugfs = debugfs_create_file("audio_ocmem", S_IRUGO,
+					NULL, NULL, &audio_ocmem_stats_fops);
 	return 0;
 destroy_voice_wq:
 	if (audio_ocmem_lcl.voice_ocmem_workqueue) {
@@ -989,6 +1106,7 @@ static int ocmem_audio_client_remove(struct platform_device *pdev)
 					dev_get_drvdata(&pdev->dev);
 
 	msm_bus_cl_clear_pdata(audio_ocmem_bus_scale_pdata);
+	debugfs_remove(audio_ocmem_lcl.debugfs);
 	ocmem_notifier_unregister(audio_ocmem_lcl.audio_hdl,
 					&audio_ocmem_client_nb);
 	if (audio_ocmem_lcl.ocmem_ramdump_dev)
@@ -151,17 +151,22 @@ static void event_handler(uint32_t opcode,
 			snd_pcm_period_elapsed(substream);
 		atomic_inc(&prtd->out_count);
 		wake_up(&the_locks.write_wait);
+		if (prtd->mmap_flag && prtd->mmap_inflight)
+			prtd->mmap_inflight--;
 		if (!atomic_read(&prtd->start))
 			break;
 		if (!prtd->mmap_flag || prtd->reset_event)
 			break;
-		if (q6asm_is_cpu_buf_avail_nolock(IN,
+		while (prtd->mmap_inflight < prtd->mmap_depth &&
+			q6asm_is_cpu_buf_avail_nolock(IN,
 				prtd->audio_client,
 				&size, &idx)) {
 			pr_debug("%s:writing %d bytes of buffer to dsp 2\n",
 					__func__, prtd->pcm_count);
-			q6asm_write_nolock(prtd->audio_client,
-				prtd->pcm_count, 0, 0, NO_TIMESTAMP);
+			if (q6asm_write_nolock(prtd->audio_client,
+				prtd->pcm_count, 0, 0, NO_TIMESTAMP))
+				break;
+			prtd->mmap_inflight++;
 		}
 		break;
 	}
@@ -223,12 +228,18 @@ static void event_handler(uint32_t opcode,
 				break;
 			}
 			if (prtd->mmap_flag) {
-				pr_debug("%s:writing %d bytes of buffer to dsp\n",
-					__func__,
-					prtd->pcm_count);
-				q6asm_write_nolock(prtd->audio_client,
-					prtd->pcm_count,
-					0, 0, NO_TIMESTAMP);
+				while (prtd->mmap_inflight <
+					prtd->mmap_depth) {
+					pr_debug("%s:writing %d bytes of buffer to dsp\n",
+						__func__,
+						prtd->pcm_count);
+					if (q6asm_write_nolock(
+						prtd->audio_client,
+						prtd->pcm_count,
+						0, 0, NO_TIMESTAMP))
+						break;
+					prtd->mmap_inflight++;
+				}
 			} else {
 				while (atomic_read(&prtd->out_needed)) {
 					pr_debug("%s:writing %d bytes of buffer to dsp\n",
@@ -299,6 +310,18 @@ static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
 	prtd->audio_client->perf_mode = pdata->perf_mode;
 	pr_debug("%s: perf: %x\n", __func__, pdata->perf_mode);
 
+	/*
+	 * In mmap mode the DSP reads the periods straight out of the shared
+	 * buffer. Keep more than one of them queued on low latency streams so
+	 * a late write done doesn't starve the DSP with small periods.
+	 */
+	if (pdata->perf_mode == LEGACY_PCM_MODE)
+		prtd->mmap_depth = 1;
+	else
+		prtd->mmap_depth = min_t(int, PLAYBACK_MMAP_DEPTH,
+			runtime->periods - 1);
+	prtd->mmap_inflight = 0;
+
 	if (params_format(params) == SNDRV_PCM_FORMAT_S24_LE)
 		bits_per_sample = 24;
 
@@ -61,6 +61,7 @@ struct msm_audio_in_frame_info {
 #define PLAYBACK_MAX_NUM_PERIODS    8
 #define PLAYBACK_MAX_PERIOD_SIZE    12288
 #define PLAYBACK_MIN_PERIOD_SIZE    128
+#define PLAYBACK_MMAP_DEPTH         3
 #define CAPTURE_MIN_NUM_PERIODS     2
 #define CAPTURE_MAX_NUM_PERIODS     8
 #define CAPTURE_MAX_PERIOD_SIZE     16384
@@ -103,6 +104,8 @@ struct msm_audio {
 	int out_head;
 	int periods;
 	int mmap_flag;
+	int mmap_depth;    /* periods kept queued to the DSP in mmap mode */
+	int mmap_inflight;
 	atomic_t pending_buffer;
 	bool set_channel_map;
 	char channel_map[8];
@@ -311,6 +311,22 @@ static uint8_t is_be_dai_extproc(int be_dai)
 		return 0;
 }
 
+/*
+ * A route to a BE whose legacy COPP is already open shares that COPP, the
+ * SRS and Dolby post processing of the COPP is already set up then.
+ */
+static bool msm_pcm_routing_copp_reused(int port_id, int perf_mode)
+{
+	return perf_mode == LEGACY_PCM_MODE &&
+		adm_copp_is_open(port_id, perf_mode);
+}
+
+static bool msm_pcm_routing_copp_closed(int port_id, int perf_mode)
+{
+	return perf_mode == LEGACY_PCM_MODE &&
+		!adm_copp_is_open(port_id, perf_mode);
+}
+
 static void msm_pcm_routing_build_matrix(int fedai_id, int dspst_id,
 	int path_type, int perf_mode)
 {
@@ -381,6 +397,7 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 	struct route_payload payload;
 	u32 channels;
 	uint16_t bits_per_sample = 16;
+	bool reused;
 
 	if (fedai_id > MSM_FRONTEND_DAI_MM_MAX_ID) {
 		/* bad ID assigned in machine driver */
@@ -425,6 +442,8 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 			if (msm_bedais[i].port_id == VOICE_RECORD_RX ||
 			    msm_bedais[i].port_id == VOICE_RECORD_TX)
 				topology = DEFAULT_COPP_TOPOLOGY;
+			reused = msm_pcm_routing_copp_reused(
+				msm_bedais[i].port_id, perf_mode);
 			if ((stream_type == SNDRV_PCM_STREAM_PLAYBACK) &&
 				(channels > 0))
 				adm_multi_ch_copp_open(msm_bedais[i].port_id,
@@ -444,6 +463,8 @@ int msm_pcm_routing_reg_phy_stream(int fedai_id, int perf_mode,
 			payload.copp_ids[payload.num_copps++] =
 				msm_bedais[i].port_id;
 			port_id = srs_port_id = msm_bedais[i].port_id;
+			if (reused)
+				continue;
 			srs_send_params(srs_port_id, 1, 0);
 			if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
 			    (perf_mode == LEGACY_PCM_MODE))
@@ -508,8 +529,8 @@ void msm_pcm_routing_dereg_phy_stream(int fedai_id, int stream_type)
 			adm_close(msm_bedais[i].port_id,
 				  fe_dai_perf_mode[fedai_id][session_type]);
 			if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
-			    (fe_dai_perf_mode[fedai_id][session_type] ==
-							LEGACY_PCM_MODE))
+			    msm_pcm_routing_copp_closed(msm_bedais[i].port_id,
+				fe_dai_perf_mode[fedai_id][session_type]))
 				dolby_dap_deinit(msm_bedais[i].port_id);
 		}
 	}
@@ -542,6 +563,7 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 	u32 channels;
 	uint16_t bits_per_sample = 16;
 	struct msm_pcm_routing_fdai_data *fdai;
+	bool reused;
 
 	pr_debug("%s: reg %x val %x set %x\n", __func__, reg, val, set);
 
@@ -592,6 +614,12 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 			    msm_bedais[reg].port_id == VOICE_RECORD_TX)
 				topology = DEFAULT_COPP_TOPOLOGY;
 
+			reused = msm_pcm_routing_copp_reused(
+				msm_bedais[reg].port_id,
+				(session_type == SESSION_TYPE_RX &&
+				 channels > 0) ?
+				fe_dai_perf_mode[val][session_type] :
+				LEGACY_PCM_MODE);
 			if ((session_type == SESSION_TYPE_RX) &&
 				(channels > 0)) {
 				adm_multi_ch_copp_open(msm_bedais[reg].port_id,
@@ -617,13 +645,16 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 				fdai->strm_id, path_type,
 				fe_dai_perf_mode[val][session_type]);
 			port_id = srs_port_id = msm_bedais[reg].port_id;
-			srs_send_params(srs_port_id, 1, 0);
-			if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
-			    (fe_dai_perf_mode[val][session_type] ==
+			if (!reused) {
+				srs_send_params(srs_port_id, 1, 0);
+				if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
+				    (fe_dai_perf_mode[val][session_type] ==
 							LEGACY_PCM_MODE))
-				if (dolby_dap_init(port_id, channels) < 0)
-					pr_err("%s: Err init dolby dap\n",
-						__func__);
+					if (dolby_dap_init(port_id,
+							channels) < 0)
+						pr_err("%s: Err init dolby dap\n",
+							__func__);
+			}
 		}
 	} else {
 		if (test_bit(val, &msm_bedais[reg].fe_sessions) &&
@@ -637,8 +668,8 @@ static void msm_pcm_routing_process_audio(u16 reg, u16 val, int set)
 			adm_close(msm_bedais[reg].port_id,
 				  fe_dai_perf_mode[val][session_type]);
 			if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
-			    (fe_dai_perf_mode[val][session_type] ==
-							LEGACY_PCM_MODE))
+			    msm_pcm_routing_copp_closed(msm_bedais[reg].port_id,
+				fe_dai_perf_mode[val][session_type]))
 				dolby_dap_deinit(msm_bedais[reg].port_id);
 			msm_pcm_routing_build_matrix(val,
 				fdai->strm_id, path_type,
@@ -4412,8 +4443,8 @@ static int msm_pcm_routing_close(struct snd_pcm_substream *substream)
 				  fe_dai_perf_mode[i][session_type]);
 			srs_port_id = -1;
 			if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
-			    (fe_dai_perf_mode[i][session_type] ==
-							LEGACY_PCM_MODE))
+			    msm_pcm_routing_copp_closed(bedai->port_id,
+				fe_dai_perf_mode[i][session_type]))
 				dolby_dap_deinit(bedai->port_id);
 		}
 	}
@@ -4433,7 +4464,7 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 	int i, path_type, session_type, port_id, topology;
 	struct msm_pcm_routing_bdai_data *bedai;
 	u32 channels;
-	bool playback, capture;
+	bool playback, capture, reused;
 	uint16_t bits_per_sample = 16;
 	struct msm_pcm_routing_fdai_data *fdai;
 
@@ -4490,6 +4521,8 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 			    bedai->port_id == VOICE_RECORD_TX)
 				topology = DEFAULT_COPP_TOPOLOGY;
 
+			reused = msm_pcm_routing_copp_reused(bedai->port_id,
+				fe_dai_perf_mode[i][session_type]);
 			if ((playback) && (channels > 0)) {
 				adm_multi_ch_copp_open(bedai->port_id,
 					path_type,
@@ -4511,6 +4544,8 @@ static int msm_pcm_routing_prepare(struct snd_pcm_substream *substream)
 				fdai->strm_id, path_type,
 				fe_dai_perf_mode[i][session_type]);
 			port_id = srs_port_id = bedai->port_id;
+			if (reused)
+				continue;
 			srs_send_params(srs_port_id, 1, 0);
 			if ((DOLBY_ADM_COPP_TOPOLOGY_ID == topology) &&
 			    (fe_dai_perf_mode[i][session_type] ==
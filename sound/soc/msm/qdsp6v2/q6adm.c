@@ -1649,6 +1649,30 @@ int adm_get_lowlatency_copp_id(int port_index)
 }
 #endif /* #ifdef CONFIG_RTAC */
 
+/**
+ * adm_copp_is_open() - Check whether a port has an open COPP
+ * @port_id: AFE port of the COPP
+ * @perf_mode: Performance mode the COPP was opened with
+ *
+ * adm_open() only takes another reference on an open COPP, so callers use
+ * this to set up post processing only on the first open of a COPP.
+ */
+bool adm_copp_is_open(int port_id, int perf_mode)
+{
+	int index;
+
+	port_id = q6audio_convert_virtual_to_portid(port_id);
+	if (q6audio_validate_port(port_id) < 0)
+		return false;
+
+	index = q6audio_get_port_index(port_id);
+	if (perf_mode == ULTRA_LOW_LATENCY_PCM_MODE ||
+			perf_mode == LOW_LATENCY_PCM_MODE)
+		return atomic_read(&this_adm.copp_low_latency_cnt[index]) != 0;
+
+	return atomic_read(&this_adm.copp_cnt[index]) != 0;
+}
+
 void adm_ec_ref_rx_id(int port_id)
 {
 	this_adm.ec_ref_rx = port_id;